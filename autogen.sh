@@ -18,11 +18,9 @@
 # 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 #
 
-autoheader
 touch NEWS README AUTHORS ChangeLog
 touch stamp-h
-aclocal
-autoconf
+autoreconf --force --install
 mkdir -p po
 find src \( -name '*.c' -o -name '*.cc' -o -name '*.h' \) -print \
 | xargs xgettext -k_ -kN_ -p po -d UnixCW
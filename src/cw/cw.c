@@ -33,6 +33,7 @@
 #include <limits.h>
 #include <stdarg.h>
 #include <errno.h>
+#include <inttypes.h>
 
 #if defined(HAVE_STRING_H)
 # include <string.h>
@@ -47,6 +48,7 @@
 
 #include "cw.h"
 #include "libcw.h"
+#include "libcw2.h"
 #include "i18n.h"
 #include "cmdline.h"
 #include "cw_copyright.h"
@@ -84,11 +86,13 @@ static void cw_atexit(void);
 
 static cw_config_t *config = NULL; /* program-specific configuration */
 static bool generator = false;     /* have we created a generator? */
+static cw_timeline_t *timeline = NULL; /* keying timeline, for -l option */
 static const char *all_options = "s:|system,d:|device,"
 	"w:|wpm,t:|tone,v:|volume,"
 	"g:|gap,k:|weighting,"
 	"f:|infile,"
 	"e|noecho,m|nomessages,c|nocommands,o|nocombinations,p|nocomments,"
+	"l|timeline,"
 	"h|help,V|version";
 
 
@@ -105,12 +109,13 @@ static const char *all_options = "s:|system,d:|device,"
 /**
    \brief fprintf-like function printing to echo stream (i.e. to stdout)
 
-   Printing is suppressed if appropriate config flag is not set.
+   Printing is suppressed if appropriate config flag is not set, or
+   if stdout is used for keying timeline.
    Writes are synchronously flushed.
 */
 void write_to_echo_stream(const char * format, ...)
 {
-	if (config->do_echo) {
+	if (config->do_echo && !config->do_timeline) {
 		va_list ap;
 
 		va_start(ap, format);
@@ -314,25 +319,25 @@ int parse_stream_cwquery(FILE * stream)
 		return CW_FAILURE;
 	}
 
-	int cw_ret = CW_FAILURE;
+	int cwret = CW_FAILURE;
 	switch (c) {
 	case CW_CMDV_FREQUENCY:
 	case CW_CMDV_VOLUME:
 	case CW_CMDV_SPEED:
 	case CW_CMDV_GAP:
 	case CW_CMDV_WEIGHTING:
-		cw_ret = write_to_cw_sender(format, value);
+		cwret = write_to_cw_sender(format, value);
 		break;
 	case CW_CMDV_ECHO:
 	case CW_CMDV_ERRORS:
 	case CW_CMDV_COMMANDS:
 	case CW_CMDV_COMBINATIONS:
 	case CW_CMDV_COMMENTS:
-		cw_ret = write_to_cw_sender(format, value ? _("ON") : _("OFF"));
+		cwret = write_to_cw_sender(format, value ? _("ON") : _("OFF"));
 		break;
 	}
 
-	return cw_ret;
+	return cwret;
 }
 
 
@@ -423,7 +428,7 @@ int parse_stream_parameter(int c, FILE *stream)
 */
 int parse_stream_command(FILE * stream)
 {
-	int cw_ret = CW_FAILURE;
+	int cwret = CW_FAILURE;
 
 	const int c = toupper(fgetc(stream));
 	switch (c) {
@@ -439,13 +444,13 @@ int parse_stream_command(FILE * stream)
 	case CW_CMDV_COMMANDS:
 	case CW_CMDV_COMBINATIONS:
 	case CW_CMDV_COMMENTS:
-		cw_ret = parse_stream_parameter(c, stream);
+		cwret = parse_stream_parameter(c, stream);
 		break;
 	case CW_CMD_QUERY:
-		cw_ret = parse_stream_query(stream);
+		cwret = parse_stream_query(stream);
 		break;
 	case CW_CMD_CWQUERY:
-		cw_ret = parse_stream_cwquery(stream);
+		cwret = parse_stream_cwquery(stream);
 		break;
 	case CW_CMDV_QUIT:
 		cw_flush_tone_queue();
@@ -453,10 +458,10 @@ int parse_stream_command(FILE * stream)
 		exit(EXIT_SUCCESS);
 	default:
 		write_to_message_stream("%c%c%c", CW_STATUS_ERR, CW_CMD_ESCAPE, c);
-		cw_ret = CW_FAILURE;
+		cwret = CW_FAILURE;
 	}
 
-	return cw_ret;
+	return cwret;
 }
 
 
@@ -635,6 +640,12 @@ int main(int argc, char *const argv[])
 		exit(EXIT_FAILURE);
 	}
 
+	if (config->do_timeline) {
+		/* Characters are collected in timeline, nothing is
+		   sounded. */
+		config->audio_system = CW_AUDIO_NULL;
+	}
+
 	if (config->input_file) {
 		if (!freopen(config->input_file, "r", stdin)) {
 			fprintf(stderr, _("%s: %s\n"), config->program_name, strerror(errno));
@@ -659,6 +670,15 @@ int main(int argc, char *const argv[])
 		exit(EXIT_FAILURE);
 	}
 
+	if (config->do_timeline) {
+		timeline = cw_timeline_new();
+		if (!timeline) {
+			fprintf(stderr, _("%s: failed to create timeline\n"), config->program_name);
+			exit(EXIT_FAILURE);
+		}
+		cw_generator_set_timeline(timeline);
+	}
+
 	/* Set up signal handlers to exit on a range of signals. */
 	static const int SIGNALS[] = { SIGHUP, SIGINT, SIGQUIT, SIGPIPE, SIGTERM, 0 };
 	for (int i = 0; SIGNALS[i]; i++) {
@@ -678,6 +698,15 @@ int main(int argc, char *const argv[])
 	/* Await final tone completion before exiting. */
 	cw_wait_for_tone_queue();
 
+	if (timeline) {
+		/* One line per interval: key value (1 = Mark, 0 =
+		   Space), start and length of the interval [us]. */
+		for (size_t i = 0; i < timeline->n_entries; i++) {
+			const cw_timeline_entry_t *entry = &timeline->entries[i];
+			fprintf(stdout, "%d %"PRId64" %"PRId32"\n", entry->key_value, entry->start, entry->len);
+		}
+	}
+
 	exit(EXIT_SUCCESS);
 }
 
@@ -693,6 +722,8 @@ void cw_atexit(void)
 		cw_generator_delete();
 	}
 
+	cw_timeline_delete(&timeline);
+
 	if (config) {
 		cw_config_delete(&config);
 	}
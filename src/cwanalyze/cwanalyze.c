@@ -0,0 +1,350 @@
+/*
+ * Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+ * Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+
+#if defined(HAVE_STRING_H)
+# include <string.h>
+#endif
+
+#if defined(HAVE_STRINGS_H)
+# include <strings.h>
+#endif
+
+#include "i18n.h"
+#include "cmdline.h"
+#include "cw_copyright.h"
+
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+
+#define INITIAL_N_CHARACTERS  10   /* Default count of reported mis-formed characters. */
+#define HISTOGRAM_WIDTH       50   /* Width of longest bar of histogram. */
+
+
+struct cwanalyze_config {
+	char *program_name;    /* Program's name (argv[0]) */
+
+	int n_characters;      /* Count of reported mis-formed characters. */
+	char *input_file;      /* Name of input file; NULL for stdin. */
+} g_config = {
+	.program_name = (char *) NULL,
+
+	.n_characters = INITIAL_N_CHARACTERS,
+	.input_file   = (char *) NULL
+};
+
+
+static const char *all_options = "c:|characters,h|help,v|version";
+
+static void cwanalyze_print_report(const cw_analyzer_t *an, int n_characters);
+static void cwanalyze_print_stat(const char *label, const cw_analyzer_stat_t *stat);
+static void cwanalyze_print_usage(const char *program_name);
+static void cwanalyze_print_help(const char *program_name);
+static void cwanalyze_parse_command_line(int argc, char **argv, struct cwanalyze_config *config);
+
+
+
+
+/**
+   \brief Print results of analysis on stdout
+
+   \param an - analyzer
+   \param n_characters - count of reported mis-formed characters
+*/
+void cwanalyze_print_report(const cw_analyzer_t *an, int n_characters)
+{
+	const long seconds = (long) (an->keying_time / 1000000);
+	printf(_("Events: %lld, characters: %lld, words: %lld\n"),
+	       (long long) an->n_events, (long long) an->n_characters, (long long) an->n_words);
+	printf(_("Unrecognized characters: %lld, rejected marks: %lld\n"),
+	       (long long) an->n_unknown, (long long) an->n_rejected);
+	printf(_("Keying time: %ld:%02ld:%02ld\n\n"), seconds / 3600, (seconds / 60) % 60, seconds % 60);
+
+	if (!an->speed.n) {
+		return;
+	}
+
+	printf(_("Speed: %.1f +/- %.1f WPM (%.1f - %.1f)\n"),
+	       an->speed.mean, cw_analyzer_stat_get_sd(&an->speed), an->speed.min, an->speed.max);
+	double ratio, weighting;
+	if (cw_analyzer_get_ratio(an, &ratio)) {
+		printf(_("Dash/Dot ratio: %.2f\n"), ratio);
+	}
+	if (cw_analyzer_get_weighting(an, &weighting)) {
+		printf(_("Weighting: %.1f\n"), weighting);
+	}
+	printf("\n");
+
+	printf("%s", _("Lengths [ms]:\n"));
+	cwanalyze_print_stat(_("Dot"), &an->dot);
+	cwanalyze_print_stat(_("Dash"), &an->dash);
+	cwanalyze_print_stat(_("Inter-mark space"), &an->imark_space);
+	cwanalyze_print_stat(_("Inter-character space"), &an->ichar_space);
+	cwanalyze_print_stat(_("Inter-word space"), &an->iword_space);
+	printf("\n");
+
+
+	printf("%s", _("Lengths of marks [units]:\n"));
+	int64_t histogram_max = 1;
+	for (int i = 0; i < CW_ANALYZER_HISTOGRAM_SIZE; i++) {
+		if (an->histogram[i] > histogram_max) {
+			histogram_max = an->histogram[i];
+		}
+	}
+	for (int i = 0; i < CW_ANALYZER_HISTOGRAM_SIZE; i++) {
+		if (!an->histogram[i]) {
+			continue;
+		}
+		printf("  %5.2f %8lld ", 1.0 * i / CW_ANALYZER_HISTOGRAM_BINS_PER_UNIT, (long long) an->histogram[i]);
+		for (int k = 0; k < (int) (HISTOGRAM_WIDTH * an->histogram[i] / histogram_max); k++) {
+			putchar('#');
+		}
+		putchar('\n');
+	}
+	printf("\n");
+
+
+	double speeds[CW_ANALYZER_SPEED_POINTS_MAX];
+	int64_t interval = 0;
+	const int n_points = cw_analyzer_get_speed_curve(an, speeds, &interval);
+	printf(_("Speed over time [WPM], every %lld s:\n"), (long long) (interval / 1000000));
+	for (int i = 0; i < n_points; i++) {
+		printf("%5.1f%s", speeds[i], (i % 10 == 9 || i == n_points - 1) ? "\n" : " ");
+	}
+	printf("\n");
+
+
+	printf("%s", _("Characters:\n"));
+	printf("%s", _("  char    count  mis-formed  speed [WPM]   dot [ms]   dash [ms]\n"));
+	for (int c = 0; c < CW_ANALYZER_N_CHARACTERS; c++) {
+		const cw_analyzer_character_t *ch = cw_analyzer_get_character(an, (char) c);
+		if (!ch || !ch->n) {
+			continue;
+		}
+		printf("  %c    %8lld  %9.1f%%  %11.1f  %9.1f  %10.1f\n",
+		       c, (long long) ch->n, 100.0 * ch->n_malformed / ch->n,
+		       ch->speed.mean, ch->dot.mean / 1000, ch->dash.mean / 1000);
+	}
+	printf("\n");
+
+
+	char *malformed = (char *) malloc(n_characters + 1);
+	if (malformed) {
+		const int n = cw_analyzer_get_malformed_characters(an, malformed, n_characters);
+		if (n) {
+			printf(_("Most frequently mis-formed characters: %s\n"), malformed);
+		}
+		free(malformed);
+	}
+
+	char representation[CW_ANALYZER_UNKNOWN_LEN + 1];
+	int64_t count;
+	for (int i = 0; cw_analyzer_get_unknown(an, i, representation, &count); i++) {
+		if (i == 0) {
+			printf("%s", _("Most frequent unrecognized representations:\n"));
+		}
+		printf("  %-16s %8lld\n", representation, (long long) count);
+	}
+
+	return;
+}
+
+
+
+
+void cwanalyze_print_stat(const char *label, const cw_analyzer_stat_t *stat)
+{
+	if (!stat->n) {
+		return;
+	}
+	printf("  %-22s %8.1f +/- %6.1f  (%.1f - %.1f)\n", label,
+	       stat->mean / 1000, cw_analyzer_stat_get_sd(stat) / 1000, stat->min / 1000, stat->max / 1000);
+
+	return;
+}
+
+
+
+
+/**
+   \brief Print out a brief message directing the user to the help function
+
+   \param program_name - program's name
+*/
+void cwanalyze_print_usage(const char *program_name)
+{
+	const char *format = has_longopts()
+		? _("Try '%s --help' for more information.\n")
+		: _("Try '%s -h' for more information.\n");
+
+	fprintf(stderr, format, program_name);
+	return;
+}
+
+
+
+
+/*
+  \brief Print out a brief page of help information
+
+  \param program_name - program's name
+*/
+static void cwanalyze_print_help(const char *program_name)
+{
+	if (!has_longopts()) {
+		fprintf(stderr, "%s", _("Long format of options is not supported on your system\n\n"));
+	}
+
+	printf(_("Usage: %s [options...] [FILE]\n\n"), program_name);
+
+	printf("%s", _("  Analyze trace of keying from FILE (or standard input).\n\n"));
+	printf(_("  -c, --characters=N     report N most frequently mis-formed characters [default %d]\n"), INITIAL_N_CHARACTERS);
+	printf("%s", _("  -h, --help             print this message\n"));
+	printf("%s", _("  -v, --version          output version information and exit\n\n"));
+
+	exit(EXIT_SUCCESS);
+}
+
+
+
+
+/**
+   \brief Parse command line options
+
+   \param argc - main()'s argc
+   \param argv - main()'s argv
+   \param config - program's configuration variable
+*/
+void cwanalyze_parse_command_line(int argc, char **argv, struct cwanalyze_config *config)
+{
+	int option;
+	char *argument;
+
+	config->program_name = strdup(cw_program_basename(argv[0]));
+	if (!config->program_name) {
+		fprintf(stderr, "%s: failed to allocate memory\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	while (get_option(argc, argv, all_options,
+			  &option, &argument)) {
+
+		switch (option) {
+		case 'c':
+			if (sscanf(argument, "%d", &(config->n_characters)) != 1
+			    || config->n_characters < 0
+			    || config->n_characters > CW_ANALYZER_N_CHARACTERS) {
+
+				fprintf(stderr, _("%s: invalid characters value: '%s'\n"), config->program_name, argument);
+				exit(EXIT_FAILURE);
+			}
+			break;
+
+		case 'h':
+			cwanalyze_print_help(config->program_name);
+			break;
+
+		case 'v':
+			printf(_("%s version %s\n%s\n"),
+			       config->program_name, PACKAGE_VERSION, _(CW_COPYRIGHT));
+			exit(EXIT_SUCCESS);
+
+		case '?':
+			cwanalyze_print_usage(config->program_name);
+			exit(EXIT_FAILURE);
+
+		default:
+			fprintf(stderr, _("%s: getopts returned %c\n"), config->program_name, option);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (get_optind() == argc - 1) {
+		config->input_file = argv[argc - 1];
+	} else if (get_optind() != argc) {
+		cwanalyze_print_usage(config->program_name);
+		exit(EXIT_FAILURE);
+	}
+
+	return;
+}
+
+
+
+
+/**
+   \brief Parse the command line options, then analyze the trace
+*/
+int main(int argc, char **argv)
+{
+	int combined_argc;
+	char **combined_argv;
+
+	/* Set locale and message catalogs. */
+	i18n_initialize();
+
+	/* Parse combined environment and command line arguments. */
+	combine_arguments(_("CWANALYZE_OPTIONS"),
+			  argc, argv, &combined_argc, &combined_argv);
+	cwanalyze_parse_command_line(combined_argc, combined_argv, &g_config);
+
+	FILE *input = stdin;
+	if (g_config.input_file) {
+		input = fopen(g_config.input_file, "rb");
+		if (!input) {
+			fprintf(stderr, _("%s: can't open '%s': %s\n"), g_config.program_name, g_config.input_file, strerror(errno));
+			free(g_config.program_name);
+			return EXIT_FAILURE;
+		}
+	}
+
+	int rv = EXIT_FAILURE;
+	cw_trace_reader_t *reader = cw_trace_reader_new(input);
+	cw_analyzer_t *an = cw_analyzer_new();
+	if (reader && an) {
+		if (cw_analyzer_add_trace(an, reader)) {
+			cwanalyze_print_report(an, g_config.n_characters);
+			rv = EXIT_SUCCESS;
+		} else {
+			fprintf(stderr, _("%s: invalid trace\n"), g_config.program_name);
+		}
+	} else {
+		fprintf(stderr, _("%s: failed to allocate memory\n"), g_config.program_name);
+	}
+
+	cw_analyzer_delete(&an);
+	cw_trace_reader_delete(&reader);
+	if (input != stdin) {
+		fclose(input);
+	}
+	free(g_config.program_name);
+
+	return rv;
+}
@@ -44,6 +44,7 @@
 #include "cmdline.h"
 #include "cw_copyright.h"
 #include "dictionary.h"
+#include "scoring.h"
 #include "memory.h"
 #include "libcw_debug.h"
 
@@ -66,6 +67,8 @@ static bool do_colors = true;
 static bool beginning_of_buffer = true;
 /* Current sending state, active or idle. */
 static bool is_sending_active = false;
+/* Text sent in dictionary modes, and user's copy of the text. */
+static cw_score_t *score = NULL;
 
 
 /* Width of parameter windows, displayed at the bottom of window.
@@ -156,8 +159,11 @@ static void queue_enqueue_random_dictionary_text(moderef_t mode, bool beginning_
 static void queue_transfer_character_to_libcw(void);
 static void queue_delete_character(void);
 
+static void score_handle_event(int c);
+
 static void ui_refresh_main_window(void);
 static void ui_display_state(const char *state);
+static void ui_display_score(void);
 static void ui_clear_main_window(void);
 static void ui_poll_user_input(int fd, int usecs);
 static void ui_update_mode_selection(int old_mode, int current_mode);
@@ -368,6 +374,13 @@ void queue_dequeue_character(void)
 			c = queue_data[queue_head];
 			queue_display_highlight_character(true);
 
+			/* In dictionary modes user copies what is
+			   being sent. */
+			if (g_current_mode->type == M_DICTIONARY) {
+				const char sent[2] = { c, '\0' };
+				cw_score_add_sent(score, sent);
+			}
+
 			if (!cw_send_character(c)) {
 				perror("cw_send_character");
 				abort();
@@ -563,6 +576,35 @@ void queue_transfer_character_to_libcw(void)
 
 
 
+/*---------------------------------------------------------------------*/
+/*  Scoring of copy practice                                           */
+/*---------------------------------------------------------------------*/
+
+/**
+   \brief Pass a key typed in dictionary mode to scoring of copy practice
+
+   \param c - key typed by user
+*/
+void score_handle_event(int c)
+{
+	if (c == KEY_BACKSPACE || c == KEY_DC) {
+		cw_score_delete_received(score);
+	} else if (c <= UCHAR_MAX && isprint(c)) {
+		const char received[2] = { (char) c, '\0' };
+		cw_score_add_received(score, received);
+	} else {
+		return;
+	}
+
+	ui_display_score();
+
+	return;
+}
+
+
+
+
+
 /*---------------------------------------------------------------------*/
 /*  Practice timer                                                     */
 /*---------------------------------------------------------------------*/
@@ -862,6 +904,7 @@ void state_change_to_active(void)
 	if (g_current_mode != last_mode) {
 		ui_clear_main_window();
 		timer_start();
+		cw_score_reset(score);
 
 		/* Don't allow a space at the beginning of buffer. */
 		beginning_of_buffer = true;
@@ -1540,6 +1583,13 @@ void ui_handle_event(int c)
 		}
 	}
 
+	/* In dictionary modes characters typed by user are a copy
+	   of sent text. */
+	if (mode_is_sending_active() && mode_current_is_type(M_DICTIONARY)) {
+		score_handle_event(c);
+		return;
+	}
+
 	/* The 'event' is nothing at all of interest; drop it. */
 
 	return;
@@ -1629,6 +1679,43 @@ void ui_display_state(const char *state)
 	wnoutrefresh(text_window);
 	doupdate();
 
+	/* Box has erased score of copy practice. */
+	ui_display_score();
+
+	return;
+}
+
+
+
+
+
+/**
+   \brief Display score of copy practice in bottom edge of main window
+
+   Nothing is displayed until user starts copying.
+*/
+void ui_display_score(void)
+{
+	cw_score_result_t result;
+	cw_score_get_result(score, &result);
+	if (result.n_received == 0) {
+		return;
+	}
+
+	int max_y, max_x;
+	getmaxyx(text_window, max_y, max_x);
+
+	char buffer[64];
+	snprintf(buffer, sizeof (buffer), _("Copy: %d%% (%d errors)"),
+		 cw_score_get_accuracy(score),
+		 result.n_substitutions + result.n_deletions + result.n_insertions);
+
+	/* Clear previous, possibly longer, score. */
+	mvwhline(text_window, max_y - 1, 1, ACS_HLINE, max_x - 2);
+	mvwaddnstr(text_window, max_y - 1, 1, buffer, max_x - 2);
+	wnoutrefresh(text_window);
+	doupdate();
+
 	return;
 }
 
@@ -1760,6 +1847,8 @@ int main(int argc, char **argv)
 	}
 	timer_set_total_practice_time(config->practice_time);
 
+	score = cw_score_new(0);
+
 
 	static const int SIGNALS[] = { SIGHUP, SIGINT, SIGQUIT, SIGPIPE, SIGTERM, 0 };
 	/* Set up signal handlers to clear up and exit on a range of signals. */
@@ -1806,6 +1895,7 @@ void cwcp_atexit(void)
 
 	mode_clean();
 
+	cw_score_delete(&score);
 	cw_dictionaries_unload();
 
 	if (config) {
@@ -0,0 +1,492 @@
+/*
+ * Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+ * Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <sys/time.h>
+#include <errno.h>
+
+#if defined(HAVE_STRING_H)
+# include <string.h>
+#endif
+
+#if defined(HAVE_STRINGS_H)
+# include <strings.h>
+#endif
+
+#include "i18n.h"
+#include "cmdline.h"
+#include "cw_copyright.h"
+
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+
+/* Longest line of CSV file. */
+#define CSV_LINE_SIZE 256
+
+
+enum {
+	MODE_CSV,      /* Binary trace to CSV. */
+	MODE_BINARY,   /* CSV to binary trace. */
+	MODE_TEXT      /* Replay binary trace into receiver, print received text. */
+};
+
+
+struct cwtrace_config {
+	char *program_name;    /* Program's name (argv[0]) */
+
+	int mode;
+	double speedup;        /* Pacing of replay in text mode; zero for no pacing. */
+	char *input_file;      /* Name of input file; NULL for stdin. */
+} g_config = {
+	.program_name = (char *) NULL,
+
+	.mode         = MODE_CSV,
+	.speedup      = 0.0,
+	.input_file   = (char *) NULL
+};
+
+
+static const char *all_options = "m:|mode,x:|speedup,h|help,v|version";
+
+static int  cwtrace_to_csv(FILE *input, FILE *output);
+static int  cwtrace_from_csv(FILE *input, FILE *output);
+static int  cwtrace_to_text(FILE *input, double speedup);
+static bool cwtrace_parse_timestamp(const char *string, struct timeval *timestamp);
+static void cwtrace_character_callback(void *callback_arg, const struct timeval *timestamp, char c, bool is_end_of_word, bool is_error);
+static void cwtrace_print_usage(const char *program_name);
+static void cwtrace_print_help(const char *program_name);
+static void cwtrace_parse_command_line(int argc, char **argv, struct cwtrace_config *config);
+
+
+
+
+/**
+   \brief Convert binary trace to CSV
+
+   Every session is written as line:
+   session,speed,tolerance,gap,weighting,frequency,adaptive,start
+   and every event as line:
+   event,timestamp,key_state
+
+   Timestamps are written as seconds with six decimal places.
+
+   \param input - binary trace
+   \param output - CSV output
+
+   \return EXIT_SUCCESS on success
+   \return EXIT_FAILURE on failure
+*/
+int cwtrace_to_csv(FILE *input, FILE *output)
+{
+	cw_trace_reader_t *reader = cw_trace_reader_new(input);
+	if (!reader) {
+		return EXIT_FAILURE;
+	}
+
+	fprintf(output, "# session,speed,tolerance,gap,weighting,frequency,adaptive,start\n");
+	fprintf(output, "# event,timestamp,key_state\n");
+
+	int session = 0;
+	cw_trace_event_t event;
+	while (cw_trace_reader_next(reader, &event)) {
+		if (event.session != session) {
+			cw_trace_header_t h;
+			cw_trace_reader_get_header(reader, &h);
+			fprintf(output, "session,%d,%d,%d,%d,%d,%d,%ld.%06ld\n",
+				h.speed, h.tolerance, h.gap, h.weighting, h.frequency, h.is_adaptive ? 1 : 0,
+				(long) h.start.tv_sec, (long) h.start.tv_usec);
+			session = event.session;
+		}
+		fprintf(output, "event,%ld.%06ld,%d\n",
+			(long) event.timestamp.tv_sec, (long) event.timestamp.tv_usec, event.key_state);
+	}
+	const int rv = ENOENT == errno ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	cw_trace_reader_delete(&reader);
+
+	return rv;
+}
+
+
+
+
+/**
+   \brief Convert CSV (in format written by cwtrace_to_csv()) to binary trace
+
+   Empty lines and lines starting with '#' are ignored.
+
+   \param input - CSV input
+   \param output - binary trace
+
+   \return EXIT_SUCCESS on success
+   \return EXIT_FAILURE on failure
+*/
+int cwtrace_from_csv(FILE *input, FILE *output)
+{
+	cw_trace_recorder_t *recorder = (cw_trace_recorder_t *) NULL;
+	char line[CSV_LINE_SIZE];
+	int line_number = 0;
+	int rv = EXIT_SUCCESS;
+
+	while (fgets(line, sizeof (line), input)) {
+		line_number++;
+		line[strcspn(line, "\r\n")] = '\0';
+		if (line[0] == '\0' || line[0] == '#') {
+			continue;
+		}
+
+		char timestamp[40];
+		if (!strncmp(line, "session,", strlen("session,"))) {
+			cw_trace_header_t h;
+			int adaptive = 0;
+			if (7 != sscanf(line, "session,%d,%d,%d,%d,%d,%d,%39s",
+					&h.speed, &h.tolerance, &h.gap, &h.weighting, &h.frequency, &adaptive, timestamp)
+			    || !cwtrace_parse_timestamp(timestamp, &h.start)) {
+
+				rv = EXIT_FAILURE;
+				break;
+			}
+			h.is_adaptive = adaptive != 0;
+
+			if (recorder) {
+				if (!cw_trace_recorder_start_session(recorder, &h)) {
+					rv = EXIT_FAILURE;
+					break;
+				}
+			} else {
+				recorder = cw_trace_recorder_new(output, &h);
+				if (!recorder) {
+					rv = EXIT_FAILURE;
+					break;
+				}
+			}
+
+		} else if (!strncmp(line, "event,", strlen("event,"))) {
+			char *comma = strchr(line + strlen("event,"), ',');
+			struct timeval t;
+			int key_state;
+			if (!recorder
+			    || !comma
+			    || (size_t) (comma - line) - strlen("event,") >= sizeof (timestamp)
+			    || 1 != sscanf(comma + 1, "%d", &key_state)) {
+
+				rv = EXIT_FAILURE;
+				break;
+			}
+			*comma = '\0';
+			if (!cwtrace_parse_timestamp(line + strlen("event,"), &t)
+			    || !cw_trace_recorder_add_event(recorder, &t, key_state)) {
+
+				rv = EXIT_FAILURE;
+				break;
+			}
+
+		} else {
+			rv = EXIT_FAILURE;
+			break;
+		}
+	}
+
+	if (EXIT_SUCCESS != rv) {
+		fprintf(stderr, _("%s: invalid line %d of input\n"), g_config.program_name, line_number);
+	}
+
+	if (recorder) {
+		if (!cw_trace_recorder_flush(recorder)) {
+			rv = EXIT_FAILURE;
+		}
+		cw_trace_recorder_delete(&recorder);
+	}
+
+	return rv;
+}
+
+
+
+
+/**
+   \brief Replay binary trace into receiver, print received text on stdout
+
+   \param input - binary trace
+   \param speedup - how many times faster than original the trace should be replayed; zero for no pacing
+
+   \return EXIT_SUCCESS on success
+   \return EXIT_FAILURE on failure
+*/
+int cwtrace_to_text(FILE *input, double speedup)
+{
+	cw_trace_reader_t *reader = cw_trace_reader_new(input);
+	cw_rec_t *rec = cw_rec_new();
+	if (!reader || !rec) {
+		cw_trace_reader_delete(&reader);
+		cw_rec_delete(&rec);
+		return EXIT_FAILURE;
+	}
+
+	const int rv = cw_trace_replay(reader, rec, NULL, speedup, cwtrace_character_callback, NULL);
+	putchar('\n');
+
+	cw_rec_delete(&rec);
+	cw_trace_reader_delete(&reader);
+
+	return rv ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+
+
+void cwtrace_character_callback(__attribute__((unused)) void *callback_arg, __attribute__((unused)) const struct timeval *timestamp, char c, bool is_end_of_word, __attribute__((unused)) bool is_error)
+{
+	putchar(c);
+	if (is_end_of_word) {
+		putchar(' ');
+	}
+	fflush(stdout);
+
+	return;
+}
+
+
+
+
+/**
+   \brief Parse timestamp in form "seconds[.fraction]"
+
+   \param string - string to parse
+   \param timestamp - parsed timestamp
+
+   \return true on success
+   \return false on failure
+*/
+bool cwtrace_parse_timestamp(const char *string, struct timeval *timestamp)
+{
+	char *end = (char *) NULL;
+	errno = 0;
+	const long seconds = strtol(string, &end, 10);
+	if (errno || end == string || seconds < 0) {
+		return false;
+	}
+
+	long usecs = 0;
+	if (*end == '.') {
+		int digits = 0;
+		for (end++; *end >= '0' && *end <= '9'; end++) {
+			if (digits < 6) {
+				usecs = usecs * 10 + (*end - '0');
+				digits++;
+			}
+		}
+		for (; digits < 6; digits++) {
+			usecs *= 10;
+		}
+	}
+	if (*end != '\0') {
+		return false;
+	}
+
+	timestamp->tv_sec = seconds;
+	timestamp->tv_usec = usecs;
+
+	return true;
+}
+
+
+
+
+/**
+   \brief Print out a brief message directing the user to the help function
+
+   \param program_name - program's name
+*/
+void cwtrace_print_usage(const char *program_name)
+{
+	const char *format = has_longopts()
+		? _("Try '%s --help' for more information.\n")
+		: _("Try '%s -h' for more information.\n");
+
+	fprintf(stderr, format, program_name);
+	return;
+}
+
+
+
+
+/*
+  \brief Print out a brief page of help information
+
+  \param program_name - program's name
+*/
+static void cwtrace_print_help(const char *program_name)
+{
+	if (!has_longopts()) {
+		fprintf(stderr, "%s", _("Long format of options is not supported on your system\n\n"));
+	}
+
+	printf(_("Usage: %s [options...] [FILE]\n\n"), program_name);
+
+	printf("%s", _("  -m, --mode=MODE        select what to do with FILE (or standard input):\n"));
+	printf("%s", _("                         csv: convert binary trace to CSV [default]\n"));
+	printf("%s", _("                         binary: convert CSV to binary trace\n"));
+	printf("%s", _("                         text: decode binary trace to text\n"));
+	printf("%s", _("  -x, --speedup=X        in text mode, replay trace X times faster than\n"));
+	printf("%s", _("                         it has been recorded; 0 for no pacing [default 0]\n"));
+	printf("%s", _("  -h, --help             print this message\n"));
+	printf("%s", _("  -v, --version          output version information and exit\n\n"));
+
+	exit(EXIT_SUCCESS);
+}
+
+
+
+
+/**
+   \brief Parse command line options
+
+   \param argc - main()'s argc
+   \param argv - main()'s argv
+   \param config - program's configuration variable
+*/
+void cwtrace_parse_command_line(int argc, char **argv, struct cwtrace_config *config)
+{
+	int option;
+	char *argument;
+
+	config->program_name = strdup(cw_program_basename(argv[0]));
+	if (!config->program_name) {
+		fprintf(stderr, "%s: failed to allocate memory\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	while (get_option(argc, argv, all_options,
+			  &option, &argument)) {
+
+		switch (option) {
+		case 'm':
+			if (!strcasecmp(argument, "csv")) {
+				config->mode = MODE_CSV;
+			} else if (!strcasecmp(argument, "binary")) {
+				config->mode = MODE_BINARY;
+			} else if (!strcasecmp(argument, "text")) {
+				config->mode = MODE_TEXT;
+			} else {
+				fprintf(stderr, _("%s: invalid mode: '%s'\n"), config->program_name, argument);
+				exit(EXIT_FAILURE);
+			}
+			break;
+
+		case 'x':
+			if (sscanf(argument, "%lf", &(config->speedup)) != 1
+			    || config->speedup < 0.0) {
+
+				fprintf(stderr, _("%s: invalid speedup value: '%s'\n"), config->program_name, argument);
+				exit(EXIT_FAILURE);
+			}
+			break;
+
+		case 'h':
+			cwtrace_print_help(config->program_name);
+			break;
+
+		case 'v':
+			printf(_("%s version %s\n%s\n"),
+			       config->program_name, PACKAGE_VERSION, _(CW_COPYRIGHT));
+			exit(EXIT_SUCCESS);
+
+		case '?':
+			cwtrace_print_usage(config->program_name);
+			exit(EXIT_FAILURE);
+
+		default:
+			fprintf(stderr, _("%s: getopts returned %c\n"), config->program_name, option);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (get_optind() == argc - 1) {
+		config->input_file = argv[argc - 1];
+	} else if (get_optind() != argc) {
+		cwtrace_print_usage(config->program_name);
+		exit(EXIT_FAILURE);
+	}
+
+	return;
+}
+
+
+
+
+/**
+   \brief Parse the command line options, then convert or replay the trace
+*/
+int main(int argc, char **argv)
+{
+	int combined_argc;
+	char **combined_argv;
+
+	/* Set locale and message catalogs. */
+	i18n_initialize();
+
+	/* Parse combined environment and command line arguments. */
+	combine_arguments(_("CWTRACE_OPTIONS"),
+			  argc, argv, &combined_argc, &combined_argv);
+	cwtrace_parse_command_line(combined_argc, combined_argv, &g_config);
+
+	FILE *input = stdin;
+	if (g_config.input_file) {
+		input = fopen(g_config.input_file, g_config.mode == MODE_BINARY ? "r" : "rb");
+		if (!input) {
+			fprintf(stderr, _("%s: can't open '%s': %s\n"), g_config.program_name, g_config.input_file, strerror(errno));
+			free(g_config.program_name);
+			return EXIT_FAILURE;
+		}
+	}
+
+	int rv;
+	switch (g_config.mode) {
+	case MODE_BINARY:
+		rv = cwtrace_from_csv(input, stdout);
+		break;
+	case MODE_TEXT:
+		rv = cwtrace_to_text(input, g_config.speedup);
+		break;
+	case MODE_CSV:
+	default:
+		rv = cwtrace_to_csv(input, stdout);
+		break;
+	}
+
+	if (EXIT_SUCCESS != rv && g_config.mode != MODE_BINARY) {
+		fprintf(stderr, _("%s: invalid trace\n"), g_config.program_name);
+	}
+
+	if (input != stdin) {
+		fclose(input);
+	}
+	free(g_config.program_name);
+
+	return rv;
+}
@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+ * Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+
+#if defined(HAVE_STRING_H)
+# include <string.h>
+#endif
+
+#if defined(HAVE_STRINGS_H)
+# include <strings.h>
+#endif
+
+#include "i18n.h"
+#include "cmdline.h"
+#include "cw_copyright.h"
+
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+
+#define BUFFER_SIZE  (1024 * 1024)   /* Size of chunks of input. */
+
+
+struct cwtranscode_config {
+	char *program_name;    /* Program's name (argv[0]) */
+
+	int direction;         /* CW_TRANSCODE_ENCODE or CW_TRANSCODE_DECODE. */
+	char *char_separator;  /* Separator of characters; NULL for default. */
+	char *word_separator;  /* Separator of words; NULL for default. */
+	char *input_file;      /* Name of input file; NULL for stdin. */
+} g_config = {
+	.program_name = (char *) NULL,
+
+	.direction      = CW_TRANSCODE_ENCODE,
+	.char_separator = (char *) NULL,
+	.word_separator = (char *) NULL,
+	.input_file     = (char *) NULL
+};
+
+
+static const char *all_options = "d|decode,c:|char-separator,w:|word-separator,h|help,v|version";
+
+static bool cwtranscode_transcode(cw_transcoder_t *tr, FILE *input, FILE *output);
+static void cwtranscode_print_usage(const char *program_name);
+static void cwtranscode_print_help(const char *program_name);
+static void cwtranscode_parse_command_line(int argc, char **argv, struct cwtranscode_config *config);
+
+
+
+
+/**
+   \brief Transcode whole input to output
+
+   \param tr - transcoder
+   \param input - input stream
+   \param output - output stream
+
+   \return true on success
+   \return false on I/O or memory allocation error
+*/
+bool cwtranscode_transcode(cw_transcoder_t *tr, FILE *input, FILE *output)
+{
+	char *in_buffer = (char *) malloc(BUFFER_SIZE);
+	char *out_buffer = (char *) malloc(cw_transcoder_get_max_output(tr, BUFFER_SIZE));
+	if (!in_buffer || !out_buffer) {
+		fprintf(stderr, _("%s: failed to allocate memory\n"), g_config.program_name);
+		free(in_buffer);
+		free(out_buffer);
+		return false;
+	}
+
+	bool success = true;
+	size_t n_read = 0;
+	while ((n_read = fread(in_buffer, 1, BUFFER_SIZE, input)) > 0) {
+		size_t n = cw_transcoder_process(tr, in_buffer, n_read, out_buffer);
+		if (fwrite(out_buffer, 1, n, output) != n) {
+			success = false;
+			break;
+		}
+	}
+
+	if (success && ferror(input)) {
+		fprintf(stderr, _("%s: failed to read input: %s\n"), g_config.program_name, strerror(errno));
+		free(in_buffer);
+		free(out_buffer);
+		return false;
+	}
+
+	if (success) {
+		size_t n = cw_transcoder_finish(tr, out_buffer);
+		success = fwrite(out_buffer, 1, n, output) == n && fflush(output) == 0;
+	}
+	if (!success) {
+		fprintf(stderr, _("%s: failed to write output: %s\n"), g_config.program_name, strerror(errno));
+	}
+
+	free(in_buffer);
+	free(out_buffer);
+
+	return success;
+}
+
+
+
+
+/**
+   \brief Print brief information about how to get help
+
+   \param program_name - program's name
+*/
+void cwtranscode_print_usage(const char *program_name)
+{
+	const char *format = has_longopts()
+		? _("Try '%s --help' for more information.\n")
+		: _("Try '%s -h' for more information.\n");
+
+	fprintf(stderr, format, program_name);
+	return;
+}
+
+
+
+
+/*
+  \brief Print out a brief page of help information
+
+  \param program_name - program's name
+*/
+static void cwtranscode_print_help(const char *program_name)
+{
+	if (!has_longopts()) {
+		fprintf(stderr, "%s", _("Long format of options is not supported on your system\n\n"));
+	}
+
+	printf(_("Usage: %s [options...] [FILE]\n\n"), program_name);
+
+	printf("%s", _("  Convert text from FILE (or standard input) to Dots and Dashes,\n"));
+	printf("%s", _("  or Dots and Dashes to text, and write it to standard output.\n\n"));
+	printf("%s", _("  -d, --decode               convert Dots and Dashes to text\n"));
+	printf(_("  -c, --char-separator=STR   separator of characters [default '%s']\n"), CW_TRANSCODE_CHAR_SEPARATOR_DEFAULT);
+	printf(_("  -w, --word-separator=STR   separator of words [default '%s']\n"), CW_TRANSCODE_WORD_SEPARATOR_DEFAULT);
+	printf("%s", _("  -h, --help                 print this message\n"));
+	printf("%s", _("  -v, --version              output version information and exit\n\n"));
+
+	exit(EXIT_SUCCESS);
+}
+
+
+
+
+/**
+   \brief Parse command line options
+
+   \param argc - main()'s argc
+   \param argv - main()'s argv
+   \param config - program's configuration variable
+*/
+void cwtranscode_parse_command_line(int argc, char **argv, struct cwtranscode_config *config)
+{
+	int option;
+	char *argument;
+
+	config->program_name = strdup(cw_program_basename(argv[0]));
+	if (!config->program_name) {
+		fprintf(stderr, "%s: failed to allocate memory\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	while (get_option(argc, argv, all_options,
+			  &option, &argument)) {
+
+		switch (option) {
+		case 'd':
+			config->direction = CW_TRANSCODE_DECODE;
+			break;
+
+		case 'c':
+			config->char_separator = argument;
+			break;
+
+		case 'w':
+			config->word_separator = argument;
+			break;
+
+		case 'h':
+			cwtranscode_print_help(config->program_name);
+			break;
+
+		case 'v':
+			printf(_("%s version %s\n%s\n"),
+			       config->program_name, PACKAGE_VERSION, _(CW_COPYRIGHT));
+			exit(EXIT_SUCCESS);
+
+		case '?':
+			cwtranscode_print_usage(config->program_name);
+			exit(EXIT_FAILURE);
+
+		default:
+			fprintf(stderr, _("%s: getopts returned %c\n"), config->program_name, option);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (get_optind() == argc - 1) {
+		config->input_file = argv[argc - 1];
+	} else if (get_optind() != argc) {
+		cwtranscode_print_usage(config->program_name);
+		exit(EXIT_FAILURE);
+	}
+
+	return;
+}
+
+
+
+
+/**
+   \brief Parse the command line options, then transcode the input
+*/
+int main(int argc, char **argv)
+{
+	int combined_argc;
+	char **combined_argv;
+
+	/* Set locale and message catalogs. */
+	i18n_initialize();
+
+	/* Parse combined environment and command line arguments. */
+	combine_arguments(_("CWTRANSCODE_OPTIONS"),
+			  argc, argv, &combined_argc, &combined_argv);
+	cwtranscode_parse_command_line(combined_argc, combined_argv, &g_config);
+
+	cw_transcoder_t *tr = cw_transcoder_new(g_config.direction, g_config.char_separator, g_config.word_separator);
+	if (!tr) {
+		if (errno == EINVAL) {
+			fprintf(stderr, _("%s: invalid separators\n"), g_config.program_name);
+		} else {
+			fprintf(stderr, _("%s: failed to allocate memory\n"), g_config.program_name);
+		}
+		free(g_config.program_name);
+		return EXIT_FAILURE;
+	}
+
+	FILE *input = stdin;
+	if (g_config.input_file) {
+		input = fopen(g_config.input_file, "rb");
+		if (!input) {
+			fprintf(stderr, _("%s: can't open '%s': %s\n"), g_config.program_name, g_config.input_file, strerror(errno));
+			cw_transcoder_delete(&tr);
+			free(g_config.program_name);
+			return EXIT_FAILURE;
+		}
+	}
+
+	int rv = EXIT_FAILURE;
+	if (cwtranscode_transcode(tr, input, stdout)) {
+		int64_t n_errors = 0;
+		cw_transcoder_get_counts(tr, NULL, &n_errors);
+		if (n_errors) {
+			fprintf(stderr, _("%s: skipped %lld characters that can't be converted\n"), g_config.program_name, (long long) n_errors);
+		}
+		rv = EXIT_SUCCESS;
+	}
+
+	cw_transcoder_delete(&tr);
+	if (input != stdin) {
+		fclose(input);
+	}
+	free(g_config.program_name);
+
+	return rv;
+}
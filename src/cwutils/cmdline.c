@@ -357,6 +357,7 @@ void cw_print_help(cw_config_t *config)
 		fprintf(stderr, "%s", _("  -c, --nocommands       disable executing embedded commands\n"));
 		fprintf(stderr, "%s", _("  -o, --nocombinations   disallow [...] combinations\n"));
 		fprintf(stderr, "%s", _("  -p, --nocomments       disallow {...} comments\n"));
+		fprintf(stderr, "%s", _("  -l, --timeline         print keying timeline instead of sounding\n"));
 	}
 	if (config->has_practice_time) {
 		fprintf(stderr, "%s", _("  -T, --time=TIME        set initial practice time (in minutes)\n"));
@@ -570,6 +571,10 @@ int cw_process_option(int opt, const char *optarg, cw_config_t *config)
 		config->do_comments = false;
 		break;
 
+        case 'l':
+		config->do_timeline = true;
+		break;
+
 	case 'h':
 		cw_print_help(config);
 		exit(EXIT_SUCCESS);
@@ -100,6 +100,7 @@ cw_config_t *cw_config_new(const char *program_name)
 	config->do_commands = true;
 	config->do_combinations = true;
 	config->do_comments = true;
+	config->do_timeline = false;
 
 	return config;
 }
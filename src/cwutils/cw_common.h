@@ -67,6 +67,7 @@ typedef struct {
 	int do_commands;       /* Execute embedded commands */
 	int do_combinations;   /* Execute [...] combinations */
 	int do_comments;       /* Allow {...} as comments */
+	int do_timeline;       /* Print keying timeline instead of sounding characters */
 } cw_config_t;
 
 
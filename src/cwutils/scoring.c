@@ -0,0 +1,1187 @@
+/*
+ * Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+ * Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include <ctype.h>
+
+#if defined(HAVE_STRING_H)
+# include <string.h>
+#endif
+
+#if defined(HAVE_STRINGS_H)
+# include <strings.h>
+#endif
+
+#include "scoring.h"
+#include "memory.h"
+
+
+/**
+   Scoring of copy practice
+
+   In copy practice a program sends text (e.g. random groups from a
+   dictionary), and user types what they hear. The module compares
+   the two texts and tells how many characters were copied correctly,
+   how many were copied as other characters, and how many were
+   missed or added. For every pair of (sent, received) characters it
+   counts how many times one was copied as the other (confusion
+   matrix).
+
+   Sent text and copy are aligned with edit distance (Levenshtein
+   distance). The distance is calculated with bit-parallel algorithm
+   of Myers, in variant for global alignment with blocks of 64 rows
+   by Hyyrö. Only cells in a band around main diagonal are calculated
+   (Ukkonen's cut-off), so calculation of one column takes one or two
+   machine words, regardless of length of copy. Bit vectors of every
+   column are kept, so that alignment can be traced back from the
+   last cell.
+
+   Sent text is usually ahead of copy: user types what they have heard
+   already. End of sent text is therefore free: characters sent
+   after last character aligned with copy are "pending", not missed.
+
+   Alignment is calculated lazily, when a result is requested. To
+   keep cost of this calculation constant during a long session,
+   alignment of characters that are more than CW_SCORE_COMMIT_LAG
+   characters behind end of copy is treated as final: its counts are
+   moved to committed statistics, and the characters are removed
+   from working buffers.
+*/
+
+
+/* Count of rows of distance matrix in one block. */
+#define CW_SCORE_BLOCK_ROWS  64
+
+/* Copy longer than this is aligned in parts. */
+#define CW_SCORE_ALIGN_PART_LEN  (4 * CW_SCORE_COMMIT_LAG)
+
+/* Distance in cells outside of band. */
+#define CW_SCORE_DISTANCE_MAX  (INT_MAX / 2)
+
+
+typedef struct {
+	uint64_t pv;  /* Bits of rows where distance grows by one from previous row. */
+	uint64_t mv;  /* Bits of rows where distance drops by one from previous row. */
+	int bottom;   /* Distance in last row of block. */
+} cw_score_block_t;
+
+/* Blocks of band stored for one column of distance matrix. */
+typedef struct {
+	int first;   /* Index of first block in the band. */
+	int last;    /* Index of last block in the band. */
+	int offset;  /* Position of first block in array of stored blocks. */
+} cw_score_column_t;
+
+/* One step of alignment. */
+typedef struct {
+	char sent;      /* '\0' for character of copy that wasn't sent. */
+	char received;  /* '\0' for sent character missing in copy. */
+} cw_score_step_t;
+
+struct cw_score_s {
+	int band;
+
+	/* Not committed parts of sent text and of copy. */
+	char *sent;
+	int sent_len;
+	int sent_capacity;
+	char *received;
+	int received_len;
+	int received_capacity;
+
+	/* Last characters added, used to squeeze runs of spaces. */
+	char sent_last;
+	char received_committed_last;
+
+	cw_score_result_t committed;
+
+	/* Alignment of not committed parts. Valid when is_aligned is
+	   true. */
+	bool is_aligned;
+	cw_score_step_t *steps;
+	int n_steps;
+	int steps_capacity;
+	cw_score_result_t current;
+
+	/* Counts of committed steps plus counts of steps of current
+	   alignment. */
+	unsigned int confusion[CW_SCORE_N_CHARACTERS][CW_SCORE_N_CHARACTERS];
+
+	/* Work memory of alignment. */
+	uint64_t *peq;
+	int peq_capacity;
+	cw_score_block_t *work;
+	int work_capacity;
+	cw_score_block_t *blocks;
+	int blocks_capacity;
+	cw_score_column_t *columns;
+	int columns_capacity;
+};
+
+
+static void *cw_score_reserve(void *buffer, int *capacity, int needed, size_t element_size);
+static char cw_score_normalize(char c);
+static void cw_score_append(char **buffer, int *len, int *capacity, char *last, const char *text);
+static void cw_score_count_step(cw_score_result_t *result, const cw_score_step_t *step, int sign);
+static int  cw_score_advance_block(cw_score_block_t *block, uint64_t eq, int hin);
+static int  cw_score_distance(const cw_score_t *score, int i, int j);
+static void cw_score_calculate_columns(cw_score_t *score, int m, int k, int n_columns);
+static void cw_score_trace_back(cw_score_t *score, int m, int j);
+static void cw_score_commit(cw_score_t *score, int m);
+static void cw_score_align_part(cw_score_t *score, int m);
+static void cw_score_align(cw_score_t *score);
+
+
+
+
+
+/**
+   \brief Create new scoring object
+
+   \p band is count of characters by which copy can be shifted
+   against sent text (because of missed or added characters) in any
+   part of session. Pass zero to use CW_SCORE_BAND_DEFAULT.
+
+   \param band - width of band of alignment
+
+   \return new scoring object
+*/
+cw_score_t *cw_score_new(int band)
+{
+	cw_score_t *score = safe_malloc(sizeof (cw_score_t));
+	memset(score, 0, sizeof (cw_score_t));
+
+	score->band = band > 0 ? band : CW_SCORE_BAND_DEFAULT;
+	cw_score_reset(score);
+
+	return score;
+}
+
+
+
+
+
+/**
+   \brief Delete scoring object
+
+   \param score - pointer to scoring object to delete; the object is set to NULL
+*/
+void cw_score_delete(cw_score_t **score)
+{
+	if (!score || !*score) {
+		return;
+	}
+
+	free((*score)->sent);
+	free((*score)->received);
+	free((*score)->steps);
+	free((*score)->peq);
+	free((*score)->work);
+	free((*score)->blocks);
+	free((*score)->columns);
+
+	free(*score);
+	*score = NULL;
+
+	return;
+}
+
+
+
+
+
+/**
+   \brief Forget sent text and copy, start new session
+
+   \param score - scoring object
+*/
+void cw_score_reset(cw_score_t *score)
+{
+	score->sent_len = 0;
+	score->received_len = 0;
+
+	/* Spaces at the beginning are skipped. */
+	score->sent_last = ' ';
+	score->received_committed_last = ' ';
+
+	memset(&score->committed, 0, sizeof (score->committed));
+	memset(&score->current, 0, sizeof (score->current));
+	memset(score->confusion, 0, sizeof (score->confusion));
+	score->n_steps = 0;
+	score->is_aligned = true;
+
+	return;
+}
+
+
+
+
+
+/**
+   \brief Add text sent to user
+
+   Letters are converted to upper case. Runs of white space are
+   treated as single space. Characters that aren't printable 7-bit
+   ASCII are ignored.
+
+   \param score - scoring object
+   \param text - text that has been sent
+*/
+void cw_score_add_sent(cw_score_t *score, const char *text)
+{
+	cw_score_append(&score->sent, &score->sent_len, &score->sent_capacity, &score->sent_last, text);
+	score->is_aligned = false;
+
+	return;
+}
+
+
+
+
+
+/**
+   \brief Add text copied by user
+
+   Text is normalized in the same way as in cw_score_add_sent().
+
+   \param score - scoring object
+   \param text - text that has been typed
+*/
+void cw_score_add_received(cw_score_t *score, const char *text)
+{
+	char last = score->received_len > 0 ? score->received[score->received_len - 1] : score->received_committed_last;
+	cw_score_append(&score->received, &score->received_len, &score->received_capacity, &last, text);
+	score->is_aligned = false;
+
+	return;
+}
+
+
+
+
+
+/**
+   \brief Remove last character of copy
+
+   Use the function when user deletes last typed character. Only
+   characters whose alignment hasn't been committed yet can be
+   removed.
+
+   \param score - scoring object
+
+   \return true if a character was removed
+   \return false otherwise
+*/
+bool cw_score_delete_received(cw_score_t *score)
+{
+	if (score->received_len == 0) {
+		return false;
+	}
+
+	score->received_len--;
+	score->is_aligned = false;
+
+	return true;
+}
+
+
+
+
+
+/**
+   \brief Get counts of correct and incorrect characters
+
+   \param score - scoring object
+   \param result - result of scoring (output)
+*/
+void cw_score_get_result(cw_score_t *score, cw_score_result_t *result)
+{
+	cw_score_align(score);
+
+	result->n_sent = score->committed.n_sent + score->current.n_sent;
+	result->n_received = score->committed.n_received + score->current.n_received;
+	result->n_correct = score->committed.n_correct + score->current.n_correct;
+	result->n_substitutions = score->committed.n_substitutions + score->current.n_substitutions;
+	result->n_deletions = score->committed.n_deletions + score->current.n_deletions;
+	result->n_insertions = score->committed.n_insertions + score->current.n_insertions;
+	result->n_pending = score->current.n_pending;
+
+	return;
+}
+
+
+
+
+
+/**
+   \brief Get count of times a sent character was copied as another one
+
+   Pass '\0' as \p received to get count of times when \p sent was
+   missed in copy. Pass '\0' as \p sent to get count of times when \p
+   received was typed but not sent.
+
+   \param score - scoring object
+   \param sent - sent character
+   \param received - character in copy
+
+   \return count of times when \p sent was copied as \p received
+*/
+unsigned int cw_score_get_confusion(cw_score_t *score, char sent, char received)
+{
+	cw_score_align(score);
+
+	const char s = sent == '\0' ? '\0' : cw_score_normalize(sent);
+	const char r = received == '\0' ? '\0' : cw_score_normalize(received);
+	if (s == -1 || r == -1) {
+		return 0;
+	}
+
+	return score->confusion[(int) s][(int) r];
+}
+
+
+
+
+
+/**
+   \brief Get percentage of correctly copied characters
+
+   Every missed, added or mis-copied character lowers the accuracy.
+   Pending characters are not taken into account.
+
+   \param score - scoring object
+
+   \return accuracy of copy, in percents (0 if nothing was copied yet)
+*/
+int cw_score_get_accuracy(cw_score_t *score)
+{
+	cw_score_result_t result;
+	cw_score_get_result(score, &result);
+
+	const int total = result.n_sent + result.n_insertions;
+	if (total == 0) {
+		return 0;
+	}
+
+	return (100 * result.n_correct) / total;
+}
+
+
+
+
+
+/*
+ * cw_score_reserve()
+ *
+ * Make sure that buffer has space for at least 'needed' elements,
+ * and return the (possibly moved) buffer.
+ */
+void *cw_score_reserve(void *buffer, int *capacity, int needed, size_t element_size)
+{
+	if (needed <= *capacity) {
+		return buffer;
+	}
+
+	int new_capacity = *capacity > 0 ? *capacity : 64;
+	while (new_capacity < needed) {
+		new_capacity *= 2;
+	}
+	*capacity = new_capacity;
+
+	return safe_realloc(buffer, (size_t) new_capacity * element_size);
+}
+
+
+
+
+
+/*
+ * cw_score_normalize()
+ *
+ * Return upper case form of character, space for any white space,
+ * or -1 for characters that are not scored.
+ */
+char cw_score_normalize(char c)
+{
+	if (isspace((unsigned char) c)) {
+		return ' ';
+	}
+	if (c <= ' ' || c >= CW_SCORE_N_CHARACTERS - 1) {
+		return -1;
+	}
+
+	return (char) toupper((unsigned char) c);
+}
+
+
+
+
+
+/*
+ * cw_score_append()
+ *
+ * Append normalized text to buffer.
+ */
+void cw_score_append(char **buffer, int *len, int *capacity, char *last, const char *text)
+{
+	for (int i = 0; text[i] != '\0'; i++) {
+		const char c = cw_score_normalize(text[i]);
+		if (c == -1 || (c == ' ' && *last == ' ')) {
+			continue;
+		}
+
+		*buffer = cw_score_reserve(*buffer, capacity, *len + 1, sizeof (char));
+		(*buffer)[(*len)++] = c;
+		*last = c;
+	}
+
+	return;
+}
+
+
+
+
+
+/*
+ * cw_score_count_step()
+ *
+ * Add (sign == 1) or subtract (sign == -1) step of alignment to/from
+ * result.
+ */
+void cw_score_count_step(cw_score_result_t *result, const cw_score_step_t *step, int sign)
+{
+	if (step->sent == '\0') {
+		result->n_insertions += sign;
+		result->n_received += sign;
+	} else if (step->received == '\0') {
+		result->n_deletions += sign;
+		result->n_sent += sign;
+	} else {
+		if (step->sent == step->received) {
+			result->n_correct += sign;
+		} else {
+			result->n_substitutions += sign;
+		}
+		result->n_sent += sign;
+		result->n_received += sign;
+	}
+
+	return;
+}
+
+
+
+
+
+/*
+ * cw_score_advance_block()
+ *
+ * Calculate next column of one block of distance matrix. 'eq' has
+ * bits set for rows of block equal to character of the column, 'hin'
+ * is difference between distances in last row of block above, in
+ * this and in previous column. Return the same difference for last
+ * row of this block. Distance in last row is updated by caller.
+ */
+int cw_score_advance_block(cw_score_block_t *block, uint64_t eq, int hin)
+{
+	const uint64_t hin_is_negative = hin < 0 ? 1 : 0;
+	const uint64_t pv = block->pv;
+	const uint64_t mv = block->mv;
+
+	const uint64_t xv = eq | mv;
+	eq |= hin_is_negative;
+	const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+
+	uint64_t ph = mv | ~(xh | pv);
+	uint64_t mh = pv & xh;
+
+	const int hout = (int) (ph >> (CW_SCORE_BLOCK_ROWS - 1)) - (int) (mh >> (CW_SCORE_BLOCK_ROWS - 1));
+
+	ph <<= 1;
+	mh <<= 1;
+	mh |= hin_is_negative;
+	ph |= hin > 0 ? 1 : 0;
+
+	block->pv = mh | ~(xv | ph);
+	block->mv = ph & xv;
+
+	return hout;
+}
+
+
+
+
+
+/*
+ * cw_score_distance()
+ *
+ * Get distance between first 'i' characters of copy and first 'j'
+ * characters of sent text, using blocks stored by
+ * cw_score_calculate_columns().
+ */
+int cw_score_distance(const cw_score_t *score, int i, int j)
+{
+	if (i == 0) {
+		return j;
+	}
+	if (j == 0) {
+		return i;
+	}
+
+	const cw_score_column_t *column = &score->columns[j];
+	const int b = (i - 1) / CW_SCORE_BLOCK_ROWS;
+	if (b < column->first || b > column->last) {
+		return CW_SCORE_DISTANCE_MAX;
+	}
+
+	const cw_score_block_t *block = &score->blocks[column->offset + b - column->first];
+	const int bit = (i - 1) % CW_SCORE_BLOCK_ROWS;
+	if (bit == CW_SCORE_BLOCK_ROWS - 1) {
+		return block->bottom;
+	}
+
+	/* Walk up from last row of the block. */
+	const uint64_t below = ~(uint64_t) 0 << (bit + 1);
+	return block->bottom
+		- __builtin_popcountll(block->pv & below)
+		+ __builtin_popcountll(block->mv & below);
+}
+
+
+
+
+
+/*
+ * cw_score_calculate_columns()
+ *
+ * Calculate columns 0 to 'n_columns' of distance matrix of first 'm'
+ * characters of copy (rows) and sent text (columns), in band of 'k'
+ * diagonals on each side of main diagonal.
+ */
+void cw_score_calculate_columns(cw_score_t *score, int m, int k, int n_columns)
+{
+	const int n_blocks = (m + CW_SCORE_BLOCK_ROWS - 1) / CW_SCORE_BLOCK_ROWS;
+
+	/* Bit masks of rows with given character. */
+	score->peq = cw_score_reserve(score->peq, &score->peq_capacity, CW_SCORE_N_CHARACTERS * n_blocks, sizeof (uint64_t));
+	memset(score->peq, 0, sizeof (uint64_t) * CW_SCORE_N_CHARACTERS * n_blocks);
+	for (int i = 0; i < m; i++) {
+		score->peq[score->received[i] * n_blocks + i / CW_SCORE_BLOCK_ROWS] |= (uint64_t) 1 << (i % CW_SCORE_BLOCK_ROWS);
+	}
+
+	/* A column of band spans at most this many blocks. */
+	int blocks_per_column = (2 * k) / CW_SCORE_BLOCK_ROWS + 2;
+	if (blocks_per_column > n_blocks) {
+		blocks_per_column = n_blocks;
+	}
+	score->work = cw_score_reserve(score->work, &score->work_capacity, n_blocks, sizeof (cw_score_block_t));
+	score->blocks = cw_score_reserve(score->blocks, &score->blocks_capacity, (n_columns + 1) * blocks_per_column, sizeof (cw_score_block_t));
+	score->columns = cw_score_reserve(score->columns, &score->columns_capacity, n_columns + 1, sizeof (cw_score_column_t));
+
+	/* Column zero: distance in row 'i' is 'i'. */
+	int first = 0;
+	int last = ((m < k ? m : k) - 1) / CW_SCORE_BLOCK_ROWS;
+	for (int b = first; b <= last; b++) {
+		score->work[b].pv = ~(uint64_t) 0;
+		score->work[b].mv = 0;
+		score->work[b].bottom = (b + 1) * CW_SCORE_BLOCK_ROWS;
+	}
+
+	int offset = 0;
+	for (int j = 0; j <= n_columns; j++) {
+		if (j > 0) {
+			const int lo = j - k > 1 ? j - k : 1;
+			const int hi = j + k < m ? j + k : m;
+			first = (lo - 1) / CW_SCORE_BLOCK_ROWS;
+
+			const uint64_t *eq = score->peq + score->sent[j - 1] * n_blocks;
+
+			/* Top row: distance grows by one in every column. */
+			int h = 1;
+			for (int b = first; b <= last; b++) {
+				h = cw_score_advance_block(&score->work[b], eq[b], h);
+				score->work[b].bottom += h;
+			}
+
+			if ((hi - 1) / CW_SCORE_BLOCK_ROWS > last) {
+				/* Band enters new block. Previous column of
+				   the block is outside of band; assume that
+				   distance there grows by one in every row. */
+				last++;
+				const int bottom = score->work[last - 1].bottom - h + CW_SCORE_BLOCK_ROWS;
+				score->work[last].pv = ~(uint64_t) 0;
+				score->work[last].mv = 0;
+				h = cw_score_advance_block(&score->work[last], eq[last], h);
+				score->work[last].bottom = bottom + h;
+			}
+		}
+
+		score->columns[j].first = first;
+		score->columns[j].last = last;
+		score->columns[j].offset = offset;
+		memcpy(&score->blocks[offset], &score->work[first], sizeof (cw_score_block_t) * (last - first + 1));
+		offset += last - first + 1;
+	}
+
+	return;
+}
+
+
+
+
+
+/*
+ * cw_score_trace_back()
+ *
+ * Build steps of alignment of first 'm' characters of copy with
+ * first 'j' characters of sent text.
+ */
+void cw_score_trace_back(cw_score_t *score, int m, int j)
+{
+	int i = m;
+
+	score->steps = cw_score_reserve(score->steps, &score->steps_capacity, i + j, sizeof (cw_score_step_t));
+	score->n_steps = 0;
+
+	while (i > 0 || j > 0) {
+		cw_score_step_t *step = &score->steps[score->n_steps++];
+
+		if (i == 0) {
+			step->sent = score->sent[--j];
+			step->received = '\0';
+			continue;
+		}
+		if (j == 0) {
+			step->sent = '\0';
+			step->received = score->received[--i];
+			continue;
+		}
+
+		const int d = cw_score_distance(score, i, j);
+		const int cost = score->received[i - 1] == score->sent[j - 1] ? 0 : 1;
+
+		if (cw_score_distance(score, i - 1, j - 1) + cost == d) {
+			step->sent = score->sent[--j];
+			step->received = score->received[--i];
+		} else if (cw_score_distance(score, i - 1, j) + 1 == d) {
+			step->sent = '\0';
+			step->received = score->received[--i];
+		} else if (cw_score_distance(score, i, j - 1) + 1 == d) {
+			step->sent = score->sent[--j];
+			step->received = '\0';
+		} else {
+			/* Only possible at edge of band. */
+			step->sent = score->sent[--j];
+			step->received = score->received[--i];
+		}
+	}
+
+	/* Steps have been found from the end. */
+	for (int a = 0, b = score->n_steps - 1; a < b; a++, b--) {
+		const cw_score_step_t tmp = score->steps[a];
+		score->steps[a] = score->steps[b];
+		score->steps[b] = tmp;
+	}
+
+	return;
+}
+
+
+
+
+
+/*
+ * cw_score_commit()
+ *
+ * Move steps of current alignment of first 'm' characters of copy
+ * that end at least CW_SCORE_COMMIT_LAG characters before 'm' to
+ * committed statistics.
+ */
+void cw_score_commit(cw_score_t *score, int m)
+{
+	const int limit = m - CW_SCORE_COMMIT_LAG;
+	if (limit <= 0) {
+		return;
+	}
+
+	int n_steps = 0;
+	int i = 0;
+	int j = 0;
+	while (n_steps < score->n_steps) {
+		const cw_score_step_t *step = &score->steps[n_steps];
+		if (step->received != '\0' && i == limit) {
+			break;
+		}
+		i += step->received != '\0' ? 1 : 0;
+		j += step->sent != '\0' ? 1 : 0;
+
+		cw_score_count_step(&score->committed, step, 1);
+		cw_score_count_step(&score->current, step, -1);
+		n_steps++;
+	}
+
+	score->n_steps -= n_steps;
+	memmove(score->steps, score->steps + n_steps, sizeof (cw_score_step_t) * score->n_steps);
+
+	if (i > 0) {
+		score->received_committed_last = score->received[i - 1];
+	}
+	score->received_len -= i;
+	memmove(score->received, score->received + i, score->received_len);
+	score->sent_len -= j;
+	memmove(score->sent, score->sent + j, score->sent_len);
+
+	return;
+}
+
+
+
+
+
+/*
+ * cw_score_align_part()
+ *
+ * Align first 'm' characters of not committed part of copy with not
+ * committed part of sent text, and commit beginning of the
+ * alignment.
+ */
+void cw_score_align_part(cw_score_t *score, int m)
+{
+	/* Forget previous alignment. */
+	for (int s = 0; s < score->n_steps; s++) {
+		score->confusion[(int) score->steps[s].sent][(int) score->steps[s].received]--;
+	}
+	memset(&score->current, 0, sizeof (score->current));
+	score->n_steps = 0;
+
+	const int n = score->sent_len;
+	int j_end = 0;
+
+	if (m > 0 && n > 0) {
+		/* Copy longer than sent text must still reach last row. */
+		const int k = m - n > score->band ? m - n : score->band;
+		/* Columns beyond band can't be end of alignment. */
+		const int n_columns = n < m + k ? n : m + k;
+
+		cw_score_calculate_columns(score, m, k, n_columns);
+
+		/* Sent characters after the best match of copy are
+		   pending. On ties prefer longer alignment. */
+		int best = CW_SCORE_DISTANCE_MAX;
+		for (int j = (m - k > 0 ? m - k : 0); j <= n_columns; j++) {
+			const int d = cw_score_distance(score, m, j);
+			if (d <= best) {
+				best = d;
+				j_end = j;
+			}
+		}
+	}
+
+	cw_score_trace_back(score, m, j_end);
+	for (int s = 0; s < score->n_steps; s++) {
+		cw_score_count_step(&score->current, &score->steps[s], 1);
+		score->confusion[(int) score->steps[s].sent][(int) score->steps[s].received]++;
+	}
+	score->current.n_pending = n - j_end;
+
+	cw_score_commit(score, m);
+
+	return;
+}
+
+
+
+
+
+/*
+ * cw_score_align()
+ *
+ * Align not committed parts of copy and of sent text, if they have
+ * changed since last alignment.
+ */
+void cw_score_align(cw_score_t *score)
+{
+	if (score->is_aligned) {
+		return;
+	}
+	score->is_aligned = true;
+
+	/* Band is placed around main diagonal, so it can't follow
+	   drift of long copy against sent text. Align long copy in
+	   parts, each part starting where committed alignment of
+	   previous one ends. */
+	while (score->received_len > CW_SCORE_ALIGN_PART_LEN) {
+		cw_score_align_part(score, CW_SCORE_ALIGN_PART_LEN);
+	}
+	cw_score_align_part(score, score->received_len);
+
+	return;
+}
+
+
+
+
+
+#ifdef CW_SCORING_UNIT_TESTS
+
+
+#include <time.h>
+
+
+static unsigned int test_cw_score_simple(void);
+static unsigned int test_cw_score_reference(void);
+static unsigned int test_cw_score_long_session(void);
+
+static int test_cw_score_reference_distance(const char *sent, const char *received);
+static void test_cw_score_mutate(const char *in, char *out, int percent);
+
+
+typedef unsigned int (*cw_score_test_function_t)(void);
+
+static cw_score_test_function_t cw_score_unit_tests[] = {
+	test_cw_score_simple,
+	test_cw_score_reference,
+	test_cw_score_long_session,
+	NULL
+};
+
+
+static unsigned int n_failures = 0;
+
+#define test_expect(expr)						\
+	do {								\
+		if (!(expr)) {						\
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr); \
+			n_failures++;					\
+		}							\
+	} while (0)
+
+
+
+int main(void)
+{
+	fprintf(stderr, "unit tests for \"scoring\" functions\n\n");
+
+	int i = 0;
+	while (cw_score_unit_tests[i]) {
+		cw_score_unit_tests[i]();
+		i++;
+	}
+
+	if (n_failures) {
+		fprintf(stdout, "\nscoring: test result: failure (%u)\n\n", n_failures);
+		return 1;
+	}
+
+	/* "make check" facility requires this message to be
+	   printed on stdout; don't localize it */
+	fprintf(stdout, "\nscoring: test result: success\n\n");
+
+	return 0;
+}
+
+
+
+
+
+unsigned int test_cw_score_simple(void)
+{
+	fprintf(stderr, "scoring: simple alignments\n");
+
+	cw_score_t *score = cw_score_new(0);
+	cw_score_result_t result;
+
+	/* Nothing copied yet. */
+	cw_score_add_sent(score, "paris  paris");
+	cw_score_get_result(score, &result);
+	test_expect(result.n_sent == 0);
+	test_expect(result.n_pending == 11);
+	test_expect(cw_score_get_accuracy(score) == 0);
+
+	/* Partial copy: rest of sent text is pending. */
+	cw_score_add_received(score, "PAR");
+	cw_score_get_result(score, &result);
+	test_expect(result.n_sent == 3);
+	test_expect(result.n_correct == 3);
+	test_expect(result.n_pending == 8);
+
+	/* One character copied as another one. */
+	cw_score_add_received(score, "IS PX");
+	cw_score_get_result(score, &result);
+	test_expect(result.n_correct == 7);
+	test_expect(result.n_substitutions == 1);
+	test_expect(result.n_pending == 3);
+	test_expect(cw_score_get_confusion(score, 'A', 'x') == 1);
+
+	/* User corrects the mistake. */
+	test_expect(cw_score_delete_received(score));
+	cw_score_add_received(score, "ARIS");
+	cw_score_get_result(score, &result);
+	test_expect(result.n_correct == 11);
+	test_expect(result.n_substitutions == 0);
+	test_expect(result.n_pending == 0);
+	test_expect(cw_score_get_confusion(score, 'A', 'X') == 0);
+	test_expect(cw_score_get_confusion(score, 'A', 'A') == 2);
+	test_expect(cw_score_get_accuracy(score) == 100);
+
+	/* Missed and added characters. */
+	cw_score_reset(score);
+	cw_score_add_sent(score, "QRM QSB QTH");
+	cw_score_add_received(score, "QM QSBB QTH");
+	cw_score_get_result(score, &result);
+	test_expect(result.n_deletions == 1);
+	test_expect(result.n_insertions == 1);
+	test_expect(result.n_correct == 10);
+	test_expect(cw_score_get_confusion(score, 'R', '\0') == 1);
+	test_expect(cw_score_get_confusion(score, '\0', 'B') == 1);
+
+	cw_score_delete(&score);
+	test_expect(score == NULL);
+
+	return 0;
+}
+
+
+
+
+
+unsigned int test_cw_score_reference(void)
+{
+	fprintf(stderr, "scoring: comparison with reference algorithm\n");
+
+	srand(1);
+
+	enum { LEN_MAX = 400 };
+	char sent[LEN_MAX + 1];
+	char received[2 * LEN_MAX + 1];
+
+	for (int t = 0; t < 300; t++) {
+		const int len = 1 + rand() % LEN_MAX;
+		for (int i = 0; i < len; i++) {
+			sent[i] = rand() % 6 == 0 ? ' ' : 'A' + rand() % 26;
+			/* No runs of spaces, no leading space. */
+			if (sent[i] == ' ' && (i == 0 || sent[i - 1] == ' ')) {
+				sent[i] = 'E';
+			}
+		}
+		sent[len] = '\0';
+		test_cw_score_mutate(sent, received, 1 + t % 8);
+
+		/* Whole texts at once. */
+		cw_score_t *score = cw_score_new(0);
+		cw_score_add_sent(score, sent);
+		cw_score_add_received(score, received);
+		cw_score_result_t result;
+		cw_score_get_result(score, &result);
+
+		const int distance = result.n_substitutions + result.n_deletions + result.n_insertions;
+		const int expected = test_cw_score_reference_distance(sent, received);
+		test_expect(distance == expected);
+		test_expect(result.n_sent + result.n_pending == (int) strlen(sent));
+		test_expect(result.n_received == (int) strlen(received));
+		test_expect(result.n_correct + result.n_substitutions + result.n_deletions == result.n_sent);
+
+		/* Copy typed character by character, scored after
+		   every character. Committed part of alignment may
+		   be slightly worse than optimal one. */
+		cw_score_reset(score);
+		cw_score_add_sent(score, sent);
+		for (int i = 0; received[i] != '\0'; i++) {
+			const char c[2] = { received[i], '\0' };
+			cw_score_add_received(score, c);
+			cw_score_get_result(score, &result);
+		}
+		const int incremental = result.n_substitutions + result.n_deletions + result.n_insertions;
+		test_expect(incremental >= expected && incremental <= expected + 2);
+		test_expect(result.n_received == (int) strlen(received));
+
+		cw_score_delete(&score);
+	}
+
+	return 0;
+}
+
+
+
+
+
+unsigned int test_cw_score_long_session(void)
+{
+	/* About 55 hours of sending at 20 WPM. */
+	enum { N_GROUPS = 66000 };
+
+	cw_score_t *score = cw_score_new(0);
+	/* The same session, scored only at the end. */
+	cw_score_t *whole = cw_score_new(0);
+
+	srand(2);
+	char group[7];
+	char copy[14];
+	int n_errors = 0;
+
+	const clock_t begin = clock();
+	for (int g = 0; g < N_GROUPS; g++) {
+		for (int i = 0; i < 5; i++) {
+			group[i] = 'A' + rand() % 26;
+		}
+		group[5] = ' ';
+		group[6] = '\0';
+		cw_score_add_sent(score, group);
+		cw_score_add_sent(whole, group);
+
+		/* Few groups are copied with errors. */
+		if (g % 10 == 0) {
+			test_cw_score_mutate(group, copy, 30);
+			n_errors += test_cw_score_reference_distance(group, copy);
+		} else {
+			strcpy(copy, group);
+		}
+
+		/* Score after every typed character. */
+		for (int i = 0; copy[i] != '\0'; i++) {
+			const char c[2] = { copy[i], '\0' };
+			cw_score_add_received(score, c);
+			cw_score_get_accuracy(score);
+		}
+		cw_score_add_received(whole, copy);
+	}
+	const double seconds = (double) (clock() - begin) / CLOCKS_PER_SEC;
+
+	cw_score_result_t result;
+	cw_score_get_result(score, &result);
+	const int distance = result.n_substitutions + result.n_deletions + result.n_insertions;
+
+	fprintf(stderr, "scoring: long session: %d characters, %d/%d errors, scored in %.2f s\n",
+		result.n_sent + result.n_pending, distance, n_errors, seconds);
+
+	/* Errors in neighbouring groups may merge into cheaper
+	   edits, committed alignment may be slightly worse than
+	   optimal one. */
+	test_expect(distance <= n_errors + n_errors / 50 && distance >= n_errors / 2);
+	test_expect(result.n_sent + result.n_pending == N_GROUPS * 6);
+	test_expect(seconds < 20.0);
+
+	cw_score_result_t whole_result;
+	cw_score_get_result(whole, &whole_result);
+	const int whole_distance = whole_result.n_substitutions + whole_result.n_deletions + whole_result.n_insertions;
+	fprintf(stderr, "scoring: long session scored at the end: %d errors\n", whole_distance);
+	test_expect(whole_distance <= n_errors + n_errors / 50 && whole_distance >= n_errors / 2);
+
+	cw_score_delete(&score);
+	cw_score_delete(&whole);
+
+	return 0;
+}
+
+
+
+
+
+/* Semi-global edit distance: whole received text against any prefix
+   of sent text. */
+int test_cw_score_reference_distance(const char *sent, const char *received)
+{
+	const int n = strlen(sent);
+	const int m = strlen(received);
+
+	int *prev = calloc(n + 1, sizeof (int));
+	int *cur = calloc(n + 1, sizeof (int));
+	for (int j = 0; j <= n; j++) {
+		prev[j] = j;
+	}
+	for (int i = 1; i <= m; i++) {
+		cur[0] = i;
+		for (int j = 1; j <= n; j++) {
+			int d = prev[j - 1] + (sent[j - 1] == received[i - 1] ? 0 : 1);
+			if (prev[j] + 1 < d) {
+				d = prev[j] + 1;
+			}
+			if (cur[j - 1] + 1 < d) {
+				d = cur[j - 1] + 1;
+			}
+			cur[j] = d;
+		}
+		int *tmp = prev;
+		prev = cur;
+		cur = tmp;
+	}
+
+	int best = prev[0];
+	for (int j = 1; j <= n; j++) {
+		if (prev[j] < best) {
+			best = prev[j];
+		}
+	}
+
+	free(prev);
+	free(cur);
+
+	return best;
+}
+
+
+
+
+
+/* Copy 'in' to 'out' with about 'percent' percent of characters
+   replaced, removed or duplicated. Spaces are left intact, so that
+   the texts are normalized in the same way. */
+void test_cw_score_mutate(const char *in, char *out, int percent)
+{
+	int o = 0;
+	for (int i = 0; in[i] != '\0'; i++) {
+		if (in[i] == ' ' || rand() % 100 >= percent) {
+			out[o++] = in[i];
+			continue;
+		}
+
+		switch (rand() % 3) {
+		case 0:
+			out[o++] = in[i] == 'Z' ? 'A' : in[i] + 1;
+			break;
+		case 1:
+			break;
+		default:
+			out[o++] = in[i];
+			out[o++] = in[i];
+			break;
+		}
+	}
+	out[o] = '\0';
+
+	/* Removed characters may leave runs of spaces. */
+	o = 0;
+	for (int i = 0; out[i] != '\0'; i++) {
+		if (out[i] == ' ' && (o == 0 || out[o - 1] == ' ')) {
+			continue;
+		}
+		out[o++] = out[i];
+	}
+	out[o] = '\0';
+
+	return;
+}
+
+
+#endif /* #ifdef CW_SCORING_UNIT_TESTS */
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+ * Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef H_CW_SCORING
+#define H_CW_SCORING
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+
+/* Size of each dimension of confusion matrix. Characters are
+   upper-cased 7-bit ASCII; index zero stands for "no character". */
+#define CW_SCORE_N_CHARACTERS    128
+
+/* Default width of band of alignment: how far (in characters) copy
+   may drift from sent text before alignment loses track of it. */
+#define CW_SCORE_BAND_DEFAULT     32
+
+/* Alignment of characters that are further than this from end of
+   copy is considered final, and is removed from working buffers. */
+#define CW_SCORE_COMMIT_LAG       64
+
+
+typedef struct cw_score_s cw_score_t;
+
+typedef struct {
+	int n_sent;           /* Sent characters aligned with copy. */
+	int n_received;       /* Characters of copy. */
+	int n_correct;        /* Sent characters copied correctly. */
+	int n_substitutions;  /* Sent characters copied as other characters. */
+	int n_deletions;      /* Sent characters missing in copy. */
+	int n_insertions;     /* Characters of copy not present in sent text. */
+	int n_pending;        /* Sent characters that haven't been copied yet. */
+} cw_score_result_t;
+
+extern cw_score_t *cw_score_new(int band);
+extern void        cw_score_delete(cw_score_t **score);
+extern void        cw_score_reset(cw_score_t *score);
+
+extern void cw_score_add_sent(cw_score_t *score, const char *text);
+extern void cw_score_add_received(cw_score_t *score, const char *text);
+extern bool cw_score_delete_received(cw_score_t *score);
+
+extern void         cw_score_get_result(cw_score_t *score, cw_score_result_t *result);
+extern unsigned int cw_score_get_confusion(cw_score_t *score, char sent, char received);
+extern int          cw_score_get_accuracy(cw_score_t *score);
+
+#if defined(__cplusplus)
+}
+#endif
+#endif  /* H_CW_SCORING */
@@ -0,0 +1,859 @@
+/*
+  This file is a part of unixcw project.
+  unixcw project is covered by GNU General Public License, version 2 or later.
+*/
+
+#ifndef H_LIBCW_PLUSPLUS
+#define H_LIBCW_PLUSPLUS
+
+
+
+
+/**
+   \file libcw++.h
+
+   \brief Header-only C++ front end of libcw.
+
+   RAII wrappers of generator (cw_gen_t), receiver (cw_rec_t) and key
+   (cw_key_t), and encoding of string literals into Dots and Dashes at
+   compile time:
+
+   \code
+   static constexpr auto cq = cw::encode("CQ CQ DE N0CALL");
+
+   cw::generator gen(CW_AUDIO_SOUNDCARD);
+   gen.start();
+   gen.enqueue(cq);
+   \endcode
+
+   Encoded messages are enqueued with cw_gen_enqueue_elements(), so
+   there is no lookup or validation of characters at run time. An
+   invalid character in a literal is reported by compiler.
+
+   Constructors throw on failure; other functions return false on
+   failure, with errno set by libcw, like functions of C API.
+
+   When compiled as C++20 (with coroutines), the header also provides
+   cw::event_loop: awaitables that let a single thread wait for
+   many generators, receivers and keys at once:
+
+   \code
+   cw::task send(cw::event_loop & loop, cw::generator & gen)
+   {
+           gen.enqueue("CQ CQ DE N0CALL");
+           co_await loop.message_played(gen);
+   }
+
+   cw::event_loop loop;
+   loop.attach(gen);
+   send(loop, gen);
+   loop.run();
+   \endcode
+
+   Requires C++17.
+*/
+
+
+
+
+#if __cplusplus < 201703L
+#error "libcw++.h requires C++17"
+#endif
+
+
+
+
+#include <cerrno>
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#if defined(__cpp_impl_coroutine)
+#include <algorithm>
+#include <coroutine>
+#include <exception>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <time.h>
+#endif
+
+#include "libcw.h"
+
+
+
+
+/* Modern API of libcw used by the front end. libcw2.h is not
+   installed, so the declarations are repeated here. They must be kept
+   identical to those in libcw2.h and module headers: test of the front
+   end includes both sets, and a mismatch fails its compilation. */
+extern "C" {
+typedef struct cw_rec_struct cw_rec_t;
+typedef struct cw_key_struct cw_key_t;
+typedef void (* cw_key_callback_t)(volatile struct timeval * timestamp, int key_state, void * callback_arg);
+
+cw_gen_t * cw_gen_new(int audio_system, const char * device);
+void cw_gen_delete(cw_gen_t ** gen);
+int cw_gen_start(cw_gen_t * gen);
+int cw_gen_stop(cw_gen_t * gen);
+int cw_gen_set_speed(cw_gen_t * gen, int new_value);
+int cw_gen_set_frequency(cw_gen_t * gen, int new_value);
+int cw_gen_set_volume(cw_gen_t * gen, int new_value);
+int cw_gen_set_gap(cw_gen_t * gen, int new_value);
+int cw_gen_set_weighting(cw_gen_t * gen, int new_value);
+int cw_gen_get_speed(const cw_gen_t * gen);
+int cw_gen_get_frequency(const cw_gen_t * gen);
+int cw_gen_get_volume(const cw_gen_t * gen);
+int cw_gen_get_gap(const cw_gen_t * gen);
+int cw_gen_get_weighting(const cw_gen_t * gen);
+int cw_gen_enqueue_character(cw_gen_t * gen, char c);
+int cw_gen_enqueue_string(cw_gen_t * gen, const char * string);
+int cw_gen_enqueue_elements(cw_gen_t * gen, const char * elements, size_t n_elements);
+int cw_gen_set_notification_fd(cw_gen_t * gen, int fd);
+int cw_gen_wait_for_tone(cw_gen_t * gen);
+int cw_gen_wait_for_queue_level(cw_gen_t * gen, size_t level);
+void cw_gen_flush_queue(cw_gen_t * gen);
+size_t cw_gen_get_queue_length(cw_gen_t const * gen);
+bool cw_gen_is_playing(cw_gen_t const * gen);
+
+cw_rec_t * cw_rec_new(void);
+void cw_rec_delete(cw_rec_t ** rec);
+int cw_rec_set_speed(cw_rec_t * rec, int new_value);
+float cw_rec_get_speed(const cw_rec_t * rec);
+int cw_rec_set_tolerance(cw_rec_t * rec, int new_value);
+int cw_rec_get_tolerance(const cw_rec_t * rec);
+int cw_rec_set_gap(cw_rec_t * rec, int new_value);
+int cw_rec_set_noise_spike_threshold(cw_rec_t * rec, int new_value);
+int cw_rec_get_noise_spike_threshold(const cw_rec_t * rec);
+void cw_rec_enable_adaptive_mode(cw_rec_t * rec);
+void cw_rec_disable_adaptive_mode(cw_rec_t * rec);
+bool cw_rec_get_adaptive_mode(const cw_rec_t * rec);
+int cw_rec_mark_begin(cw_rec_t * rec, const volatile struct timeval * timestamp);
+int cw_rec_mark_end(cw_rec_t * rec, const volatile struct timeval * timestamp);
+int cw_rec_add_mark(cw_rec_t * rec, const volatile struct timeval * timestamp, char mark);
+int cw_rec_poll_representation(cw_rec_t * rec, const struct timeval * timestamp, char * representation, bool * is_end_of_word, bool * is_error);
+int cw_rec_poll_character(cw_rec_t * rec, const struct timeval * timestamp, char * c, bool * is_end_of_word, bool * is_error);
+bool cw_rec_poll_is_pending_inter_word_space(cw_rec_t const * rec);
+int cw_rec_get_character_time(cw_rec_t * rec, struct timeval * timestamp);
+void cw_rec_reset_state(cw_rec_t * rec);
+
+cw_key_t * cw_key_new(void);
+void cw_key_delete(cw_key_t ** key);
+void cw_key_register_generator(volatile cw_key_t * key, cw_gen_t * gen);
+void cw_key_register_receiver(volatile cw_key_t * key, cw_rec_t * rec);
+void cw_key_register_keying_callback(volatile cw_key_t * key, cw_key_callback_t callback_func, void * callback_arg);
+int cw_key_sk_notify_event(volatile cw_key_t * key, int key_state);
+int cw_key_sk_get_value(const volatile cw_key_t * key);
+int cw_key_ik_notify_paddle_event(volatile cw_key_t * key, int dot_paddle_state, int dash_paddle_state);
+void cw_key_ik_enable_curtis_mode_b(volatile cw_key_t * key);
+void cw_key_ik_disable_curtis_mode_b(volatile cw_key_t * key);
+bool cw_key_ik_is_busy(const volatile cw_key_t * key);
+int cw_key_ik_wait_for_keyer(volatile cw_key_t * key);
+}
+
+
+
+
+namespace cw {
+
+
+
+
+/* Elements of message enqueued with cw_gen_enqueue_elements()
+   (CW_ELEMENT_EOC_SPACE and CW_ELEMENT_EOW_SPACE in libcw_gen.h). */
+constexpr char element_eoc_space = ' ';
+constexpr char element_eow_space = '/';
+
+/* Longest representation of a character (CW_DATA_MAX_REPRESENTATION_LENGTH in libcw_data.h). */
+constexpr std::size_t max_representation_length = 7;
+
+
+
+
+/**
+   \brief Get representation of a character at compile time
+
+   The function covers ASCII characters of main table of characters
+   (CW_TABLE in libcw_data.c). Lowercase letters have representations
+   of uppercase letters. Characters added at run time with
+   cw_load_character_table() aren't known to this function.
+
+   \param c - character
+
+   \return representation of \p c, or nullptr
+*/
+constexpr const char * representation(char c) noexcept
+{
+	switch (c) {
+	case 'A': case 'a': return ".-";
+	case 'B': case 'b': return "-...";
+	case 'C': case 'c': return "-.-.";
+	case 'D': case 'd': return "-..";
+	case 'E': case 'e': return ".";
+	case 'F': case 'f': return "..-.";
+	case 'G': case 'g': return "--.";
+	case 'H': case 'h': return "....";
+	case 'I': case 'i': return "..";
+	case 'J': case 'j': return ".---";
+	case 'K': case 'k': return "-.-";
+	case 'L': case 'l': return ".-..";
+	case 'M': case 'm': return "--";
+	case 'N': case 'n': return "-.";
+	case 'O': case 'o': return "---";
+	case 'P': case 'p': return ".--.";
+	case 'Q': case 'q': return "--.-";
+	case 'R': case 'r': return ".-.";
+	case 'S': case 's': return "...";
+	case 'T': case 't': return "-";
+	case 'U': case 'u': return "..-";
+	case 'V': case 'v': return "...-";
+	case 'W': case 'w': return ".--";
+	case 'X': case 'x': return "-..-";
+	case 'Y': case 'y': return "-.--";
+	case 'Z': case 'z': return "--..";
+
+	case '0': return "-----";
+	case '1': return ".----";
+	case '2': return "..---";
+	case '3': return "...--";
+	case '4': return "....-";
+	case '5': return ".....";
+	case '6': return "-....";
+	case '7': return "--...";
+	case '8': return "---..";
+	case '9': return "----.";
+
+	case '"':  return ".-..-.";
+	case '\'': return ".----.";
+	case '$':  return "...-..-";
+	case '(':  return "-.--.";
+	case ')':  return "-.--.-";
+	case '+':  return ".-.-.";
+	case ',':  return "--..--";
+	case '-':  return "-....-";
+	case '.':  return ".-.-.-";
+	case '/':  return "-..-.";
+	case ':':  return "---...";
+	case ';':  return "-.-.-.";
+	case '=':  return "-...-";
+	case '?':  return "..--..";
+	case '_':  return "..--.-";
+	case '@':  return ".--.-.";
+
+	/* Procedural signals. */
+	case '<':  return "...-.-";
+	case '>':  return "-...-.-";
+	case '!':  return "...-.";
+	case '&':  return ".-...";
+	case '^':  return "-.-.-";
+	case '~':  return ".-.-..";
+
+	default:   return nullptr;
+	}
+}
+
+
+
+
+/**
+   \brief Message encoded into elements
+
+   See cw_gen_enqueue_elements() for description of elements.
+   \p Capacity is the largest count of elements of the message.
+*/
+template <std::size_t Capacity>
+class elements {
+public:
+	constexpr const char * data() const noexcept { return buffer; }
+	constexpr std::size_t size() const noexcept { return n_elements; }
+	constexpr char operator[](std::size_t i) const noexcept { return buffer[i]; }
+
+	constexpr void push_back(char element) { buffer[n_elements++] = element; }
+
+private:
+	char buffer[Capacity + 1] = {};
+	std::size_t n_elements = 0;
+};
+
+
+
+
+/**
+   \brief Encode text into elements
+
+   Every character of \p text is encoded into its marks followed by
+   element_eoc_space, and every space character into
+   element_eow_space followed by element_eoc_space, as
+   cw_gen_enqueue_string() would enqueue them. Use the function in
+   constant expression to encode text at compile time; invalid
+   character in \p text is then a compilation error.
+
+   \param text - string literal
+
+   \return encoded text
+*/
+template <std::size_t N>
+constexpr elements<(max_representation_length + 1) * (N - 1)> encode(const char (&text)[N])
+{
+	elements<(max_representation_length + 1) * (N - 1)> result;
+
+	for (std::size_t i = 0; i < N - 1 && text[i] != '\0'; i++) {
+		if (text[i] == ' ') {
+			result.push_back(element_eow_space);
+			result.push_back(element_eoc_space);
+			continue;
+		}
+
+		const char * marks = representation(text[i]);
+		if (!marks) {
+			throw std::invalid_argument("cw::encode(): character without representation");
+		}
+		for (; *marks != '\0'; marks++) {
+			result.push_back(*marks);
+		}
+		result.push_back(element_eoc_space);
+	}
+
+	return result;
+}
+
+
+
+
+/**
+   \brief Owner of generator
+*/
+class generator {
+public:
+	/**
+	   \brief Create generator
+
+	   \throws std::system_error - cw_gen_new() failed
+
+	   \param audio_system - audio system (CW_AUDIO_*)
+	   \param device - audio device, or nullptr for default device
+	*/
+	explicit generator(int audio_system, const char * device = nullptr)
+		: gen(cw_gen_new(audio_system, device))
+	{
+		if (!gen) {
+			throw std::system_error(errno ? errno : ENODEV, std::generic_category(), "cw_gen_new()");
+		}
+	}
+
+	~generator() { cw_gen_delete(&gen); }
+
+	generator(const generator &) = delete;
+	generator & operator=(const generator &) = delete;
+	generator(generator && other) noexcept : gen(std::exchange(other.gen, nullptr)) {}
+	generator & operator=(generator && other) noexcept
+	{
+		if (this != &other) {
+			cw_gen_delete(&gen);
+			gen = std::exchange(other.gen, nullptr);
+		}
+		return *this;
+	}
+
+	cw_gen_t * get() const noexcept { return gen; }
+
+	bool start() { return cw_gen_start(gen); }
+	bool stop() { return cw_gen_stop(gen); }
+
+	bool set_speed(int value) { return cw_gen_set_speed(gen, value); }
+	bool set_frequency(int value) { return cw_gen_set_frequency(gen, value); }
+	bool set_volume(int value) { return cw_gen_set_volume(gen, value); }
+	bool set_gap(int value) { return cw_gen_set_gap(gen, value); }
+	bool set_weighting(int value) { return cw_gen_set_weighting(gen, value); }
+
+	int speed() const { return cw_gen_get_speed(gen); }
+	int frequency() const { return cw_gen_get_frequency(gen); }
+	int volume() const { return cw_gen_get_volume(gen); }
+	int gap() const { return cw_gen_get_gap(gen); }
+	int weighting() const { return cw_gen_get_weighting(gen); }
+
+	bool enqueue(char c) { return cw_gen_enqueue_character(gen, c); }
+	bool enqueue(const char * string) { return cw_gen_enqueue_string(gen, string); }
+	template <std::size_t Capacity>
+	bool enqueue(const elements<Capacity> & message) { return cw_gen_enqueue_elements(gen, message.data(), message.size()); }
+
+	bool wait_for_tone() { return cw_gen_wait_for_tone(gen); }
+	bool wait_for_queue_level(std::size_t level) { return cw_gen_wait_for_queue_level(gen, level); }
+	void flush_queue() { cw_gen_flush_queue(gen); }
+	std::size_t queue_length() const { return cw_gen_get_queue_length(gen); }
+
+private:
+	cw_gen_t * gen = nullptr;
+};
+
+
+
+
+/**
+   \brief Owner of receiver
+*/
+class receiver {
+public:
+	/**
+	   \brief Create receiver
+
+	   \throws std::bad_alloc - cw_rec_new() failed
+	*/
+	receiver()
+		: rec(cw_rec_new())
+	{
+		if (!rec) {
+			throw std::bad_alloc();
+		}
+	}
+
+	~receiver() { cw_rec_delete(&rec); }
+
+	receiver(const receiver &) = delete;
+	receiver & operator=(const receiver &) = delete;
+	receiver(receiver && other) noexcept : rec(std::exchange(other.rec, nullptr)) {}
+	receiver & operator=(receiver && other) noexcept
+	{
+		if (this != &other) {
+			cw_rec_delete(&rec);
+			rec = std::exchange(other.rec, nullptr);
+		}
+		return *this;
+	}
+
+	cw_rec_t * get() const noexcept { return rec; }
+
+	bool set_speed(int value) { return cw_rec_set_speed(rec, value); }
+	bool set_tolerance(int value) { return cw_rec_set_tolerance(rec, value); }
+	bool set_gap(int value) { return cw_rec_set_gap(rec, value); }
+	bool set_noise_spike_threshold(int value) { return cw_rec_set_noise_spike_threshold(rec, value); }
+	void set_adaptive_mode(bool adaptive) { adaptive ? cw_rec_enable_adaptive_mode(rec) : cw_rec_disable_adaptive_mode(rec); }
+
+	float speed() const { return cw_rec_get_speed(rec); }
+	int tolerance() const { return cw_rec_get_tolerance(rec); }
+	int noise_spike_threshold() const { return cw_rec_get_noise_spike_threshold(rec); }
+	bool adaptive_mode() const { return cw_rec_get_adaptive_mode(rec); }
+
+	bool mark_begin(const struct timeval * timestamp) { return cw_rec_mark_begin(rec, timestamp); }
+	bool mark_end(const struct timeval * timestamp) { return cw_rec_mark_end(rec, timestamp); }
+	bool add_mark(const struct timeval * timestamp, char mark) { return cw_rec_add_mark(rec, timestamp, mark); }
+
+	bool poll_character(const struct timeval * timestamp, char & c, bool & is_end_of_word, bool & is_error)
+	{
+		return cw_rec_poll_character(rec, timestamp, &c, &is_end_of_word, &is_error);
+	}
+	bool poll_representation(const struct timeval * timestamp, char * representation, bool & is_end_of_word, bool & is_error)
+	{
+		return cw_rec_poll_representation(rec, timestamp, representation, &is_end_of_word, &is_error);
+	}
+	void reset_state() { cw_rec_reset_state(rec); }
+
+private:
+	cw_rec_t * rec = nullptr;
+};
+
+
+
+
+/**
+   \brief Owner of key
+
+   Generator and receiver registered with the key must live longer
+   than the key.
+*/
+class key {
+public:
+	/**
+	   \brief Create key
+
+	   \throws std::bad_alloc - cw_key_new() failed
+	*/
+	key()
+		: k(cw_key_new())
+	{
+		if (!k) {
+			throw std::bad_alloc();
+		}
+	}
+
+	~key() { cw_key_delete(&k); }
+
+	key(const key &) = delete;
+	key & operator=(const key &) = delete;
+	key(key && other) noexcept : k(std::exchange(other.k, nullptr)) {}
+	key & operator=(key && other) noexcept
+	{
+		if (this != &other) {
+			cw_key_delete(&k);
+			k = std::exchange(other.k, nullptr);
+		}
+		return *this;
+	}
+
+	cw_key_t * get() const noexcept { return k; }
+
+	void register_generator(generator & gen) { cw_key_register_generator(k, gen.get()); }
+	void register_receiver(receiver & rec) { cw_key_register_receiver(k, rec.get()); }
+	void register_keying_callback(cw_key_callback_t callback_func, void * callback_arg) { cw_key_register_keying_callback(k, callback_func, callback_arg); }
+
+	bool sk_notify_event(int key_state) { return cw_key_sk_notify_event(k, key_state); }
+	int sk_value() const { return cw_key_sk_get_value(k); }
+
+	bool ik_notify_paddle_event(int dot_paddle_state, int dash_paddle_state) { return cw_key_ik_notify_paddle_event(k, dot_paddle_state, dash_paddle_state); }
+	void ik_set_curtis_mode_b(bool enable) { enable ? cw_key_ik_enable_curtis_mode_b(k) : cw_key_ik_disable_curtis_mode_b(k); }
+	bool ik_wait_for_keyer() { return cw_key_ik_wait_for_keyer(k); }
+
+private:
+	cw_key_t * k = nullptr;
+};
+
+
+
+
+#if defined(__cpp_impl_coroutine)
+
+
+
+
+/**
+   \brief Coroutine started by caller and never awaited
+
+   The coroutine runs until its first co_await on cw::event_loop,
+   and is then resumed by the loop. Frame of the coroutine is freed
+   when the coroutine returns.
+*/
+class task {
+public:
+	struct promise_type {
+		task get_return_object() noexcept { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() noexcept {}
+		void unhandled_exception() noexcept { std::terminate(); }
+	};
+};
+
+
+
+
+/**
+   \brief Single-threaded loop resuming coroutines waiting for libcw
+
+   Generators report progress of playing of their tone queues through
+   a pipe owned by the loop (see cw_gen_set_notification_fd()), so
+   generators must be attached to the loop before awaiting them.
+   Iambic keyer is driven by its generator, so the generator of a
+   key must be attached as well.
+
+   Receivers have no thread of their own: the loop wakes up when a
+   character being received is complete, and otherwise waits for
+   cw::event_loop::notify(). Code that feeds marks to a receiver
+   outside of the loop's thread should call notify() afterwards.
+
+   Loop and awaited objects must be used in one thread; only
+   notify() may be called from other threads.
+*/
+class event_loop {
+public:
+	/**
+	   \brief Object of coroutine waiting for event
+
+	   The object is a part of frame of suspended coroutine.
+	*/
+	class waiter {
+	public:
+		bool await_ready() { return is_ready(); }
+		void await_suspend(std::coroutine_handle<> h)
+		{
+			handle = h;
+			loop.waiters.push_back(this);
+		}
+
+	protected:
+		explicit waiter(event_loop & l) : loop(l) {}
+		~waiter() = default;
+		waiter(const waiter &) = delete;
+		waiter & operator=(const waiter &) = delete;
+
+		/**
+		   \brief Check if event has happened
+
+		   \param deadline - time (CLOCK_MONOTONIC) at which the event will happen, if known
+
+		   \return true if coroutine can be resumed
+		*/
+		virtual bool is_ready(struct timespec * deadline = nullptr) = 0;
+
+	private:
+		friend class event_loop;
+		event_loop & loop;
+		std::coroutine_handle<> handle;
+	};
+
+
+
+	class queue_below_waiter : public waiter {
+	public:
+		queue_below_waiter(event_loop & l, generator & g, std::size_t lvl) : waiter(l), gen(g), level(lvl) {}
+		void await_resume() noexcept {}
+	protected:
+		bool is_ready(struct timespec *) override { return gen.queue_length() <= level; }
+	private:
+		generator & gen;
+		std::size_t level;
+	};
+
+
+
+	class message_played_waiter : public waiter {
+	public:
+		message_played_waiter(event_loop & l, generator & g) : waiter(l), gen(g) {}
+		void await_resume() noexcept {}
+	protected:
+		bool is_ready(struct timespec *) override { return !cw_gen_is_playing(gen.get()); }
+	private:
+		generator & gen;
+	};
+
+
+
+	/**
+	   \brief Character received by receiver
+	*/
+	struct character {
+		char c = '\0';
+		bool is_end_of_word = false;
+		bool is_error = false;
+	};
+
+	class character_received_waiter : public waiter {
+	public:
+		character_received_waiter(event_loop & l, receiver & r) : waiter(l), rec(r) {}
+		character await_resume() noexcept { return result; }
+	protected:
+		bool is_ready(struct timespec * deadline) override
+		{
+			/* Timestamps of receiver come from gettimeofday(). */
+			struct timeval now;
+			gettimeofday(&now, nullptr);
+			const bool is_pending = cw_rec_poll_is_pending_inter_word_space(rec.get());
+			character polled;
+			if (rec.poll_character(&now, polled.c, polled.is_end_of_word, polled.is_error)
+			    && (!is_pending || polled.is_end_of_word)) {
+
+				if (!is_pending) {
+					/* New character, maybe already followed by end of word. */
+					result = polled;
+				} else {
+					/* End of word after character that has been taken earlier. */
+					result = { ' ', true, false };
+				}
+				if (result.is_end_of_word) {
+					rec.reset_state();
+				}
+				return true;
+			}
+			struct timeval character_time;
+			if (deadline && CW_SUCCESS == cw_rec_get_character_time(rec.get(), &character_time)) {
+				/* Convert the time to loop's clock now, so
+				   that adjustments of system time don't
+				   affect the loop's timeout. */
+				const long long delta_us = (character_time.tv_sec - now.tv_sec) * 1000000LL + (character_time.tv_usec - now.tv_usec);
+				clock_gettime(CLOCK_MONOTONIC, deadline);
+				const long long nsec = deadline->tv_nsec + delta_us * 1000;
+				deadline->tv_sec += nsec / 1000000000LL;
+				deadline->tv_nsec = nsec % 1000000000LL;
+				if (deadline->tv_nsec < 0) {
+					deadline->tv_sec--;
+					deadline->tv_nsec += 1000000000LL;
+				}
+			}
+			return false;
+		}
+	private:
+		receiver & rec;
+		character result;
+	};
+
+
+
+	class keyer_idle_waiter : public waiter {
+	public:
+		keyer_idle_waiter(event_loop & l, key & kk) : waiter(l), k(kk) {}
+		void await_resume() noexcept {}
+	protected:
+		bool is_ready(struct timespec *) override { return !cw_key_ik_is_busy(k.get()); }
+	private:
+		key & k;
+	};
+
+
+
+	/**
+	   \throws std::system_error - pipe can't be created
+	*/
+	event_loop()
+	{
+		if (-1 == pipe2(fds, O_NONBLOCK | O_CLOEXEC)) {
+			throw std::system_error(errno, std::generic_category(), "pipe2()");
+		}
+	}
+
+	~event_loop()
+	{
+		close(fds[0]);
+		close(fds[1]);
+	}
+
+	event_loop(const event_loop &) = delete;
+	event_loop & operator=(const event_loop &) = delete;
+
+	/* Generator must be detached before the loop is destroyed. */
+	bool attach(generator & gen) { return cw_gen_set_notification_fd(gen.get(), fds[1]); }
+	bool detach(generator & gen) { return cw_gen_set_notification_fd(gen.get(), -1); }
+
+	/**
+	   \brief Wake up the loop to check state of awaited objects
+	*/
+	void notify() noexcept
+	{
+		const char byte = 0;
+		if (-1 == write(fds[1], &byte, 1)) {
+			/* Full pipe is readable anyway. */
+			;
+		}
+	}
+
+	/**
+	   \brief Descriptor to be polled by external loop before calling run_once()
+	*/
+	int fd() const noexcept { return fds[0]; }
+
+	/**
+	   \brief Wait until length of generator's queue is at or below level
+
+	   See cw_gen_wait_for_queue_level().
+	*/
+	queue_below_waiter queue_below(generator & gen, std::size_t level) { return { *this, gen, level }; }
+
+	/**
+	   \brief Wait until generator has played all enqueued tones
+	*/
+	message_played_waiter message_played(generator & gen) { return { *this, gen }; }
+
+	/**
+	   \brief Wait until receiver has received a character
+
+	   The character is taken from receiver as with
+	   cw_rec_poll_character(). When the character isn't followed by
+	   end of word yet, next wait returns ' ' with is_end_of_word set
+	   when inter-word space is received (or a next character, when
+	   new marks come first). Receiver's state is reset at end of
+	   word.
+	*/
+	character_received_waiter character_received(receiver & rec) { return { *this, rec }; }
+
+	/**
+	   \brief Wait until iambic keyer has finished sending elements
+
+	   See cw_key_ik_wait_for_keyer().
+	*/
+	keyer_idle_waiter keyer_idle(key & k) { return { *this, k }; }
+
+	/**
+	   \brief Resume coroutines whose events happened, wait for at most \p timeout_ms
+
+	   \param timeout_ms - timeout passed to poll(), -1 for no timeout
+
+	   \return count of resumed coroutines
+	*/
+	int run_once(int timeout_ms = -1)
+	{
+		int n_resumed = resume_ready(&timeout_ms);
+		if (n_resumed || waiters.empty()) {
+			return n_resumed;
+		}
+
+		struct pollfd pfd = { fds[0], POLLIN, 0 };
+		if (poll(&pfd, 1, timeout_ms) > 0) {
+			char buffer[64];
+			while (read(fds[0], buffer, sizeof (buffer)) > 0) {
+				;
+			}
+		}
+
+		return resume_ready(nullptr);
+	}
+
+	/**
+	   \brief Run until all waiting coroutines are finished, or until stop()
+	*/
+	void run()
+	{
+		stopped = false;
+		while (!stopped && !waiters.empty()) {
+			run_once();
+		}
+	}
+
+	void stop() noexcept { stopped = true; }
+
+private:
+	/* Resume ready coroutines, shorten \p timeout_ms to nearest known deadline. */
+	int resume_ready(int * timeout_ms)
+	{
+		std::vector<waiter *> ready;
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		for (auto it = waiters.begin(); it != waiters.end(); ) {
+			struct timespec deadline = { -1, 0 };
+			if ((*it)->is_ready(&deadline)) {
+				ready.push_back(*it);
+				it = waiters.erase(it);
+				continue;
+			}
+			if (timeout_ms && deadline.tv_sec >= 0) {
+				const long long delta = (deadline.tv_sec - now.tv_sec) * 1000LL + (deadline.tv_nsec - now.tv_nsec + 999999) / 1000000;
+				const int ms = (int) std::max(0LL, delta);
+				if (*timeout_ms < 0 || ms < *timeout_ms) {
+					*timeout_ms = ms;
+				}
+			}
+			++it;
+		}
+
+		/* Waiters are removed from the list before they are
+		   resumed, because resumed coroutine may add new
+		   waiters to the list. */
+		for (waiter * w : ready) {
+			w->handle.resume();
+		}
+
+		return (int) ready.size();
+	}
+
+	int fds[2] = { -1, -1 };
+	std::vector<waiter *> waiters;
+	bool stopped = false;
+};
+
+
+
+
+#endif /* #if defined(__cpp_impl_coroutine) */
+
+
+
+
+} /* namespace cw */
+
+
+
+
+#endif /* #ifndef H_LIBCW_PLUSPLUS */
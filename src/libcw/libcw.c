@@ -262,6 +262,22 @@ int cw_generator_start(void)
 
 
 
+/**
+   \brief Redirect characters sent with generator to keying timeline
+
+   See cw_gen_set_timeline() for details.
+
+   \param timeline - timeline to append to, or NULL
+*/
+void cw_generator_set_timeline(cw_timeline_t *timeline)
+{
+	cw_gen_set_timeline(cw_generator, timeline);
+}
+
+
+
+
+
 /**
    \brief Shut down a generator
 
@@ -701,7 +717,7 @@ int cw_send_representation_partial(const char *representation)
 */
 int cw_send_character(char c)
 {
-	return cw_gen_enqueue_valid_character_internal(cw_generator, c);
+	return cw_gen_enqueue_valid_character_internal(cw_generator, cw_character_table_internal(), c);
 }
 
 
@@ -25,6 +25,7 @@
 #include <stdint.h>    /* int16_t */
 #include <pthread.h>
 #include <stdbool.h>
+#include <stddef.h>    /* size_t */
 
 
 static const int        CW_AUDIO_CHANNELS = 1;                /* Sound in mono */
@@ -196,6 +197,7 @@ enum {
 };
 
 typedef struct cw_gen_struct cw_gen_t;
+typedef struct cw_timeline_struct cw_timeline_t;
 
 
 /* Functions handling library meta data */
@@ -211,6 +213,7 @@ extern void cw_generator_delete(void);
 extern int  cw_generator_start(void);
 extern void cw_generator_stop(void);
 extern const char *cw_generator_get_audio_system_label(void);
+extern void cw_generator_set_timeline(cw_timeline_t *timeline);
 /* FIXME: first argument of the function is gen, but no function provides access to generator variable. */
 extern int  cw_generator_set_tone_slope(cw_gen_t *gen, int slope_shape, int slope_usecs);
 
@@ -221,6 +224,9 @@ extern int   cw_get_maximum_representation_length(void);
 extern char *cw_character_to_representation(int c);
 extern bool  cw_representation_is_valid(const char *representation);
 extern int   cw_representation_to_character(const char *representation);
+extern int   cw_load_character_table(const char *characters, const char *const representations[], int count);
+extern int   cw_load_character_table_file(const char *path);
+extern void  cw_reset_character_table(void);
 
 
 /* Extended Morse code data and lookup (procedural signals) */
@@ -340,6 +346,7 @@ extern int cw_send_string(const char *string);
 
 extern bool cw_character_is_valid(char c);
 extern bool cw_string_is_valid(const char *string);
+extern int  cw_string_normalize(const char *string, char *normalized, size_t *positions, int n_positions_max);
 
 
 
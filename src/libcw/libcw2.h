@@ -4,7 +4,21 @@
 
 
 
+#include <time.h>
+
 #include "libcw_gen.h"
+#include "libcw_sched.h"
+#include "libcw_codec.h"
+#include "libcw_trace.h"
+#include "libcw_analyzer.h"
+#include "libcw_transcode.h"
+#include "libcw_alphabet.h"
+#include "libcw_pool.h"
+#include "libcw_resampler.h"
+#include "libcw_snapshot.h"
+#include "libcw_shm_tq.h"
+#include "libcw_rec_output.h"
+#include "libcw_rec_manager.h"
 
 
 
@@ -30,9 +44,56 @@ cw_ret cw_get_package_version(int * major, int * minor, int * maintenance);
 
 
 
+/* Storage of generators, receivers and keys provided by client code. */
+size_t      cw_get_storage_alignment(void);
+cw_pool_t * cw_pool_new(size_t block_size, size_t n_blocks);
+void        cw_pool_delete(cw_pool_t ** pool);
+void *      cw_pool_alloc(cw_pool_t * pool);
+int         cw_pool_free(cw_pool_t * pool, void * block);
+size_t      cw_pool_get_block_size(cw_pool_t const * pool);
+size_t      cw_pool_get_n_free(cw_pool_t * pool);
+
+
+
+
+/* Conversion of samples between sample rates. */
+cw_resampler_t * cw_resampler_new(int in_rate, int out_rate);
+void             cw_resampler_delete(cw_resampler_t ** resampler);
+void             cw_resampler_reset(cw_resampler_t * resampler);
+int              cw_resampler_get_delay(const cw_resampler_t * resampler);
+int              cw_resampler_process(cw_resampler_t * resampler, const cw_sample_t * in, int * n_in, cw_sample_t * out, int n_out);
+
+
+
+
+/* Snapshots of state of generators and receivers. */
+int cw_gen_snapshot(cw_gen_t * gen, uint8_t * bytes, size_t size, size_t * n_bytes);
+int cw_gen_restore(cw_gen_t * gen, const uint8_t * bytes, size_t n_bytes);
+int cw_rec_snapshot(cw_rec_t const * rec, uint8_t * bytes, size_t size, size_t * n_bytes);
+int cw_rec_restore(cw_rec_t * rec, const uint8_t * bytes, size_t n_bytes);
+
+
+
+
+/* Tone queue in memory shared between processes. */
+cw_shm_tq_t * cw_shm_tq_new(size_t capacity);
+cw_shm_tq_t * cw_shm_tq_attach(int fd);
+void          cw_shm_tq_delete(cw_shm_tq_t ** queue);
+int           cw_shm_tq_get_fd(cw_shm_tq_t const * queue);
+size_t        cw_shm_tq_get_length(cw_shm_tq_t const * queue);
+int           cw_shm_tq_enqueue_tone(cw_shm_tq_t * queue, int usecs, int frequency);
+int           cw_shm_tq_enqueue_string(cw_shm_tq_t * queue, const char * string);
+int           cw_shm_tq_forward(cw_shm_tq_t * queue, cw_gen_t * gen);
+
+
+
+
 /* Basic generator functions. */
 cw_gen_t * cw_gen_new(int audio_system, const char * device);
 void       cw_gen_delete(cw_gen_t ** gen);
+size_t     cw_gen_get_storage_size(void);
+cw_gen_t * cw_gen_init(void * storage, size_t size, int audio_system, const char * device);
+void       cw_gen_deinit(cw_gen_t * gen);
 int        cw_gen_stop(cw_gen_t * gen);
 int        cw_gen_start(cw_gen_t * gen);
 
@@ -55,21 +116,46 @@ int cw_gen_get_weighting(const cw_gen_t * gen);
 
 int cw_gen_enqueue_character(cw_gen_t * gen, char c);
 int cw_gen_enqueue_string(cw_gen_t * gen, const char * string);
+int cw_gen_enqueue_at(cw_gen_t * gen, const char * text, clockid_t clock, const struct timespec * when);
 int cw_gen_wait_for_queue_level(cw_gen_t * gen, size_t level);
 
 void cw_gen_flush_queue(cw_gen_t * gen);
+
+void cw_gen_enable_key_edges(cw_gen_t * gen, bool enable);
+int cw_gen_get_key_edge(cw_gen_t * gen, cw_key_edge_t * edge);
+unsigned int cw_gen_get_key_edges_dropped(cw_gen_t const * gen);
+
+cw_timeline_t * cw_timeline_new(void);
+void cw_timeline_delete(cw_timeline_t ** timeline);
+void cw_timeline_clear(cw_timeline_t * timeline);
+void cw_gen_set_timeline(cw_gen_t * gen, cw_timeline_t * timeline);
 const char *cw_gen_get_audio_device(cw_gen_t const * gen);
 int cw_gen_get_audio_system(cw_gen_t const * gen);
 size_t cw_gen_get_queue_length(cw_gen_t const * gen);
 int cw_gen_register_low_level_callback(cw_gen_t * gen, cw_queue_low_callback_t callback_func, void * callback_arg, size_t level);
 int cw_gen_wait_for_tone(cw_gen_t * gen);
 bool cw_gen_is_queue_full(cw_gen_t const * gen);
+int64_t cw_gen_get_queued_duration(cw_gen_t const * gen, int64_t * n_samples);
+void cw_gen_set_symbolic_enqueue(cw_gen_t * gen, bool symbolic);
+bool cw_gen_get_symbolic_enqueue(cw_gen_t const * gen);
+int cw_gen_set_alphabet(cw_gen_t * gen, int alphabet);
+int cw_gen_enqueue_utf8_string(cw_gen_t * gen, const char * string);
+int cw_gen_enqueue_elements(cw_gen_t * gen, const char * elements, size_t n_elements);
+int cw_gen_set_notification_fd(cw_gen_t * gen, int fd);
+bool cw_gen_is_playing(cw_gen_t const * gen);
+int cw_gen_set_synthesis(cw_gen_t * gen, int synthesis);
+int cw_gen_get_synthesis(cw_gen_t const * gen);
+int cw_gen_set_synthesis_rate(cw_gen_t * gen, int sample_rate);
+int cw_gen_get_synthesis_rate(cw_gen_t const * gen);
 
 
 
 
 cw_key_t * cw_key_new(void);
 void cw_key_delete(cw_key_t ** key);
+size_t cw_key_get_storage_size(void);
+cw_key_t * cw_key_init(void * storage, size_t size);
+void cw_key_deinit(cw_key_t * key);
 
 void cw_key_register_keying_callback(volatile cw_key_t * key, cw_key_callback_t callback_func, void * callback_arg);
 void cw_key_register_generator(volatile cw_key_t * key, cw_gen_t * gen);
@@ -84,6 +170,7 @@ int  cw_key_ik_notify_dot_paddle_event(volatile cw_key_t * key, int dot_paddle_s
 void cw_key_ik_get_paddles(const volatile cw_key_t * key, int * dot_paddle_state, int * dash_paddle_state);
 int  cw_key_ik_wait_for_element(const volatile cw_key_t * key);
 int  cw_key_ik_wait_for_keyer(volatile cw_key_t * key);
+bool cw_key_ik_is_busy(const volatile cw_key_t * key);
 
 int  cw_key_sk_get_value(const volatile cw_key_t * key);
 bool cw_key_sk_is_busy(volatile cw_key_t * key);
@@ -95,6 +182,9 @@ int  cw_key_sk_notify_event(volatile cw_key_t * key, int key_state);
 /* Creator and destructor. */
 cw_rec_t * cw_rec_new(void);
 void       cw_rec_delete(cw_rec_t ** rec);
+size_t     cw_rec_get_storage_size(void);
+cw_rec_t * cw_rec_init(void * storage, size_t size);
+void       cw_rec_deinit(cw_rec_t * rec);
 
 
 /* Helper receive functions. */
@@ -129,6 +219,99 @@ int  cw_rec_poll_representation(cw_rec_t * rec, const struct timeval * timestamp
 void cw_rec_enable_adaptive_mode(cw_rec_t * rec);
 void cw_rec_disable_adaptive_mode(cw_rec_t * rec);
 bool cw_rec_poll_is_pending_inter_word_space(cw_rec_t const * rec);
+int  cw_rec_get_character_time(cw_rec_t * rec, struct timeval * timestamp);
+int  cw_rec_set_alphabet(cw_rec_t * rec, int alphabet);
+int  cw_rec_poll_utf8_character(cw_rec_t * rec, const struct timeval * timestamp, char * character, bool * is_end_of_word, bool * is_error);
+
+/* Queue of received characters. */
+int          cw_rec_start_output(cw_rec_t * rec);
+void         cw_rec_stop_output(cw_rec_t * rec);
+int          cw_rec_get_output_fd(cw_rec_t const * rec);
+int          cw_rec_get_output(cw_rec_t * rec, cw_rec_output_t * output);
+int          cw_rec_wait_output(cw_rec_t * rec, cw_rec_output_t * output, int timeout);
+unsigned int cw_rec_get_output_n_dropped(cw_rec_t const * rec);
+
+
+
+
+/* Manager of many receivers. */
+cw_rec_manager_t * cw_rec_manager_new(int n_receivers, cw_rec_manager_callback_t callback, void * callback_arg);
+void               cw_rec_manager_delete(cw_rec_manager_t ** manager);
+cw_rec_t *         cw_rec_manager_get_receiver(cw_rec_manager_t * manager, int receiver);
+int                cw_rec_manager_process(cw_rec_manager_t * manager, const cw_rec_manager_event_t * events, size_t n_events);
+void               cw_rec_manager_advance(cw_rec_manager_t * manager, const struct timeval * timestamp);
+int                cw_rec_manager_get_n_pending(cw_rec_manager_t const * manager);
+
+
+
+
+/* Scheduler rendering many generators (sessions) on a fixed pool of threads. */
+cw_sched_t * cw_sched_new(int n_workers, int sample_rate, int buffer_n_samples);
+void         cw_sched_delete(cw_sched_t ** sched);
+cw_gen_t *   cw_sched_add_session(cw_sched_t * sched, cw_sched_write_t write_func, void * write_arg);
+int          cw_sched_remove_session(cw_sched_t * sched, cw_gen_t ** gen);
+int          cw_sched_set_write_silence(cw_sched_t * sched, cw_gen_t * gen, cw_sched_write_silence_t write_silence_func);
+int          cw_sched_get_n_sessions(cw_sched_t * sched);
+int          cw_sched_tick(cw_sched_t * sched);
+
+
+
+/* Compact encoding of generator's output, and synthesis of samples from the encoding. */
+cw_codec_encoder_t * cw_codec_encoder_new(cw_gen_t * gen, cw_codec_write_t write_func, void * write_arg);
+void                 cw_codec_encoder_delete(cw_codec_encoder_t ** enc);
+int                  cw_codec_encoder_flush(cw_codec_encoder_t * enc);
+cw_codec_decoder_t * cw_codec_decoder_new(cw_codec_pcm_write_t write_func, void * write_arg);
+void                 cw_codec_decoder_delete(cw_codec_decoder_t ** dec);
+void                 cw_codec_decoder_set_write_silence(cw_codec_decoder_t * dec, cw_codec_pcm_write_silence_t write_silence_func);
+int                  cw_codec_decoder_push(cw_codec_decoder_t * dec, const uint8_t * bytes, size_t n_bytes);
+
+
+
+/* Recording and replaying of key events. */
+cw_trace_recorder_t * cw_trace_recorder_new(FILE * file, const cw_trace_header_t * header);
+void                  cw_trace_recorder_delete(cw_trace_recorder_t ** recorder);
+int                   cw_trace_recorder_start_session(cw_trace_recorder_t * recorder, const cw_trace_header_t * header);
+int                   cw_trace_recorder_add_event(cw_trace_recorder_t * recorder, const struct timeval * timestamp, int key_state);
+int                   cw_trace_recorder_flush(cw_trace_recorder_t * recorder);
+void                  cw_trace_recorder_keying_callback(volatile struct timeval * timestamp, int key_state, void * callback_arg);
+cw_trace_reader_t *   cw_trace_reader_new(FILE * file);
+void                  cw_trace_reader_delete(cw_trace_reader_t ** reader);
+int                   cw_trace_reader_next(cw_trace_reader_t * reader, cw_trace_event_t * event);
+int                   cw_trace_reader_get_header(const cw_trace_reader_t * reader, cw_trace_header_t * header);
+int                   cw_trace_replay(cw_trace_reader_t * reader, cw_rec_t * rec, volatile cw_key_t * key, double speedup, cw_trace_character_callback_t callback_func, void * callback_arg);
+
+
+
+/* Analysis of quality of sending. */
+cw_analyzer_t *                 cw_analyzer_new(void);
+void                            cw_analyzer_delete(cw_analyzer_t ** an);
+int                             cw_analyzer_set_parameters(cw_analyzer_t * an, int speed, int tolerance);
+int                             cw_analyzer_add_event(cw_analyzer_t * an, const struct timeval * timestamp, int key_state);
+void                            cw_analyzer_flush(cw_analyzer_t * an);
+int                             cw_analyzer_add_trace(cw_analyzer_t * an, cw_trace_reader_t * reader);
+const cw_analyzer_character_t * cw_analyzer_get_character(const cw_analyzer_t * an, char c);
+int                             cw_analyzer_get_malformed_characters(const cw_analyzer_t * an, char * characters, int n_max);
+int                             cw_analyzer_get_unknown(const cw_analyzer_t * an, int i, char * representation, int64_t * count);
+int                             cw_analyzer_get_speed_curve(const cw_analyzer_t * an, double * speeds, int64_t * interval);
+int                             cw_analyzer_get_weighting(const cw_analyzer_t * an, double * weighting);
+int                             cw_analyzer_get_ratio(const cw_analyzer_t * an, double * ratio);
+double                          cw_analyzer_stat_get_sd(const cw_analyzer_stat_t * stat);
+
+
+
+/* Bulk conversion of text to Dots and Dashes, and back. */
+cw_transcoder_t * cw_transcoder_new(int direction, const char * char_separator, const char * word_separator);
+void              cw_transcoder_delete(cw_transcoder_t ** tr);
+size_t            cw_transcoder_get_max_output(const cw_transcoder_t * tr, size_t size);
+size_t            cw_transcoder_process(cw_transcoder_t * tr, const char * input, size_t size, char * output);
+size_t            cw_transcoder_finish(cw_transcoder_t * tr, char * output);
+void              cw_transcoder_get_counts(const cw_transcoder_t * tr, int64_t * n_characters, int64_t * n_errors);
+
+
+
+/* Unicode characters and non-Latin alphabets. */
+int      cw_alphabet_codepoint_to_representations(int alphabet, uint32_t codepoint, const char * representations[CW_ALPHABET_REPRESENTATIONS_MAX]);
+uint32_t cw_alphabet_representation_to_codepoint(int alphabet, const char * representation);
 
 
 
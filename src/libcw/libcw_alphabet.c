@@ -0,0 +1,689 @@
+/*
+  Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+  Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+/**
+   \file libcw_alphabet.c
+
+   \brief Unicode characters and non-Latin Morse alphabets.
+
+   Table of characters (see libcw_data.c) is indexed with single
+   bytes. This file maps Unicode codepoints to representations, for
+   Latin alphabet (table of characters), and for Cyrillic, Greek,
+   Hebrew, Arabic and Wabun (Japanese) alphabets.
+
+   Letters of each alphabet are kept in a table indexed with
+   (codepoint - first codepoint of the alphabet), built by compiler
+   with designated initializers. Lowercase letters, final forms and
+   other variants are first folded to the codepoint that is in the
+   table. So lookup of a codepoint is a range check and a table
+   access, as for single-byte characters.
+
+   Reverse lookup uses the hash of representation (see
+   cw_representation_to_hash_internal()): the hash is a position in
+   complete binary trie of Dots and Dashes, so the trie is stored as
+   an array indexed with the hash. Arrays for letters of all
+   alphabets are built once, on first lookup.
+
+   ASCII characters (numerals, punctuation, procedural signals, and
+   Latin letters) are looked up in current table of characters, so
+   characters loaded with cw_load_character_table() are used in all
+   alphabets.
+*/
+
+
+
+
+#include "config.h"
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+
+
+#include "libcw_alphabet.h"
+#include "libcw_data.h"
+#include "libcw_debug.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+#define MSG_PREFIX "libcw/alphabet: "
+
+
+
+
+/* From libcw_debug.c. */
+extern cw_debug_t cw_debug_object;
+extern cw_debug_t cw_debug_object_dev;
+
+/* Latin letters outside of ASCII (ISO 8859-1 and ISO 8859-2
+   characters of main table). */
+#define CW_ALPHABET_LATIN_BASE 0x00C0
+static const char * const cw_alphabet_latin[] = {
+	[0x00C0 - CW_ALPHABET_LATIN_BASE] = ".--.-",   /* A with grave */
+	[0x00C4 - CW_ALPHABET_LATIN_BASE] = ".-.-",    /* A with diaeresis */
+	[0x00C7 - CW_ALPHABET_LATIN_BASE] = "-.-..",   /* C with cedilla */
+	[0x00C8 - CW_ALPHABET_LATIN_BASE] = ".-..-",   /* E with grave */
+	[0x00C9 - CW_ALPHABET_LATIN_BASE] = "..-..",   /* E with acute */
+	[0x00D1 - CW_ALPHABET_LATIN_BASE] = "--.--",   /* N with tilde */
+	[0x00D6 - CW_ALPHABET_LATIN_BASE] = "---.",    /* O with diaeresis */
+	[0x00DC - CW_ALPHABET_LATIN_BASE] = "..--",    /* U with diaeresis */
+	[0x015E - CW_ALPHABET_LATIN_BASE] = "----",    /* S with cedilla */
+	[0x017B - CW_ALPHABET_LATIN_BASE] = "--..-"    /* Z with dot above */
+};
+
+
+/* Russian letters. */
+#define CW_ALPHABET_CYRILLIC_BASE 0x0410
+static const char * const cw_alphabet_cyrillic[] = {
+	[0x0410 - CW_ALPHABET_CYRILLIC_BASE] = ".-",     /* A */
+	[0x0411 - CW_ALPHABET_CYRILLIC_BASE] = "-...",   /* BE */
+	[0x0412 - CW_ALPHABET_CYRILLIC_BASE] = ".--",    /* VE */
+	[0x0413 - CW_ALPHABET_CYRILLIC_BASE] = "--.",    /* GHE */
+	[0x0414 - CW_ALPHABET_CYRILLIC_BASE] = "-..",    /* DE */
+	[0x0415 - CW_ALPHABET_CYRILLIC_BASE] = ".",      /* IE */
+	[0x0416 - CW_ALPHABET_CYRILLIC_BASE] = "...-",   /* ZHE */
+	[0x0417 - CW_ALPHABET_CYRILLIC_BASE] = "--..",   /* ZE */
+	[0x0418 - CW_ALPHABET_CYRILLIC_BASE] = "..",     /* I */
+	[0x0419 - CW_ALPHABET_CYRILLIC_BASE] = ".---",   /* SHORT I */
+	[0x041A - CW_ALPHABET_CYRILLIC_BASE] = "-.-",    /* KA */
+	[0x041B - CW_ALPHABET_CYRILLIC_BASE] = ".-..",   /* EL */
+	[0x041C - CW_ALPHABET_CYRILLIC_BASE] = "--",     /* EM */
+	[0x041D - CW_ALPHABET_CYRILLIC_BASE] = "-.",     /* EN */
+	[0x041E - CW_ALPHABET_CYRILLIC_BASE] = "---",    /* O */
+	[0x041F - CW_ALPHABET_CYRILLIC_BASE] = ".--.",   /* PE */
+	[0x0420 - CW_ALPHABET_CYRILLIC_BASE] = ".-.",    /* ER */
+	[0x0421 - CW_ALPHABET_CYRILLIC_BASE] = "...",    /* ES */
+	[0x0422 - CW_ALPHABET_CYRILLIC_BASE] = "-",      /* TE */
+	[0x0423 - CW_ALPHABET_CYRILLIC_BASE] = "..-",    /* U */
+	[0x0424 - CW_ALPHABET_CYRILLIC_BASE] = "..-.",   /* EF */
+	[0x0425 - CW_ALPHABET_CYRILLIC_BASE] = "....",   /* HA */
+	[0x0426 - CW_ALPHABET_CYRILLIC_BASE] = "-.-.",   /* TSE */
+	[0x0427 - CW_ALPHABET_CYRILLIC_BASE] = "---.",   /* CHE */
+	[0x0428 - CW_ALPHABET_CYRILLIC_BASE] = "----",   /* SHA */
+	[0x0429 - CW_ALPHABET_CYRILLIC_BASE] = "--.-",   /* SHCHA */
+	[0x042A - CW_ALPHABET_CYRILLIC_BASE] = "--.--",  /* HARD SIGN */
+	[0x042B - CW_ALPHABET_CYRILLIC_BASE] = "-.--",   /* YERU */
+	[0x042C - CW_ALPHABET_CYRILLIC_BASE] = "-..-",   /* SOFT SIGN */
+	[0x042D - CW_ALPHABET_CYRILLIC_BASE] = "..-..",  /* E */
+	[0x042E - CW_ALPHABET_CYRILLIC_BASE] = "..--",   /* YU */
+	[0x042F - CW_ALPHABET_CYRILLIC_BASE] = ".-.-"    /* YA */
+};
+
+
+#define CW_ALPHABET_GREEK_BASE 0x0391
+static const char * const cw_alphabet_greek[] = {
+	[0x0391 - CW_ALPHABET_GREEK_BASE] = ".-",     /* ALPHA */
+	[0x0392 - CW_ALPHABET_GREEK_BASE] = "-...",   /* BETA */
+	[0x0393 - CW_ALPHABET_GREEK_BASE] = "--.",    /* GAMMA */
+	[0x0394 - CW_ALPHABET_GREEK_BASE] = "-..",    /* DELTA */
+	[0x0395 - CW_ALPHABET_GREEK_BASE] = ".",      /* EPSILON */
+	[0x0396 - CW_ALPHABET_GREEK_BASE] = "--..",   /* ZETA */
+	[0x0397 - CW_ALPHABET_GREEK_BASE] = "....",   /* ETA */
+	[0x0398 - CW_ALPHABET_GREEK_BASE] = "-.-.",   /* THETA */
+	[0x0399 - CW_ALPHABET_GREEK_BASE] = "..",     /* IOTA */
+	[0x039A - CW_ALPHABET_GREEK_BASE] = "-.-",    /* KAPPA */
+	[0x039B - CW_ALPHABET_GREEK_BASE] = ".-..",   /* LAMDA */
+	[0x039C - CW_ALPHABET_GREEK_BASE] = "--",     /* MU */
+	[0x039D - CW_ALPHABET_GREEK_BASE] = "-.",     /* NU */
+	[0x039E - CW_ALPHABET_GREEK_BASE] = "-..-",   /* XI */
+	[0x039F - CW_ALPHABET_GREEK_BASE] = "---",    /* OMICRON */
+	[0x03A0 - CW_ALPHABET_GREEK_BASE] = ".--.",   /* PI */
+	[0x03A1 - CW_ALPHABET_GREEK_BASE] = ".-.",    /* RHO */
+	[0x03A3 - CW_ALPHABET_GREEK_BASE] = "...",    /* SIGMA */
+	[0x03A4 - CW_ALPHABET_GREEK_BASE] = "-",      /* TAU */
+	[0x03A5 - CW_ALPHABET_GREEK_BASE] = "-.--",   /* UPSILON */
+	[0x03A6 - CW_ALPHABET_GREEK_BASE] = "..-.",   /* PHI */
+	[0x03A7 - CW_ALPHABET_GREEK_BASE] = "----",   /* CHI */
+	[0x03A8 - CW_ALPHABET_GREEK_BASE] = "--.-",   /* PSI */
+	[0x03A9 - CW_ALPHABET_GREEK_BASE] = ".--"     /* OMEGA */
+};
+
+
+#define CW_ALPHABET_HEBREW_BASE 0x05D0
+static const char * const cw_alphabet_hebrew[] = {
+	[0x05D0 - CW_ALPHABET_HEBREW_BASE] = ".-",     /* ALEF */
+	[0x05D1 - CW_ALPHABET_HEBREW_BASE] = "-...",   /* BET */
+	[0x05D2 - CW_ALPHABET_HEBREW_BASE] = "--.",    /* GIMEL */
+	[0x05D3 - CW_ALPHABET_HEBREW_BASE] = "-..",    /* DALET */
+	[0x05D4 - CW_ALPHABET_HEBREW_BASE] = "---",    /* HE */
+	[0x05D5 - CW_ALPHABET_HEBREW_BASE] = ".",      /* VAV */
+	[0x05D6 - CW_ALPHABET_HEBREW_BASE] = "--..",   /* ZAYIN */
+	[0x05D7 - CW_ALPHABET_HEBREW_BASE] = "....",   /* HET */
+	[0x05D8 - CW_ALPHABET_HEBREW_BASE] = "..-",    /* TET */
+	[0x05D9 - CW_ALPHABET_HEBREW_BASE] = "..",     /* YOD */
+	[0x05DB - CW_ALPHABET_HEBREW_BASE] = "-.-",    /* KAF */
+	[0x05DC - CW_ALPHABET_HEBREW_BASE] = ".-..",   /* LAMED */
+	[0x05DE - CW_ALPHABET_HEBREW_BASE] = "--",     /* MEM */
+	[0x05E0 - CW_ALPHABET_HEBREW_BASE] = "-.",     /* NUN */
+	[0x05E1 - CW_ALPHABET_HEBREW_BASE] = "-.-.",   /* SAMEKH */
+	[0x05E2 - CW_ALPHABET_HEBREW_BASE] = ".---",   /* AYIN */
+	[0x05E4 - CW_ALPHABET_HEBREW_BASE] = ".--.",   /* PE */
+	[0x05E6 - CW_ALPHABET_HEBREW_BASE] = ".--",    /* TSADI */
+	[0x05E7 - CW_ALPHABET_HEBREW_BASE] = "--.-",   /* QOF */
+	[0x05E8 - CW_ALPHABET_HEBREW_BASE] = ".-.",    /* RESH */
+	[0x05E9 - CW_ALPHABET_HEBREW_BASE] = "...",    /* SHIN */
+	[0x05EA - CW_ALPHABET_HEBREW_BASE] = "-"       /* TAV */
+};
+
+
+#define CW_ALPHABET_ARABIC_BASE 0x0621
+static const char * const cw_alphabet_arabic[] = {
+	[0x0621 - CW_ALPHABET_ARABIC_BASE] = ".",      /* HAMZA */
+	[0x0627 - CW_ALPHABET_ARABIC_BASE] = ".-",     /* ALEF */
+	[0x0628 - CW_ALPHABET_ARABIC_BASE] = "-...",   /* BEH */
+	[0x062A - CW_ALPHABET_ARABIC_BASE] = "-",      /* TEH */
+	[0x062B - CW_ALPHABET_ARABIC_BASE] = "-.-.",   /* THEH */
+	[0x062C - CW_ALPHABET_ARABIC_BASE] = ".---",   /* JEEM */
+	[0x062D - CW_ALPHABET_ARABIC_BASE] = "....",   /* HAH */
+	[0x062E - CW_ALPHABET_ARABIC_BASE] = "---",    /* KHAH */
+	[0x062F - CW_ALPHABET_ARABIC_BASE] = "-..",    /* DAL */
+	[0x0630 - CW_ALPHABET_ARABIC_BASE] = "--..",   /* THAL */
+	[0x0631 - CW_ALPHABET_ARABIC_BASE] = ".-.",    /* REH */
+	[0x0632 - CW_ALPHABET_ARABIC_BASE] = "---.",   /* ZAIN */
+	[0x0633 - CW_ALPHABET_ARABIC_BASE] = "...",    /* SEEN */
+	[0x0634 - CW_ALPHABET_ARABIC_BASE] = "----",   /* SHEEN */
+	[0x0635 - CW_ALPHABET_ARABIC_BASE] = "-..-",   /* SAD */
+	[0x0636 - CW_ALPHABET_ARABIC_BASE] = "...-",   /* DAD */
+	[0x0637 - CW_ALPHABET_ARABIC_BASE] = "..-",    /* TAH */
+	[0x0638 - CW_ALPHABET_ARABIC_BASE] = "-.--",   /* ZAH */
+	[0x0639 - CW_ALPHABET_ARABIC_BASE] = ".-.-",   /* AIN */
+	[0x063A - CW_ALPHABET_ARABIC_BASE] = "--.",    /* GHAIN */
+	[0x0641 - CW_ALPHABET_ARABIC_BASE] = "..-.",   /* FEH */
+	[0x0642 - CW_ALPHABET_ARABIC_BASE] = "--.-",   /* QAF */
+	[0x0643 - CW_ALPHABET_ARABIC_BASE] = "-.-",    /* KAF */
+	[0x0644 - CW_ALPHABET_ARABIC_BASE] = ".-..",   /* LAM */
+	[0x0645 - CW_ALPHABET_ARABIC_BASE] = "--",     /* MEEM */
+	[0x0646 - CW_ALPHABET_ARABIC_BASE] = "-.",     /* NOON */
+	[0x0647 - CW_ALPHABET_ARABIC_BASE] = "..-..",  /* HEH */
+	[0x0648 - CW_ALPHABET_ARABIC_BASE] = ".--",    /* WAW */
+	[0x064A - CW_ALPHABET_ARABIC_BASE] = ".."      /* YEH */
+};
+
+
+/* Katakana, and the voicing marks. */
+#define CW_ALPHABET_WABUN_BASE 0x309B
+static const char * const cw_alphabet_wabun[] = {
+	[0x309B - CW_ALPHABET_WABUN_BASE] = "..",      /* VOICED SOUND MARK (dakuten) */
+	[0x309C - CW_ALPHABET_WABUN_BASE] = "..--.",   /* SEMI-VOICED SOUND MARK (handakuten) */
+	[0x30A2 - CW_ALPHABET_WABUN_BASE] = "--.--",   /* A */
+	[0x30A4 - CW_ALPHABET_WABUN_BASE] = ".-",      /* I */
+	[0x30A6 - CW_ALPHABET_WABUN_BASE] = "..-",     /* U */
+	[0x30A8 - CW_ALPHABET_WABUN_BASE] = "-.---",   /* E */
+	[0x30AA - CW_ALPHABET_WABUN_BASE] = ".-...",   /* O */
+	[0x30AB - CW_ALPHABET_WABUN_BASE] = ".-..",    /* KA */
+	[0x30AD - CW_ALPHABET_WABUN_BASE] = "-.-..",   /* KI */
+	[0x30AF - CW_ALPHABET_WABUN_BASE] = "...-",    /* KU */
+	[0x30B1 - CW_ALPHABET_WABUN_BASE] = "-.--",    /* KE */
+	[0x30B3 - CW_ALPHABET_WABUN_BASE] = "----",    /* KO */
+	[0x30B5 - CW_ALPHABET_WABUN_BASE] = "-.-.-",   /* SA */
+	[0x30B7 - CW_ALPHABET_WABUN_BASE] = "--.-.",   /* SI */
+	[0x30B9 - CW_ALPHABET_WABUN_BASE] = "---.-",   /* SU */
+	[0x30BB - CW_ALPHABET_WABUN_BASE] = ".---.",   /* SE */
+	[0x30BD - CW_ALPHABET_WABUN_BASE] = "---.",    /* SO */
+	[0x30BF - CW_ALPHABET_WABUN_BASE] = "-.",      /* TA */
+	[0x30C1 - CW_ALPHABET_WABUN_BASE] = "..-.",    /* TI */
+	[0x30C4 - CW_ALPHABET_WABUN_BASE] = ".--.",    /* TU */
+	[0x30C6 - CW_ALPHABET_WABUN_BASE] = ".-.--",   /* TE */
+	[0x30C8 - CW_ALPHABET_WABUN_BASE] = "..-..",   /* TO */
+	[0x30CA - CW_ALPHABET_WABUN_BASE] = ".-.",     /* NA */
+	[0x30CB - CW_ALPHABET_WABUN_BASE] = "-.-.",    /* NI */
+	[0x30CC - CW_ALPHABET_WABUN_BASE] = "....",    /* NU */
+	[0x30CD - CW_ALPHABET_WABUN_BASE] = "--.-",    /* NE */
+	[0x30CE - CW_ALPHABET_WABUN_BASE] = "..--",    /* NO */
+	[0x30CF - CW_ALPHABET_WABUN_BASE] = "-...",    /* HA */
+	[0x30D2 - CW_ALPHABET_WABUN_BASE] = "--..-",   /* HI */
+	[0x30D5 - CW_ALPHABET_WABUN_BASE] = "--..",    /* HU */
+	[0x30D8 - CW_ALPHABET_WABUN_BASE] = ".",       /* HE */
+	[0x30DB - CW_ALPHABET_WABUN_BASE] = "-..",     /* HO */
+	[0x30DE - CW_ALPHABET_WABUN_BASE] = "-..-",    /* MA */
+	[0x30DF - CW_ALPHABET_WABUN_BASE] = "..-.-",   /* MI */
+	[0x30E0 - CW_ALPHABET_WABUN_BASE] = "-",       /* MU */
+	[0x30E1 - CW_ALPHABET_WABUN_BASE] = "-...-",   /* ME */
+	[0x30E2 - CW_ALPHABET_WABUN_BASE] = "-..-.",   /* MO */
+	[0x30E4 - CW_ALPHABET_WABUN_BASE] = ".--",     /* YA */
+	[0x30E6 - CW_ALPHABET_WABUN_BASE] = "-..--",   /* YU */
+	[0x30E8 - CW_ALPHABET_WABUN_BASE] = "--",      /* YO */
+	[0x30E9 - CW_ALPHABET_WABUN_BASE] = "...",     /* RA */
+	[0x30EA - CW_ALPHABET_WABUN_BASE] = "--.",     /* RI */
+	[0x30EB - CW_ALPHABET_WABUN_BASE] = "-.--.",   /* RU */
+	[0x30EC - CW_ALPHABET_WABUN_BASE] = "---",     /* RE */
+	[0x30ED - CW_ALPHABET_WABUN_BASE] = ".-.-",    /* RO */
+	[0x30EF - CW_ALPHABET_WABUN_BASE] = "-.-",     /* WA */
+	[0x30F0 - CW_ALPHABET_WABUN_BASE] = ".-..-",   /* WI */
+	[0x30F1 - CW_ALPHABET_WABUN_BASE] = ".--..",   /* WE */
+	[0x30F2 - CW_ALPHABET_WABUN_BASE] = ".---",    /* WO */
+	[0x30F3 - CW_ALPHABET_WABUN_BASE] = ".-.-.",   /* N */
+	[0x30FC - CW_ALPHABET_WABUN_BASE] = ".--.-"    /* PROLONGED SOUND MARK */
+};
+
+
+/* Katakana that are sent as another katakana, optionally followed
+   by a voicing mark: voiced syllables, and small forms of
+   syllables. Indexed in the same way as cw_alphabet_wabun[]. */
+static const uint16_t cw_alphabet_wabun_variants[][2] = {
+	[0x30A1 - CW_ALPHABET_WABUN_BASE] = { 0x30A2, 0 },        /* Small A */
+	[0x30A3 - CW_ALPHABET_WABUN_BASE] = { 0x30A4, 0 },        /* Small I */
+	[0x30A5 - CW_ALPHABET_WABUN_BASE] = { 0x30A6, 0 },        /* Small U */
+	[0x30A7 - CW_ALPHABET_WABUN_BASE] = { 0x30A8, 0 },        /* Small E */
+	[0x30A9 - CW_ALPHABET_WABUN_BASE] = { 0x30AA, 0 },        /* Small O */
+	[0x30AC - CW_ALPHABET_WABUN_BASE] = { 0x30AB, 0x309B },   /* GA */
+	[0x30AE - CW_ALPHABET_WABUN_BASE] = { 0x30AD, 0x309B },   /* GI */
+	[0x30B0 - CW_ALPHABET_WABUN_BASE] = { 0x30AF, 0x309B },   /* GU */
+	[0x30B2 - CW_ALPHABET_WABUN_BASE] = { 0x30B1, 0x309B },   /* GE */
+	[0x30B4 - CW_ALPHABET_WABUN_BASE] = { 0x30B3, 0x309B },   /* GO */
+	[0x30B6 - CW_ALPHABET_WABUN_BASE] = { 0x30B5, 0x309B },   /* ZA */
+	[0x30B8 - CW_ALPHABET_WABUN_BASE] = { 0x30B7, 0x309B },   /* ZI */
+	[0x30BA - CW_ALPHABET_WABUN_BASE] = { 0x30B9, 0x309B },   /* ZU */
+	[0x30BC - CW_ALPHABET_WABUN_BASE] = { 0x30BB, 0x309B },   /* ZE */
+	[0x30BE - CW_ALPHABET_WABUN_BASE] = { 0x30BD, 0x309B },   /* ZO */
+	[0x30C0 - CW_ALPHABET_WABUN_BASE] = { 0x30BF, 0x309B },   /* DA */
+	[0x30C2 - CW_ALPHABET_WABUN_BASE] = { 0x30C1, 0x309B },   /* DI */
+	[0x30C3 - CW_ALPHABET_WABUN_BASE] = { 0x30C4, 0 },        /* Small TU */
+	[0x30C5 - CW_ALPHABET_WABUN_BASE] = { 0x30C4, 0x309B },   /* DU */
+	[0x30C7 - CW_ALPHABET_WABUN_BASE] = { 0x30C6, 0x309B },   /* DE */
+	[0x30C9 - CW_ALPHABET_WABUN_BASE] = { 0x30C8, 0x309B },   /* DO */
+	[0x30D0 - CW_ALPHABET_WABUN_BASE] = { 0x30CF, 0x309B },   /* BA */
+	[0x30D1 - CW_ALPHABET_WABUN_BASE] = { 0x30CF, 0x309C },   /* PA */
+	[0x30D3 - CW_ALPHABET_WABUN_BASE] = { 0x30D2, 0x309B },   /* BI */
+	[0x30D4 - CW_ALPHABET_WABUN_BASE] = { 0x30D2, 0x309C },   /* PI */
+	[0x30D6 - CW_ALPHABET_WABUN_BASE] = { 0x30D5, 0x309B },   /* BU */
+	[0x30D7 - CW_ALPHABET_WABUN_BASE] = { 0x30D5, 0x309C },   /* PU */
+	[0x30D9 - CW_ALPHABET_WABUN_BASE] = { 0x30D8, 0x309B },   /* BE */
+	[0x30DA - CW_ALPHABET_WABUN_BASE] = { 0x30D8, 0x309C },   /* PE */
+	[0x30DC - CW_ALPHABET_WABUN_BASE] = { 0x30DB, 0x309B },   /* BO */
+	[0x30DD - CW_ALPHABET_WABUN_BASE] = { 0x30DB, 0x309C },   /* PO */
+	[0x30E3 - CW_ALPHABET_WABUN_BASE] = { 0x30E4, 0 },        /* Small YA */
+	[0x30E5 - CW_ALPHABET_WABUN_BASE] = { 0x30E6, 0 },        /* Small YU */
+	[0x30E7 - CW_ALPHABET_WABUN_BASE] = { 0x30E8, 0 },        /* Small YO */
+	[0x30EE - CW_ALPHABET_WABUN_BASE] = { 0x30EF, 0 },        /* Small WA */
+	[0x30F4 - CW_ALPHABET_WABUN_BASE] = { 0x30A6, 0x309B }    /* VU */
+};
+
+
+
+
+typedef struct {
+	uint32_t base;                        /* Codepoint of first entry of the table. */
+	uint32_t size;                        /* Count of entries of the table. */
+	const char * const * representations; /* Letters, indexed with (codepoint - base). */
+} cw_alphabet_letters_t;
+
+
+#define CW_ALPHABET_LETTERS(base, table) { (base), sizeof (table) / sizeof ((table)[0]), (table) }
+
+static const cw_alphabet_letters_t cw_alphabet_letters[CW_ALPHABET_MAX] = {
+	[CW_ALPHABET_LATIN]    = CW_ALPHABET_LETTERS(CW_ALPHABET_LATIN_BASE, cw_alphabet_latin),
+	[CW_ALPHABET_CYRILLIC] = CW_ALPHABET_LETTERS(CW_ALPHABET_CYRILLIC_BASE, cw_alphabet_cyrillic),
+	[CW_ALPHABET_GREEK]    = CW_ALPHABET_LETTERS(CW_ALPHABET_GREEK_BASE, cw_alphabet_greek),
+	[CW_ALPHABET_HEBREW]   = CW_ALPHABET_LETTERS(CW_ALPHABET_HEBREW_BASE, cw_alphabet_hebrew),
+	[CW_ALPHABET_ARABIC]   = CW_ALPHABET_LETTERS(CW_ALPHABET_ARABIC_BASE, cw_alphabet_arabic),
+	[CW_ALPHABET_WABUN]    = CW_ALPHABET_LETTERS(CW_ALPHABET_WABUN_BASE, cw_alphabet_wabun)
+};
+
+
+
+
+/* Reverse lookup tables of letters of alphabets (codepoints indexed
+   with hash of representation). */
+static uint32_t cw_alphabet_reverse[CW_ALPHABET_MAX][CW_DATA_MAX_REPRESENTATION_HASH + 1];
+static pthread_once_t cw_alphabet_once = PTHREAD_ONCE_INIT;
+
+
+
+
+static void     cw_alphabet_init_internal(void);
+static uint32_t cw_alphabet_fold_internal(int alphabet, uint32_t codepoint);
+static const char * cw_alphabet_letter_internal(int alphabet, uint32_t codepoint);
+
+
+
+
+/**
+   \brief Build reverse lookup tables of letters of alphabets
+
+   Called once, through pthread_once().
+*/
+void cw_alphabet_init_internal(void)
+{
+	for (int alphabet = 0; alphabet < CW_ALPHABET_MAX; alphabet++) {
+		uint32_t *reverse = cw_alphabet_reverse[alphabet];
+		const cw_alphabet_letters_t *letters = &cw_alphabet_letters[alphabet];
+
+		for (uint32_t i = 0; i < letters->size; i++) {
+			if (letters->representations[i]) {
+				const uint8_t hash = cw_representation_to_hash_internal(letters->representations[i]);
+				if (hash && !reverse[hash]) {
+					reverse[hash] = letters->base + i;
+				}
+			}
+		}
+	}
+
+	cw_debug_msg (&cw_debug_object, CW_DEBUG_LOOKUPS, CW_DEBUG_INFO,
+		      MSG_PREFIX "initialized lookup tables");
+
+	return;
+}
+
+
+
+
+/**
+   \brief Convert a codepoint to codepoint of letter that is in table of alphabet
+
+   Lowercase letters are converted to uppercase letters, final forms
+   of Hebrew letters to regular forms, and Hiragana to Katakana.
+
+   \param alphabet - alphabet
+   \param codepoint - codepoint to convert
+
+   \return converted codepoint
+*/
+uint32_t cw_alphabet_fold_internal(int alphabet, uint32_t codepoint)
+{
+	switch (alphabet) {
+	case CW_ALPHABET_LATIN:
+		if (codepoint >= 0x00E0 && codepoint <= 0x00FE && codepoint != 0x00F7) {
+			return codepoint - 0x20;
+		} else if (codepoint == 0x015F || codepoint == 0x017C) {
+			return codepoint - 1;
+		}
+		break;
+
+	case CW_ALPHABET_CYRILLIC:
+		if (codepoint >= 0x0430 && codepoint <= 0x044F) {
+			return codepoint - 0x20;
+		} else if (codepoint == 0x0401 || codepoint == 0x0451) {
+			return 0x0415; /* IO is sent as IE. */
+		}
+		break;
+
+	case CW_ALPHABET_GREEK:
+		if (codepoint == 0x03C2) {
+			return 0x03A3; /* Final sigma. */
+		} else if (codepoint >= 0x03B1 && codepoint <= 0x03C9) {
+			return codepoint - 0x20;
+		}
+		break;
+
+	case CW_ALPHABET_HEBREW:
+		/* Final forms precede regular forms. */
+		if (codepoint == 0x05DA || codepoint == 0x05DD || codepoint == 0x05DF
+		    || codepoint == 0x05E3 || codepoint == 0x05E5) {
+			return codepoint + 1;
+		}
+		break;
+
+	case CW_ALPHABET_WABUN:
+		if (codepoint >= 0x3041 && codepoint <= 0x3096) {
+			return codepoint + 0x60;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return codepoint;
+}
+
+
+
+
+/**
+   \brief Get representation of a letter of alphabet
+
+   \param alphabet - alphabet
+   \param codepoint - folded codepoint of the letter
+
+   \return representation, or NULL if alphabet doesn't have the letter
+*/
+const char * cw_alphabet_letter_internal(int alphabet, uint32_t codepoint)
+{
+	const cw_alphabet_letters_t *letters = &cw_alphabet_letters[alphabet];
+	const uint32_t i = codepoint - letters->base; /* Wraps around for codepoints below base. */
+
+	return i < letters->size ? letters->representations[i] : (const char *) NULL;
+}
+
+
+
+
+/**
+   \brief Get representations of a Unicode character in given alphabet
+
+   Most characters have one representation. Some Wabun kana are
+   sent as two characters (a kana followed by a voicing mark).
+
+   Numerals, punctuation and procedural signals of main table of
+   characters are available in all alphabets, Latin letters only in
+   Latin alphabet. The lookup doesn't allocate memory; returned
+   representations are owned by library.
+
+   \errno EINVAL - invalid alphabet
+   \errno ENOENT - the character doesn't have a representation
+
+   \param alphabet - alphabet (CW_ALPHABET_*)
+   \param codepoint - codepoint of the character
+   \param representations - buffer for CW_ALPHABET_REPRESENTATIONS_MAX representations
+
+   \return count of representations on success
+   \return zero on failure
+*/
+int cw_alphabet_codepoint_to_representations(int alphabet, uint32_t codepoint, const char * representations[CW_ALPHABET_REPRESENTATIONS_MAX])
+{
+	if (alphabet < 0 || alphabet >= CW_ALPHABET_MAX) {
+		errno = EINVAL;
+		return 0;
+	}
+
+	pthread_once(&cw_alphabet_once, cw_alphabet_init_internal);
+
+	if (codepoint < 128) {
+		/* Non-Latin alphabets don't use Latin letters. */
+		const char *representation = alphabet == CW_ALPHABET_LATIN || !isalpha((int) codepoint)
+			? cw_character_to_representation_internal((int) codepoint)
+			: NULL;
+		if (representation) {
+			representations[0] = representation;
+			return 1;
+		}
+		errno = ENOENT;
+		return 0;
+	}
+
+	codepoint = cw_alphabet_fold_internal(alphabet, codepoint);
+
+	const char *representation = cw_alphabet_letter_internal(alphabet, codepoint);
+	if (representation) {
+		representations[0] = representation;
+		return 1;
+	}
+
+	if (alphabet == CW_ALPHABET_WABUN) {
+		const uint32_t i = codepoint - CW_ALPHABET_WABUN_BASE;
+		if (i < sizeof (cw_alphabet_wabun_variants) / sizeof (cw_alphabet_wabun_variants[0])
+		    && cw_alphabet_wabun_variants[i][0]) {
+
+			int n = 0;
+			representations[n++] = cw_alphabet_letter_internal(alphabet, cw_alphabet_wabun_variants[i][0]);
+			if (cw_alphabet_wabun_variants[i][1]) {
+				representations[n++] = cw_alphabet_letter_internal(alphabet, cw_alphabet_wabun_variants[i][1]);
+			}
+			return n;
+		}
+	}
+
+	errno = ENOENT;
+	return 0;
+}
+
+
+
+
+/**
+   \brief Get Unicode character corresponding to representation in given alphabet
+
+   \errno EINVAL - invalid alphabet or invalid representation
+   \errno ENOENT - there is no character for the representation
+
+   \param alphabet - alphabet (CW_ALPHABET_*)
+   \param representation - representation to look up
+
+   \return codepoint of character on success
+   \return zero on failure
+*/
+uint32_t cw_alphabet_representation_to_codepoint(int alphabet, const char * representation)
+{
+	if (alphabet < 0 || alphabet >= CW_ALPHABET_MAX) {
+		errno = EINVAL;
+		return 0;
+	}
+
+	pthread_once(&cw_alphabet_once, cw_alphabet_init_internal);
+
+	const uint8_t hash = cw_representation_to_hash_internal(representation);
+	if (!hash) {
+		errno = EINVAL;
+		return 0;
+	}
+
+	/* Letters of the alphabet take precedence over ASCII
+	   characters. */
+	uint32_t codepoint = cw_alphabet_reverse[alphabet][hash];
+	if (!codepoint) {
+		const int c = cw_representation_to_character_internal(representation);
+		if (c > 0 && c < 128 && (alphabet == CW_ALPHABET_LATIN || !isalpha(c))) {
+			codepoint = (uint32_t) c;
+		}
+	}
+	if (!codepoint) {
+		errno = ENOENT;
+		return 0;
+	}
+
+	return codepoint;
+}
+
+
+
+
+/**
+   \brief Decode one character of UTF-8 string
+
+   On success \p string is moved past the decoded character.
+   Overlong forms, surrogates and codepoints above U+10FFFF are
+   rejected.
+
+   \param string - pointer to position in string
+   \param codepoint - decoded codepoint
+
+   \return true on success
+   \return false if the string at given position isn't valid UTF-8
+*/
+bool cw_utf8_decode_internal(const char ** string, uint32_t * codepoint)
+{
+	const unsigned char *s = (const unsigned char *) *string;
+	uint32_t cp;
+	int n_continuation;
+
+	if (s[0] < 0x80) {
+		cp = s[0];
+		n_continuation = 0;
+	} else if ((s[0] & 0xE0) == 0xC0) {
+		cp = s[0] & 0x1F;
+		n_continuation = 1;
+	} else if ((s[0] & 0xF0) == 0xE0) {
+		cp = s[0] & 0x0F;
+		n_continuation = 2;
+	} else if ((s[0] & 0xF8) == 0xF0) {
+		cp = s[0] & 0x07;
+		n_continuation = 3;
+	} else {
+		return false;
+	}
+
+	for (int i = 1; i <= n_continuation; i++) {
+		/* Also stops at terminating NUL. */
+		if ((s[i] & 0xC0) != 0x80) {
+			return false;
+		}
+		cp = (cp << 6) | (s[i] & 0x3F);
+	}
+
+	static const uint32_t min[] = { 0, 0x80, 0x800, 0x10000 };
+	if (cp < min[n_continuation] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+		return false;
+	}
+
+	*codepoint = cp;
+	*string += n_continuation + 1;
+
+	return true;
+}
+
+
+
+
+/**
+   \brief Encode a codepoint in UTF-8
+
+   \p buffer must have space for CW_ALPHABET_UTF8_SIZE bytes. The
+   encoded character is terminated with NUL.
+
+   \param codepoint - codepoint to encode
+   \param buffer - output buffer
+
+   \return count of bytes of encoded character (without NUL)
+*/
+int cw_utf8_encode_internal(uint32_t codepoint, char * buffer)
+{
+	unsigned char *b = (unsigned char *) buffer;
+	int n;
+
+	if (codepoint < 0x80) {
+		b[0] = (unsigned char) codepoint;
+		n = 1;
+	} else if (codepoint < 0x800) {
+		b[0] = (unsigned char) (0xC0 | (codepoint >> 6));
+		b[1] = (unsigned char) (0x80 | (codepoint & 0x3F));
+		n = 2;
+	} else if (codepoint < 0x10000) {
+		b[0] = (unsigned char) (0xE0 | (codepoint >> 12));
+		b[1] = (unsigned char) (0x80 | ((codepoint >> 6) & 0x3F));
+		b[2] = (unsigned char) (0x80 | (codepoint & 0x3F));
+		n = 3;
+	} else {
+		b[0] = (unsigned char) (0xF0 | (codepoint >> 18));
+		b[1] = (unsigned char) (0x80 | ((codepoint >> 12) & 0x3F));
+		b[2] = (unsigned char) (0x80 | ((codepoint >> 6) & 0x3F));
+		b[3] = (unsigned char) (0x80 | (codepoint & 0x3F));
+		n = 4;
+	}
+	b[n] = '\0';
+
+	return n;
+}
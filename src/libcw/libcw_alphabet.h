@@ -0,0 +1,47 @@
+/*
+  This file is a part of unixcw project.
+  unixcw project is covered by GNU General Public License, version 2 or later.
+*/
+
+#ifndef H_LIBCW_ALPHABET
+#define H_LIBCW_ALPHABET
+
+
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+
+
+/* Morse alphabets. Letters of non-Latin alphabets replace Latin
+   letters; numerals and punctuation are shared by all alphabets. */
+enum {
+	CW_ALPHABET_LATIN = 0,  /* Main table of characters (ASCII, ISO 8859-1 and -2 letters). */
+	CW_ALPHABET_CYRILLIC,   /* Russian. */
+	CW_ALPHABET_GREEK,
+	CW_ALPHABET_HEBREW,
+	CW_ALPHABET_ARABIC,
+	CW_ALPHABET_WABUN,      /* Japanese kana. */
+	CW_ALPHABET_MAX
+};
+
+/* Size of buffer for one character encoded in UTF-8, with
+   terminating NUL. */
+#define CW_ALPHABET_UTF8_SIZE 5
+
+/* Count of representations of a codepoint, at most. Wabun kana
+   with voicing marks are sent as two characters. */
+#define CW_ALPHABET_REPRESENTATIONS_MAX 2
+
+
+
+
+bool cw_utf8_decode_internal(const char ** string, uint32_t * codepoint);
+int  cw_utf8_encode_internal(uint32_t codepoint, char * buffer);
+
+
+
+
+#endif /* #ifndef H_LIBCW_ALPHABET */
@@ -81,6 +81,7 @@ static const snd_pcm_format_t CW_ALSA_SAMPLE_FORMAT = SND_PCM_FORMAT_S16; /* "Si
 static int  cw_alsa_set_hw_params_internal(cw_gen_t *gen, snd_pcm_hw_params_t * hw_params);
 static int  cw_alsa_dlsym_internal(void *handle);
 static int  cw_alsa_write_internal(cw_gen_t *gen);
+static int64_t cw_alsa_get_delay_internal(cw_gen_t *gen);
 static int  cw_alsa_debug_evaluate_write_internal(cw_gen_t *gen, int rv);
 static int  cw_alsa_open_device_internal(cw_gen_t *gen);
 static void cw_alsa_close_device_internal(cw_gen_t *gen);
@@ -107,6 +108,7 @@ static struct {
 	int (* snd_pcm_close)(snd_pcm_t *pcm);
 	int (* snd_pcm_prepare)(snd_pcm_t *pcm);
 	int (* snd_pcm_drop)(snd_pcm_t *pcm);
+	int (* snd_pcm_delay)(snd_pcm_t *pcm, snd_pcm_sframes_t *delayp);
 	snd_pcm_sframes_t (* snd_pcm_writei)(snd_pcm_t *pcm, const void *buffer, snd_pcm_uframes_t size);
 
 	const char *(* snd_strerror)(int errnum);
@@ -129,6 +131,7 @@ static struct {
 	.snd_pcm_close = NULL,
 	.snd_pcm_prepare = NULL,
 	.snd_pcm_drop = NULL,
+	.snd_pcm_delay = NULL,
 	.snd_pcm_writei = NULL,
 
 	.snd_strerror = NULL,
@@ -217,6 +220,7 @@ int cw_alsa_configure(cw_gen_t *gen, const char *device)
 	gen->open_device  = cw_alsa_open_device_internal;
 	gen->close_device = cw_alsa_close_device_internal;
 	gen->write        = cw_alsa_write_internal;
+	gen->get_delay    = cw_alsa_get_delay_internal;
 
 	return CW_SUCCESS;
 }
@@ -242,11 +246,13 @@ int cw_alsa_write_internal(cw_gen_t *gen)
 	/* Send audio buffer to ALSA.
 	   Size of correct and current data in the buffer is the same as
 	   ALSA's period, so there should be no underruns */
-	int rv = cw_alsa.snd_pcm_writei(gen->alsa_data.handle, gen->buffer, gen->buffer_n_samples);
+	int n_samples = 0;
+	const cw_sample_t * buffer = cw_gen_get_sink_buffer_internal(gen, &n_samples);
+	int rv = cw_alsa.snd_pcm_writei(gen->alsa_data.handle, buffer, n_samples);
 	rv = cw_alsa_debug_evaluate_write_internal(gen, rv); /* TODO: fix reusing rv variable. */
 	/*
 	cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_SOUND_SYSTEM, CW_DEBUG_INFO,
-		      MSG_PREFIX "write: written %d/%d samples", rv, gen->buffer_n_samples);
+		      MSG_PREFIX "write: written %d/%d samples", rv, n_samples);
 	*/
 	return rv;
 }
@@ -254,6 +260,30 @@ int cw_alsa_write_internal(cw_gen_t *gen)
 
 
 
+/**
+   \brief Get delay of ALSA audio sink
+
+   \param gen - generator
+
+   \return time after which a sample written now will be played [us]
+   \return -1 if the delay can't be determined
+*/
+int64_t cw_alsa_get_delay_internal(cw_gen_t *gen)
+{
+	snd_pcm_sframes_t n_frames = 0;
+	const int rv = cw_alsa.snd_pcm_delay(gen->alsa_data.handle, &n_frames);
+	if (rv < 0) {
+		cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_SOUND_SYSTEM, CW_DEBUG_WARNING,
+			      MSG_PREFIX "get delay: snd_pcm_delay(): %s", cw_alsa.snd_strerror(rv));
+		return -1;
+	}
+
+	return (int64_t) n_frames * CW_USECS_PER_SEC / cw_gen_get_sink_sample_rate_internal(gen);
+}
+
+
+
+
 /**
    \brief Open ALSA output, associate it with given generator
 
@@ -385,6 +415,9 @@ void cw_alsa_close_device_internal(cw_gen_t *gen)
 */
 int cw_alsa_debug_evaluate_write_internal(cw_gen_t *gen, int rv)
 {
+	int n_samples = 0;
+	cw_gen_get_sink_buffer_internal(gen, &n_samples);
+
 	if (rv == -EPIPE) {
 		cw_debug_msg (&cw_debug_object, CW_DEBUG_SOUND_SYSTEM, CW_DEBUG_WARNING,
 			      MSG_PREFIX "write: underrun");
@@ -395,9 +428,9 @@ int cw_alsa_debug_evaluate_write_internal(cw_gen_t *gen, int rv)
 			      MSG_PREFIX "write: writei: %s", cw_alsa.snd_strerror(rv));
 		cw_alsa.snd_pcm_prepare(gen->alsa_data.handle);  /* Reset audio sink. */
 
-	} else if (rv != gen->buffer_n_samples) {
+	} else if (rv != n_samples) {
 		cw_debug_msg ((&cw_debug_object), CW_DEBUG_SOUND_SYSTEM, CW_DEBUG_WARNING,
-			      MSG_PREFIX "short write, %d != %d", rv, gen->buffer_n_samples);
+			      MSG_PREFIX "short write, %d != %d", rv, n_samples);
 	} else {
 		return CW_SUCCESS;
 	}
@@ -737,6 +770,9 @@ static int cw_alsa_dlsym_internal(void *handle)
 	*(void **) &(cw_alsa.snd_pcm_writei)  = dlsym(handle, "snd_pcm_writei");
 	if (!cw_alsa.snd_pcm_writei)  { return -5; }
 
+	*(void **) &(cw_alsa.snd_pcm_delay)   = dlsym(handle, "snd_pcm_delay");
+	if (!cw_alsa.snd_pcm_delay)   { return -6; }
+
 	*(void **) &(cw_alsa.snd_strerror) = dlsym(handle, "snd_strerror");
 	if (!cw_alsa.snd_strerror) { return -10; }
 
@@ -0,0 +1,777 @@
+/*
+  Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+  Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+/**
+   \file libcw_analyzer.c
+
+   \brief Analysis of quality of sending.
+
+   Analyzer is fed with key events (e.g. read from a trace, see
+   libcw_trace.c). A receiver in adaptive mode recognizes characters
+   in the keying, and analyzer matches marks of every recognized
+   character with its representation, so that lengths of Dots, Dashes
+   and spaces of every character are known.
+
+   The analysis is done in a single pass over the events, and uses
+   constant memory: statistics are running statistics, the
+   speed-over-time curve has fixed count of points (adjacent points
+   are merged when the curve is full), and only a small number of the
+   most frequent unrecognized representations is tracked.
+
+   Receiver's own statistics (cw_rec_get_statistics_internal())
+   cover only last few hundreds of marks and don't distinguish
+   characters.
+*/
+
+
+
+
+#include "config.h"
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+
+#include "libcw_analyzer.h"
+#include "libcw_rec.h"
+#include "libcw_key.h"
+#include "libcw_data.h"
+#include "libcw_debug.h"
+#include "libcw_utils.h"
+#include "libcw2.h"
+
+
+
+
+#define MSG_PREFIX "libcw/analyzer: "
+
+
+
+
+/* From libcw_debug.c. */
+extern cw_debug_t cw_debug_object;
+extern cw_debug_t cw_debug_object_dev;
+
+
+
+
+static void    cw_analyzer_stat_add_internal(cw_analyzer_stat_t * stat, double value);
+static void    cw_analyzer_stat_merge_internal(cw_analyzer_stat_t * stat, const cw_analyzer_stat_t * other);
+static int64_t cw_analyzer_timestamp_diff_internal(const struct timeval * earlier, const struct timeval * later);
+static void    cw_analyzer_poll_internal(cw_analyzer_t * an, const struct timeval * timestamp);
+static void    cw_analyzer_add_character_internal(cw_analyzer_t * an, char c, const char * representation, bool is_end_of_word);
+static void    cw_analyzer_add_unknown_internal(cw_analyzer_t * an, const char * representation);
+static void    cw_analyzer_add_speed_point_internal(cw_analyzer_t * an, double speed);
+
+
+
+
+/**
+   \brief Create new analyzer
+
+   \errno ENOMEM - failed to allocate memory
+
+   \return pointer to new analyzer on success
+   \return NULL on failure
+*/
+cw_analyzer_t * cw_analyzer_new(void)
+{
+	cw_analyzer_t * an = (cw_analyzer_t *) calloc(1, sizeof (cw_analyzer_t));
+	if (!an) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR, MSG_PREFIX "calloc()");
+		errno = ENOMEM;
+		return (cw_analyzer_t *) NULL;
+	}
+
+	an->rec = cw_rec_new();
+	if (!an->rec) {
+		free(an);
+		errno = ENOMEM;
+		return (cw_analyzer_t *) NULL;
+	}
+	cw_rec_enable_adaptive_mode(an->rec);
+
+	an->speed_interval = CW_ANALYZER_SPEED_INTERVAL_INITIAL;
+
+	return an;
+}
+
+
+
+
+/**
+   \brief Delete analyzer
+
+   Pointer to \p an is set to NULL.
+
+   \param an - pointer to analyzer
+*/
+void cw_analyzer_delete(cw_analyzer_t ** an)
+{
+	cw_assert (an, MSG_PREFIX "delete: pointer to analyzer is NULL");
+
+	if (!*an) {
+		return;
+	}
+
+	cw_rec_delete(&(*an)->rec);
+
+	free(*an);
+	*an = (cw_analyzer_t *) NULL;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Set initial speed and tolerance of analyzer's receiver
+
+   Receiver of analyzer works in adaptive mode, but the initial speed
+   should be close to speed of analyzed keying. A character that is
+   being received is completed before the parameters are changed.
+
+   \param an - analyzer
+   \param speed - initial speed [wpm]; zero for no change
+   \param tolerance - tolerance of receiver; zero for no change
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_analyzer_set_parameters(cw_analyzer_t * an, int speed, int tolerance)
+{
+	cw_analyzer_flush(an);
+
+	int rv = CW_SUCCESS;
+	cw_rec_disable_adaptive_mode(an->rec);
+	if (speed && CW_SUCCESS != cw_rec_set_speed(an->rec, speed)) {
+		rv = CW_FAILURE;
+	}
+	if (tolerance && CW_SUCCESS != cw_rec_set_tolerance(an->rec, tolerance)) {
+		rv = CW_FAILURE;
+	}
+	/* Adaptive threshold is derived from speed only during sync
+	   in fixed speed mode. */
+	cw_rec_sync_parameters_internal(an->rec);
+	cw_rec_enable_adaptive_mode(an->rec);
+
+	return rv;
+}
+
+
+
+
+/**
+   \brief Add key event to analysis
+
+   Events must be added in chronological order.
+
+   \errno EINVAL - invalid timestamp
+
+   \param an - analyzer
+   \param timestamp - time of change of key's state
+   \param key_state - new state of key (CW_KEY_STATE_OPEN or CW_KEY_STATE_CLOSED)
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_analyzer_add_event(cw_analyzer_t * an, const struct timeval * timestamp, int key_state)
+{
+	if (!timestamp || timestamp->tv_usec < 0 || timestamp->tv_usec >= CW_USECS_PER_SEC) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	an->n_events++;
+
+	if (key_state == CW_KEY_STATE_CLOSED) {
+		if (an->is_mark) {
+			/* Repeated "key down" event. */
+			return CW_SUCCESS;
+		}
+		/* Beginning of mark may end a character that is in receiver. */
+		cw_analyzer_poll_internal(an, timestamp);
+
+		if (CW_SUCCESS != cw_rec_mark_begin(an->rec, timestamp)) {
+			an->n_rejected++;
+			return CW_SUCCESS;
+		}
+		an->pending_mark_begin = *timestamp;
+		an->is_mark = true;
+
+	} else {
+		if (!an->is_mark) {
+			return CW_SUCCESS;
+		}
+		an->is_mark = false;
+
+		if (CW_SUCCESS != cw_rec_mark_end(an->rec, timestamp)) {
+			an->n_rejected++;
+			if (ENOMEM == errno) {
+				/* Representation is too long to be a character. */
+				cw_rec_reset_state(an->rec);
+				an->n_marks = 0;
+			}
+			/* EAGAIN: noise spike, receiver has already forgotten the mark. */
+			return CW_SUCCESS;
+		}
+
+		if (an->n_marks < CW_REC_REPRESENTATION_CAPACITY) {
+			an->mark_begin[an->n_marks] = an->pending_mark_begin;
+			an->mark_end[an->n_marks] = *timestamp;
+			an->n_marks++;
+		}
+	}
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Complete analysis of character that is being received
+
+   Call this function after last event has been added.
+
+   \param an - analyzer
+*/
+void cw_analyzer_flush(cw_analyzer_t * an)
+{
+	if (!an->n_marks || an->is_mark) {
+		return;
+	}
+
+	/* Long space after last mark ends the character and the word. */
+	struct timeval t = an->mark_end[an->n_marks - 1];
+	t.tv_sec += 10;
+	cw_analyzer_poll_internal(an, &t);
+
+	return;
+}
+
+
+
+
+/**
+   \brief Analyze whole trace
+
+   Parameters of receiver are updated at the beginning of every
+   session of the trace.
+
+   \errno EINVAL - trace is malformed
+
+   \param an - analyzer
+   \param reader - reader of trace
+
+   \return CW_SUCCESS when whole trace has been analyzed
+   \return CW_FAILURE on failure
+*/
+int cw_analyzer_add_trace(cw_analyzer_t * an, cw_trace_reader_t * reader)
+{
+	int session = 0;
+	cw_trace_event_t event;
+	while (CW_SUCCESS == cw_trace_reader_next(reader, &event)) {
+		if (event.session != session) {
+			cw_trace_header_t header;
+			cw_trace_reader_get_header(reader, &header);
+			cw_analyzer_set_parameters(an, header.speed, header.tolerance);
+			session = event.session;
+		}
+		cw_analyzer_add_event(an, &event.timestamp, event.key_state);
+	}
+	if (ENOENT != errno) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	cw_analyzer_flush(an);
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Get statistics of given character
+
+   \errno ENOENT - \p c is not a character that has statistics
+
+   \param an - analyzer
+   \param c - character
+
+   \return pointer to statistics on success
+   \return NULL on failure
+*/
+const cw_analyzer_character_t * cw_analyzer_get_character(const cw_analyzer_t * an, char c)
+{
+	const int i = (unsigned char) c;
+	if (i >= CW_ANALYZER_N_CHARACTERS) {
+		errno = ENOENT;
+		return (const cw_analyzer_character_t *) NULL;
+	}
+
+	return &an->characters[i];
+}
+
+
+
+
+/**
+   \brief Get characters most frequently sent mis-formed
+
+   Characters are sorted by ratio of mis-formed characters to all
+   received characters, in descending order. Characters that were
+   never mis-formed are not returned.
+
+   \param an - analyzer
+   \param characters - output buffer, at least \p n_max + 1 bytes long; will be NUL-terminated
+   \param n_max - maximal count of returned characters
+
+   \return count of characters put into \p characters
+*/
+int cw_analyzer_get_malformed_characters(const cw_analyzer_t * an, char * characters, int n_max)
+{
+	int n = 0;
+	for (int i = 0; i < CW_ANALYZER_N_CHARACTERS; i++) {
+		const cw_analyzer_character_t * ch = &an->characters[i];
+		if (!ch->n_malformed) {
+			continue;
+		}
+		const double ratio = 1.0 * ch->n_malformed / ch->n;
+
+		/* Insertion into sorted, bounded list. */
+		int k = n < n_max ? n : n_max - 1;
+		if (k < 0) {
+			break;
+		}
+		if (n == n_max) {
+			const cw_analyzer_character_t * last = &an->characters[(unsigned char) characters[k]];
+			if (1.0 * last->n_malformed / last->n >= ratio) {
+				continue;
+			}
+		}
+		while (k > 0) {
+			const cw_analyzer_character_t * prev = &an->characters[(unsigned char) characters[k - 1]];
+			if (1.0 * prev->n_malformed / prev->n >= ratio) {
+				break;
+			}
+			characters[k] = characters[k - 1];
+			k--;
+		}
+		characters[k] = (char) i;
+		if (n < n_max) {
+			n++;
+		}
+	}
+	characters[n] = '\0';
+
+	return n;
+}
+
+
+
+
+/**
+   \brief Get one of most frequent unrecognized representations
+
+   Representations are sorted by frequency, in descending order.
+
+   \errno ENOENT - there is no representation with index \p i
+
+   \param an - analyzer
+   \param i - index of representation
+   \param representation - output buffer, at least CW_ANALYZER_UNKNOWN_LEN + 1 bytes long
+   \param count - how many times the representation has been received (approximately, if more than CW_ANALYZER_N_UNKNOWN distinct representations were received)
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_analyzer_get_unknown(const cw_analyzer_t * an, int i, char * representation, int64_t * count)
+{
+	if (i < 0 || i >= an->n_unknown_slots) {
+		errno = ENOENT;
+		return CW_FAILURE;
+	}
+
+	/* Table is small: find i-th most frequent entry by counting
+	   entries that precede it. */
+	for (int k = 0; k < an->n_unknown_slots; k++) {
+		int rank = 0;
+		for (int m = 0; m < an->n_unknown_slots; m++) {
+			if (an->unknown[m].count > an->unknown[k].count
+			    || (an->unknown[m].count == an->unknown[k].count && m < k)) {
+				rank++;
+			}
+		}
+		if (rank == i) {
+			strcpy(representation, an->unknown[k].representation);
+			*count = an->unknown[k].count;
+			return CW_SUCCESS;
+		}
+	}
+
+	errno = ENOENT;
+	return CW_FAILURE;
+}
+
+
+
+
+/**
+   \brief Get speed-over-time curve
+
+   Points of the curve are average speeds of characters received in
+   consecutive intervals of keying time. Pauses longer than
+   CW_ANALYZER_PAUSE_LEN_MAX are shortened on time axis.
+
+   \param an - analyzer
+   \param speeds - output buffer for speeds [wpm], at least CW_ANALYZER_SPEED_POINTS_MAX items long; zero for intervals without characters
+   \param interval - length of interval represented by one point [us]
+
+   \return count of points of the curve
+*/
+int cw_analyzer_get_speed_curve(const cw_analyzer_t * an, double * speeds, int64_t * interval)
+{
+	for (int i = 0; i < an->n_speed_points; i++) {
+		speeds[i] = an->speed_points[i].n ? an->speed_points[i].sum / an->speed_points[i].n : 0.0;
+	}
+	*interval = an->speed_interval;
+
+	return an->n_speed_points;
+}
+
+
+
+
+/**
+   \brief Estimate weighting of sending
+
+   The estimate uses lengths of Dots and Dashes: difference between
+   them is two units, and weighting makes both of them longer (or
+   shorter) by the same amount. Value of 50 means no weighting, as in
+   cw_gen_set_weighting().
+
+   \errno ENOENT - no Dots or Dashes have been received
+
+   \param an - analyzer
+   \param weighting - estimated weighting
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_analyzer_get_weighting(const cw_analyzer_t * an, double * weighting)
+{
+	if (!an->dot.n || !an->dash.n || an->dash.mean <= an->dot.mean) {
+		errno = ENOENT;
+		return CW_FAILURE;
+	}
+
+	const double unit = (an->dash.mean - an->dot.mean) / 2.0;
+	*weighting = 50.0 + 50.0 * (an->dot.mean - unit) / unit;
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Estimate ratio of length of Dash to length of Dot
+
+   \errno ENOENT - no Dots or Dashes have been received
+
+   \param an - analyzer
+   \param ratio - estimated ratio (3.0 for ideal keying)
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_analyzer_get_ratio(const cw_analyzer_t * an, double * ratio)
+{
+	if (!an->dot.n || !an->dash.n) {
+		errno = ENOENT;
+		return CW_FAILURE;
+	}
+
+	*ratio = an->dash.mean / an->dot.mean;
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Get standard deviation of values of statistics
+
+   \param stat - statistics
+
+   \return standard deviation (zero for less than two values)
+*/
+double cw_analyzer_stat_get_sd(const cw_analyzer_stat_t * stat)
+{
+	return stat->n > 1 ? sqrt(stat->m2 / (stat->n - 1)) : 0.0;
+}
+
+
+
+
+/**
+   \brief Get complete character from receiver, if there is one
+*/
+void cw_analyzer_poll_internal(cw_analyzer_t * an, const struct timeval * timestamp)
+{
+	char representation[CW_REC_REPRESENTATION_CAPACITY + 1];
+	bool is_end_of_word = false;
+	bool is_error = false;
+
+	if (CW_SUCCESS != cw_rec_poll_representation(an->rec, timestamp, representation, &is_end_of_word, &is_error)) {
+		/* EAGAIN: space is too short to end a character;
+		   ERANGE: receiver is idle. */
+		return;
+	}
+
+	const int c = cw_representation_to_character_internal(representation);
+	if (c) {
+		cw_analyzer_add_character_internal(an, (char) c, representation, is_end_of_word);
+	} else {
+		an->n_unknown++;
+		cw_analyzer_add_unknown_internal(an, representation);
+		an->has_prev = false;
+	}
+
+	cw_rec_reset_state(an->rec);
+	an->n_marks = 0;
+
+	return;
+}
+
+
+
+
+void cw_analyzer_add_character_internal(cw_analyzer_t * an, char c, const char * representation, bool is_end_of_word)
+{
+	an->n_characters++;
+	if (is_end_of_word) {
+		an->n_words++;
+	}
+
+	const int n = an->n_marks;
+	if ((int) strlen(representation) != n || !n) {
+		/* Marks don't match representation (this should not
+		   happen). Timings of the character are unknown. */
+		an->has_prev = false;
+		return;
+	}
+
+	const struct timeval * begin = &an->mark_begin[0];
+	const struct timeval * end = &an->mark_end[n - 1];
+
+	/* Spaces between characters. */
+	if (an->has_prev) {
+		const int64_t space = cw_analyzer_timestamp_diff_internal(&an->prev_end, begin);
+		cw_analyzer_stat_add_internal(an->prev_is_end_of_word ? &an->iword_space : &an->ichar_space, (double) space);
+
+		int64_t pause = cw_analyzer_timestamp_diff_internal(&an->prev_begin, begin);
+		if (pause > CW_ANALYZER_PAUSE_LEN_MAX) {
+			pause = CW_ANALYZER_PAUSE_LEN_MAX;
+		}
+		an->keying_time += pause;
+	}
+
+	/* Speed of character: count of units in the character vs. its length. */
+	int units = n - 1;
+	for (int i = 0; i < n; i++) {
+		units += representation[i] == CW_DOT_REPRESENTATION ? 1 : 3;
+	}
+	const double unit = (double) cw_analyzer_timestamp_diff_internal(begin, end) / units;
+	if (unit <= 0.0) {
+		an->has_prev = false;
+		return;
+	}
+	const double speed = CW_DOT_CALIBRATION / unit;
+
+	cw_analyzer_character_t * ch = (unsigned char) c < CW_ANALYZER_N_CHARACTERS
+		? &an->characters[(unsigned char) c]
+		: (cw_analyzer_character_t *) NULL;
+
+	/* Elements of character. */
+	bool is_malformed = false;
+	for (int i = 0; i < n; i++) {
+		const double len = (double) cw_analyzer_timestamp_diff_internal(&an->mark_begin[i], &an->mark_end[i]);
+		const bool is_dot = representation[i] == CW_DOT_REPRESENTATION;
+		const double ideal = is_dot ? unit : 3 * unit;
+
+		cw_analyzer_stat_add_internal(is_dot ? &an->dot : &an->dash, len);
+		if (ch) {
+			cw_analyzer_stat_add_internal(is_dot ? &ch->dot : &ch->dash, len);
+		}
+		if (fabs(len - ideal) * 100 > ideal * CW_ANALYZER_MALFORMED_TOLERANCE) {
+			is_malformed = true;
+		}
+
+		int bin = (int) (len * CW_ANALYZER_HISTOGRAM_BINS_PER_UNIT / unit);
+		if (bin >= CW_ANALYZER_HISTOGRAM_SIZE) {
+			bin = CW_ANALYZER_HISTOGRAM_SIZE - 1;
+		}
+		an->histogram[bin]++;
+
+		if (i > 0) {
+			const double space = (double) cw_analyzer_timestamp_diff_internal(&an->mark_end[i - 1], &an->mark_begin[i]);
+			cw_analyzer_stat_add_internal(&an->imark_space, space);
+			if (ch) {
+				cw_analyzer_stat_add_internal(&ch->imark_space, space);
+			}
+			if (fabs(space - unit) * 100 > unit * CW_ANALYZER_MALFORMED_TOLERANCE) {
+				is_malformed = true;
+			}
+		}
+	}
+
+	cw_analyzer_stat_add_internal(&an->speed, speed);
+	if (ch) {
+		ch->n++;
+		if (is_malformed) {
+			ch->n_malformed++;
+		}
+		cw_analyzer_stat_add_internal(&ch->speed, speed);
+	}
+	cw_analyzer_add_speed_point_internal(an, speed);
+
+	an->has_prev = true;
+	an->prev_is_end_of_word = is_end_of_word;
+	an->prev_begin = *begin;
+	an->prev_end = *end;
+
+	return;
+}
+
+
+
+
+void cw_analyzer_add_unknown_internal(cw_analyzer_t * an, const char * representation)
+{
+	char r[CW_ANALYZER_UNKNOWN_LEN + 1];
+	strncpy(r, representation, CW_ANALYZER_UNKNOWN_LEN);
+	r[CW_ANALYZER_UNKNOWN_LEN] = '\0';
+
+	int least = 0;
+	for (int i = 0; i < an->n_unknown_slots; i++) {
+		if (!strcmp(an->unknown[i].representation, r)) {
+			an->unknown[i].count++;
+			return;
+		}
+		if (an->unknown[i].count < an->unknown[least].count) {
+			least = i;
+		}
+	}
+
+	if (an->n_unknown_slots < CW_ANALYZER_N_UNKNOWN) {
+		least = an->n_unknown_slots++;
+		an->unknown[least].count = 0;
+	}
+	/* Space-saving: new entry inherits count of replaced entry. */
+	strcpy(an->unknown[least].representation, r);
+	an->unknown[least].count++;
+
+	return;
+}
+
+
+
+
+void cw_analyzer_add_speed_point_internal(cw_analyzer_t * an, double speed)
+{
+	int64_t i = an->keying_time / an->speed_interval;
+	while (i >= CW_ANALYZER_SPEED_POINTS_MAX) {
+		/* Curve is full: merge pairs of points. */
+		for (int k = 0; k < CW_ANALYZER_SPEED_POINTS_MAX / 2; k++) {
+			an->speed_points[k].sum = an->speed_points[2 * k].sum + an->speed_points[2 * k + 1].sum;
+			an->speed_points[k].n = an->speed_points[2 * k].n + an->speed_points[2 * k + 1].n;
+		}
+		memset(&an->speed_points[CW_ANALYZER_SPEED_POINTS_MAX / 2], 0, (CW_ANALYZER_SPEED_POINTS_MAX / 2) * sizeof (an->speed_points[0]));
+		an->speed_interval *= 2;
+		an->n_speed_points = (an->n_speed_points + 1) / 2;
+		i = an->keying_time / an->speed_interval;
+	}
+
+	an->speed_points[i].sum += speed;
+	an->speed_points[i].n++;
+	if (i + 1 > an->n_speed_points) {
+		an->n_speed_points = (int) i + 1;
+	}
+
+	return;
+}
+
+
+
+
+void cw_analyzer_stat_add_internal(cw_analyzer_stat_t * stat, double value)
+{
+	cw_analyzer_stat_t one = { .n = 1, .mean = value, .m2 = 0.0, .min = value, .max = value };
+	cw_analyzer_stat_merge_internal(stat, &one);
+
+	return;
+}
+
+
+
+
+/* Chan et al. formula for combining two sets of running statistics. */
+void cw_analyzer_stat_merge_internal(cw_analyzer_stat_t * stat, const cw_analyzer_stat_t * other)
+{
+	if (!other->n) {
+		return;
+	}
+	if (!stat->n) {
+		*stat = *other;
+		return;
+	}
+
+	const int64_t n = stat->n + other->n;
+	const double delta = other->mean - stat->mean;
+	stat->mean += delta * other->n / n;
+	stat->m2 += other->m2 + delta * delta * stat->n * other->n / n;
+	stat->n = n;
+	if (other->min < stat->min) {
+		stat->min = other->min;
+	}
+	if (other->max > stat->max) {
+		stat->max = other->max;
+	}
+
+	return;
+}
+
+
+
+
+int64_t cw_analyzer_timestamp_diff_internal(const struct timeval * earlier, const struct timeval * later)
+{
+	return ((int64_t) later->tv_sec - (int64_t) earlier->tv_sec) * CW_USECS_PER_SEC
+		+ ((int64_t) later->tv_usec - (int64_t) earlier->tv_usec);
+}
@@ -0,0 +1,151 @@
+/*
+  This file is a part of unixcw project.
+  unixcw project is covered by GNU General Public License, version 2 or later.
+*/
+
+#ifndef H_LIBCW_ANALYZER
+#define H_LIBCW_ANALYZER
+
+
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/time.h>
+
+
+
+
+#include "libcw_rec.h"
+#include "libcw_trace.h"
+
+
+
+
+/* Characters with codes below this value have their own statistics. */
+#define CW_ANALYZER_N_CHARACTERS        128
+
+/* Count of points of speed-over-time curve. When the curve is full,
+   adjacent points are merged and interval between points is doubled. */
+#define CW_ANALYZER_SPEED_POINTS_MAX    128
+
+/* Initial interval between points of speed-over-time curve [us]. */
+#define CW_ANALYZER_SPEED_INTERVAL_INITIAL (10 * 1000000)
+
+/* Pauses in keying longer than this are counted on time axis of
+   speed-over-time curve as pauses of this length [us]. */
+#define CW_ANALYZER_PAUSE_LEN_MAX       (5 * 1000000)
+
+/* Histogram of lengths of marks: bins of 1/4 of unit, up to 8 units. */
+#define CW_ANALYZER_HISTOGRAM_BINS_PER_UNIT   4
+#define CW_ANALYZER_HISTOGRAM_SIZE           (8 * CW_ANALYZER_HISTOGRAM_BINS_PER_UNIT)
+
+/* An element of character is mis-formed when its length differs
+   from ideal length by more than this many percent. Ideal lengths
+   are calculated from speed of the character itself. */
+#define CW_ANALYZER_MALFORMED_TOLERANCE  50
+
+/* Count of most frequent unrecognized representations that are
+   tracked, and longest tracked representation. */
+#define CW_ANALYZER_N_UNKNOWN            16
+#define CW_ANALYZER_UNKNOWN_LEN          15
+
+
+
+
+/* Running statistics of a series of values (Welford's algorithm). */
+typedef struct {
+	int64_t n;
+	double mean;
+	double m2;
+	double min;
+	double max;
+} cw_analyzer_stat_t;
+
+
+
+
+/* Statistics of one character. Lengths are in microseconds, speed
+   is in WPM. */
+typedef struct {
+	int64_t n;               /* Count of received characters. */
+	int64_t n_malformed;     /* Count of characters with at least one mis-formed element. */
+	cw_analyzer_stat_t dot;
+	cw_analyzer_stat_t dash;
+	cw_analyzer_stat_t imark_space;
+	cw_analyzer_stat_t speed;
+} cw_analyzer_character_t;
+
+
+
+
+/* Representation that didn't match any character. */
+typedef struct {
+	char representation[CW_ANALYZER_UNKNOWN_LEN + 1];
+	int64_t count;
+} cw_analyzer_unknown_t;
+
+
+
+
+struct cw_analyzer_struct {
+	/* Receiver recognizing characters in keying. Works in
+	   adaptive mode, so it follows changes of speed. */
+	cw_rec_t * rec;
+
+	/* Marks of character that is being received. */
+	struct timeval mark_begin[CW_REC_REPRESENTATION_CAPACITY];
+	struct timeval mark_end[CW_REC_REPRESENTATION_CAPACITY];
+	int n_marks;
+	struct timeval pending_mark_begin;
+	bool is_mark;
+
+	/* Previous character. */
+	bool has_prev;
+	bool prev_is_end_of_word;
+	struct timeval prev_begin;
+	struct timeval prev_end;
+
+	/* Counters. */
+	int64_t n_events;
+	int64_t n_characters;
+	int64_t n_words;
+	int64_t n_unknown;       /* Representations that didn't match any character. */
+	int64_t n_rejected;      /* Marks rejected by receiver (noise spikes, too long representations). */
+	int64_t keying_time;     /* Time from first to last character, with long pauses shortened [us]. */
+
+	/* Statistics of all characters. */
+	cw_analyzer_stat_t dot;
+	cw_analyzer_stat_t dash;
+	cw_analyzer_stat_t imark_space;
+	cw_analyzer_stat_t ichar_space;
+	cw_analyzer_stat_t iword_space;
+	cw_analyzer_stat_t speed;
+
+	/* Histogram of lengths of marks, in units of speed of their
+	   characters. */
+	int64_t histogram[CW_ANALYZER_HISTOGRAM_SIZE];
+
+	cw_analyzer_character_t characters[CW_ANALYZER_N_CHARACTERS];
+
+	/* Most frequent unrecognized representations, tracked with
+	   "space-saving" algorithm: when the table is full, a new
+	   representation replaces the least frequent one. */
+	cw_analyzer_unknown_t unknown[CW_ANALYZER_N_UNKNOWN];
+	int n_unknown_slots;
+
+	/* Speed-over-time curve. */
+	struct {
+		double sum;
+		int64_t n;
+	} speed_points[CW_ANALYZER_SPEED_POINTS_MAX];
+	int n_speed_points;
+	int64_t speed_interval;  /* [us] */
+};
+
+typedef struct cw_analyzer_struct cw_analyzer_t;
+
+
+
+
+#endif /* #ifndef H_LIBCW_ANALYZER */
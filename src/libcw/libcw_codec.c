@@ -0,0 +1,1112 @@
+/*
+  Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+  Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+/**
+   \file libcw_codec.c
+
+   \brief Compact encoding of generator's output, and synthesis of
+   samples from the encoding.
+
+   Samples produced by a generator are fully determined by a handful
+   of values: sample rate, size of generator's buffer, volume, shape
+   and length of slopes, and a sequence of tones (frequency and
+   samples count of each tone). Instead of passing around 16-bit PCM
+   samples (96 kB/s at 48 kHz), encoder attached to a generator
+   records only these values. Decoder feeds them to the same synthesis
+   code that is used by generator, so that decoded samples are
+   identical to samples that the generator has written to its audio
+   sink.
+
+   Format of encoded stream:
+
+   Header:
+   'C' 'W' 'C' version
+   varint: sample rate
+   varint: size of buffer [samples]
+   varint: volume [%]
+   varint: slope shape
+   varint: slope length [us]
+   8 bytes: initial phase (IEEE 754 double, little endian)
+
+   Records following the header:
+   CW_CODEC_RECORD_TONE: varints: frequency, samples count, rising slope samples count, falling slope samples count
+   CW_CODEC_RECORD_REPEAT: varint: count of repetitions of previous tone
+   CW_CODEC_RECORD_PARAMETERS: varints: volume, slope shape, slope length
+   CW_CODEC_RECORD_PHASE: 8 bytes: new phase
+   CW_CODEC_RECORD_PART: varints: frequency, samples count, rising slope samples count, falling slope samples count, first sample, count of samples
+   CW_CODEC_RECORD_DICTIONARY + i: tone from i-th slot of dictionary
+
+   Every tone record puts its tone in next slot of a small dictionary
+   (round robin), so that most of tones of Morse code (Dots, Dashes
+   and three kinds of spaces) take one byte in the stream. Repeated
+   tones (e.g. "forever" tones of straight key) are run-length
+   encoded. A part of a tone (a slope of straight key's tone that is
+   split between buffers, or interrupted by next edge) is recorded
+   with range of its samples that has been rendered; it doesn't go
+   into dictionary and can't be repeated.
+
+   Samples are identical unless volume or slopes are changed in the
+   middle of a tone: a change of parameters is recorded just before
+   next tone.
+*/
+
+
+
+
+#include "config.h"
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+
+#include "libcw_codec.h"
+#include "libcw_gen.h"
+#include "libcw_debug.h"
+#include "libcw_utils.h"
+#include "libcw2.h"
+
+
+
+
+#define MSG_PREFIX "libcw/codec: "
+
+
+
+
+/* From libcw_debug.c. */
+extern cw_debug_t cw_debug_object;
+extern cw_debug_t cw_debug_object_dev;
+
+
+
+
+enum {
+	CW_CODEC_RECORD_TONE       = 0x01,
+	CW_CODEC_RECORD_REPEAT     = 0x02,
+	CW_CODEC_RECORD_PARAMETERS = 0x03,
+	CW_CODEC_RECORD_PHASE      = 0x04,
+	CW_CODEC_RECORD_PART       = 0x05,
+	CW_CODEC_RECORD_DICTIONARY = 0x10  /* 0x10 - 0x17 */
+};
+
+static const uint8_t cw_codec_magic[] = { 'C', 'W', 'C', CW_CODEC_VERSION };
+
+
+
+
+static bool   cw_codec_tone_equal_internal(const cw_codec_tone_t * a, const cw_codec_tone_t * b);
+
+static void   cw_codec_encoder_put_internal(cw_codec_encoder_t * enc, const uint8_t * bytes, size_t n_bytes);
+static void   cw_codec_encoder_write_header_internal(cw_codec_encoder_t * enc);
+static void   cw_codec_encoder_write_parameters_internal(cw_codec_encoder_t * enc);
+static void   cw_codec_encoder_write_repeats_internal(cw_codec_encoder_t * enc);
+static int    cw_codec_encoder_flush_internal(cw_codec_encoder_t * enc);
+
+static int    cw_codec_decoder_parse_internal(cw_codec_decoder_t * dec, const uint8_t * bytes, size_t n_bytes);
+static int    cw_codec_decoder_open_internal(cw_codec_decoder_t * dec, int sample_rate, int buffer_n_samples, int volume, int slope_shape, int slope_len, double phase);
+static int    cw_codec_decoder_render_internal(cw_codec_decoder_t * dec, const cw_codec_tone_t * tone, int64_t first, int64_t n_samples);
+
+
+
+
+/* ******************************************************************** */
+/*                           Section:Encoder                            */
+/* ******************************************************************** */
+
+
+
+
+/**
+   \brief Create new encoder and attach it to generator
+
+   From now on every tone rendered by \p gen is encoded, and the
+   encoded bytes are passed to \p write_func (with \p write_arg as
+   first argument).
+
+   The generator must render samples into its buffer: it must use one
+   of soundcard audio systems (OSS, ALSA, PulseAudio), or be a
+   session of scheduler (see cw_sched_add_session()). Attach the
+   encoder before starting the generator.
+
+   \errno EINVAL - generator doesn't render samples, or \p write_func is NULL
+   \errno EBUSY - generator already has an encoder
+   \errno ENOMEM - failed to allocate memory
+
+   \param gen - generator whose output should be encoded
+   \param write_func - function receiving encoded bytes
+   \param write_arg - argument passed to \p write_func
+
+   \return pointer to new encoder on success
+   \return NULL on failure
+*/
+cw_codec_encoder_t * cw_codec_encoder_new(cw_gen_t * gen, cw_codec_write_t write_func, void * write_arg)
+{
+	if (!gen || !gen->buffer || !write_func) {
+		errno = EINVAL;
+		return (cw_codec_encoder_t *) NULL;
+	}
+	if (gen->encoder) {
+		errno = EBUSY;
+		return (cw_codec_encoder_t *) NULL;
+	}
+
+	cw_codec_encoder_t * enc = (cw_codec_encoder_t *) malloc(sizeof (cw_codec_encoder_t));
+	if (!enc) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR, MSG_PREFIX "malloc()");
+		errno = ENOMEM;
+		return (cw_codec_encoder_t *) NULL;
+	}
+
+	enc->gen = gen;
+	enc->write_func = write_func;
+	enc->write_arg = write_arg;
+
+	enc->n_bytes = 0;
+	enc->header_written = false;
+
+	enc->volume_percent = -1;
+	enc->slope_shape = -1;
+	enc->slope_len = -1;
+
+	enc->has_last = false;
+	enc->n_repeats = 0;
+
+	enc->dictionary_len = 0;
+	enc->dictionary_next = 0;
+
+	enc->write_failed = false;
+
+	pthread_mutex_init(&enc->mutex, NULL);
+
+	gen->encoder = enc;
+
+	return enc;
+}
+
+
+
+
+/**
+   \brief Detach encoder from its generator and delete the encoder
+
+   Bytes that are still buffered in encoder are passed to encoder's
+   write function before the encoder is deleted. Pointer to \p enc is
+   set to NULL.
+
+   \param enc - pointer to encoder
+*/
+void cw_codec_encoder_delete(cw_codec_encoder_t ** enc)
+{
+	cw_assert (enc, MSG_PREFIX "encoder delete: pointer to encoder is NULL");
+
+	if (!*enc) {
+		return;
+	}
+
+	cw_codec_encoder_flush(*enc);
+
+	if ((*enc)->gen) {
+		(*enc)->gen->encoder = (cw_codec_encoder_t *) NULL;
+		(*enc)->gen = (cw_gen_t *) NULL;
+	}
+
+	pthread_mutex_destroy(&(*enc)->mutex);
+
+	free(*enc);
+	*enc = (cw_codec_encoder_t *) NULL;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Pass all buffered bytes to encoder's write function
+
+   Encoder flushes its buffer by itself when the buffer is full and
+   when generator's tone queue goes empty. Call this function when
+   you need the encoded stream to be complete at given moment.
+
+   \errno EIO - write function has failed (now or in one of previous calls)
+
+   \param enc - encoder
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_codec_encoder_flush(cw_codec_encoder_t * enc)
+{
+	pthread_mutex_lock(&enc->mutex);
+	cw_codec_encoder_write_repeats_internal(enc);
+	const int rv = cw_codec_encoder_flush_internal(enc);
+	pthread_mutex_unlock(&enc->mutex);
+
+	if (CW_SUCCESS != rv) {
+		errno = EIO;
+	}
+	return rv;
+}
+
+
+
+
+/**
+   \brief Encode a tone rendered by generator
+
+   Function is called by generator after samples count of \p tone has
+   been calculated, before samples of the tone are calculated.
+
+   \param enc - encoder
+   \param tone - tone to encode
+*/
+void cw_codec_encoder_add_tone_internal(cw_codec_encoder_t * enc, const cw_tone_t * tone)
+{
+	const cw_codec_tone_t t = {
+		.frequency = tone->frequency,
+		.n_samples = tone->n_samples,
+		.rising_slope_n_samples = tone->rising_slope_n_samples,
+		.falling_slope_n_samples = tone->falling_slope_n_samples
+	};
+
+	pthread_mutex_lock(&enc->mutex);
+
+	cw_codec_encoder_write_parameters_internal(enc);
+
+	const cw_gen_t * gen = enc->gen;
+	if (enc->has_last && cw_codec_tone_equal_internal(&t, &enc->last)) {
+		enc->n_repeats++;
+		pthread_mutex_unlock(&enc->mutex);
+		return;
+	}
+	cw_codec_encoder_write_repeats_internal(enc);
+
+
+	uint8_t record[CW_CODEC_RECORD_SIZE_MAX];
+	size_t n = 0;
+
+	int i = 0;
+	for (i = 0; i < enc->dictionary_len; i++) {
+		if (cw_codec_tone_equal_internal(&t, &enc->dictionary[i])) {
+			break;
+		}
+	}
+	if (i < enc->dictionary_len) {
+		record[n++] = CW_CODEC_RECORD_DICTIONARY + i;
+	} else {
+		record[n++] = CW_CODEC_RECORD_TONE;
+		n += cw_codec_put_varint_internal(record + n, (uint64_t) t.frequency);
+		n += cw_codec_put_varint_internal(record + n, (uint64_t) t.n_samples);
+		n += cw_codec_put_varint_internal(record + n, (uint64_t) t.rising_slope_n_samples);
+		n += cw_codec_put_varint_internal(record + n, (uint64_t) t.falling_slope_n_samples);
+
+		enc->dictionary[enc->dictionary_next] = t;
+		enc->dictionary_next = (enc->dictionary_next + 1) % CW_CODEC_DICTIONARY_SIZE;
+		if (enc->dictionary_len < CW_CODEC_DICTIONARY_SIZE) {
+			enc->dictionary_len++;
+		}
+	}
+	cw_codec_encoder_put_internal(enc, record, n);
+
+	enc->last = t;
+	enc->has_last = true;
+
+	/* Silence usually means that tone queue has been drained:
+	   this is a good moment to let the bytes go. */
+	if (t.frequency == 0 && gen->tq->len == 0) {
+		cw_codec_encoder_flush_internal(enc);
+	}
+
+	pthread_mutex_unlock(&enc->mutex);
+
+	return;
+}
+
+
+
+
+/**
+   \brief Encode a part of a tone rendered by generator
+
+   Function is called by generator that renders only some samples of
+   \p tone: \p n_samples samples starting at tone->sample_iterator
+   (e.g. a slope of straight key's tone that is split between
+   buffers). A part that covers the whole tone is encoded as a tone.
+
+   \param enc - encoder
+   \param tone - tone, with samples count and first rendered sample
+   \param n_samples - count of rendered samples
+*/
+void cw_codec_encoder_add_tone_part_internal(cw_codec_encoder_t * enc, const cw_tone_t * tone, int n_samples)
+{
+	if (tone->sample_iterator == 0 && n_samples == tone->n_samples) {
+		cw_codec_encoder_add_tone_internal(enc, tone);
+		return;
+	}
+
+	pthread_mutex_lock(&enc->mutex);
+
+	cw_codec_encoder_write_parameters_internal(enc);
+	cw_codec_encoder_write_repeats_internal(enc);
+
+	uint8_t record[CW_CODEC_RECORD_SIZE_MAX];
+	size_t n = 0;
+	record[n++] = CW_CODEC_RECORD_PART;
+	n += cw_codec_put_varint_internal(record + n, (uint64_t) tone->frequency);
+	n += cw_codec_put_varint_internal(record + n, (uint64_t) tone->n_samples);
+	n += cw_codec_put_varint_internal(record + n, (uint64_t) tone->rising_slope_n_samples);
+	n += cw_codec_put_varint_internal(record + n, (uint64_t) tone->falling_slope_n_samples);
+	n += cw_codec_put_varint_internal(record + n, (uint64_t) tone->sample_iterator);
+	n += cw_codec_put_varint_internal(record + n, (uint64_t) n_samples);
+	cw_codec_encoder_put_internal(enc, record, n);
+
+	pthread_mutex_unlock(&enc->mutex);
+
+	return;
+}
+
+
+
+
+/**
+   \brief Record reset of phase of generator's sine wave
+
+   Function is called by generator when it is started.
+
+   \param enc - encoder
+*/
+void cw_codec_encoder_reset_phase_internal(cw_codec_encoder_t * enc)
+{
+	pthread_mutex_lock(&enc->mutex);
+
+	/* Header (written before first tone) will contain current
+	   phase. */
+	if (enc->header_written) {
+		cw_codec_encoder_write_repeats_internal(enc);
+
+		uint8_t record[CW_CODEC_RECORD_SIZE_MAX];
+		size_t n = 0;
+		record[n++] = CW_CODEC_RECORD_PHASE;
+		n += cw_codec_put_double_internal(record + n, cw_gen_get_phase_internal(enc->gen));
+		cw_codec_encoder_put_internal(enc, record, n);
+	}
+
+	pthread_mutex_unlock(&enc->mutex);
+
+	return;
+}
+
+
+
+
+/**
+   \brief Write header of encoded stream
+
+   \param enc - encoder
+*/
+void cw_codec_encoder_write_header_internal(cw_codec_encoder_t * enc)
+{
+	const cw_gen_t * gen = enc->gen;
+
+	enc->volume_percent = gen->volume_percent;
+	enc->slope_shape = gen->tone_slope.shape;
+	enc->slope_len = gen->tone_slope.len;
+
+	uint8_t header[CW_CODEC_RECORD_SIZE_MAX];
+	size_t n = 0;
+	memcpy(header, cw_codec_magic, sizeof (cw_codec_magic));
+	n += sizeof (cw_codec_magic);
+	n += cw_codec_put_varint_internal(header + n, (uint64_t) gen->sample_rate);
+	n += cw_codec_put_varint_internal(header + n, (uint64_t) gen->buffer_n_samples);
+	n += cw_codec_put_varint_internal(header + n, (uint64_t) enc->volume_percent);
+	n += cw_codec_put_varint_internal(header + n, (uint64_t) enc->slope_shape);
+	n += cw_codec_put_varint_internal(header + n, (uint64_t) enc->slope_len);
+	n += cw_codec_put_double_internal(header + n, cw_gen_get_phase_internal(gen));
+
+	cw_codec_encoder_put_internal(enc, header, n);
+	enc->header_written = true;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Write header of stream, or changed parameters of generator
+
+   Function is called before each tone is recorded.
+
+   \param enc - encoder
+*/
+void cw_codec_encoder_write_parameters_internal(cw_codec_encoder_t * enc)
+{
+	if (!enc->header_written) {
+		cw_codec_encoder_write_header_internal(enc);
+	}
+
+	const cw_gen_t * gen = enc->gen;
+	if (gen->volume_percent != enc->volume_percent
+	    || gen->tone_slope.shape != enc->slope_shape
+	    || gen->tone_slope.len != enc->slope_len) {
+
+		cw_codec_encoder_write_repeats_internal(enc);
+
+		enc->volume_percent = gen->volume_percent;
+		enc->slope_shape = gen->tone_slope.shape;
+		enc->slope_len = gen->tone_slope.len;
+
+		uint8_t record[CW_CODEC_RECORD_SIZE_MAX];
+		size_t n = 0;
+		record[n++] = CW_CODEC_RECORD_PARAMETERS;
+		n += cw_codec_put_varint_internal(record + n, (uint64_t) enc->volume_percent);
+		n += cw_codec_put_varint_internal(record + n, (uint64_t) enc->slope_shape);
+		n += cw_codec_put_varint_internal(record + n, (uint64_t) enc->slope_len);
+		cw_codec_encoder_put_internal(enc, record, n);
+
+		/* Tones in decoder's dictionary have been calculated
+		   with old parameters, but this doesn't matter: samples
+		   count of tone doesn't depend on volume, and slopes
+		   count is stored in the tone. */
+	}
+
+
+	return;
+}
+
+
+
+
+/**
+   \brief Write record with count of pending repetitions of last tone
+
+   \param enc - encoder
+*/
+void cw_codec_encoder_write_repeats_internal(cw_codec_encoder_t * enc)
+{
+	if (!enc->n_repeats) {
+		return;
+	}
+
+	uint8_t record[CW_CODEC_RECORD_SIZE_MAX];
+	size_t n = 0;
+	record[n++] = CW_CODEC_RECORD_REPEAT;
+	n += cw_codec_put_varint_internal(record + n, enc->n_repeats);
+	cw_codec_encoder_put_internal(enc, record, n);
+
+	enc->n_repeats = 0;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Append bytes to encoder's buffer, flush the buffer if necessary
+
+   \param enc - encoder
+   \param bytes - bytes to append
+   \param n_bytes - count of bytes to append
+*/
+void cw_codec_encoder_put_internal(cw_codec_encoder_t * enc, const uint8_t * bytes, size_t n_bytes)
+{
+	if (enc->n_bytes + n_bytes > CW_CODEC_BUFFER_SIZE) {
+		cw_codec_encoder_flush_internal(enc);
+	}
+	memcpy(enc->buffer + enc->n_bytes, bytes, n_bytes);
+	enc->n_bytes += n_bytes;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Pass buffered bytes to encoder's write function
+
+   \param enc - encoder
+
+   \return CW_SUCCESS if all bytes have been written so far
+   \return CW_FAILURE otherwise
+*/
+int cw_codec_encoder_flush_internal(cw_codec_encoder_t * enc)
+{
+	if (enc->n_bytes) {
+		if (CW_SUCCESS != enc->write_func(enc->write_arg, enc->buffer, enc->n_bytes)) {
+			cw_debug_msg (&cw_debug_object, CW_DEBUG_GENERATOR, CW_DEBUG_ERROR,
+				      MSG_PREFIX "failed to write %zu encoded bytes", enc->n_bytes);
+			enc->write_failed = true;
+		}
+		enc->n_bytes = 0;
+	}
+
+	return enc->write_failed ? CW_FAILURE : CW_SUCCESS;
+}
+
+
+
+
+/* ******************************************************************** */
+/*                           Section:Decoder                            */
+/* ******************************************************************** */
+
+
+
+
+/**
+   \brief Create new decoder
+
+   Decoded samples will be passed to \p write_func (with \p write_arg
+   as first argument), in chunks of the same size as size of buffer of
+   generator that produced the encoded stream.
+
+   \errno EINVAL - \p write_func is NULL
+   \errno ENOMEM - failed to allocate memory
+
+   \param write_func - function receiving decoded samples
+   \param write_arg - argument passed to \p write_func
+
+   \return pointer to new decoder on success
+   \return NULL on failure
+*/
+cw_codec_decoder_t * cw_codec_decoder_new(cw_codec_pcm_write_t write_func, void * write_arg)
+{
+	if (!write_func) {
+		errno = EINVAL;
+		return (cw_codec_decoder_t *) NULL;
+	}
+
+	cw_codec_decoder_t * dec = (cw_codec_decoder_t *) malloc(sizeof (cw_codec_decoder_t));
+	if (!dec) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR, MSG_PREFIX "malloc()");
+		errno = ENOMEM;
+		return (cw_codec_decoder_t *) NULL;
+	}
+
+	dec->gen = (cw_gen_t *) NULL;
+	dec->buffer_fill = 0;
+
+	dec->write_func = write_func;
+	dec->write_silence_func = NULL;
+	dec->write_arg = write_arg;
+
+	dec->n_pending = 0;
+
+	dec->has_last = false;
+	dec->dictionary_len = 0;
+	dec->dictionary_next = 0;
+
+	return dec;
+}
+
+
+
+
+/**
+   \brief Delete decoder
+
+   Pointer to \p dec is set to NULL.
+
+   \param dec - pointer to decoder
+*/
+void cw_codec_decoder_delete(cw_codec_decoder_t ** dec)
+{
+	cw_assert (dec, MSG_PREFIX "decoder delete: pointer to decoder is NULL");
+
+	if (!*dec) {
+		return;
+	}
+
+	cw_gen_delete(&(*dec)->gen);
+
+	free(*dec);
+	*dec = (cw_codec_decoder_t *) NULL;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Set function receiving silence of decoded stream
+
+   When \p write_silence_func is set, buffers of decoded samples that
+   contain only silence are not passed to decoder's write function:
+   \p write_silence_func gets count of their samples instead. Pass
+   NULL to pass all samples to write function again.
+
+   \param dec - decoder
+   \param write_silence_func - function receiving count of silent samples
+*/
+void cw_codec_decoder_set_write_silence(cw_codec_decoder_t * dec, cw_codec_pcm_write_silence_t write_silence_func)
+{
+	dec->write_silence_func = write_silence_func;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Decode bytes of encoded stream
+
+   Bytes can be pushed in chunks of any size; an incomplete record at
+   the end of \p bytes is remembered and completed with next chunk.
+
+   Samples are passed to decoder's write function each time a full
+   buffer of samples has been synthesized.
+
+   \errno EINVAL - invalid data in stream
+   \errno EIO - write function has failed
+
+   \param dec - decoder
+   \param bytes - encoded bytes
+   \param n_bytes - count of encoded bytes
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_codec_decoder_push(cw_codec_decoder_t * dec, const uint8_t * bytes, size_t n_bytes)
+{
+	size_t i = 0;
+	while (i < n_bytes) {
+		/* Move as many new bytes as possible to pending bytes
+		   of incomplete record... */
+		size_t n = CW_CODEC_RECORD_SIZE_MAX - dec->n_pending;
+		if (n > n_bytes - i) {
+			n = n_bytes - i;
+		}
+		memcpy(dec->pending + dec->n_pending, bytes + i, n);
+		dec->n_pending += n;
+		i += n;
+
+		/* ... and decode all complete records. */
+		size_t consumed = 0;
+		while (consumed < dec->n_pending) {
+			const int rv = cw_codec_decoder_parse_internal(dec, dec->pending + consumed, dec->n_pending - consumed);
+			if (rv < 0) {
+				return CW_FAILURE;
+			} else if (rv == 0) {
+				break; /* Incomplete record. */
+			} else {
+				consumed += (size_t) rv;
+			}
+		}
+		memmove(dec->pending, dec->pending + consumed, dec->n_pending - consumed);
+		dec->n_pending -= consumed;
+
+		if (dec->n_pending == CW_CODEC_RECORD_SIZE_MAX) {
+			/* No valid record is this long, so more bytes
+			   won't complete it. */
+			cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+				      MSG_PREFIX "decoder push: no complete record in %d bytes", CW_CODEC_RECORD_SIZE_MAX);
+			errno = EINVAL;
+			return CW_FAILURE;
+		}
+	}
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Decode one record
+
+   \param dec - decoder
+   \param bytes - beginning of record
+   \param n_bytes - count of available bytes
+
+   \return count of bytes of decoded record
+   \return zero if record is incomplete
+   \return -1 on errors
+*/
+int cw_codec_decoder_parse_internal(cw_codec_decoder_t * dec, const uint8_t * bytes, size_t n_bytes)
+{
+	size_t i = 0;
+	uint64_t v[6] = { 0 };
+
+	if (!dec->gen) {
+		/* Header. */
+		if (n_bytes < sizeof (cw_codec_magic)) {
+			return 0;
+		}
+		if (memcmp(bytes, cw_codec_magic, sizeof (cw_codec_magic))) {
+			cw_debug_msg (&cw_debug_object, CW_DEBUG_GENERATOR, CW_DEBUG_ERROR, MSG_PREFIX "invalid header of stream");
+			errno = EINVAL;
+			return -1;
+		}
+		i = sizeof (cw_codec_magic);
+		for (int k = 0; k < 5; k++) {
+			if (!cw_codec_get_varint_internal(bytes, n_bytes, &i, &v[k])) {
+				return 0;
+			}
+		}
+		double phase = 0.0;
+		if (!cw_codec_get_double_internal(bytes, n_bytes, &i, &phase)) {
+			return 0;
+		}
+
+		if (CW_SUCCESS != cw_codec_decoder_open_internal(dec, (int) v[0], (int) v[1], (int) v[2], (int) v[3], (int) v[4], phase)) {
+			return -1;
+		}
+		return (int) i;
+	}
+
+
+	const uint8_t type = bytes[i++];
+	cw_codec_tone_t tone;
+
+	if (type >= CW_CODEC_RECORD_DICTIONARY && type < CW_CODEC_RECORD_DICTIONARY + CW_CODEC_DICTIONARY_SIZE) {
+		const int k = type - CW_CODEC_RECORD_DICTIONARY;
+		if (k >= dec->dictionary_len) {
+			errno = EINVAL;
+			return -1;
+		}
+		tone = dec->dictionary[k];
+		dec->last = tone;
+		dec->has_last = true;
+		if (CW_SUCCESS != cw_codec_decoder_render_internal(dec, &tone, 0, tone.n_samples)) {
+			return -1;
+		}
+		return (int) i;
+	}
+
+	switch (type) {
+	case CW_CODEC_RECORD_TONE:
+		for (int k = 0; k < 4; k++) {
+			if (!cw_codec_get_varint_internal(bytes, n_bytes, &i, &v[k])) {
+				return 0;
+			}
+		}
+		tone.frequency = (int) v[0];
+		tone.n_samples = (int64_t) v[1];
+		tone.rising_slope_n_samples = (int) v[2];
+		tone.falling_slope_n_samples = (int) v[3];
+
+		if (tone.rising_slope_n_samples > dec->gen->tone_slope.n_amplitudes
+		    || tone.falling_slope_n_samples > dec->gen->tone_slope.n_amplitudes) {
+			errno = EINVAL;
+			return -1;
+		}
+
+		dec->dictionary[dec->dictionary_next] = tone;
+		dec->dictionary_next = (dec->dictionary_next + 1) % CW_CODEC_DICTIONARY_SIZE;
+		if (dec->dictionary_len < CW_CODEC_DICTIONARY_SIZE) {
+			dec->dictionary_len++;
+		}
+
+		dec->last = tone;
+		dec->has_last = true;
+		if (CW_SUCCESS != cw_codec_decoder_render_internal(dec, &tone, 0, tone.n_samples)) {
+			return -1;
+		}
+		return (int) i;
+
+	case CW_CODEC_RECORD_PART:
+		for (int k = 0; k < 6; k++) {
+			if (!cw_codec_get_varint_internal(bytes, n_bytes, &i, &v[k])) {
+				return 0;
+			}
+		}
+		tone.frequency = (int) v[0];
+		tone.n_samples = (int64_t) v[1];
+		tone.rising_slope_n_samples = (int) v[2];
+		tone.falling_slope_n_samples = (int) v[3];
+
+		if (tone.rising_slope_n_samples > dec->gen->tone_slope.n_amplitudes
+		    || tone.falling_slope_n_samples > dec->gen->tone_slope.n_amplitudes
+		    || v[4] > v[1]
+		    || v[5] > v[1] - v[4]) {
+			errno = EINVAL;
+			return -1;
+		}
+
+		/* Part of tone doesn't go into dictionary and doesn't
+		   become last tone. */
+		if (CW_SUCCESS != cw_codec_decoder_render_internal(dec, &tone, (int64_t) v[4], (int64_t) v[5])) {
+			return -1;
+		}
+		return (int) i;
+
+	case CW_CODEC_RECORD_REPEAT:
+		if (!cw_codec_get_varint_internal(bytes, n_bytes, &i, &v[0])) {
+			return 0;
+		}
+		if (!dec->has_last) {
+			errno = EINVAL;
+			return -1;
+		}
+		for (uint64_t k = 0; k < v[0]; k++) {
+			tone = dec->last;
+			if (CW_SUCCESS != cw_codec_decoder_render_internal(dec, &tone, 0, tone.n_samples)) {
+				return -1;
+			}
+		}
+		return (int) i;
+
+	case CW_CODEC_RECORD_PARAMETERS:
+		for (int k = 0; k < 3; k++) {
+			if (!cw_codec_get_varint_internal(bytes, n_bytes, &i, &v[k])) {
+				return 0;
+			}
+		}
+		if (CW_SUCCESS != cw_gen_set_volume(dec->gen, (int) v[0])
+		    || CW_SUCCESS != cw_gen_set_tone_slope(dec->gen, (int) v[1], (int) v[2])) {
+			errno = EINVAL;
+			return -1;
+		}
+		return (int) i;
+
+	case CW_CODEC_RECORD_PHASE:
+		{
+			double phase = 0.0;
+			if (!cw_codec_get_double_internal(bytes, n_bytes, &i, &phase)) {
+				return 0;
+			}
+			cw_gen_set_phase_internal(dec->gen, phase);
+		}
+		return (int) i;
+
+	default:
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_GENERATOR, CW_DEBUG_ERROR, MSG_PREFIX "invalid record type 0x%02x", type);
+		errno = EINVAL;
+		return -1;
+	}
+}
+
+
+
+
+/**
+   \brief Create generator that will synthesize samples of decoded tones
+
+   \param dec - decoder
+   \param sample_rate - sample rate of stream
+   \param buffer_n_samples - size of buffer of generator that produced the stream
+   \param volume - initial volume [%]
+   \param slope_shape - initial shape of slopes
+   \param slope_len - initial length of slopes [us]
+   \param phase - initial phase of sine wave
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_codec_decoder_open_internal(cw_codec_decoder_t * dec, int sample_rate, int buffer_n_samples, int volume, int slope_shape, int slope_len, double phase)
+{
+	if (sample_rate <= 0 || buffer_n_samples <= 0) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	dec->gen = cw_gen_new(CW_AUDIO_NULL, CW_DEFAULT_NULL_DEVICE);
+	if (!dec->gen) {
+		return CW_FAILURE;
+	}
+
+	dec->gen->sample_rate = sample_rate;
+	dec->gen->buffer_n_samples = buffer_n_samples;
+	dec->gen->buffer = (cw_sample_t *) malloc(buffer_n_samples * sizeof (cw_sample_t));
+	if (!dec->gen->buffer) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR, MSG_PREFIX "malloc()");
+		cw_gen_delete(&dec->gen);
+		errno = ENOMEM;
+		return CW_FAILURE;
+	}
+	dec->gen->render.is_external = true;
+	dec->buffer_fill = 0;
+
+	if (CW_SUCCESS != cw_gen_set_volume(dec->gen, volume)
+	    || CW_SUCCESS != cw_gen_set_tone_slope(dec->gen, slope_shape, slope_len)) {
+		cw_gen_delete(&dec->gen);
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+	cw_gen_set_phase_internal(dec->gen, phase);
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Synthesize samples of decoded tone
+
+   \param dec - decoder
+   \param t - decoded tone
+   \param first - index of first sample of tone to synthesize
+   \param n_samples - count of samples to synthesize
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE if decoder's write function has failed
+*/
+int cw_codec_decoder_render_internal(cw_codec_decoder_t * dec, const cw_codec_tone_t * t, int64_t first, int64_t n_samples)
+{
+	cw_tone_t tone;
+	CW_TONE_INIT(&tone, t->frequency, 0, CW_SLOPE_MODE_STANDARD_SLOPES);
+	tone.n_samples = t->n_samples;
+	tone.rising_slope_n_samples = t->rising_slope_n_samples;
+	tone.falling_slope_n_samples = t->falling_slope_n_samples;
+	tone.sample_iterator = (int) first;
+
+	const int64_t stop = first + n_samples;
+	while (tone.sample_iterator < stop) {
+		dec->buffer_fill = cw_gen_render_tone_internal(dec->gen, &tone, dec->buffer_fill, stop);
+		if (dec->buffer_fill == dec->gen->buffer_n_samples) {
+			dec->buffer_fill = 0;
+			const int rv = dec->write_silence_func && dec->gen->buffer_is_silent
+				? dec->write_silence_func(dec->write_arg, dec->gen->buffer_n_samples)
+				: dec->write_func(dec->write_arg, dec->gen->buffer, dec->gen->buffer_n_samples);
+			if (CW_SUCCESS != rv) {
+				errno = EIO;
+				return CW_FAILURE;
+			}
+		}
+	}
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/* ******************************************************************** */
+/*                           Section:Helpers                            */
+/* ******************************************************************** */
+
+
+
+
+/**
+   \brief Put unsigned LEB128 encoding of a value into buffer
+
+   \param bytes - output buffer, at least 10 bytes long
+   \param value - value to encode
+
+   \return count of bytes put into buffer
+*/
+size_t cw_codec_put_varint_internal(uint8_t * bytes, uint64_t value)
+{
+	size_t n = 0;
+	do {
+		uint8_t byte = value & 0x7f;
+		value >>= 7;
+		if (value) {
+			byte |= 0x80;
+		}
+		bytes[n++] = byte;
+	} while (value);
+
+	return n;
+}
+
+
+
+
+/**
+   \brief Get value encoded as unsigned LEB128
+
+   \param bytes - input buffer
+   \param n_bytes - size of input buffer
+   \param i - index of first byte of encoded value; on success updated to point past the value
+   \param value - decoded value
+
+   \return true if complete value has been decoded
+   \return false if input buffer ends in the middle of the value
+*/
+int cw_codec_get_varint_internal(const uint8_t * bytes, size_t n_bytes, size_t * i, uint64_t * value)
+{
+	uint64_t result = 0;
+	int shift = 0;
+	for (size_t k = *i; k < n_bytes && shift < 64; k++) {
+		result |= ((uint64_t) (bytes[k] & 0x7f)) << shift;
+		shift += 7;
+		if (!(bytes[k] & 0x80)) {
+			*i = k + 1;
+			*value = result;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+
+
+/**
+   \brief Put IEEE 754 representation of double into buffer (little endian)
+
+   \return count of bytes put into buffer
+*/
+size_t cw_codec_put_double_internal(uint8_t * bytes, double value)
+{
+	uint64_t bits = 0;
+	memcpy(&bits, &value, sizeof (bits));
+	for (int k = 0; k < 8; k++) {
+		bytes[k] = (bits >> (8 * k)) & 0xff;
+	}
+
+	return 8;
+}
+
+
+
+
+/**
+   \brief Get double stored in buffer by cw_codec_put_double_internal()
+
+   \return true if value has been decoded
+   \return false if input buffer is too short
+*/
+int cw_codec_get_double_internal(const uint8_t * bytes, size_t n_bytes, size_t * i, double * value)
+{
+	if (n_bytes - *i < 8) {
+		return false;
+	}
+
+	uint64_t bits = 0;
+	for (int k = 0; k < 8; k++) {
+		bits |= ((uint64_t) bytes[*i + k]) << (8 * k);
+	}
+	memcpy(value, &bits, sizeof (bits));
+	*i += 8;
+
+	return true;
+}
+
+
+
+
+bool cw_codec_tone_equal_internal(const cw_codec_tone_t * a, const cw_codec_tone_t * b)
+{
+	return a->frequency == b->frequency
+		&& a->n_samples == b->n_samples
+		&& a->rising_slope_n_samples == b->rising_slope_n_samples
+		&& a->falling_slope_n_samples == b->falling_slope_n_samples;
+}
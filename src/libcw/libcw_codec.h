@@ -0,0 +1,153 @@
+/*
+  This file is a part of unixcw project.
+  unixcw project is covered by GNU General Public License, version 2 or later.
+*/
+
+#ifndef H_LIBCW_CODEC
+#define H_LIBCW_CODEC
+
+
+
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+
+
+#include "libcw_gen.h"
+#include "libcw_tq.h"
+
+
+
+
+/* Version of format of encoded stream, written in stream's header. */
+#define CW_CODEC_VERSION               1
+
+/* Size of encoder's output buffer. Encoded bytes are passed to
+   client's write function in chunks no larger than this. */
+#define CW_CODEC_BUFFER_SIZE         256
+
+/* Count of recently used tones that can be referenced in encoded
+   stream with a single byte. */
+#define CW_CODEC_DICTIONARY_SIZE       8
+
+/* Longest possible record (including header) in encoded stream. */
+#define CW_CODEC_RECORD_SIZE_MAX      64
+
+
+
+
+/* Function receiving encoded bytes. Should return CW_SUCCESS when it
+   accepted the bytes, and CW_FAILURE otherwise. */
+typedef int (* cw_codec_write_t)(void * write_arg, const uint8_t * bytes, size_t n_bytes);
+
+/* Function receiving decoded samples. Should return CW_SUCCESS when it
+   accepted the samples, and CW_FAILURE otherwise. */
+typedef int (* cw_codec_pcm_write_t)(void * write_arg, const cw_sample_t * samples, int n_samples);
+
+/* Function receiving count of decoded samples that are silence, see
+   cw_codec_decoder_set_write_silence(). */
+typedef int (* cw_codec_pcm_write_silence_t)(void * write_arg, int n_samples);
+
+
+
+
+/* Tone as stored in encoded stream: only the values that are
+   needed to calculate its samples. */
+typedef struct {
+	int frequency;
+	int64_t n_samples;
+	int rising_slope_n_samples;
+	int falling_slope_n_samples;
+} cw_codec_tone_t;
+
+
+
+
+struct cw_codec_encoder_struct {
+	/* Generator whose tones are encoded. */
+	cw_gen_t * gen;
+
+	cw_codec_write_t write_func;
+	void * write_arg;
+
+	/* Encoded bytes that haven't been passed to write function yet. */
+	uint8_t buffer[CW_CODEC_BUFFER_SIZE];
+	size_t n_bytes;
+
+	bool header_written;
+
+	/* Parameters of generator as recorded in stream. */
+	int volume_percent;
+	int slope_shape;
+	int slope_len;
+
+	/* Previous tone, and count of its repetitions that haven't
+	   been written to stream yet. */
+	cw_codec_tone_t last;
+	bool has_last;
+	uint32_t n_repeats;
+
+	cw_codec_tone_t dictionary[CW_CODEC_DICTIONARY_SIZE];
+	int dictionary_len;
+	int dictionary_next;
+
+	/* Write function returned failure. */
+	bool write_failed;
+
+	/* Tones are added from generator's thread, flushes may be
+	   requested from client's thread. */
+	pthread_mutex_t mutex;
+};
+
+typedef struct cw_codec_encoder_struct cw_codec_encoder_t;
+
+
+
+
+struct cw_codec_decoder_struct {
+	/* Generator used to synthesize samples of decoded tones. It is
+	   created when header of stream is decoded. */
+	cw_gen_t * gen;
+
+	/* Count of samples in generator's buffer that are already filled. */
+	int buffer_fill;
+
+	cw_codec_pcm_write_t write_func;
+	cw_codec_pcm_write_silence_t write_silence_func; /* May be NULL. */
+	void * write_arg;
+
+	/* Bytes of incomplete record. */
+	uint8_t pending[CW_CODEC_RECORD_SIZE_MAX];
+	size_t n_pending;
+
+	cw_codec_tone_t last;
+	bool has_last;
+
+	cw_codec_tone_t dictionary[CW_CODEC_DICTIONARY_SIZE];
+	int dictionary_len;
+	int dictionary_next;
+};
+
+typedef struct cw_codec_decoder_struct cw_codec_decoder_t;
+
+
+
+
+void cw_codec_encoder_add_tone_internal(cw_codec_encoder_t * enc, const cw_tone_t * tone);
+void cw_codec_encoder_add_tone_part_internal(cw_codec_encoder_t * enc, const cw_tone_t * tone, int n_samples);
+void cw_codec_encoder_reset_phase_internal(cw_codec_encoder_t * enc);
+
+/* Helpers, used also by libcw_snapshot.c and libcw_trace.c. */
+size_t cw_codec_put_varint_internal(uint8_t * bytes, uint64_t value);
+int    cw_codec_get_varint_internal(const uint8_t * bytes, size_t n_bytes, size_t * i, uint64_t * value);
+size_t cw_codec_put_double_internal(uint8_t * bytes, double value);
+int    cw_codec_get_double_internal(const uint8_t * bytes, size_t n_bytes, size_t * i, double * value);
+
+
+
+
+#endif /* #ifndef H_LIBCW_CODEC */
@@ -43,7 +43,9 @@
 #include <limits.h> /* UCHAR_MAX */
 #include <string.h>
 #include <errno.h>
+#include <stdlib.h>
 #include <ctype.h>
+#include <pthread.h>
 
 
 
@@ -131,6 +133,270 @@ const cw_entry_t CW_TABLE[] = { /* TODO: make it accessible through function onl
 
 
 
+/*
+  Table of characters used by lookup functions.
+
+  The table is built from main table of characters (CW_TABLE),
+  extended with characters defined by client code (see
+  cw_load_character_table()). A table is never modified once it is
+  in use: a new table is built off to the side, and swapped in with
+  a single atomic store of a pointer. Lookup functions, called by
+  running generators and receivers, only load the pointer, so they
+  don't take any locks and never see a half-built table.
+
+  A lookup may still be in progress in a table that has just been
+  replaced, and lookup functions return pointers to representations
+  in the table, which client code may still hold. So replaced tables
+  are never freed: they are put on a list of retired tables, and
+  stay there until the process exits. This is a deliberate leak of
+  one table (a few kB, see sizeof (cw_character_table_t)) per call
+  to cw_load_character_table() or cw_load_character_table_file()
+  that replaces a loaded table. The default table is static and
+  isn't retired.
+
+  Code that validates a character and then looks it up, or looks up
+  many characters, gets current table once (with
+  cw_character_table_internal()) and uses the cw_character_table_*()
+  lookup functions, so that all lookups see the same table even if
+  the table is swapped in the meantime.
+*/
+struct cw_character_table_struct {
+	/* Representations indexed with character. Empty string
+	   for characters without representation. */
+	char representations[UCHAR_MAX + 1][CW_DATA_MAX_REPRESENTATION_LENGTH + 1];
+
+	/* Characters indexed with hash of representation. Zero for
+	   representations without character. */
+	char characters[CW_DATA_MAX_REPRESENTATION_HASH + 1];
+
+	/* Classes of all byte values, for validation of strings. */
+	cw_character_classes_t classes;
+
+	/* All characters of the table, in order of adding them. */
+	char list[UCHAR_MAX + 1];
+	int n_characters;
+	int max_representation_length;
+
+	/* Next table on list of retired tables. */
+	struct cw_character_table_struct *retired;
+};
+
+static cw_character_table_t cw_character_table_default;
+static cw_character_table_t *cw_character_table_current = NULL;  /* Accessed only with __atomic builtins. */
+static cw_character_table_t *cw_character_table_retired = NULL;
+static pthread_once_t cw_character_table_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t cw_character_table_mutex = PTHREAD_MUTEX_INITIALIZER;  /* Serializes swaps of tables. */
+
+
+
+
+static void cw_character_table_init_internal(void);
+static void cw_character_table_clear_internal(cw_character_table_t *table);
+static int  cw_character_table_add_internal(cw_character_table_t *table, char character, const char *representation);
+static void cw_character_table_finalize_internal(cw_character_table_t *table);
+static void cw_character_table_swap_internal(cw_character_table_t *table);
+static int  cw_character_table_parse_line_internal(char *line, char *character, char **representation);
+
+
+
+
+/**
+   \brief Get current table of characters
+
+   Lookup functions call this function once per lookup. The table
+   with characters from CW_TABLE is built on first call.
+
+   \return current table of characters
+*/
+const cw_character_table_t *cw_character_table_internal(void)
+{
+	const cw_character_table_t *table = __atomic_load_n(&cw_character_table_current, __ATOMIC_ACQUIRE);
+	if (!table) {
+		pthread_once(&cw_character_table_once, cw_character_table_init_internal);
+		table = __atomic_load_n(&cw_character_table_current, __ATOMIC_ACQUIRE);
+	}
+
+	return table;
+}
+
+
+
+
+/**
+   \brief Build default table of characters
+
+   Called once, through pthread_once(). The default table is made
+   current unless client code has already loaded its own table.
+*/
+void cw_character_table_init_internal(void)
+{
+	cw_debug_msg (&cw_debug_object, CW_DEBUG_LOOKUPS, CW_DEBUG_INFO,
+		      MSG_PREFIX "initializing fast lookup tables");
+
+	cw_character_table_clear_internal(&cw_character_table_default);
+	cw_character_table_finalize_internal(&cw_character_table_default);
+
+	cw_character_table_t *expected = NULL;
+	__atomic_compare_exchange_n(&cw_character_table_current, &expected, &cw_character_table_default,
+				    false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+
+	return;
+}
+
+
+
+
+/**
+   \brief Put characters from CW_TABLE in a table of characters
+
+   \param table - table to initialize
+*/
+void cw_character_table_clear_internal(cw_character_table_t *table)
+{
+	memset(table, 0, sizeof (cw_character_table_t));
+
+	for (const cw_entry_t *cw_entry = CW_TABLE; cw_entry->character; cw_entry++) {
+		cw_character_table_add_internal(table, cw_entry->character, cw_entry->representation);
+	}
+
+	return;
+}
+
+
+
+
+/**
+   \brief Add a character to a table of characters
+
+   If the character is already in the table, its representation is
+   replaced. If another character has the same representation,
+   receivers will decode the representation as \p character.
+
+   Lowercase letters are added as uppercase letters, since lookup
+   functions don't differentiate between upper and lower case.
+
+   \errno EINVAL - \p character can't be added (it's a space character or NUL)
+   \errno EINVAL - \p representation is invalid or too long
+
+   \param table - table to modify
+   \param character - character to add
+   \param representation - representation of the character
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_character_table_add_internal(cw_character_table_t *table, char character, const char *representation)
+{
+	const unsigned char c = (unsigned char) toupper((unsigned char) character);
+	if (c == '\0' || c == '\b' || isspace(c)) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	const uint8_t hash = cw_representation_to_hash_internal(representation);
+	if (!hash) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	char *current = table->representations[c];
+	if (current[0] == '\0') {
+		table->list[table->n_characters++] = (char) c;
+	} else {
+		/* Replace current representation of the character. */
+		const uint8_t current_hash = cw_representation_to_hash_internal(current);
+		if ((unsigned char) table->characters[current_hash] == c) {
+			table->characters[current_hash] = '\0';
+		}
+	}
+
+	snprintf(current, CW_DATA_MAX_REPRESENTATION_LENGTH + 1, "%s", representation);
+	table->characters[hash] = (char) c;
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Build derived data of a table of characters
+
+   Call the function after last character has been added to the
+   table.
+
+   \param table - table to finalize
+*/
+void cw_character_table_finalize_internal(cw_character_table_t *table)
+{
+	table->list[table->n_characters] = '\0';
+
+	cw_character_classes_t *classes = &table->classes;
+	for (int c = 0; c <= UCHAR_MAX; c++) {
+		classes->flags[c] = isspace(c) ? CW_DATA_CLASS_SPACE : 0;
+		classes->folded[c] = (char) c;
+	}
+
+	table->max_representation_length = 0;
+	for (int i = 0; i < table->n_characters; i++) {
+		const unsigned char c = (unsigned char) table->list[i];
+		classes->flags[c] |= CW_DATA_CLASS_VALID;
+
+		const unsigned char lower = (unsigned char) tolower(c);
+		if (lower != c) {
+			classes->flags[lower] |= CW_DATA_CLASS_VALID;
+			classes->folded[lower] = (char) c;
+		}
+
+		const int length = (int) strlen(table->representations[c]);
+		if (length > table->max_representation_length) {
+			table->max_representation_length = length;
+		}
+	}
+
+	/* Special cases. */
+	classes->flags[' '] |= CW_DATA_CLASS_VALID;
+	classes->flags['\b'] |= CW_DATA_CLASS_VALID;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Make a table of characters current
+
+   Previously current table is retired, unless it is the default
+   table.
+
+   \param table - new current table
+*/
+void cw_character_table_swap_internal(cw_character_table_t *table)
+{
+	/* Make sure that the default table exists before it can be
+	   made current by cw_reset_character_table(). */
+	pthread_once(&cw_character_table_once, cw_character_table_init_internal);
+
+	pthread_mutex_lock(&cw_character_table_mutex);
+
+	cw_character_table_t *old = __atomic_exchange_n(&cw_character_table_current, table, __ATOMIC_ACQ_REL);
+	if (old != &cw_character_table_default && old != table) {
+		old->retired = cw_character_table_retired;
+		cw_character_table_retired = old;
+	}
+
+	pthread_mutex_unlock(&cw_character_table_mutex);
+
+	cw_debug_msg (&cw_debug_object, CW_DEBUG_LOOKUPS, CW_DEBUG_INFO,
+		      MSG_PREFIX "swapped table of characters, %d characters", table->n_characters);
+
+	return;
+}
+
+
+
+
 /**
    \brief Return the number of characters present in character lookup table
 
@@ -149,15 +415,7 @@ const cw_entry_t CW_TABLE[] = { /* TODO: make it accessible through function onl
 */
 int cw_get_character_count(void)
 {
-	static int character_count = 0;
-
-	if (character_count == 0) {
-		for (const cw_entry_t *cw_entry = CW_TABLE; cw_entry->character; cw_entry++) {
-			character_count++;
-		}
-	}
-
-	return character_count;
+	return cw_character_table_internal()->n_characters;
 }
 
 
@@ -190,13 +448,8 @@ void cw_list_characters(char *list)
 {
 	cw_assert (list, MSG_PREFIX "output pointer is NULL");
 
-	/* Append each table character to the output string. */
-	int i = 0;
-	for (const cw_entry_t *cw_entry = CW_TABLE; cw_entry->character; cw_entry++) {
-		list[i++] = cw_entry->character;
-	}
-
-	list[i] = '\0';
+	const cw_character_table_t *table = cw_character_table_internal();
+	memcpy(list, table->list, (size_t) table->n_characters + 1);
 
 	return;
 }
@@ -216,19 +469,7 @@ void cw_list_characters(char *list)
 */
 int cw_get_maximum_representation_length(void)
 {
-	static int maximum_length = 0;
-
-	if (maximum_length == 0) {
-		/* Traverse the main lookup table, finding the longest representation. */
-		for (const cw_entry_t *cw_entry = CW_TABLE; cw_entry->character; cw_entry++) {
-			int length = (int) strlen(cw_entry->representation);
-			if (length > maximum_length) {
-				maximum_length = length;
-			}
-		}
-	}
-
-	return maximum_length;
+	return cw_character_table_internal()->max_representation_length;
 }
 
 
@@ -254,22 +495,25 @@ int cw_get_maximum_representation_length(void)
 */
 const char *cw_character_to_representation_internal(int c)
 {
-	static const cw_entry_t *lookup[UCHAR_MAX];  /* Fast lookup table */
-	static bool is_initialized = false;
+	return cw_character_table_to_representation_internal(cw_character_table_internal(), c);
+}
 
-	/* If this is the first call, set up the fast lookup table to give
-	   direct access to the CW table for a given character. */
-	if (!is_initialized) {
-		cw_debug_msg (&cw_debug_object, CW_DEBUG_LOOKUPS, CW_DEBUG_INFO,
-			      MSG_PREFIX "initializing fast lookup table");
 
-		for (const cw_entry_t *cw_entry = CW_TABLE; cw_entry->character; cw_entry++) {
-			lookup[(unsigned char) cw_entry->character] = cw_entry;
-		}
 
-		is_initialized = true;
-	}
 
+/**
+   \brief Return representation of given character, from given table of characters
+
+   See cw_character_to_representation_internal().
+
+   \param table - table of characters
+   \param c - character to look up
+
+   \return pointer to string with representation of character on success
+   \return NULL on failure (when \p c has no representation)
+*/
+const char *cw_character_table_to_representation_internal(const cw_character_table_t *table, int c)
+{
 	/* There is no differentiation in the lookup and
 	   representation table between upper and lower case
 	   characters; everything is held as uppercase.  So before we
@@ -277,15 +521,16 @@ const char *cw_character_to_representation_internal(int c)
 	   work. */
 	c = toupper(c);
 
-	/* Now use the table to lookup the table entry.  Unknown characters
-	   return NULL, courtesy of the fact that explicitly uninitialized
-	   static variables are initialized to zero, so lookup[x] is NULL
-	   if it's not assigned to in the above loop. */
-	const cw_entry_t *cw_entry = lookup[(unsigned char) c];
+	/* Now use the table to lookup the representation.  Unknown
+	   characters have empty representation. */
+	const char *representation = table->representations[(unsigned char) c];
+	if (representation[0] == '\0') {
+		representation = NULL;
+	}
 
 	if (cw_debug_has_flag((&cw_debug_object), CW_DEBUG_LOOKUPS)) {
-		if (cw_entry) {
-			fprintf(stderr, MSG_PREFIX "char to representation: '%c' -> '%c'/'%s'\n", c, cw_entry->character, cw_entry->representation);
+		if (representation) {
+			fprintf(stderr, MSG_PREFIX "char to representation: '%c' -> '%s'\n", c, representation);
 		} else if (isprint(c)) {
 			fprintf(stderr, MSG_PREFIX "char to representation: '%c' -> NOTHING\n", c);
 		} else {
@@ -293,7 +538,7 @@ const char *cw_character_to_representation_internal(int c)
 		}
 	}
 
-	return cw_entry ? cw_entry->representation : NULL;
+	return representation;
 }
 
 
@@ -465,76 +710,42 @@ uint8_t cw_representation_to_hash_internal(const char *representation)
 */
 int cw_representation_to_character_internal(const char *representation)
 {
-	static const cw_entry_t *lookup[UCHAR_MAX];   /* Fast lookup table */
-	static bool is_complete = true;               /* Set to false if there are any
-							 lookup table entries not in
-							 the fast lookup table */
-	static bool is_initialized = false;
-
-	/* If this is the first call, set up the fast lookup table to give direct
-	   access to the CW table for a hashed representation. */
-	if (!is_initialized) {
-		cw_debug_msg (&cw_debug_object, CW_DEBUG_LOOKUPS, CW_DEBUG_INFO,
-			      MSG_PREFIX "initialize hash lookup table");
-		is_complete = cw_representation_lookup_init_internal(lookup);
-		is_initialized = true;
-	}
+	return cw_character_table_to_character_internal(cw_character_table_internal(), representation);
+}
 
-	/* Hash the representation to get an index for the fast lookup. */
-	uint8_t hash = cw_representation_to_hash_internal(representation);
 
-	const cw_entry_t *cw_entry = NULL;
-	/* If the hashed lookup table is complete, we can simply believe any
-	   hash value that came back.  That is, we just use what is at the index
-	   "hash", since this is either the entry we want, or NULL. */
-	if (is_complete) {
-		cw_entry = lookup[hash];
-	} else {
-		/* Impossible, since test_cw_representation_to_hash_internal()
-		   passes without problems for all valid representations.
 
-		   Debug message is already displayed in
-		   cw_representation_lookup_init_internal(). */
 
-		/* The lookup table is incomplete, but it doesn't have
-		   to be that we are missing entry for this particular
-		   hash.
+/**
+   \brief Return character corresponding to given representation, from given table of characters
 
-		   Try to find the entry in lookup table anyway, maybe
-		   it exists.
+   See cw_representation_to_character_internal().
 
-		   TODO: create tests to find situation where lookup
-		   table is incomplete. */
-		if (hash && lookup[hash] && lookup[hash]->representation
-		    && strcmp(lookup[hash]->representation, representation) == 0) {
-			/* Found it in an incomplete table. */
-			cw_entry = lookup[hash];
-		} else {
-			/* We have no choice but to search the table entry
-			   by entry, sequentially, from top to bottom. */
-			for (cw_entry = CW_TABLE; cw_entry->character; cw_entry++) {
-				if (strcmp(cw_entry->representation, representation) == 0) {
-					break;
-				}
-			}
+   \param table - table of characters
+   \param representation - representation of a character to look up
 
-			/* If we got to the end of the table, prepare to return zero. */
-			cw_entry = cw_entry->character ? cw_entry : NULL;
-		}
-	}
+   \return zero if there is no character for given representation
+   \return non-zero character corresponding to given representation otherwise
+*/
+int cw_character_table_to_character_internal(const cw_character_table_t *table, const char *representation)
+{
+	/* Hash the representation to get an index for the fast
+	   lookup. Invalid representations have hash equal to zero,
+	   and there is no character at index zero. */
+	const uint8_t hash = cw_representation_to_hash_internal(representation);
+	const int character = table->characters[hash];
 
 	if (cw_debug_has_flag((&cw_debug_object), CW_DEBUG_LOOKUPS)) {
-		if (cw_entry) {
-			fprintf(stderr, MSG_PREFIX "lookup [0x%02x]'%s' returned <'%c':\"%s\">\n",
-				hash, representation,
-				cw_entry->character, cw_entry->representation);
+		if (character) {
+			fprintf(stderr, MSG_PREFIX "lookup [0x%02x]'%s' returned '%c'\n",
+				hash, representation, character);
 		} else {
 			fprintf(stderr, MSG_PREFIX "lookup [0x%02x]'%s' found nothing\n",
 				hash, representation);
 		}
 	}
 
-	return cw_entry ? cw_entry->character : 0;
+	return character;
 }
 
 
@@ -609,10 +820,9 @@ int cw_representation_to_character_direct_internal(const char *representation)
    Second condition of function's success, mentioned above, should be
    also always true because first condition is always true.
 
-   The initialization may fail under one condition: if the lookup
-   functions should operate on non-standard character table, other
-   than CW_TABLE. For now it's impossible, because there is no way for
-   client code to provide its own table of CW characters.
+   Characters defined by client code are validated when they are
+   loaded (see cw_load_character_table()), so they aren't a concern
+   here.
 
    \param lookup - lookup table to be initialized
 
@@ -815,6 +1025,218 @@ int cw_representation_to_character(const char *representation)
 
 
 
+/* ******************************************************************** */
+/*           Section:Tables of characters defined by client code        */
+/* ******************************************************************** */
+
+
+
+
+/**
+   \brief Add characters to main table of characters
+
+   Build a new table of characters from main table of characters and
+   from \p count characters and their representations, and make it
+   current. Lookup functions of all generators and receivers start
+   using the new table immediately, without being stopped.
+
+   Characters that are already in main table get new
+   representations. If a representation belongs to two characters,
+   receivers decode the representation as the character given to
+   this function. Each call starts from main table of characters, so
+   characters added by previous calls are dropped.
+
+   Valid representations consist of 1 to
+   CW_DATA_MAX_REPRESENTATION_LENGTH Dots and Dashes. Space
+   characters can't be redefined.
+
+   If any of the characters or representations is invalid, current
+   table isn't changed.
+
+   Memory of a table that has been replaced by next call to this
+   function (a few kB) isn't freed until the process exits, because
+   running generators and receivers may still be using the table.
+   Load tables rarely, e.g. on start of program or on change of
+   configuration.
+
+   \errno EINVAL - invalid character or representation
+   \errno ENOMEM - failed to allocate memory for the table
+
+   \param characters - characters to add
+   \param representations - representations of \p characters
+   \param count - count of characters
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_load_character_table(const char *characters, const char *const representations[], int count)
+{
+	cw_character_table_t *table = (cw_character_table_t *) malloc(sizeof (cw_character_table_t));
+	if (!table) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "load table: malloc()");
+		errno = ENOMEM;
+		return CW_FAILURE;
+	}
+
+	cw_character_table_clear_internal(table);
+	for (int i = 0; i < count; i++) {
+		if (!cw_character_table_add_internal(table, characters[i], representations[i])) {
+			cw_debug_msg (&cw_debug_object, CW_DEBUG_LOOKUPS, CW_DEBUG_ERROR,
+				      MSG_PREFIX "load table: invalid entry #%d", i);
+			free(table);
+			errno = EINVAL;
+			return CW_FAILURE;
+		}
+	}
+	cw_character_table_finalize_internal(table);
+
+	cw_character_table_swap_internal(table);
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Add characters from a file to main table of characters
+
+   The function works as cw_load_character_table(), but characters
+   and representations are read from a text file. Each line of the
+   file contains a character, white space, and representation of the
+   character, e.g. "* ...-.-". Character may also be given as its
+   code: "0x23 -.-.--". Empty lines and lines starting with '#'
+   followed by white space are ignored.
+
+   \errno EINVAL - invalid line in the file
+   \errno ENOMEM - failed to allocate memory for the table
+   \errno other - failed to read the file (see fopen())
+
+   \param path - path to file
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_load_character_table_file(const char *path)
+{
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "load table: fopen(%s)", path);
+		return CW_FAILURE;
+	}
+
+	cw_character_table_t *table = (cw_character_table_t *) malloc(sizeof (cw_character_table_t));
+	if (!table) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "load table: malloc()");
+		fclose(file);
+		errno = ENOMEM;
+		return CW_FAILURE;
+	}
+
+	cw_character_table_clear_internal(table);
+	int line_number = 0;
+	char line[128];
+	while (fgets(line, sizeof (line), file)) {
+		line_number++;
+
+		char character = '\0';
+		char *representation = NULL;
+		if (!cw_character_table_parse_line_internal(line, &character, &representation)
+		    || (representation && !cw_character_table_add_internal(table, character, representation))) {
+
+			cw_debug_msg (&cw_debug_object, CW_DEBUG_LOOKUPS, CW_DEBUG_ERROR,
+				      MSG_PREFIX "load table: invalid line %d in %s", line_number, path);
+			free(table);
+			fclose(file);
+			errno = EINVAL;
+			return CW_FAILURE;
+		}
+	}
+
+	const bool is_error = ferror(file);
+	fclose(file);
+	if (is_error) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "load table: fgets(%s)", path);
+		free(table);
+		errno = EIO;
+		return CW_FAILURE;
+	}
+
+	cw_character_table_finalize_internal(table);
+	cw_character_table_swap_internal(table);
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Parse a line of file with table of characters
+
+   See cw_load_character_table_file() for format of the line. The
+   line is modified. \p representation is set to NULL for empty lines
+   and comments.
+
+   \param line - line to parse
+   \param character - parsed character
+   \param representation - parsed representation (pointer into \p line)
+
+   \return CW_SUCCESS if the line is valid
+   \return CW_FAILURE otherwise
+*/
+int cw_character_table_parse_line_internal(char *line, char *character, char **representation)
+{
+	*representation = NULL;
+
+	char *first = strtok(line, " \t\r\n");
+	if (!first || (first[0] == '#' && first[1] == '\0')) {
+		return CW_SUCCESS;
+	}
+	char *second = strtok(NULL, " \t\r\n");
+	if (!second || strtok(NULL, " \t\r\n")) {
+		return CW_FAILURE;
+	}
+
+	if (first[1] == '\0') {
+		*character = first[0];
+	} else if (first[0] == '0' && (first[1] == 'x' || first[1] == 'X')
+		   && isxdigit((unsigned char) first[2]) && isxdigit((unsigned char) first[3]) && first[4] == '\0') {
+		*character = (char) strtoul(first + 2, NULL, 16);
+	} else {
+		return CW_FAILURE;
+	}
+
+	*representation = second;
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Go back to main table of characters
+
+   Drop characters added with cw_load_character_table() or
+   cw_load_character_table_file().
+*/
+void cw_reset_character_table(void)
+{
+	pthread_once(&cw_character_table_once, cw_character_table_init_internal);
+	cw_character_table_swap_internal(&cw_character_table_default);
+
+	return;
+}
+
+
+
+
+
 /* ******************************************************************** */
 /*   Section:Extended Morse code data and lookup (procedural signals)   */
 /* ******************************************************************** */
@@ -1221,9 +1643,11 @@ int cw_check_character(char c)
 bool cw_string_is_valid(const char *string)
 {
 	/* Check that each character in the string has a Morse
-	   representation, or - as a special case - is a space character. */
-	for (int i = 0; string[i] != '\0'; i++) {
-		if (!cw_character_is_valid(string[i])) {
+	   representation, or - as a special case - is a space
+	   character. One table lookup per character. */
+	const cw_character_classes_t *classes = cw_character_classes_internal();
+	for (const unsigned char *c = (const unsigned char *) string; *c != '\0'; c++) {
+		if (!(classes->flags[*c] & CW_DATA_CLASS_VALID)) {
 			errno = EINVAL;
 			return CW_FAILURE;
 		}
@@ -1240,3 +1664,103 @@ int cw_check_string(const char *string)
 {
 	return cw_string_is_valid(string);
 }
+
+
+
+
+
+/**
+   \brief Validate and normalize a string in one pass
+
+   Prepare \p string for sending: every run of white space is
+   replaced with single space, lowercase characters are converted to
+   uppercase, and characters that can't be sent are removed.
+   Positions (offsets in \p string) of removed characters are
+   reported in \p positions, so that large inputs can be checked
+   before they are queued, without calling cw_character_is_valid()
+   for each character.
+
+   \p normalized must have space for strlen(\p string) + 1
+   characters. It may be the same buffer as \p string. Pass NULL as
+   \p normalized to only validate the string.
+
+   Count of invalid characters is returned even if it is larger than
+   \p n_positions_max.
+
+   \param string - string to validate and normalize
+   \param normalized - buffer for normalized string (may be NULL)
+   \param positions - buffer for positions of invalid characters (may be NULL)
+   \param n_positions_max - size of \p positions
+
+   \return count of invalid characters in \p string
+*/
+int cw_string_normalize(const char *string, char *normalized, size_t *positions, int n_positions_max)
+{
+	const cw_character_classes_t *classes = cw_character_classes_internal();
+	int n_invalid = 0;
+	bool is_space = false;
+	char *out = normalized;
+
+	for (size_t i = 0; string[i] != '\0'; i++) {
+		const unsigned char c = (unsigned char) string[i];
+		const uint8_t flags = classes->flags[c];
+
+		if (flags & CW_DATA_CLASS_SPACE) {
+			if (!is_space && out) {
+				*out++ = ' ';
+			}
+			is_space = true;
+		} else if (flags & CW_DATA_CLASS_VALID) {
+			if (out) {
+				*out++ = classes->folded[c];
+			}
+			is_space = false;
+		} else {
+			/* Invalid character doesn't break a run of
+			   white space. */
+			if (positions && n_invalid < n_positions_max) {
+				positions[n_invalid] = i;
+			}
+			n_invalid++;
+		}
+	}
+
+	if (out) {
+		*out = '\0';
+	}
+
+	return n_invalid;
+}
+
+
+
+
+/**
+   \brief Get table of classes of all byte values
+
+   The classes are a part of current table of characters (see
+   cw_load_character_table()); a function processing a string should
+   get them once, before processing the string. See
+   cw_character_is_valid() for definition of valid character.
+
+   \return pointer to table of classes
+*/
+const cw_character_classes_t *cw_character_classes_internal(void)
+{
+	return cw_character_table_classes_internal(cw_character_table_internal());
+}
+
+
+
+
+/**
+   \brief Get table of classes of all byte values, from given table of characters
+
+   \param table - table of characters
+
+   \return pointer to table of classes
+*/
+const cw_character_classes_t *cw_character_table_classes_internal(const cw_character_table_t *table)
+{
+	return &table->classes;
+}
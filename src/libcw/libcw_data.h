@@ -11,6 +11,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <limits.h> /* UCHAR_MAX */
 
 
 
@@ -43,4 +44,34 @@ const char  *cw_lookup_procedural_character_internal(int c, bool *is_usually_exp
 
 
 
+/* Flags of classes of characters. */
+#define CW_DATA_CLASS_VALID 0x01 /* Character can be sent (see cw_character_is_valid()). */
+#define CW_DATA_CLASS_SPACE 0x02 /* White space. */
+
+/* Classes of all byte values, for processing of whole strings. */
+typedef struct {
+	uint8_t flags[UCHAR_MAX + 1];  /* CW_DATA_CLASS_* flags. */
+	char folded[UCHAR_MAX + 1];    /* Uppercase form of valid character. */
+} cw_character_classes_t;
+
+const cw_character_classes_t *cw_character_classes_internal(void);
+
+
+
+
+/* Table of characters, built from main table of characters and from
+   characters defined by client code. */
+typedef struct cw_character_table_struct cw_character_table_t;
+
+/* Functions that look up more than one character, or validate a
+   character and then look it up, get current table once and do all
+   lookups in it. */
+const cw_character_table_t    *cw_character_table_internal(void);
+const char                    *cw_character_table_to_representation_internal(const cw_character_table_t *table, int c);
+int                            cw_character_table_to_character_internal(const cw_character_table_t *table, const char *representation);
+const cw_character_classes_t  *cw_character_table_classes_internal(const cw_character_table_t *table);
+
+
+
+
 #endif /* #ifndef H_LIBCW_DATA */
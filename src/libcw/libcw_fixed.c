@@ -0,0 +1,211 @@
+/*
+  Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+  Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+/**
+   \file libcw_fixed.c
+
+   \brief Integer arithmetic for fixed-point synthesis of sine wave.
+
+   Generator may synthesize samples without floating point
+   arithmetic (see cw_gen_set_synthesis()), which is expensive on
+   processors without FPU. Phase of sine wave is kept in 32-bit
+   accumulator, sine is read from a quarter-wave table of Q15 values
+   with linear interpolation, and amplitudes are multiplied with
+   saturation to 16 bits.
+*/
+
+
+
+
+#include "config.h"
+
+
+#include <math.h>
+
+
+#include "libcw_fixed.h"
+
+
+
+
+/* sin(i * Pi / 512) in Q15 format, for i = 0..256 (quarter of a
+   period). */
+static const int16_t cw_fixed_sine_table[257] = {
+	    0,   201,   402,   603,   804,  1005,  1206,  1407,
+	 1608,  1809,  2009,  2210,  2411,  2611,  2811,  3012,
+	 3212,  3412,  3612,  3812,  4011,  4211,  4410,  4609,
+	 4808,  5007,  5205,  5404,  5602,  5800,  5998,  6195,
+	 6393,  6590,  6787,  6983,  7180,  7376,  7571,  7767,
+	 7962,  8157,  8351,  8546,  8740,  8933,  9127,  9319,
+	 9512,  9704,  9896, 10088, 10279, 10469, 10660, 10850,
+	11039, 11228, 11417, 11605, 11793, 11980, 12167, 12354,
+	12540, 12725, 12910, 13095, 13279, 13463, 13646, 13828,
+	14010, 14192, 14373, 14553, 14733, 14912, 15091, 15269,
+	15447, 15624, 15800, 15976, 16151, 16326, 16500, 16673,
+	16846, 17018, 17190, 17361, 17531, 17700, 17869, 18037,
+	18205, 18372, 18538, 18703, 18868, 19032, 19195, 19358,
+	19520, 19681, 19841, 20001, 20160, 20318, 20475, 20632,
+	20788, 20943, 21097, 21251, 21403, 21555, 21706, 21856,
+	22006, 22154, 22302, 22449, 22595, 22740, 22884, 23028,
+	23170, 23312, 23453, 23593, 23732, 23870, 24008, 24144,
+	24279, 24414, 24548, 24680, 24812, 24943, 25073, 25202,
+	25330, 25457, 25583, 25708, 25833, 25956, 26078, 26199,
+	26320, 26439, 26557, 26674, 26791, 26906, 27020, 27133,
+	27246, 27357, 27467, 27576, 27684, 27791, 27897, 28002,
+	28106, 28209, 28311, 28411, 28511, 28610, 28707, 28803,
+	28899, 28993, 29086, 29178, 29269, 29359, 29448, 29535,
+	29622, 29707, 29792, 29875, 29957, 30038, 30118, 30196,
+	30274, 30350, 30425, 30499, 30572, 30644, 30715, 30784,
+	30853, 30920, 30986, 31050, 31114, 31177, 31238, 31298,
+	31357, 31415, 31471, 31527, 31581, 31634, 31686, 31737,
+	31786, 31834, 31881, 31927, 31972, 32015, 32058, 32099,
+	32138, 32177, 32214, 32251, 32286, 32319, 32352, 32383,
+	32413, 32442, 32470, 32496, 32522, 32546, 32568, 32590,
+	32610, 32629, 32647, 32664, 32679, 32693, 32706, 32718,
+	32729, 32738, 32746, 32753, 32758, 32762, 32766, 32767,
+	32767,
+};
+
+
+
+
+/**
+   \brief Calculate sine of phase
+
+   Error of the result is at most 1 (in units of Q15).
+
+   \param phase - phase (2^32 = 2 * Pi)
+
+   \return sine in Q15 format, -32767 to 32767
+*/
+int16_t cw_fixed_sin_internal(uint32_t phase)
+{
+	const uint32_t quadrant = phase >> 30;
+	uint32_t position = phase & 0x3fffffff;
+	if (quadrant & 1) {
+		/* Falling quarters are mirrored rising quarters. */
+		position = 0x3fffffff - position;
+	}
+
+	/* 8 bits of index in table, 15 bits of fraction for
+	   interpolation between two items of table. */
+	const uint32_t i = position >> 22;
+	const int32_t fraction = (int32_t) ((position >> 7) & 0x7fff);
+	const int32_t a = cw_fixed_sine_table[i];
+	const int32_t b = cw_fixed_sine_table[i + 1];
+	const int32_t value = a + (((b - a) * fraction) >> 15);
+
+	return (int16_t) (quadrant & 2 ? -value : value);
+}
+
+
+
+
+/**
+   \brief Saturate value to range of 16-bit sample
+
+   \param value - value
+
+   \return value limited to INT16_MIN - INT16_MAX
+*/
+int16_t cw_fixed_saturate_internal(int32_t value)
+{
+	if (value > INT16_MAX) {
+		return INT16_MAX;
+	} else if (value < INT16_MIN) {
+		return INT16_MIN;
+	} else {
+		return (int16_t) value;
+	}
+}
+
+
+
+
+/**
+   \brief Multiply value by Q15 factor, with rounding and saturation
+
+   \param a - value, -32768 to 32768
+   \param b_q15 - factor in Q15 format
+
+   \return a * b_q15 / 2^15, limited to 16 bits
+*/
+int16_t cw_fixed_mul_q15_internal(int32_t a, int32_t b_q15)
+{
+	return cw_fixed_saturate_internal((a * b_q15 + (1 << 14)) >> 15);
+}
+
+
+
+
+/**
+   \brief Calculate increment of phase per sample
+
+   Increment is exact: remainder of division is accumulated by
+   caller, so phase of fixed-point synthesis doesn't drift from
+   phase of floating-point synthesis.
+
+   \param step - output, increment of phase
+   \param frequency - frequency of sine wave [Hz]
+   \param sample_rate - sample rate [Hz]
+*/
+void cw_fixed_step_internal(cw_fixed_step_t * step, int frequency, int sample_rate)
+{
+	const uint64_t numerator = (uint64_t) (uint32_t) frequency << 32;
+	step->increment = (uint32_t) (numerator / (uint32_t) sample_rate);
+	step->remainder = (uint32_t) (numerator % (uint32_t) sample_rate);
+	step->sample_rate = (uint32_t) sample_rate;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Convert phase in radians to fixed-point phase
+
+   The function is used only when synthesis is switched, not for
+   every sample.
+
+   \param phase - phase in range 0 - 2 * Pi
+
+   \return fixed-point phase
+*/
+uint32_t cw_fixed_phase_from_radians_internal(double phase)
+{
+	const double fraction = phase / (2.0 * M_PI);
+	return (uint32_t) (uint64_t) ((fraction - floor(fraction)) * 4294967296.0);
+}
+
+
+
+
+/**
+   \brief Convert fixed-point phase to phase in radians
+
+   \param phase - fixed-point phase
+
+   \return phase in range 0 - 2 * Pi
+*/
+double cw_fixed_phase_to_radians_internal(uint32_t phase)
+{
+	return phase * (2.0 * M_PI / 4294967296.0);
+}
@@ -0,0 +1,41 @@
+/*
+  This file is a part of unixcw project.
+  unixcw project is covered by GNU General Public License, version 2 or later.
+*/
+
+#ifndef H_LIBCW_FIXED
+#define H_LIBCW_FIXED
+
+
+
+
+#include <stdint.h>
+
+
+
+
+/* Phase of sine wave in fixed-point synthesis is an unsigned 32-bit
+   fraction of a period: 2^32 is a full period (2 * Pi). */
+
+/* Increment of phase per sample, as integer part and remainder (in
+   units of 1/sample_rate of the integer part). */
+typedef struct {
+	uint32_t increment;
+	uint32_t remainder;
+	uint32_t sample_rate;
+} cw_fixed_step_t;
+
+
+
+
+int16_t cw_fixed_sin_internal(uint32_t phase);
+int16_t cw_fixed_mul_q15_internal(int32_t a, int32_t b_q15);
+int16_t cw_fixed_saturate_internal(int32_t value);
+void    cw_fixed_step_internal(cw_fixed_step_t * step, int frequency, int sample_rate);
+uint32_t cw_fixed_phase_from_radians_internal(double phase);
+double  cw_fixed_phase_to_radians_internal(uint32_t phase);
+
+
+
+
+#endif /* #ifndef H_LIBCW_FIXED */
@@ -63,6 +63,7 @@
 #include <signal.h>
 #include <errno.h>
 #include <inttypes.h> /* uint32_t */
+#include <time.h>
 
 #if defined(HAVE_STRING_H)
 # include <string.h>
@@ -78,11 +79,15 @@
 #include "libcw_gen.h"
 #include "libcw_debug.h"
 #include "libcw_utils.h"
+#include "libcw_pool.h"
+#include "libcw_fixed.h"
 #include "libcw_signal.h"
 #include "libcw_data.h"
+#include "libcw_alphabet.h"
 #include "libcw_null.h"
 #include "libcw_console.h"
 #include "libcw_oss.h"
+#include "libcw_codec.h"
 #include "libcw2.h"
 #include "libcw_gen_internal.h"
 
@@ -94,6 +99,18 @@
 
 
 
+/* Inter-word space is enqueued as this many tones, see
+   cw_gen_enqueue_eow_space_internal(). */
+#define CW_GEN_EOW_SPACE_N_PARTS 2
+
+/* Message enqueued with cw_gen_enqueue_at() is moved to tone queue
+   (preceded by silence of calculated length) when there is less than
+   this time left to its start. [us] */
+#define CW_GEN_TIMED_HORIZON     200000
+
+
+
+
 #ifndef M_PI  /* C99 may not define M_PI */
 #define M_PI  3.14159265358979323846
 #endif
@@ -205,7 +222,25 @@ char *cw_gen_get_audio_system_label_internal(cw_gen_t *gen)
 */
 int cw_gen_start(cw_gen_t * gen)
 {
-	gen->phase_offset = 0.0;
+	if (gen->render.is_external) {
+		/* Samples of this generator are rendered by external
+		   code (e.g. by session scheduler). Running generator's
+		   own thread would compete with the external code for
+		   tones in tone queue. */
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_GENERATOR, CW_DEBUG_ERROR,
+			      MSG_PREFIX "can't start generator driven by external code");
+		errno = EBUSY;
+		return CW_FAILURE;
+	}
+
+	cw_gen_set_phase_internal(gen, 0.0);
+	if (gen->encoder) {
+		cw_codec_encoder_reset_phase_internal(gen->encoder);
+	}
+	if (gen->sink.resampler) {
+		cw_resampler_reset(gen->sink.resampler);
+		gen->sink.buffer_fill = 0;
+	}
 
 	/* This should be set to true before launching
 	   cw_gen_dequeue_and_generate_internal(), because loop in the
@@ -339,6 +374,15 @@ int cw_gen_silence_internal(cw_gen_t *gen)
 		return CW_SUCCESS;
 	}
 
+	if (gen->buffer) {
+		/* Straight key keying the generator may be closed.
+		   Release it, otherwise the generator would generate
+		   the tone forever. */
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		cw_gen_sk_publish_edge_internal(gen, false, &now);
+	}
+
 	if (!gen->thread.running) {
 		/* Silencing a generator means enqueueing and generating
 		   a tone with zero frequency.  We shouldn't do this
@@ -397,6 +441,67 @@ int cw_gen_silence_internal(cw_gen_t *gen)
 
 */
 cw_gen_t * cw_gen_new(int audio_system, const char * device)
+{
+	const size_t size = cw_gen_get_storage_size();
+	void * storage = NULL;
+	if (0 != posix_memalign(&storage, CW_STORAGE_ALIGNMENT, size)) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR, MSG_PREFIX "posix_memalign()");
+		return (cw_gen_t *) NULL;
+	}
+
+	cw_gen_t * gen = cw_gen_init(storage, size, audio_system, device);
+	if (!gen) {
+		free(storage);
+		return (cw_gen_t *) NULL;
+	}
+	gen->is_allocated = true;
+
+	return gen;
+}
+
+
+
+
+/**
+   \brief Get size of storage for generator
+
+   Generator and its tone queue are placed in one block of memory.
+   The size is a multiple of cw_get_storage_alignment(), so storages
+   of several objects can be placed back to back in one block.
+
+   \return size of storage required by cw_gen_init() [bytes]
+*/
+size_t cw_gen_get_storage_size(void)
+{
+	return CW_STORAGE_SIZE(sizeof (cw_gen_t)) + CW_STORAGE_SIZE(sizeof (cw_tone_queue_t));
+}
+
+
+
+
+/**
+   \brief Create new generator in storage provided by caller
+
+   Storage of \p size bytes, aligned to cw_get_storage_alignment(),
+   must be provided by caller and must outlive the generator. Use
+   cw_gen_deinit() to release resources of the generator (audio
+   sink, sample buffer, table of slope amplitudes) before the storage
+   is reused. cw_gen_delete() may be also used: it deinitializes
+   the generator, but doesn't deallocate the storage.
+
+   Storages may be taken from cw_pool_t.
+
+   \errno EINVAL - storage is NULL, too small, or misaligned
+
+   \param storage - memory for generator
+   \param size - size of \p storage, at least cw_gen_get_storage_size()
+   \param audio_system - audio system to be used by generator
+   \param device - name of audio device to be used by generator
+
+   \return pointer to generator on success (equal to \p storage)
+   \return NULL on failure
+*/
+cw_gen_t * cw_gen_init(void * storage, size_t size, int audio_system, const char * device)
 {
 #ifdef LIBCW_WITH_DEV
 	fprintf(stderr, "libcw build %s %s\n", __DATE__, __TIME__);
@@ -404,24 +509,23 @@ cw_gen_t * cw_gen_new(int audio_system, const char * device)
 
 	cw_assert (audio_system != CW_AUDIO_NONE, MSG_PREFIX "can't create generator with audio system '%s'", cw_get_audio_system_label(audio_system));
 
-	cw_gen_t *gen = (cw_gen_t *) malloc(sizeof (cw_gen_t));
-	if (!gen) {
-		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR, MSG_PREFIX "malloc()");
+	if (!cw_storage_is_valid_internal(storage, size, cw_gen_get_storage_size())) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_GENERATOR, CW_DEBUG_ERROR, MSG_PREFIX "invalid storage for generator");
+		errno = EINVAL;
 		return (cw_gen_t *) NULL;
 	}
 
+	cw_gen_t *gen = (cw_gen_t *) storage;
+	gen->is_allocated = false;
+
 
 
 	/* Tone queue. */
 	{
-		gen->tq = cw_tq_new_internal();
-		if (!gen->tq) {
-			cw_gen_delete(&gen);
-			return (cw_gen_t *) NULL;
-		} else {
-			/* Sometimes tq needs to access a key associated with generator. */
-			gen->tq->gen = gen;
-		}
+		gen->tq = (cw_tone_queue_t *) ((char *) storage + CW_STORAGE_SIZE(sizeof (cw_gen_t)));
+		cw_tq_init_internal(gen->tq);
+		/* Sometimes tq needs to access a key associated with generator. */
+		gen->tq->gen = gen;
 	}
 
 
@@ -447,12 +551,19 @@ cw_gen_t * cw_gen_new(int audio_system, const char * device)
 		gen->additional_space_len = 0;
 		gen->adjustment_space_len = 0;
 
+		memset(gen->symbol_len, 0, sizeof (gen->symbol_len));
+
 
 		/* Generator's misc parameters. */
 		gen->quantum_len = CW_AUDIO_QUANTUM_LEN_INITIAL;
 
 
 		gen->parameters_in_sync = false;
+		gen->symbolic_enqueue = false;
+		gen->alphabet = CW_ALPHABET_LATIN;
+		gen->notification_fd = -1;
+		gen->is_playing = false;
+		gen->timeline = (cw_timeline_t *) NULL;
 	}
 
 
@@ -464,15 +575,30 @@ cw_gen_t * cw_gen_new(int audio_system, const char * device)
 		gen->buffer_n_samples = -1;
 		gen->buffer_sub_start = 0;
 		gen->buffer_sub_stop  = 0;
+		gen->buffer_is_silent = false;
 
 		gen->sample_rate = -1;
 		gen->phase_offset = -1;
+#ifdef LIBCW_WITH_FIXED_POINT
+		gen->synthesis = CW_SYNTHESIS_FIXED_POINT;
+#else
+		gen->synthesis = CW_SYNTHESIS_FLOATING_POINT;
+#endif
+		gen->phase_fixed = 0;
+		gen->phase_fixed_remainder = 0;
+
+		gen->sink.resampler = (cw_resampler_t *) NULL;
+		gen->sink.buffer = NULL;
+		gen->sink.buffer_n_samples = 0;
+		gen->sink.buffer_fill = 0;
+		gen->sink.sample_rate = 0;
 
 
 		/* Tone parameters. */
 		gen->tone_slope.len = CW_AUDIO_SLOPE_LEN;
 		gen->tone_slope.shape = CW_TONE_SLOPE_SHAPE_RAISED_COSINE;
 		gen->tone_slope.amplitudes = NULL;
+		gen->tone_slope.amplitudes_fixed = NULL;
 		gen->tone_slope.n_amplitudes = 0;
 
 
@@ -502,6 +628,56 @@ cw_gen_t * cw_gen_new(int audio_system, const char * device)
 	}
 
 
+	/* Rendering driven by external code. */
+	{
+		gen->render.is_external = false;
+		gen->render.has_tone = false;
+		gen->render.dequeued_prev = false;
+		CW_TONE_INIT(&gen->render.tone, 0, 0, CW_SLOPE_MODE_STANDARD_SLOPES);
+	}
+
+
+	/* Messages waiting for their time. */
+	{
+		gen->timed.items = (cw_gen_timed_t *) NULL;
+		gen->timed.n_items = 0;
+		gen->timed.capacity = 0;
+		gen->timed.sequence = 0;
+		pthread_mutex_init(&gen->timed.mutex, NULL);
+	}
+
+
+	/* Schedule of key edges. */
+	{
+		gen->key_edges.is_enabled = false;
+		gen->key_edges.head = 0;
+		gen->key_edges.tail = 0;
+		gen->key_edges.epoch = 0;
+		gen->key_edges.n_dropped = 0;
+		gen->key_edges.cursor = 0;
+		gen->key_edges.key_value = CW_KEY_STATE_OPEN;
+		gen->key_edges.sink_delay = 0;
+	}
+
+
+	/* Straight key keying generator. */
+	{
+		gen->sk.n_edges = 0;
+		gen->sk.n_consumed = 0;
+		gen->sk.is_closed = false;
+		gen->sk.level = 0;
+		gen->sk.has_prev_buffer = false;
+	}
+
+
+	/* Encoder of generator's output. */
+	gen->encoder = (cw_codec_encoder_t *) NULL;
+
+
+	/* Shared queue forwarded to generator. */
+	gen->shm_tq = (cw_shm_tq_t *) NULL;
+
+
 	/* Audio system. */
 	{
 		gen->audio_device = NULL;
@@ -513,6 +689,7 @@ cw_gen_t * cw_gen_new(int audio_system, const char * device)
 		gen->open_device = NULL;
 		gen->close_device = NULL;
 		gen->write = NULL;
+		gen->get_delay = NULL;
 
 
 		/* Audio system - OSS. */
@@ -540,7 +717,7 @@ cw_gen_t * cw_gen_new(int audio_system, const char * device)
 		if (rv == CW_FAILURE) {
 			cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_SOUND_SYSTEM, CW_DEBUG_ERROR,
 				      MSG_PREFIX "failed to open audio sink for audio system '%s' and device '%s'", cw_get_audio_system_label(audio_system), device);
-			cw_gen_delete(&gen);
+			cw_gen_deinit(gen);
 			return (cw_gen_t *) NULL;
 		}
 
@@ -553,7 +730,7 @@ cw_gen_t * cw_gen_new(int audio_system, const char * device)
 			if (!gen->buffer) {
 				cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
 					      MSG_PREFIX "malloc()");
-				cw_gen_delete(&gen);
+				cw_gen_deinit(gen);
 				return (cw_gen_t *) NULL;
 			}
 		}
@@ -565,7 +742,7 @@ cw_gen_t * cw_gen_new(int audio_system, const char * device)
 		if (rv == CW_FAILURE) {
 			cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_GENERATOR, CW_DEBUG_ERROR,
 				      MSG_PREFIX "failed to set slope");
-			cw_gen_delete(&gen);
+			cw_gen_deinit(gen);
 			return (cw_gen_t *) NULL;
 		}
 	}
@@ -580,6 +757,8 @@ cw_gen_t * cw_gen_new(int audio_system, const char * device)
 /**
    \brief Delete a generator
 
+   Generator created with cw_gen_init() is deinitialized, but its
+   storage is not deallocated.
 */
 void cw_gen_delete(cw_gen_t **gen)
 {
@@ -589,10 +768,38 @@ void cw_gen_delete(cw_gen_t **gen)
 		return;
 	}
 
-	if ((*gen)->do_dequeue_and_generate) {
+	const bool is_allocated = (*gen)->is_allocated;
+	cw_gen_deinit(*gen);
+	if (is_allocated) {
+		free(*gen);
+	}
+	*gen = NULL;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Release resources held by generator
+
+   Stop the generator if necessary, close its audio sink and
+   deallocate memory allocated by the generator. Memory of
+   generator itself is not deallocated.
+
+   \param gen - generator created with cw_gen_init()
+*/
+void cw_gen_deinit(cw_gen_t * gen)
+{
+	if (!gen) {
+		return;
+	}
+
+	if (gen->do_dequeue_and_generate) {
 		cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_GENERATOR, CW_DEBUG_DEBUG,
 			      MSG_PREFIX "you forgot to call cw_gen_stop()");
-		cw_gen_stop(*gen);
+		cw_gen_stop(gen);
 	}
 
 	/* Wait for "write" thread to end accessing output
@@ -603,32 +810,53 @@ void cw_gen_delete(cw_gen_t **gen)
 	   with algorithm for calculating the value. */
 	usleep(500);
 
-	free((*gen)->audio_device);
-	(*gen)->audio_device = NULL;
+	if (gen->shm_tq) {
+		/* Shared queue outlives the generator, but its items
+		   must not be forwarded to it anymore. */
+		cw_shm_tq_forward(gen->shm_tq, (cw_gen_t *) NULL);
+	}
+
+	if (gen->encoder) {
+		/* Encoder outlives the generator, but must not refer
+		   to it anymore. */
+		gen->encoder->gen = (cw_gen_t *) NULL;
+		gen->encoder = (cw_codec_encoder_t *) NULL;
+	}
+
+	free(gen->audio_device);
+	gen->audio_device = NULL;
 
-	free((*gen)->buffer);
-	(*gen)->buffer = NULL;
+	free(gen->buffer);
+	gen->buffer = NULL;
 
-	if ((*gen)->close_device) {
-		(*gen)->close_device(*gen);
+	cw_resampler_delete(&gen->sink.resampler);
+	free(gen->sink.buffer);
+	gen->sink.buffer = NULL;
+
+	if (gen->close_device) {
+		gen->close_device(gen);
 	} else {
 		cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_GENERATOR, CW_DEBUG_WARNING, MSG_PREFIX "WARNING: 'close' function pointer is NULL, something went wrong");
 	}
 
-	pthread_attr_destroy(&(*gen)->thread.attr);
+	pthread_attr_destroy(&gen->thread.attr);
 
-	free((*gen)->client.name);
-	(*gen)->client.name = NULL;
+	free(gen->client.name);
+	gen->client.name = NULL;
 
-	free((*gen)->tone_slope.amplitudes);
-	(*gen)->tone_slope.amplitudes = NULL;
+	free(gen->tone_slope.amplitudes);
+	gen->tone_slope.amplitudes = NULL;
+	free(gen->tone_slope.amplitudes_fixed);
+	gen->tone_slope.amplitudes_fixed = NULL;
 
-	cw_tq_delete_internal(&((*gen)->tq));
+	cw_tq_deinit_internal(gen->tq);
 
-	(*gen)->audio_system = CW_AUDIO_NONE;
+	cw_gen_timed_clear_internal(gen);
+	free(gen->timed.items);
+	gen->timed.items = (cw_gen_timed_t *) NULL;
+	pthread_mutex_destroy(&gen->timed.mutex);
 
-	free(*gen);
-	*gen = NULL;
+	gen->audio_system = CW_AUDIO_NONE;
 
 	return;
 }
@@ -930,12 +1158,32 @@ void *cw_gen_dequeue_and_generate_internal(void *arg)
 	int dequeued_now = CW_FAILURE; /* Status of current call to dequeue(). */
 
 	while (gen->do_dequeue_and_generate) {
+		if (gen->buffer && cw_gen_sk_is_active_internal(gen)) {
+			/* Straight key is keying the generator. Tone
+			   queue is left alone until the key is open
+			   and falling slope is over. */
+			cw_gen_sk_write_internal(gen);
+			/* Buffer has been written completely, there
+			   are no pending samples to pad with
+			   silence. */
+			dequeued_prev = CW_FAILURE;
+			continue;
+		}
+
+		/* Move message that is about to start from waiting
+		   room to tone queue. */
+		cw_gen_timed_dispatch_internal(gen);
+
 		dequeued_now = cw_tq_dequeue_internal(gen->tq, &tone);
 		if (!dequeued_now && !dequeued_prev) {
 
 			cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_TONE_QUEUE, CW_DEBUG_INFO,
 				      MSG_PREFIX "queue is idle");
 
+			/* Tone queue may have been flushed before the
+			   tones were dequeued. */
+			cw_gen_drained_internal(gen);
+
 			/* We won't get here while there are some
 			   accumulated tones in queue, because
 			   cw_tq_dequeue_internal() will be handling
@@ -954,10 +1202,34 @@ void *cw_gen_dequeue_and_generate_internal(void *arg)
 
 			   The kick may also come from cw_gen_stop()
 			   that gently asks this function to stop
-			   idling and nicely return. */
+			   idling and nicely return.
+
+			   Or it may come from straight key that has
+			   just been closed. The key publishes its edge
+			   before taking the mutex, so check for the
+			   edge under the mutex to not miss the kick.
+
+			   Or from cw_gen_enqueue_at(). If there are
+			   messages waiting for their time, don't wait
+			   longer than until the first of them needs to
+			   be dispatched. */
 
 			pthread_mutex_lock(&(gen->tq->dequeue_mutex));
-			pthread_cond_wait(&gen->tq->dequeue_var, &gen->tq->dequeue_mutex);
+			if (!cw_gen_sk_is_active_internal(gen)) {
+				const int64_t timeout = cw_gen_timed_timeout_internal(gen);
+				if (timeout < 0) {
+					pthread_cond_wait(&gen->tq->dequeue_var, &gen->tq->dequeue_mutex);
+				} else if (timeout > 0) {
+					struct timespec deadline;
+					clock_gettime(CLOCK_MONOTONIC, &deadline); /* Clock of dequeue_var, see cw_tq_init_internal(). */
+					const int64_t nsecs = deadline.tv_nsec + (timeout % CW_USECS_PER_SEC) * 1000;
+					deadline.tv_sec += timeout / CW_USECS_PER_SEC + nsecs / CW_NSECS_PER_SEC;
+					deadline.tv_nsec = nsecs % CW_NSECS_PER_SEC;
+					pthread_cond_timedwait(&gen->tq->dequeue_var, &gen->tq->dequeue_mutex, &deadline);
+				} else {
+					; /* Message is due right now. */
+				}
+			}
 			pthread_mutex_unlock(&(gen->tq->dequeue_mutex));
 
 #if 0                   /* Original implementation using signals. */ /* This code has been disabled some time before 2017-01-19. */
@@ -1068,6 +1340,14 @@ void *cw_gen_dequeue_and_generate_internal(void *arg)
 			cw_key_ik_update_graph_state_internal(gen->key);
 		}
 
+		if (dequeued_now) {
+			cw_gen_notify_internal(gen);
+		} else {
+			/* Silence after last tone from tone queue
+			   has been played. */
+			cw_gen_drained_internal(gen);
+		}
+
 #ifdef LIBCW_WITH_DEV
 		cw_debug_ev (&cw_debug_object_ev, 0, tone.frequency ? CW_DEBUG_EVENT_TONE_LOW : CW_DEBUG_EVENT_TONE_HIGH);
 #endif
@@ -1107,369 +1387,451 @@ void *cw_gen_dequeue_and_generate_internal(void *arg)
 
 
 /**
-   \brief Calculate a fragment of sine wave
-
-   Calculate a fragment of sine wave, as many samples as can be fitted
-   in generator buffer's subarea.
+   \brief Get length of symbolic element
 
-   The function calculates values of (gen->buffer_sub_stop - gen->buffer_sub_start + 1)
-   samples and puts them into gen->buffer[], starting from
-   gen->buffer[gen->buffer_sub_start].
+   Get length of symbolic element of Morse code (see CW_TONE_SYMBOL_*)
+   resolved from timing parameters that \p gen has right now.
 
-   The function takes into account all state variables from gen,
-   so initial phase of new fragment of sine wave in the buffer matches
-   ending phase of a sine wave generated in previous call.
+   Lengths of all elements are changed together under
+   gen->tq->mutex. Call the function with the mutex locked when
+   lengths of several elements must come from the same set of
+   parameters.
 
-   \param gen - generator that generates sine wave
-   \param tone - generated tone
+   \param gen - generator
+   \param symbol - symbolic element, other than CW_TONE_SYMBOL_NONE
 
-   \return number of calculated samples
+   \return length of the element [us]
 */
-int cw_gen_calculate_sine_wave_internal(cw_gen_t *gen, cw_tone_t *tone)
+int cw_gen_symbol_len_internal(cw_gen_t const * gen, int symbol)
 {
-	assert (gen->buffer_sub_stop <= gen->buffer_n_samples);
-
-	/* We need two separate iterators to correctly generate sine wave:
-	    -- i -- for iterating through output buffer (generator
-	            buffer's subarea), it can travel between buffer
-	            cells delimited by start and stop (inclusive);
-	    -- t -- for calculating phase of a sine wave; 't' always has to
-	            start from zero for every calculated subarea (i.e. for
-		    every call of this function);
-
-	  Initial/starting phase of generated fragment is always retained
-	  in gen->phase_offset, it is the only "memory" of previously
-	  calculated fragment of sine wave (to be precise: it stores phase
-	  of last sample in previously calculated fragment).
-	  Therefore iterator used to calculate phase of sine wave can't have
-	  the memory too. Therefore it has to always start from zero for
-	  every new fragment of sine wave. Therefore a separate t. */
-
-	double phase = 0.0;
-	int t = 0;
-
-	for (int i = gen->buffer_sub_start; i <= gen->buffer_sub_stop; i++) {
-		phase = (2.0 * M_PI
-				* (double) tone->frequency * (double) t
-				/ (double) gen->sample_rate)
-			+ gen->phase_offset;
-		int amplitude = cw_gen_calculate_amplitude_internal(gen, tone);
+	if (symbol <= CW_TONE_SYMBOL_NONE || symbol >= CW_TONE_SYMBOL_COUNT) {
+		cw_assert (0, MSG_PREFIX "symbol len: unexpected symbol %d", symbol);
+		return 0;
+	}
 
-		gen->buffer[i] = amplitude * sin(phase);
+	return __atomic_load_n(&gen->symbol_len[symbol], __ATOMIC_RELAXED);
+}
 
-		tone->sample_iterator++;
 
-		t++;
-	}
 
-	phase = (2.0 * M_PI
-		 * (double) tone->frequency * (double) t
-		 / (double) gen->sample_rate)
-		+ gen->phase_offset;
 
-	/* "phase" is now phase of the first sample in next fragment to be
-	   calculated.
-	   However, for long fragments this can be a large value, well
-	   beyond <0; 2*Pi) range.
-	   The value of phase may further accumulate in different
-	   calculations, and at some point it may overflow. This would
-	   result in an audible click.
+/**
+   \brief Resolve length of symbolic tone
 
-	   Let's bring back the phase from beyond <0; 2*Pi) range into the
-	   <0; 2*Pi) range, in other words lets "normalize" it. Or, in yet
-	   other words, lets apply modulo operation to the phase.
+   Set length of \p tone that represents a symbolic element of Morse
+   code (see CW_TONE_SYMBOL_*), using timing parameters that \p gen
+   has right now. Length of tones that aren't symbolic is not
+   changed.
 
-	   The normalized phase will be used as a phase offset for next
-	   fragment (during next function call). It will be added phase of
-	   every sample calculated in next function call. */
+   The function is called by cw_tq_dequeue_internal() with
+   gen->tq->mutex locked, so changes of speed, gap or weighting apply
+   also to symbolic tones that have been enqueued before the change,
+   and a tone is never resolved from a half-updated set of lengths.
 
-	int n_periods = floor(phase / (2.0 * M_PI));
-	gen->phase_offset = phase - n_periods * 2.0 * M_PI;
+   \param gen - generator
+   \param tone - dequeued tone
+*/
+void cw_gen_resolve_tone_len_internal(cw_gen_t * gen, cw_tone_t * tone)
+{
+	if (tone->symbol != CW_TONE_SYMBOL_NONE) {
+		tone->len = cw_gen_symbol_len_internal(gen, tone->symbol);
+	}
 
-	return t;
+	return;
 }
 
 
 
 
 /**
-   \brief Calculate value of a single sample of sine wave
+   \brief Render samples of a tone into generator's buffer
 
-   This function calculates an amplitude (a value) of a single sample
-   in sine wave PCM data.
+   Calculate as many remaining samples of \p tone as can be fitted in
+   generator's buffer, starting at index \p start. The samples count
+   of \p tone must have been already calculated, and
+   tone->sample_iterator tells which sample of the tone is rendered
+   first.
 
-   Actually "calculation" is a bit too big word. The function just
-   makes a decision which of precalculated values to return. There are
-   no complicated arithmetical calculations being made each time the
-   function is called, so the execution time should be pretty small.
+   Buffer is split into subareas in the same way as in
+   cw_gen_write_to_soundcard_internal(), so that samples calculated
+   here are identical to samples written to soundcard.
 
-   The precalcuated values depend on some factors, so the values
-   should be re-calculated each time these factors change. See
-   cw_gen_set_tone_slope() for list of these factors.
+   \param gen - generator
+   \param tone - tone to render
+   \param start - index of first free sample in generator's buffer
+   \param stop - index of sample of \p tone after last sample to render (usually tone->n_samples)
 
-   A generator stores some of information needed to get an amplitude
-   of every sample in a sine wave - this is why we have \p gen.  If
-   tone's slopes are non-rectangular, the length of slopes is defined
-   in generator. If a tone is non-silent, the volume is also defined
-   in generator.
+   \return index of first free sample in generator's buffer after rendering
+*/
+int cw_gen_render_tone_internal(cw_gen_t * gen, cw_tone_t * tone, int start, int64_t stop)
+{
+	const int64_t n_left = stop - tone->sample_iterator;
+	const int64_t free_space = gen->buffer_n_samples - start;
+	const int n = (int) (n_left < free_space ? n_left : free_space);
+	if (n > 0) {
+		gen->buffer_sub_start = start;
+		gen->buffer_sub_stop = start + n - 1;
+		cw_gen_calculate_sine_wave_internal(gen, tone);
+		start += n;
+	}
 
-   However, decision tree for getting the amplitude also depends on
-   some parameters that are strictly bound to tone, such as what is
-   the shape of slopes for a given tone - this is why we have \p tone.
-   The \p also stores iterator of samples - this is how we know for
-   which sample to calculate the amplitude.
+	return start;
+}
 
-   \reviewed on 2017-01-24
 
-   \param gen - generator used to generate a sine wave
-   \param tone - tone being generated
 
-   \return value of a sample of sine wave, a non-negative number
+
+/**
+   \brief Render one full buffer of samples
+
+   Fill generator's buffer with exactly gen->buffer_n_samples samples,
+   dequeueing from generator's tone queue as many tones as
+   necessary. A tone that doesn't fit into the buffer is remembered in
+   generator, and its remaining samples are rendered during next
+   call. When tone queue is empty, remainder of the buffer is filled
+   with silence.
+
+   This is a counterpart of cw_gen_dequeue_and_generate_internal() for
+   generators that don't have their own thread but are driven by
+   external code, e.g. by session scheduler (see libcw_sched.c).  The
+   function doesn't write the samples to any audio sink and never
+   waits for tones. It's up to caller to consume gen->buffer after the
+   function returns.
+
+   Key associated with the generator is updated in the same way as in
+   cw_gen_dequeue_and_generate_internal(). While straight key is
+   keying the generator, the buffer is filled with straight key's
+   tone and tone queue isn't touched.
+
+   \param gen - generator to render samples for
+
+   \return number of tones dequeued during the call
 */
-int cw_gen_calculate_amplitude_internal(cw_gen_t *gen, const cw_tone_t *tone)
+int cw_gen_render_buffer_internal(cw_gen_t * gen)
 {
-#if 0   /* Blunt algorithm for calculating amplitude. For debug purposes only. */
-
-	return tone->frequency ? gen->volume_abs : 0;
-
-#else
+	cw_assert (gen->buffer, MSG_PREFIX "render buffer: generator has no buffer");
 
-	if (tone->frequency <= 0) {
+	if (!gen->render.has_tone && cw_gen_sk_is_active_internal(gen)) {
+		/* Straight key is keying the generator. */
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		cw_gen_sk_render_buffer_internal(gen, 0, &now);
 		return 0;
 	}
+	/* Next key-down edge will come after a period of silence. */
+	gen->sk.has_prev_buffer = false;
+
+	int n_dequeued = 0;
+	int start = 0;
+
+	while (start < gen->buffer_n_samples) {
+
+		cw_tone_t * tone = &gen->render.tone;
+
+		if (!gen->render.has_tone) {
+			if (CW_SUCCESS != cw_tq_dequeue_internal(gen->tq, tone)) {
+				if (gen->render.dequeued_prev) {
+					/* Tone queue just went empty. No tone == no sound. */
+					if (gen->key) {
+						cw_key_tk_set_value_internal(gen->key, CW_KEY_STATE_OPEN);
+					}
+					gen->render.dequeued_prev = false;
+				}
+				cw_gen_drained_internal(gen);
+
+				memset(gen->buffer + start, 0, (gen->buffer_n_samples - start) * sizeof (cw_sample_t));
+				if (0 == start) {
+					gen->buffer_is_silent = true;
+				}
+				if (gen->encoder) {
+					cw_tone_t silence;
+					CW_TONE_INIT(&silence, 0, 0, CW_SLOPE_MODE_NO_SLOPES);
+					silence.n_samples = gen->buffer_n_samples - start;
+					cw_codec_encoder_add_tone_internal(gen->encoder, &silence);
+				}
+				break;
+			}
 
+			n_dequeued++;
+			gen->render.dequeued_prev = true;
+			gen->render.has_tone = true;
+			cw_gen_tone_calculate_samples_size_internal(gen, tone);
+			if (gen->encoder) {
+				cw_codec_encoder_add_tone_internal(gen->encoder, tone);
+			}
 
-	int amplitude = 0;
-
-	/* Every tone, regardless of slope mode (CW_SLOPE_MODE_*), has
-	   three components. It has rising slope + plateau + falling
-	   slope.
-
-	   There can be four variants of rising and falling slope
-	   length, just as there are four CW_SLOPE_MODE_* values.
-
-	   There can be also tones with zero-length plateau, and there
-	   can be also tones with zero-length slopes. */
+			if (gen->key) {
+				cw_key_tk_set_value_internal(gen->key, tone->frequency ? CW_KEY_STATE_CLOSED : CW_KEY_STATE_OPEN);
+				cw_key_ik_increment_timer_internal(gen->key, tone->len);
+			}
+		}
 
-	if (tone->sample_iterator < tone->rising_slope_n_samples) {
-		/* Beginning of tone, rising slope. */
-		int i = tone->sample_iterator;
-		amplitude = gen->tone_slope.amplitudes[i];
-		assert (amplitude >= 0);
+		start = cw_gen_render_tone_internal(gen, tone, start, tone->n_samples);
 
-	} else if (tone->sample_iterator >= tone->rising_slope_n_samples
-		   && tone->sample_iterator < tone->n_samples - tone->falling_slope_n_samples) {
+		if (tone->sample_iterator >= tone->n_samples) {
+			/* All samples of the tone have been rendered. */
+			gen->render.has_tone = false;
 
-		/* Middle of tone, plateau, constant amplitude. */
-		amplitude = gen->volume_abs;
-		assert (amplitude >= 0);
+			pthread_mutex_lock(&gen->tq->wait_mutex);
+			/* There may be many listeners, so use broadcast(). */
+			pthread_cond_broadcast(&gen->tq->wait_var);
+			pthread_mutex_unlock(&gen->tq->wait_mutex);
 
-	} else if (tone->sample_iterator >= tone->n_samples - tone->falling_slope_n_samples) {
-		/* Falling slope. */
-		int i = tone->n_samples - tone->sample_iterator - 1;
-		assert (i >= 0);
-		amplitude = gen->tone_slope.amplitudes[i];
-		assert (amplitude >= 0);
+			/* See comment in cw_gen_dequeue_and_generate_internal(). */
+			cw_key_ik_update_graph_state_internal(gen->key);
 
-	} else {
-		cw_assert (0, MSG_PREFIX "->sample_iterator out of bounds:\n"
-			   "tone->sample_iterator: %d\n"
-			   "tone->n_samples: %"PRId64"\n"
-			   "tone->rising_slope_n_samples: %d\n"
-			   "tone->falling_slope_n_samples: %d\n",
-			   tone->sample_iterator,
-			   tone->n_samples,
-			   tone->rising_slope_n_samples,
-			   tone->falling_slope_n_samples);
+			cw_gen_notify_internal(gen);
+		}
 	}
 
-	assert (amplitude >= 0);
-	return amplitude;
-#endif
+	gen->buffer_sub_start = 0;
+	gen->buffer_sub_stop = 0;
+
+	return n_dequeued;
 }
 
 
 
 
 /**
-   \brief Set parameters of tones generated by generator
+   \brief Publish an edge of straight key
 
-   Most of variables related to slope of tones is in tone data type,
-   but there are still some variables that are generator-specific, as
-   they are common for all tones.  This function sets two of these
-   variables.
-
-
-   A: If you pass to function conflicting values of \p slope_shape and
-   \p slope_len, the function will return CW_FAILURE. These
-   conflicting values are rectangular slope shape and larger than zero
-   slope length. You just can't have rectangular slopes that have
-   non-zero length.
-
-
-   B: If you pass to function '-1' as value of both \p slope_shape and
-   \p slope_len, the function won't change any of the related two
-   generator's parameters.
-
-
-   C1: If you pass to function '-1' as value of either \p slope_shape
-   or \p slope_len, the function will attempt to set only this
-   generator's parameter that is different than '-1'.
-
-   C2: However, if selected slope shape is rectangular, function will
-   set generator's slope length to zero, even if value of \p
-   slope_len is '-1'.
+   Function is called by key's code on key-down and key-up events of
+   straight key. The edge will be applied to generator's output by
+   generator's thread (or by code rendering buffers for the
+   generator), with sample accuracy, one buffer period after \p
+   timestamp.
 
+   Edge that doesn't change state of the key is ignored. The function
+   doesn't take any lock, except for waking up idle generator's
+   thread on key-down edge.
 
-   D: Notice that the function allows non-rectangular slope shape with
-   zero length of the slopes. The slopes will be non-rectangular, but
-   just unusually short.
+   \param gen - generator
+   \param is_closed - new state of the key
+   \param timestamp - time of the edge
+*/
+void cw_gen_sk_publish_edge_internal(cw_gen_t * gen, bool is_closed, const struct timeval * timestamp)
+{
+	const uint32_t n = __atomic_load_n(&gen->sk.n_edges, __ATOMIC_RELAXED);
+	if ((n % 2 == 1) == is_closed) {
+		return;
+	}
+	gen->sk.edges[n % CW_GEN_SK_EDGES_CAPACITY] = *timestamp;
+	/* Consumer reads the edge only after it sees the new count. */
+	__atomic_store_n(&gen->sk.n_edges, n + 1, __ATOMIC_RELEASE);
+
+	if (n % 2 == 0) {
+		/* Key-down edge. Generator's thread may be idle,
+		   waiting for kick from tone queue. */
+		pthread_mutex_lock(&gen->tq->dequeue_mutex);
+		pthread_cond_signal(&gen->tq->dequeue_var);
+		pthread_mutex_unlock(&gen->tq->dequeue_mutex);
+	}
 
+	return;
+}
 
-   The function should be called every time one of following
-   parameters change:
 
-   \li shape of slope,
-   \li length of slope,
-   \li generator's sample rate,
-   \li generator's volume.
 
-   There are four supported shapes of slopes:
-   \li linear (the only one supported by libcw until version 4.1.1),
-   \li raised cosine (supposedly the most desired shape),
-   \li sine,
-   \li rectangular.
 
-   Use CW_TONE_SLOPE_SHAPE_* symbolic names as values of \p slope_shape.
+/**
+   \brief Check if straight key is keying the generator
 
-   FIXME: first argument of this public function is gen, but no
-   function provides access to generator variable.
+   The function should be called only by consumer of straight key's
+   edges.
 
-   \param gen - generator for which to set tone slope parameters
-   \param slope_shape - shape of slope: linear, raised cosine, sine, rectangular
-   \param slope_usecs - duration of slope [microseconds]
+   \param gen - generator
 
-   \return CW_SUCCESS on success
-   \return CW_FAILURE on failure
+   \return true if there are unconsumed edges, or key is closed, or falling slope hasn't ended yet
+   \return false otherwise
 */
-int cw_generator_set_tone_slope(cw_gen_t * gen, int slope_shape, int slope_usecs)
+bool cw_gen_sk_is_active_internal(const cw_gen_t * gen)
 {
-	return cw_gen_set_tone_slope(gen, slope_shape, slope_usecs);
+	return gen->sk.is_closed
+		|| gen->sk.level > 0
+		|| __atomic_load_n(&gen->sk.n_edges, __ATOMIC_ACQUIRE) != gen->sk.n_consumed;
 }
 
 
 
 
-int cw_gen_set_tone_slope(cw_gen_t * gen, int slope_shape, int slope_len)
-{
-	assert (gen);
-
-	/* Handle conflicting values of arguments. */
-	if (slope_shape == CW_TONE_SLOPE_SHAPE_RECTANGULAR
-	    && slope_len > 0) {
+/**
+   \brief Render samples of straight key's tone
 
-		cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_GENERATOR, CW_DEBUG_ERROR,
-			      MSG_PREFIX "requested a rectangular slope shape, but also requested slope len > 0");
+   Render samples from \p start to \p stop (exclusive) of generator's
+   buffer, according to current state of straight key. Rising and
+   falling slopes are rendered as samples of tones with appropriate
+   slopes, so shape of slopes is the same as for enqueued tones. A
+   slope interrupted by next edge is continued from the same
+   amplitude in opposite direction.
 
-		return CW_FAILURE;
+   \param gen - generator
+   \param start - index of first sample to render
+   \param stop - index of sample after last sample to render
+*/
+void cw_gen_sk_render_samples_internal(cw_gen_t * gen, int start, int stop)
+{
+	const int n_amplitudes = gen->tone_slope.n_amplitudes;
+	if (gen->sk.level > n_amplitudes) {
+		/* Slopes have been shortened during a tone. */
+		gen->sk.level = n_amplitudes;
 	}
 
-	/* Assign new values from arguments. */
-	if (slope_shape != -1) {
-		gen->tone_slope.shape = slope_shape;
-	}
-	if (slope_len != -1) {
-		gen->tone_slope.len = slope_len;
-	}
+	while (start < stop) {
+		int n = stop - start;
+		cw_tone_t tone;
 
+		if (gen->sk.is_closed && gen->sk.level < n_amplitudes) {
+			/* Rising slope, from current level. */
+			n = n < n_amplitudes - gen->sk.level ? n : n_amplitudes - gen->sk.level;
+			CW_TONE_INIT(&tone, gen->frequency, 0, CW_SLOPE_MODE_RISING_SLOPE);
+			tone.n_samples = gen->sk.level + n;
+			tone.rising_slope_n_samples = n_amplitudes;
+			tone.sample_iterator = gen->sk.level;
+			gen->sk.level += n;
+
+		} else if (gen->sk.is_closed) {
+			/* Plateau. */
+			CW_TONE_INIT(&tone, gen->frequency, 0, CW_SLOPE_MODE_NO_SLOPES);
+			tone.n_samples = n;
+
+		} else if (gen->sk.level > 0) {
+			/* Falling slope, from current level. */
+			n = n < gen->sk.level ? n : gen->sk.level;
+			CW_TONE_INIT(&tone, gen->frequency, 0, CW_SLOPE_MODE_FALLING_SLOPE);
+			tone.n_samples = gen->sk.level;
+			tone.falling_slope_n_samples = gen->sk.level;
+			gen->sk.level -= n;
 
-	/* Override of slope length. */
-	if (slope_shape == CW_TONE_SLOPE_SHAPE_RECTANGULAR) {
-		gen->tone_slope.len = 0;
-	}
+		} else {
+			/* Silence. */
+			CW_TONE_INIT(&tone, 0, 0, CW_SLOPE_MODE_NO_SLOPES);
+			tone.n_samples = n;
+		}
 
+		if (gen->encoder) {
+			/* Slope split between buffers, or interrupted
+			   by an edge, is encoded as the part of the
+			   tone that is actually rendered. */
+			cw_codec_encoder_add_tone_part_internal(gen->encoder, &tone, n);
+		}
 
-	int slope_n_samples = ((gen->sample_rate / 100) * gen->tone_slope.len) / 10000;
-	cw_assert (slope_n_samples >= 0, MSG_PREFIX "negative slope_n_samples: %d", slope_n_samples);
+		gen->buffer_sub_start = start;
+		gen->buffer_sub_stop = start + n - 1;
+		cw_gen_calculate_sine_wave_internal(gen, &tone);
 
+		start += n;
+	}
 
-	/* Reallocate the table of slope amplitudes only when necessary.
+	return;
+}
 
-	   In practice the function will be called foremost when user
-	   changes volume of tone (and then the function may be
-	   called several times in a row if volume is changed in
-	   steps). In such situation the size of amplitudes table
-	   doesn't change. */
 
-	if (gen->tone_slope.n_amplitudes != slope_n_samples) {
 
-		 /* Remember that slope_n_samples may be zero. In that
-		    case realloc() would equal to free(). We don't
-		    want to have NULL ->amplitudes, so don't modify
-		    ->amplitudes for zero-length slopes.  Since with
-		    zero-length slopes we won't be referring to
-		    ->amplitudes[], it is ok that the table will not
-		    be up-to-date. */
 
-		if (slope_n_samples > 0) {
-			gen->tone_slope.amplitudes = realloc(gen->tone_slope.amplitudes, sizeof(float) * slope_n_samples);
-			if (!gen->tone_slope.amplitudes) {
-				cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_GENERATOR, CW_DEBUG_ERROR,
-					      MSG_PREFIX "failed to realloc() table of slope amplitudes");
-				return CW_FAILURE;
-			}
-		}
+/**
+   \brief Apply an edge of straight key to generator
 
-		gen->tone_slope.n_amplitudes = slope_n_samples;
+   \param gen - generator
+   \param edge - timestamp of the edge
+*/
+void cw_gen_sk_consume_edge_internal(cw_gen_t * gen, const struct timeval * edge)
+{
+	gen->sk.is_closed = !gen->sk.is_closed;
+	gen->sk.n_consumed++;
+
+	if (gen->key) {
+		/* Let receiver see the edge at the time when it
+		   happened. Timestamp of the edge is passed by value:
+		   key's timer belongs to thread of the key. */
+		cw_key_tk_set_value_at_internal(gen->key, edge, gen->sk.is_closed ? CW_KEY_STATE_CLOSED : CW_KEY_STATE_OPEN);
 	}
 
-	cw_gen_recalculate_slopes_internal(gen);
-
-	return CW_SUCCESS;
+	return;
 }
 
 
 
 
 /**
-   \brief Recalculate amplitudes of PCM samples that form tone's slopes
+   \brief Render one buffer of straight key's tone
 
-   \reviewed on 2017-01-24
+   Fill generator's buffer, starting at sample \p start, with samples
+   of tone keyed by straight key.
 
-   TODO: consider writing unit test code for the function.
+   An edge is placed in the buffer at the same distance from the
+   beginning of the buffer as the distance between time of rendering
+   of previous buffer and timestamp of the edge. In other words
+   every edge is delayed by one buffer period, so lengths of marks
+   and spaces are preserved with sample accuracy. An edge that
+   happened too late to be placed in this buffer is left for next
+   buffer.
 
    \param gen - generator
+   \param start - index of first free sample in generator's buffer
+   \param now - time of rendering of the buffer
 */
-void cw_gen_recalculate_slopes_internal(cw_gen_t *gen)
+void cw_gen_sk_render_buffer_internal(cw_gen_t * gen, int start, const struct timeval * now)
 {
-	/* The values in amplitudes[] change from zero to max (at
-	   least for any sane slope shape), so naturally they can be
-	   used in forming rising slope. However they can be used in
-	   forming falling slope as well - just iterate the table from
-	   end to beginning. */
-	for (int i = 0; i < gen->tone_slope.n_amplitudes; i++) {
+	const int n_samples = gen->buffer_n_samples;
+
+	if (!gen->sk.has_prev_buffer) {
+		/* Generator is coming from silence or from tones of
+		   tone queue. Pretend that previous buffer has been
+		   rendered one buffer period ago. */
+		const int64_t buffer_len = (int64_t) n_samples * CW_USECS_PER_SEC / gen->sample_rate;
+		const int64_t usecs = (int64_t) now->tv_sec * CW_USECS_PER_SEC + now->tv_usec - buffer_len;
+		gen->sk.prev_buffer.tv_sec = usecs / CW_USECS_PER_SEC;
+		gen->sk.prev_buffer.tv_usec = usecs % CW_USECS_PER_SEC;
+		gen->sk.has_prev_buffer = true;
+	}
 
-		if (gen->tone_slope.shape == CW_TONE_SLOPE_SHAPE_LINEAR) {
-			gen->tone_slope.amplitudes[i] = 1.0 * gen->volume_abs * i / gen->tone_slope.n_amplitudes;
+	const uint32_t n_edges = __atomic_load_n(&gen->sk.n_edges, __ATOMIC_ACQUIRE);
+	if (n_edges - gen->sk.n_consumed > CW_GEN_SK_EDGES_CAPACITY) {
+		/* Consumer has fallen so far behind that some edges
+		   have been overwritten. Skip them, but keep parity
+		   of count of consumed edges. */
+		uint32_t n_skipped = n_edges - gen->sk.n_consumed - CW_GEN_SK_EDGES_CAPACITY;
+		n_skipped += n_skipped % 2;
+		gen->sk.n_consumed += n_skipped;
 
-		} else if (gen->tone_slope.shape == CW_TONE_SLOPE_SHAPE_SINE) {
-			float radian = i * (M_PI / 2.0) / gen->tone_slope.n_amplitudes;
-			gen->tone_slope.amplitudes[i] = sin(radian) * gen->volume_abs;
+		cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_GENERATOR, CW_DEBUG_WARNING,
+			      MSG_PREFIX "sk render buffer: skipped %"PRIu32" edges", n_skipped);
+	}
 
-		} else if (gen->tone_slope.shape == CW_TONE_SLOPE_SHAPE_RAISED_COSINE) {
-			float radian = i * M_PI / gen->tone_slope.n_amplitudes;
-			gen->tone_slope.amplitudes[i] = (1 - ((1 + cos(radian)) / 2)) * gen->volume_abs;
+	while (start < n_samples) {
+		int stop = n_samples;
+		bool has_edge = false;
+		struct timeval edge;
+
+		if (gen->sk.n_consumed != n_edges) {
+			/* Copy of the edge: slot of the ring may be
+			   overwritten by thread of the key. */
+			edge = gen->sk.edges[gen->sk.n_consumed % CW_GEN_SK_EDGES_CAPACITY];
+			const int64_t delta = (int64_t) (edge.tv_sec - gen->sk.prev_buffer.tv_sec) * CW_USECS_PER_SEC
+				+ edge.tv_usec - gen->sk.prev_buffer.tv_usec;
+			const int64_t offset = delta * gen->sample_rate / CW_USECS_PER_SEC;
+			if (offset < n_samples) {
+				/* Otherwise edge belongs to one of next
+				   buffers. */
+				has_edge = true;
+				stop = offset > start ? (int) offset : start;
+			}
+		}
 
-		} else if (gen->tone_slope.shape == CW_TONE_SLOPE_SHAPE_RECTANGULAR) {
-			/* CW_TONE_SLOPE_SHAPE_RECTANGULAR is covered
-			   before entering this "for" loop. */
-			cw_assert (0, MSG_PREFIX "we shouldn't be here, calculating rectangular slopes");
+		cw_gen_sk_render_samples_internal(gen, start, stop);
+		start = stop;
 
-		} else {
-			cw_assert (0, MSG_PREFIX "unsupported slope shape %d", gen->tone_slope.shape);
+		if (has_edge) {
+			cw_gen_sk_consume_edge_internal(gen, &edge);
 		}
 	}
 
+	gen->sk.prev_buffer = *now;
+
+	gen->buffer_sub_start = 0;
+	gen->buffer_sub_stop = 0;
+
 	return;
 }
 
@@ -1477,286 +1839,2164 @@ void cw_gen_recalculate_slopes_internal(cw_gen_t *gen)
 
 
 /**
-   \brief Write tone to soundcard
+   \brief Write buffers of straight key's tone to audio sink
 
-   \param gen
-   \param tone - tone dequeued from queue (if dequeueing was successful); must always be non-NULL
-   \param is_empty_tone - true if dequeueing was not successful (if no tone was dequeued), false otherwise
+   Function is called by generator's thread when straight key starts
+   keying the generator. It renders and writes buffers as long as the
+   key is active (see cw_gen_sk_is_active_internal()). The tone
+   queue isn't touched.
 
-   \return 0
+   \param gen - generator
 */
-int cw_gen_write_to_soundcard_internal(cw_gen_t *gen, cw_tone_t *tone, bool is_empty_tone)
+void cw_gen_sk_write_internal(cw_gen_t * gen)
 {
-	cw_assert (tone, MSG_PREFIX "'tone' argument should always be non-NULL, even when dequeueing failed");
-
-	if (is_empty_tone) {
-		/* No valid tone dequeued from tone queue. 'tone'
-		   argument doesn't represent a valid tone. We need
-		   samples to complete filling buffer, but they have
-		   to be empty samples. */
-		cw_gen_empty_tone_calculate_samples_size_internal(gen, tone);
-	} else {
-		/* Valid tone dequeued from tone queue. Use it to
-		   calculate samples in buffer. */
-		cw_gen_tone_calculate_samples_size_internal(gen, tone);
-	}
-	/* After the calculations above, we can use 'tone' to generate
-	   samples in the same way, regardless of state of tone queue
-	   (regardless of what the tone queue returned in last call).
+	while (gen->do_dequeue_and_generate && cw_gen_sk_is_active_internal(gen)) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
 
-	   Simply look at tone's frequency and tone's samples count. */
+		/* Start at sub start: the buffer may have some
+		   samples of last tone dequeued from tone queue. */
+		cw_gen_sk_render_buffer_internal(gen, gen->buffer_sub_start, &now);
 
+		cw_gen_write_internal(gen);
+#if CW_DEV_RAW_SINK
+		cw_dev_debug_raw_sink_write_internal(gen);
+#endif
+	}
 
-	/* Total number of samples to write in a loop below. */
-	int64_t samples_to_write = tone->n_samples;
+	/* Next key-down edge will come after a period of silence. */
+	gen->sk.has_prev_buffer = false;
 
-#if 0   /* Debug code. */
-	int n_loops = 0;
-	const double n_loops_expected = floor(1.0 * samples_to_write / gen->buffer_n_samples); /* In reality number of loops executed is sometimes n_loops_expected, but mostly it's n_loops_expected+1. */
-	fprintf(stderr, MSG_PREFIX "entering loop (~%.1g), tone->frequency = %d, buffer->n_samples = %d, samples_to_write = %d\n",
-		n_loops_expected, tone->frequency, gen->buffer_n_samples, samples_to_write);
+	return;
+}
 
-#endif
 
-	// cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_GENERATOR, CW_DEBUG_DEBUG, MSG_PREFIX "%lld samples, %d us, %d Hz", tone->n_samples, tone->len, gen->frequency);
-	while (samples_to_write > 0) {
 
-		int64_t free_space = gen->buffer_n_samples - gen->buffer_sub_start;
-		if (samples_to_write > free_space) {
-			/* There will be some tone samples left for
-			   next iteration of this loop.  But buffer in
-			   this iteration will be ready to be pushed
-			   to audio sink. */
-			gen->buffer_sub_stop = gen->buffer_n_samples - 1;
-		} else if (samples_to_write == free_space) {
-			/* How nice, end of tone samples aligns with
-			   end of buffer (last sample of tone will be
-			   placed in last cell of buffer).
 
-			   But the result is the same - a full buffer
-			   ready to be pushed to audio sink. */
-			gen->buffer_sub_stop = gen->buffer_n_samples - 1;
-		} else {
-			/* There will be too few samples to fill a
-			   buffer. We can't send an under-filled buffer to
-			   audio sink. We will have to get more
-			   samples to fill the buffer completely. */
-			gen->buffer_sub_stop = gen->buffer_sub_start + samples_to_write - 1;
-		}
+/**
+   \brief Calculate a fragment of sine wave
 
-		/* How many samples of audio buffer's subarea will be
-		   calculated in a given cycle of "calculate sine
-		   wave" code, i.e. in current iteration of the 'while' loop? */
-		const int buffer_sub_n_samples = gen->buffer_sub_stop - gen->buffer_sub_start + 1;
+   Calculate a fragment of sine wave, as many samples as can be fitted
+   in generator buffer's subarea.
 
+   The function calculates values of (gen->buffer_sub_stop - gen->buffer_sub_start + 1)
+   samples and puts them into gen->buffer[], starting from
+   gen->buffer[gen->buffer_sub_start].
 
-#if 0           /* Debug code. */
+   The function takes into account all state variables from gen,
+   so initial phase of new fragment of sine wave in the buffer matches
+   ending phase of a sine wave generated in previous call.
 
-		fprintf(stderr, MSG_PREFIX "       loop #%d, buffer_sub_n_samples = %d\n", ++n_loops, buffer_sub_n_samples);
-		cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_GENERATOR, CW_DEBUG_DEBUG,
-			      MSG_PREFIX "sub start: %d, sub stop: %d, sub size: %d / %d", gen->buffer_sub_start, gen->buffer_sub_stop, buffer_sub_n_samples, samples_to_write);
-#endif
+   Samples of silent tones (tones with zero frequency) are just
+   cleared. The function also keeps gen->buffer_is_silent up to date.
 
-		const int calculated = cw_gen_calculate_sine_wave_internal(gen, tone);
-		cw_assert (calculated == buffer_sub_n_samples, MSG_PREFIX "calculated wrong number of samples: %d != %d", calculated, buffer_sub_n_samples);
+   \param gen - generator that generates sine wave
+   \param tone - generated tone
 
-		if (gen->buffer_sub_stop == gen->buffer_n_samples - 1) {
+   \return number of calculated samples
+*/
+int cw_gen_calculate_sine_wave_internal(cw_gen_t *gen, cw_tone_t *tone)
+{
+	assert (gen->buffer_sub_stop <= gen->buffer_n_samples);
 
-			/* We have a buffer full of samples. The
-			   buffer is ready to be pushed to audio
-			   sink. */
-			gen->write(gen);
-#if CW_DEV_RAW_SINK
-			cw_dev_debug_raw_sink_write_internal(gen);
-#endif
-			gen->buffer_sub_start = 0;
-			gen->buffer_sub_stop = 0;
-		} else {
-			/* #needmoresamples
-			   There is still some space left in the
-			   buffer, go fetch new tone from tone
-			   queue. */
+	if (0 == gen->buffer_sub_start) {
+		gen->buffer_is_silent = true;
+	}
 
-			gen->buffer_sub_start = gen->buffer_sub_stop + 1;
+	if (tone->frequency <= 0) {
+		/* Silence. Phase of sine wave doesn't advance for zero
+		   frequency, so there is nothing to calculate. */
+		const int n = gen->buffer_sub_stop - gen->buffer_sub_start + 1;
+		memset(gen->buffer + gen->buffer_sub_start, 0, n * sizeof (cw_sample_t));
+		tone->sample_iterator += n;
+		return n;
+	}
+	gen->buffer_is_silent = false;
 
-			cw_assert (gen->buffer_sub_start <= gen->buffer_n_samples - 1, MSG_PREFIX "sub start out of range: sub start = %d, buffer n samples = %d", gen->buffer_sub_start, gen->buffer_n_samples);
-		}
+	if (gen->synthesis == CW_SYNTHESIS_FIXED_POINT) {
+		return cw_gen_calculate_sine_wave_fixed_internal(gen, tone);
+	}
 
-		samples_to_write -= buffer_sub_n_samples;
+	/* We need two separate iterators to correctly generate sine wave:
+	    -- i -- for iterating through output buffer (generator
+	            buffer's subarea), it can travel between buffer
+	            cells delimited by start and stop (inclusive);
+	    -- t -- for calculating phase of a sine wave; 't' always has to
+	            start from zero for every calculated subarea (i.e. for
+		    every call of this function);
+
+	  Initial/starting phase of generated fragment is always retained
+	  in gen->phase_offset, it is the only "memory" of previously
+	  calculated fragment of sine wave (to be precise: it stores phase
+	  of last sample in previously calculated fragment).
+	  Therefore iterator used to calculate phase of sine wave can't have
+	  the memory too. Therefore it has to always start from zero for
+	  every new fragment of sine wave. Therefore a separate t. */
+
+	double phase = 0.0;
+	int t = 0;
+
+	for (int i = gen->buffer_sub_start; i <= gen->buffer_sub_stop; i++) {
+		phase = (2.0 * M_PI
+				* (double) tone->frequency * (double) t
+				/ (double) gen->sample_rate)
+			+ gen->phase_offset;
+		int amplitude = cw_gen_calculate_amplitude_internal(gen, tone);
+
+		gen->buffer[i] = amplitude * sin(phase);
+
+		tone->sample_iterator++;
+
+		t++;
+	}
+
+	phase = (2.0 * M_PI
+		 * (double) tone->frequency * (double) t
+		 / (double) gen->sample_rate)
+		+ gen->phase_offset;
+
+	/* "phase" is now phase of the first sample in next fragment to be
+	   calculated.
+	   However, for long fragments this can be a large value, well
+	   beyond <0; 2*Pi) range.
+	   The value of phase may further accumulate in different
+	   calculations, and at some point it may overflow. This would
+	   result in an audible click.
+
+	   Let's bring back the phase from beyond <0; 2*Pi) range into the
+	   <0; 2*Pi) range, in other words lets "normalize" it. Or, in yet
+	   other words, lets apply modulo operation to the phase.
+
+	   The normalized phase will be used as a phase offset for next
+	   fragment (during next function call). It will be added phase of
+	   every sample calculated in next function call. */
+
+	int n_periods = floor(phase / (2.0 * M_PI));
+	gen->phase_offset = phase - n_periods * 2.0 * M_PI;
+
+	return t;
+}
+
+
+
+
+/**
+   \brief Calculate value of a single sample of sine wave
+
+   This function calculates an amplitude (a value) of a single sample
+   in sine wave PCM data.
+
+   Actually "calculation" is a bit too big word. The function just
+   makes a decision which of precalculated values to return. There are
+   no complicated arithmetical calculations being made each time the
+   function is called, so the execution time should be pretty small.
+
+   The precalcuated values depend on some factors, so the values
+   should be re-calculated each time these factors change. See
+   cw_gen_set_tone_slope() for list of these factors.
+
+   A generator stores some of information needed to get an amplitude
+   of every sample in a sine wave - this is why we have \p gen.  If
+   tone's slopes are non-rectangular, the length of slopes is defined
+   in generator. If a tone is non-silent, the volume is also defined
+   in generator.
+
+   However, decision tree for getting the amplitude also depends on
+   some parameters that are strictly bound to tone, such as what is
+   the shape of slopes for a given tone - this is why we have \p tone.
+   The \p also stores iterator of samples - this is how we know for
+   which sample to calculate the amplitude.
+
+   \reviewed on 2017-01-24
+
+   \param gen - generator used to generate a sine wave
+   \param tone - tone being generated
+
+   \return value of a sample of sine wave, a non-negative number
+*/
+int cw_gen_calculate_amplitude_internal(cw_gen_t *gen, const cw_tone_t *tone)
+{
+#if 0   /* Blunt algorithm for calculating amplitude. For debug purposes only. */
+
+	return tone->frequency ? gen->volume_abs : 0;
+
+#else
+
+	if (tone->frequency <= 0) {
+		return 0;
+	}
+
+	const int i = cw_gen_slope_index_internal(tone);
+	const int amplitude = i < 0 ? gen->volume_abs : (int) gen->tone_slope.amplitudes[i];
+
+	assert (amplitude >= 0);
+	return amplitude;
+#endif
+}
+
+
+
+
+/**
+   \brief Get index of sample of tone in table of slope amplitudes
+
+   Every tone, regardless of slope mode (CW_SLOPE_MODE_*), has three
+   components. It has rising slope + plateau + falling slope.
+
+   There can be four variants of rising and falling slope length,
+   just as there are four CW_SLOPE_MODE_* values.
+
+   There can be also tones with zero-length plateau, and there can be
+   also tones with zero-length slopes.
+
+   \param tone - tone being generated
+
+   \return index in gen->tone_slope.amplitudes[] for sample in a slope
+   \return -1 for sample in plateau
+*/
+int cw_gen_slope_index_internal(const cw_tone_t * tone)
+{
+	if (tone->sample_iterator < tone->rising_slope_n_samples) {
+		/* Beginning of tone, rising slope. */
+		return tone->sample_iterator;
+
+	} else if (tone->sample_iterator >= tone->rising_slope_n_samples
+		   && tone->sample_iterator < tone->n_samples - tone->falling_slope_n_samples) {
+
+		/* Middle of tone, plateau, constant amplitude. */
+		return -1;
+
+	} else if (tone->sample_iterator >= tone->n_samples - tone->falling_slope_n_samples) {
+		/* Falling slope. */
+		const int i = tone->n_samples - tone->sample_iterator - 1;
+		assert (i >= 0);
+		return i;
+
+	} else {
+		cw_assert (0, MSG_PREFIX "->sample_iterator out of bounds:\n"
+			   "tone->sample_iterator: %d\n"
+			   "tone->n_samples: %"PRId64"\n"
+			   "tone->rising_slope_n_samples: %d\n"
+			   "tone->falling_slope_n_samples: %d\n",
+			   tone->sample_iterator,
+			   tone->n_samples,
+			   tone->rising_slope_n_samples,
+			   tone->falling_slope_n_samples);
+		return -1;
+	}
+}
+
+
+
+
+/**
+   \brief Calculate a fragment of sine wave with integer arithmetic
+
+   Fixed-point counterpart of cw_gen_calculate_sine_wave_internal().
+   Phase is kept in gen->phase_fixed, where 2^32 is a full period.
+   The increment of phase per sample is rarely an integer, so
+   remainder of the increment is accumulated in
+   gen->phase_fixed_remainder, and phase doesn't drift from phase of
+   floating-point synthesis.
+
+   \param gen - generator that generates sine wave
+   \param tone - generated tone
+
+   \return number of calculated samples
+*/
+int cw_gen_calculate_sine_wave_fixed_internal(cw_gen_t *gen, cw_tone_t *tone)
+{
+	cw_fixed_step_t step;
+	cw_fixed_step_internal(&step, tone->frequency > 0 ? tone->frequency : 0, gen->sample_rate);
+
+	uint32_t phase = gen->phase_fixed;
+	uint32_t remainder = gen->phase_fixed_remainder;
+	int t = 0;
+
+	for (int i = gen->buffer_sub_start; i <= gen->buffer_sub_stop; i++) {
+		const int amplitude = cw_gen_calculate_amplitude_fixed_internal(gen, tone);
+		gen->buffer[i] = cw_fixed_mul_q15_internal(amplitude, cw_fixed_sin_internal(phase));
+
+		phase += step.increment;
+		remainder += step.remainder;
+		if (remainder >= step.sample_rate) {
+			remainder -= step.sample_rate;
+			phase++;
+		}
+
+		tone->sample_iterator++;
+		t++;
+	}
+
+	/* Unsigned phase wraps around at full period, there is
+	   nothing to normalize. */
+	gen->phase_fixed = phase;
+	gen->phase_fixed_remainder = remainder;
+
+	return t;
+}
+
+
+
+
+/**
+   \brief Calculate value of a single sample of sine wave with integer arithmetic
+
+   Fixed-point counterpart of cw_gen_calculate_amplitude_internal().
+
+   \param gen - generator used to generate a sine wave
+   \param tone - tone being generated
+
+   \return value of a sample of sine wave, a non-negative number
+*/
+int cw_gen_calculate_amplitude_fixed_internal(cw_gen_t *gen, const cw_tone_t *tone)
+{
+	if (tone->frequency <= 0) {
+		return 0;
+	}
+
+	const int i = cw_gen_slope_index_internal(tone);
+	return i < 0 ? gen->volume_abs : gen->tone_slope.amplitudes_fixed[i];
+}
+
+
+
+
+/**
+   \brief Get phase of sine wave of generator
+
+   \param gen - generator
+
+   \return phase of first sample of next fragment of sine wave [radians]
+*/
+double cw_gen_get_phase_internal(cw_gen_t const * gen)
+{
+	if (gen->synthesis == CW_SYNTHESIS_FIXED_POINT) {
+		return cw_fixed_phase_to_radians_internal(gen->phase_fixed);
+	} else {
+		return gen->phase_offset;
+	}
+}
+
+
+
+
+/**
+   \brief Set phase of sine wave of generator
+
+   \param gen - generator
+   \param phase - phase of first sample of next fragment of sine wave [radians]
+*/
+void cw_gen_set_phase_internal(cw_gen_t * gen, double phase)
+{
+	gen->phase_offset = phase;
+	gen->phase_fixed = cw_fixed_phase_from_radians_internal(phase);
+	gen->phase_fixed_remainder = 0;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Select synthesis of samples
+
+   By default generator synthesizes samples of sine wave with
+   floating point arithmetic (or with fixed-point arithmetic, if
+   libcw was configured with --enable-fixed-point).
+
+   CW_SYNTHESIS_FIXED_POINT synthesis uses only integer arithmetic
+   for every sample, which is much faster on processors without FPU.
+   Its samples differ from samples of CW_SYNTHESIS_FLOATING_POINT
+   synthesis by at most CW_SYNTHESIS_MAX_ERROR.
+
+   Synthesis can't be changed while generator is running.
+
+   \errno EINVAL - invalid \p synthesis
+   \errno EBUSY - generator is running
+
+   \param gen - generator
+   \param synthesis - synthesis, CW_SYNTHESIS_*
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_gen_set_synthesis(cw_gen_t * gen, int synthesis)
+{
+	if (synthesis != CW_SYNTHESIS_FLOATING_POINT
+	    && synthesis != CW_SYNTHESIS_FIXED_POINT) {
+
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	if (gen->do_dequeue_and_generate) {
+		errno = EBUSY;
+		return CW_FAILURE;
+	}
+
+	if (synthesis != gen->synthesis) {
+		/* Continue sine wave from the same phase. */
+		const double phase = cw_gen_get_phase_internal(gen);
+		gen->synthesis = synthesis;
+		cw_gen_set_phase_internal(gen, phase);
+
+		/* Only the table of current synthesis is up to date. */
+		cw_gen_recalculate_slopes_internal(gen);
+	}
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \param gen - generator
+
+   \return synthesis of samples, CW_SYNTHESIS_*
+*/
+int cw_gen_get_synthesis(cw_gen_t const * gen)
+{
+	return gen->synthesis;
+}
+
+
+
+
+/**
+   \brief Set sample rate at which generator calculates samples
+
+   By default generator calculates samples at sample rate of its
+   audio sink. Tones of Morse code are narrow-band, so when the audio
+   sink has been opened with high sample rate (e.g. 96 or 192 kHz),
+   the generator can calculate samples at lower rate, and convert
+   them to sample rate of audio sink with polyphase resampler (see
+   libcw_resampler.c). Calculating the samples and resampling them is
+   cheaper than calculating them at high rate.
+
+   Pass zero as \p sample_rate to calculate samples at sample rate of
+   audio sink again.
+
+   Function can't be called while generator is running.
+
+   \errno EINVAL - \p sample_rate is lower than CW_SYNTHESIS_RATE_MIN
+   or higher than sample rate of audio sink, or generator doesn't
+   write samples to audio sink
+   \errno EBUSY - generator is running
+
+   \param gen - generator
+   \param sample_rate - sample rate of synthesis
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_gen_set_synthesis_rate(cw_gen_t * gen, int sample_rate)
+{
+	if (gen->do_dequeue_and_generate) {
+		errno = EBUSY;
+		return CW_FAILURE;
+	}
+
+	if (!gen->buffer || !gen->write) {
+		/* Null and console audio sinks, and generators
+		   rendering samples for external code. */
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	const int sink_sample_rate = cw_gen_get_sink_sample_rate_internal(gen);
+	if (0 == sample_rate) {
+		sample_rate = sink_sample_rate;
+	}
+	if (sample_rate < CW_SYNTHESIS_RATE_MIN || sample_rate > sink_sample_rate) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	if (sample_rate == gen->sample_rate) {
+		return CW_SUCCESS;
+	}
+
+	cw_resampler_t * resampler = (cw_resampler_t *) NULL;
+	cw_sample_t * buffer = NULL;
+	int buffer_n_samples = 0;
+	if (sample_rate != sink_sample_rate) {
+		resampler = cw_resampler_new(sample_rate, sink_sample_rate);
+		if (!resampler) {
+			return CW_FAILURE;
+		}
+
+		/* One buffer of synthesis gives (about) one buffer of
+		   audio sink. */
+		const int sink_n_samples = gen->sink.resampler ? gen->sink.buffer_n_samples : gen->buffer_n_samples;
+		buffer_n_samples = (int) (((int64_t) sink_n_samples * sample_rate + sink_sample_rate - 1) / sink_sample_rate);
+		buffer = (cw_sample_t *) malloc(buffer_n_samples * sizeof (cw_sample_t));
+		if (!buffer) {
+			cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+				      MSG_PREFIX "set synthesis rate: malloc()");
+			cw_resampler_delete(&resampler);
+			return CW_FAILURE;
+		}
+	}
+
+	if (gen->sink.resampler) {
+		/* Go back to buffer and sample rate of audio sink. */
+		cw_resampler_delete(&gen->sink.resampler);
+		free(gen->buffer);
+		gen->buffer = gen->sink.buffer;
+		gen->buffer_n_samples = gen->sink.buffer_n_samples;
+		gen->sample_rate = gen->sink.sample_rate;
+		gen->sink.buffer = NULL;
+	}
+
+	if (resampler) {
+		gen->sink.resampler = resampler;
+		gen->sink.buffer = gen->buffer;
+		gen->sink.buffer_n_samples = gen->buffer_n_samples;
+		gen->sink.buffer_fill = 0;
+		gen->sink.sample_rate = gen->sample_rate;
+
+		gen->buffer = buffer;
+		gen->buffer_n_samples = buffer_n_samples;
+		gen->sample_rate = sample_rate;
+	}
+
+	gen->buffer_sub_start = 0;
+	gen->buffer_sub_stop = 0;
+
+	/* Lengths of slopes are counted in samples. */
+	if (CW_SUCCESS != cw_gen_set_tone_slope(gen, -1, -1)) {
+		return CW_FAILURE;
+	}
+
+	cw_debug_msg (&cw_debug_object, CW_DEBUG_GENERATOR, CW_DEBUG_INFO,
+		      MSG_PREFIX "synthesis at %d Hz, audio sink at %d Hz", gen->sample_rate, sink_sample_rate);
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \param gen - generator
+
+   \return sample rate at which generator calculates samples
+*/
+int cw_gen_get_synthesis_rate(cw_gen_t const * gen)
+{
+	return gen->sample_rate;
+}
+
+
+
+
+/**
+   \brief Get buffer that should be written to audio sink
+
+   Audio systems write this buffer, and not generator's buffer,
+   because the two are different when generator resamples its
+   samples.
+
+   \param gen - generator
+   \param n_samples - size of the buffer (output)
+
+   \return buffer of audio sink
+*/
+cw_sample_t * cw_gen_get_sink_buffer_internal(cw_gen_t * gen, int * n_samples)
+{
+	if (gen->sink.resampler) {
+		*n_samples = gen->sink.buffer_n_samples;
+		return gen->sink.buffer;
+	} else {
+		*n_samples = gen->buffer_n_samples;
+		return gen->buffer;
+	}
+}
+
+
+
+
+/**
+   \param gen - generator
+
+   \return sample rate of audio sink
+*/
+int cw_gen_get_sink_sample_rate_internal(cw_gen_t const * gen)
+{
+	return gen->sink.resampler ? gen->sink.sample_rate : gen->sample_rate;
+}
+
+
+
+
+/**
+   \brief Write full buffer of generator to audio sink
+
+   Samples calculated at sample rate of synthesis are resampled, and
+   are written to audio sink in full buffers of audio sink, so one
+   call may write zero, one or more buffers.
+
+   \param gen - generator
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE if writing of a buffer has failed
+*/
+int cw_gen_write_internal(cw_gen_t * gen)
+{
+	if (!gen->sink.resampler) {
+		return gen->write(gen);
+	}
+
+	int rv = CW_SUCCESS;
+	const cw_sample_t * in = gen->buffer;
+	int n_in = gen->buffer_n_samples;
+
+	while (n_in > 0) {
+		int n_taken = n_in;
+		gen->sink.buffer_fill += cw_resampler_process(gen->sink.resampler, in, &n_taken,
+							       gen->sink.buffer + gen->sink.buffer_fill,
+							       gen->sink.buffer_n_samples - gen->sink.buffer_fill);
+		in += n_taken;
+		n_in -= n_taken;
+
+		if (gen->sink.buffer_fill == gen->sink.buffer_n_samples) {
+			if (CW_SUCCESS != gen->write(gen)) {
+				rv = CW_FAILURE;
+			}
+			gen->sink.buffer_fill = 0;
+		}
+	}
+
+	return rv;
+}
+
+
+
+
+/**
+   \brief Set parameters of tones generated by generator
+
+   Most of variables related to slope of tones is in tone data type,
+   but there are still some variables that are generator-specific, as
+   they are common for all tones.  This function sets two of these
+   variables.
+
+
+   A: If you pass to function conflicting values of \p slope_shape and
+   \p slope_len, the function will return CW_FAILURE. These
+   conflicting values are rectangular slope shape and larger than zero
+   slope length. You just can't have rectangular slopes that have
+   non-zero length.
+
+
+   B: If you pass to function '-1' as value of both \p slope_shape and
+   \p slope_len, the function won't change any of the related two
+   generator's parameters.
+
+
+   C1: If you pass to function '-1' as value of either \p slope_shape
+   or \p slope_len, the function will attempt to set only this
+   generator's parameter that is different than '-1'.
+
+   C2: However, if selected slope shape is rectangular, function will
+   set generator's slope length to zero, even if value of \p
+   slope_len is '-1'.
+
+
+   D: Notice that the function allows non-rectangular slope shape with
+   zero length of the slopes. The slopes will be non-rectangular, but
+   just unusually short.
+
+
+   The function should be called every time one of following
+   parameters change:
+
+   \li shape of slope,
+   \li length of slope,
+   \li generator's sample rate,
+   \li generator's volume.
+
+   There are four supported shapes of slopes:
+   \li linear (the only one supported by libcw until version 4.1.1),
+   \li raised cosine (supposedly the most desired shape),
+   \li sine,
+   \li rectangular.
+
+   Use CW_TONE_SLOPE_SHAPE_* symbolic names as values of \p slope_shape.
+
+   FIXME: first argument of this public function is gen, but no
+   function provides access to generator variable.
+
+   \param gen - generator for which to set tone slope parameters
+   \param slope_shape - shape of slope: linear, raised cosine, sine, rectangular
+   \param slope_usecs - duration of slope [microseconds]
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_generator_set_tone_slope(cw_gen_t * gen, int slope_shape, int slope_usecs)
+{
+	return cw_gen_set_tone_slope(gen, slope_shape, slope_usecs);
+}
+
+
+
+
+int cw_gen_set_tone_slope(cw_gen_t * gen, int slope_shape, int slope_len)
+{
+	assert (gen);
+
+	/* Handle conflicting values of arguments. */
+	if (slope_shape == CW_TONE_SLOPE_SHAPE_RECTANGULAR
+	    && slope_len > 0) {
+
+		cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_GENERATOR, CW_DEBUG_ERROR,
+			      MSG_PREFIX "requested a rectangular slope shape, but also requested slope len > 0");
+
+		return CW_FAILURE;
+	}
+
+	/* New values from arguments. They are assigned to generator
+	   only when the table of amplitudes has been reallocated, so
+	   that generator is left unchanged on failure. */
+	int new_shape = gen->tone_slope.shape;
+	int new_len = gen->tone_slope.len;
+	if (slope_shape != -1) {
+		new_shape = slope_shape;
+	}
+	if (slope_len != -1) {
+		new_len = slope_len;
+	}
+
+
+	/* Override of slope length. */
+	if (slope_shape == CW_TONE_SLOPE_SHAPE_RECTANGULAR) {
+		new_len = 0;
+	}
+
+
+	int slope_n_samples = cw_gen_slope_n_samples_internal(gen->sample_rate, new_len);
+	cw_assert (slope_n_samples >= 0, MSG_PREFIX "negative slope_n_samples: %d", slope_n_samples);
+
+
+	/* Reallocate the table of slope amplitudes only when necessary.
+
+	   In practice the function will be called foremost when user
+	   changes volume of tone (and then the function may be
+	   called several times in a row if volume is changed in
+	   steps). In such situation the size of amplitudes table
+	   doesn't change. */
+
+	if (gen->tone_slope.n_amplitudes != slope_n_samples) {
+
+		 /* Remember that slope_n_samples may be zero. In that
+		    case realloc() would equal to free(). We don't
+		    want to have NULL ->amplitudes, so don't modify
+		    ->amplitudes for zero-length slopes.  Since with
+		    zero-length slopes we won't be referring to
+		    ->amplitudes[], it is ok that the table will not
+		    be up-to-date. */
+
+		if (slope_n_samples > 0) {
+			float * amplitudes = realloc(gen->tone_slope.amplitudes, sizeof(float) * slope_n_samples);
+			if (!amplitudes) {
+				cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_GENERATOR, CW_DEBUG_ERROR,
+					      MSG_PREFIX "failed to realloc() table of slope amplitudes");
+				return CW_FAILURE;
+			}
+			gen->tone_slope.amplitudes = amplitudes;
+
+			int16_t * amplitudes_fixed = realloc(gen->tone_slope.amplitudes_fixed, sizeof (int16_t) * slope_n_samples);
+			if (!amplitudes_fixed) {
+				cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_GENERATOR, CW_DEBUG_ERROR,
+					      MSG_PREFIX "failed to realloc() table of slope amplitudes");
+				return CW_FAILURE;
+			}
+			gen->tone_slope.amplitudes_fixed = amplitudes_fixed;
+		}
+
+		gen->tone_slope.n_amplitudes = slope_n_samples;
+	}
+
+	gen->tone_slope.shape = new_shape;
+	gen->tone_slope.len = new_len;
+
+	cw_gen_recalculate_slopes_internal(gen);
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Recalculate amplitudes of PCM samples that form tone's slopes
+
+   \reviewed on 2017-01-24
+
+   TODO: consider writing unit test code for the function.
+
+   \param gen - generator
+*/
+void cw_gen_recalculate_slopes_internal(cw_gen_t *gen)
+{
+	/* The values in amplitudes[] change from zero to max (at
+	   least for any sane slope shape), so naturally they can be
+	   used in forming rising slope. However they can be used in
+	   forming falling slope as well - just iterate the table from
+	   end to beginning. */
+	if (gen->synthesis == CW_SYNTHESIS_FIXED_POINT) {
+		cw_gen_recalculate_slopes_fixed_internal(gen);
+		return;
+	}
+
+	for (int i = 0; i < gen->tone_slope.n_amplitudes; i++) {
+
+		if (gen->tone_slope.shape == CW_TONE_SLOPE_SHAPE_LINEAR) {
+			gen->tone_slope.amplitudes[i] = 1.0 * gen->volume_abs * i / gen->tone_slope.n_amplitudes;
+
+		} else if (gen->tone_slope.shape == CW_TONE_SLOPE_SHAPE_SINE) {
+			float radian = i * (M_PI / 2.0) / gen->tone_slope.n_amplitudes;
+			gen->tone_slope.amplitudes[i] = sin(radian) * gen->volume_abs;
+
+		} else if (gen->tone_slope.shape == CW_TONE_SLOPE_SHAPE_RAISED_COSINE) {
+			float radian = i * M_PI / gen->tone_slope.n_amplitudes;
+			gen->tone_slope.amplitudes[i] = (1 - ((1 + cos(radian)) / 2)) * gen->volume_abs;
+
+		} else if (gen->tone_slope.shape == CW_TONE_SLOPE_SHAPE_RECTANGULAR) {
+			/* CW_TONE_SLOPE_SHAPE_RECTANGULAR is covered
+			   before entering this "for" loop. */
+			cw_assert (0, MSG_PREFIX "we shouldn't be here, calculating rectangular slopes");
+
+		} else {
+			cw_assert (0, MSG_PREFIX "unsupported slope shape %d", gen->tone_slope.shape);
+		}
+	}
+
+	return;
+}
+
+
+
+
+/**
+   \brief Recalculate amplitudes of slopes with integer arithmetic
+
+   Fixed-point counterpart of cw_gen_recalculate_slopes_internal().
+
+   \param gen - generator
+*/
+void cw_gen_recalculate_slopes_fixed_internal(cw_gen_t *gen)
+{
+	const int32_t n = gen->tone_slope.n_amplitudes;
+	for (int32_t i = 0; i < n; i++) {
+		int32_t amplitude = 0;
+
+		if (gen->tone_slope.shape == CW_TONE_SLOPE_SHAPE_LINEAR) {
+			amplitude = gen->volume_abs * i / n;
+
+		} else if (gen->tone_slope.shape == CW_TONE_SLOPE_SHAPE_SINE) {
+			/* sin(i * (Pi / 2) / n). */
+			const uint32_t phase = (uint32_t) (((uint64_t) i << 30) / (uint32_t) n);
+			amplitude = (gen->volume_abs * cw_fixed_sin_internal(phase)) >> 15;
+
+		} else if (gen->tone_slope.shape == CW_TONE_SLOPE_SHAPE_RAISED_COSINE) {
+			/* (1 - cos(i * Pi / n)) / 2, cos(x) = sin(x + Pi / 2). */
+			const uint32_t phase = (uint32_t) (((uint64_t) i << 31) / (uint32_t) n) + (1u << 30);
+			amplitude = (gen->volume_abs * (32768 - cw_fixed_sin_internal(phase))) >> 16;
+
+		} else {
+			cw_assert (0, MSG_PREFIX "unsupported slope shape %d", gen->tone_slope.shape);
+		}
+
+		gen->tone_slope.amplitudes_fixed[i] = cw_fixed_saturate_internal(amplitude);
+	}
+
+	return;
+}
+
+
+
+
+/**
+   \brief Write tone to soundcard
+
+   \param gen
+   \param tone - tone dequeued from queue (if dequeueing was successful); must always be non-NULL
+   \param is_empty_tone - true if dequeueing was not successful (if no tone was dequeued), false otherwise
+
+   \return 0
+*/
+int cw_gen_write_to_soundcard_internal(cw_gen_t *gen, cw_tone_t *tone, bool is_empty_tone)
+{
+	cw_assert (tone, MSG_PREFIX "'tone' argument should always be non-NULL, even when dequeueing failed");
+
+	if (is_empty_tone) {
+		/* No valid tone dequeued from tone queue. 'tone'
+		   argument doesn't represent a valid tone. We need
+		   samples to complete filling buffer, but they have
+		   to be empty samples. */
+		cw_gen_empty_tone_calculate_samples_size_internal(gen, tone);
+	} else {
+		/* Valid tone dequeued from tone queue. Use it to
+		   calculate samples in buffer. */
+		cw_gen_tone_calculate_samples_size_internal(gen, tone);
+	}
+	/* After the calculations above, we can use 'tone' to generate
+	   samples in the same way, regardless of state of tone queue
+	   (regardless of what the tone queue returned in last call).
+
+	   Simply look at tone's frequency and tone's samples count. */
+
+	if (gen->encoder) {
+		cw_codec_encoder_add_tone_internal(gen->encoder, tone);
+	}
+
+
+	/* Total number of samples to write in a loop below. */
+	int64_t samples_to_write = tone->n_samples;
+
+#if 0   /* Debug code. */
+	int n_loops = 0;
+	const double n_loops_expected = floor(1.0 * samples_to_write / gen->buffer_n_samples); /* In reality number of loops executed is sometimes n_loops_expected, but mostly it's n_loops_expected+1. */
+	fprintf(stderr, MSG_PREFIX "entering loop (~%.1g), tone->frequency = %d, buffer->n_samples = %d, samples_to_write = %d\n",
+		n_loops_expected, tone->frequency, gen->buffer_n_samples, samples_to_write);
+
+#endif
+
+	// cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_GENERATOR, CW_DEBUG_DEBUG, MSG_PREFIX "%lld samples, %d us, %d Hz", tone->n_samples, tone->len, gen->frequency);
+	while (samples_to_write > 0) {
+
+		int64_t free_space = gen->buffer_n_samples - gen->buffer_sub_start;
+		if (samples_to_write > free_space) {
+			/* There will be some tone samples left for
+			   next iteration of this loop.  But buffer in
+			   this iteration will be ready to be pushed
+			   to audio sink. */
+			gen->buffer_sub_stop = gen->buffer_n_samples - 1;
+		} else if (samples_to_write == free_space) {
+			/* How nice, end of tone samples aligns with
+			   end of buffer (last sample of tone will be
+			   placed in last cell of buffer).
+
+			   But the result is the same - a full buffer
+			   ready to be pushed to audio sink. */
+			gen->buffer_sub_stop = gen->buffer_n_samples - 1;
+		} else {
+			/* There will be too few samples to fill a
+			   buffer. We can't send an under-filled buffer to
+			   audio sink. We will have to get more
+			   samples to fill the buffer completely. */
+			gen->buffer_sub_stop = gen->buffer_sub_start + samples_to_write - 1;
+		}
+
+		/* How many samples of audio buffer's subarea will be
+		   calculated in a given cycle of "calculate sine
+		   wave" code, i.e. in current iteration of the 'while' loop? */
+		const int buffer_sub_n_samples = gen->buffer_sub_stop - gen->buffer_sub_start + 1;
+
+
+#if 0           /* Debug code. */
+
+		fprintf(stderr, MSG_PREFIX "       loop #%d, buffer_sub_n_samples = %d\n", ++n_loops, buffer_sub_n_samples);
+		cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_GENERATOR, CW_DEBUG_DEBUG,
+			      MSG_PREFIX "sub start: %d, sub stop: %d, sub size: %d / %d", gen->buffer_sub_start, gen->buffer_sub_stop, buffer_sub_n_samples, samples_to_write);
+#endif
+
+		const int calculated = cw_gen_calculate_sine_wave_internal(gen, tone);
+		cw_assert (calculated == buffer_sub_n_samples, MSG_PREFIX "calculated wrong number of samples: %d != %d", calculated, buffer_sub_n_samples);
+
+		if (gen->buffer_sub_stop == gen->buffer_n_samples - 1) {
+
+			/* We have a buffer full of samples. The
+			   buffer is ready to be pushed to audio
+			   sink. */
+			cw_gen_write_internal(gen);
+#if CW_DEV_RAW_SINK
+			cw_dev_debug_raw_sink_write_internal(gen);
+#endif
+			if (gen->key_edges.is_enabled && gen->get_delay) {
+				/* Audio sink may be accessed only from
+				   this thread, so producer of key edges
+				   gets the delay from here. */
+				__atomic_store_n(&gen->key_edges.sink_delay, gen->get_delay(gen), __ATOMIC_RELAXED);
+			}
+			gen->buffer_sub_start = 0;
+			gen->buffer_sub_stop = 0;
+		} else {
+			/* #needmoresamples
+			   There is still some space left in the
+			   buffer, go fetch new tone from tone
+			   queue. */
+
+			gen->buffer_sub_start = gen->buffer_sub_stop + 1;
+
+			cw_assert (gen->buffer_sub_start <= gen->buffer_n_samples - 1, MSG_PREFIX "sub start out of range: sub start = %d, buffer n samples = %d", gen->buffer_sub_start, gen->buffer_n_samples);
+		}
+
+		samples_to_write -= buffer_sub_n_samples;
+
+#if 0           /* Debug code. */
+
+		if (samples_to_write < 0) {
+			cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_GENERATOR, CW_DEBUG_DEBUG, MSG_PREFIX "samples left = %d", samples_to_write);
+		}
+#endif
+
+	} /* while (samples_to_write > 0) { */
+
+#if 0   /* Debug code. */
+	fprintf(stderr, MSG_PREFIX "left loop, %d / %.1f loops, samples left = %d\n", n_loops, n_loops_expected, (int) samples_to_write);
+#endif
+
+	return 0;
+}
+
+
+
+
+/**
+   \brief Construct empty tone with correct/needed values of samples count
+
+   The function sets values tone->..._n_samples fields of empty \p
+   tone based on information from \p gen (i.e. looking on how many
+   samples of silence need to be "created").  The sample count values
+   are set in a way that allows filling remainder of generator's
+   buffer with silence.
+
+   After this point tone length should not be used - it's the samples count that is correct.
+
+   \reviewed on 2017-01-22
+
+   \param gen
+   \param tone - tone for which to calculate samples count.
+*/
+void cw_gen_empty_tone_calculate_samples_size_internal(cw_gen_t const * gen, cw_tone_t * tone)
+{
+	/* All tones have been already dequeued from tone queue.
+
+	   \p tone does not represent a valid tone to generate. At
+	   first sight there is no need to write anything to
+	   soundcard. But...
+
+	   It may happen that during previous call to the function
+	   there were too few samples in a tone to completely fill a
+	   buffer (see #needmoresamples tag below).
+
+	   We need to fill the buffer until it is full and ready to be
+	   sent to audio sink.
+
+	   Since there are no new tones for which we could generate
+	   samples, we need to generate silence samples.
+
+	   Padding the buffer with silence seems to be a good idea (it
+	   will work regardless of value (Mark/Space) of last valid
+	   tone). We just need to know how many samples of the silence
+	   to produce.
+
+	   Number of these samples will be stored in
+	   samples_to_write. */
+
+	/* We don't have a valid tone, so let's construct a fake one
+	   for purposes of padding. */
+
+	/* Required length of padding space is from end of last buffer
+	   subarea to end of buffer. */
+	tone->n_samples = gen->buffer_n_samples - (gen->buffer_sub_stop + 1);;
+
+	tone->len = 0;         /* This value matters no more, because now we only deal with samples. */
+	tone->frequency = 0;   /* This fake tone is a piece of silence. */
+
+	/* The silence tone used for padding doesn't require any
+	   slopes. A slope falling to silence has been already
+	   provided by last non-fake and non-silent tone. */
+	tone->slope_mode = CW_SLOPE_MODE_NO_SLOPES;
+	tone->rising_slope_n_samples = 0;
+	tone->falling_slope_n_samples = 0;
+
+	tone->sample_iterator = 0;
+
+	//fprintf(stderr, "++++ length of padding silence = %d [samples]\n", tone->n_samples);
+
+	return;
+}
+
+
+
+
+/**
+   \brief Get samples count of a single slope (rising or falling) of tones
+
+   \param sample_rate - sample rate of generator
+   \param slope_len - length of slope [microseconds]
+
+   \return samples count of slope
+*/
+int cw_gen_slope_n_samples_internal(int sample_rate, int slope_len)
+{
+	/* 100 * 10000 = 1.000.000 usecs per second. */
+	return ((sample_rate / 100) * slope_len) / 10000;
+}
+
+
+
+
+/**
+   \brief Recalculate non-empty tone parameters from microseconds into samples
+
+   The function sets tone->..._n_samples fields of non-empty \p tone
+   based on other information from \p tone and from \p gen.
+
+   After this point tone length should not be used - it's the samples count that is correct.
+
+   \reviewed on 2017-01-22
+
+   \param gen
+   \param tone - tone for which to calculate samples count.
+*/
+void cw_gen_tone_calculate_samples_size_internal(cw_gen_t const * gen, cw_tone_t * tone)
+{
+
+	/* 100 * 10000 = 1.000.000 usecs per second. */
+	tone->n_samples = gen->sample_rate / 100;
+	tone->n_samples *= tone->len;
+	tone->n_samples /= 10000;
+
+	//fprintf(stderr, MSG_PREFIX "length of regular tone = %d [samples]\n", tone->n_samples);
+
+	/* Length of a single slope (rising or falling). */
+	const int slope_n_samples = cw_gen_slope_n_samples_internal(gen->sample_rate, gen->tone_slope.len);
+
+	if (tone->slope_mode == CW_SLOPE_MODE_RISING_SLOPE) {
+		tone->rising_slope_n_samples = slope_n_samples;
+		tone->falling_slope_n_samples = 0;
+
+	} else if (tone->slope_mode == CW_SLOPE_MODE_FALLING_SLOPE) {
+		tone->rising_slope_n_samples = 0;
+		tone->falling_slope_n_samples = slope_n_samples;
+
+	} else if (tone->slope_mode == CW_SLOPE_MODE_STANDARD_SLOPES) {
+		tone->rising_slope_n_samples = slope_n_samples;
+		tone->falling_slope_n_samples = slope_n_samples;
+
+	} else if (tone->slope_mode == CW_SLOPE_MODE_NO_SLOPES) {
+		tone->rising_slope_n_samples = 0;
+		tone->falling_slope_n_samples = 0;
+
+	} else {
+		cw_assert (0, MSG_PREFIX "unknown tone slope mode %d", tone->slope_mode);
+	}
+
+	tone->sample_iterator = 0;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Set sending speed of generator
+
+   See libcw.h/CW_SPEED_{INITIAL|MIN|MAX} for initial/minimal/maximal value
+   of send speed.
+
+   \errno EINVAL - \p new_value is out of range.
+
+   \reviewed on 2017-01-21
+
+   \param gen - generator for which to set the speed
+   \param new_value - new value of send speed to be assigned to generator
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_gen_set_speed(cw_gen_t *gen, int new_value)
+{
+	if (new_value < CW_SPEED_MIN || new_value > CW_SPEED_MAX) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	if (new_value != gen->send_speed) {
+		gen->send_speed = new_value;
+
+		/* Changes of send speed require resynchronization. */
+		gen->parameters_in_sync = false;
+		cw_gen_sync_parameters_internal(gen);
+	}
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Set frequency of generator
+
+   Set frequency of sound wave generated by generator.
+   The frequency must be within limits marked by CW_FREQUENCY_MIN
+   and CW_FREQUENCY_MAX.
+
+   See libcw.h/CW_FREQUENCY_{INITIAL|MIN|MAX} for initial/minimal/maximal
+   value of frequency.
+
+   \errno EINVAL - \p new_value is out of range.
+
+   \reviewed on 2017-01-21
+
+   \param gen - generator for which to set new frequency
+   \param new_value - new value of frequency to be assigned to generator
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_gen_set_frequency(cw_gen_t *gen, int new_value)
+{
+	if (new_value < CW_FREQUENCY_MIN || new_value > CW_FREQUENCY_MAX) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	} else {
+		gen->frequency = new_value;
+		return CW_SUCCESS;
+	}
+}
+
+
+
+
+/**
+   \brief Set volume of generator
+
+   Set volume of sound wave generated by generator.
+   The volume must be within limits marked by CW_VOLUME_MIN and CW_VOLUME_MAX.
+
+   Note that volume settings are not fully possible for the console speaker.
+   In this case, volume settings greater than zero indicate console speaker
+   sound is on, and setting volume to zero will turn off console speaker
+   sound.
+
+   See libcw.h/CW_VOLUME_{INITIAL|MIN|MAX} for initial/minimal/maximal
+   value of volume.
+   errno is set to EINVAL if \p new_value is out of range.
+
+   \param gen - generator for which to set a volume level
+   \param new_value - new value of volume to be assigned to generator
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_gen_set_volume(cw_gen_t *gen, int new_value)
+{
+	if (new_value < CW_VOLUME_MIN || new_value > CW_VOLUME_MAX) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	} else {
+		gen->volume_percent = new_value;
+		gen->volume_abs = (gen->volume_percent * CW_AUDIO_VOLUME_RANGE) / 100;
+
+		cw_gen_set_tone_slope(gen, -1, -1);
+
+		return CW_SUCCESS;
+	}
+}
+
+
+
+
+/**
+   \brief Set sending gap of generator
+
+   See libcw.h/CW_GAP_{INITIAL|MIN|MAX} for initial/minimal/maximal
+   value of gap.
+   errno is set to EINVAL if \p new_value is out of range.
+
+   \param gen - generator for which to set gap
+   \param new_value - new value of gap to be assigned to generator
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_gen_set_gap(cw_gen_t *gen, int new_value)
+{
+	if (new_value < CW_GAP_MIN || new_value > CW_GAP_MAX) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	if (new_value != gen->gap) {
+		gen->gap = new_value;
+		/* Changes of gap require resynchronization. */
+		gen->parameters_in_sync = false;
+		cw_gen_sync_parameters_internal(gen);
+	}
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Set sending weighting for generator
+
+   See libcw.h/CW_WEIGHTING_{INITIAL|MIN|MAX} for initial/minimal/maximal
+   value of weighting.
+   errno is set to EINVAL if \p new_value is out of range.
+
+   \param gen - generator for which to set new weighting
+   \param new_value - new value of weighting to be assigned for generator
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_gen_set_weighting(cw_gen_t * gen, int new_value)
+{
+	if (new_value < CW_WEIGHTING_MIN || new_value > CW_WEIGHTING_MAX) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	if (new_value != gen->weighting) {
+		gen->weighting = new_value;
+
+		/* Changes of weighting require resynchronization. */
+		gen->parameters_in_sync = false;
+		cw_gen_sync_parameters_internal(gen);
+	}
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Get sending speed from generator
+
+   Returned value is in range CW_SPEED_MIN-CW_SPEED_MAX [wpm].
+
+   \reviewed on 2017-01-21
+
+   \param gen - generator from which to get the parameter
+
+   \return current value of the generator's send speed
+*/
+int cw_gen_get_speed(const cw_gen_t * gen)
+{
+	return gen->send_speed;
+}
+
+
+
+
+/**
+   \brief Get frequency from generator
+
+   Function returns "frequency" parameter of generator,
+   even if the generator is stopped, or volume of generated sound is zero.
+
+   Returned value is in range CW_FREQUENCY_MIN-CW_FREQUENCY_MAX [Hz].
+
+   \reviewed on 2017-01-21
+
+   \param gen - generator from which to get the parameter
+
+   \return current value of generator's frequency
+*/
+int cw_gen_get_frequency(const cw_gen_t * gen)
+{
+	return gen->frequency;
+}
+
+
+
+
+/**
+   \brief Get sound volume from generator
+
+   Function returns "volume" parameter of generator, even if the
+   generator is stopped.  Returned value is in range
+   CW_VOLUME_MIN-CW_VOLUME_MAX [%].
+
+
+   \reviewed on 2017-01-21
+
+   \param gen - generator from which to get the parameter
+
+   \return current value of generator's sound volume
+*/
+int cw_gen_get_volume(const cw_gen_t * gen)
+{
+	return gen->volume_percent;
+}
+
+
+
+
+/**
+   \brief Get sending gap from generator
+
+   Returned value is in range CW_GAP_MIN-CW_GAP_MAX.
+
+   \reviewed on 2017-01-21
+
+   \param gen - generator from which to get the parameter
+
+   \return current value of generator's sending gap
+*/
+int cw_gen_get_gap(const cw_gen_t * gen)
+{
+	return gen->gap;
+}
+
+
+
+
+/**
+   \brief Get sending weighting from generator
+
+   Returned value is in range CW_WEIGHTING_MIN-CW_WEIGHTING_MAX.
+
+   \reviewed on 2017-01-21
+
+   \param gen - generator from which to get the parameter
+
+   \return current value of generator's sending weighting
+*/
+int cw_gen_get_weighting(const cw_gen_t * gen)
+{
+	return gen->weighting;
+}
+
+
+
+
+/**
+   \brief Get timing parameters for sending
+
+   Return the low-level timing parameters calculated from the speed,
+   gap, tolerance, and weighting set.  Units of returned parameter
+   values are microseconds.
+
+   Use NULL for the pointer argument to any parameter value not required.
+
+   \reviewed on 2017-01-21
+
+   \param gen
+   \param dot_len
+   \param dash_len
+   \param eom_space_len
+   \param eoc_space_len
+   \param eow_space_len
+   \param additional_space_len
+   \param adjustment_space_len
+*/
+void cw_gen_get_timing_parameters_internal(cw_gen_t *gen,
+					   int *dot_len,
+					   int *dash_len,
+					   int *eom_space_len,
+					   int *eoc_space_len,
+					   int *eow_space_len,
+					   int *additional_space_len, int *adjustment_space_len)
+{
+	cw_gen_sync_parameters_internal(gen);
+
+	if (dot_len)   { *dot_len = gen->dot_len; }
+	if (dash_len)  { *dash_len = gen->dash_len; }
+
+	if (eom_space_len)   { *eom_space_len = gen->eom_space_len; }
+	if (eoc_space_len)   { *eoc_space_len = gen->eoc_space_len; }
+	if (eow_space_len)   { *eow_space_len = gen->eow_space_len; }
+
+	if (additional_space_len)    { *additional_space_len = gen->additional_space_len; }
+	if (adjustment_space_len)    { *adjustment_space_len = gen->adjustment_space_len; }
+
+	return;
+}
+
+
+
+
+/**
+   \brief Enqueue a tone of character
+
+   Low level primitive used by functions enqueueing Marks and Spaces
+   of characters. The tone is enqueued in generator's tone queue, or
+   appended to generator's timeline (if the generator has one, see
+   cw_gen_set_timeline()).
+
+   \param gen - generator
+   \param tone - tone to enqueue
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_gen_enqueue_tone_internal(cw_gen_t * gen, cw_tone_t * tone)
+{
+	if (gen->timeline) {
+		return cw_timeline_append_internal(gen->timeline, tone);
+	} else {
+		return cw_tq_enqueue_internal(gen->tq, tone);
+	}
+}
+
+
+
+
+/**
+   \brief Enqueue a mark (Dot or Dash)
+
+   Low level primitive to enqueue a tone for mark of the given type, followed
+   by the standard inter-mark space.
+
+   Function sets errno to EINVAL if an argument is invalid, and
+   returns CW_FAILURE.
+
+   Function also returns CW_FAILURE if adding the element to queue of
+   tones failed.
+
+   \param gen - generator to be used to enqueue a mark and inter-mark space
+   \param mark - mark to send: Dot (CW_DOT_REPRESENTATION) or Dash (CW_DASH_REPRESENTATION)
+   \param is_first - is it a first mark in a character?
+
+   \return CW_FAILURE on failure
+   \return CW_SUCCESS on success
+*/
+int cw_gen_enqueue_mark_internal(cw_gen_t *gen, char mark, bool is_first)
+{
+	int status;
+
+	/* Synchronize low-level timings if required. */
+	cw_gen_sync_parameters_internal(gen);
+	/* TODO: do we need to synchronize here receiver as well? */
+
+	/* Send either a dot or a dash mark, depending on representation. */
+	if (mark == CW_DOT_REPRESENTATION) {
+		cw_tone_t tone;
+		CW_TONE_INIT(&tone, gen->frequency, gen->dot_len, CW_SLOPE_MODE_STANDARD_SLOPES);
+		tone.is_first = is_first;
+		tone.symbol = gen->symbolic_enqueue ? CW_TONE_SYMBOL_DOT : CW_TONE_SYMBOL_NONE;
+		status = cw_gen_enqueue_tone_internal(gen, &tone);
+	} else if (mark == CW_DASH_REPRESENTATION) {
+		cw_tone_t tone;
+		CW_TONE_INIT(&tone, gen->frequency, gen->dash_len, CW_SLOPE_MODE_STANDARD_SLOPES);
+		tone.is_first = is_first;
+		tone.symbol = gen->symbolic_enqueue ? CW_TONE_SYMBOL_DASH : CW_TONE_SYMBOL_NONE;
+		status = cw_gen_enqueue_tone_internal(gen, &tone);
+	} else {
+		errno = EINVAL;
+		status = CW_FAILURE;
+	}
+
+	if (CW_SUCCESS != status) {
+		return CW_FAILURE;
+	}
+
+	/* Send the inter-mark space. */
+	cw_tone_t tone;
+	CW_TONE_INIT(&tone, 0, gen->eom_space_len, CW_SLOPE_MODE_NO_SLOPES);
+	tone.symbol = gen->symbolic_enqueue ? CW_TONE_SYMBOL_EOM_SPACE : CW_TONE_SYMBOL_NONE;
+	if (CW_SUCCESS != cw_gen_enqueue_tone_internal(gen, &tone)) {
+		return CW_FAILURE;
+	} else {
+		return CW_SUCCESS;
+	}
+}
+
+
+
+
+/**
+   \brief Enqueue inter-character space
+
+   The function enqueues space of length 2 Units. The function is
+   intended to be used after inter-mark space has already been enqueued.
+
+   In such situation standard inter-mark space (one Unit) and two
+   Units enqueued by this function form a full standard
+   inter-character space (three Units).
+
+   Inter-character adjustment space is added at the end.
+
+   \param gen
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_gen_enqueue_eoc_space_internal(cw_gen_t *gen)
+{
+	/* Synchronize low-level timing parameters. */
+	cw_gen_sync_parameters_internal(gen);
+
+	/* Enqueue standard inter-character space, plus any additional inter-character gap. */
+	cw_tone_t tone;
+	CW_TONE_INIT(&tone, 0, gen->eoc_space_len + gen->additional_space_len, CW_SLOPE_MODE_NO_SLOPES);
+	tone.symbol = gen->symbolic_enqueue ? CW_TONE_SYMBOL_EOC_SPACE : CW_TONE_SYMBOL_NONE;
+	return cw_gen_enqueue_tone_internal(gen, &tone);
+}
+
+
+
+
+/**
+   \brief Enqueue space character (' ') in generator, to be sent using Morse code
+
+   The function should be used to enqueue a regular ' ' character.
+
+   The function enqueues space of length 5 Units. The function is
+   intended to be used after inter-mark space and inter-character
+   space have already been enqueued.
+
+   In such situation standard inter-mark space (one Unit) and
+   inter-character space (two Units) and regular space (five units)
+   form a full standard inter-word space (seven Units).
+
+   Inter-word adjustment space is added at the end.
+
+   \param gen
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_gen_enqueue_eow_space_internal(cw_gen_t *gen)
+{
+	/* Synchronize low-level timing parameters. */
+	cw_gen_sync_parameters_internal(gen);
+
+	/* Send silence for the word delay period, plus any adjustment
+	   that may be needed at end of word. Make it in two tones,
+	   and here is why.
+
+	   Let's say that 'tone queue low watermark' is one element
+	   (i.e. one tone).
+
+	   In order for tone queue to recognize that a 'low tone
+	   queue' callback needs to be called, the level in tq needs
+	   to drop from 2 to 1.
+
+	   Almost every queued character guarantees that there will be
+	   at least two tones, e.g for 'E' it is dash + following
+	   space. But what about a ' ' character?
+
+	   If we enqueue ' ' character as single tone, there is only one
+	   tone in tone queue, and the tone queue manager can't
+	   recognize when the level drops from 2 to 1 (and thus the
+	   'low level' callback won't be called).
+
+	   If we enqueue ' ' character as two separate tones (as we do
+	   this in this function), the tone queue manager can
+	   recognize level dropping from 2 to 1. Then the passing of
+	   critical level can be noticed, and "low level" callback can
+	   be called.
+
+	   BUT: Sometimes the first tone is dequeued before/during the
+	   second one is enqueued, and we can't recognize 2->1 event.
+
+	   So, to be super-sure that there is a recognizable event of
+	   passing tone queue level from 2 to 1, we split the inter-word
+	   space into N parts and enqueue them. This way we have N + 1
+	   tones per space, and client applications that rely on low
+	   level threshold == 1 can correctly work when enqueueing
+	   spaces.
+
+	   At 60 wpm length of gen->eow_space_len is 100000 [us], so
+	   it's large enough to safely divide it by small integer
+	   value. */
+
+	int enqueued = 0;
+
+	cw_tone_t tone;
+#if 0
+	/* This section is incorrect. Enable this section only for
+	   tests.  This section "implements" a bug that was present in
+	   libcw until version 6.4.1 and that is now tested by
+	   src/libcw/tests/libcw_test_tq_short_space.c */
+	const int n = 1; /* No division. Old situation causing an error in
+		      client applications. */
+#else
+	const int n = CW_GEN_EOW_SPACE_N_PARTS; /* "small integer value" - used to have more tones per eow space. */
+#endif
+	CW_TONE_INIT(&tone, 0, gen->eow_space_len / n, CW_SLOPE_MODE_NO_SLOPES);
+	tone.symbol = gen->symbolic_enqueue ? CW_TONE_SYMBOL_EOW_SPACE_PART : CW_TONE_SYMBOL_NONE;
+	for (int i = 0; i < n; i++) {
+		if (CW_SUCCESS != cw_gen_enqueue_tone_internal(gen, &tone)) {
+			return CW_FAILURE;
+		}
+		enqueued++;
+	}
+
+	CW_TONE_INIT(&tone, 0, gen->adjustment_space_len, CW_SLOPE_MODE_NO_SLOPES);
+	tone.symbol = gen->symbolic_enqueue ? CW_TONE_SYMBOL_ADJUSTMENT_SPACE : CW_TONE_SYMBOL_NONE;
+	if (CW_SUCCESS != cw_gen_enqueue_tone_internal(gen, &tone)) {
+		return CW_FAILURE;
+	}
+	enqueued++;
+
+	cw_debug_msg (&cw_debug_object, CW_DEBUG_GENERATOR, CW_DEBUG_DEBUG, MSG_PREFIX "enqueued %d tones per iw space, tq len = %zu", enqueued, cw_tq_length_internal(gen->tq));
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Enqueue the given representation in generator, to be sent using Morse code
+
+   Function enqueues given \p representation using given \p generator.
+   *Every* mark from the \p representation is followed by a standard
+   inter-mark space.
+
+   Representation is not validated by this function.
+
+   _partial_ in function's name means that the inter-character space is
+   not appended at the end of Marks and Spaces enqueued in generator
+   (but the last inter-mark space is).
+
+   \errno EAGAIN - there is not enough space in tone queue to enqueue
+   \p representation.
+
+   \reviewed on 2017-01-21
+
+   \param gen - generator used to enqueue the representation
+   \param representation - representation to enqueue
+
+   \return CW_FAILURE on failure
+   \return CW_SUCCESS on success
+*/
+int cw_gen_enqueue_representation_partial_internal(cw_gen_t *gen, const char *representation)
+{
+	/* Before we let this representation loose on tone generation,
+	   we'd really like to know that all of its tones will get queued
+	   up successfully.  The right way to do this is to calculate the
+	   number of tones in our representation, then check that the space
+	   exists in the tone queue. However, since the queue is comfortably
+	   long, we can get away with just looking for a high water mark.  */
+	if (!gen->timeline && cw_tq_length_internal(gen->tq) >= gen->tq->high_water_mark) {
+		errno = EAGAIN;
+		return CW_FAILURE;
+	}
+
+	/* Enqueue the marks. Every mark is followed by inter-mark
+	   space. */
+	for (int i = 0; representation[i] != '\0'; i++) {
+		if (!cw_gen_enqueue_mark_internal(gen, representation[i], i == 0)) {
+			return CW_FAILURE;
+		}
+	}
 
-#if 0           /* Debug code. */
+	/* No inter-character space added here. */
 
-		if (samples_to_write < 0) {
-			cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_GENERATOR, CW_DEBUG_DEBUG, MSG_PREFIX "samples left = %d", samples_to_write);
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Enqueue a given valid ASCII character in generator, to be sent using Morse code
+
+   _valid_character_ in function's name means that the function
+   expects the character \p c to be valid (\p c should be validated by
+   caller before passing it to the function).
+
+   _partial_ in function's name means that the inter-character space is
+   not appended at the end of Marks and Spaces enqueued in generator
+   (but the last inter-mark space is).
+
+   \errno ENOENT - character \p c is not a recognized character.
+
+   \reviewed on 2017-01-21
+
+   \param gen - generator to be used to enqueue character
+   \param table - table of characters in which \p character has been validated
+   \param character - character to enqueue
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_gen_enqueue_valid_character_partial_internal(cw_gen_t *gen, const cw_character_table_t *table, char character)
+{
+	if (!gen) {
+		cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_GENERATOR, CW_DEBUG_ERROR,
+			      MSG_PREFIX "no generator available");
+		return CW_FAILURE;
+	}
+
+	/* ' ' character (i.e. regular space) is a special case. */
+	if (character == ' ') {
+		return cw_gen_enqueue_eow_space_internal(gen);
+	}
+
+	/* backspace character (0x08) is also a special case. */
+	if (character == '\b') {
+		if (gen->timeline) {
+			cw_timeline_backspace_internal(gen->timeline);
+		} else {
+			cw_tq_handle_backspace_internal(gen->tq);
 		}
-#endif
+		return CW_SUCCESS;
+	}
 
-	} /* while (samples_to_write > 0) { */
+	const char *representation = cw_character_table_to_representation_internal(table, character);
 
-#if 0   /* Debug code. */
-	fprintf(stderr, MSG_PREFIX "left loop, %d / %.1f loops, samples left = %d\n", n_loops, n_loops_expected, (int) samples_to_write);
-#endif
+	/* This shouldn't happen since we are in _valid_character_
+	   function, and the character has been validated in the same
+	   table... */
+	cw_assert (representation, MSG_PREFIX "failed to find representation for character '%c'/%hhx", character, character);
 
-	return 0;
+	/* ... but fail gracefully anyway. */
+	if (!representation) {
+		errno = ENOENT;
+		return CW_FAILURE;
+	}
+
+	if (!cw_gen_enqueue_representation_partial_internal(gen, representation)) {
+		return CW_FAILURE;
+	}
+
+	/* No inter-character space here. */
+
+	return CW_SUCCESS;
 }
 
 
 
 
 /**
-   \brief Construct empty tone with correct/needed values of samples count
+   \brief Enqueue a given valid ASCII character in generator, to be sent using Morse code
 
-   The function sets values tone->..._n_samples fields of empty \p
-   tone based on information from \p gen (i.e. looking on how many
-   samples of silence need to be "created").  The sample count values
-   are set in a way that allows filling remainder of generator's
-   buffer with silence.
+   After enqueueing last Mark (Dot or Dash) comprising a character, an
+   inter-mark space is enqueued.  Inter-character space is enqueued
+   after that last inter-mark space.
 
-   After this point tone length should not be used - it's the samples count that is correct.
+   _valid_character_ in function's name means that the function
+   expects the character \p c to be valid (\p c should be validated by
+   caller before passing it to the function).
 
-   \reviewed on 2017-01-22
+   \errno ENOENT - character \p c is not a recognized character.
 
-   \param gen
-   \param tone - tone for which to calculate samples count.
+   \reviewed on 2017-01-20
+
+   \param gen - generator to be used to enqueue character
+   \param table - table of characters in which \p c has been validated
+   \param c - character to enqueue
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
 */
-void cw_gen_empty_tone_calculate_samples_size_internal(cw_gen_t const * gen, cw_tone_t * tone)
+int cw_gen_enqueue_valid_character_internal(cw_gen_t *gen, const cw_character_table_t *table, char c)
 {
-	/* All tones have been already dequeued from tone queue.
+	if (!cw_gen_enqueue_valid_character_partial_internal(gen, table, c)) {
+		return CW_FAILURE;
+	}
 
-	   \p tone does not represent a valid tone to generate. At
-	   first sight there is no need to write anything to
-	   soundcard. But...
+	if (!cw_gen_enqueue_eoc_space_internal(gen)) {
+		return CW_FAILURE;
+	}
 
-	   It may happen that during previous call to the function
-	   there were too few samples in a tone to completely fill a
-	   buffer (see #needmoresamples tag below).
+	return CW_SUCCESS;
+}
 
-	   We need to fill the buffer until it is full and ready to be
-	   sent to audio sink.
 
-	   Since there are no new tones for which we could generate
-	   samples, we need to generate silence samples.
 
-	   Padding the buffer with silence seems to be a good idea (it
-	   will work regardless of value (Mark/Space) of last valid
-	   tone). We just need to know how many samples of the silence
-	   to produce.
 
-	   Number of these samples will be stored in
-	   samples_to_write. */
+/**
+   \brief Enqueue a given ASCII character in generator, to be sent using Morse code
 
-	/* We don't have a valid tone, so let's construct a fake one
-	   for purposes of padding. */
+   Inter-mark + inter-character delay is appended at the end of
+   enqueued Marks.
 
-	/* Required length of padding space is from end of last buffer
-	   subarea to end of buffer. */
-	tone->n_samples = gen->buffer_n_samples - (gen->buffer_sub_stop + 1);;
+   \errno ENOENT - the given character \p c is not a valid Morse
+   character.
 
-	tone->len = 0;         /* This value matters no more, because now we only deal with samples. */
-	tone->frequency = 0;   /* This fake tone is a piece of silence. */
+   \errno EBUSY - generator's audio sink or keying system is busy.
 
-	/* The silence tone used for padding doesn't require any
-	   slopes. A slope falling to silence has been already
-	   provided by last non-fake and non-silent tone. */
-	tone->slope_mode = CW_SLOPE_MODE_NO_SLOPES;
-	tone->rising_slope_n_samples = 0;
-	tone->falling_slope_n_samples = 0;
+   \errno EAGAIN - generator's tone queue is full, or there is
+   insufficient space to queue the tones for the character.
 
-	tone->sample_iterator = 0;
+   This routine returns as soon as the character and trailing spaces
+   (inter-mark and inter-character spaces) have been successfully
+   queued for sending/playing by the generator, without waiting for
+   generator to even start playing the character.  The actual sending
+   happens in background processing. See cw_gen_wait_for_tone() and
+   cw_gen_wait_for_queue_level() for ways to check the progress of
+   sending.
+
+   \reviewed on 2017-01-20
+
+   \param gen - generator to enqueue the character to
+   \param c - character to enqueue in generator
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_gen_enqueue_character(cw_gen_t * gen, char c)
+{
+	/* Validate and look up the character in the same table. */
+	const cw_character_table_t *table = cw_character_table_internal();
+	if (!(cw_character_table_classes_internal(table)->flags[(unsigned char) c] & CW_DATA_CLASS_VALID)) {
+		errno = ENOENT;
+		return CW_FAILURE;
+	}
+
+	/* This function adds eoc space at the end of character. */
+	if (!cw_gen_enqueue_valid_character_internal(gen, table, c)) {
+		return CW_FAILURE;
+	}
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Enqueue a given ASCII character in generator, to be sent using Morse code
+
+   "partial" means that the inter-character space is not appended at
+   the end of Marks and Spaces enqueued in generator (but the last
+   inter-mark space is). This enables the formation of combination
+   characters by client code.
+
+   This routine returns as soon as the character has been successfully
+   queued for sending/playing by the generator, without waiting for
+   generator to even start playing the character. The actual sending
+   happens in background processing.  See cw_gen_wait_for_tone() and
+   cw_gen_wait_for_queue() for ways to check the progress of sending.
+
+   \reviewed on 2017-01-20
+
+   \errno ENOENT - given character \p c is not a valid Morse
+   character.
+
+   \errno EBUSY - generator's audio sink or keying system is busy.
+
+   \errno EAGAIN - generator's tone queue is full, or there is
+   insufficient space to queue the tones for the character.
+
+   \param gen - generator to use
+   \param c - character to enqueue
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_gen_enqueue_character_partial(cw_gen_t *gen, char c)
+{
+	/* Validate and look up the character in the same table. */
+	const cw_character_table_t *table = cw_character_table_internal();
+	if (!(cw_character_table_classes_internal(table)->flags[(unsigned char) c] & CW_DATA_CLASS_VALID)) {
+		errno = ENOENT;
+		return CW_FAILURE;
+	}
+
+	if (!cw_gen_enqueue_valid_character_partial_internal(gen, table, c)) {
+		return CW_FAILURE;
+	}
+
+	/* _partial(): don't enqueue eoc space. */
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Enqueue a given ASCII string in generator, to be sent using Morse code
+
+   For safety, clients can ensure the tone queue is empty before
+   queueing a string, or use cw_gen_enqueue_character() if they
+   need finer control.
+
+   This routine returns as soon as the string has been successfully
+   queued for sending/playing by the generator, without waiting for
+   generator to even start playing the string. The actual
+   playing/sending happens in background. See cw_gen_wait_for_tone()
+   and cw_gen_wait_for_queue() for ways to check the progress of
+   sending.
+
+
+   \errno ENOENT - \p string argument is invalid (one or more
+   characters in the string is not a valid Morse character). No tones
+   from such string are going to be enqueued.
+
+   \errno EBUSY  - generator's audio sink or keying system is busy
+
+   \errno EAGAIN - generator's tone queue is full or the tone queue
+   is likely to run out of space part way through queueing the string.
+   However, an indeterminate number of the characters from the string
+   will have already been queued.
+
+   \param gen - generator to use
+   \param string - string to enqueue
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_gen_enqueue_string(cw_gen_t * gen, const char * string)
+{
+	/* Check that the string is composed of valid characters. The
+	   characters are validated and looked up in the same table. */
+	const cw_character_table_t *table = cw_character_table_internal();
+	const cw_character_classes_t *classes = cw_character_table_classes_internal(table);
+	for (const unsigned char *c = (const unsigned char *) string; *c != '\0'; c++) {
+		if (!(classes->flags[*c] & CW_DATA_CLASS_VALID)) {
+			errno = ENOENT;
+			return CW_FAILURE;
+		}
+	}
 
-	//fprintf(stderr, "++++ length of padding silence = %d [samples]\n", tone->n_samples);
+	/* Send every character in the string. */
+	for (int i = 0; string[i] != '\0'; i++) {
+		/* This function adds eoc space at the end of character. */
+		if (!cw_gen_enqueue_valid_character_internal(gen, table, string[i])) {
+			return CW_FAILURE;
+		}
+	}
 
-	return;
+	return CW_SUCCESS;
 }
 
 
 
 
 /**
-   \brief Recalculate non-empty tone parameters from microseconds into samples
+   \brief Enqueue a given UTF-8 string in generator, to be sent using Morse code
 
-   The function sets tone->..._n_samples fields of non-empty \p tone
-   based on other information from \p tone and from \p gen.
+   Characters of the string are looked up in generator's alphabet
+   (see cw_gen_set_alphabet()). Otherwise the function works as
+   cw_gen_enqueue_string().
 
-   After this point tone length should not be used - it's the samples count that is correct.
+   \errno ENOENT - \p string is not a valid UTF-8 string, or one or
+   more characters in the string don't have representation in
+   generator's alphabet. No tones from such string are going to be
+   enqueued.
 
-   \reviewed on 2017-01-22
+   \errno EAGAIN - generator's tone queue is full or the tone queue
+   is likely to run out of space part way through queueing the string.
+   However, an indeterminate number of the characters from the string
+   will have already been queued.
 
-   \param gen
-   \param tone - tone for which to calculate samples count.
+   \param gen - generator to use
+   \param string - UTF-8 string to enqueue
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
 */
-void cw_gen_tone_calculate_samples_size_internal(cw_gen_t const * gen, cw_tone_t * tone)
+int cw_gen_enqueue_utf8_string(cw_gen_t * gen, const char * string)
 {
+	const char *representations[CW_ALPHABET_REPRESENTATIONS_MAX];
+	uint32_t codepoint = 0;
 
-	/* 100 * 10000 = 1.000.000 usecs per second. */
-	tone->n_samples = gen->sample_rate / 100;
-	tone->n_samples *= tone->len;
-	tone->n_samples /= 10000;
-
-	//fprintf(stderr, MSG_PREFIX "length of regular tone = %d [samples]\n", tone->n_samples);
-
-	/* Length of a single slope (rising or falling). */
-	int slope_n_samples = gen->sample_rate / 100;
-	slope_n_samples *= gen->tone_slope.len;
-	slope_n_samples /= 10000;
-
-	if (tone->slope_mode == CW_SLOPE_MODE_RISING_SLOPE) {
-		tone->rising_slope_n_samples = slope_n_samples;
-		tone->falling_slope_n_samples = 0;
+	/* Check that the string is composed of valid characters. */
+	for (const char *s = string; *s != '\0'; ) {
+		if (!cw_utf8_decode_internal(&s, &codepoint)) {
+			errno = ENOENT;
+			return CW_FAILURE;
+		}
+		if (codepoint != ' ' && codepoint != '\b'
+		    && !cw_alphabet_codepoint_to_representations(gen->alphabet, codepoint, representations)) {
 
-	} else if (tone->slope_mode == CW_SLOPE_MODE_FALLING_SLOPE) {
-		tone->rising_slope_n_samples = 0;
-		tone->falling_slope_n_samples = slope_n_samples;
+			errno = ENOENT;
+			return CW_FAILURE;
+		}
+	}
 
-	} else if (tone->slope_mode == CW_SLOPE_MODE_STANDARD_SLOPES) {
-		tone->rising_slope_n_samples = slope_n_samples;
-		tone->falling_slope_n_samples = slope_n_samples;
+	/* Send every character in the string. */
+	for (const char *s = string; *s != '\0'; ) {
+		cw_utf8_decode_internal(&s, &codepoint);
+		if (codepoint == ' ' || codepoint == '\b') {
+			/* Space and backspace don't need a table. */
+			if (!cw_gen_enqueue_valid_character_internal(gen, cw_character_table_internal(), (char) codepoint)) {
+				return CW_FAILURE;
+			}
+			continue;
+		}
 
-	} else if (tone->slope_mode == CW_SLOPE_MODE_NO_SLOPES) {
-		tone->rising_slope_n_samples = 0;
-		tone->falling_slope_n_samples = 0;
+		const int n = cw_alphabet_codepoint_to_representations(gen->alphabet, codepoint, representations);
+		for (int i = 0; i < n; i++) {
+			if (!cw_gen_enqueue_representation_partial_internal(gen, representations[i])
+			    || !cw_gen_enqueue_eoc_space_internal(gen)) {
 
-	} else {
-		cw_assert (0, MSG_PREFIX "unknown tone slope mode %d", tone->slope_mode);
+				return CW_FAILURE;
+			}
+		}
 	}
 
-	tone->sample_iterator = 0;
-
-	return;
+	return CW_SUCCESS;
 }
 
 
 
 
 /**
-   \brief Set sending speed of generator
+   \brief Enqueue a pre-encoded message in generator
 
-   See libcw.h/CW_SPEED_{INITIAL|MIN|MAX} for initial/minimal/maximal value
-   of send speed.
+   \p elements is a sequence of marks (CW_DOT_REPRESENTATION,
+   CW_DASH_REPRESENTATION) and spaces: CW_ELEMENT_EOC_SPACE ends a
+   character, CW_ELEMENT_EOW_SPACE extends it to inter-word space.
+   Space character of cw_gen_enqueue_string() is enqueued as
+   CW_ELEMENT_EOW_SPACE followed by CW_ELEMENT_EOC_SPACE, so "CQ DE"
+   is "-.-. --.- / -.. . ".
 
-   \errno EINVAL - \p new_value is out of range.
+   The function doesn't look up any characters, so messages that are
+   sent many times (calls, beacon identifiers) can be encoded once,
+   or at compile time (see libcw++.h).
 
-   \reviewed on 2017-01-21
+   \errno EINVAL - \p elements contains invalid element. No tones
+   are enqueued.
 
-   \param gen - generator for which to set the speed
-   \param new_value - new value of send speed to be assigned to generator
+   \errno EAGAIN - generator's tone queue is full or the tone queue
+   is likely to run out of space part way through queueing the
+   message. However, an indeterminate number of the characters from
+   the message will have already been queued.
+
+   \param gen - generator to use
+   \param elements - elements of message
+   \param n_elements - count of elements
 
    \return CW_SUCCESS on success
    \return CW_FAILURE on failure
 */
-int cw_gen_set_speed(cw_gen_t *gen, int new_value)
+int cw_gen_enqueue_elements(cw_gen_t * gen, const char * elements, size_t n_elements)
 {
-	if (new_value < CW_SPEED_MIN || new_value > CW_SPEED_MAX) {
-		errno = EINVAL;
-		return CW_FAILURE;
+	for (size_t i = 0; i < n_elements; i++) {
+		if (elements[i] != CW_DOT_REPRESENTATION && elements[i] != CW_DASH_REPRESENTATION
+		    && elements[i] != CW_ELEMENT_EOC_SPACE && elements[i] != CW_ELEMENT_EOW_SPACE) {
+
+			errno = EINVAL;
+			return CW_FAILURE;
+		}
 	}
 
-	if (new_value != gen->send_speed) {
-		gen->send_speed = new_value;
+	bool is_first = true;
+	for (size_t i = 0; i < n_elements; i++) {
+		int cwret;
+		if (elements[i] == CW_ELEMENT_EOC_SPACE) {
+			cwret = cw_gen_enqueue_eoc_space_internal(gen);
+			is_first = true;
+		} else if (elements[i] == CW_ELEMENT_EOW_SPACE) {
+			cwret = cw_gen_enqueue_eow_space_internal(gen);
+			is_first = true;
+		} else {
+			/* See cw_gen_enqueue_representation_partial_internal(). */
+			if (is_first && !gen->timeline && cw_tq_length_internal(gen->tq) >= gen->tq->high_water_mark) {
+				errno = EAGAIN;
+				return CW_FAILURE;
+			}
+			cwret = cw_gen_enqueue_mark_internal(gen, elements[i], is_first);
+			is_first = false;
+		}
 
-		/* Changes of send speed require resynchronization. */
-		gen->parameters_in_sync = false;
-		cw_gen_sync_parameters_internal(gen);
+		if (!cwret) {
+			return CW_FAILURE;
+		}
 	}
 
 	return CW_SUCCESS;
@@ -1766,529 +4006,646 @@ int cw_gen_set_speed(cw_gen_t *gen, int new_value)
 
 
 /**
-   \brief Set frequency of generator
+   \brief Reset generator's essential parameters to their initial values
 
-   Set frequency of sound wave generated by generator.
-   The frequency must be within limits marked by CW_FREQUENCY_MIN
-   and CW_FREQUENCY_MAX.
+   You need to call cw_gen_sync_parameters_internal() after call to this function.
 
-   See libcw.h/CW_FREQUENCY_{INITIAL|MIN|MAX} for initial/minimal/maximal
-   value of frequency.
+  \param gen
+*/
+void cw_gen_reset_parameters_internal(cw_gen_t *gen)
+{
+	cw_assert (gen, MSG_PREFIX "generator is NULL");
 
-   \errno EINVAL - \p new_value is out of range.
+	gen->send_speed = CW_SPEED_INITIAL;
+	gen->frequency = CW_FREQUENCY_INITIAL;
+	gen->volume_percent = CW_VOLUME_INITIAL;
+	gen->volume_abs = (gen->volume_percent * CW_AUDIO_VOLUME_RANGE) / 100;
+	gen->gap = CW_GAP_INITIAL;
+	gen->weighting = CW_WEIGHTING_INITIAL;
 
-   \reviewed on 2017-01-21
+	gen->parameters_in_sync = false;
 
-   \param gen - generator for which to set new frequency
-   \param new_value - new value of frequency to be assigned to generator
+	return;
 
-   \return CW_SUCCESS on success
-   \return CW_FAILURE on failure
-*/
-int cw_gen_set_frequency(cw_gen_t *gen, int new_value)
-{
-	if (new_value < CW_FREQUENCY_MIN || new_value > CW_FREQUENCY_MAX) {
-		errno = EINVAL;
-		return CW_FAILURE;
-	} else {
-		gen->frequency = new_value;
-		return CW_SUCCESS;
-	}
 }
 
 
 
 
 /**
-   \brief Set volume of generator
+   \brief Synchronize generator's low level timing parameters
 
-   Set volume of sound wave generated by generator.
-   The volume must be within limits marked by CW_VOLUME_MIN and CW_VOLUME_MAX.
+   \param gen - generator
+*/
+void cw_gen_sync_parameters_internal(cw_gen_t *gen)
+{
+	cw_assert (gen, MSG_PREFIX "generator is NULL");
 
-   Note that volume settings are not fully possible for the console speaker.
-   In this case, volume settings greater than zero indicate console speaker
-   sound is on, and setting volume to zero will turn off console speaker
-   sound.
+	/* Do nothing if we are already synchronized. */
+	if (gen->parameters_in_sync) {
+		return;
+	}
 
-   See libcw.h/CW_VOLUME_{INITIAL|MIN|MAX} for initial/minimal/maximal
-   value of volume.
-   errno is set to EINVAL if \p new_value is out of range.
+	/* Set the length of a Dot to be a Unit with any weighting
+	   adjustment, and the length of a Dash as three Dot lengths.
+	   The weighting adjustment is by adding or subtracting a
+	   length based on 50 % as a neutral weighting. */
+	int unit_length = CW_DOT_CALIBRATION / gen->send_speed;
+	int weighting_length = (2 * (gen->weighting - 50) * unit_length) / 100;
+	gen->dot_len = unit_length + weighting_length;
+	gen->dash_len = 3 * gen->dot_len;
 
-   \param gen - generator for which to set a volume level
-   \param new_value - new value of volume to be assigned to generator
+	/* End-of-mark space length is one Unit, perhaps adjusted.
+	   End-of-character space length is three Units total.
+	   End-of-word space length is seven Units total.
 
-   \return CW_SUCCESS on success
-   \return CW_FAILURE on failure
-*/
-int cw_gen_set_volume(cw_gen_t *gen, int new_value)
-{
-	if (new_value < CW_VOLUME_MIN || new_value > CW_VOLUME_MAX) {
-		errno = EINVAL;
-		return CW_FAILURE;
-	} else {
-		gen->volume_percent = new_value;
-		gen->volume_abs = (gen->volume_percent * CW_AUDIO_VOLUME_RANGE) / 100;
+	   WARNING: notice how the eoc and eow spaces are
+	   calculated. They aren't full 3 units and 7 units. They are
+	   2 units (which takes into account preceding eom space
+	   length), and 5 units (which takes into account preceding
+	   eom *and* eoc space length). So these two lengths are
+	   *additional* ones, i.e. in addition to (already existing)
+	   eom and/or eoc space.  Whether this is good or bad idea to
+	   calculate them like this is a separate topic. Just be aware
+	   of this fact.
 
-		cw_gen_set_tone_slope(gen, -1, -1);
+	   The end-of-mark length is adjusted by 28/22 times
+	   weighting length to keep PARIS calibration correctly
+	   timed (PARIS has 22 full units, and 28 empty ones).
+	   End-of-mark and end of character delays take
+	   weightings into account. */
+	gen->eom_space_len = unit_length - (28 * weighting_length) / 22;  /* End-of-mark space, a.k.a. regular inter-mark space. */
+	gen->eoc_space_len = 3 * unit_length - gen->eom_space_len;
+	gen->eow_space_len = 7 * unit_length - gen->eoc_space_len;
+	gen->additional_space_len = gen->gap * unit_length;
 
-		return CW_SUCCESS;
+	/* For "Farnsworth", there also needs to be an adjustment
+	   delay added to the end of words, otherwise the rhythm is
+	   lost on word end.
+	   I don't know if there is an "official" value for this,
+	   but 2.33 or so times the gap is the correctly scaled
+	   value, and seems to sound okay.
+
+	   Thanks to Michael D. Ivey <ivey@gweezlebur.com> for
+	   identifying this in earlier versions of libcw. */
+	gen->adjustment_space_len = (7 * gen->additional_space_len) / 3;
+
+	/* Publish lengths of symbolic tones to generator's thread. */
+	int symbol_len[CW_TONE_SYMBOL_COUNT] = { 0 };
+	symbol_len[CW_TONE_SYMBOL_DOT] = gen->dot_len;
+	symbol_len[CW_TONE_SYMBOL_DASH] = gen->dash_len;
+	symbol_len[CW_TONE_SYMBOL_EOM_SPACE] = gen->eom_space_len;
+	symbol_len[CW_TONE_SYMBOL_EOC_SPACE] = gen->eoc_space_len + gen->additional_space_len;
+	symbol_len[CW_TONE_SYMBOL_EOW_SPACE_PART] = gen->eow_space_len / CW_GEN_EOW_SPACE_N_PARTS;
+	symbol_len[CW_TONE_SYMBOL_ADJUSTMENT_SPACE] = gen->adjustment_space_len;
+
+	pthread_mutex_lock(&gen->tq->mutex);
+	for (int symbol = 0; symbol < CW_TONE_SYMBOL_COUNT; symbol++) {
+		__atomic_store_n(&gen->symbol_len[symbol], symbol_len[symbol], __ATOMIC_RELAXED);
 	}
+	pthread_mutex_unlock(&gen->tq->mutex);
+
+	cw_debug_msg (&cw_debug_object, CW_DEBUG_PARAMETERS, CW_DEBUG_INFO,
+		      MSG_PREFIX "send usec timings <%d [wpm]>: dot: %d, dash: %d, %d, %d, %d, %d, %d",
+		      gen->send_speed, gen->dot_len, gen->dash_len,
+		      gen->eom_space_len, gen->eoc_space_len,
+		      gen->eow_space_len, gen->additional_space_len, gen->adjustment_space_len);
+
+	/* Generator parameters are now in sync. */
+	gen->parameters_in_sync = true;
+
+	return;
 }
 
 
 
 
 /**
-   \brief Set sending gap of generator
+   Helper function intended to hide details of tone queue and of
+   enqueueing a tone from cw_key module.
 
-   See libcw.h/CW_GAP_{INITIAL|MIN|MAX} for initial/minimal/maximal
-   value of gap.
-   errno is set to EINVAL if \p new_value is out of range.
+   The function should be called only on "key down" (begin mark) event
+   from hardware straight key.
 
-   \param gen - generator for which to set gap
-   \param new_value - new value of gap to be assigned to generator
+   The function is called in very specific context, see cw_key module
+   for details.
+
+   \param gen - generator
 
    \return CW_SUCCESS on success
    \return CW_FAILURE on failure
 */
-int cw_gen_set_gap(cw_gen_t *gen, int new_value)
+int cw_gen_enqueue_begin_mark_internal(cw_gen_t *gen)
 {
-	if (new_value < CW_GAP_MIN || new_value > CW_GAP_MAX) {
-		errno = EINVAL;
-		return CW_FAILURE;
+	/* In case of straight key we don't know at all how long the
+	   tone should be (we don't know for how long the straight key
+	   will be closed).
+
+	   Generator that calculates samples simply generates the tone
+	   until it gets key-up edge. */
+	if (gen->buffer) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		cw_gen_sk_publish_edge_internal(gen, true, &now);
+		return CW_SUCCESS;
+	}
+
+	/* Other generators (console, NULL) need tones.
+
+	   Let's enqueue a beginning of mark (rising slope) +
+	   "forever" (constant) tone. The constant tone will be generated
+	   until key goes into CW_KEY_STATE_OPEN state. */
+
+	cw_tone_t tone;
+	CW_TONE_INIT(&tone, gen->frequency, gen->tone_slope.len, CW_SLOPE_MODE_RISING_SLOPE);
+	int rv = cw_tq_enqueue_internal(gen->tq, &tone);
+
+	if (rv != CW_SUCCESS) {
+		cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_TONE_QUEUE, CW_DEBUG_ERROR,
+			      MSG_PREFIX "enqueue begin mark: failed to enqueue rising slope: '%s'", strerror(errno));
 	}
 
-	if (new_value != gen->gap) {
-		gen->gap = new_value;
-		/* Changes of gap require resynchronization. */
-		gen->parameters_in_sync = false;
-		cw_gen_sync_parameters_internal(gen);
+	/* If there was an error during enqueue of rising slope of
+	   mark, assume that it was a transient error, and proceed to
+	   enqueueing forever tone. Only after we fail to enqueue the
+	   "main" tone, we are allowed to return failure to caller. */
+	CW_TONE_INIT(&tone, gen->frequency, gen->quantum_len, CW_SLOPE_MODE_NO_SLOPES);
+	tone.is_forever = true;
+	rv = cw_tq_enqueue_internal(gen->tq, &tone);
+
+	if (rv != CW_SUCCESS) {
+		cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_TONE_QUEUE, CW_DEBUG_ERROR,
+			      MSG_PREFIX "enqueue begin mark: failed to enqueue forever tone: '%s'", strerror(errno));
 	}
 
-	return CW_SUCCESS;
+	cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_TONE_QUEUE, CW_DEBUG_DEBUG,
+		      MSG_PREFIX "enqueue begin mark: tone queue len = %zu", cw_tq_length_internal(gen->tq));
+
+	return rv;
 }
 
 
 
 
 /**
-   \brief Set sending weighting for generator
+   Helper function intended to hide details of tone queue and of
+   enqueueing a tone from cw_key module.
 
-   See libcw.h/CW_WEIGHTING_{INITIAL|MIN|MAX} for initial/minimal/maximal
-   value of weighting.
-   errno is set to EINVAL if \p new_value is out of range.
+   The function should be called only on "key up" (begin space) event
+   from hardware straight key.
 
-   \param gen - generator for which to set new weighting
-   \param new_value - new value of weighting to be assigned for generator
+   The function is called in very specific context, see cw_key module
+   for details.
+
+   \param gen - generator
 
    \return CW_SUCCESS on success
    \return CW_FAILURE on failure
 */
-int cw_gen_set_weighting(cw_gen_t * gen, int new_value)
+int cw_gen_enqueue_begin_space_internal(cw_gen_t *gen)
 {
-	if (new_value < CW_WEIGHTING_MIN || new_value > CW_WEIGHTING_MAX) {
-		errno = EINVAL;
-		return CW_FAILURE;
-	}
-
-	if (new_value != gen->weighting) {
-		gen->weighting = new_value;
-
-		/* Changes of weighting require resynchronization. */
-		gen->parameters_in_sync = false;
-		cw_gen_sync_parameters_internal(gen);
+	if (gen->buffer) {
+		/* Key-up edge ends tone started in
+		   cw_gen_enqueue_begin_mark_internal(). Falling slope
+		   is generated by the generator. */
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		cw_gen_sk_publish_edge_internal(gen, false, &now);
+		return CW_SUCCESS;
 	}
 
-	return CW_SUCCESS;
-}
-
-
+	if (gen->audio_system == CW_AUDIO_CONSOLE) {
+		/* FIXME: I think that enqueueing tone is not just a
+		   matter of generating it using generator, but also a
+		   matter of timing events using generator. Enqueueing
+		   tone here and dequeueing it later will be used to
+		   control state of a key. How does enqueueing a
+		   quantum tone influences the key state? */
 
 
-/**
-   \brief Get sending speed from generator
+		/* Generate just a bit of silence, just to switch
+		   buzzer from generating a sound to being silent. */
+		cw_tone_t tone;
+		CW_TONE_INIT(&tone, 0, gen->quantum_len, CW_SLOPE_MODE_NO_SLOPES);
+		return cw_tq_enqueue_internal(gen->tq, &tone);
+	} else {
+		/* For soundcards a falling slope with volume from max
+		   to zero should be enough, but... */
+		cw_tone_t tone;
+		CW_TONE_INIT(&tone, gen->frequency, gen->tone_slope.len, CW_SLOPE_MODE_FALLING_SLOPE);
+		int rv = cw_tq_enqueue_internal(gen->tq, &tone);
 
-   Returned value is in range CW_SPEED_MIN-CW_SPEED_MAX [wpm].
+		if (rv == CW_SUCCESS) {
+			/* ... but on some occasions, on some
+			   platforms, some sound systems may need to
+			   constantly generate "silent" tone. These four
+			   lines of code are just for them.
 
-   \reviewed on 2017-01-21
+			   FIXME: what occasions? what platforms? what sound systems?
 
-   \param gen - generator from which to get the parameter
+			   It would be better to avoid queueing silent
+			   "forever" tone because this increases CPU
+			   usage. It would be better to simply not to
+			   queue any new tones after "falling slope"
+			   tone. Silence after the last falling slope
+			   would simply last on itself until there is
+			   new tone in queue to dequeue. */
+			CW_TONE_INIT(&tone, 0, gen->quantum_len, CW_SLOPE_MODE_NO_SLOPES);
+			tone.is_forever = true;
+			rv = cw_tq_enqueue_internal(gen->tq, &tone);
+		}
 
-   \return current value of the generator's send speed
-*/
-int cw_gen_get_speed(const cw_gen_t * gen)
-{
-	return gen->send_speed;
+		return rv;
+	}
 }
 
 
 
 
 /**
-   \brief Get frequency from generator
+   Helper function intended to hide details of tone queue and of
+   enqueueing a tone from cw_key module.
 
-   Function returns "frequency" parameter of generator,
-   even if the generator is stopped, or volume of generated sound is zero.
+   The function should be called on hardware key events only. Since we
+   enqueue symbols, we know that they have limited, specified
+   length. This means that the function should be called for events
+   from iambic keyer.
 
-   Returned value is in range CW_FREQUENCY_MIN-CW_FREQUENCY_MAX [Hz].
+   'Partial' means without any end-of-mark spaces.
 
-   \reviewed on 2017-01-21
+   The function is called in very specific context, see cw_key module
+   for details.
 
-   \param gen - generator from which to get the parameter
+   \param gen - generator
+   \param symbol - symbol to enqueue (Space/Dot/Dash)
 
-   \return current value of generator's frequency
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
 */
-int cw_gen_get_frequency(const cw_gen_t * gen)
+int cw_gen_enqueue_partial_symbol_internal(cw_gen_t *gen, char symbol)
 {
-	return gen->frequency;
+	cw_tone_t tone = { 0 };
+
+	if (symbol == CW_DOT_REPRESENTATION) {
+		CW_TONE_INIT(&tone, gen->frequency, cw_gen_symbol_len_internal(gen, CW_TONE_SYMBOL_DOT), CW_SLOPE_MODE_STANDARD_SLOPES);
+
+	} else if (symbol == CW_DASH_REPRESENTATION) {
+		CW_TONE_INIT(&tone, gen->frequency, cw_gen_symbol_len_internal(gen, CW_TONE_SYMBOL_DASH), CW_SLOPE_MODE_STANDARD_SLOPES);
+
+	} else if (symbol == CW_SYMBOL_SPACE) {
+		CW_TONE_INIT(&tone, 0, cw_gen_symbol_len_internal(gen, CW_TONE_SYMBOL_EOM_SPACE), CW_SLOPE_MODE_NO_SLOPES);
+
+	} else {
+		cw_assert (0, MSG_PREFIX "unknown key symbol '%d'", symbol);
+	}
+
+	return cw_tq_enqueue_internal(gen->tq, &tone);
 }
 
 
 
 
 /**
-   \brief Get sound volume from generator
+   \brief Wait for generator's tone queue to drain until only as many tones as given in \p level remain queued
 
-   Function returns "volume" parameter of generator, even if the
-   generator is stopped.  Returned value is in range
-   CW_VOLUME_MIN-CW_VOLUME_MAX [%].
+   This function is for use by programs that want to optimize
+   themselves to avoid the cleanup that happens when generator's tone
+   queue drains completely. Such programs have a short time in which
+   to add more tones to the queue.
 
+   The function returns when queue's level is equal or lower than \p
+   level.  If at the time of function call the level of queue is
+   already equal or lower than \p level, function returns immediately.
 
-   \reviewed on 2017-01-21
+   Notice that generator must be running (started with cw_gen_start())
+   when this function is called, otherwise it will be waiting forever
+   for a change of tone queue's level that will never happen.
 
-   \param gen - generator from which to get the parameter
+   \reviewed on 2017-01-20
 
-   \return current value of generator's sound volume
+   \param gen - generator on which to wait
+   \param level - level in queue, at which to return
+
+   \return CW_SUCCESS
 */
-int cw_gen_get_volume(const cw_gen_t * gen)
+int cw_gen_wait_for_queue_level(cw_gen_t * gen, size_t level)
 {
-	return gen->volume_percent;
+	return cw_tq_wait_for_level_internal(gen->tq, level);
 }
 
 
 
 
 /**
-   \brief Get sending gap from generator
-
-   Returned value is in range CW_GAP_MIN-CW_GAP_MAX.
-
-   \reviewed on 2017-01-21
+   \brief Cancel all pending queued tones in a generator, and return to silence
 
-   \param gen - generator from which to get the parameter
+   If there is a tone in progress, the function will wait until this
+   last one has completed, then silence the tones.
 
-   \return current value of generator's sending gap
+   \param gen - generator to flush
 */
-int cw_gen_get_gap(const cw_gen_t * gen)
+void cw_gen_flush_queue(cw_gen_t * gen)
 {
-	return gen->gap;
+	/* Messages waiting for their time are flushed too. */
+	cw_gen_timed_clear_internal(gen);
+
+	/* This function locks and unlocks mutex. */
+	cw_tq_flush_internal(gen->tq);
+
+	/* Force silence on the speaker anyway, and stop any background
+	   soundcard tone generation. */
+	cw_gen_silence_internal(gen);
+
+	return;
 }
 
 
 
 
 /**
-   \brief Get sending weighting from generator
+   \brief Return char string with generator's audio device path/name
 
-   Returned value is in range CW_WEIGHTING_MIN-CW_WEIGHTING_MAX.
+   Returned pointer is owned by library.
 
-   \reviewed on 2017-01-21
+   \reviewed on 2017-01-20
 
-   \param gen - generator from which to get the parameter
+   \param gen
 
-   \return current value of generator's sending weighting
+   \return char string with generator's audio device path/name
 */
-int cw_gen_get_weighting(const cw_gen_t * gen)
+const char *cw_gen_get_audio_device(cw_gen_t const * gen)
 {
-	return gen->weighting;
+	cw_assert (gen, MSG_PREFIX "generator is NULL");
+	return gen->audio_device;
 }
 
 
 
 
 /**
-   \brief Get timing parameters for sending
+   \brief Get id of audio system used by given generator (one of enum cw_audio_system values)
 
-   Return the low-level timing parameters calculated from the speed,
-   gap, tolerance, and weighting set.  Units of returned parameter
-   values are microseconds.
+   You can use cw_get_audio_system_label() to get string corresponding
+   to value returned by this function.
 
-   Use NULL for the pointer argument to any parameter value not required.
+   \reviewed on 2017-01-20
 
-   \reviewed on 2017-01-21
+   \param gen - generator from which to get audio system
 
-   \param gen
-   \param dot_len
-   \param dash_len
-   \param eom_space_len
-   \param eoc_space_len
-   \param eow_space_len
-   \param additional_space_len
-   \param adjustment_space_len
+   \return audio system's id
 */
-void cw_gen_get_timing_parameters_internal(cw_gen_t *gen,
-					   int *dot_len,
-					   int *dash_len,
-					   int *eom_space_len,
-					   int *eoc_space_len,
-					   int *eow_space_len,
-					   int *additional_space_len, int *adjustment_space_len)
+int cw_gen_get_audio_system(cw_gen_t const * gen)
 {
-	cw_gen_sync_parameters_internal(gen);
+	cw_assert (gen, MSG_PREFIX "generator is NULL");
+	return gen->audio_system;
+}
 
-	if (dot_len)   { *dot_len = gen->dot_len; }
-	if (dash_len)  { *dash_len = gen->dash_len; }
 
-	if (eom_space_len)   { *eom_space_len = gen->eom_space_len; }
-	if (eoc_space_len)   { *eoc_space_len = gen->eoc_space_len; }
-	if (eow_space_len)   { *eow_space_len = gen->eow_space_len; }
 
-	if (additional_space_len)    { *additional_space_len = gen->additional_space_len; }
-	if (adjustment_space_len)    { *adjustment_space_len = gen->adjustment_space_len; }
 
-	return;
+/**
+   \reviewed on 2017-01-20
+*/
+size_t cw_gen_get_queue_length(cw_gen_t const * gen)
+{
+	return cw_tq_length_internal(gen->tq);
 }
 
 
 
 
 /**
-   \brief Enqueue a mark (Dot or Dash)
-
-   Low level primitive to enqueue a tone for mark of the given type, followed
-   by the standard inter-mark space.
+   \reviewed on 2017-01-20
+*/
+int cw_gen_register_low_level_callback(cw_gen_t * gen, cw_queue_low_callback_t callback_func, void * callback_arg, size_t level)
+{
+	return cw_tq_register_low_level_callback_internal(gen->tq, callback_func, callback_arg, level);
+}
 
-   Function sets errno to EINVAL if an argument is invalid, and
-   returns CW_FAILURE.
 
-   Function also returns CW_FAILURE if adding the element to queue of
-   tones failed.
 
-   \param gen - generator to be used to enqueue a mark and inter-mark space
-   \param mark - mark to send: Dot (CW_DOT_REPRESENTATION) or Dash (CW_DASH_REPRESENTATION)
-   \param is_first - is it a first mark in a character?
 
-   \return CW_FAILURE on failure
-   \return CW_SUCCESS on success
-*/
-int cw_gen_enqueue_mark_internal(cw_gen_t *gen, char mark, bool is_first)
+int cw_gen_wait_for_tone(cw_gen_t * gen)
 {
-	int status;
+	return cw_tq_wait_for_tone_internal(gen->tq);
+}
 
-	/* Synchronize low-level timings if required. */
-	cw_gen_sync_parameters_internal(gen);
-	/* TODO: do we need to synchronize here receiver as well? */
 
-	/* Send either a dot or a dash mark, depending on representation. */
-	if (mark == CW_DOT_REPRESENTATION) {
-		cw_tone_t tone;
-		CW_TONE_INIT(&tone, gen->frequency, gen->dot_len, CW_SLOPE_MODE_STANDARD_SLOPES);
-		tone.is_first = is_first;
-		status = cw_tq_enqueue_internal(gen->tq, &tone);
-	} else if (mark == CW_DASH_REPRESENTATION) {
-		cw_tone_t tone;
-		CW_TONE_INIT(&tone, gen->frequency, gen->dash_len, CW_SLOPE_MODE_STANDARD_SLOPES);
-		tone.is_first = is_first;
-		status = cw_tq_enqueue_internal(gen->tq, &tone);
-	} else {
-		errno = EINVAL;
-		status = CW_FAILURE;
-	}
 
-	if (CW_SUCCESS != status) {
-		return CW_FAILURE;
-	}
 
-	/* Send the inter-mark space. */
-	cw_tone_t tone;
-	CW_TONE_INIT(&tone, 0, gen->eom_space_len, CW_SLOPE_MODE_NO_SLOPES);
-	if (CW_SUCCESS != cw_tq_enqueue_internal(gen->tq, &tone)) {
-		return CW_FAILURE;
-	} else {
-		return CW_SUCCESS;
-	}
+/**
+   \reviewed on 2017-01-20
+*/
+bool cw_gen_is_queue_full(cw_gen_t const * gen)
+{
+	return cw_tq_is_full_internal(gen->tq);
 }
 
 
 
 
 /**
-   \brief Enqueue inter-character space
+   \brief Set descriptor notified by generator's thread
 
-   The function enqueues space of length 2 Units. The function is
-   intended to be used after inter-mark space has already been enqueued.
+   After each tone played from tone queue, and after the queue has
+   been drained, generator's thread writes a single byte to \p fd.
+   Client code may poll() read end of the descriptor to learn that
+   state of generator (queue length, cw_gen_is_playing()) may have
+   changed, without waiting for the generator in a separate thread.
 
-   In such situation standard inter-mark space (one Unit) and two
-   Units enqueued by this function form a full standard
-   inter-character space (three Units).
+   \p fd should be a write end of a non-blocking pipe: if the pipe
+   is full, the byte is dropped (the pipe is readable anyway).
 
-   Inter-character adjustment space is added at the end.
+   Pass -1 to stop notifications.
 
-   \param gen
+   \errno EINVAL - invalid descriptor
+
+   \param gen - generator
+   \param fd - file descriptor, or -1
 
    \return CW_SUCCESS on success
    \return CW_FAILURE on failure
 */
-int cw_gen_enqueue_eoc_space_internal(cw_gen_t *gen)
+int cw_gen_set_notification_fd(cw_gen_t * gen, int fd)
 {
-	/* Synchronize low-level timing parameters. */
-	cw_gen_sync_parameters_internal(gen);
+	if (fd < -1) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
 
-	/* Enqueue standard inter-character space, plus any additional inter-character gap. */
-	cw_tone_t tone;
-	CW_TONE_INIT(&tone, 0, gen->eoc_space_len + gen->additional_space_len, CW_SLOPE_MODE_NO_SLOPES);
-	return cw_tq_enqueue_internal(gen->tq, &tone);
+	__atomic_store_n(&gen->notification_fd, fd, __ATOMIC_RELEASE);
+
+	return CW_SUCCESS;
 }
 
 
 
 
 /**
-   \brief Enqueue space character (' ') in generator, to be sent using Morse code
+   \brief Check if generator is still playing enqueued tones
 
-   The function should be used to enqueue a regular ' ' character.
+   Unlike checking length of tone queue, this function returns true
+   also while last tone from the queue is being played.
 
-   The function enqueues space of length 5 Units. The function is
-   intended to be used after inter-mark space and inter-character
-   space have already been enqueued.
+   \param gen - generator
 
-   In such situation standard inter-mark space (one Unit) and
-   inter-character space (two Units) and regular space (five units)
-   form a full standard inter-word space (seven Units).
+   \return true if generator has enqueued tones that were not played yet
+   \return false otherwise
+*/
+bool cw_gen_is_playing(cw_gen_t const * gen)
+{
+	return __atomic_load_n(&gen->is_playing, __ATOMIC_ACQUIRE);
+}
 
-   Inter-word adjustment space is added at the end.
 
-   \param gen
 
-   \return CW_SUCCESS on success
-   \return CW_FAILURE on failure
-*/
-int cw_gen_enqueue_eow_space_internal(cw_gen_t *gen)
-{
-	/* Synchronize low-level timing parameters. */
-	cw_gen_sync_parameters_internal(gen);
 
-	/* Send silence for the word delay period, plus any adjustment
-	   that may be needed at end of word. Make it in two tones,
-	   and here is why.
+/**
+   \brief Notify client code about change of state of generator
 
-	   Let's say that 'tone queue low watermark' is one element
-	   (i.e. one tone).
+   \param gen - generator
+*/
+void cw_gen_notify_internal(cw_gen_t * gen)
+{
+	const int fd = __atomic_load_n(&gen->notification_fd, __ATOMIC_ACQUIRE);
+	if (fd < 0) {
+		return;
+	}
 
-	   In order for tone queue to recognize that a 'low tone
-	   queue' callback needs to be called, the level in tq needs
-	   to drop from 2 to 1.
+	const char byte = 0;
+	if (-1 == write(fd, &byte, 1)) {
+		/* Full pipe is readable anyway. */
+		;
+	}
 
-	   Almost every queued character guarantees that there will be
-	   at least two tones, e.g for 'E' it is dash + following
-	   space. But what about a ' ' character?
+	return;
+}
 
-	   If we enqueue ' ' character as single tone, there is only one
-	   tone in tone queue, and the tone queue manager can't
-	   recognize when the level drops from 2 to 1 (and thus the
-	   'low level' callback won't be called).
 
-	   If we enqueue ' ' character as two separate tones (as we do
-	   this in this function), the tone queue manager can
-	   recognize level dropping from 2 to 1. Then the passing of
-	   critical level can be noticed, and "low level" callback can
-	   be called.
 
-	   BUT: Sometimes the first tone is dequeued before/during the
-	   second one is enqueued, and we can't recognize 2->1 event.
 
-	   So, to be super-sure that there is a recognizable event of
-	   passing tone queue level from 2 to 1, we split the inter-word
-	   space into N parts and enqueue them. This way we have N + 1
-	   tones per space, and client applications that rely on low
-	   level threshold == 1 can correctly work when enqueueing
-	   spaces.
+/**
+   \brief Mark generator as no longer playing if tone queue is empty
 
-	   At 60 wpm length of gen->eow_space_len is 100000 [us], so
-	   it's large enough to safely divide it by small integer
-	   value. */
+   Called by generator's thread when there is nothing more to play.
 
-	int enqueued = 0;
+   \param gen - generator
+*/
+void cw_gen_drained_internal(cw_gen_t * gen)
+{
+	bool changed = false;
 
-	cw_tone_t tone;
-#if 0
-	/* This section is incorrect. Enable this section only for
-	   tests.  This section "implements" a bug that was present in
-	   libcw until version 6.4.1 and that is now tested by
-	   src/libcw/tests/libcw_test_tq_short_space.c */
-	const int n = 1; /* No division. Old situation causing an error in
-		      client applications. */
-#else
-	const int n = 2; /* "small integer value" - used to have more tones per eow space. */
-#endif
-	CW_TONE_INIT(&tone, 0, gen->eow_space_len / n, CW_SLOPE_MODE_NO_SLOPES);
-	for (int i = 0; i < n; i++) {
-		if (CW_SUCCESS != cw_tq_enqueue_internal(gen->tq, &tone)) {
-			return CW_FAILURE;
-		}
-		enqueued++;
+	pthread_mutex_lock(&gen->tq->mutex);
+	if (0 == gen->tq->len && __atomic_load_n(&gen->is_playing, __ATOMIC_ACQUIRE)) {
+		__atomic_store_n(&gen->is_playing, false, __ATOMIC_RELEASE);
+		changed = true;
 	}
+	pthread_mutex_unlock(&gen->tq->mutex);
 
-	CW_TONE_INIT(&tone, 0, gen->adjustment_space_len, CW_SLOPE_MODE_NO_SLOPES);
-	if (CW_SUCCESS != cw_tq_enqueue_internal(gen->tq, &tone)) {
-		return CW_FAILURE;
+	if (changed) {
+		cw_gen_notify_internal(gen);
 	}
-	enqueued++;
 
-	cw_debug_msg (&cw_debug_object, CW_DEBUG_GENERATOR, CW_DEBUG_DEBUG, MSG_PREFIX "enqueued %d tones per iw space, tq len = %zu", enqueued, cw_tq_length_internal(gen->tq));
+	return;
+}
 
-	return CW_SUCCESS;
+
+
+
+/**
+   \brief Get current time of CLOCK_MONOTONIC clock
+
+   \return current time [ns]
+*/
+static int64_t cw_gen_monotonic_now_internal(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t) now.tv_sec * CW_NSECS_PER_SEC + now.tv_nsec;
 }
 
 
 
 
 /**
-   \brief Enqueue the given representation in generator, to be sent using Morse code
+   \brief Enqueue text to be played at given time
 
-   Function enqueues given \p representation using given \p generator.
-   *Every* mark from the \p representation is followed by a standard
-   inter-mark space.
+   Enqueue \p text in \p gen, so that first sample of the text is
+   played by audio sink at time \p when of clock \p clock. Time of
+   CLOCK_REALTIME clock is converted to CLOCK_MONOTONIC time during the
+   call, so later adjustments of system time don't affect the message.
 
-   Representation is not validated by this function.
+   The text waits in generator until it is about to start. Then, if
+   generator's tone queue is empty, the generator enqueues silence of
+   exactly calculated length, followed by the text. The length of
+   silence takes into account the delay reported by audio sink and
+   samples of previous tone that haven't been written to the sink
+   yet. Text that is due while tone queue is still busy with other
+   tones is enqueued as soon as the queue becomes empty, so it will
+   start late.
 
-   _partial_ in function's name means that the inter-character space is
-   not appended at the end of Marks and Spaces enqueued in generator
-   (but the last inter-mark space is).
+   Any number of messages can wait for their time in the generator.
+   Messages with the same time are played in order of enqueueing.
+   cw_gen_flush_queue() removes the waiting messages.
 
-   \errno EAGAIN - there is not enough space in tone queue to enqueue
-   \p representation.
+   Generators driven by session scheduler (see libcw_sched.c) don't
+   play in real time, and can't be used with this function.
 
-   \reviewed on 2017-01-21
+   \errno EINVAL - invalid \p clock, or \p gen is driven by session scheduler
+   \errno ENOENT - \p text is invalid
+   \errno ENOMEM - failed to allocate memory for the message
 
-   \param gen - generator used to enqueue the representation
-   \param representation - representation to enqueue
+   \param gen - generator
+   \param text - text to enqueue
+   \param clock - CLOCK_MONOTONIC or CLOCK_REALTIME
+   \param when - time of start of the text
 
-   \return CW_FAILURE on failure
    \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
 */
-int cw_gen_enqueue_representation_partial_internal(cw_gen_t *gen, const char *representation)
+int cw_gen_enqueue_at(cw_gen_t * gen, const char * text, clockid_t clock, const struct timespec * when)
 {
-	/* Before we let this representation loose on tone generation,
-	   we'd really like to know that all of its tones will get queued
-	   up successfully.  The right way to do this is to calculate the
-	   number of tones in our representation, then check that the space
-	   exists in the tone queue. However, since the queue is comfortably
-	   long, we can get away with just looking for a high water mark.  */
-	if (cw_tq_length_internal(gen->tq) >= gen->tq->high_water_mark) {
-		errno = EAGAIN;
+	if (gen->render.is_external
+	    || (clock != CLOCK_MONOTONIC && clock != CLOCK_REALTIME)) {
+
+		errno = EINVAL;
 		return CW_FAILURE;
 	}
 
-	/* Enqueue the marks. Every mark is followed by inter-mark
-	   space. */
-	for (int i = 0; representation[i] != '\0'; i++) {
-		if (!cw_gen_enqueue_mark_internal(gen, representation[i], i == 0)) {
-			return CW_FAILURE;
-		}
+	if (!cw_string_is_valid(text)) {
+		errno = ENOENT;
+		return CW_FAILURE;
 	}
 
-	/* No inter-character space added here. */
+	cw_gen_timed_t item;
+	item.start = (int64_t) when->tv_sec * CW_NSECS_PER_SEC + when->tv_nsec;
+	if (clock == CLOCK_REALTIME) {
+		struct timespec now;
+		clock_gettime(CLOCK_REALTIME, &now);
+		item.start += cw_gen_monotonic_now_internal() - ((int64_t) now.tv_sec * CW_NSECS_PER_SEC + now.tv_nsec);
+	}
+	item.text = strdup(text);
+	if (!item.text) {
+		errno = ENOMEM;
+		return CW_FAILURE;
+	}
+
+	pthread_mutex_lock(&gen->timed.mutex);
+	item.sequence = gen->timed.sequence++;
+	const int rv = cw_gen_timed_push_internal(gen, &item);
+	pthread_mutex_unlock(&gen->timed.mutex);
+
+	if (CW_SUCCESS != rv) {
+		free(item.text);
+		errno = ENOMEM;
+		return CW_FAILURE;
+	}
+
+	/* Generator's thread may be idle, waiting for a tone or for
+	   time of a message that starts later than this one. */
+	pthread_mutex_lock(&gen->tq->dequeue_mutex);
+	pthread_cond_signal(&gen->tq->dequeue_var);
+	pthread_mutex_unlock(&gen->tq->dequeue_mutex);
 
 	return CW_SUCCESS;
 }
@@ -2297,61 +4654,53 @@ int cw_gen_enqueue_representation_partial_internal(cw_gen_t *gen, const char *re
 
 
 /**
-   \brief Enqueue a given valid ASCII character in generator, to be sent using Morse code
+   \brief Compare order of two messages waiting for their time
 
-   _valid_character_ in function's name means that the function
-   expects the character \p c to be valid (\p c should be validated by
-   caller before passing it to the function).
+   \return true if \p a should be played before \p b
+*/
+static bool cw_gen_timed_is_before_internal(const cw_gen_timed_t * a, const cw_gen_timed_t * b)
+{
+	return a->start < b->start
+		|| (a->start == b->start && a->sequence < b->sequence);
+}
 
-   _partial_ in function's name means that the inter-character space is
-   not appended at the end of Marks and Spaces enqueued in generator
-   (but the last inter-mark space is).
 
-   \errno ENOENT - character \p c is not a recognized character.
 
-   \reviewed on 2017-01-21
 
-   \param gen - generator to be used to enqueue character
-   \param character - character to enqueue
+/**
+   \brief Add message to heap of messages waiting for their time
+
+   Call the function with gen->timed.mutex locked.
+
+   \param gen - generator
+   \param item - message to add
 
    \return CW_SUCCESS on success
-   \return CW_FAILURE on failure
+   \return CW_FAILURE on failure to allocate memory
 */
-int cw_gen_enqueue_valid_character_partial_internal(cw_gen_t *gen, char character)
+int cw_gen_timed_push_internal(cw_gen_t * gen, const cw_gen_timed_t * item)
 {
-	if (!gen) {
-		cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_GENERATOR, CW_DEBUG_ERROR,
-			      MSG_PREFIX "no generator available");
-		return CW_FAILURE;
-	}
-
-	/* ' ' character (i.e. regular space) is a special case. */
-	if (character == ' ') {
-		return cw_gen_enqueue_eow_space_internal(gen);
-	}
-
-	/* backspace character (0x08) is also a special case. */
-	if (character == '\b') {
-		cw_tq_handle_backspace_internal(gen->tq);
-		return CW_SUCCESS;
-	}
-
-	const char *representation = cw_character_to_representation_internal(character);
-
-	/* This shouldn't happen since we are in _valid_character_ function... */
-	cw_assert (representation, MSG_PREFIX "failed to find representation for character '%c'/%hhx", character, character);
-
-	/* ... but fail gracefully anyway. */
-	if (!representation) {
-		errno = ENOENT;
-		return CW_FAILURE;
+	if (gen->timed.n_items == gen->timed.capacity) {
+		const size_t capacity = gen->timed.capacity ? 2 * gen->timed.capacity : 16;
+		cw_gen_timed_t * items = (cw_gen_timed_t *) realloc(gen->timed.items, capacity * sizeof (cw_gen_timed_t));
+		if (!items) {
+			return CW_FAILURE;
+		}
+		gen->timed.items = items;
+		gen->timed.capacity = capacity;
 	}
 
-	if (!cw_gen_enqueue_representation_partial_internal(gen, representation)) {
-		return CW_FAILURE;
+	cw_gen_timed_t * items = gen->timed.items;
+	size_t i = gen->timed.n_items++;
+	while (i > 0) {
+		const size_t parent = (i - 1) / 2;
+		if (!cw_gen_timed_is_before_internal(item, &items[parent])) {
+			break;
+		}
+		items[i] = items[parent];
+		i = parent;
 	}
-
-	/* No inter-character space here. */
+	items[i] = *item;
 
 	return CW_SUCCESS;
 }
@@ -2360,286 +4709,411 @@ int cw_gen_enqueue_valid_character_partial_internal(cw_gen_t *gen, char characte
 
 
 /**
-   \brief Enqueue a given valid ASCII character in generator, to be sent using Morse code
-
-   After enqueueing last Mark (Dot or Dash) comprising a character, an
-   inter-mark space is enqueued.  Inter-character space is enqueued
-   after that last inter-mark space.
-
-   _valid_character_ in function's name means that the function
-   expects the character \p c to be valid (\p c should be validated by
-   caller before passing it to the function).
-
-   \errno ENOENT - character \p c is not a recognized character.
+   \brief Remove first message from heap of messages waiting for their time
 
-   \reviewed on 2017-01-20
-
-   \param gen - generator to be used to enqueue character
-   \param c - character to enqueue
+   Call the function with gen->timed.mutex locked, and only when the
+   heap is not empty.
 
-   \return CW_SUCCESS on success
-   \return CW_FAILURE on failure
+   \param gen - generator
+   \param item - output, removed message
 */
-int cw_gen_enqueue_valid_character_internal(cw_gen_t *gen, char c)
+void cw_gen_timed_pop_internal(cw_gen_t * gen, cw_gen_timed_t * item)
 {
-	if (!cw_gen_enqueue_valid_character_partial_internal(gen, c)) {
-		return CW_FAILURE;
+	cw_gen_timed_t * items = gen->timed.items;
+	*item = items[0];
+
+	const cw_gen_timed_t last = items[--gen->timed.n_items];
+	const size_t n = gen->timed.n_items;
+	size_t i = 0;
+	while (true) {
+		size_t child = 2 * i + 1;
+		if (child >= n) {
+			break;
+		}
+		if (child + 1 < n && cw_gen_timed_is_before_internal(&items[child + 1], &items[child])) {
+			child++;
+		}
+		if (!cw_gen_timed_is_before_internal(&items[child], &last)) {
+			break;
+		}
+		items[i] = items[child];
+		i = child;
 	}
-
-	if (!cw_gen_enqueue_eoc_space_internal(gen)) {
-		return CW_FAILURE;
+	if (n) {
+		items[i] = last;
 	}
 
-	return CW_SUCCESS;
+	return;
 }
 
 
 
 
 /**
-   \brief Enqueue a given ASCII character in generator, to be sent using Morse code
+   \brief Remove all messages waiting for their time
 
-   Inter-mark + inter-character delay is appended at the end of
-   enqueued Marks.
+   \param gen - generator
+*/
+void cw_gen_timed_clear_internal(cw_gen_t * gen)
+{
+	pthread_mutex_lock(&gen->timed.mutex);
+	for (size_t i = 0; i < gen->timed.n_items; i++) {
+		free(gen->timed.items[i].text);
+	}
+	gen->timed.n_items = 0;
+	pthread_mutex_unlock(&gen->timed.mutex);
 
-   \errno ENOENT - the given character \p c is not a valid Morse
-   character.
+	return;
+}
 
-   \errno EBUSY - generator's audio sink or keying system is busy.
 
-   \errno EAGAIN - generator's tone queue is full, or there is
-   insufficient space to queue the tones for the character.
 
-   This routine returns as soon as the character and trailing spaces
-   (inter-mark and inter-character spaces) have been successfully
-   queued for sending/playing by the generator, without waiting for
-   generator to even start playing the character.  The actual sending
-   happens in background processing. See cw_gen_wait_for_tone() and
-   cw_gen_wait_for_queue_level() for ways to check the progress of
-   sending.
 
-   \reviewed on 2017-01-20
+/**
+   \brief Calculate silence needed before first waiting message
 
-   \param gen - generator to enqueue the character to
-   \param c - character to enqueue in generator
+   Calculate length of silence that needs to be enqueued now in empty
+   tone queue, so that first sample of the first waiting message is
+   played at its time. Delay of audio sink, samples that are still
+   in generator's buffer, and delay of resampler (if samples are
+   resampled) are taken into account.
 
-   \return CW_SUCCESS on success
-   \return CW_FAILURE on failure
+   Call the function with gen->timed.mutex locked, and only when
+   there are waiting messages.
+
+   \param gen - generator
+
+   \return length of silence [us], negative if the message is late
 */
-int cw_gen_enqueue_character(cw_gen_t * gen, char c)
+int64_t cw_gen_timed_lead_internal(cw_gen_t * gen)
 {
-	if (!cw_character_is_valid(c)) {
-		errno = ENOENT;
-		return CW_FAILURE;
+	int64_t lead = (gen->timed.items[0].start - cw_gen_monotonic_now_internal()) / 1000;
+
+	if (gen->get_delay && gen->audio_device_is_open) {
+		const int64_t delay = gen->get_delay(gen);
+		if (delay > 0) {
+			lead -= delay;
+		}
 	}
 
-	/* This function adds eoc space at the end of character. */
-	if (!cw_gen_enqueue_valid_character_internal(gen, c)) {
-		return CW_FAILURE;
+	if (gen->buffer && gen->sample_rate > 0) {
+		/* Samples of last tone that wait in buffer for
+		   buffer to be filled. */
+		lead -= (int64_t) gen->buffer_sub_start * CW_USECS_PER_SEC / gen->sample_rate;
 	}
 
-	return CW_SUCCESS;
+	if (gen->sink.resampler) {
+		/* Resampled samples that wait for buffer of audio
+		   sink to be filled, and delay of resampler's
+		   filter. */
+		lead -= (int64_t) gen->sink.buffer_fill * CW_USECS_PER_SEC / gen->sink.sample_rate;
+		lead -= cw_resampler_get_delay(gen->sink.resampler);
+	}
+
+	return lead;
 }
 
 
 
 
 /**
-   \brief Enqueue a given ASCII character in generator, to be sent using Morse code
+   \brief Get time until first waiting message needs to be dispatched
 
-   "partial" means that the inter-character space is not appended at
-   the end of Marks and Spaces enqueued in generator (but the last
-   inter-mark space is). This enables the formation of combination
-   characters by client code.
+   \param gen - generator
 
-   This routine returns as soon as the character has been successfully
-   queued for sending/playing by the generator, without waiting for
-   generator to even start playing the character. The actual sending
-   happens in background processing.  See cw_gen_wait_for_tone() and
-   cw_gen_wait_for_queue() for ways to check the progress of sending.
+   \return time [us] after which cw_gen_timed_dispatch_internal() should be called (zero if it should be called now)
+   \return -1 if there are no waiting messages
+*/
+int64_t cw_gen_timed_timeout_internal(cw_gen_t * gen)
+{
+	int64_t timeout = -1;
 
-   \reviewed on 2017-01-20
+	pthread_mutex_lock(&gen->timed.mutex);
+	if (gen->timed.n_items) {
+		timeout = cw_gen_timed_lead_internal(gen) - CW_GEN_TIMED_HORIZON;
+		if (timeout < 0) {
+			timeout = 0;
+		}
+	}
+	pthread_mutex_unlock(&gen->timed.mutex);
 
-   \errno ENOENT - given character \p c is not a valid Morse
-   character.
+	return timeout;
+}
 
-   \errno EBUSY - generator's audio sink or keying system is busy.
 
-   \errno EAGAIN - generator's tone queue is full, or there is
-   insufficient space to queue the tones for the character.
 
-   \param gen - generator to use
-   \param c - character to enqueue
 
-   \return CW_SUCCESS on success
-   \return CW_FAILURE on failure
+/**
+   \brief Move first waiting message to tone queue if it's about to start
+
+   If tone queue is empty and first waiting message starts soon,
+   enqueue silence of calculated length followed by the message.
+
+   \param gen - generator
+
+   \return true if a message has been dispatched
+   \return false otherwise
 */
-int cw_gen_enqueue_character_partial(cw_gen_t *gen, char c)
+bool cw_gen_timed_dispatch_internal(cw_gen_t * gen)
 {
-	if (!cw_character_is_valid(c)) {
-		errno = ENOENT;
-		return CW_FAILURE;
+	if (0 != cw_tq_length_internal(gen->tq)) {
+		/* Silence before the message can be calculated only
+		   for empty queue. */
+		return false;
 	}
 
-	if (!cw_gen_enqueue_valid_character_partial_internal(gen, c)) {
-		return CW_FAILURE;
+	pthread_mutex_lock(&gen->timed.mutex);
+	if (!gen->timed.n_items) {
+		pthread_mutex_unlock(&gen->timed.mutex);
+		return false;
+	}
+	const int64_t lead = cw_gen_timed_lead_internal(gen);
+	if (lead > CW_GEN_TIMED_HORIZON) {
+		pthread_mutex_unlock(&gen->timed.mutex);
+		return false;
 	}
+	cw_gen_timed_t item;
+	cw_gen_timed_pop_internal(gen, &item);
+	pthread_mutex_unlock(&gen->timed.mutex);
 
-	/* _partial(): don't enqueue eoc space. */
+	if (lead > 0) {
+		cw_tone_t tone;
+		CW_TONE_INIT(&tone, 0, (int) lead, CW_SLOPE_MODE_NO_SLOPES);
+		cw_tq_enqueue_internal(gen->tq, &tone);
+	} else {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_GENERATOR, CW_DEBUG_WARNING,
+			      MSG_PREFIX "timed message: late by %"PRId64" us", -lead);
+	}
 
-	return CW_SUCCESS;
+	if (CW_SUCCESS != cw_gen_enqueue_string(gen, item.text)) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_GENERATOR, CW_DEBUG_ERROR,
+			      MSG_PREFIX "timed message: failed to enqueue text: %s", strerror(errno));
+	}
+	free(item.text);
+
+	return true;
 }
 
 
 
 
 /**
-   \brief Enqueue a given ASCII string in generator, to be sent using Morse code
+   \brief Enable or disable schedule of key edges
+
+   When enabled, generator publishes key-down and key-up edges that
+   it will produce when playing tones from its tone queue, together
+   with projected (absolute, CLOCK_MONOTONIC) times of the edges. The
+   edges are published as soon as tones are enqueued, long before
+   the tones are played, so that client's code can read them with
+   cw_gen_get_key_edge() and drive keying hardware with a precise
+   timer instead of relying on callbacks registered with
+   cw_register_keying_callback(), which are called when tones are
+   dequeued.
+
+   The times are projected from time of enqueueing, lengths of tones,
+   and delay of audio sink. Flushing of tone queue or removal of last
+   character from it starts a new epoch of the schedule: edges of
+   previous epoch that haven't been read are discarded, and remaining
+   tones are published again.
+
+   Lengths of tones enqueued in symbolic mode (see
+   cw_gen_set_symbolic_enqueue()) are projected with timing
+   parameters that generator has at the time of enqueueing.
+
+   Enable the schedule before enqueueing tones.
 
-   For safety, clients can ensure the tone queue is empty before
-   queueing a string, or use cw_gen_enqueue_character() if they
-   need finer control.
+   \param gen - generator
+   \param enable - enable or disable the schedule
+*/
+void cw_gen_enable_key_edges(cw_gen_t * gen, bool enable)
+{
+	pthread_mutex_lock(&gen->tq->mutex);
+	if (enable && !gen->key_edges.is_enabled) {
+		__atomic_store_n(&gen->key_edges.epoch, gen->key_edges.epoch + 1, __ATOMIC_RELEASE);
+		gen->key_edges.cursor = cw_gen_monotonic_now_internal();
+		gen->key_edges.key_value = CW_KEY_STATE_OPEN;
+		gen->key_edges.is_enabled = true;
+		cw_gen_key_edges_publish_queue_internal(gen, gen->tq->head, gen->tq->len, cw_gen_key_edges_earliest_internal(gen));
+	} else {
+		gen->key_edges.is_enabled = enable;
+	}
+	pthread_mutex_unlock(&gen->tq->mutex);
 
-   This routine returns as soon as the string has been successfully
-   queued for sending/playing by the generator, without waiting for
-   generator to even start playing the string. The actual
-   playing/sending happens in background. See cw_gen_wait_for_tone()
-   and cw_gen_wait_for_queue() for ways to check the progress of
-   sending.
+	return;
+}
 
 
-   \errno ENOENT - \p string argument is invalid (one or more
-   characters in the string is not a valid Morse character). No tones
-   from such string are going to be enqueued.
 
-   \errno EBUSY  - generator's audio sink or keying system is busy
 
-   \errno EAGAIN - generator's tone queue is full or the tone queue
-   is likely to run out of space part way through queueing the string.
-   However, an indeterminate number of the characters from the string
-   will have already been queued.
+/**
+   \brief Get next edge from schedule of key edges
 
-   \param gen - generator to use
-   \param string - string to enqueue
+   Get oldest edge, that hasn't been read yet, from schedule of key
+   edges (see cw_gen_enable_key_edges()). The function doesn't block
+   and doesn't lock any mutex. Only one thread may read the edges.
 
-   \return CW_SUCCESS on success
-   \return CW_FAILURE on failure
+   \errno EAGAIN - there are no edges to read
+
+   \param gen - generator
+   \param edge - output, the edge
+
+   \return CW_SUCCESS if an edge has been read
+   \return CW_FAILURE otherwise
 */
-int cw_gen_enqueue_string(cw_gen_t * gen, const char * string)
+int cw_gen_get_key_edge(cw_gen_t * gen, cw_key_edge_t * edge)
 {
-	/* Check that the string is composed of valid characters. */
-	if (!cw_string_is_valid(string)) {
-		errno = ENOENT;
-		return CW_FAILURE;
-	}
+	uint32_t tail = gen->key_edges.tail;
 
-	/* Send every character in the string. */
-	for (int i = 0; string[i] != '\0'; i++) {
-		/* This function adds eoc space at the end of character. */
-		if (!cw_gen_enqueue_valid_character_internal(gen, string[i])) {
+	while (true) {
+		const uint32_t head = __atomic_load_n(&gen->key_edges.head, __ATOMIC_ACQUIRE);
+		if (tail == head) {
+			__atomic_store_n(&gen->key_edges.tail, tail, __ATOMIC_RELEASE);
+			errno = EAGAIN;
 			return CW_FAILURE;
 		}
+
+		*edge = gen->key_edges.ring[tail & (CW_GEN_KEY_EDGES_CAPACITY - 1)];
+		tail++;
+
+		if (edge->epoch == __atomic_load_n(&gen->key_edges.epoch, __ATOMIC_ACQUIRE)) {
+			__atomic_store_n(&gen->key_edges.tail, tail, __ATOMIC_RELEASE);
+			return CW_SUCCESS;
+		}
+		/* Edge has been superseded, skip it. */
 	}
+}
 
-	return CW_SUCCESS;
+
+
+
+/**
+   \brief Get count of key edges that didn't fit in schedule
+
+   Edges are dropped when client's code doesn't read them fast enough
+   and the ring of edges is full.
+
+   \param gen - generator
+
+   \return count of dropped edges
+*/
+unsigned int cw_gen_get_key_edges_dropped(cw_gen_t const * gen)
+{
+	return __atomic_load_n(&gen->key_edges.n_dropped, __ATOMIC_RELAXED);
 }
 
 
 
 
 /**
-   \brief Reset generator's essential parameters to their initial values
+   \brief Publish key edge in schedule of key edges
 
-   You need to call cw_gen_sync_parameters_internal() after call to this function.
+   Call the function with gen->tq->mutex locked.
 
-  \param gen
+   \param gen - generator
+   \param time - time of edge [ns]
+   \param key_value - key value after the edge
 */
-void cw_gen_reset_parameters_internal(cw_gen_t *gen)
+void cw_gen_key_edges_push_internal(cw_gen_t * gen, int64_t time, int key_value)
 {
-	cw_assert (gen, MSG_PREFIX "generator is NULL");
+	const uint32_t head = gen->key_edges.head;
+	const uint32_t tail = __atomic_load_n(&gen->key_edges.tail, __ATOMIC_ACQUIRE);
+	if (head - tail == CW_GEN_KEY_EDGES_CAPACITY) {
+		__atomic_add_fetch(&gen->key_edges.n_dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
 
-	gen->send_speed = CW_SPEED_INITIAL;
-	gen->frequency = CW_FREQUENCY_INITIAL;
-	gen->volume_percent = CW_VOLUME_INITIAL;
-	gen->volume_abs = (gen->volume_percent * CW_AUDIO_VOLUME_RANGE) / 100;
-	gen->gap = CW_GAP_INITIAL;
-	gen->weighting = CW_WEIGHTING_INITIAL;
+	cw_key_edge_t * edge = &gen->key_edges.ring[head & (CW_GEN_KEY_EDGES_CAPACITY - 1)];
+	edge->time = time;
+	edge->key_value = key_value;
+	edge->epoch = gen->key_edges.epoch;
 
-	gen->parameters_in_sync = false;
+	__atomic_store_n(&gen->key_edges.head, head + 1, __ATOMIC_RELEASE);
 
 	return;
+}
+
+
+
+
+/**
+   \brief Get earliest time at which tone enqueued now can be played
+
+   \param gen - generator
 
+   \return time [ns]
+*/
+int64_t cw_gen_key_edges_earliest_internal(cw_gen_t * gen)
+{
+	const int64_t delay = __atomic_load_n(&gen->key_edges.sink_delay, __ATOMIC_RELAXED);
+	return cw_gen_monotonic_now_internal() + (delay > 0 ? delay * 1000 : 0);
 }
 
 
 
 
 /**
-   \brief Synchronize generator's low level timing parameters
+   \brief Publish edges of tones in given range of tone queue
+
+   Edges are projected from time of end of previously published tone
+   (or from now, if previously published tones will have been played
+   before the tones from the range).
+
+   Call the function with gen->tq->mutex locked.
 
    \param gen - generator
+   \param idx - index of first tone in the range
+   \param n_tones - count of tones in the range
+   \param earliest - time before which tones enqueued now can't be played [ns]
 */
-void cw_gen_sync_parameters_internal(cw_gen_t *gen)
+void cw_gen_key_edges_publish_queue_internal(cw_gen_t * gen, size_t idx, size_t n_tones, int64_t earliest)
 {
-	cw_assert (gen, MSG_PREFIX "generator is NULL");
+	for (; n_tones > 0; idx = (idx + 1) % gen->tq->capacity, n_tones--) {
+		cw_tone_t tone;
+		CW_TONE_COPY(&tone, &gen->tq->queue[idx]);
+		cw_gen_resolve_tone_len_internal(gen, &tone);
+
+		if (gen->key_edges.cursor < earliest) {
+			/* Tone queue will have been emptied before the
+			   tone is played. Generator opens the key when
+			   there are no tones to play. */
+			if (gen->key_edges.key_value == CW_KEY_STATE_CLOSED) {
+				cw_gen_key_edges_push_internal(gen, gen->key_edges.cursor, CW_KEY_STATE_OPEN);
+				gen->key_edges.key_value = CW_KEY_STATE_OPEN;
+			}
+			gen->key_edges.cursor = earliest;
+		}
 
-	/* Do nothing if we are already synchronized. */
-	if (gen->parameters_in_sync) {
-		return;
+		const int key_value = tone.frequency ? CW_KEY_STATE_CLOSED : CW_KEY_STATE_OPEN;
+		if (key_value != gen->key_edges.key_value) {
+			cw_gen_key_edges_push_internal(gen, gen->key_edges.cursor, key_value);
+			gen->key_edges.key_value = key_value;
+		}
+		gen->key_edges.cursor += (int64_t) tone.len * 1000;
 	}
 
-	/* Set the length of a Dot to be a Unit with any weighting
-	   adjustment, and the length of a Dash as three Dot lengths.
-	   The weighting adjustment is by adding or subtracting a
-	   length based on 50 % as a neutral weighting. */
-	int unit_length = CW_DOT_CALIBRATION / gen->send_speed;
-	int weighting_length = (2 * (gen->weighting - 50) * unit_length) / 100;
-	gen->dot_len = unit_length + weighting_length;
-	gen->dash_len = 3 * gen->dot_len;
+	return;
+}
 
-	/* End-of-mark space length is one Unit, perhaps adjusted.
-	   End-of-character space length is three Units total.
-	   End-of-word space length is seven Units total.
 
-	   WARNING: notice how the eoc and eow spaces are
-	   calculated. They aren't full 3 units and 7 units. They are
-	   2 units (which takes into account preceding eom space
-	   length), and 5 units (which takes into account preceding
-	   eom *and* eoc space length). So these two lengths are
-	   *additional* ones, i.e. in addition to (already existing)
-	   eom and/or eoc space.  Whether this is good or bad idea to
-	   calculate them like this is a separate topic. Just be aware
-	   of this fact.
 
-	   The end-of-mark length is adjusted by 28/22 times
-	   weighting length to keep PARIS calibration correctly
-	   timed (PARIS has 22 full units, and 28 empty ones).
-	   End-of-mark and end of character delays take
-	   weightings into account. */
-	gen->eom_space_len = unit_length - (28 * weighting_length) / 22;  /* End-of-mark space, a.k.a. regular inter-mark space. */
-	gen->eoc_space_len = 3 * unit_length - gen->eom_space_len;
-	gen->eow_space_len = 7 * unit_length - gen->eoc_space_len;
-	gen->additional_space_len = gen->gap * unit_length;
 
-	/* For "Farnsworth", there also needs to be an adjustment
-	   delay added to the end of words, otherwise the rhythm is
-	   lost on word end.
-	   I don't know if there is an "official" value for this,
-	   but 2.33 or so times the gap is the correctly scaled
-	   value, and seems to sound okay.
+/**
+   \brief Publish edges of tone that has been just enqueued
 
-	   Thanks to Michael D. Ivey <ivey@gweezlebur.com> for
-	   identifying this in earlier versions of libcw. */
-	gen->adjustment_space_len = (7 * gen->additional_space_len) / 3;
+   Called by tone queue, with tone queue's mutex locked, after the
+   tone has been put at tail of tone queue, but before the tail has
+   been moved.
 
-	cw_debug_msg (&cw_debug_object, CW_DEBUG_PARAMETERS, CW_DEBUG_INFO,
-		      MSG_PREFIX "send usec timings <%d [wpm]>: dot: %d, dash: %d, %d, %d, %d, %d, %d",
-		      gen->send_speed, gen->dot_len, gen->dash_len,
-		      gen->eom_space_len, gen->eoc_space_len,
-		      gen->eow_space_len, gen->additional_space_len, gen->adjustment_space_len);
+   \param gen - generator
+*/
+void cw_gen_key_edges_enqueue_internal(cw_gen_t * gen)
+{
+	if (!gen->key_edges.is_enabled) {
+		return;
+	}
 
-	/* Generator parameters are now in sync. */
-	gen->parameters_in_sync = true;
+	/* The tone has been just put at tail of tone queue. */
+	cw_gen_key_edges_publish_queue_internal(gen, gen->tq->tail, 1, cw_gen_key_edges_earliest_internal(gen));
 
 	return;
 }
@@ -2648,216 +5122,208 @@ void cw_gen_sync_parameters_internal(cw_gen_t *gen)
 
 
 /**
-   Helper function intended to hide details of tone queue and of
-   enqueueing a tone from cw_key module.
+   \brief Update schedule of key edges after flushing of tone queue
 
-   The function should be called only on "key down" (begin mark) event
-   from hardware straight key.
-
-   The function is called in very specific context, see cw_key module
-   for details.
+   Called by tone queue, with tone queue's mutex locked.
 
    \param gen - generator
-
-   \return CW_SUCCESS on success
-   \return CW_FAILURE on failure
 */
-int cw_gen_enqueue_begin_mark_internal(cw_gen_t *gen)
+void cw_gen_key_edges_flush_internal(cw_gen_t * gen)
 {
-	/* In case of straight key we don't know at all how long the
-	   tone should be (we don't know for how long the straight key
-	   will be closed).
-
-	   Let's enqueue a beginning of mark (rising slope) +
-	   "forever" (constant) tone. The constant tone will be generated
-	   until key goes into CW_KEY_STATE_OPEN state. */
-
-	cw_tone_t tone;
-	CW_TONE_INIT(&tone, gen->frequency, gen->tone_slope.len, CW_SLOPE_MODE_RISING_SLOPE);
-	int rv = cw_tq_enqueue_internal(gen->tq, &tone);
-
-	if (rv != CW_SUCCESS) {
-		cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_TONE_QUEUE, CW_DEBUG_ERROR,
-			      MSG_PREFIX "enqueue begin mark: failed to enqueue rising slope: '%s'", strerror(errno));
+	if (!gen->key_edges.is_enabled) {
+		return;
 	}
 
-	/* If there was an error during enqueue of rising slope of
-	   mark, assume that it was a transient error, and proceed to
-	   enqueueing forever tone. Only after we fail to enqueue the
-	   "main" tone, we are allowed to return failure to caller. */
-	CW_TONE_INIT(&tone, gen->frequency, gen->quantum_len, CW_SLOPE_MODE_NO_SLOPES);
-	tone.is_forever = true;
-	rv = cw_tq_enqueue_internal(gen->tq, &tone);
-
-	if (rv != CW_SUCCESS) {
-		cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_TONE_QUEUE, CW_DEBUG_ERROR,
-			      MSG_PREFIX "enqueue begin mark: failed to enqueue forever tone: '%s'", strerror(errno));
-	}
+	const int64_t now = cw_gen_monotonic_now_internal();
 
-	cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_TONE_QUEUE, CW_DEBUG_DEBUG,
-		      MSG_PREFIX "enqueue begin mark: tone queue len = %zu", cw_tq_length_internal(gen->tq));
+	__atomic_store_n(&gen->key_edges.epoch, gen->key_edges.epoch + 1, __ATOMIC_RELEASE);
+	cw_gen_key_edges_push_internal(gen, now, CW_KEY_STATE_OPEN);
+	gen->key_edges.key_value = CW_KEY_STATE_OPEN;
+	gen->key_edges.cursor = now;
 
-	return rv;
+	return;
 }
 
 
 
 
 /**
-   Helper function intended to hide details of tone queue and of
-   enqueueing a tone from cw_key module.
+   \brief Update schedule of key edges before removal of tones
 
-   The function should be called only on "key up" (begin space) event
-   from hardware straight key.
+   Called by tone queue, with tone queue's mutex locked, before tones
+   starting at \p idx are removed from tail of the queue.
 
-   The function is called in very specific context, see cw_key module
-   for details.
+   Edges of remaining tones are published again, in new epoch.
 
    \param gen - generator
-
-   \return CW_SUCCESS on success
-   \return CW_FAILURE on failure
+   \param idx - index of first tone that will be removed
 */
-int cw_gen_enqueue_begin_space_internal(cw_gen_t *gen)
+void cw_gen_key_edges_backspace_internal(cw_gen_t * gen, size_t idx)
 {
-	if (gen->audio_system == CW_AUDIO_CONSOLE) {
-		/* FIXME: I think that enqueueing tone is not just a
-		   matter of generating it using generator, but also a
-		   matter of timing events using generator. Enqueueing
-		   tone here and dequeueing it later will be used to
-		   control state of a key. How does enqueueing a
-		   quantum tone influences the key state? */
-
+	if (!gen->key_edges.is_enabled) {
+		return;
+	}
 
-		/* Generate just a bit of silence, just to switch
-		   buzzer from generating a sound to being silent. */
-		cw_tone_t tone;
-		CW_TONE_INIT(&tone, 0, gen->quantum_len, CW_SLOPE_MODE_NO_SLOPES);
-		return cw_tq_enqueue_internal(gen->tq, &tone);
-	} else {
-		/* For soundcards a falling slope with volume from max
-		   to zero should be enough, but... */
+	/* Projected time of start of tone at head of tone queue. */
+	int64_t start = gen->key_edges.cursor;
+	size_t len = gen->tq->len;
+	for (size_t i = gen->tq->head; len > 0; i = (i + 1) % gen->tq->capacity, len--) {
 		cw_tone_t tone;
-		CW_TONE_INIT(&tone, gen->frequency, gen->tone_slope.len, CW_SLOPE_MODE_FALLING_SLOPE);
-		int rv = cw_tq_enqueue_internal(gen->tq, &tone);
+		CW_TONE_COPY(&tone, &gen->tq->queue[i]);
+		cw_gen_resolve_tone_len_internal(gen, &tone);
+		start -= (int64_t) tone.len * 1000;
+	}
 
-		if (rv == CW_SUCCESS) {
-			/* ... but on some occasions, on some
-			   platforms, some sound systems may need to
-			   constantly generate "silent" tone. These four
-			   lines of code are just for them.
+	__atomic_store_n(&gen->key_edges.epoch, gen->key_edges.epoch + 1, __ATOMIC_RELEASE);
+	gen->key_edges.cursor = start;
+	gen->key_edges.key_value = -1; /* Unknown: first remaining tone gets its edge. */
+	/* Remaining tones keep their place in time, even if the
+	   first of them is being played right now. */
+	cw_gen_key_edges_publish_queue_internal(gen, gen->tq->head, (idx + gen->tq->capacity - gen->tq->head) % gen->tq->capacity, start);
 
-			   FIXME: what occasions? what platforms? what sound systems?
+	return;
+}
 
-			   It would be better to avoid queueing silent
-			   "forever" tone because this increases CPU
-			   usage. It would be better to simply not to
-			   queue any new tones after "falling slope"
-			   tone. Silence after the last falling slope
-			   would simply last on itself until there is
-			   new tone in queue to dequeue. */
-			CW_TONE_INIT(&tone, 0, gen->quantum_len, CW_SLOPE_MODE_NO_SLOPES);
-			tone.is_forever = true;
-			rv = cw_tq_enqueue_internal(gen->tq, &tone);
-		}
 
-		return rv;
+
+
+/**
+   \brief Create new keying timeline
+
+   \return new timeline on success
+   \return NULL on failure to allocate memory
+*/
+cw_timeline_t * cw_timeline_new(void)
+{
+	cw_timeline_t * timeline = (cw_timeline_t *) malloc(sizeof (cw_timeline_t));
+	if (!timeline) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR, MSG_PREFIX "malloc()");
+		return (cw_timeline_t *) NULL;
 	}
+
+	timeline->entries = (cw_timeline_entry_t *) NULL;
+	timeline->n_entries = 0;
+	timeline->capacity = 0;
+	timeline->duration = 0;
+
+	return timeline;
 }
 
 
 
 
 /**
-   Helper function intended to hide details of tone queue and of
-   enqueueing a tone from cw_key module.
+   \brief Delete keying timeline
 
-   The function should be called on hardware key events only. Since we
-   enqueue symbols, we know that they have limited, specified
-   length. This means that the function should be called for events
-   from iambic keyer.
+   \param timeline - pointer to timeline to delete
+*/
+void cw_timeline_delete(cw_timeline_t ** timeline)
+{
+	if (!timeline || !*timeline) {
+		return;
+	}
 
-   'Partial' means without any end-of-mark spaces.
+	free((*timeline)->entries);
+	free(*timeline);
+	*timeline = (cw_timeline_t *) NULL;
 
-   The function is called in very specific context, see cw_key module
-   for details.
+	return;
+}
 
-   \param gen - generator
-   \param symbol - symbol to enqueue (Space/Dot/Dash)
 
-   \return CW_SUCCESS on success
-   \return CW_FAILURE on failure
-*/
-int cw_gen_enqueue_partial_symbol_internal(cw_gen_t *gen, char symbol)
-{
-	cw_tone_t tone = { 0 };
 
-	if (symbol == CW_DOT_REPRESENTATION) {
-		CW_TONE_INIT(&tone, gen->frequency, gen->dot_len, CW_SLOPE_MODE_STANDARD_SLOPES);
 
-	} else if (symbol == CW_DASH_REPRESENTATION) {
-		CW_TONE_INIT(&tone, gen->frequency, gen->dash_len, CW_SLOPE_MODE_STANDARD_SLOPES);
+/**
+   \brief Remove all entries from keying timeline
 
-	} else if (symbol == CW_SYMBOL_SPACE) {
-		CW_TONE_INIT(&tone, 0, gen->eom_space_len, CW_SLOPE_MODE_NO_SLOPES);
+   Memory allocated for entries is kept for reuse.
 
-	} else {
-		cw_assert (0, MSG_PREFIX "unknown key symbol '%d'", symbol);
-	}
+   \param timeline - timeline to clear
+*/
+void cw_timeline_clear(cw_timeline_t * timeline)
+{
+	timeline->n_entries = 0;
+	timeline->duration = 0;
 
-	return cw_tq_enqueue_internal(gen->tq, &tone);
+	return;
 }
 
 
 
 
 /**
-   \brief Wait for generator's tone queue to drain until only as many tones as given in \p level remain queued
-
-   This function is for use by programs that want to optimize
-   themselves to avoid the cleanup that happens when generator's tone
-   queue drains completely. Such programs have a short time in which
-   to add more tones to the queue.
-
-   The function returns when queue's level is equal or lower than \p
-   level.  If at the time of function call the level of queue is
-   already equal or lower than \p level, function returns immediately.
+   \brief Append tone to keying timeline
 
-   Notice that generator must be running (started with cw_gen_start())
-   when this function is called, otherwise it will be waiting forever
-   for a change of tone queue's level that will never happen.
+   Space is merged with preceding Space. Empty tones are ignored.
 
-   \reviewed on 2017-01-20
+   \errno ENOMEM - failed to allocate memory for new entry
 
-   \param gen - generator on which to wait
-   \param level - level in queue, at which to return
+   \param timeline - timeline
+   \param tone - tone to append
 
-   \return CW_SUCCESS
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
 */
-int cw_gen_wait_for_queue_level(cw_gen_t * gen, size_t level)
+int cw_timeline_append_internal(cw_timeline_t * timeline, const cw_tone_t * tone)
 {
-	return cw_tq_wait_for_level_internal(gen->tq, level);
+	if (tone->len == 0) {
+		return CW_SUCCESS;
+	}
+
+	const uint8_t key_value = tone->frequency ? CW_KEY_STATE_CLOSED : CW_KEY_STATE_OPEN;
+
+	if (key_value == CW_KEY_STATE_OPEN
+	    && timeline->n_entries > 0
+	    && timeline->entries[timeline->n_entries - 1].key_value == CW_KEY_STATE_OPEN) {
+
+		timeline->entries[timeline->n_entries - 1].len += tone->len;
+		timeline->duration += tone->len;
+		return CW_SUCCESS;
+	}
+
+	if (timeline->n_entries == timeline->capacity) {
+		const size_t capacity = timeline->capacity ? 2 * timeline->capacity : 256;
+		cw_timeline_entry_t * entries = (cw_timeline_entry_t *) realloc(timeline->entries, capacity * sizeof (cw_timeline_entry_t));
+		if (!entries) {
+			errno = ENOMEM;
+			return CW_FAILURE;
+		}
+		timeline->entries = entries;
+		timeline->capacity = capacity;
+	}
+
+	cw_timeline_entry_t * entry = &timeline->entries[timeline->n_entries++];
+	entry->start = timeline->duration;
+	entry->len = tone->len;
+	entry->key_value = key_value;
+	entry->is_first = tone->is_first;
+
+	timeline->duration += tone->len;
+
+	return CW_SUCCESS;
 }
 
 
 
 
 /**
-   \brief Cancel all pending queued tones in a generator, and return to silence
+   \brief Remove last character from keying timeline
 
-   If there is a tone in progress, the function will wait until this
-   last one has completed, then silence the tones.
+   Remove all entries until and including first Mark of last
+   character. This is the timeline's counterpart of
+   cw_tq_handle_backspace_internal().
 
-   \param gen - generator to flush
+   \param timeline - timeline
 */
-void cw_gen_flush_queue(cw_gen_t * gen)
+void cw_timeline_backspace_internal(cw_timeline_t * timeline)
 {
-	/* This function locks and unlocks mutex. */
-	cw_tq_flush_internal(gen->tq);
-
-	/* Force silence on the speaker anyway, and stop any background
-	   soundcard tone generation. */
-	cw_gen_silence_internal(gen);
+	for (size_t i = timeline->n_entries; i > 0; i--) {
+		if (timeline->entries[i - 1].is_first) {
+			timeline->n_entries = i - 1;
+			timeline->duration = timeline->entries[i - 1].start;
+			break;
+		}
+	}
 
 	return;
 }
@@ -2866,80 +5332,144 @@ void cw_gen_flush_queue(cw_gen_t * gen)
 
 
 /**
-   \brief Return char string with generator's audio device path/name
+   \brief Redirect characters enqueued in generator to keying timeline
 
-   Returned pointer is owned by library.
+   While \p timeline is set, Marks and Spaces of characters enqueued
+   in \p gen with cw_gen_enqueue_string(), cw_gen_enqueue_character()
+   and cw_gen_enqueue_character_partial() are appended to \p timeline
+   instead of being enqueued in generator's tone queue. No audio is synthesized, and generator doesn't need to
+   be started. Speed, gap and weighting of the generator are honored
+   in the same way as when the characters are played, and so are
+   combinations formed with cw_gen_enqueue_character_partial().
 
-   \reviewed on 2017-01-20
+   Pass NULL as \p timeline to enqueue characters in tone queue again.
+   Generator doesn't take ownership of \p timeline.
 
-   \param gen
+   Timeline isn't locked: set it, enqueue characters, and read or
+   clear the timeline from one thread only. Other threads must not
+   enqueue characters in \p gen while the timeline is set.
 
-   \return char string with generator's audio device path/name
+   \param gen - generator
+   \param timeline - timeline to append to, or NULL
 */
-const char *cw_gen_get_audio_device(cw_gen_t const * gen)
+void cw_gen_set_timeline(cw_gen_t * gen, cw_timeline_t * timeline)
 {
-	cw_assert (gen, MSG_PREFIX "generator is NULL");
-	return gen->audio_device;
+	gen->timeline = timeline;
+
+	return;
 }
 
 
 
 
 /**
-   \brief Get id of audio system used by given generator (one of enum cw_audio_system values)
+   \brief Get duration of tones in generator's queue
 
-   You can use cw_get_audio_system_label() to get string corresponding
-   to value returned by this function.
+   Get total length of tones waiting in generator's tone queue. The
+   tone that is being played right now is not included.
 
-   \reviewed on 2017-01-20
+   The total is maintained by tone queue on every enqueue, dequeue,
+   backspace and flush, so the function doesn't walk the queue and
+   doesn't take any lock. Lengths of tones enqueued in symbolic mode
+   (see cw_gen_set_symbolic_enqueue()) are calculated with current
+   timing parameters of the generator.
 
-   \param gen - generator from which to get audio system
+   The value may be slightly out of date if the queue is modified
+   concurrently, but it never includes a tone twice.
 
-   \return audio system's id
+   \param gen - generator
+   \param n_samples - output, duration in samples at generator's sample rate (may be NULL)
+
+   \return duration of queued tones [us]
 */
-int cw_gen_get_audio_system(cw_gen_t const * gen)
+int64_t cw_gen_get_queued_duration(cw_gen_t const * gen, int64_t * n_samples)
 {
-	cw_assert (gen, MSG_PREFIX "generator is NULL");
-	return gen->audio_system;
+	const cw_tone_queue_t * tq = gen->tq;
+
+	int64_t duration = __atomic_load_n(&tq->duration, __ATOMIC_RELAXED);
+	for (int symbol = CW_TONE_SYMBOL_NONE + 1; symbol < CW_TONE_SYMBOL_COUNT; symbol++) {
+		const uint32_t n = __atomic_load_n(&tq->n_symbols[symbol], __ATOMIC_RELAXED);
+		if (n) {
+			duration += (int64_t) n * cw_gen_symbol_len_internal(gen, symbol);
+		}
+	}
+
+	if (n_samples) {
+		*n_samples = duration * gen->sample_rate / CW_USECS_PER_SEC;
+	}
+
+	return duration;
 }
 
 
 
 
 /**
-   \reviewed on 2017-01-20
+   \brief Set enqueue mode of generator
+
+   In symbolic mode Marks and Spaces of characters are enqueued as
+   symbolic elements (dot, dash, inter-mark space, inter-character
+   space, inter-word space), and their lengths are calculated only
+   when they are dequeued. Changes of speed, gap or weighting then
+   act instantly on text that is already in tone queue, without a
+   need to flush and re-enqueue the text.
+
+   The mode applies to characters enqueued after the call. By default
+   the mode is off.
+
+   \param gen - generator
+   \param symbolic - enable or disable symbolic mode
 */
-size_t cw_gen_get_queue_length(cw_gen_t const * gen)
+void cw_gen_set_symbolic_enqueue(cw_gen_t * gen, bool symbolic)
 {
-	return cw_tq_length_internal(gen->tq);
+	gen->symbolic_enqueue = symbolic;
+
+	return;
 }
 
 
 
 
 /**
-   \reviewed on 2017-01-20
+   \brief Get enqueue mode of generator
+
+   See cw_gen_set_symbolic_enqueue().
+
+   \param gen - generator
+
+   \return true if symbolic mode is enabled
+   \return false otherwise
 */
-int cw_gen_register_low_level_callback(cw_gen_t * gen, cw_queue_low_callback_t callback_func, void * callback_arg, size_t level)
+bool cw_gen_get_symbolic_enqueue(cw_gen_t const * gen)
 {
-	return cw_tq_register_low_level_callback_internal(gen->tq, callback_func, callback_arg, level);
+	return gen->symbolic_enqueue;
 }
 
 
 
 
-int cw_gen_wait_for_tone(cw_gen_t * gen)
-{
-	return cw_tq_wait_for_tone_internal(gen->tq);
-}
+/**
+   \brief Set alphabet of generator
 
+   The alphabet is used by cw_gen_enqueue_utf8_string(). By default
+   generator uses CW_ALPHABET_LATIN.
 
+   \errno EINVAL - invalid alphabet
 
+   \param gen - generator
+   \param alphabet - alphabet (CW_ALPHABET_*)
 
-/**
-   \reviewed on 2017-01-20
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
 */
-bool cw_gen_is_queue_full(cw_gen_t const * gen)
+int cw_gen_set_alphabet(cw_gen_t * gen, int alphabet)
 {
-	return cw_tq_is_full_internal(gen->tq);
+	if (alphabet < 0 || alphabet >= CW_ALPHABET_MAX) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	gen->alphabet = alphabet;
+
+	return CW_SUCCESS;
 }
@@ -12,8 +12,10 @@
 
 #include "libcw.h"
 #include "libcw_alsa.h"
+#include "libcw_data.h"
 #include "libcw_key.h"
 #include "libcw_pa.h"
+#include "libcw_resampler.h"
 #include "libcw_tq.h"
 
 
@@ -36,9 +38,39 @@
 
 
 
+/* Capacity of ring of straight key edges that haven't been applied
+   to generator's output yet. */
+#define CW_GEN_SK_EDGES_CAPACITY        16
+
+
+
+/* Capacity of ring of scheduled key edges, see
+   cw_gen_get_key_edge(). Must be a power of two. It's larger than
+   maximal capacity of tone queue, so that schedule of full tone
+   queue fits in the ring. */
+#define CW_GEN_KEY_EDGES_CAPACITY     4096
+
+
+
 /* Symbolic name for inter-mark space. */
 enum { CW_SYMBOL_SPACE = ' ' };
 
+/* Spaces in pre-encoded messages, see cw_gen_enqueue_elements().
+   Marks are CW_DOT_REPRESENTATION and CW_DASH_REPRESENTATION. */
+enum { CW_ELEMENT_EOC_SPACE = ' ', CW_ELEMENT_EOW_SPACE = '/' };
+
+/* Synthesis of samples of sine wave, see cw_gen_set_synthesis().
+   Samples of fixed-point synthesis differ from samples of
+   floating-point synthesis by at most CW_SYNTHESIS_MAX_ERROR. */
+enum {
+	CW_SYNTHESIS_FLOATING_POINT = 0,
+	CW_SYNTHESIS_FIXED_POINT,
+	CW_SYNTHESIS_MAX_ERROR = 4
+};
+
+/* Lowest sample rate of synthesis, see cw_gen_set_synthesis_rate(). */
+#define CW_SYNTHESIS_RATE_MIN (4 * CW_FREQUENCY_MAX)
+
 
 
 
@@ -54,6 +86,50 @@ enum { CW_SYMBOL_SPACE = ' ' };
 
 
 
+/* Edge of key (transition between Mark and Space) that generator
+   will produce when playing tones that are in its tone queue, see
+   cw_gen_get_key_edge(). */
+typedef struct {
+	int64_t time;    /* Projected time of edge, CLOCK_MONOTONIC [ns]. */
+	int key_value;   /* CW_KEY_STATE_OPEN or CW_KEY_STATE_CLOSED. */
+	uint32_t epoch;  /* Edges of older epoch have been superseded by flush or backspace. */
+} cw_key_edge_t;
+
+
+
+
+/* Interval of constant key value in keying timeline, see
+   cw_gen_set_timeline(). */
+typedef struct {
+	int64_t start;      /* Start of interval, from start of timeline [us]. */
+	int32_t len;        /* Length of interval [us]. */
+	uint8_t key_value;  /* CW_KEY_STATE_OPEN or CW_KEY_STATE_CLOSED. */
+	bool is_first;      /* The interval is first Mark of a character. */
+} cw_timeline_entry_t;
+
+/* Keying timeline: Marks and Spaces that generator would play,
+   collected without audio synthesis. Adjacent Spaces are merged into
+   one entry. Not locked, used by one thread only. */
+struct cw_timeline_struct {
+	cw_timeline_entry_t * entries;
+	size_t n_entries;
+	size_t capacity;
+	int64_t duration;   /* Sum of lengths of entries [us]. */
+};
+
+
+
+
+/* Message waiting in generator for its time of transmission. */
+typedef struct {
+	int64_t start;      /* Time of first sample of message, CLOCK_MONOTONIC [ns]. */
+	uint64_t sequence;  /* Order of enqueueing. */
+	char * text;
+} cw_gen_timed_t;
+
+
+
+
 struct cw_gen_struct {
 
 	/* Tone queue. */
@@ -69,6 +145,12 @@ struct cw_gen_struct {
 	   cw_tq module for declarations of these functions. */
 	cw_tone_queue_t *tq;
 
+	/* Generator and its tone queue were allocated by
+	   cw_gen_new(), and are deallocated by cw_gen_delete(). False
+	   for generator created in caller's storage by
+	   cw_gen_init(). */
+	bool is_allocated;
+
 
 
 
@@ -112,6 +194,13 @@ struct cw_gen_struct {
 	int additional_space_len; /* Length of additional space at the end of a character. [us] */
 	int adjustment_space_len; /* Length of adjustment space at the end of a word. [us] */
 
+	/* Lengths of symbolic tones (CW_TONE_SYMBOL_*), resolved from
+	   the lengths above. Generator's thread reads them while client
+	   code may be changing speed, gap or weighting, so
+	   cw_gen_sync_parameters_internal() publishes all of them under
+	   tq->mutex. [us] */
+	int symbol_len[CW_TONE_SYMBOL_COUNT];
+
 
 
 
@@ -131,6 +220,24 @@ struct cw_gen_struct {
 	   This is a flag that shows when this needs to be done. */
 	bool parameters_in_sync;
 
+	/* Enqueue Marks and Spaces of characters as symbolic
+	   elements (see CW_TONE_SYMBOL_*), whose lengths are resolved
+	   at dequeue time. Changes of speed, gap or weighting then
+	   apply also to text that is already in tone queue. */
+	bool symbolic_enqueue;
+
+	/* Alphabet used by cw_gen_enqueue_utf8_string(), see
+	   CW_ALPHABET_*. */
+	int alphabet;
+
+	/* Write end of a pipe, to which generator's thread writes a
+	   byte after each tone, see cw_gen_set_notification_fd(). */
+	int notification_fd;
+
+	/* True from enqueueing of a tone until generator has played
+	   all tones from tone queue. Set under tq->mutex. */
+	bool is_playing;
+
 
 
 
@@ -202,6 +309,12 @@ struct cw_gen_struct {
 	int buffer_sub_start;
 	int buffer_sub_stop;
 
+	/* All samples of buffer, up to and including sample at
+	   buffer_sub_stop, are silence (zero). Consumers of full
+	   buffers may skip or mark such buffers instead of copying
+	   their samples. */
+	bool buffer_is_silent;
+
 	int sample_rate; /* set to the same value of sample rate as
 			    you have used when configuring sound card */
 
@@ -210,6 +323,29 @@ struct cw_gen_struct {
 	   function calculating consecutive fragments of sine wave. */
 	double phase_offset;
 
+	/* Synthesis of samples, CW_SYNTHESIS_*. */
+	int synthesis;
+
+	/* Phase offset of fixed-point synthesis (2^32 = 2 * Pi), and
+	   accumulated remainder of phase increments (see
+	   cw_fixed_step_internal()). */
+	uint32_t phase_fixed;
+	uint32_t phase_fixed_remainder;
+
+	/* Audio sink of generator that calculates samples at lower
+	   sample rate than sample rate of audio sink (see
+	   cw_gen_set_synthesis_rate()). 'buffer' and 'sample_rate'
+	   of generator are then buffer and sample rate of synthesis,
+	   and resampler converts samples from generator's buffer to
+	   the buffer below. Resampler is NULL otherwise. */
+	struct {
+		cw_resampler_t * resampler;
+		cw_sample_t * buffer;
+		int buffer_n_samples;
+		int buffer_fill;     /* Count of samples waiting in 'buffer'. */
+		int sample_rate;
+	} sink;
+
 
 
 	/* Tone parameters. */
@@ -245,6 +381,10 @@ struct cw_gen_struct {
 		   just iterate the table from end to beginning. */
 		float *amplitudes;
 
+		/* The same table for fixed-point synthesis. Only the
+		   table for current synthesis is up to date. */
+		int16_t *amplitudes_fixed;
+
 		/* This is a secondary parameter, derived from
 		   ->len. n_amplitudes is useful when iterating over
 		   ->amplitudes[] or reallocing the ->amplitudes[]. */
@@ -308,6 +448,105 @@ struct cw_gen_struct {
 	   dequeue_and_generate thread function. */
 	bool do_dequeue_and_generate;
 
+	/* Rendering without generator's own thread.
+
+	   A generator may be driven by external code (e.g. by session
+	   scheduler, see libcw_sched.c) instead of by its own
+	   cw_gen_dequeue_and_generate_internal() thread. The external
+	   code calls cw_gen_render_buffer_internal() to get one full
+	   buffer of samples at a time. A tone that doesn't fit into
+	   one buffer is kept here between the calls. */
+	struct {
+		bool is_external;    /* Generator is driven by external code, cw_gen_start() is not allowed. */
+		bool has_tone;       /* 'tone' has samples that haven't been rendered yet. */
+		bool dequeued_prev;  /* Result of previous dequeue, used to detect moment when tone queue goes empty. */
+		cw_tone_t tone;
+	} render;
+
+	/* Straight key keying generator with sample accuracy.
+
+	   Key-down and key-up edges of straight key are published in
+	   'edges' ring by key's thread, and are consumed by
+	   generator's thread (or by code rendering buffers for the
+	   generator). While key is closed the generator synthesizes
+	   one continuous tone, buffer after buffer, without any
+	   traffic in tone queue. Key-up edge is applied at the sample
+	   corresponding to its timestamp, and is followed by falling
+	   slope.
+
+	   Used only by generators that have sample buffer (i.e. not
+	   by NULL and console generators when they have their own
+	   thread). */
+	struct {
+		struct timeval edges[CW_GEN_SK_EDGES_CAPACITY];
+
+		/* Count of published edges. Written (atomically) only
+		   by key's thread. Odd count means that key is closed. */
+		uint32_t n_edges;
+
+		/* Fields below are used only by consumer of edges. */
+		uint32_t n_consumed;
+		bool is_closed;
+		/* Position on slope: 0 = silence,
+		   tone_slope.n_amplitudes = plateau. */
+		int level;
+		/* Time of rendering of previous buffer. Edges are
+		   placed in buffer relative to this time. */
+		struct timeval prev_buffer;
+		bool has_prev_buffer;
+	} sk;
+
+	/* Messages enqueued with cw_gen_enqueue_at(), waiting for
+	   their time. Binary min-heap ordered by time of start of
+	   message (and by order of enqueueing, for messages with the
+	   same time). */
+	struct {
+		cw_gen_timed_t * items;
+		size_t n_items;
+		size_t capacity;
+		uint64_t sequence;
+		pthread_mutex_t mutex;
+	} timed;
+
+	/* When not NULL, tones of enqueued characters are appended to
+	   this timeline instead of being enqueued in tone queue, see
+	   cw_gen_set_timeline(). */
+	cw_timeline_t * timeline;
+
+	/* Schedule of key edges, published as soon as tones are
+	   enqueued, see cw_gen_get_key_edge().
+
+	   Single-producer single-consumer ring. The producer is code
+	   enqueueing tones, flushing tone queue or removing last
+	   character from it; all these operations are done with tone
+	   queue's mutex locked, so there is only one producer at a
+	   time. The consumer is client's code. 'head' is written
+	   (atomically) only by producer, 'tail' only by consumer. */
+	struct {
+		bool is_enabled;
+		cw_key_edge_t ring[CW_GEN_KEY_EDGES_CAPACITY];
+		uint32_t head;
+		uint32_t tail;
+		uint32_t epoch;
+		uint32_t n_dropped;
+
+		/* Fields below are used only by producer. */
+		int64_t cursor;  /* Projected end of last enqueued tone [ns]. */
+		int key_value;   /* Key value at 'cursor'. */
+
+		/* Delay of audio sink [us], updated by generator's
+		   thread. */
+		int64_t sink_delay;
+	} key_edges;
+
+	/* Encoder of generator's output (see libcw_codec.c). NULL if
+	   generator's output isn't encoded. */
+	struct cw_codec_encoder_struct * encoder;
+
+	/* Shared queue from which items are forwarded to generator's
+	   tone queue (see libcw_shm_tq.c). NULL if there is none. */
+	struct cw_shm_tq_struct * shm_tq;
+
 
 
 
@@ -334,6 +573,10 @@ struct cw_gen_struct {
 	int  (* open_device)(cw_gen_t *gen);
 	void (* close_device)(cw_gen_t *gen);
 	int  (* write)(cw_gen_t *gen);
+	/* Time after which a sample written now will be played [us],
+	   or -1 if unknown. NULL for audio systems without buffering
+	   of samples. */
+	int64_t (* get_delay)(cw_gen_t *gen);
 
 
 	/* Audio system - OSS. */
@@ -381,7 +624,7 @@ int cw_gen_enqueue_partial_symbol_internal(cw_gen_t *gen, char symbol);
 
 
 int cw_gen_enqueue_representation_partial_internal(cw_gen_t * gen, const char * representation);
-int cw_gen_enqueue_valid_character_internal(cw_gen_t * gen, char c);
+int cw_gen_enqueue_valid_character_internal(cw_gen_t * gen, const cw_character_table_t * table, char c);
 int cw_gen_enqueue_character_partial(cw_gen_t * gen, char c);
 
 
@@ -395,6 +638,26 @@ void cw_generator_delete_internal(void);
 
 void cw_gen_reset_parameters_internal(cw_gen_t *gen);
 void cw_gen_sync_parameters_internal(cw_gen_t *gen);
+double cw_gen_get_phase_internal(cw_gen_t const * gen);
+void cw_gen_set_phase_internal(cw_gen_t * gen, double phase);
+int cw_gen_slope_n_samples_internal(int sample_rate, int slope_len);
+
+int cw_gen_write_internal(cw_gen_t * gen);
+cw_sample_t * cw_gen_get_sink_buffer_internal(cw_gen_t * gen, int * n_samples);
+int cw_gen_get_sink_sample_rate_internal(cw_gen_t const * gen);
+
+int cw_gen_render_buffer_internal(cw_gen_t * gen);
+int cw_gen_render_tone_internal(cw_gen_t * gen, cw_tone_t * tone, int start, int64_t stop);
+int  cw_gen_symbol_len_internal(cw_gen_t const * gen, int symbol);
+void cw_gen_resolve_tone_len_internal(cw_gen_t * gen, cw_tone_t * tone);
+
+void cw_gen_sk_publish_edge_internal(cw_gen_t * gen, bool is_closed, const struct timeval * timestamp);
+bool cw_gen_sk_is_active_internal(const cw_gen_t * gen);
+void cw_gen_sk_render_buffer_internal(cw_gen_t * gen, int start, const struct timeval * now);
+
+void cw_gen_key_edges_enqueue_internal(cw_gen_t * gen);
+void cw_gen_key_edges_flush_internal(cw_gen_t * gen);
+void cw_gen_key_edges_backspace_internal(cw_gen_t * gen, size_t idx);
 
 
 
@@ -24,12 +24,33 @@ CW_STATIC_FUNC int    cw_gen_new_open_internal(cw_gen_t * gen, int audio_system,
 CW_STATIC_FUNC void * cw_gen_dequeue_and_generate_internal(void * arg);
 CW_STATIC_FUNC int    cw_gen_calculate_sine_wave_internal(cw_gen_t * gen, cw_tone_t * tone);
 CW_STATIC_FUNC int    cw_gen_calculate_amplitude_internal(cw_gen_t * gen, const cw_tone_t * tone);
+CW_STATIC_FUNC int    cw_gen_calculate_sine_wave_fixed_internal(cw_gen_t * gen, cw_tone_t * tone);
+CW_STATIC_FUNC int    cw_gen_calculate_amplitude_fixed_internal(cw_gen_t * gen, const cw_tone_t * tone);
+CW_STATIC_FUNC int    cw_gen_slope_index_internal(const cw_tone_t * tone);
 CW_STATIC_FUNC int    cw_gen_write_to_soundcard_internal(cw_gen_t * gen, cw_tone_t * tone, bool is_empty_tone);
-CW_STATIC_FUNC int    cw_gen_enqueue_valid_character_partial_internal(cw_gen_t * gen, char character);
+CW_STATIC_FUNC int    cw_gen_enqueue_valid_character_partial_internal(cw_gen_t * gen, const cw_character_table_t * table, char character);
 CW_STATIC_FUNC void   cw_gen_recalculate_slopes_internal(cw_gen_t * gen);
+CW_STATIC_FUNC void   cw_gen_recalculate_slopes_fixed_internal(cw_gen_t * gen);
 CW_STATIC_FUNC int    cw_gen_join_thread_internal(cw_gen_t * gen);
 CW_STATIC_FUNC void   cw_gen_empty_tone_calculate_samples_size_internal(cw_gen_t const * gen, cw_tone_t * tone);
 CW_STATIC_FUNC void   cw_gen_tone_calculate_samples_size_internal(cw_gen_t const * gen, cw_tone_t * tone);
+CW_STATIC_FUNC void   cw_gen_sk_render_samples_internal(cw_gen_t * gen, int start, int stop);
+CW_STATIC_FUNC void   cw_gen_sk_write_internal(cw_gen_t * gen);
+CW_STATIC_FUNC void   cw_gen_sk_consume_edge_internal(cw_gen_t * gen, const struct timeval * edge);
+CW_STATIC_FUNC int    cw_gen_timed_push_internal(cw_gen_t * gen, const cw_gen_timed_t * item);
+CW_STATIC_FUNC void   cw_gen_timed_pop_internal(cw_gen_t * gen, cw_gen_timed_t * item);
+CW_STATIC_FUNC void   cw_gen_timed_clear_internal(cw_gen_t * gen);
+CW_STATIC_FUNC int64_t cw_gen_timed_lead_internal(cw_gen_t * gen);
+CW_STATIC_FUNC int64_t cw_gen_timed_timeout_internal(cw_gen_t * gen);
+CW_STATIC_FUNC bool   cw_gen_timed_dispatch_internal(cw_gen_t * gen);
+CW_STATIC_FUNC void   cw_gen_key_edges_push_internal(cw_gen_t * gen, int64_t time, int key_value);
+CW_STATIC_FUNC int64_t cw_gen_key_edges_earliest_internal(cw_gen_t * gen);
+CW_STATIC_FUNC int    cw_gen_enqueue_tone_internal(cw_gen_t * gen, cw_tone_t * tone);
+CW_STATIC_FUNC int    cw_timeline_append_internal(cw_timeline_t * timeline, const cw_tone_t * tone);
+CW_STATIC_FUNC void   cw_timeline_backspace_internal(cw_timeline_t * timeline);
+CW_STATIC_FUNC void   cw_gen_key_edges_publish_queue_internal(cw_gen_t * gen, size_t idx, size_t n_tones, int64_t earliest);
+CW_STATIC_FUNC void   cw_gen_notify_internal(cw_gen_t * gen);
+CW_STATIC_FUNC void   cw_gen_drained_internal(cw_gen_t * gen);
 
 
 
@@ -44,6 +44,7 @@
 #include "libcw_rec.h"
 #include "libcw_signal.h"
 #include "libcw_utils.h"
+#include "libcw_pool.h"
 #include "libcw2.h"
 
 
@@ -250,6 +251,31 @@ void cw_key_tk_set_value_internal(volatile cw_key_t *key, int key_state)
 {
 	cw_assert (key, MSG_PREFIX "tk set value: key is NULL");
 
+	const struct timeval timestamp = { .tv_sec = key->timer.tv_sec, .tv_usec = key->timer.tv_usec };
+	cw_key_tk_set_value_at_internal(key, &timestamp, key_state);
+
+	return;
+}
+
+
+
+
+/**
+   \brief Set new key value of generator's keying, with given timestamp
+
+   Variant of cw_key_tk_set_value_internal() that passes \p timestamp
+   to receiver and to keying callback instead of key's timer. Used by
+   generator's thread for edges of straight key, so that the thread
+   doesn't write key's timer, which is written by thread of the key.
+
+   \param key - key to use
+   \param timestamp - time of change of key value
+   \param key_state - key state to be set
+*/
+void cw_key_tk_set_value_at_internal(volatile cw_key_t *key, const struct timeval *timestamp, int key_state)
+{
+	cw_assert (key, MSG_PREFIX "tk set value: key is NULL");
+
 	if (key->tk.key_value == key_state) {
 		/* This is not an error. This may happen when
 		   dequeueing 'forever' tone multiple times in a
@@ -271,13 +297,17 @@ void cw_key_tk_set_value_internal(volatile cw_key_t *key, int key_state)
 	   So *in theory* only one of these "if" blocks will be
 	   executed. */
 
+	/* Local copy, so that receiver and callback don't get a
+	   pointer to data of the caller. */
+	struct timeval t = *timestamp;
+
 	if (key->rec) {
 		if (key->tk.key_value) {
 			/* Key down. */
-			cw_rec_mark_begin(key->rec, &key->timer);
+			cw_rec_mark_begin(key->rec, &t);
 		} else {
 			/* Key up. */
-			cw_rec_mark_end(key->rec, &key->timer);
+			cw_rec_mark_end(key->rec, &t);
 		}
 	}
 
@@ -285,7 +315,7 @@ void cw_key_tk_set_value_internal(volatile cw_key_t *key, int key_state)
 		cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_KEYING, CW_DEBUG_INFO,
 			      MSG_PREFIX "tk set value: about to call callback, key state = %d\n", key->tk.key_value);
 
-		(*key->key_callback_func)(&key->timer, key->tk.key_value, key->key_callback_arg);
+		(*key->key_callback_func)(&t, key->tk.key_value, key->key_callback_arg);
 	}
 	if (key->key_legacy_callback_func) {
 		cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_KEYING, CW_DEBUG_INFO,
@@ -1089,6 +1119,26 @@ bool cw_key_ik_is_busy_internal(const volatile cw_key_t *key)
 
 
 
+/**
+   \brief Check if iambic keyer is busy
+
+   Client code may use this function to learn, without blocking,
+   that the keyer has finished sending elements (see also
+   cw_key_ik_wait_for_keyer()).
+
+   \param key
+
+   \return true if keyer is busy
+   \return false otherwise
+*/
+bool cw_key_ik_is_busy(const volatile cw_key_t * key)
+{
+	return cw_key_ik_is_busy_internal(key);
+}
+
+
+
+
 
 /**
    \brief Wait for end of element from the keyer
@@ -1377,13 +1427,63 @@ void cw_key_sk_reset_internal(volatile cw_key_t *key)
 */
 cw_key_t * cw_key_new(void)
 {
-	cw_key_t * key = (cw_key_t *) malloc(sizeof (cw_key_t));
-	if (!key) {
+	const size_t size = cw_key_get_storage_size();
+	void * storage = NULL;
+	if (0 != posix_memalign(&storage, CW_STORAGE_ALIGNMENT, size)) {
 		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
-			      MSG_PREFIX "new: malloc()");
+			      MSG_PREFIX "new: posix_memalign()");
 		return (cw_key_t *) NULL;
 	}
 
+	cw_key_t * key = cw_key_init(storage, size);
+	key->is_allocated = true;
+
+	return key;
+}
+
+
+
+
+/**
+   \brief Get size of storage for key
+
+   The size is a multiple of cw_get_storage_alignment().
+
+   \return size of storage required by cw_key_init() [bytes]
+*/
+size_t cw_key_get_storage_size(void)
+{
+	return CW_STORAGE_SIZE(sizeof (cw_key_t));
+}
+
+
+
+
+/**
+   \brief Initialize new key in storage provided by caller
+
+   Storage of \p size bytes, aligned to cw_get_storage_alignment(),
+   must be provided by caller and must outlive the key. Storages may
+   be taken from cw_pool_t.
+
+   \errno EINVAL - storage is NULL, too small, or misaligned
+
+   \param storage - memory for key
+   \param size - size of \p storage, at least cw_key_get_storage_size()
+
+   \return pointer to key on success (equal to \p storage)
+   \return NULL on failure
+*/
+cw_key_t * cw_key_init(void * storage, size_t size)
+{
+	if (!cw_storage_is_valid_internal(storage, size, cw_key_get_storage_size())) {
+		errno = EINVAL;
+		return (cw_key_t *) NULL;
+	}
+
+	cw_key_t * key = (cw_key_t *) storage;
+	key->is_allocated = false;
+
 	key->gen = (cw_gen_t *) NULL;
 	key->rec = (cw_rec_t *) NULL;
 
@@ -1421,7 +1521,8 @@ cw_key_t * cw_key_new(void)
 /**
    \brief Delete key
 
-   \p key is deallocated. Pointer to \p key is set to NULL.
+   \p key is deallocated (unless it has been created with
+   cw_key_init()). Pointer to \p key is set to NULL.
 
    \reviewed on 2017-01-31
 
@@ -1435,13 +1536,38 @@ void cw_key_delete(cw_key_t ** key)
 		return;
 	}
 
-	if ((*key)->gen) {
-		/* Unregister. */
-		(*key)->gen->key = NULL;
+	const bool is_allocated = (*key)->is_allocated;
+	cw_key_deinit(*key);
+	if (is_allocated) {
+		free(*key);
 	}
-
-	free(*key);
 	*key = (cw_key_t *) NULL;
 
 	return;
 }
+
+
+
+
+/**
+   \brief Deinitialize key created with cw_key_init()
+
+   Key is unregistered from its generator. Storage of \p key is not
+   deallocated.
+
+   \param key - key
+*/
+void cw_key_deinit(cw_key_t * key)
+{
+	if (!key) {
+		return;
+	}
+
+	if (key->gen) {
+		/* Unregister. */
+		key->gen->key = NULL;
+		key->gen = (cw_gen_t *) NULL;
+	}
+
+	return;
+}
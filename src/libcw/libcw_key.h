@@ -134,6 +134,11 @@ struct cw_key_struct {
 
 	/* Every key event needs to have a timestamp. */
 	struct timeval timer;
+
+	/* Key was allocated by cw_key_new(), and is deallocated by
+	   cw_key_delete(). False for key created in caller's storage
+	   by cw_key_init(). */
+	bool is_allocated;
 };
 
 
@@ -148,6 +153,7 @@ typedef struct cw_key_struct cw_key_t;
 void cw_key_register_legacy_keying_callback_internal(volatile cw_key_t * key, cw_key_legacy_callback_t callback_func, void * callback_arg);
 
 void cw_key_tk_set_value_internal(volatile cw_key_t * key, int key_state);
+void cw_key_tk_set_value_at_internal(volatile cw_key_t * key, const struct timeval * timestamp, int key_state);
 
 int  cw_key_ik_update_graph_state_internal(volatile cw_key_t * key);
 void cw_key_ik_increment_timer_internal(volatile cw_key_t * key, int usecs);
@@ -74,6 +74,7 @@ extern cw_debug_t cw_debug_object_dev;
 
 #include "libcw_oss.h"
 #include "libcw_gen.h"
+#include "libcw_utils.h"
 
 
 #if   defined(HAVE_SYS_SOUNDCARD_H)
@@ -104,6 +105,7 @@ static const int CW_OSS_SAMPLE_FORMAT = AFMT_S16_NE;  /* Sound format AFMT_S16_N
 static int  cw_oss_open_device_ioctls_internal(int *fd, int *sample_rate);
 static int  cw_oss_get_version_internal(int fd, int *x, int *y, int *z);
 static int  cw_oss_write_internal(cw_gen_t *gen);
+static int64_t cw_oss_get_delay_internal(cw_gen_t *gen);
 static int  cw_oss_open_device_internal(cw_gen_t *gen);
 static void cw_oss_close_device_internal(cw_gen_t *gen);
 
@@ -199,6 +201,7 @@ int cw_oss_configure(cw_gen_t *gen, const char *device)
 	gen->open_device  = cw_oss_open_device_internal;
 	gen->close_device = cw_oss_close_device_internal;
 	gen->write        = cw_oss_write_internal;
+	gen->get_delay    = cw_oss_get_delay_internal;
 
 	return CW_SUCCESS;
 }
@@ -220,14 +223,16 @@ int cw_oss_write_internal(cw_gen_t *gen)
 	assert (gen);
 	assert (gen->audio_system == CW_AUDIO_OSS);
 
-	int n_bytes = sizeof (gen->buffer[0]) * gen->buffer_n_samples;
-	int rv = write(gen->audio_sink, gen->buffer, n_bytes);
+	int n_samples = 0;
+	const cw_sample_t * buffer = cw_gen_get_sink_buffer_internal(gen, &n_samples);
+	int n_bytes = sizeof (buffer[0]) * n_samples;
+	int rv = write(gen->audio_sink, buffer, n_bytes);
 	if (rv != n_bytes) {
 		cw_debug_msg (&cw_debug_object, CW_DEBUG_SOUND_SYSTEM, CW_DEBUG_ERROR,
 			      MSG_PREFIX "write: audio write: %s", strerror(errno));
 		return CW_FAILURE;
 	}
-	// cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_SOUND_SYSTEM, CW_DEBUG_INFO, MSG_PREFIX "written %d samples", gen->buffer_n_samples);
+	// cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_SOUND_SYSTEM, CW_DEBUG_INFO, MSG_PREFIX "written %d samples", n_samples);
 
 	return CW_SUCCESS;
 }
@@ -235,6 +240,35 @@ int cw_oss_write_internal(cw_gen_t *gen)
 
 
 
+/**
+   \brief Get delay of OSS audio sink
+
+   \param gen - generator
+
+   \return time after which a sample written now will be played [us]
+   \return -1 if the delay can't be determined
+*/
+int64_t cw_oss_get_delay_internal(cw_gen_t *gen)
+{
+#ifdef SNDCTL_DSP_GETODELAY
+	int n_bytes = 0;
+	if (-1 == ioctl(gen->audio_sink, SNDCTL_DSP_GETODELAY, &n_bytes)) {
+		cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_SOUND_SYSTEM, CW_DEBUG_WARNING,
+			      MSG_PREFIX "get delay: ioctl(SNDCTL_DSP_GETODELAY): %s", strerror(errno));
+		return -1;
+	}
+
+	const int64_t n_samples = n_bytes / (int) sizeof (gen->buffer[0]);
+	return n_samples * CW_USECS_PER_SEC / cw_gen_get_sink_sample_rate_internal(gen);
+#else
+	(void) gen;
+	return -1;
+#endif
+}
+
+
+
+
 /**
    \brief Open OSS output, associate it with given generator
 
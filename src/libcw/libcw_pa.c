@@ -77,6 +77,7 @@ static int        cw_pa_dlsym_internal(void *handle);
 static int        cw_pa_open_device_internal(cw_gen_t *gen);
 static void       cw_pa_close_device_internal(cw_gen_t *gen);
 static int        cw_pa_write_internal(cw_gen_t *gen);
+static int64_t    cw_pa_get_delay_internal(cw_gen_t *gen);
 
 
 
@@ -200,6 +201,7 @@ int cw_pa_configure(cw_gen_t *gen, const char *dev)
 	gen->open_device  = cw_pa_open_device_internal;
 	gen->close_device = cw_pa_close_device_internal;
 	gen->write        = cw_pa_write_internal;
+	gen->get_delay    = cw_pa_get_delay_internal;
 
 	return CW_SUCCESS;
 }
@@ -223,14 +225,16 @@ int cw_pa_write_internal(cw_gen_t *gen)
 	assert (gen->audio_system == CW_AUDIO_PA);
 
 	int error = 0;
-	size_t n_bytes = sizeof (gen->buffer[0]) * gen->buffer_n_samples;
-	int rv = cw_pa.pa_simple_write(gen->pa_data.s, gen->buffer, n_bytes, &error);
+	int n_samples = 0;
+	const cw_sample_t * buffer = cw_gen_get_sink_buffer_internal(gen, &n_samples);
+	size_t n_bytes = sizeof (buffer[0]) * n_samples;
+	int rv = cw_pa.pa_simple_write(gen->pa_data.s, buffer, n_bytes, &error);
 	if (rv < 0) {
 		cw_debug_msg (&cw_debug_object, CW_DEBUG_SOUND_SYSTEM, CW_DEBUG_ERROR,
 			      MSG_PREFIX "write: pa_simple_write() failed: %s", cw_pa.pa_strerror(error));
 		return CW_FAILURE;
 	} else {
-		//cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_SOUND_SYSTEM, CW_DEBUG_INFO, MSG_PREFIX "written %d samples with PulseAudio", gen->buffer_n_samples);
+		//cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_SOUND_SYSTEM, CW_DEBUG_INFO, MSG_PREFIX "written %d samples with PulseAudio", n_samples);
 		return CW_SUCCESS;
 	}
 }
@@ -238,6 +242,30 @@ int cw_pa_write_internal(cw_gen_t *gen)
 
 
 
+/**
+   \brief Get delay of PulseAudio audio sink
+
+   \param gen - generator
+
+   \return time after which a sample written now will be played [us]
+   \return -1 if the delay can't be determined
+*/
+int64_t cw_pa_get_delay_internal(cw_gen_t *gen)
+{
+	int error = 0;
+	const pa_usec_t latency = cw_pa.pa_simple_get_latency(gen->pa_data.s, &error);
+	if (latency == (pa_usec_t) -1) {
+		cw_debug_msg (&cw_debug_object_dev, CW_DEBUG_SOUND_SYSTEM, CW_DEBUG_WARNING,
+			      MSG_PREFIX "get delay: pa_simple_get_latency() failed: %s", cw_pa.pa_strerror(error));
+		return -1;
+	}
+
+	return (int64_t) latency;
+}
+
+
+
+
 /**
    \brief Wrapper for pa_simple_new()
 
@@ -0,0 +1,325 @@
+/*
+  Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+  Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+/**
+   \file libcw_pool.c
+
+   \brief Storage of generators, receivers and keys provided by
+   client code.
+
+   cw_gen_new(), cw_rec_new() and cw_key_new() allocate their objects
+   with malloc(). A server handling many short sessions can instead
+   take one block of a pool per session, and create session's objects
+   in the block with cw_gen_init(), cw_rec_init() and cw_key_init():
+
+   \code
+   size_t gen_size = cw_gen_get_storage_size();
+   size_t rec_size = cw_rec_get_storage_size();
+   cw_pool_t * pool = cw_pool_new(gen_size + rec_size, n_sessions);
+
+   char * block = cw_pool_alloc(pool);
+   cw_gen_t * gen = cw_gen_init(block, gen_size, CW_AUDIO_NULL, NULL);
+   cw_rec_t * rec = cw_rec_init(block + gen_size, rec_size);
+   ...
+   cw_rec_deinit(rec);
+   cw_gen_deinit(gen);
+   cw_pool_free(pool, block);
+   \endcode
+
+   Storage sizes are multiples of cw_get_storage_alignment(), so
+   objects of a session placed back to back are aligned and
+   contiguous in memory. Blocks of a pool are allocated once, in one
+   array, and are reused without calls to allocator.
+*/
+
+
+
+
+#include "config.h"
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+
+
+#include "libcw_pool.h"
+#include "libcw_debug.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+#define MSG_PREFIX "libcw/pool: "
+
+
+
+
+/* From libcw_debug.c. */
+extern cw_debug_t cw_debug_object;
+
+
+
+
+struct cw_pool_struct {
+	char * blocks;       /* Array of n_blocks blocks. */
+	size_t block_size;   /* Multiple of CW_STORAGE_ALIGNMENT. */
+	size_t n_blocks;
+
+	/* Free blocks are linked through their first bytes. */
+	void * free_list;
+	size_t n_free;
+
+	pthread_mutex_t mutex;
+};
+
+
+
+
+/**
+   \brief Get alignment of storage of objects
+
+   Storage passed to cw_gen_init(), cw_rec_init() and cw_key_init()
+   must be aligned to this value. Memory returned by malloc() and
+   blocks of cw_pool_t are aligned correctly.
+
+   \return alignment [bytes]
+*/
+size_t cw_get_storage_alignment(void)
+{
+	return CW_STORAGE_ALIGNMENT;
+}
+
+
+
+
+/**
+   \brief Check storage provided by client code
+
+   \param storage - storage
+   \param size - size of \p storage
+   \param required_size - size of object to be placed in \p storage
+
+   \return true if \p storage can hold the object
+   \return false otherwise
+*/
+bool cw_storage_is_valid_internal(const void * storage, size_t size, size_t required_size)
+{
+	return storage
+		&& size >= required_size
+		&& 0 == (uintptr_t) storage % CW_STORAGE_ALIGNMENT;
+}
+
+
+
+
+/**
+   \brief Create new pool of blocks
+
+   All blocks are allocated at once. Size of blocks is rounded up to
+   multiple of cw_get_storage_alignment().
+
+   \errno EINVAL - \p block_size or \p n_blocks is zero
+   \errno ENOMEM - pool is too large
+
+   \param block_size - size of a block [bytes]
+   \param n_blocks - count of blocks
+
+   \return pointer to new pool on success
+   \return NULL on failure
+*/
+cw_pool_t * cw_pool_new(size_t block_size, size_t n_blocks)
+{
+	if (0 == block_size || 0 == n_blocks) {
+		errno = EINVAL;
+		return (cw_pool_t *) NULL;
+	}
+
+	block_size = CW_STORAGE_SIZE(block_size);
+	if (block_size < sizeof (void *) || n_blocks > SIZE_MAX / block_size) {
+		errno = ENOMEM;
+		return (cw_pool_t *) NULL;
+	}
+
+	cw_pool_t * pool = (cw_pool_t *) malloc(sizeof (cw_pool_t));
+	if (!pool) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "new: malloc()");
+		return (cw_pool_t *) NULL;
+	}
+
+	void * blocks = NULL;
+	if (0 != posix_memalign(&blocks, CW_STORAGE_ALIGNMENT, block_size * n_blocks)) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "new: posix_memalign()");
+		free(pool);
+		errno = ENOMEM;
+		return (cw_pool_t *) NULL;
+	}
+
+	pool->blocks = (char *) blocks;
+	pool->block_size = block_size;
+	pool->n_blocks = n_blocks;
+
+	/* Link blocks in order of addresses, so that blocks taken
+	   one after another are adjacent. */
+	pool->free_list = NULL;
+	for (size_t i = n_blocks; i > 0; i--) {
+		void * block = pool->blocks + (i - 1) * block_size;
+		*(void **) block = pool->free_list;
+		pool->free_list = block;
+	}
+	pool->n_free = n_blocks;
+
+	pthread_mutex_init(&pool->mutex, NULL);
+
+	return pool;
+}
+
+
+
+
+/**
+   \brief Delete pool
+
+   Objects created in blocks of the pool must be deinitialized
+   before the pool is deleted.
+
+   \param pool - pointer to pool
+*/
+void cw_pool_delete(cw_pool_t ** pool)
+{
+	cw_assert (pool, MSG_PREFIX "delete: 'pool' argument can't be NULL\n");
+
+	if (!*pool) {
+		return;
+	}
+
+	pthread_mutex_destroy(&(*pool)->mutex);
+	free((*pool)->blocks);
+	free(*pool);
+	*pool = (cw_pool_t *) NULL;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Take a block from pool
+
+   The function can be called from many threads.
+
+   \errno ENOMEM - all blocks are taken
+
+   \param pool - pool
+
+   \return pointer to block on success
+   \return NULL on failure
+*/
+void * cw_pool_alloc(cw_pool_t * pool)
+{
+	pthread_mutex_lock(&pool->mutex);
+
+	void * block = pool->free_list;
+	if (block) {
+		pool->free_list = *(void **) block;
+		pool->n_free--;
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (!block) {
+		errno = ENOMEM;
+	}
+	return block;
+}
+
+
+
+
+/**
+   \brief Return a block to pool
+
+   The function can be called from many threads.
+
+   \errno EINVAL - \p block is not a block of \p pool
+
+   \param pool - pool
+   \param block - block taken with cw_pool_alloc()
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_pool_free(cw_pool_t * pool, void * block)
+{
+	const char * b = (const char *) block;
+	if (!b
+	    || b < pool->blocks
+	    || b >= pool->blocks + pool->n_blocks * pool->block_size
+	    || 0 != (size_t) (b - pool->blocks) % pool->block_size) {
+
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+
+	*(void **) block = pool->free_list;
+	pool->free_list = block;
+	pool->n_free++;
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \param pool - pool
+
+   \return size of blocks of \p pool [bytes]
+*/
+size_t cw_pool_get_block_size(cw_pool_t const * pool)
+{
+	return pool->block_size;
+}
+
+
+
+
+/**
+   \param pool - pool
+
+   \return count of blocks that can be taken from \p pool
+*/
+size_t cw_pool_get_n_free(cw_pool_t * pool)
+{
+	pthread_mutex_lock(&pool->mutex);
+	const size_t n_free = pool->n_free;
+	pthread_mutex_unlock(&pool->mutex);
+
+	return n_free;
+}
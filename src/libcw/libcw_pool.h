@@ -0,0 +1,40 @@
+/*
+  This file is a part of unixcw project.
+  unixcw project is covered by GNU General Public License, version 2 or later.
+*/
+
+#ifndef H_LIBCW_POOL
+#define H_LIBCW_POOL
+
+
+
+
+#include <stddef.h>
+#include <stdbool.h>
+
+
+
+
+/* Alignment of storage of objects created in memory provided by
+   client code (cw_gen_init(), cw_rec_init(), cw_key_init()), and of
+   blocks of pool. */
+#define CW_STORAGE_ALIGNMENT ((size_t) __BIGGEST_ALIGNMENT__)
+
+/* Size rounded up to multiple of CW_STORAGE_ALIGNMENT. */
+#define CW_STORAGE_SIZE(size) ((((size) + CW_STORAGE_ALIGNMENT - 1) / CW_STORAGE_ALIGNMENT) * CW_STORAGE_ALIGNMENT)
+
+
+
+
+/* Pool of blocks of memory of equal size. */
+typedef struct cw_pool_struct cw_pool_t;
+
+
+
+
+bool cw_storage_is_valid_internal(const void * storage, size_t size, size_t required_size);
+
+
+
+
+#endif /* #ifndef H_LIBCW_POOL */
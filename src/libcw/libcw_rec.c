@@ -42,11 +42,15 @@
    above functions from first method.
 
 
-   Currently there is only one method of passing received data
-   (characters) from receiver to client code. This is done by client
-   code cyclically polling the receiver with
-   cw_rec_poll_representation() or cw_rec_poll_character() (which
-   itself is built on top of cw_rec_poll_representation()).
+   There are two methods of passing received data (characters) from
+   receiver to client code. First of them is client code cyclically
+   polling the receiver with cw_rec_poll_representation() or
+   cw_rec_poll_character() (which itself is built on top of
+   cw_rec_poll_representation()).
+
+   The second method is a queue of received characters, to which
+   receiver puts characters as soon as they are recognized (see
+   cw_rec_start_output() in libcw_rec_output.c).
 
 
    Duration (length) of marks, spaces and few other things is in
@@ -85,11 +89,13 @@
 
 
 #include "libcw_utils.h"
+#include "libcw_pool.h"
 #include "libcw.h"
 #include "libcw_rec.h"
 #include "libcw_rec_internal.h"
 #include "libcw_key.h"
 #include "libcw_data.h"
+#include "libcw_alphabet.h"
 #include "libcw_debug.h"
 #include "libcw2.h"
 
@@ -128,6 +134,12 @@ static void cw_rec_update_average_internal(cw_rec_averaging_t * avg, int mark_le
 static void cw_rec_update_averages_internal(cw_rec_t * rec, int mark_len, char mark);
 static void cw_rec_reset_average_internal(cw_rec_averaging_t * avg, int initial);
 
+/* Functions feeding marks to receiver, called with receiver locked
+   (see libcw_rec_output.c). */
+static int cw_rec_mark_begin_internal(cw_rec_t * rec, const volatile struct timeval * timestamp);
+static int cw_rec_mark_end_internal(cw_rec_t * rec, const volatile struct timeval * timestamp);
+static int cw_rec_add_mark_internal(cw_rec_t * rec, const volatile struct timeval * timestamp, char mark);
+
 
 
 
@@ -144,14 +156,64 @@ static void cw_rec_reset_average_internal(cw_rec_averaging_t * avg, int initial)
 */
 cw_rec_t * cw_rec_new(void)
 {
-	cw_rec_t *rec = (cw_rec_t *) malloc(sizeof (cw_rec_t));
-	if (!rec) {
+	const size_t size = cw_rec_get_storage_size();
+	void * storage = NULL;
+	if (0 != posix_memalign(&storage, CW_STORAGE_ALIGNMENT, size)) {
 		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
-			      MSG_PREFIX "new: malloc()");
+			      MSG_PREFIX "new: posix_memalign()");
 		return (cw_rec_t *) NULL;
 	}
 
+	cw_rec_t * rec = cw_rec_init(storage, size);
+	rec->is_allocated = true;
+
+	return rec;
+}
+
+
+
+
+/**
+   \brief Get size of storage for receiver
+
+   The size is a multiple of cw_get_storage_alignment().
+
+   \return size of storage required by cw_rec_init() [bytes]
+*/
+size_t cw_rec_get_storage_size(void)
+{
+	return CW_STORAGE_SIZE(sizeof (cw_rec_t));
+}
+
+
+
+
+/**
+   \brief Initialize new receiver in storage provided by caller
+
+   Storage of \p size bytes, aligned to cw_get_storage_alignment(),
+   must be provided by caller and must outlive the receiver. Storages
+   may be taken from cw_pool_t.
+
+   \errno EINVAL - storage is NULL, too small, or misaligned
+
+   \param storage - memory for receiver
+   \param size - size of \p storage, at least cw_rec_get_storage_size()
+
+   \return initialized and synchronized receiver on success (equal to \p storage)
+   \return NULL pointer on failure
+*/
+cw_rec_t * cw_rec_init(void * storage, size_t size)
+{
+	if (!cw_storage_is_valid_internal(storage, size, cw_rec_get_storage_size())) {
+		errno = EINVAL;
+		return (cw_rec_t *) NULL;
+	}
+
+	cw_rec_t *rec = (cw_rec_t *) storage;
+
 	memset(rec, 0, sizeof (cw_rec_t));
+	rec->is_allocated = false;
 
 	rec->state = RS_IDLE;
 
@@ -222,6 +284,10 @@ cw_rec_t * cw_rec_new(void)
 	rec->push_callback = NULL;
 #endif
 
+	rec->output.is_running = false;
+	rec->output.fd = -1;
+	rec->output.write_fd = -1;
+
 	return rec;
 }
 
@@ -232,7 +298,8 @@ cw_rec_t * cw_rec_new(void)
    \brief Delete a generator
 
    Deallocate all memory and free all resources associated with given
-   receiver.
+   receiver. Storage of receiver created with cw_rec_init() is not
+   deallocated.
 
    \reviewed on 2017-02-02
 
@@ -246,7 +313,12 @@ void cw_rec_delete(cw_rec_t ** rec)
 		return;
 	}
 
-	free(*rec);
+	if ((*rec)->is_allocated) {
+		cw_rec_stop_output(*rec);
+		free(*rec);
+	} else {
+		cw_rec_deinit(*rec);
+	}
 	*rec = (cw_rec_t *) NULL;
 
 	return;
@@ -255,6 +327,30 @@ void cw_rec_delete(cw_rec_t ** rec)
 
 
 
+/**
+   \brief Deinitialize receiver created with cw_rec_init()
+
+   Queue of received characters is stopped (see
+   cw_rec_start_output()). Client code should call the function
+   before storage of the receiver is reused.
+
+   \param rec - receiver
+*/
+void cw_rec_deinit(cw_rec_t * rec)
+{
+	if (!rec) {
+		return;
+	}
+
+	cw_rec_stop_output(rec);
+	rec->state = RS_IDLE;
+
+	return;
+}
+
+
+
+
 /**
    \brief Set receiver's receiving speed
 
@@ -559,6 +655,7 @@ void cw_rec_reset_average_internal(cw_rec_averaging_t *avg, int initial)
 	}
 
 	avg->sum = initial * CW_REC_AVERAGING_ARRAY_LENGTH;
+	avg->average = initial;
 	avg->cursor = 0;
 
 	return;
@@ -929,6 +1026,23 @@ bool cw_rec_get_adaptive_mode(const cw_rec_t * rec)
 
 */
 int cw_rec_mark_begin(cw_rec_t * rec, const volatile struct timeval * timestamp)
+{
+	cw_rec_output_lock_internal(rec);
+	const int rv = cw_rec_mark_begin_internal(rec, timestamp);
+	cw_rec_output_unlock_internal(rec);
+
+	return rv;
+}
+
+
+
+
+/**
+   \brief Handle beginning of mark, with receiver locked
+
+   See cw_rec_mark_begin().
+*/
+int cw_rec_mark_begin_internal(cw_rec_t * rec, const volatile struct timeval * timestamp)
 {
 	if (rec->is_pending_inter_word_space) {
 
@@ -1011,6 +1125,23 @@ int cw_rec_mark_begin(cw_rec_t * rec, const volatile struct timeval * timestamp)
    \return CW_FAILURE otherwise
 */
 int cw_rec_mark_end(cw_rec_t * rec, const volatile struct timeval * timestamp)
+{
+	cw_rec_output_lock_internal(rec);
+	const int rv = cw_rec_mark_end_internal(rec, timestamp);
+	cw_rec_output_unlock_internal(rec);
+
+	return rv;
+}
+
+
+
+
+/**
+   \brief Handle end of mark, with receiver locked
+
+   See cw_rec_mark_end().
+*/
+int cw_rec_mark_end_internal(cw_rec_t * rec, const volatile struct timeval * timestamp)
 {
 	/* The receive state is expected to be inside of a mark. */
 	if (rec->state != RS_MARK) {
@@ -1351,6 +1482,23 @@ void cw_rec_update_averages_internal(cw_rec_t *rec, int mark_len, char mark)
    \return CW_FAILURE on failure
 */
 int cw_rec_add_mark(cw_rec_t * rec, const volatile struct timeval * timestamp, char mark)
+{
+	cw_rec_output_lock_internal(rec);
+	const int rv = cw_rec_add_mark_internal(rec, timestamp, mark);
+	cw_rec_output_unlock_internal(rec);
+
+	return rv;
+}
+
+
+
+
+/**
+   \brief Handle full mark, with receiver locked
+
+   See cw_rec_add_mark().
+*/
+int cw_rec_add_mark_internal(cw_rec_t * rec, const volatile struct timeval * timestamp, char mark)
 {
 	/* The receiver's state is expected to be idle or
 	   inter-mark-space in order to use this routine. */
@@ -1740,6 +1888,94 @@ int cw_rec_poll_character(cw_rec_t * rec,
 
 
 
+/**
+   \brief Try to get a received character, encoded in UTF-8
+
+   The function works as cw_rec_poll_character(), but the
+   representation is looked up in receiver's alphabet (see
+   cw_rec_set_alphabet()), and the character is returned as
+   NUL-terminated UTF-8 string.
+
+   \errno ERANGE, EAGAIN - see cw_rec_poll_representation()
+   \errno ENOENT - received representation doesn't match any character of the alphabet
+
+   \param rec - receiver
+   \param timestamp - timestamp of poll (may be NULL)
+   \param character - buffer of CW_ALPHABET_UTF8_SIZE bytes for received character (may be NULL)
+   \param is_end_of_word - end of word flag (may be NULL)
+   \param is_error - error flag (may be NULL)
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_rec_poll_utf8_character(cw_rec_t * rec,
+			       const struct timeval * timestamp,
+			       /* out */ char * character,
+			       /* out */ bool * is_end_of_word,
+			       /* out */ bool * is_error)
+{
+	bool end_of_word, error;
+	char representation[CW_REC_REPRESENTATION_CAPACITY + 1];
+
+	if (!cw_rec_poll_representation(rec, timestamp, representation, &end_of_word, &error)) {
+		return CW_FAILURE;
+	}
+
+	const uint32_t codepoint = cw_alphabet_representation_to_codepoint(rec->alphabet, representation);
+	if (!codepoint) {
+		errno = ENOENT;
+		return CW_FAILURE;
+	}
+
+	/* See cw_rec_poll_character(). */
+	if (!end_of_word) {
+		rec->is_pending_inter_word_space = true;
+	}
+
+	if (character) {
+		cw_utf8_encode_internal(codepoint, character);
+	}
+	if (is_end_of_word) {
+		*is_end_of_word = end_of_word;
+	}
+	if (is_error) {
+		*is_error = error;
+	}
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Set alphabet of receiver
+
+   The alphabet is used by cw_rec_poll_utf8_character(). By default
+   receiver uses CW_ALPHABET_LATIN.
+
+   \errno EINVAL - invalid alphabet
+
+   \param rec - receiver
+   \param alphabet - alphabet (CW_ALPHABET_*)
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_rec_set_alphabet(cw_rec_t * rec, int alphabet)
+{
+	if (alphabet < 0 || alphabet >= CW_ALPHABET_MAX) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	rec->alphabet = alphabet;
+
+	return CW_SUCCESS;
+}
+
+
+
+
 /**
    \brief Reset state of receiver
 
@@ -1944,6 +2180,51 @@ void cw_rec_sync_parameters_internal(cw_rec_t *rec)
 
 
 
+/**
+   \brief Get time at which receiver will have a complete character
+
+   Client code that doesn't want to poll receiver periodically can
+   use this function to learn when a call to
+   cw_rec_poll_character() will be able to return a character
+   that is being received, or, after the character has been polled
+   (see cw_rec_poll_is_pending_inter_word_space()), when it will be
+   able to return end of word.
+
+   \errno ERANGE - receiver is neither between marks of a character, nor waiting for end of word
+
+   \param rec - receiver
+   \param timestamp - time of end of current character, or of current word
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_rec_get_character_time(cw_rec_t * rec, struct timeval * timestamp)
+{
+	const bool is_eow_pending = rec->is_pending_inter_word_space
+		&& (rec->state == RS_EOC_GAP || rec->state == RS_EOC_GAP_ERR);
+	if (rec->state != RS_IMARK_SPACE && !is_eow_pending) {
+		errno = ERANGE;
+		return CW_FAILURE;
+	}
+
+	/* Synchronize parameters if required */
+	cw_rec_sync_parameters_internal(rec);
+
+	/* Space longer than eoc_len_max is inter-word space. */
+	const int space_len = is_eow_pending ? rec->eoc_len_max + 1 : rec->eoc_len_min;
+	timestamp->tv_sec = rec->mark_end.tv_sec + space_len / CW_USECS_PER_SEC;
+	timestamp->tv_usec = rec->mark_end.tv_usec + space_len % CW_USECS_PER_SEC;
+	if (timestamp->tv_usec >= CW_USECS_PER_SEC) {
+		timestamp->tv_sec++;
+		timestamp->tv_usec -= CW_USECS_PER_SEC;
+	}
+
+	return CW_SUCCESS;
+}
+
+
+
+
 /**
    \param rec - receiver
 */
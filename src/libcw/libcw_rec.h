@@ -18,6 +18,7 @@
 
 
 #include "libcw.h"
+#include "libcw_rec_output.h"
 
 
 
@@ -216,6 +217,17 @@ struct cw_rec_struct {
 	   space on a later poll. */
 	bool is_pending_inter_word_space;
 
+	/* Alphabet used by cw_rec_poll_utf8_character(), see
+	   CW_ALPHABET_*. */
+	int alphabet;
+
+	/* Queue of received characters, see libcw_rec_output.c. */
+	cw_rec_output_queue_t output;
+
+	/* Receiver was allocated by cw_rec_new(), and is deallocated
+	   by cw_rec_delete(). False for receiver created in caller's
+	   storage by cw_rec_init(). */
+	bool is_allocated;
 };
 
 
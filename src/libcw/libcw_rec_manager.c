@@ -0,0 +1,599 @@
+/*
+  Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+  Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+/**
+   \file libcw_rec_manager.c
+
+   \brief Manager of many receivers, fed with key events in batches.
+
+   Each receiver needs to be polled when a space after its last mark
+   becomes long enough to be an inter-character space, and then when
+   it becomes long enough to be an inter-word space (see
+   cw_rec_poll_character()). Manager owns many receivers and keeps
+   times of these polls (deadlines) in one timing wheel, so that
+   client code doesn't have to poll each receiver.
+
+   Client code passes key events of all receivers to
+   cw_rec_manager_process(), and periodically calls
+   cw_rec_manager_advance() with current time. Recognized characters
+   are passed to callback function. Manager doesn't have threads and
+   doesn't read clock: time of manager is time of events and time
+   passed to cw_rec_manager_advance().
+
+   Timing wheel is hierarchical: CW_REC_MANAGER_N_LEVELS levels of
+   CW_REC_MANAGER_N_SLOTS slots each. Level 0 has one slot per tick
+   (CW_REC_MANAGER_TICK), and each slot of next level covers all slots
+   of previous level. Deadlines far in future are kept in higher
+   levels, and are moved to lower levels ("cascaded") as time of
+   manager approaches them. Scheduling, rescheduling and cancelling a
+   deadline takes constant time, so cost of handling of an event
+   doesn't depend on count of receivers.
+*/
+
+
+
+
+#include "config.h"
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+
+
+
+
+#include "libcw_rec.h"
+#include "libcw_rec_output.h"
+#include "libcw_rec_manager.h"
+#include "libcw_pool.h"
+#include "libcw_utils.h"
+#include "libcw_debug.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+#define MSG_PREFIX "libcw/rec_manager: "
+
+
+
+
+/* From libcw_debug.c. */
+extern cw_debug_t cw_debug_object;
+
+
+
+
+/* Geometry of timing wheel. With 1 ms ticks, the wheel covers
+   deadlines up to 64^4 ms (4.6 hours) in future. Later deadlines are
+   kept in last slot and cascaded again. */
+#define CW_REC_MANAGER_SLOT_BITS      6
+#define CW_REC_MANAGER_N_SLOTS        (1 << CW_REC_MANAGER_SLOT_BITS)
+#define CW_REC_MANAGER_SLOT_MASK      (CW_REC_MANAGER_N_SLOTS - 1)
+#define CW_REC_MANAGER_N_LEVELS       4
+
+/* End of list of timers. */
+#define CW_REC_MANAGER_NONE          -1
+
+
+
+
+/* Deadline of one receiver, linked in list of one slot of timing wheel. */
+typedef struct {
+	cw_rec_t * rec;
+	struct timeval deadline;   /* Time at which receiver must be polled. */
+	int64_t expires;           /* Deadline rounded up to tick. [ticks] */
+	int slot;                  /* Slot of wheel, CW_REC_MANAGER_NONE if receiver has no deadline. */
+	int prev;
+	int next;
+} cw_rec_manager_timer_t;
+
+
+struct cw_rec_manager_struct {
+	void * storage;                        /* Storage of all receivers. */
+	cw_rec_manager_timer_t * timers;       /* One timer per receiver. */
+	int n_receivers;
+
+	/* First timer in each slot of each level of wheel. */
+	int slots[CW_REC_MANAGER_N_LEVELS * CW_REC_MANAGER_N_SLOTS];
+	int n_scheduled;
+
+	/* All ticks before this one have been processed. Set from
+	   first timestamp seen by manager. */
+	int64_t tick;
+	bool is_started;
+
+	cw_rec_manager_callback_t callback;
+	void * callback_arg;
+};
+
+
+
+
+static int64_t cw_rec_manager_to_ticks_internal(const struct timeval * timestamp, bool round_up);
+static void cw_rec_manager_start_internal(cw_rec_manager_t * manager, const struct timeval * timestamp);
+static void cw_rec_manager_link_internal(cw_rec_manager_t * manager, int i);
+static void cw_rec_manager_unlink_internal(cw_rec_manager_t * manager, int i);
+static void cw_rec_manager_schedule_internal(cw_rec_manager_t * manager, int i);
+static void cw_rec_manager_fire_internal(cw_rec_manager_t * manager, int i);
+static void cw_rec_manager_cascade_internal(cw_rec_manager_t * manager);
+
+
+
+
+/**
+   \brief Create new manager of receivers
+
+   All receivers are initialized with default parameters. Parameters
+   of receivers can be changed with cw_rec_set_*() functions called
+   on receivers returned by cw_rec_manager_get_receiver(), but
+   receivers must not be fed with marks, polled or deleted by client
+   code.
+
+   \errno EINVAL - invalid \p n_receivers, or \p callback is NULL
+
+   \param n_receivers - count of receivers (up to CW_REC_MANAGER_N_RECEIVERS_MAX)
+   \param callback - function called for each recognized character
+   \param callback_arg - first argument of \p callback
+
+   \return pointer to new manager on success
+   \return NULL on failure
+*/
+cw_rec_manager_t * cw_rec_manager_new(int n_receivers, cw_rec_manager_callback_t callback, void * callback_arg)
+{
+	if (n_receivers <= 0 || n_receivers > CW_REC_MANAGER_N_RECEIVERS_MAX || !callback) {
+		errno = EINVAL;
+		return (cw_rec_manager_t *) NULL;
+	}
+
+	cw_rec_manager_t * manager = (cw_rec_manager_t *) malloc(sizeof (cw_rec_manager_t));
+	if (!manager) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "new: malloc()");
+		return (cw_rec_manager_t *) NULL;
+	}
+
+	const size_t rec_size = cw_rec_get_storage_size();
+	manager->storage = NULL;
+	manager->timers = (cw_rec_manager_timer_t *) malloc((size_t) n_receivers * sizeof (cw_rec_manager_timer_t));
+	if (!manager->timers
+	    || 0 != posix_memalign(&manager->storage, CW_STORAGE_ALIGNMENT, (size_t) n_receivers * rec_size)) {
+
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "new: failed to allocate %d receivers", n_receivers);
+		free(manager->timers);
+		free(manager);
+		return (cw_rec_manager_t *) NULL;
+	}
+
+	for (int i = 0; i < n_receivers; i++) {
+		cw_rec_manager_timer_t * timer = &manager->timers[i];
+		timer->rec = cw_rec_init((char *) manager->storage + (size_t) i * rec_size, rec_size);
+		timer->slot = CW_REC_MANAGER_NONE;
+		timer->prev = CW_REC_MANAGER_NONE;
+		timer->next = CW_REC_MANAGER_NONE;
+	}
+	manager->n_receivers = n_receivers;
+
+	for (int s = 0; s < CW_REC_MANAGER_N_LEVELS * CW_REC_MANAGER_N_SLOTS; s++) {
+		manager->slots[s] = CW_REC_MANAGER_NONE;
+	}
+	manager->n_scheduled = 0;
+	manager->tick = 0;
+	manager->is_started = false;
+
+	manager->callback = callback;
+	manager->callback_arg = callback_arg;
+
+	return manager;
+}
+
+
+
+
+/**
+   \brief Delete manager of receivers
+
+   All receivers of the manager are deleted too. Characters that
+   haven't been recognized yet are discarded.
+
+   \param manager - pointer to manager
+*/
+void cw_rec_manager_delete(cw_rec_manager_t ** manager)
+{
+	cw_assert (manager, MSG_PREFIX "delete: 'manager' argument can't be NULL\n");
+
+	if (!*manager) {
+		return;
+	}
+
+	for (int i = 0; i < (*manager)->n_receivers; i++) {
+		cw_rec_deinit((*manager)->timers[i].rec);
+	}
+	free((*manager)->storage);
+	free((*manager)->timers);
+	free(*manager);
+	*manager = (cw_rec_manager_t *) NULL;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Get one of receivers of manager
+
+   \errno EINVAL - invalid \p receiver
+
+   \param manager - manager
+   \param receiver - index of receiver
+
+   \return receiver on success
+   \return NULL on failure
+*/
+cw_rec_t * cw_rec_manager_get_receiver(cw_rec_manager_t * manager, int receiver)
+{
+	if (receiver < 0 || receiver >= manager->n_receivers) {
+		errno = EINVAL;
+		return (cw_rec_t *) NULL;
+	}
+
+	return manager->timers[receiver].rec;
+}
+
+
+
+
+/**
+   \brief Pass a batch of key events to receivers of manager
+
+   Events of one receiver must be in order of their timestamps. Events
+   of different receivers may be mixed in any order, but no event may
+   be earlier than time passed in last call to
+   cw_rec_manager_advance().
+
+   Before an event is passed to its receiver, the receiver's character
+   (if any) whose deadline is before the event is recognized. Events
+   rejected by receivers (e.g. noise spikes) are ignored.
+
+   \errno EINVAL - one or more events have invalid index of receiver
+   or invalid key state (these events are skipped)
+
+   \param manager - manager
+   \param events - events
+   \param n_events - count of events
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_rec_manager_process(cw_rec_manager_t * manager, const cw_rec_manager_event_t * events, size_t n_events)
+{
+	bool has_invalid = false;
+
+	for (size_t e = 0; e < n_events; e++) {
+		const cw_rec_manager_event_t * event = &events[e];
+		if (event->receiver < 0 || event->receiver >= manager->n_receivers
+		    || (event->key_state != CW_KEY_STATE_OPEN && event->key_state != CW_KEY_STATE_CLOSED)) {
+
+			has_invalid = true;
+			continue;
+		}
+		if (!manager->is_started) {
+			cw_rec_manager_start_internal(manager, &event->timestamp);
+		}
+
+		const int i = event->receiver;
+		cw_rec_manager_timer_t * timer = &manager->timers[i];
+
+		/* Space before this event may have been long enough
+		   to end a character or a word. Fire the deadline
+		   now, as the wheel may not have reached it yet. */
+		while (timer->slot != CW_REC_MANAGER_NONE
+		       && !timercmp(&event->timestamp, &timer->deadline, <)) {
+
+			cw_rec_manager_unlink_internal(manager, i);
+			cw_rec_manager_fire_internal(manager, i);
+		}
+
+		int cwret;
+		if (event->key_state == CW_KEY_STATE_CLOSED) {
+			cwret = cw_rec_mark_begin(timer->rec, &event->timestamp);
+		} else {
+			cwret = cw_rec_mark_end(timer->rec, &event->timestamp);
+		}
+		if (!cwret) {
+			cw_debug_msg (&cw_debug_object, CW_DEBUG_RECEIVE_STATES, CW_DEBUG_DEBUG,
+				      MSG_PREFIX "process: receiver %d rejected event %d: errno = %d", i, event->key_state, errno);
+		}
+
+		cw_rec_manager_schedule_internal(manager, i);
+	}
+
+	if (has_invalid) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Advance time of manager
+
+   Characters and inter-word spaces of all receivers, whose deadlines
+   are not later than \p timestamp, are recognized and passed to
+   callback of manager.
+
+   \param manager - manager
+   \param timestamp - current time
+*/
+void cw_rec_manager_advance(cw_rec_manager_t * manager, const struct timeval * timestamp)
+{
+	if (!manager->is_started) {
+		cw_rec_manager_start_internal(manager, timestamp);
+	}
+
+	const int64_t target = cw_rec_manager_to_ticks_internal(timestamp, false);
+	while (manager->tick <= target) {
+		if (!manager->n_scheduled) {
+			/* Nothing to do in skipped ticks. Slots of
+			   all levels are empty, so no cascading is
+			   missed. */
+			manager->tick = target + 1;
+			break;
+		}
+
+		if ((manager->tick & CW_REC_MANAGER_SLOT_MASK) == 0) {
+			cw_rec_manager_cascade_internal(manager);
+		}
+
+		/* Timers fired in this tick may be scheduled again
+		   in this tick (inter-word space directly after
+		   character), so take them one by one. */
+		const int s = (int) (manager->tick & CW_REC_MANAGER_SLOT_MASK);
+		while (manager->slots[s] != CW_REC_MANAGER_NONE) {
+			const int i = manager->slots[s];
+			cw_rec_manager_unlink_internal(manager, i);
+			cw_rec_manager_fire_internal(manager, i);
+		}
+
+		manager->tick++;
+	}
+
+	return;
+}
+
+
+
+
+/**
+   \brief Get count of receivers of manager that wait for their deadlines
+
+   \param manager - manager
+
+   \return count of receivers with characters or inter-word spaces not recognized yet
+*/
+int cw_rec_manager_get_n_pending(cw_rec_manager_t const * manager)
+{
+	return manager->n_scheduled;
+}
+
+
+
+
+int64_t cw_rec_manager_to_ticks_internal(const struct timeval * timestamp, bool round_up)
+{
+	const int64_t usecs = (int64_t) timestamp->tv_sec * CW_USECS_PER_SEC + timestamp->tv_usec;
+	if (round_up) {
+		return (usecs + CW_REC_MANAGER_TICK - 1) / CW_REC_MANAGER_TICK;
+	} else {
+		return usecs / CW_REC_MANAGER_TICK;
+	}
+}
+
+
+
+
+void cw_rec_manager_start_internal(cw_rec_manager_t * manager, const struct timeval * timestamp)
+{
+	manager->tick = cw_rec_manager_to_ticks_internal(timestamp, false);
+	manager->is_started = true;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Recognize character or inter-word space of receiver whose deadline has come
+
+   Timer of receiver must be unlinked from wheel.
+*/
+void cw_rec_manager_fire_internal(cw_rec_manager_t * manager, int i)
+{
+	cw_rec_manager_timer_t * timer = &manager->timers[i];
+
+	/* Receiver is polled at its deadline, not at current time of
+	   manager, so that a character followed by a long space is
+	   recognized in the same way as when polled in time. */
+	cw_rec_output_t items[2];
+	const int n_items = cw_rec_output_decide_internal(timer->rec, &timer->deadline, items);
+	for (int k = 0; k < n_items; k++) {
+		manager->callback(manager->callback_arg, i, &items[k]);
+	}
+
+	const struct timeval fired = timer->deadline;
+	cw_rec_manager_schedule_internal(manager, i);
+	if (!n_items
+	    && timer->slot != CW_REC_MANAGER_NONE
+	    && !timercmp(&timer->deadline, &fired, >)) {
+
+		/* Nothing could be recognized, and the deadline
+		   hasn't moved. Leave receiver alone until its next
+		   mark, instead of firing the same deadline again. */
+		cw_rec_manager_unlink_internal(manager, i);
+	} else {
+		/* Deadline of inter-word space, or deadline moved by
+		   change of receiver's parameters. */
+	}
+
+	return;
+}
+
+
+
+
+/**
+   \brief Put timer of receiver into wheel, or remove it from wheel
+
+   Timer is put into wheel if receiver has something to recognize.
+*/
+void cw_rec_manager_schedule_internal(cw_rec_manager_t * manager, int i)
+{
+	cw_rec_manager_timer_t * timer = &manager->timers[i];
+
+	if (timer->slot != CW_REC_MANAGER_NONE) {
+		cw_rec_manager_unlink_internal(manager, i);
+	}
+
+	if (!cw_rec_output_deadline_internal(timer->rec, &timer->deadline)) {
+		return;
+	}
+	timer->expires = cw_rec_manager_to_ticks_internal(&timer->deadline, true);
+	cw_rec_manager_link_internal(manager, i);
+
+	return;
+}
+
+
+
+
+/**
+   \brief Link timer into slot of wheel matching its expiry
+*/
+void cw_rec_manager_link_internal(cw_rec_manager_t * manager, int i)
+{
+	cw_rec_manager_timer_t * timer = &manager->timers[i];
+
+	int64_t expires = timer->expires;
+	if (expires < manager->tick) {
+		/* Deadline has passed. Fire it in next processed tick. */
+		expires = manager->tick;
+	}
+
+	/* Find the lowest level whose range covers the deadline. */
+	const int64_t delta = expires - manager->tick;
+	int level = 0;
+	while (level < CW_REC_MANAGER_N_LEVELS - 1
+	       && (delta >> (CW_REC_MANAGER_SLOT_BITS * (level + 1))) != 0) {
+		level++;
+	}
+	if ((delta >> (CW_REC_MANAGER_SLOT_BITS * CW_REC_MANAGER_N_LEVELS)) != 0) {
+		/* Beyond range of wheel: keep it in the farthest slot
+		   of the last level, and look at it again when the
+		   slot is cascaded. */
+		expires = manager->tick + ((int64_t) 1 << (CW_REC_MANAGER_SLOT_BITS * CW_REC_MANAGER_N_LEVELS)) - 1;
+	}
+
+	const int slot = level * CW_REC_MANAGER_N_SLOTS
+		+ (int) ((expires >> (CW_REC_MANAGER_SLOT_BITS * level)) & CW_REC_MANAGER_SLOT_MASK);
+
+	timer->slot = slot;
+	timer->prev = CW_REC_MANAGER_NONE;
+	timer->next = manager->slots[slot];
+	if (timer->next != CW_REC_MANAGER_NONE) {
+		manager->timers[timer->next].prev = i;
+	}
+	manager->slots[slot] = i;
+	manager->n_scheduled++;
+
+	return;
+}
+
+
+
+
+void cw_rec_manager_unlink_internal(cw_rec_manager_t * manager, int i)
+{
+	cw_rec_manager_timer_t * timer = &manager->timers[i];
+
+	if (timer->prev != CW_REC_MANAGER_NONE) {
+		manager->timers[timer->prev].next = timer->next;
+	} else {
+		manager->slots[timer->slot] = timer->next;
+	}
+	if (timer->next != CW_REC_MANAGER_NONE) {
+		manager->timers[timer->next].prev = timer->prev;
+	}
+
+	timer->slot = CW_REC_MANAGER_NONE;
+	timer->prev = CW_REC_MANAGER_NONE;
+	timer->next = CW_REC_MANAGER_NONE;
+	manager->n_scheduled--;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Move timers from slots of higher levels to lower levels
+
+   Called when current tick is first tick of a slot of level 1. Slot
+   of level 1 covering next CW_REC_MANAGER_N_SLOTS ticks is
+   distributed into level 0, and so on for higher levels whose slots
+   start at current tick.
+*/
+void cw_rec_manager_cascade_internal(cw_rec_manager_t * manager)
+{
+	for (int level = 1; level < CW_REC_MANAGER_N_LEVELS; level++) {
+		const int index = (int) ((manager->tick >> (CW_REC_MANAGER_SLOT_BITS * level)) & CW_REC_MANAGER_SLOT_MASK);
+		const int slot = level * CW_REC_MANAGER_N_SLOTS + index;
+
+		/* Detach whole list first: timers may be linked back
+		   into the same slot. */
+		int i = manager->slots[slot];
+		manager->slots[slot] = CW_REC_MANAGER_NONE;
+		while (i != CW_REC_MANAGER_NONE) {
+			const int next = manager->timers[i].next;
+			manager->n_scheduled--;
+			cw_rec_manager_link_internal(manager, i);
+			i = next;
+		}
+
+		if (index != 0) {
+			/* Slots of higher levels don't start at
+			   current tick. */
+			break;
+		}
+	}
+
+	return;
+}
@@ -0,0 +1,54 @@
+/*
+  This file is a part of unixcw project.
+  unixcw project is covered by GNU General Public License, version 2 or later.
+*/
+
+#ifndef H_LIBCW_REC_MANAGER
+#define H_LIBCW_REC_MANAGER
+
+
+
+
+#include <sys/time.h> /* struct timeval */
+
+
+
+
+#include "libcw_rec_output.h"
+
+
+
+
+/* Largest count of receivers owned by one manager. */
+#define CW_REC_MANAGER_N_RECEIVERS_MAX   65536
+
+/* Resolution of timing wheel of manager [us]. Characters are
+   recognized at most this late after the end of a character can be
+   recognized. */
+#define CW_REC_MANAGER_TICK               1000
+
+
+
+
+/* Event of key of one of receivers of manager. */
+typedef struct {
+	int receiver;               /* Index of receiver. */
+	int key_state;              /* CW_KEY_STATE_CLOSED (begin of mark) or CW_KEY_STATE_OPEN (end of mark). */
+	struct timeval timestamp;   /* Time of event, from clock common for all events of manager. */
+} cw_rec_manager_event_t;
+
+
+/* Function called by manager for each character (or inter-word
+   space) recognized by one of its receivers. */
+typedef void (* cw_rec_manager_callback_t)(void * callback_arg, int receiver, const cw_rec_output_t * output);
+
+
+
+
+/* Manager of many receivers. */
+typedef struct cw_rec_manager_struct cw_rec_manager_t;
+
+
+
+
+#endif /* #ifndef H_LIBCW_REC_MANAGER */
@@ -0,0 +1,599 @@
+/*
+  Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+  Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+/**
+   \file libcw_rec_output.c
+
+   \brief Queue of characters received by receiver.
+
+   Receiver decides that a character has been received when a space
+   after last mark becomes long enough, but without the queue the
+   decision is made only when client code polls the receiver (see
+   cw_rec_poll_character()). Marks are often fed to receiver by one
+   thread (e.g. a keyer callback), and received characters are
+   needed by another thread.
+
+   After cw_rec_start_output() the receiver has its own thread, that
+   wakes up at the moment when current character (or inter-word space)
+   can be recognized, polls the receiver and puts the character into
+   a queue. Client code takes characters from the queue with
+   cw_rec_get_output() (without blocking), with cw_rec_wait_output(),
+   or waits for descriptor returned by cw_rec_get_output_fd() in its
+   own event loop.
+
+   \code
+   cw_rec_start_output(rec);
+
+   Keyer thread:                      Display thread:
+
+   cw_rec_mark_begin(rec, NULL);      cw_rec_output_t out;
+   cw_rec_mark_end(rec, NULL);        while (cw_rec_wait_output(rec, &out, -1)) {
+   ...                                        putchar(out.character);
+                                      }
+   \endcode
+
+   The queue is a single-producer single-consumer ring: characters
+   are put into it only by receiver's thread, and should be taken
+   from it by one thread at a time. Taking a character from the queue
+   doesn't require any lock or system call.
+*/
+
+
+
+
+#include "config.h"
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#if defined(HAVE_SYS_EVENTFD_H)
+#include <sys/eventfd.h>
+#endif
+
+
+#include "libcw_rec.h"
+#include "libcw_rec_output.h"
+#include "libcw_data.h"
+#include "libcw_utils.h"
+#include "libcw_debug.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+#define MSG_PREFIX "libcw/rec_output: "
+
+
+
+
+/* From libcw_debug.c. */
+extern cw_debug_t cw_debug_object;
+
+
+
+
+static void * cw_rec_output_thread_internal(void * arg);
+static void   cw_rec_output_put_internal(cw_rec_t * rec, const cw_rec_output_t * item);
+static void   cw_rec_output_drain_fd_internal(cw_rec_output_queue_t * queue);
+
+
+
+
+/**
+   \brief Start putting received characters into receiver's queue
+
+   A thread is started that polls the receiver at moments when
+   characters can be recognized.
+
+   While the queue is running:
+   \li timestamps passed to cw_rec_mark_begin(), cw_rec_mark_end()
+   and cw_rec_add_mark() must come from gettimeofday() (or be NULL);
+   \li client code should not poll the receiver, reset its state or
+   change its parameters;
+   \li snapshots of the receiver can't be taken or restored.
+
+   \errno EALREADY - the queue is already running
+
+   \param rec - receiver
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_rec_start_output(cw_rec_t * rec)
+{
+	cw_rec_output_queue_t * queue = &rec->output;
+	if (queue->is_running) {
+		errno = EALREADY;
+		return CW_FAILURE;
+	}
+
+#if defined(HAVE_SYS_EVENTFD_H)
+	queue->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	queue->write_fd = queue->fd;
+	if (queue->fd == -1) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "start: eventfd()");
+		return CW_FAILURE;
+	}
+#else
+	int fds[2];
+	if (-1 == pipe(fds)) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "start: pipe()");
+		return CW_FAILURE;
+	}
+	for (int i = 0; i < 2; i++) {
+		fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+		fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+	}
+	queue->fd = fds[0];
+	queue->write_fd = fds[1];
+#endif
+
+	queue->head = 0;
+	queue->tail = 0;
+	queue->n_dropped = 0;
+
+	pthread_mutex_init(&queue->mutex, NULL);
+	/* The thread of the queue waits with a deadline; steps of wall
+	   clock must not affect the wait. */
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&queue->var, &attr);
+	pthread_condattr_destroy(&attr);
+	queue->do_run = true;
+
+	int rv = pthread_create(&queue->thread, NULL, cw_rec_output_thread_internal, rec);
+	if (rv != 0) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "start: failed to create thread: %d", rv);
+		pthread_cond_destroy(&queue->var);
+		pthread_mutex_destroy(&queue->mutex);
+		if (queue->write_fd != queue->fd) {
+			close(queue->write_fd);
+		}
+		close(queue->fd);
+		queue->fd = -1;
+		queue->write_fd = -1;
+		errno = rv;
+		return CW_FAILURE;
+	}
+	queue->is_running = true;
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Stop putting received characters into receiver's queue
+
+   Characters that are still in the queue are discarded. The function
+   is called also by cw_rec_delete() and cw_rec_deinit().
+
+   \param rec - receiver
+*/
+void cw_rec_stop_output(cw_rec_t * rec)
+{
+	cw_rec_output_queue_t * queue = &rec->output;
+	if (!queue->is_running) {
+		return;
+	}
+
+	pthread_mutex_lock(&queue->mutex);
+	queue->do_run = false;
+	pthread_cond_signal(&queue->var);
+	pthread_mutex_unlock(&queue->mutex);
+	pthread_join(queue->thread, NULL);
+
+	queue->is_running = false;
+	pthread_cond_destroy(&queue->var);
+	pthread_mutex_destroy(&queue->mutex);
+	if (queue->write_fd != queue->fd) {
+		close(queue->write_fd);
+	}
+	close(queue->fd);
+	queue->fd = -1;
+	queue->write_fd = -1;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Get descriptor of receiver's queue
+
+   The descriptor is readable when there are characters in the
+   queue. Client code can wait for it with poll() or select(), and
+   then take characters with cw_rec_get_output() until it fails with
+   EAGAIN. Client code must not read from the descriptor.
+
+   \param rec - receiver
+
+   \return descriptor, or -1 if the queue isn't running
+*/
+int cw_rec_get_output_fd(cw_rec_t const * rec)
+{
+	return rec->output.fd;
+}
+
+
+
+
+/**
+   \brief Take received character from receiver's queue
+
+   \errno EAGAIN - the queue is empty
+   \errno EINVAL - the queue isn't running
+
+   \param rec - receiver
+   \param output - received character
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_rec_get_output(cw_rec_t * rec, cw_rec_output_t * output)
+{
+	cw_rec_output_queue_t * queue = &rec->output;
+	if (!queue->is_running) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	const uint32_t head = queue->head;
+	if (head == __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE)) {
+		/* Make the descriptor non-readable, and look at the
+		   ring again: the producer may have put an item (and
+		   written to descriptor) just before draining. */
+		cw_rec_output_drain_fd_internal(queue);
+		if (head == __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE)) {
+			errno = EAGAIN;
+			return CW_FAILURE;
+		}
+	}
+
+	*output = queue->items[head & (CW_REC_OUTPUT_CAPACITY - 1)];
+	__atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Wait for received character in receiver's queue
+
+   \errno ETIMEDOUT - no character has been received in \p timeout
+   \errno EINVAL - the queue isn't running
+
+   \param rec - receiver
+   \param output - received character
+   \param timeout - how long to wait for character, -1 to wait until a character is received [us]
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_rec_wait_output(cw_rec_t * rec, cw_rec_output_t * output, int timeout)
+{
+	struct timespec deadline;
+	if (timeout >= 0) {
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_sec += timeout / CW_USECS_PER_SEC;
+		deadline.tv_nsec += (timeout % CW_USECS_PER_SEC) * 1000;
+		if (deadline.tv_nsec >= CW_NSECS_PER_SEC) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= CW_NSECS_PER_SEC;
+		}
+	}
+
+	while (!cw_rec_get_output(rec, output)) {
+		if (errno != EAGAIN) {
+			return CW_FAILURE;
+		}
+
+		int poll_timeout = -1; /* [ms] */
+		if (timeout >= 0) {
+			struct timespec now;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			const long long remaining = (deadline.tv_sec - now.tv_sec) * (long long) CW_USECS_PER_SEC
+				+ (deadline.tv_nsec - now.tv_nsec) / 1000;
+			if (remaining <= 0) {
+				errno = ETIMEDOUT;
+				return CW_FAILURE;
+			}
+			poll_timeout = (int) ((remaining + 999) / 1000);
+		}
+
+		struct pollfd pfd = { .fd = rec->output.fd, .events = POLLIN, .revents = 0 };
+		if (-1 == poll(&pfd, 1, poll_timeout) && errno != EINTR) {
+			return CW_FAILURE;
+		}
+	}
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Get count of characters dropped because receiver's queue was full
+
+   \param rec - receiver
+
+   \return count of dropped characters
+*/
+unsigned int cw_rec_get_output_n_dropped(cw_rec_t const * rec)
+{
+	return __atomic_load_n(&rec->output.n_dropped, __ATOMIC_RELAXED);
+}
+
+
+
+
+/**
+   \brief Lock receiver before feeding marks to it
+
+   Does nothing if the queue isn't running.
+*/
+void cw_rec_output_lock_internal(cw_rec_t * rec)
+{
+	if (rec->output.is_running) {
+		pthread_mutex_lock(&rec->output.mutex);
+	}
+
+	return;
+}
+
+
+
+
+/**
+   \brief Unlock receiver after feeding marks to it
+
+   Thread of the queue is notified that state of receiver (and time
+   at which next character will be recognized) has changed.
+*/
+void cw_rec_output_unlock_internal(cw_rec_t * rec)
+{
+	if (rec->output.is_running) {
+		pthread_cond_signal(&rec->output.var);
+		pthread_mutex_unlock(&rec->output.mutex);
+	}
+
+	return;
+}
+
+
+
+
+void * cw_rec_output_thread_internal(void * arg)
+{
+	cw_rec_t * rec = (cw_rec_t *) arg;
+	cw_rec_output_queue_t * queue = &rec->output;
+
+	pthread_mutex_lock(&queue->mutex);
+	while (queue->do_run) {
+		struct timeval deadline;
+		if (!cw_rec_output_deadline_internal(rec, &deadline)) {
+			/* Nothing to recognize until next mark. */
+			pthread_cond_wait(&queue->var, &queue->mutex);
+			continue;
+		}
+
+		/* The deadline is on clock of receiver's timestamps
+			   (gettimeofday(), see cw_rec_start_output()),
+			   while the variable waits on CLOCK_MONOTONIC. Time
+			   remaining to the deadline is added to monotonic
+			   time, so a step of wall clock during the wait
+			   doesn't make the thread oversleep. */
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		const long long remaining = (deadline.tv_sec - now.tv_sec) * (long long) CW_USECS_PER_SEC
+			+ (deadline.tv_usec - now.tv_usec);
+		struct timespec abstime;
+		clock_gettime(CLOCK_MONOTONIC, &abstime);
+		if (remaining > 0) {
+			const long long nsec = abstime.tv_nsec + remaining * 1000;
+			abstime.tv_sec += nsec / CW_NSECS_PER_SEC;
+			abstime.tv_nsec = nsec % CW_NSECS_PER_SEC;
+		}
+
+		if (ETIMEDOUT == pthread_cond_timedwait(&queue->var, &queue->mutex, &abstime)) {
+			gettimeofday(&now, NULL);
+			cw_rec_output_t items[2];
+			const int n_items = cw_rec_output_decide_internal(rec, &now, items);
+			for (int i = 0; i < n_items; i++) {
+				cw_rec_output_put_internal(rec, &items[i]);
+			}
+		} else {
+			/* Receiver has been fed with mark, or queue
+			   is being stopped. Deadline must be
+			   calculated again. */
+		}
+	}
+	pthread_mutex_unlock(&queue->mutex);
+
+	return NULL;
+}
+
+
+
+
+/**
+   \brief Calculate time at which receiver will be able to recognize next character or inter-word space
+
+   The function is used also by receiver manager (libcw_rec_manager.c).
+
+   \param rec - receiver
+   \param deadline - time of recognition, from the same clock as timestamps of marks
+
+   \return true if there is a character or space to be recognized
+   \return false otherwise
+*/
+bool cw_rec_output_deadline_internal(cw_rec_t * rec, struct timeval * deadline)
+{
+	int space_len = 0; /* [us] */
+
+	if (rec->state == RS_IMARK_SPACE
+	    || rec->state == RS_EOC_GAP
+	    || rec->state == RS_EOC_GAP_ERR) {
+
+		cw_rec_sync_parameters_internal(rec);
+		if (rec->is_pending_inter_word_space) {
+			/* Character has been recognized, wait for end
+			   of word. */
+			space_len = rec->eoc_len_max + 1;
+		} else {
+			space_len = rec->eoc_len_min;
+		}
+	} else if (rec->state == RS_EOW_GAP
+		   || rec->state == RS_EOW_GAP_ERR) {
+
+		space_len = 0;
+	} else {
+		return false;
+	}
+
+	deadline->tv_sec = rec->mark_end.tv_sec + space_len / CW_USECS_PER_SEC;
+	deadline->tv_usec = rec->mark_end.tv_usec + space_len % CW_USECS_PER_SEC;
+	if (deadline->tv_usec >= CW_USECS_PER_SEC) {
+		deadline->tv_sec++;
+		deadline->tv_usec -= CW_USECS_PER_SEC;
+	}
+
+	return true;
+}
+
+
+
+
+/**
+   \brief Poll receiver and recognize character and/or inter-word space
+
+   The function is used also by receiver manager (libcw_rec_manager.c).
+
+   \param rec - receiver
+   \param timestamp - time of poll
+   \param items - recognized character and/or inter-word space
+
+   \return count of items put into \p items (0 - 2)
+*/
+int cw_rec_output_decide_internal(cw_rec_t * rec, const struct timeval * timestamp, cw_rec_output_t items[2])
+{
+	char representation[CW_REC_REPRESENTATION_CAPACITY + 1];
+	bool is_end_of_word = false;
+	bool is_error = false;
+
+	if (!cw_rec_poll_representation(rec, timestamp, representation, &is_end_of_word, &is_error)) {
+		if (errno != EAGAIN) {
+			cw_debug_msg (&cw_debug_object, CW_DEBUG_RECEIVE_STATES, CW_DEBUG_WARNING,
+				      MSG_PREFIX "decide: can't poll receiver, resetting its state");
+			cw_rec_reset_state(rec);
+		}
+		return 0;
+	}
+
+	int n_items = 0;
+	if (!rec->is_pending_inter_word_space) {
+		/* See cw_rec_poll_character(). */
+		cw_rec_output_t * item = &items[n_items++];
+		item->character = (char) cw_representation_to_character_internal(representation);
+		item->is_end_of_word = false;
+		item->is_error = is_error || !item->character;
+		item->speed = rec->speed;
+		item->timestamp = rec->mark_end;
+
+		rec->is_pending_inter_word_space = true;
+	}
+
+	if (is_end_of_word) {
+		cw_rec_output_t * item = &items[n_items++];
+		item->character = ' ';
+		item->is_end_of_word = true;
+		item->is_error = false;
+		item->speed = rec->speed;
+		item->timestamp = rec->mark_end;
+
+		cw_rec_reset_state(rec);
+	}
+
+	return n_items;
+}
+
+
+
+
+void cw_rec_output_put_internal(cw_rec_t * rec, const cw_rec_output_t * item)
+{
+	cw_rec_output_queue_t * queue = &rec->output;
+
+	const uint32_t tail = queue->tail;
+	if (tail - __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) == CW_REC_OUTPUT_CAPACITY) {
+		__atomic_add_fetch(&queue->n_dropped, 1, __ATOMIC_RELAXED);
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_RECEIVE_STATES, CW_DEBUG_WARNING,
+			      MSG_PREFIX "put: queue is full, dropping character '%c'", item->character);
+		return;
+	}
+
+	queue->items[tail & (CW_REC_OUTPUT_CAPACITY - 1)] = *item;
+	__atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+
+#if defined(HAVE_SYS_EVENTFD_H)
+	const uint64_t value = 1;
+#else
+	const uint8_t value = 1;
+#endif
+	if (-1 == write(queue->write_fd, &value, sizeof (value))) {
+		/* Descriptor is readable anyway. */
+		;
+	}
+
+	return;
+}
+
+
+
+
+void cw_rec_output_drain_fd_internal(cw_rec_output_queue_t * queue)
+{
+	uint64_t buffer[8];
+	while (0 < read(queue->fd, buffer, sizeof (buffer))) {
+		;
+	}
+
+	return;
+}
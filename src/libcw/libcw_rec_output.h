@@ -0,0 +1,85 @@
+/*
+  This file is a part of unixcw project.
+  unixcw project is covered by GNU General Public License, version 2 or later.
+*/
+
+#ifndef H_LIBCW_REC_OUTPUT
+#define H_LIBCW_REC_OUTPUT
+
+
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/time.h> /* struct timeval */
+
+
+
+
+/* Capacity of queue of received characters. Must be a power of two. */
+enum { CW_REC_OUTPUT_CAPACITY = 64 };
+
+
+
+
+/* Character received by receiver, taken from queue of received
+   characters with cw_rec_get_output() or cw_rec_wait_output(). */
+typedef struct {
+	/* Received character. ' ' for inter-word space. '\0' when
+	   received representation doesn't match any character. */
+	char character;
+
+	bool is_end_of_word;  /* The item is inter-word space. */
+	bool is_error;        /* Receiver has seen invalid mark or space, or character is unknown. */
+
+	float speed;          /* Receiver's speed when the character was received. [wpm] */
+
+	/* End of last mark of character (or of last mark before
+	   inter-word space). */
+	struct timeval timestamp;
+} cw_rec_output_t;
+
+
+
+
+/* Queue of received characters, and thread that decides when a
+   character has been received. Member of cw_rec_t. */
+typedef struct {
+	/* Single-producer single-consumer ring. Items are put only by
+	   thread of the queue, and are taken by client code.
+	   Indices are free-running counters. */
+	cw_rec_output_t items[CW_REC_OUTPUT_CAPACITY];
+	uint32_t head;        /* Written by consumer. */
+	uint32_t tail;        /* Written by producer. */
+	uint32_t n_dropped;   /* Count of characters dropped because the ring was full. */
+
+	/* Descriptor that is readable when there are items in ring
+	   (eventfd, or reading end of pipe). -1 when queue isn't
+	   running. */
+	int fd;
+	int write_fd;
+
+	/* Thread of the queue, and lock serializing the thread with
+	   functions feeding marks to receiver. */
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t var;   /* Signalled when marks are fed to receiver. */
+	bool is_running;
+	bool do_run;
+} cw_rec_output_queue_t;
+
+
+
+
+struct cw_rec_struct;
+
+void cw_rec_output_lock_internal(struct cw_rec_struct * rec);
+void cw_rec_output_unlock_internal(struct cw_rec_struct * rec);
+bool cw_rec_output_deadline_internal(struct cw_rec_struct * rec, struct timeval * deadline);
+int  cw_rec_output_decide_internal(struct cw_rec_struct * rec, const struct timeval * timestamp, cw_rec_output_t items[2]);
+
+
+
+
+#endif /* #ifndef H_LIBCW_REC_OUTPUT */
@@ -0,0 +1,371 @@
+/*
+  Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+  Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+/**
+   \file libcw_resampler.c
+
+   \brief Conversion of samples between sample rates.
+
+   Tones of Morse code have frequencies of at most CW_FREQUENCY_MAX,
+   and their slopes are smooth, so a generator doesn't have to
+   calculate samples at 96 or 192 kHz just because audio sink has
+   been opened with such sample rate. The generator can calculate
+   samples at lower rate (see cw_gen_set_synthesis_rate()), and
+   resampler converts them to sample rate of audio sink.
+
+   Client code can also use the resampler directly, e.g. to render
+   samples of sessions of cw_sched_t once, at one sample rate, and
+   to convert them for sinks with different sample rates.
+
+   The resampler is a polyphase FIR filter: for conversion from rate
+   'in' to rate 'out' with L/M = out/in (in lowest terms), a low-pass
+   filter of L * n_taps coefficients is split into L phases of n_taps
+   coefficients, and every output sample is calculated with one phase
+   only. Coefficients are calculated once, when the resampler is
+   created. Samples are calculated with integer arithmetic only.
+*/
+
+
+
+
+#include "config.h"
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+
+#include "libcw_resampler.h"
+#include "libcw_debug.h"
+#include "libcw_utils.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+#define MSG_PREFIX "libcw/resampler: "
+
+
+
+
+/* From libcw_debug.c. */
+extern cw_debug_t cw_debug_object;
+
+
+
+
+struct cw_resampler_struct {
+	int in_rate;
+	int out_rate;
+
+	int n_phases;   /* Interpolation factor (L). */
+	int step;       /* Decimation factor (M). */
+	int n_taps;     /* Count of coefficients of a phase. */
+
+	/* n_phases * n_taps Q15 coefficients, coefficients of a
+	   phase are adjacent. */
+	int16_t * coefficients;
+
+	/* Last n_taps input samples, the newest at history[history_pos].
+	   Every sample is stored twice (at i and at i + n_taps), so
+	   that the samples can be read without wrapping. */
+	cw_sample_t * history;
+	int history_pos;
+
+	/* Phase of next output sample. Values >= n_phases mean that
+	   next input sample must be taken first. */
+	int phase;
+};
+
+
+
+
+static int cw_resampler_gcd_internal(int a, int b);
+static void cw_resampler_calculate_coefficients_internal(cw_resampler_t * resampler);
+
+
+
+
+int cw_resampler_gcd_internal(int a, int b)
+{
+	while (b) {
+		const int r = a % b;
+		a = b;
+		b = r;
+	}
+	return a;
+}
+
+
+
+
+/**
+   \brief Calculate coefficients of resampler's filter
+
+   The filter is a windowed sinc (Blackman window) with cutoff at 0.45
+   of lower of the two sample rates. Coefficients of every phase are
+   adjusted so that their sum is exactly 1.0, so constant input gives
+   constant output, without ripple at input sample rate.
+
+   \param resampler - resampler
+*/
+void cw_resampler_calculate_coefficients_internal(cw_resampler_t * resampler)
+{
+	const int n = resampler->n_phases * resampler->n_taps;
+	const double center = (n - 1) / 2.0;
+	const int lower_rate = resampler->in_rate < resampler->out_rate ? resampler->in_rate : resampler->out_rate;
+	/* Cutoff in cycles per sample of interpolated signal. */
+	const double cutoff = 0.45 * lower_rate / ((double) resampler->in_rate * resampler->n_phases);
+
+	for (int p = 0; p < resampler->n_phases; p++) {
+		int16_t * phase = resampler->coefficients + p * resampler->n_taps;
+
+		/* First pass: sum of coefficients of the phase,
+		   second pass: normalized coefficients. */
+		double sum = 0.0;
+		for (int pass = 0; pass < 2; pass++) {
+			for (int k = 0; k < resampler->n_taps; k++) {
+				const int i = p + k * resampler->n_phases;
+				const double x = 2.0 * cutoff * (i - center);
+				const double sinc = fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+				const double window = 0.42
+					- 0.5 * cos(2.0 * M_PI * i / (n - 1))
+					+ 0.08 * cos(4.0 * M_PI * i / (n - 1));
+				if (pass == 0) {
+					sum += sinc * window;
+				} else {
+					phase[k] = (int16_t) lrint(sinc * window / sum * (1 << 15));
+				}
+			}
+		}
+
+		int32_t sum_q15 = 0;
+		int32_t sum_abs_q15 = 0;
+		int largest = 0;
+		for (int k = 0; k < resampler->n_taps; k++) {
+			sum_q15 += phase[k];
+			sum_abs_q15 += abs(phase[k]);
+			if (abs(phase[k]) > abs(phase[largest])) {
+				largest = k;
+			}
+		}
+		phase[largest] += (1 << 15) - sum_q15;
+
+		/* Output sample is accumulated in 32 bits. */
+		cw_assert (sum_abs_q15 < (1 << 16) - (1 << 10), MSG_PREFIX "sum of coefficients of phase %d is too large: %d", p, sum_abs_q15);
+	}
+
+	return;
+}
+
+
+
+
+/**
+   \brief Create new resampler
+
+   \errno EINVAL - a sample rate is not positive, or ratio of the
+   sample rates can't be expressed with CW_RESAMPLER_N_PHASES_MAX
+   phases
+
+   \param in_rate - sample rate of input samples
+   \param out_rate - sample rate of output samples
+
+   \return pointer to new resampler on success
+   \return NULL on failure
+*/
+cw_resampler_t * cw_resampler_new(int in_rate, int out_rate)
+{
+	if (in_rate <= 0 || out_rate <= 0) {
+		errno = EINVAL;
+		return (cw_resampler_t *) NULL;
+	}
+
+	const int gcd = cw_resampler_gcd_internal(in_rate, out_rate);
+	const int n_phases = out_rate / gcd;
+	const int step = in_rate / gcd;
+	if (n_phases > CW_RESAMPLER_N_PHASES_MAX || step > CW_RESAMPLER_N_PHASES_MAX) {
+		errno = EINVAL;
+		return (cw_resampler_t *) NULL;
+	}
+
+	cw_resampler_t * resampler = (cw_resampler_t *) malloc(sizeof (cw_resampler_t));
+	if (!resampler) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "new: malloc()");
+		return (cw_resampler_t *) NULL;
+	}
+
+	resampler->in_rate = in_rate;
+	resampler->out_rate = out_rate;
+	resampler->n_phases = n_phases;
+	resampler->step = step;
+	/* Decimating filter has lower cutoff, so it needs more taps. */
+	resampler->n_taps = CW_RESAMPLER_N_TAPS * ((step + n_phases - 1) / n_phases);
+
+	resampler->coefficients = (int16_t *) malloc(n_phases * resampler->n_taps * sizeof (int16_t));
+	resampler->history = (cw_sample_t *) malloc(2 * resampler->n_taps * sizeof (cw_sample_t));
+	if (!resampler->coefficients || !resampler->history) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "new: malloc()");
+		cw_resampler_delete(&resampler);
+		return (cw_resampler_t *) NULL;
+	}
+
+	cw_resampler_calculate_coefficients_internal(resampler);
+	cw_resampler_reset(resampler);
+
+	return resampler;
+}
+
+
+
+
+/**
+   \brief Delete resampler
+
+   \param resampler - pointer to resampler
+*/
+void cw_resampler_delete(cw_resampler_t ** resampler)
+{
+	cw_assert (resampler, MSG_PREFIX "delete: 'resampler' argument can't be NULL\n");
+
+	if (!*resampler) {
+		return;
+	}
+
+	free((*resampler)->coefficients);
+	free((*resampler)->history);
+	free(*resampler);
+	*resampler = (cw_resampler_t *) NULL;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Forget input samples passed to resampler
+
+   Next output sample will be calculated as if the resampler has been
+   receiving silence.
+
+   \param resampler - resampler
+*/
+void cw_resampler_reset(cw_resampler_t * resampler)
+{
+	memset(resampler->history, 0, 2 * resampler->n_taps * sizeof (cw_sample_t));
+	resampler->history_pos = 0;
+	resampler->phase = resampler->n_phases;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Get delay of output samples of resampler
+
+   Output samples are delayed by a half of length of resampler's
+   filter (about n_taps / 2 input samples): a change of input is
+   seen in the middle of output after that time.
+
+   \param resampler - resampler
+
+   \return delay [us]
+*/
+int cw_resampler_get_delay(const cw_resampler_t * resampler)
+{
+	/* Center of filter, in samples of interpolated signal. */
+	const int64_t n = (int64_t) resampler->n_phases * resampler->n_taps - 1;
+	return (int) (n * CW_USECS_PER_SEC / (2 * (int64_t) resampler->n_phases * resampler->in_rate));
+}
+
+
+
+
+/**
+   \brief Convert samples to output sample rate
+
+   The function takes input samples until all of them are taken or
+   until \p n_out output samples are calculated, whichever comes
+   first. Output samples are delayed by a half of length of the
+   filter (see cw_resampler_get_delay()).
+
+   Every \p in_rate input samples give \p out_rate output samples, so
+   a caller that converts whole buffers of input samples should
+   provide at least n_in * out_rate / in_rate + 1 output samples.
+
+   \param resampler - resampler
+   \param in - input samples
+   \param n_in - count of input samples (in); count of taken input samples (out)
+   \param out - output samples
+   \param n_out - size of \p out
+
+   \return count of output samples
+*/
+int cw_resampler_process(cw_resampler_t * resampler, const cw_sample_t * in, int * n_in, cw_sample_t * out, int n_out)
+{
+	const int n_taps = resampler->n_taps;
+	int i = 0;
+	int o = 0;
+
+	while (o < n_out) {
+		while (resampler->phase >= resampler->n_phases) {
+			if (i == *n_in) {
+				goto done;
+			}
+			if (resampler->history_pos == 0) {
+				resampler->history_pos = n_taps;
+			}
+			resampler->history_pos--;
+			resampler->history[resampler->history_pos] = in[i];
+			resampler->history[resampler->history_pos + n_taps] = in[i];
+			i++;
+			resampler->phase -= resampler->n_phases;
+		}
+
+		const int16_t * coefficients = resampler->coefficients + resampler->phase * n_taps;
+		const cw_sample_t * history = resampler->history + resampler->history_pos;
+		/* n_taps is a multiple of CW_RESAMPLER_N_TAPS. Constant
+		   count of iterations of inner loop lets compiler
+		   vectorize it. */
+		int32_t acc = 1 << 14;
+		for (int j = 0; j < n_taps; j += CW_RESAMPLER_N_TAPS) {
+			for (int k = 0; k < CW_RESAMPLER_N_TAPS; k++) {
+				acc += (int32_t) coefficients[j + k] * history[j + k];
+			}
+		}
+		acc >>= 15;
+		out[o++] = acc > INT16_MAX ? INT16_MAX : (acc < INT16_MIN ? INT16_MIN : (cw_sample_t) acc);
+
+		resampler->phase += resampler->step;
+	}
+
+ done:
+	*n_in = i;
+	return o;
+}
@@ -0,0 +1,34 @@
+/*
+  This file is a part of unixcw project.
+  unixcw project is covered by GNU General Public License, version 2 or later.
+*/
+
+#ifndef H_LIBCW_RESAMPLER
+#define H_LIBCW_RESAMPLER
+
+
+
+
+#include <stdint.h>
+
+
+
+
+/* Count of taps of every phase of polyphase filter, when the filter
+   interpolates. The count is multiplied when the filter decimates. */
+#define CW_RESAMPLER_N_TAPS 16
+
+/* Largest interpolation factor (output rate / input rate, reduced to
+   lowest terms) supported by resampler. */
+#define CW_RESAMPLER_N_PHASES_MAX 1024
+
+
+
+
+/* Polyphase resampler converting samples between two sample rates. */
+typedef struct cw_resampler_struct cw_resampler_t;
+
+
+
+
+#endif /* #ifndef H_LIBCW_RESAMPLER */
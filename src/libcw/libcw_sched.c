@@ -0,0 +1,652 @@
+/*
+  Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+  Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+/**
+   \file libcw_sched.c
+
+   \brief Render many generators ("sessions") on a fixed pool of threads.
+
+   A generator started with cw_gen_start() has its own thread that
+   dequeues tones and writes samples to audio sink. This is fine for
+   an application with one or two generators, but not for a server
+   that needs to serve hundreds or thousands of independent
+   generators, each with its own speed, frequency and tone queue.
+
+   Scheduler owns a fixed number of worker threads, and any number
+   of sessions. A session is a generator that doesn't have its own
+   thread, and a stream function to which samples of the generator
+   are written.
+
+   Scheduler works in ticks. A tick is started by client code with
+   cw_sched_tick(). In every tick scheduler renders exactly one
+   buffer of samples for every session, and passes the buffer to
+   session's stream function. Client code decides how often to call
+   cw_sched_tick(): in real time (once per buffer duration) when
+   samples are streamed to listeners, or as fast as possible when
+   samples are e.g. saved to files.
+
+   Sessions are distributed between workers at the beginning of each
+   tick. A worker that has rendered all of its own sessions steals
+   sessions from other workers, so cost of rendering that varies
+   between sessions (tone vs. silence, slopes, keying callbacks) is
+   balanced between cores.
+*/
+
+
+
+
+#include "config.h"
+
+
+#include <stdlib.h>
+#include <errno.h>
+
+
+#include "libcw_sched.h"
+#include "libcw_gen.h"
+#include "libcw_debug.h"
+#include "libcw_utils.h"
+#include "libcw2.h"
+
+
+
+
+#define MSG_PREFIX "libcw/sched: "
+
+
+
+
+/* From libcw_debug.c. */
+extern cw_debug_t cw_debug_object;
+extern cw_debug_t cw_debug_object_dev;
+
+
+
+
+#define CW_SCHED_RANGE_FRONT(m_range) ((uint32_t) ((m_range) >> 32))
+#define CW_SCHED_RANGE_BACK(m_range)  ((uint32_t) ((m_range) & 0xffffffff))
+#define CW_SCHED_RANGE(m_front, m_back) ((((uint64_t) (m_front)) << 32) | ((uint64_t) (m_back)))
+
+
+
+
+static void * cw_sched_worker_thread_internal(void * arg);
+static int    cw_sched_worker_pop_internal(cw_sched_worker_t * worker);
+static int    cw_sched_worker_steal_internal(cw_sched_worker_t * victim);
+static void   cw_sched_render_session_internal(cw_sched_t * sched, int i);
+static void   cw_sched_stop_workers_internal(cw_sched_t * sched);
+
+
+
+
+/**
+   \brief Create new scheduler
+
+   Create a scheduler with a pool of \p n_workers worker threads. All
+   sessions added to the scheduler will be rendered with sample rate
+   \p sample_rate, \p buffer_n_samples samples per tick.
+
+   Pass zero as \p sample_rate or \p buffer_n_samples to use default
+   values (CW_SCHED_SAMPLE_RATE_DEFAULT and
+   CW_SCHED_BUFFER_N_SAMPLES_DEFAULT).
+
+   \errno EINVAL - invalid value of one of arguments
+   \errno ENOMEM - failed to allocate memory
+   \errno EAGAIN - failed to create worker thread
+
+   \param n_workers - number of worker threads (1 - CW_SCHED_N_WORKERS_MAX)
+   \param sample_rate - sample rate of rendered samples
+   \param buffer_n_samples - number of samples rendered for each session in one tick
+
+   \return pointer to new scheduler on success
+   \return NULL on failure
+*/
+cw_sched_t * cw_sched_new(int n_workers, int sample_rate, int buffer_n_samples)
+{
+	if (n_workers < 1 || n_workers > CW_SCHED_N_WORKERS_MAX
+	    || sample_rate < 0 || buffer_n_samples < 0) {
+
+		errno = EINVAL;
+		return (cw_sched_t *) NULL;
+	}
+
+	cw_sched_t * sched = (cw_sched_t *) malloc(sizeof (cw_sched_t));
+	if (!sched) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR, MSG_PREFIX "malloc()");
+		errno = ENOMEM;
+		return (cw_sched_t *) NULL;
+	}
+
+	sched->sample_rate = sample_rate ? sample_rate : CW_SCHED_SAMPLE_RATE_DEFAULT;
+	sched->buffer_n_samples = buffer_n_samples ? buffer_n_samples : CW_SCHED_BUFFER_N_SAMPLES_DEFAULT;
+
+	sched->sessions = (cw_sched_session_t *) NULL;
+	sched->n_sessions = 0;
+	sched->sessions_capacity = 0;
+	pthread_mutex_init(&sched->mutex, NULL);
+
+	pthread_mutex_init(&sched->tick.mutex, NULL);
+	pthread_cond_init(&sched->tick.start_var, NULL);
+	pthread_cond_init(&sched->tick.done_var, NULL);
+	sched->tick.id = 0;
+	sched->tick.n_done = 0;
+	sched->tick.do_run = true;
+
+	sched->n_write_failures = 0;
+
+	sched->n_workers = 0;
+	sched->workers = (cw_sched_worker_t *) calloc(n_workers, sizeof (cw_sched_worker_t));
+	if (!sched->workers) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR, MSG_PREFIX "calloc()");
+		cw_sched_delete(&sched);
+		errno = ENOMEM;
+		return (cw_sched_t *) NULL;
+	}
+
+	for (int i = 0; i < n_workers; i++) {
+		cw_sched_worker_t * worker = &sched->workers[i];
+		worker->sched = sched;
+		worker->range = CW_SCHED_RANGE(0, 0);
+		worker->tick_id = 0;
+		worker->running = false;
+
+		if (0 != pthread_create(&worker->id, NULL, cw_sched_worker_thread_internal, (void *) worker)) {
+			cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+				      MSG_PREFIX "failed to create worker thread #%d", i);
+			cw_sched_delete(&sched);
+			errno = EAGAIN;
+			return (cw_sched_t *) NULL;
+		}
+		worker->running = true;
+		sched->n_workers++;
+	}
+
+	return sched;
+}
+
+
+
+
+/**
+   \brief Delete scheduler
+
+   Stop worker threads of scheduler, delete all sessions (generators)
+   that still exist in the scheduler, and deallocate the scheduler.
+   Pointer to \p sched is set to NULL.
+
+   \param sched - pointer to scheduler
+*/
+void cw_sched_delete(cw_sched_t ** sched)
+{
+	cw_assert (sched, MSG_PREFIX "delete: pointer to scheduler is NULL");
+
+	if (!*sched) {
+		return;
+	}
+
+	cw_sched_stop_workers_internal(*sched);
+	free((*sched)->workers);
+	(*sched)->workers = (cw_sched_worker_t *) NULL;
+
+	for (int i = 0; i < (*sched)->n_sessions; i++) {
+		cw_gen_delete(&(*sched)->sessions[i].gen);
+	}
+	free((*sched)->sessions);
+	(*sched)->sessions = (cw_sched_session_t *) NULL;
+	(*sched)->n_sessions = 0;
+
+	pthread_cond_destroy(&(*sched)->tick.start_var);
+	pthread_cond_destroy(&(*sched)->tick.done_var);
+	pthread_mutex_destroy(&(*sched)->tick.mutex);
+	pthread_mutex_destroy(&(*sched)->mutex);
+
+	free(*sched);
+	*sched = (cw_sched_t *) NULL;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Add new session to scheduler
+
+   Create a new generator that will be driven by scheduler \p sched.
+   Samples of the generator will be passed to \p write_func (with \p
+   write_arg as first argument) once per tick.
+
+   Returned generator can be configured and used with regular cw_gen_*
+   functions (setting speed and frequency, enqueueing characters and
+   strings, waiting for tone queue etc.), but it must not be started
+   with cw_gen_start(), and must not be deleted with cw_gen_delete().
+   Use cw_sched_remove_session() to delete the generator.
+
+   \errno EINVAL - \p write_func is NULL
+   \errno ENOMEM - failed to allocate memory
+
+   \param sched - scheduler
+   \param write_func - function receiving samples of new session
+   \param write_arg - argument passed to \p write_func
+
+   \return generator of new session on success
+   \return NULL on failure
+*/
+cw_gen_t * cw_sched_add_session(cw_sched_t * sched, cw_sched_write_t write_func, void * write_arg)
+{
+	if (!write_func) {
+		errno = EINVAL;
+		return (cw_gen_t *) NULL;
+	}
+
+	cw_gen_t * gen = cw_gen_new(CW_AUDIO_NULL, CW_DEFAULT_NULL_DEVICE);
+	if (!gen) {
+		errno = ENOMEM;
+		return (cw_gen_t *) NULL;
+	}
+
+	/* Null audio sink doesn't use buffer, so we have to set it up
+	   here, together with sample rate common for all sessions. */
+	gen->sample_rate = sched->sample_rate;
+	gen->buffer_n_samples = sched->buffer_n_samples;
+	gen->buffer = (cw_sample_t *) malloc(gen->buffer_n_samples * sizeof (cw_sample_t));
+	if (!gen->buffer) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR, MSG_PREFIX "malloc()");
+		cw_gen_delete(&gen);
+		errno = ENOMEM;
+		return (cw_gen_t *) NULL;
+	}
+	cw_gen_set_phase_internal(gen, 0.0);
+	gen->render.is_external = true;
+
+	/* Slopes depend on sample rate. */
+	if (CW_SUCCESS != cw_gen_set_tone_slope(gen, -1, -1)) {
+		cw_gen_delete(&gen);
+		errno = ENOMEM;
+		return (cw_gen_t *) NULL;
+	}
+
+
+	pthread_mutex_lock(&sched->mutex);
+
+	if (sched->n_sessions == sched->sessions_capacity) {
+		const int new_capacity = sched->sessions_capacity ? 2 * sched->sessions_capacity : 16;
+		cw_sched_session_t * sessions = (cw_sched_session_t *) realloc(sched->sessions, new_capacity * sizeof (cw_sched_session_t));
+		if (!sessions) {
+			pthread_mutex_unlock(&sched->mutex);
+
+			cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR, MSG_PREFIX "realloc()");
+			cw_gen_delete(&gen);
+			errno = ENOMEM;
+			return (cw_gen_t *) NULL;
+		}
+		sched->sessions = sessions;
+		sched->sessions_capacity = new_capacity;
+	}
+
+	cw_sched_session_t * session = &sched->sessions[sched->n_sessions];
+	session->gen = gen;
+	session->write_func = write_func;
+	session->write_silence_func = NULL;
+	session->write_arg = write_arg;
+	sched->n_sessions++;
+
+	pthread_mutex_unlock(&sched->mutex);
+
+	return gen;
+}
+
+
+
+
+/**
+   \brief Remove session from scheduler
+
+   Remove session with generator \p gen from scheduler \p sched, and
+   delete the generator. Pointer to generator is set to NULL.
+
+   The function waits for end of current tick (if any) before removing
+   the session.
+
+   \errno EINVAL - \p gen doesn't belong to \p sched
+
+   \param sched - scheduler
+   \param gen - pointer to generator of session to be removed
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_sched_remove_session(cw_sched_t * sched, cw_gen_t ** gen)
+{
+	cw_assert (gen, MSG_PREFIX "remove session: pointer to generator is NULL");
+
+	pthread_mutex_lock(&sched->mutex);
+
+	for (int i = 0; i < sched->n_sessions; i++) {
+		if (sched->sessions[i].gen == *gen) {
+			/* Order of sessions doesn't matter, so move last
+			   session into the hole. */
+			sched->n_sessions--;
+			sched->sessions[i] = sched->sessions[sched->n_sessions];
+
+			pthread_mutex_unlock(&sched->mutex);
+
+			cw_gen_delete(gen);
+			return CW_SUCCESS;
+		}
+	}
+
+	pthread_mutex_unlock(&sched->mutex);
+
+	errno = EINVAL;
+	return CW_FAILURE;
+}
+
+
+
+
+/**
+   \brief Set function receiving silence of session
+
+   Most of time of a typical session is silence: spaces between
+   Marks, and periods of empty tone queue. When \p write_silence_func
+   is set, the scheduler calls it (with session's write argument and
+   count of samples) instead of session's write function for every
+   tick in which all samples of the session are silence. A file or
+   network sink can then store or send just a count of silent
+   samples.
+
+   Pass NULL as \p write_silence_func to pass all samples to session's
+   write function again.
+
+   \errno EINVAL - \p gen doesn't belong to \p sched
+
+   \param sched - scheduler
+   \param gen - generator of session
+   \param write_silence_func - function receiving count of silent samples
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_sched_set_write_silence(cw_sched_t * sched, cw_gen_t * gen, cw_sched_write_silence_t write_silence_func)
+{
+	pthread_mutex_lock(&sched->mutex);
+
+	for (int i = 0; i < sched->n_sessions; i++) {
+		if (sched->sessions[i].gen == gen) {
+			sched->sessions[i].write_silence_func = write_silence_func;
+			pthread_mutex_unlock(&sched->mutex);
+			return CW_SUCCESS;
+		}
+	}
+
+	pthread_mutex_unlock(&sched->mutex);
+
+	errno = EINVAL;
+	return CW_FAILURE;
+}
+
+
+
+
+/**
+   \brief Get count of sessions in scheduler
+
+   \param sched - scheduler
+
+   \return number of sessions
+*/
+int cw_sched_get_n_sessions(cw_sched_t * sched)
+{
+	pthread_mutex_lock(&sched->mutex);
+	const int n = sched->n_sessions;
+	pthread_mutex_unlock(&sched->mutex);
+
+	return n;
+}
+
+
+
+
+/**
+   \brief Render one buffer of samples for every session
+
+   Distribute sessions between worker threads, let the workers render
+   one buffer of samples for every session and pass the samples to
+   sessions' write functions. The function returns when samples of all
+   sessions have been written.
+
+   Sessions can't be added or removed while the function is running.
+
+   \errno EIO - write function of at least one session returned failure
+
+   \param sched - scheduler
+
+   \return CW_SUCCESS if samples of all sessions have been written successfully
+   \return CW_FAILURE otherwise
+*/
+int cw_sched_tick(cw_sched_t * sched)
+{
+	pthread_mutex_lock(&sched->mutex);
+
+	if (!sched->n_sessions) {
+		pthread_mutex_unlock(&sched->mutex);
+		return CW_SUCCESS;
+	}
+
+	sched->n_write_failures = 0;
+
+	/* Give each worker a contiguous range of sessions of (almost)
+	   equal size. */
+	const int n = sched->n_sessions;
+	for (int w = 0; w < sched->n_workers; w++) {
+		const uint32_t front = (uint32_t) (((int64_t) n * w) / sched->n_workers);
+		const uint32_t back = (uint32_t) (((int64_t) n * (w + 1)) / sched->n_workers);
+		__atomic_store_n(&sched->workers[w].range, CW_SCHED_RANGE(front, back), __ATOMIC_RELEASE);
+	}
+
+	pthread_mutex_lock(&sched->tick.mutex);
+	sched->tick.n_done = 0;
+	sched->tick.id++;
+	pthread_cond_broadcast(&sched->tick.start_var);
+	while (sched->tick.n_done < sched->n_workers) {
+		pthread_cond_wait(&sched->tick.done_var, &sched->tick.mutex);
+	}
+	pthread_mutex_unlock(&sched->tick.mutex);
+
+	const int n_failures = __atomic_load_n(&sched->n_write_failures, __ATOMIC_ACQUIRE);
+
+	pthread_mutex_unlock(&sched->mutex);
+
+	if (n_failures) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_GENERATOR, CW_DEBUG_WARNING,
+			      MSG_PREFIX "tick: %d session write(s) failed", n_failures);
+		errno = EIO;
+		return CW_FAILURE;
+	} else {
+		return CW_SUCCESS;
+	}
+}
+
+
+
+
+/**
+   \brief Thread function of scheduler's worker
+
+   \param arg - worker (casted to (void *))
+
+   \return NULL pointer
+*/
+void * cw_sched_worker_thread_internal(void * arg)
+{
+	cw_sched_worker_t * worker = (cw_sched_worker_t *) arg;
+	cw_sched_t * sched = worker->sched;
+
+	while (true) {
+		pthread_mutex_lock(&sched->tick.mutex);
+		while (sched->tick.do_run && worker->tick_id == sched->tick.id) {
+			pthread_cond_wait(&sched->tick.start_var, &sched->tick.mutex);
+		}
+		if (!sched->tick.do_run) {
+			pthread_mutex_unlock(&sched->tick.mutex);
+			break;
+		}
+		worker->tick_id = sched->tick.id;
+		pthread_mutex_unlock(&sched->tick.mutex);
+
+
+		/* First render own sessions... */
+		int i;
+		while (-1 != (i = cw_sched_worker_pop_internal(worker))) {
+			cw_sched_render_session_internal(sched, i);
+		}
+
+		/* ... then help other workers. Start with a neighbour,
+		   so that not all thieves attack the same victim. */
+		const int w = (int) (worker - sched->workers);
+		for (int v = 1; v < sched->n_workers; v++) {
+			cw_sched_worker_t * victim = &sched->workers[(w + v) % sched->n_workers];
+			while (-1 != (i = cw_sched_worker_steal_internal(victim))) {
+				cw_sched_render_session_internal(sched, i);
+			}
+		}
+
+
+		pthread_mutex_lock(&sched->tick.mutex);
+		sched->tick.n_done++;
+		if (sched->tick.n_done == sched->n_workers) {
+			pthread_cond_signal(&sched->tick.done_var);
+		}
+		pthread_mutex_unlock(&sched->tick.mutex);
+	}
+
+	return NULL;
+}
+
+
+
+
+/**
+   \brief Take a session from back of worker's own range
+
+   \param worker - worker
+
+   \return index of session to render
+   \return -1 if worker's range is empty
+*/
+int cw_sched_worker_pop_internal(cw_sched_worker_t * worker)
+{
+	uint64_t range = __atomic_load_n(&worker->range, __ATOMIC_ACQUIRE);
+	while (true) {
+		const uint32_t front = CW_SCHED_RANGE_FRONT(range);
+		const uint32_t back = CW_SCHED_RANGE_BACK(range);
+		if (front >= back) {
+			return -1;
+		}
+		/* On failure 'range' is updated with current value. */
+		if (__atomic_compare_exchange_n(&worker->range, &range, CW_SCHED_RANGE(front, back - 1),
+						false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			return (int) (back - 1);
+		}
+	}
+}
+
+
+
+
+/**
+   \brief Take a session from front of range of another worker
+
+   \param victim - worker from which to steal a session
+
+   \return index of session to render
+   \return -1 if victim's range is empty
+*/
+int cw_sched_worker_steal_internal(cw_sched_worker_t * victim)
+{
+	uint64_t range = __atomic_load_n(&victim->range, __ATOMIC_ACQUIRE);
+	while (true) {
+		const uint32_t front = CW_SCHED_RANGE_FRONT(range);
+		const uint32_t back = CW_SCHED_RANGE_BACK(range);
+		if (front >= back) {
+			return -1;
+		}
+		/* On failure 'range' is updated with current value. */
+		if (__atomic_compare_exchange_n(&victim->range, &range, CW_SCHED_RANGE(front + 1, back),
+						false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			return (int) front;
+		}
+	}
+}
+
+
+
+
+/**
+   \brief Render one buffer of samples of given session, and write the samples
+
+   \param sched - scheduler
+   \param i - index of session
+*/
+void cw_sched_render_session_internal(cw_sched_t * sched, int i)
+{
+	cw_sched_session_t * session = &sched->sessions[i];
+
+	cw_gen_render_buffer_internal(session->gen);
+
+	int rv;
+	if (session->write_silence_func && session->gen->buffer_is_silent) {
+		rv = session->write_silence_func(session->write_arg, session->gen->buffer_n_samples);
+	} else {
+		rv = session->write_func(session->write_arg, session->gen->buffer, session->gen->buffer_n_samples);
+	}
+	if (CW_SUCCESS != rv) {
+		__atomic_add_fetch(&sched->n_write_failures, 1, __ATOMIC_ACQ_REL);
+	}
+
+	return;
+}
+
+
+
+
+/**
+   \brief Stop and join worker threads of scheduler
+
+   \param sched - scheduler
+*/
+void cw_sched_stop_workers_internal(cw_sched_t * sched)
+{
+	pthread_mutex_lock(&sched->tick.mutex);
+	sched->tick.do_run = false;
+	pthread_cond_broadcast(&sched->tick.start_var);
+	pthread_mutex_unlock(&sched->tick.mutex);
+
+	for (int i = 0; i < sched->n_workers; i++) {
+		if (sched->workers[i].running) {
+			pthread_join(sched->workers[i].id, NULL);
+			sched->workers[i].running = false;
+		}
+	}
+	sched->n_workers = 0;
+
+	return;
+}
@@ -0,0 +1,125 @@
+/*
+  This file is a part of unixcw project.
+  unixcw project is covered by GNU General Public License, version 2 or later.
+*/
+
+#ifndef H_LIBCW_SCHED
+#define H_LIBCW_SCHED
+
+
+
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+
+
+
+#include "libcw_gen.h"
+
+
+
+
+/* Default values of scheduler's parameters. */
+#define CW_SCHED_SAMPLE_RATE_DEFAULT        48000
+#define CW_SCHED_BUFFER_N_SAMPLES_DEFAULT     256
+#define CW_SCHED_N_WORKERS_MAX                256
+
+
+
+
+/* Function consuming samples rendered for one session. Called once
+   per session per tick, from one of scheduler's worker threads.
+
+   The function should return CW_SUCCESS when it accepted the
+   samples, and CW_FAILURE otherwise. */
+typedef int (* cw_sched_write_t)(void * write_arg, const cw_sample_t * samples, int n_samples);
+
+/* Function called instead of cw_sched_write_t when all samples
+   rendered for session in a tick are silence (see
+   cw_sched_set_write_silence()). */
+typedef int (* cw_sched_write_silence_t)(void * write_arg, int n_samples);
+
+
+
+
+/* One session: one generator with its own parameters and tone queue,
+   and a stream to which samples of the generator are written. */
+typedef struct {
+	cw_gen_t * gen;
+
+	cw_sched_write_t write_func;
+	cw_sched_write_silence_t write_silence_func; /* May be NULL. */
+	void * write_arg;
+} cw_sched_session_t;
+
+
+
+
+/* Worker thread of a scheduler.
+
+   Before every tick, each worker gets a contiguous range of indices
+   of sessions to render. The range is a double-ended queue: the
+   worker itself takes sessions from the back of its range, and
+   workers that have emptied their own ranges steal sessions from the
+   front of ranges of other workers.
+
+   Both ends of the range are packed into one 64-bit word ("front" in
+   upper 32 bits, "back" in lower 32 bits), so that the owner and the
+   thieves can claim a session with a single compare-and-swap. */
+typedef struct {
+	pthread_t id;
+	bool running;
+
+	struct cw_sched_struct * sched;
+
+	volatile uint64_t range;
+
+	/* Id of last tick processed by this worker. */
+	unsigned int tick_id;
+} cw_sched_worker_t;
+
+
+
+
+struct cw_sched_struct {
+
+	/* Parameters common for all sessions. */
+	int sample_rate;
+	int buffer_n_samples;
+
+	/* Sessions handled by scheduler. The array is modified only
+	   under ->mutex, and ->mutex is held for whole duration of a
+	   tick, so sessions can't be added or removed in the middle
+	   of a tick. */
+	cw_sched_session_t * sessions;
+	int n_sessions;
+	int sessions_capacity;
+	pthread_mutex_t mutex;
+
+	/* Pool of worker threads. */
+	cw_sched_worker_t * workers;
+	int n_workers;
+
+	/* Synchronization between thread calling cw_sched_tick() and
+	   worker threads. */
+	struct {
+		pthread_mutex_t mutex;
+		pthread_cond_t start_var;  /* Signalled by cw_sched_tick() when new tick starts. */
+		pthread_cond_t done_var;   /* Signalled by last worker that has finished its work in a tick. */
+		unsigned int id;           /* Incremented on every tick. */
+		int n_done;                /* Count of workers that have finished their work in current tick. */
+		bool do_run;               /* Workers keep running as long as this is true. */
+	} tick;
+
+	/* Count of failed writes of session samples in current tick. */
+	volatile int n_write_failures;
+};
+
+typedef struct cw_sched_struct cw_sched_t;
+
+
+
+
+#endif /* #ifndef H_LIBCW_SCHED */
@@ -0,0 +1,670 @@
+/*
+  Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+  Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+/**
+   \file libcw_shm_tq.c
+
+   \brief Tone queue shared between processes.
+
+   Tone queue of a generator (cw_tone_queue_t) can be used only by
+   threads of the process that owns the generator. A process that
+   only prepares text or tones (producer) can instead put them into a
+   shared queue: a ring of fixed-size items in a shared memory
+   segment. A thread of process owning the generator (consumer) takes
+   the items from the ring and enqueues them in generator's tone
+   queue, see cw_shm_tq_forward(). No system call is made by producer
+   unless the consumer is waiting for items.
+
+   \code
+   Audio process:                          Text process:
+
+   cw_shm_tq_t * q = cw_shm_tq_new(1024);
+   send cw_shm_tq_get_fd(q) over
+   Unix socket (SCM_RIGHTS) ------------>  cw_shm_tq_t * q = cw_shm_tq_attach(fd);
+   cw_shm_tq_forward(q, gen);              cw_shm_tq_enqueue_string(q, "CQ CQ");
+   \endcode
+
+   The ring has one producer and one consumer. Indices of the ring
+   are free-running 32-bit counters, written with atomic operations:
+   'tail' only by producer, 'head' only by consumer. Consumer waiting
+   for items sleeps on futex (on Linux), and producer wakes it up
+   only when the consumer has announced that it is waiting.
+
+   Items of type CW_SHM_TQ_ITEM_CHARACTER are enqueued with
+   cw_gen_enqueue_character(), so they are sent with speed, frequency
+   and other parameters of consumer's generator. When generator's
+   tone queue is full, items wait in the ring.
+*/
+
+
+
+
+#include "config.h"
+
+
+#define _GNU_SOURCE   /* memfd_create() */
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(HAVE_LINUX_FUTEX_H)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+
+#include "libcw_shm_tq.h"
+#include "libcw_gen.h"
+#include "libcw_tq.h"
+#include "libcw_debug.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+#define MSG_PREFIX "libcw/shm_tq: "
+
+
+
+
+/* From libcw_debug.c. */
+extern cw_debug_t cw_debug_object;
+
+
+
+
+/* How long consumer waits before retrying to enqueue an item in
+   generator's tone queue that has been full. [us] */
+enum { CW_SHM_TQ_FULL_RETRY_PERIOD = 1000 };
+
+/* How often consumer checks the ring when futex isn't available. [ns] */
+enum { CW_SHM_TQ_POLL_PERIOD = 1000000 };
+
+static const uint8_t cw_shm_tq_magic[] = { 'C', 'W', 'Q', CW_SHM_TQ_VERSION };
+
+
+
+
+/* Header of shared memory segment, followed by 'capacity' items.
+   Members written by producer and members written by consumer are
+   in separate cache lines. */
+typedef struct {
+	uint8_t magic[4];
+	uint32_t capacity;
+	uint8_t padding_1[56];
+
+	/* Written by producer. */
+	uint32_t tail;          /* Count of items put into the ring. */
+	uint32_t wake_sequence; /* Futex word, incremented to wake consumer. */
+	uint8_t padding_2[56];
+
+	/* Written by consumer. */
+	uint32_t head;          /* Count of items taken from the ring. */
+	uint32_t is_waiting;    /* Consumer waits (or is about to wait) on futex. */
+	uint8_t padding_3[56];
+} cw_shm_tq_header_t;
+
+
+struct cw_shm_tq_struct {
+	int fd;
+	size_t size;                 /* Size of mapped segment [bytes]. */
+	cw_shm_tq_header_t * header;
+	cw_shm_tq_item_t * items;
+	uint32_t mask;               /* capacity - 1 */
+
+	/* Consumer's side: generator to which items are forwarded,
+	   and forwarding thread. */
+	cw_gen_t * gen;
+	pthread_t thread;
+	bool do_forward;
+};
+
+
+
+
+static cw_shm_tq_t * cw_shm_tq_map_internal(int fd, size_t size);
+static void   cw_shm_tq_wake_internal(cw_shm_tq_t * queue);
+static void   cw_shm_tq_wait_internal(cw_shm_tq_t * queue, uint32_t head);
+static int    cw_shm_tq_put_internal(cw_shm_tq_t * queue, const cw_shm_tq_item_t * items, size_t n_items);
+static int    cw_shm_tq_enqueue_item_internal(cw_gen_t * gen, const cw_shm_tq_item_t * item);
+static void * cw_shm_tq_forward_thread_internal(void * arg);
+
+
+
+
+/**
+   \brief Create new shared queue
+
+   The queue is placed in a new shared memory segment. Descriptor of
+   the segment (see cw_shm_tq_get_fd()) can be passed to other
+   processes (e.g. over Unix socket, or by fork()), which attach the
+   queue with cw_shm_tq_attach().
+
+   \errno EINVAL - \p capacity is not a power of two, or is larger
+   than CW_SHM_TQ_CAPACITY_MAX
+
+   \param capacity - capacity of queue [items]
+
+   \return pointer to new queue on success
+   \return NULL on failure
+*/
+cw_shm_tq_t * cw_shm_tq_new(size_t capacity)
+{
+	if (capacity == 0
+	    || capacity > CW_SHM_TQ_CAPACITY_MAX
+	    || (capacity & (capacity - 1))) {
+
+		errno = EINVAL;
+		return (cw_shm_tq_t *) NULL;
+	}
+
+#if defined(HAVE_MEMFD_CREATE)
+	const int fd = memfd_create("libcw_shm_tq", MFD_CLOEXEC);
+#else
+	char path[] = "/tmp/libcw_shm_tq_XXXXXX";
+	const int fd = mkstemp(path);
+	if (fd != -1) {
+		unlink(path);
+	}
+#endif
+	if (fd == -1) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "new: can't create shared memory segment");
+		return (cw_shm_tq_t *) NULL;
+	}
+
+	const size_t size = sizeof (cw_shm_tq_header_t) + capacity * sizeof (cw_shm_tq_item_t);
+	if (-1 == ftruncate(fd, (off_t) size)) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "new: ftruncate()");
+		close(fd);
+		return (cw_shm_tq_t *) NULL;
+	}
+
+	cw_shm_tq_t * queue = cw_shm_tq_map_internal(fd, size);
+	if (!queue) {
+		close(fd);
+		return (cw_shm_tq_t *) NULL;
+	}
+
+	/* Segment is zeroed by ftruncate(). */
+	queue->header->capacity = (uint32_t) capacity;
+	queue->mask = (uint32_t) capacity - 1;
+	/* Magic goes last: until then other processes can't attach. */
+	memcpy(queue->header->magic, cw_shm_tq_magic, sizeof (cw_shm_tq_magic));
+
+	return queue;
+}
+
+
+
+
+/**
+   \brief Attach shared queue created by other process
+
+   The function doesn't take ownership of \p fd: it uses its own
+   duplicate of the descriptor.
+
+   \errno EINVAL - \p fd is not a descriptor of shared queue, or the
+   queue has been created with other version of library
+
+   \param fd - descriptor of shared memory segment of queue
+
+   \return pointer to queue on success
+   \return NULL on failure
+*/
+cw_shm_tq_t * cw_shm_tq_attach(int fd)
+{
+	struct stat st;
+	if (-1 == fstat(fd, &st) || (size_t) st.st_size < sizeof (cw_shm_tq_header_t)) {
+		errno = EINVAL;
+		return (cw_shm_tq_t *) NULL;
+	}
+
+	const int own_fd = dup(fd);
+	if (own_fd == -1) {
+		return (cw_shm_tq_t *) NULL;
+	}
+
+	cw_shm_tq_t * queue = cw_shm_tq_map_internal(own_fd, (size_t) st.st_size);
+	if (!queue) {
+		close(own_fd);
+		return (cw_shm_tq_t *) NULL;
+	}
+
+	const uint32_t capacity = queue->header->capacity;
+	if (memcmp(queue->header->magic, cw_shm_tq_magic, sizeof (cw_shm_tq_magic))
+	    || capacity == 0
+	    || capacity > CW_SHM_TQ_CAPACITY_MAX
+	    || (capacity & (capacity - 1))
+	    || queue->size != sizeof (cw_shm_tq_header_t) + capacity * sizeof (cw_shm_tq_item_t)) {
+
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_TONE_QUEUE, CW_DEBUG_ERROR,
+			      MSG_PREFIX "attach: descriptor %d is not a valid shared queue", fd);
+		cw_shm_tq_delete(&queue);
+		errno = EINVAL;
+		return (cw_shm_tq_t *) NULL;
+	}
+	queue->mask = capacity - 1;
+
+	return queue;
+}
+
+
+
+
+cw_shm_tq_t * cw_shm_tq_map_internal(int fd, size_t size)
+{
+	void * segment = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (segment == MAP_FAILED) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "mmap()");
+		return (cw_shm_tq_t *) NULL;
+	}
+
+	cw_shm_tq_t * queue = (cw_shm_tq_t *) malloc(sizeof (cw_shm_tq_t));
+	if (!queue) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "malloc()");
+		munmap(segment, size);
+		return (cw_shm_tq_t *) NULL;
+	}
+
+	queue->fd = fd;
+	queue->size = size;
+	queue->header = (cw_shm_tq_header_t *) segment;
+	queue->items = (cw_shm_tq_item_t *) ((char *) segment + sizeof (cw_shm_tq_header_t));
+	queue->mask = 0;
+	queue->gen = (cw_gen_t *) NULL;
+	queue->do_forward = false;
+
+	return queue;
+}
+
+
+
+
+/**
+   \brief Delete shared queue
+
+   Forwarding of items to generator is stopped. Shared memory segment
+   is removed when all processes have deleted their queues.
+
+   \param queue - pointer to queue
+*/
+void cw_shm_tq_delete(cw_shm_tq_t ** queue)
+{
+	cw_assert (queue, MSG_PREFIX "delete: 'queue' argument can't be NULL\n");
+
+	if (!*queue) {
+		return;
+	}
+
+	cw_shm_tq_forward(*queue, (cw_gen_t *) NULL);
+
+	munmap((*queue)->header, (*queue)->size);
+	close((*queue)->fd);
+	free(*queue);
+	*queue = (cw_shm_tq_t *) NULL;
+
+	return;
+}
+
+
+
+
+/**
+   \param queue - queue
+
+   \return descriptor of shared memory segment of \p queue
+*/
+int cw_shm_tq_get_fd(cw_shm_tq_t const * queue)
+{
+	return queue->fd;
+}
+
+
+
+
+/**
+   \param queue - queue
+
+   \return count of items in \p queue that haven't been taken by consumer
+*/
+size_t cw_shm_tq_get_length(cw_shm_tq_t const * queue)
+{
+	const uint32_t head = __atomic_load_n(&queue->header->head, __ATOMIC_ACQUIRE);
+	const uint32_t tail = __atomic_load_n(&queue->header->tail, __ATOMIC_ACQUIRE);
+
+	return tail - head;
+}
+
+
+
+
+/**
+   \brief Put tone into shared queue
+
+   Function is called by producer.
+
+   \errno EINVAL - invalid \p usecs or \p frequency
+   \errno EAGAIN - queue is full
+
+   \param queue - queue
+   \param usecs - length of tone [us]
+   \param frequency - frequency of tone [Hz]
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_shm_tq_enqueue_tone(cw_shm_tq_t * queue, int usecs, int frequency)
+{
+	if (usecs < 0
+	    || frequency < CW_FREQUENCY_MIN
+	    || frequency > CW_FREQUENCY_MAX) {
+
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	const cw_shm_tq_item_t item = { .type = CW_SHM_TQ_ITEM_TONE, .value = frequency, .len = usecs };
+
+	return cw_shm_tq_put_internal(queue, &item, 1);
+}
+
+
+
+
+/**
+   \brief Put string into shared queue
+
+   Function is called by producer. Either all characters of \p string
+   are put into the queue, or none.
+
+   \errno ENOENT - \p string contains characters that aren't valid Morse characters
+   \errno EAGAIN - there is no space for all characters in queue
+
+   \param queue - queue
+   \param string - string to put
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_shm_tq_enqueue_string(cw_shm_tq_t * queue, const char * string)
+{
+	if (!cw_string_is_valid(string)) {
+		errno = ENOENT;
+		return CW_FAILURE;
+	}
+
+	/* Items are put in chunks, but all chunks are published at
+	   once, so check space for all of them first. */
+	const size_t len = strlen(string);
+	const uint32_t head = __atomic_load_n(&queue->header->head, __ATOMIC_ACQUIRE);
+	const uint32_t tail = queue->header->tail;
+	if (len > queue->mask + 1 - (tail - head)) {
+		errno = EAGAIN;
+		return CW_FAILURE;
+	}
+
+	for (size_t i = 0; i < len; i++) {
+		cw_shm_tq_item_t * item = &queue->items[(tail + i) & queue->mask];
+		item->type = CW_SHM_TQ_ITEM_CHARACTER;
+		item->value = (unsigned char) string[i];
+		item->len = 0;
+	}
+
+	__atomic_store_n(&queue->header->tail, tail + (uint32_t) len, __ATOMIC_SEQ_CST);
+	cw_shm_tq_wake_internal(queue);
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Put items into ring
+
+   \errno EAGAIN - there is no space for all items in ring
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_shm_tq_put_internal(cw_shm_tq_t * queue, const cw_shm_tq_item_t * items, size_t n_items)
+{
+	const uint32_t head = __atomic_load_n(&queue->header->head, __ATOMIC_ACQUIRE);
+	const uint32_t tail = queue->header->tail;
+	if (n_items > queue->mask + 1 - (tail - head)) {
+		errno = EAGAIN;
+		return CW_FAILURE;
+	}
+
+	for (size_t i = 0; i < n_items; i++) {
+		queue->items[(tail + i) & queue->mask] = items[i];
+	}
+
+	/* Sequentially consistent store of tail and load of
+	   'is_waiting' in cw_shm_tq_wake_internal() pair with store of
+	   'is_waiting' and load of tail in cw_shm_tq_wait_internal():
+	   either producer sees that consumer waits, or consumer sees
+	   the new items. */
+	__atomic_store_n(&queue->header->tail, tail + (uint32_t) n_items, __ATOMIC_SEQ_CST);
+	cw_shm_tq_wake_internal(queue);
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Wake up consumer if it waits for items
+*/
+void cw_shm_tq_wake_internal(cw_shm_tq_t * queue)
+{
+	if (!__atomic_load_n(&queue->header->is_waiting, __ATOMIC_SEQ_CST)) {
+		return;
+	}
+
+	__atomic_add_fetch(&queue->header->wake_sequence, 1, __ATOMIC_SEQ_CST);
+#if defined(HAVE_LINUX_FUTEX_H)
+	syscall(SYS_futex, &queue->header->wake_sequence, FUTEX_WAKE, 1, NULL, NULL, 0);
+#endif
+
+	return;
+}
+
+
+
+
+/**
+   \brief Wait until producer puts new items into ring
+
+   The function may return earlier (e.g. when forwarding is stopped).
+
+   \param queue - queue
+   \param head - head of ring, as seen by consumer
+*/
+void cw_shm_tq_wait_internal(cw_shm_tq_t * queue, uint32_t head)
+{
+	cw_shm_tq_header_t * header = queue->header;
+
+	/* Load the futex word before checking the ring, so that a
+	   wakeup done after the check makes futex wait return at
+	   once. */
+	const uint32_t sequence = __atomic_load_n(&header->wake_sequence, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&header->is_waiting, 1, __ATOMIC_SEQ_CST);
+
+	if (head == __atomic_load_n(&header->tail, __ATOMIC_SEQ_CST)
+	    && __atomic_load_n(&queue->do_forward, __ATOMIC_ACQUIRE)) {
+
+#if defined(HAVE_LINUX_FUTEX_H)
+		syscall(SYS_futex, &header->wake_sequence, FUTEX_WAIT, sequence, NULL, NULL, 0);
+#else
+		(void) sequence;
+		const struct timespec period = { .tv_sec = 0, .tv_nsec = CW_SHM_TQ_POLL_PERIOD };
+		nanosleep(&period, NULL);
+#endif
+	}
+
+	__atomic_store_n(&header->is_waiting, 0, __ATOMIC_SEQ_CST);
+
+	return;
+}
+
+
+
+
+/**
+   \brief Enqueue item of shared queue in generator's tone queue
+
+   \errno EAGAIN - generator's tone queue is full
+   \errno EINVAL - invalid item
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_shm_tq_enqueue_item_internal(cw_gen_t * gen, const cw_shm_tq_item_t * item)
+{
+	if (item->type == CW_SHM_TQ_ITEM_TONE) {
+		cw_tone_t tone;
+		CW_TONE_INIT(&tone, item->value, item->len, CW_SLOPE_MODE_STANDARD_SLOPES);
+		return cw_tq_enqueue_internal(gen->tq, &tone);
+
+	} else if (item->type == CW_SHM_TQ_ITEM_CHARACTER) {
+		if (item->value < 0 || item->value > UINT8_MAX) {
+			errno = EINVAL;
+			return CW_FAILURE;
+		}
+		return cw_gen_enqueue_character(gen, (char) item->value);
+
+	} else {
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+}
+
+
+
+
+void * cw_shm_tq_forward_thread_internal(void * arg)
+{
+	cw_shm_tq_t * queue = (cw_shm_tq_t *) arg;
+	cw_shm_tq_header_t * header = queue->header;
+
+	while (__atomic_load_n(&queue->do_forward, __ATOMIC_ACQUIRE)) {
+
+		const uint32_t head = header->head;
+		if (head == __atomic_load_n(&header->tail, __ATOMIC_ACQUIRE)) {
+			cw_shm_tq_wait_internal(queue, head);
+			continue;
+		}
+
+		const cw_shm_tq_item_t item = queue->items[head & queue->mask];
+		if (CW_SUCCESS != cw_shm_tq_enqueue_item_internal(queue->gen, &item)) {
+			if (errno == EAGAIN) {
+				/* Item stays in the ring until there
+				   is space in generator's tone queue. */
+				usleep(CW_SHM_TQ_FULL_RETRY_PERIOD);
+				continue;
+			}
+			cw_debug_msg (&cw_debug_object, CW_DEBUG_TONE_QUEUE, CW_DEBUG_WARNING,
+				      MSG_PREFIX "forward: dropping invalid item: type = %d, value = %d, len = %d",
+				      (int) item.type, (int) item.value, (int) item.len);
+		}
+
+		__atomic_store_n(&header->head, head + 1, __ATOMIC_RELEASE);
+	}
+
+	return NULL;
+}
+
+
+
+
+/**
+   \brief Forward items of shared queue to generator
+
+   Start a thread of calling process that takes items from \p queue
+   and enqueues them in tone queue of \p gen. Only one process at a
+   time should forward items of a shared queue. Pass NULL as \p gen
+   to stop forwarding (this is done also by cw_gen_delete()).
+
+   \errno EBUSY - \p queue is already forwarded to other generator,
+   or \p gen already gets items from other queue
+
+   \param queue - queue
+   \param gen - generator, or NULL
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_shm_tq_forward(cw_shm_tq_t * queue, cw_gen_t * gen)
+{
+	if (gen == queue->gen) {
+		return CW_SUCCESS;
+	}
+
+	if (gen && (queue->gen || gen->shm_tq)) {
+		errno = EBUSY;
+		return CW_FAILURE;
+	}
+
+	if (!gen) {
+		/* Stop forwarding. */
+		__atomic_store_n(&queue->do_forward, false, __ATOMIC_RELEASE);
+		__atomic_add_fetch(&queue->header->wake_sequence, 1, __ATOMIC_SEQ_CST);
+#if defined(HAVE_LINUX_FUTEX_H)
+		syscall(SYS_futex, &queue->header->wake_sequence, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+#endif
+		pthread_join(queue->thread, NULL);
+
+		queue->gen->shm_tq = (cw_shm_tq_t *) NULL;
+		queue->gen = (cw_gen_t *) NULL;
+
+		return CW_SUCCESS;
+	}
+
+	queue->gen = gen;
+	queue->do_forward = true;
+	int rv = pthread_create(&queue->thread, NULL, cw_shm_tq_forward_thread_internal, queue);
+	if (rv != 0) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "forward: failed to create thread: %d", rv);
+		queue->gen = (cw_gen_t *) NULL;
+		queue->do_forward = false;
+		errno = rv;
+		return CW_FAILURE;
+	}
+	gen->shm_tq = queue;
+
+	return CW_SUCCESS;
+}
@@ -0,0 +1,52 @@
+/*
+  This file is a part of unixcw project.
+  unixcw project is covered by GNU General Public License, version 2 or later.
+*/
+
+#ifndef H_LIBCW_SHM_TQ
+#define H_LIBCW_SHM_TQ
+
+
+
+
+#include <stdint.h>
+
+
+
+
+/* Version of layout of shared memory segment, written in segment's
+   header. Processes using different layouts can't share a queue. */
+#define CW_SHM_TQ_VERSION             1
+
+/* Largest capacity of shared queue [items]. Capacity must be a power
+   of two. */
+#define CW_SHM_TQ_CAPACITY_MAX    65536
+
+
+
+
+/* Types of items of shared queue. */
+enum {
+	CW_SHM_TQ_ITEM_TONE = 1,      /* Tone with given length and frequency. */
+	CW_SHM_TQ_ITEM_CHARACTER      /* Character, sent with parameters of consumer's generator. */
+};
+
+
+/* Item of shared queue. Items are stored in shared memory, so the
+   layout must not depend on compiler or on process. */
+typedef struct {
+	int32_t type;       /* CW_SHM_TQ_ITEM_* */
+	int32_t value;      /* Frequency of tone [Hz], or character. */
+	int32_t len;        /* Length of tone [us]. */
+} cw_shm_tq_item_t;
+
+
+
+
+/* Tone queue in memory shared between processes. */
+typedef struct cw_shm_tq_struct cw_shm_tq_t;
+
+
+
+
+#endif /* #ifndef H_LIBCW_SHM_TQ */
@@ -0,0 +1,892 @@
+/*
+  Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+  Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+/**
+   \file libcw_snapshot.c
+
+   \brief Snapshots of state of generators and receivers.
+
+   A snapshot is a compact, versioned, byte-order independent record
+   of state of a generator or of a receiver. A session (e.g. a
+   generator of cw_sched_t and a receiver) can be checkpointed, and
+   moved to another process or machine: snapshot taken with
+   cw_gen_snapshot() and restored with cw_gen_restore() into another
+   generator with the same sample rate makes that generator continue
+   with exactly the same samples that the first generator would have
+   produced.
+
+   Values derived from other values (timing parameters of generator,
+   tables of slopes, volume in absolute terms) aren't stored, they
+   are recalculated during restore. Things that are meaningful only
+   in a process that has created them (audio sink, callbacks, key,
+   encoder, timeline, file descriptors) aren't stored either, and are
+   left untouched by restore. Messages waiting for their time (see
+   cw_gen_enqueue_at()) and edges of straight key aren't stored.
+
+   Format of snapshot:
+
+   Header:
+   'C' 'W' 'S' version kind
+
+   Generator (kind CW_SNAPSHOT_KIND_GENERATOR):
+   varints: sample rate, speed, frequency, volume, gap, weighting
+   varints: slope shape, slope length, synthesis, alphabet, flags
+   8 bytes: phase of floating-point synthesis (IEEE 754 double, little endian)
+   varints: phase of fixed-point synthesis, remainder of the phase
+   tone being rendered (only if flags say so): tone, see below, and
+   varints: samples count, sample iterator, rising slope samples
+   count, falling slope samples count
+   varints: capacity, high water mark, length of tone queue
+   tones of tone queue, from head to tail: varints: frequency,
+   length, slope mode, symbol, flags
+
+   Receiver (kind CW_SNAPSHOT_KIND_RECEIVER):
+   varints: state, tolerance, gap, noise spike threshold, adaptive
+   speed threshold, alphabet, flags
+   8 bytes: speed
+   signed varints: seconds and microseconds of start and of end of
+   last mark
+   signed varints: 14 low-level timing parameters
+   varint: length of representation, and the representation
+   varint: index of statistics, and 256 entries of statistics:
+   varint: type, and (for types other than CW_REC_STAT_NONE) signed
+   varint: delta
+   signed varints: buffer, cursor, sum and average of dot averaging
+   and of dash averaging
+
+   Signed varints are zig-zag encoded.
+*/
+
+
+
+
+#include "config.h"
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+
+
+#include "libcw_snapshot.h"
+#include "libcw_gen.h"
+#include "libcw_tq.h"
+#include "libcw_rec.h"
+#include "libcw_codec.h"
+#include "libcw_alphabet.h"
+#include "libcw_debug.h"
+#include "libcw_utils.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+#define MSG_PREFIX "libcw/snapshot: "
+
+
+
+
+/* From libcw_debug.c. */
+extern cw_debug_t cw_debug_object;
+
+
+
+
+/* Flags of generator. */
+enum {
+	CW_SNAPSHOT_GEN_SYMBOLIC_ENQUEUE = 1 << 0,
+	CW_SNAPSHOT_GEN_HAS_TONE         = 1 << 1,
+	CW_SNAPSHOT_GEN_DEQUEUED_PREV    = 1 << 2,
+	CW_SNAPSHOT_GEN_FLAGS_ALL        = (1 << 3) - 1
+};
+
+/* Flags of tone. */
+enum {
+	CW_SNAPSHOT_TONE_IS_FOREVER = 1 << 0,
+	CW_SNAPSHOT_TONE_IS_FIRST   = 1 << 1,
+	CW_SNAPSHOT_TONE_FLAGS_ALL  = (1 << 2) - 1
+};
+
+/* Flags of receiver. */
+enum {
+	CW_SNAPSHOT_REC_IS_ADAPTIVE         = 1 << 0,
+	CW_SNAPSHOT_REC_PENDING_WORD_SPACE  = 1 << 1,
+	CW_SNAPSHOT_REC_PARAMETERS_IN_SYNC  = 1 << 2,
+	CW_SNAPSHOT_REC_FLAGS_ALL           = (1 << 3) - 1
+};
+
+static const uint8_t cw_snapshot_magic[] = { 'C', 'W', 'S', CW_SNAPSHOT_VERSION };
+
+
+
+
+/* Output of snapshot. Bytes that don't fit into output buffer are
+   counted, but not written, so that caller can learn size of whole
+   snapshot. */
+typedef struct {
+	uint8_t * bytes;
+	size_t size;
+	size_t n_bytes;
+} cw_snapshot_writer_t;
+
+/* Input of restore. Truncated snapshot or invalid value sets
+   'failed', and all values read after that are zero. */
+typedef struct {
+	const uint8_t * bytes;
+	size_t n_bytes;
+	size_t i;
+	bool failed;
+} cw_snapshot_reader_t;
+
+
+
+
+static void     cw_snapshot_put_bytes_internal(cw_snapshot_writer_t * w, const uint8_t * bytes, size_t n_bytes);
+static void     cw_snapshot_put_uint_internal(cw_snapshot_writer_t * w, uint64_t value);
+static void     cw_snapshot_put_int_internal(cw_snapshot_writer_t * w, int64_t value);
+static void     cw_snapshot_put_double_internal(cw_snapshot_writer_t * w, double value);
+static void     cw_snapshot_put_header_internal(cw_snapshot_writer_t * w, int kind);
+static void     cw_snapshot_put_tone_internal(cw_snapshot_writer_t * w, const volatile cw_tone_t * tone, bool with_position);
+static void     cw_snapshot_put_averaging_internal(cw_snapshot_writer_t * w, const cw_rec_averaging_t * avg);
+
+static uint64_t cw_snapshot_get_uint_internal(cw_snapshot_reader_t * r, uint64_t max);
+static int64_t  cw_snapshot_get_int_internal(cw_snapshot_reader_t * r, int64_t min, int64_t max);
+static double   cw_snapshot_get_double_internal(cw_snapshot_reader_t * r);
+static void     cw_snapshot_get_header_internal(cw_snapshot_reader_t * r, int kind);
+static void     cw_snapshot_get_tone_internal(cw_snapshot_reader_t * r, cw_tone_t * tone, bool with_position);
+static void     cw_snapshot_get_averaging_internal(cw_snapshot_reader_t * r, cw_rec_averaging_t * avg);
+
+
+
+
+/* ******************************************************************** */
+/*                           Section:Helpers                            */
+/* ******************************************************************** */
+
+
+
+
+void cw_snapshot_put_bytes_internal(cw_snapshot_writer_t * w, const uint8_t * bytes, size_t n_bytes)
+{
+	if (w->n_bytes + n_bytes <= w->size) {
+		memcpy(w->bytes + w->n_bytes, bytes, n_bytes);
+	}
+	w->n_bytes += n_bytes;
+
+	return;
+}
+
+
+
+
+void cw_snapshot_put_uint_internal(cw_snapshot_writer_t * w, uint64_t value)
+{
+	uint8_t bytes[10];
+	const size_t n = cw_codec_put_varint_internal(bytes, value);
+	cw_snapshot_put_bytes_internal(w, bytes, n);
+
+	return;
+}
+
+
+
+
+void cw_snapshot_put_int_internal(cw_snapshot_writer_t * w, int64_t value)
+{
+	/* Zig-zag: small negative values take as few bytes as small
+	   positive values. */
+	cw_snapshot_put_uint_internal(w, ((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+
+	return;
+}
+
+
+
+
+void cw_snapshot_put_double_internal(cw_snapshot_writer_t * w, double value)
+{
+	uint8_t bytes[8];
+	const size_t n = cw_codec_put_double_internal(bytes, value);
+	cw_snapshot_put_bytes_internal(w, bytes, n);
+
+	return;
+}
+
+
+
+
+void cw_snapshot_put_header_internal(cw_snapshot_writer_t * w, int kind)
+{
+	cw_snapshot_put_bytes_internal(w, cw_snapshot_magic, sizeof (cw_snapshot_magic));
+	const uint8_t k = (uint8_t) kind;
+	cw_snapshot_put_bytes_internal(w, &k, 1);
+
+	return;
+}
+
+
+
+
+/**
+   \brief Put tone into snapshot
+
+   \param w - output of snapshot
+   \param tone - tone
+   \param with_position - put also samples count of the tone and position in the tone
+*/
+void cw_snapshot_put_tone_internal(cw_snapshot_writer_t * w, const volatile cw_tone_t * tone, bool with_position)
+{
+	cw_snapshot_put_uint_internal(w, (uint64_t) tone->frequency);
+	cw_snapshot_put_uint_internal(w, (uint64_t) tone->len);
+	cw_snapshot_put_uint_internal(w, (uint64_t) tone->slope_mode);
+	cw_snapshot_put_uint_internal(w, (uint64_t) tone->symbol);
+	cw_snapshot_put_uint_internal(w, (tone->is_forever ? CW_SNAPSHOT_TONE_IS_FOREVER : 0)
+				      | (tone->is_first ? CW_SNAPSHOT_TONE_IS_FIRST : 0));
+
+	if (with_position) {
+		cw_snapshot_put_uint_internal(w, (uint64_t) tone->n_samples);
+		cw_snapshot_put_uint_internal(w, (uint64_t) tone->sample_iterator);
+		cw_snapshot_put_uint_internal(w, (uint64_t) tone->rising_slope_n_samples);
+		cw_snapshot_put_uint_internal(w, (uint64_t) tone->falling_slope_n_samples);
+	}
+
+	return;
+}
+
+
+
+
+void cw_snapshot_put_averaging_internal(cw_snapshot_writer_t * w, const cw_rec_averaging_t * avg)
+{
+	for (int k = 0; k < CW_REC_AVERAGING_ARRAY_LENGTH; k++) {
+		cw_snapshot_put_int_internal(w, avg->buffer[k]);
+	}
+	cw_snapshot_put_int_internal(w, avg->cursor);
+	cw_snapshot_put_int_internal(w, avg->sum);
+	cw_snapshot_put_int_internal(w, avg->average);
+
+	return;
+}
+
+
+
+
+/**
+   \brief Get varint from snapshot
+
+   \param r - input of restore
+   \param max - largest valid value
+
+   \return value, or zero if the value is invalid
+*/
+uint64_t cw_snapshot_get_uint_internal(cw_snapshot_reader_t * r, uint64_t max)
+{
+	uint64_t value = 0;
+	if (r->failed
+	    || !cw_codec_get_varint_internal(r->bytes, r->n_bytes, &r->i, &value)
+	    || value > max) {
+
+		r->failed = true;
+		return 0;
+	}
+
+	return value;
+}
+
+
+
+
+/**
+   \brief Get signed varint from snapshot
+
+   \param r - input of restore
+   \param min - smallest valid value
+   \param max - largest valid value
+
+   \return value, or zero if the value is invalid
+*/
+int64_t cw_snapshot_get_int_internal(cw_snapshot_reader_t * r, int64_t min, int64_t max)
+{
+	const uint64_t u = cw_snapshot_get_uint_internal(r, UINT64_MAX);
+	const int64_t value = (int64_t) (u >> 1) ^ -(int64_t) (u & 1);
+	if (r->failed || value < min || value > max) {
+		r->failed = true;
+		return 0;
+	}
+
+	return value;
+}
+
+
+
+
+/**
+   \brief Get double from snapshot
+
+   \param r - input of restore
+
+   \return finite value, or zero if the value is invalid
+*/
+double cw_snapshot_get_double_internal(cw_snapshot_reader_t * r)
+{
+	double value = 0.0;
+	if (r->failed
+	    || !cw_codec_get_double_internal(r->bytes, r->n_bytes, &r->i, &value)
+	    || !isfinite(value)) {
+
+		r->failed = true;
+		return 0.0;
+	}
+
+	return value;
+}
+
+
+
+
+void cw_snapshot_get_header_internal(cw_snapshot_reader_t * r, int kind)
+{
+	/* Snapshots of older versions of the format would be
+	   converted here. */
+	if (r->n_bytes < sizeof (cw_snapshot_magic) + 1
+	    || memcmp(r->bytes, cw_snapshot_magic, sizeof (cw_snapshot_magic))
+	    || r->bytes[sizeof (cw_snapshot_magic)] != kind) {
+
+		r->failed = true;
+		return;
+	}
+	r->i = sizeof (cw_snapshot_magic) + 1;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Get tone from snapshot
+
+   Values of tone are validated in the same way as by
+   cw_tq_enqueue_internal().
+
+   \param r - input of restore
+   \param tone - tone
+   \param with_position - get also samples count of the tone and position in the tone
+*/
+void cw_snapshot_get_tone_internal(cw_snapshot_reader_t * r, cw_tone_t * tone, bool with_position)
+{
+	CW_TONE_INIT(tone, 0, 0, CW_SLOPE_MODE_STANDARD_SLOPES);
+
+	tone->frequency  = (int) cw_snapshot_get_uint_internal(r, CW_FREQUENCY_MAX);
+	tone->len        = (int) cw_snapshot_get_uint_internal(r, INT_MAX);
+	tone->slope_mode = (int) cw_snapshot_get_uint_internal(r, CW_SLOPE_MODE_FALLING_SLOPE);
+	tone->symbol     = (int) cw_snapshot_get_uint_internal(r, CW_TONE_SYMBOL_COUNT - 1);
+	const uint64_t flags = cw_snapshot_get_uint_internal(r, CW_SNAPSHOT_TONE_FLAGS_ALL);
+	tone->is_forever = flags & CW_SNAPSHOT_TONE_IS_FOREVER;
+	tone->is_first   = flags & CW_SNAPSHOT_TONE_IS_FIRST;
+
+	if (tone->slope_mode < CW_SLOPE_MODE_STANDARD_SLOPES) {
+		r->failed = true;
+	}
+
+	if (with_position) {
+		tone->n_samples               = (int64_t) cw_snapshot_get_uint_internal(r, INT64_MAX);
+		tone->sample_iterator         = (int) cw_snapshot_get_uint_internal(r, INT_MAX);
+		tone->rising_slope_n_samples  = (int) cw_snapshot_get_uint_internal(r, INT_MAX);
+		tone->falling_slope_n_samples = (int) cw_snapshot_get_uint_internal(r, INT_MAX);
+
+		if (tone->sample_iterator > tone->n_samples) {
+			r->failed = true;
+		}
+	}
+
+	return;
+}
+
+
+
+
+void cw_snapshot_get_averaging_internal(cw_snapshot_reader_t * r, cw_rec_averaging_t * avg)
+{
+	for (int k = 0; k < CW_REC_AVERAGING_ARRAY_LENGTH; k++) {
+		avg->buffer[k] = (int) cw_snapshot_get_int_internal(r, INT_MIN, INT_MAX);
+	}
+	avg->cursor  = (int) cw_snapshot_get_int_internal(r, 0, CW_REC_AVERAGING_ARRAY_LENGTH - 1);
+	avg->sum     = (int) cw_snapshot_get_int_internal(r, INT_MIN, INT_MAX);
+	avg->average = (int) cw_snapshot_get_int_internal(r, INT_MIN, INT_MAX);
+
+	return;
+}
+
+
+
+
+/* ******************************************************************** */
+/*                          Section:Generator                           */
+/* ******************************************************************** */
+
+
+
+
+/**
+   \brief Take snapshot of state of generator
+
+   The snapshot contains generator's parameters, contents of its tone
+   queue, the tone that is being rendered (with position in the tone)
+   and phase of sine wave.
+
+   Only generator that doesn't have its own thread running can be
+   snapshotted, i.e. a stopped generator, or a generator driven by
+   external code (e.g. a session of cw_sched_t, between ticks of the
+   scheduler). Tone that is being rendered is known only for the
+   latter.
+
+   When \p size is too small, nothing is written to \p bytes, but \p
+   n_bytes is still set to size of snapshot, so the function can be
+   called with zero \p size to learn the size.
+
+   \errno EBUSY - generator's thread is running
+   \errno ENOSPC - \p size is smaller than size of snapshot
+
+   \param gen - generator
+   \param bytes - output buffer
+   \param size - size of output buffer
+   \param n_bytes - size of snapshot
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_gen_snapshot(cw_gen_t * gen, uint8_t * bytes, size_t size, size_t * n_bytes)
+{
+	if (gen->do_dequeue_and_generate) {
+		errno = EBUSY;
+		return CW_FAILURE;
+	}
+
+	cw_snapshot_writer_t w = { .bytes = bytes, .size = size, .n_bytes = 0 };
+
+	cw_snapshot_put_header_internal(&w, CW_SNAPSHOT_KIND_GENERATOR);
+
+	cw_snapshot_put_uint_internal(&w, (uint64_t) gen->sample_rate);
+	cw_snapshot_put_uint_internal(&w, (uint64_t) gen->send_speed);
+	cw_snapshot_put_uint_internal(&w, (uint64_t) gen->frequency);
+	cw_snapshot_put_uint_internal(&w, (uint64_t) gen->volume_percent);
+	cw_snapshot_put_uint_internal(&w, (uint64_t) gen->gap);
+	cw_snapshot_put_uint_internal(&w, (uint64_t) gen->weighting);
+	cw_snapshot_put_uint_internal(&w, (uint64_t) gen->tone_slope.shape);
+	cw_snapshot_put_uint_internal(&w, (uint64_t) gen->tone_slope.len);
+	cw_snapshot_put_uint_internal(&w, (uint64_t) gen->synthesis);
+	cw_snapshot_put_uint_internal(&w, (uint64_t) gen->alphabet);
+	cw_snapshot_put_uint_internal(&w, (gen->symbolic_enqueue ? CW_SNAPSHOT_GEN_SYMBOLIC_ENQUEUE : 0)
+				      | (gen->render.has_tone ? CW_SNAPSHOT_GEN_HAS_TONE : 0)
+				      | (gen->render.dequeued_prev ? CW_SNAPSHOT_GEN_DEQUEUED_PREV : 0));
+
+	cw_snapshot_put_double_internal(&w, gen->phase_offset);
+	cw_snapshot_put_uint_internal(&w, gen->phase_fixed);
+	cw_snapshot_put_uint_internal(&w, gen->phase_fixed_remainder);
+
+	if (gen->render.has_tone) {
+		cw_snapshot_put_tone_internal(&w, &gen->render.tone, true);
+	}
+
+	pthread_mutex_lock(&gen->tq->mutex);
+
+	cw_snapshot_put_uint_internal(&w, gen->tq->capacity);
+	cw_snapshot_put_uint_internal(&w, gen->tq->high_water_mark);
+	cw_snapshot_put_uint_internal(&w, gen->tq->len);
+	size_t idx = gen->tq->head;
+	for (size_t i = 0; i < gen->tq->len; i++) {
+		cw_snapshot_put_tone_internal(&w, &gen->tq->queue[idx], false);
+		idx = cw_tq_next_index_internal(gen->tq, idx);
+	}
+
+	pthread_mutex_unlock(&gen->tq->mutex);
+
+	*n_bytes = w.n_bytes;
+	if (w.n_bytes > size) {
+		errno = ENOSPC;
+		return CW_FAILURE;
+	}
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Restore state of generator from snapshot
+
+   Generator's parameters, contents of its tone queue, the tone that
+   is being rendered, and phase of sine wave are replaced with values
+   from snapshot taken with cw_gen_snapshot(). Messages waiting for
+   their time are flushed. The snapshot is validated before the
+   generator is modified, so generator is left untouched when the
+   function fails.
+
+   Sample rate of generator must be the same as sample rate of
+   generator that has been snapshotted.
+
+   \errno EBUSY - generator's thread is running
+   \errno EINVAL - \p bytes is not a valid snapshot of generator, or
+   the snapshot has been taken at other sample rate
+   \errno ENOMEM - failed to allocate table of slope amplitudes
+
+   \param gen - generator
+   \param bytes - snapshot
+   \param n_bytes - size of snapshot
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_gen_restore(cw_gen_t * gen, const uint8_t * bytes, size_t n_bytes)
+{
+	if (gen->do_dequeue_and_generate) {
+		errno = EBUSY;
+		return CW_FAILURE;
+	}
+
+	cw_snapshot_reader_t r = { .bytes = bytes, .n_bytes = n_bytes, .i = 0, .failed = false };
+
+	cw_snapshot_get_header_internal(&r, CW_SNAPSHOT_KIND_GENERATOR);
+
+	const int sample_rate = (int) cw_snapshot_get_uint_internal(&r, INT_MAX);
+	const int speed       = (int) cw_snapshot_get_uint_internal(&r, CW_SPEED_MAX);
+	const int frequency   = (int) cw_snapshot_get_uint_internal(&r, CW_FREQUENCY_MAX);
+	const int volume      = (int) cw_snapshot_get_uint_internal(&r, CW_VOLUME_MAX);
+	const int gap         = (int) cw_snapshot_get_uint_internal(&r, CW_GAP_MAX);
+	const int weighting   = (int) cw_snapshot_get_uint_internal(&r, CW_WEIGHTING_MAX);
+	const int slope_shape = (int) cw_snapshot_get_uint_internal(&r, CW_TONE_SLOPE_SHAPE_RECTANGULAR);
+	const int slope_len   = (int) cw_snapshot_get_uint_internal(&r, CW_USECS_PER_SEC);
+	const int synthesis   = (int) cw_snapshot_get_uint_internal(&r, CW_SYNTHESIS_FIXED_POINT);
+	const int alphabet    = (int) cw_snapshot_get_uint_internal(&r, CW_ALPHABET_MAX - 1);
+	const uint64_t flags  = cw_snapshot_get_uint_internal(&r, CW_SNAPSHOT_GEN_FLAGS_ALL);
+
+	const double phase_offset             = cw_snapshot_get_double_internal(&r);
+	const uint32_t phase_fixed            = (uint32_t) cw_snapshot_get_uint_internal(&r, UINT32_MAX);
+	const uint32_t phase_fixed_remainder  = (uint32_t) cw_snapshot_get_uint_internal(&r, UINT32_MAX);
+
+	cw_tone_t tone;
+	CW_TONE_INIT(&tone, 0, 0, CW_SLOPE_MODE_STANDARD_SLOPES);
+	if (flags & CW_SNAPSHOT_GEN_HAS_TONE) {
+		cw_snapshot_get_tone_internal(&r, &tone, true);
+	}
+
+	const size_t capacity        = (size_t) cw_snapshot_get_uint_internal(&r, CW_TONE_QUEUE_CAPACITY_MAX);
+	const size_t high_water_mark = (size_t) cw_snapshot_get_uint_internal(&r, capacity);
+	const size_t len             = (size_t) cw_snapshot_get_uint_internal(&r, capacity);
+
+	/* Validate tones of tone queue before anything in generator
+	   is changed, and put them into tone queue later. */
+	const size_t tones_start = r.i;
+	for (size_t i = 0; i < len && !r.failed; i++) {
+		cw_tone_t queued;
+		cw_snapshot_get_tone_internal(&r, &queued, false);
+	}
+
+	/* Rising and falling slopes of tone being rendered index the
+	   table of slope amplitudes, which will be recalculated for
+	   the slope length from the snapshot. */
+	const int slope_n_samples = cw_gen_slope_n_samples_internal(gen->sample_rate, slope_len);
+	const bool tone_valid = tone.rising_slope_n_samples <= slope_n_samples
+		&& tone.falling_slope_n_samples <= slope_n_samples
+		&& (int64_t) tone.rising_slope_n_samples + tone.falling_slope_n_samples <= tone.n_samples;
+
+	if (r.failed
+	    || r.i != n_bytes
+	    || !tone_valid
+	    || sample_rate != gen->sample_rate
+	    || speed < CW_SPEED_MIN
+	    || weighting < CW_WEIGHTING_MIN
+	    || (slope_shape == CW_TONE_SLOPE_SHAPE_RECTANGULAR && slope_len > 0)
+	    || capacity == 0
+	    || high_water_mark == 0
+	    || high_water_mark > CW_TONE_QUEUE_HIGH_WATER_MARK_MAX) {
+
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_GENERATOR, CW_DEBUG_ERROR,
+			      MSG_PREFIX "restore: invalid snapshot of generator");
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+
+	/* Parameters. Slopes are recalculated for synthesis and sample
+	   rate of the generator. Setting the slope is the only step
+	   that can fail (when the table of amplitudes can't be
+	   reallocated), and it leaves generator unchanged when it
+	   fails, so it goes first. */
+	if (CW_SUCCESS != cw_gen_set_tone_slope(gen, slope_shape, slope_len)) {
+		errno = ENOMEM;
+		return CW_FAILURE;
+	}
+	cw_gen_set_synthesis(gen, synthesis);
+	cw_gen_set_volume(gen, volume);
+	cw_gen_set_speed(gen, speed);
+	cw_gen_set_frequency(gen, frequency);
+	cw_gen_set_gap(gen, gap);
+	cw_gen_set_weighting(gen, weighting);
+	cw_gen_set_symbolic_enqueue(gen, flags & CW_SNAPSHOT_GEN_SYMBOLIC_ENQUEUE);
+	cw_gen_set_alphabet(gen, alphabet);
+	cw_gen_sync_parameters_internal(gen);
+
+	gen->phase_offset = phase_offset;
+	gen->phase_fixed = phase_fixed;
+	gen->phase_fixed_remainder = phase_fixed_remainder;
+
+
+	/* Tone queue. */
+	cw_gen_flush_queue(gen);
+	cw_tq_set_capacity_internal(gen->tq, capacity, high_water_mark);
+
+	/* The tones have been validated, and there are no more of them
+	   than capacity of the queue, so enqueueing can't fail. */
+	r.i = tones_start;
+	for (size_t i = 0; i < len; i++) {
+		cw_tone_t queued;
+		cw_snapshot_get_tone_internal(&r, &queued, false);
+		cw_tq_enqueue_internal(gen->tq, &queued);
+	}
+
+
+	/* Tone being rendered. */
+	gen->render.has_tone = flags & CW_SNAPSHOT_GEN_HAS_TONE;
+	gen->render.dequeued_prev = flags & CW_SNAPSHOT_GEN_DEQUEUED_PREV;
+	CW_TONE_COPY(&gen->render.tone, &tone);
+	if (gen->render.has_tone) {
+		__atomic_store_n(&gen->is_playing, true, __ATOMIC_RELEASE);
+	}
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/* ******************************************************************** */
+/*                           Section:Receiver                           */
+/* ******************************************************************** */
+
+
+
+
+/**
+   \brief Take snapshot of state of receiver
+
+   The snapshot contains receiver's parameters, state of its state
+   machine, timestamps of last mark, received representation,
+   statistics and averaging of lengths of marks.
+
+   Receiver must not be used by other threads during the call.
+
+   When \p size is too small, nothing is written to \p bytes, but \p
+   n_bytes is still set to size of snapshot.
+
+   \errno ENOSPC - \p size is smaller than size of snapshot
+   \errno EBUSY - queue of received characters is running (see cw_rec_start_output())
+
+   \param rec - receiver
+   \param bytes - output buffer
+   \param size - size of output buffer
+   \param n_bytes - size of snapshot
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_rec_snapshot(cw_rec_t const * rec, uint8_t * bytes, size_t size, size_t * n_bytes)
+{
+	if (rec->output.is_running) {
+		/* Receiver is used by thread of its queue. */
+		errno = EBUSY;
+		return CW_FAILURE;
+	}
+
+	cw_snapshot_writer_t w = { .bytes = bytes, .size = size, .n_bytes = 0 };
+
+	cw_snapshot_put_header_internal(&w, CW_SNAPSHOT_KIND_RECEIVER);
+
+	cw_snapshot_put_uint_internal(&w, (uint64_t) rec->state);
+	cw_snapshot_put_uint_internal(&w, (uint64_t) rec->tolerance);
+	cw_snapshot_put_uint_internal(&w, (uint64_t) rec->gap);
+	cw_snapshot_put_uint_internal(&w, (uint64_t) rec->noise_spike_threshold);
+	cw_snapshot_put_uint_internal(&w, (uint64_t) rec->adaptive_speed_threshold);
+	cw_snapshot_put_uint_internal(&w, (uint64_t) rec->alphabet);
+	cw_snapshot_put_uint_internal(&w, (rec->is_adaptive_receive_mode ? CW_SNAPSHOT_REC_IS_ADAPTIVE : 0)
+				      | (rec->is_pending_inter_word_space ? CW_SNAPSHOT_REC_PENDING_WORD_SPACE : 0)
+				      | (rec->parameters_in_sync ? CW_SNAPSHOT_REC_PARAMETERS_IN_SYNC : 0));
+	cw_snapshot_put_double_internal(&w, rec->speed);
+
+	cw_snapshot_put_int_internal(&w, rec->mark_start.tv_sec);
+	cw_snapshot_put_int_internal(&w, rec->mark_start.tv_usec);
+	cw_snapshot_put_int_internal(&w, rec->mark_end.tv_sec);
+	cw_snapshot_put_int_internal(&w, rec->mark_end.tv_usec);
+
+	/* In adaptive mode these are not exactly derivable from
+	   speed (see cw_rec_sync_parameters_internal()), so they are
+	   stored as they are. */
+	const int timing[] = {
+		rec->dot_len_ideal, rec->dot_len_min, rec->dot_len_max,
+		rec->dash_len_ideal, rec->dash_len_min, rec->dash_len_max,
+		rec->eom_len_ideal, rec->eom_len_min, rec->eom_len_max,
+		rec->eoc_len_ideal, rec->eoc_len_min, rec->eoc_len_max,
+		rec->additional_delay, rec->adjustment_delay };
+	for (size_t k = 0; k < sizeof (timing) / sizeof (timing[0]); k++) {
+		cw_snapshot_put_int_internal(&w, timing[k]);
+	}
+
+	cw_snapshot_put_uint_internal(&w, (uint64_t) rec->representation_ind);
+	cw_snapshot_put_bytes_internal(&w, (const uint8_t *) rec->representation, (size_t) rec->representation_ind);
+
+	cw_snapshot_put_uint_internal(&w, (uint64_t) rec->statistics_ind);
+	for (int k = 0; k < CW_REC_STATISTICS_CAPACITY; k++) {
+		cw_snapshot_put_uint_internal(&w, (uint64_t) rec->statistics[k].type);
+		if (rec->statistics[k].type != CW_REC_STAT_NONE) {
+			cw_snapshot_put_int_internal(&w, rec->statistics[k].delta);
+		}
+	}
+
+	cw_snapshot_put_averaging_internal(&w, &rec->dot_averaging);
+	cw_snapshot_put_averaging_internal(&w, &rec->dash_averaging);
+
+	*n_bytes = w.n_bytes;
+	if (w.n_bytes > size) {
+		errno = ENOSPC;
+		return CW_FAILURE;
+	}
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Restore state of receiver from snapshot
+
+   Receiver's parameters and state are replaced with values from
+   snapshot taken with cw_rec_snapshot(). The receiver is left
+   untouched when the function fails.
+
+   Timestamps passed to the receiver after restore must come from the
+   same clock as timestamps passed to snapshotted receiver.
+
+   \errno EINVAL - \p bytes is not a valid snapshot of receiver
+   \errno EBUSY - queue of received characters is running (see cw_rec_start_output())
+
+   \param rec - receiver
+   \param bytes - snapshot
+   \param n_bytes - size of snapshot
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_rec_restore(cw_rec_t * rec, const uint8_t * bytes, size_t n_bytes)
+{
+	if (rec->output.is_running) {
+		/* Receiver is used by thread of its queue. */
+		errno = EBUSY;
+		return CW_FAILURE;
+	}
+
+	cw_snapshot_reader_t r = { .bytes = bytes, .n_bytes = n_bytes, .i = 0, .failed = false };
+
+	/* Receiver is modified only after whole snapshot has been
+	   validated. Members that aren't stored in snapshot keep
+	   their values. */
+	cw_rec_t state = *rec;
+
+	cw_snapshot_get_header_internal(&r, CW_SNAPSHOT_KIND_RECEIVER);
+
+	state.state                    = (int) cw_snapshot_get_uint_internal(&r, RS_EOW_GAP_ERR);
+	state.tolerance                = (int) cw_snapshot_get_uint_internal(&r, CW_TOLERANCE_MAX);
+	state.gap                      = (int) cw_snapshot_get_uint_internal(&r, CW_GAP_MAX);
+	state.noise_spike_threshold    = (int) cw_snapshot_get_uint_internal(&r, INT_MAX);
+	state.adaptive_speed_threshold = (int) cw_snapshot_get_uint_internal(&r, INT_MAX);
+	state.alphabet                 = (int) cw_snapshot_get_uint_internal(&r, CW_ALPHABET_MAX - 1);
+	const uint64_t flags           = cw_snapshot_get_uint_internal(&r, CW_SNAPSHOT_REC_FLAGS_ALL);
+	state.is_adaptive_receive_mode    = flags & CW_SNAPSHOT_REC_IS_ADAPTIVE;
+	state.is_pending_inter_word_space = flags & CW_SNAPSHOT_REC_PENDING_WORD_SPACE;
+	state.parameters_in_sync          = flags & CW_SNAPSHOT_REC_PARAMETERS_IN_SYNC;
+	const double speed = cw_snapshot_get_double_internal(&r);
+	state.speed = (float) speed;
+
+	state.mark_start.tv_sec  = (time_t) cw_snapshot_get_int_internal(&r, INT64_MIN, INT64_MAX);
+	state.mark_start.tv_usec = (suseconds_t) cw_snapshot_get_int_internal(&r, 0, CW_USECS_PER_SEC - 1);
+	state.mark_end.tv_sec    = (time_t) cw_snapshot_get_int_internal(&r, INT64_MIN, INT64_MAX);
+	state.mark_end.tv_usec   = (suseconds_t) cw_snapshot_get_int_internal(&r, 0, CW_USECS_PER_SEC - 1);
+
+	int * timing[] = {
+		&state.dot_len_ideal, &state.dot_len_min, &state.dot_len_max,
+		&state.dash_len_ideal, &state.dash_len_min, &state.dash_len_max,
+		&state.eom_len_ideal, &state.eom_len_min, &state.eom_len_max,
+		&state.eoc_len_ideal, &state.eoc_len_min, &state.eoc_len_max,
+		&state.additional_delay, &state.adjustment_delay };
+	for (size_t k = 0; k < sizeof (timing) / sizeof (timing[0]); k++) {
+		*timing[k] = (int) cw_snapshot_get_int_internal(&r, INT_MIN, INT_MAX);
+	}
+
+	state.representation_ind = (int) cw_snapshot_get_uint_internal(&r, CW_REC_REPRESENTATION_CAPACITY);
+	memset(state.representation, 0, sizeof (state.representation));
+	if (!r.failed && n_bytes - r.i >= (size_t) state.representation_ind) {
+		memcpy(state.representation, bytes + r.i, (size_t) state.representation_ind);
+		r.i += (size_t) state.representation_ind;
+	} else {
+		r.failed = true;
+	}
+	for (int k = 0; k < state.representation_ind; k++) {
+		if (state.representation[k] != CW_DOT_REPRESENTATION
+		    && state.representation[k] != CW_DASH_REPRESENTATION) {
+			r.failed = true;
+		}
+	}
+
+	state.statistics_ind = (int) cw_snapshot_get_uint_internal(&r, CW_REC_STATISTICS_CAPACITY - 1);
+	for (int k = 0; k < CW_REC_STATISTICS_CAPACITY; k++) {
+		state.statistics[k].type = (stat_type_t) cw_snapshot_get_uint_internal(&r, CW_REC_STAT_ICHAR_SPACE);
+		state.statistics[k].delta = 0;
+		if (state.statistics[k].type != CW_REC_STAT_NONE) {
+			state.statistics[k].delta = (int) cw_snapshot_get_int_internal(&r, INT_MIN, INT_MAX);
+		}
+	}
+
+	cw_snapshot_get_averaging_internal(&r, &state.dot_averaging);
+	cw_snapshot_get_averaging_internal(&r, &state.dash_averaging);
+
+	if (r.failed
+	    || r.i != n_bytes
+	    || speed < CW_SPEED_MIN
+	    || speed > CW_SPEED_MAX
+	    || state.tolerance < CW_TOLERANCE_MIN
+	    || state.adaptive_speed_threshold == 0) {
+
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_RECEIVE_STATES, CW_DEBUG_ERROR,
+			      MSG_PREFIX "restore: invalid snapshot of receiver");
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	*rec = state;
+
+	return CW_SUCCESS;
+}
@@ -0,0 +1,23 @@
+/*
+  This file is a part of unixcw project.
+  unixcw project is covered by GNU General Public License, version 2 or later.
+*/
+
+#ifndef H_LIBCW_SNAPSHOT
+#define H_LIBCW_SNAPSHOT
+
+
+
+
+/* Version of format of snapshots, written in snapshot's header.
+   Snapshots with newer version are rejected. */
+#define CW_SNAPSHOT_VERSION            1
+
+/* Kinds of snapshots, written in snapshot's header. */
+#define CW_SNAPSHOT_KIND_GENERATOR   'G'
+#define CW_SNAPSHOT_KIND_RECEIVER    'R'
+
+
+
+
+#endif /* #ifndef H_LIBCW_SNAPSHOT */
@@ -71,6 +71,7 @@
 #include <pthread.h>
 #include <signal.h> /* SIGALRM */
 #include <unistd.h> /* sleep() */
+#include <time.h> /* CLOCK_MONOTONIC */
 
 
 
@@ -177,6 +178,21 @@ cw_tone_queue_t *cw_tq_new_internal(void)
 		return (cw_tone_queue_t *) NULL;
 	}
 
+	cw_tq_init_internal(tq);
+
+	return tq;
+}
+
+
+
+
+/**
+   \brief Initialize tone queue in memory provided by caller
+
+   \param tq - tone queue to initialize
+*/
+void cw_tq_init_internal(cw_tone_queue_t *tq)
+{
 	int rv = pthread_mutex_init(&tq->mutex, NULL);
 	cw_assert (!rv, MSG_PREFIX "new: failed to initialize mutex");
 
@@ -185,7 +201,14 @@ cw_tone_queue_t *cw_tq_new_internal(void)
 	pthread_cond_init(&tq->wait_var, NULL);
 	pthread_mutex_init(&tq->wait_mutex, NULL);
 
-	pthread_cond_init(&tq->dequeue_var, NULL);
+	/* Generator waits on the variable with a deadline calculated
+	   from time of messages enqueued with cw_gen_enqueue_at(), so
+	   the deadline must not be affected by changes of wall clock. */
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&tq->dequeue_var, &attr);
+	pthread_condattr_destroy(&attr);
 	pthread_mutex_init(&tq->dequeue_mutex, NULL);
 
 	/* This function operates on cw_tq_t::wait_var and
@@ -205,7 +228,7 @@ cw_tone_queue_t *cw_tq_new_internal(void)
 
 	pthread_mutex_unlock(&tq->mutex);
 
-	return tq;
+	return;
 }
 
 
@@ -229,7 +252,26 @@ void cw_tq_delete_internal(cw_tone_queue_t **tq)
 		return;
 	}
 
+	cw_tq_deinit_internal(*tq);
+
+	free(*tq);
+	*tq = (cw_tone_queue_t *) NULL;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Release resources held by tone queue
+
+   Memory of \p tq itself is not deallocated.
 
+   \param tq - tone queue
+*/
+void cw_tq_deinit_internal(cw_tone_queue_t *tq)
+{
 	/* Don't call pthread_cond_destroy().
 
 	   When pthread_cond_wait() is waiting for signal, and a
@@ -250,18 +292,38 @@ void cw_tq_delete_internal(cw_tone_queue_t **tq)
 
 	   So don't call _destroy(). */
 
-	//pthread_cond_destroy(&(*tq)->wait_var);
-	pthread_mutex_destroy(&(*tq)->wait_mutex);
+	//pthread_cond_destroy(&tq->wait_var);
+	pthread_mutex_destroy(&tq->wait_mutex);
 
-	//pthread_cond_destroy(&(*tq)->dequeue_var);
-	pthread_mutex_destroy(&(*tq)->dequeue_mutex);
+	//pthread_cond_destroy(&tq->dequeue_var);
+	pthread_mutex_destroy(&tq->dequeue_mutex);
 
+	pthread_mutex_destroy(&tq->mutex);
 
-	pthread_mutex_destroy(&(*tq)->mutex);
+	return;
+}
 
 
-	free(*tq);
-	*tq = (cw_tone_queue_t *) NULL;
+
+
+/**
+   \brief Update queued duration of tone queue
+
+   Add (\p sign == 1) or subtract (\p sign == -1) \p tone to/from
+   queued duration of \p tq. The function should be called under
+   tq->mutex, every time a tone is added to or removed from the queue.
+
+   \param tq - tone queue
+   \param tone - tone added to or removed from the queue
+   \param sign - direction of update
+*/
+void cw_tq_account_tone_internal(cw_tone_queue_t * tq, const volatile cw_tone_t * tone, int sign)
+{
+	if (tone->symbol == CW_TONE_SYMBOL_NONE) {
+		__atomic_add_fetch(&tq->duration, (int64_t) sign * tone->len, __ATOMIC_RELAXED);
+	} else {
+		__atomic_add_fetch(&tq->n_symbols[tone->symbol], (uint32_t) sign, __ATOMIC_RELAXED);
+	}
 
 	return;
 }
@@ -287,6 +349,11 @@ void cw_tq_make_empty_internal(cw_tone_queue_t * tq)
 	tq->len = 0;
 	tq->state = CW_TQ_IDLE;
 
+	__atomic_store_n(&tq->duration, 0, __ATOMIC_RELAXED);
+	for (int i = 0; i < CW_TONE_SYMBOL_COUNT; i++) {
+		__atomic_store_n(&tq->n_symbols[i], 0, __ATOMIC_RELAXED);
+	}
+
 	//fprintf(stderr, MSG_PREFIX "make empty: broadcast on tq->len = 0\n");
 	pthread_cond_broadcast(&tq->wait_var);
 	pthread_mutex_unlock(&tq->wait_mutex);
@@ -487,6 +554,9 @@ size_t cw_tq_next_index_internal(const cw_tone_queue_t *tq, size_t ind)
    \p tq must be a valid queue.
    \p tone must be allocated by caller.
 
+   Length of dequeued symbolic tone is resolved with generator's
+   current timing parameters (see cw_gen_resolve_tone_len_internal()).
+
    If queue \p tq has registered low water callback function, and
    condition to call the function is met after dequeue has occurred,
    the function calls the callback.
@@ -515,6 +585,10 @@ int cw_tq_dequeue_internal(cw_tone_queue_t *tq, /* out */ cw_tone_t *tone)
 		cw_assert (tq->len, MSG_PREFIX "dequeue: tone queue is CW_TQ_BUSY, but tq->len = %zu\n", tq->len);
 
 		bool call_callback = cw_tq_dequeue_sub_internal(tq, tone);
+		if (tq->gen) {
+			/* Lengths of symbols can't change under tq->mutex. */
+			cw_gen_resolve_tone_len_internal(tq->gen, tone);
+		}
 
 		if (!tq->len) {
 			tq->state = CW_TQ_IDLE;
@@ -585,6 +659,7 @@ bool cw_tq_dequeue_sub_internal(cw_tone_queue_t * tq, /* out */ cw_tone_t * tone
 	size_t tq_len_before = tq->len;
 
 	/* Dequeue. We already have the tone, now update tq's state. */
+	cw_tq_account_tone_internal(tq, &tq->queue[tq->head], -1);
 	tq->head = cw_tq_next_index_internal(tq, tq->head);
 	tq->len--;
 	//fprintf(stderr, MSG_PREFIX "dequeue sub: broadcast on tq->len--\n");
@@ -641,7 +716,9 @@ bool cw_tq_dequeue_sub_internal(cw_tone_queue_t * tq, /* out */ cw_tone_t * tone
    CW_FREQUENCY_MIN-CW_FREQUENCY_MAX range.
 
    If length of a tone (tone->len) is zero, the function does not
-   add it to tone queue and returns CW_SUCCESS.
+   add it to tone queue and returns CW_SUCCESS. Symbolic tones are
+   always added, because their length may change before they are
+   dequeued.
 
    The function does not accept tones with negative values of len.
 
@@ -673,7 +750,7 @@ int cw_tq_enqueue_internal(cw_tone_queue_t *tq, cw_tone_t *tone)
 		return CW_FAILURE;
 	}
 
-	if (tone->len == 0) {
+	if (tone->len == 0 && tone->symbol == CW_TONE_SYMBOL_NONE) {
 		/* Drop empty tone. It won't be played anyway, and for
 		   now there are no other good reasons to enqueue
 		   it. While it may happen in higher-level code to
@@ -709,6 +786,11 @@ int cw_tq_enqueue_internal(cw_tone_queue_t *tq, cw_tone_t *tone)
 	   means that for empty tq new tone is inserted at index
 	   tail == head (which should be kind of obvious). */
 	tq->queue[tq->tail] = *tone;
+	cw_tq_account_tone_internal(tq, tone, 1);
+	if (tq->gen) {
+		cw_gen_key_edges_enqueue_internal(tq->gen);
+		__atomic_store_n(&tq->gen->is_playing, true, __ATOMIC_RELEASE);
+	}
 
 	tq->tail = cw_tq_next_index_internal(tq, tq->tail);
 	tq->len++;
@@ -897,6 +979,9 @@ void cw_tq_flush_internal(cw_tone_queue_t *tq)
 	pthread_mutex_lock(&tq->mutex);
 	/* Force zero length state. */
 	cw_tq_make_empty_internal(tq);
+	if (tq->gen) {
+		cw_gen_key_edges_flush_internal(tq->gen);
+	}
 	pthread_mutex_unlock(&tq->mutex);
 
 
@@ -954,6 +1039,12 @@ void cw_tq_handle_backspace_internal(cw_tone_queue_t *tq)
 	}
 
 	if (is_found) {
+		if (tq->gen) {
+			cw_gen_key_edges_backspace_internal(tq->gen, idx);
+		}
+		for (size_t i = idx; i != tq->tail; i = cw_tq_next_index_internal(tq, i)) {
+			cw_tq_account_tone_internal(tq, &tq->queue[i], -1);
+		}
 		tq->len = len;
 		tq->tail = idx;
 	}
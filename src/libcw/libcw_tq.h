@@ -60,6 +60,22 @@ enum cw_queue_state {
 };
 
 
+/* Symbolic elements of Morse code stored in cw_tone_t.symbol. Length
+   of a tone with symbol other than CW_TONE_SYMBOL_NONE is resolved by
+   generator at dequeue time, from timing parameters that the
+   generator has at that time. */
+enum {
+	CW_TONE_SYMBOL_NONE = 0,         /* Tone with fixed length. */
+	CW_TONE_SYMBOL_DOT,
+	CW_TONE_SYMBOL_DASH,
+	CW_TONE_SYMBOL_EOM_SPACE,        /* Inter-mark space. */
+	CW_TONE_SYMBOL_EOC_SPACE,        /* Additional inter-character space, with Farnsworth gap. */
+	CW_TONE_SYMBOL_EOW_SPACE_PART,   /* Part of additional inter-word space, see cw_gen_enqueue_eow_space_internal(). */
+	CW_TONE_SYMBOL_ADJUSTMENT_SPACE, /* Inter-word adjustment space. */
+	CW_TONE_SYMBOL_COUNT
+};
+
+
 /* Return values from dequeue function. */
 enum {
 	CW_TQ_DEQUEUED        = 10,
@@ -89,6 +105,11 @@ typedef struct {
 	/* Type of slope. */
 	int slope_mode;
 
+	/* Symbolic element represented by the tone (CW_TONE_SYMBOL_*).
+	   For symbolic tones 'len' is only a length calculated at
+	   enqueue time. */
+	int symbol;
+
 	/* Duration of a tone, in samples.
 	   This is a derived value, a function of lenght and sample rate. */
 
@@ -151,6 +172,7 @@ typedef struct {
 		(m_tone)->slope_mode              = m_slope_mode;	\
 		(m_tone)->is_forever              = false;		\
 		(m_tone)->is_first                = false;		\
+		(m_tone)->symbol                  = CW_TONE_SYMBOL_NONE; \
 		(m_tone)->n_samples               = 0;			\
 		(m_tone)->sample_iterator         = 0;			\
 		(m_tone)->rising_slope_n_samples  = 0;			\
@@ -167,6 +189,7 @@ typedef struct {
 		(m_dest)->slope_mode              = (m_source)->slope_mode; \
 		(m_dest)->is_forever              = (m_source)->is_forever; \
 		(m_dest)->is_first                = (m_source)->is_first; \
+		(m_dest)->symbol                  = (m_source)->symbol; \
 		(m_dest)->n_samples               = (m_source)->n_samples; \
 		(m_dest)->sample_iterator         = (m_source)->sample_iterator;	\
 		(m_dest)->rising_slope_n_samples  = (m_source)->rising_slope_n_samples; \
@@ -200,6 +223,17 @@ typedef struct {
 	size_t high_water_mark;
 	size_t len;
 
+	/* Duration of queued tones. Updated (atomically) on every
+	   change of contents of the queue, so that it can be read
+	   without walking the queue and without locking, see
+	   cw_gen_get_queued_duration().
+
+	   'duration' is sum of lengths of tones with fixed length
+	   [us]. Lengths of symbolic tones are known only to generator,
+	   so they are counted per symbol in 'n_symbols[]'. */
+	int64_t duration;
+	uint32_t n_symbols[CW_TONE_SYMBOL_COUNT];
+
 	/* It's useful to have the tone queue dequeue function call
 	   a client-supplied callback routine when the amount of data
 	   in the queue drops below a defined low water mark.
@@ -235,9 +269,13 @@ typedef struct {
 
 cw_tone_queue_t *cw_tq_new_internal(void);
 void             cw_tq_delete_internal(cw_tone_queue_t **tq);
+void             cw_tq_init_internal(cw_tone_queue_t *tq);
+void             cw_tq_deinit_internal(cw_tone_queue_t *tq);
 void             cw_tq_flush_internal(cw_tone_queue_t *tq);
 
+int    cw_tq_set_capacity_internal(cw_tone_queue_t *tq, size_t capacity, size_t high_water_mark);
 size_t cw_tq_get_capacity_internal(cw_tone_queue_t *tq);
+size_t cw_tq_next_index_internal(const cw_tone_queue_t *tq, size_t ind);
 size_t cw_tq_length_internal(cw_tone_queue_t *tq);
 int    cw_tq_enqueue_internal(cw_tone_queue_t *tq, cw_tone_t *tone);
 int    cw_tq_dequeue_internal(cw_tone_queue_t *tq, cw_tone_t *tone);
@@ -15,12 +15,11 @@
 
 
 
-CW_STATIC_FUNC int    cw_tq_set_capacity_internal(cw_tone_queue_t * tq, size_t capacity, size_t high_water_mark);
 CW_STATIC_FUNC size_t cw_tq_get_high_water_mark_internal(const cw_tone_queue_t * tq) __attribute__((unused));
 CW_STATIC_FUNC size_t cw_tq_prev_index_internal(const cw_tone_queue_t * tq, size_t ind) __attribute__((unused));
-CW_STATIC_FUNC size_t cw_tq_next_index_internal(const cw_tone_queue_t * tq, size_t ind);
 CW_STATIC_FUNC bool   cw_tq_dequeue_sub_internal(cw_tone_queue_t * tq, cw_tone_t * tone);
 CW_STATIC_FUNC void   cw_tq_make_empty_internal(cw_tone_queue_t * tq);
+CW_STATIC_FUNC void   cw_tq_account_tone_internal(cw_tone_queue_t * tq, const volatile cw_tone_t * tone, int sign);
 
 
 
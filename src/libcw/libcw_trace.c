@@ -0,0 +1,878 @@
+/*
+  Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+  Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+/**
+   \file libcw_trace.c
+
+   \brief Recording of key events to a compact trace, and replaying
+   of the trace.
+
+   Recorder is registered as keying callback of a key (see
+   cw_key_register_keying_callback()) and appends every change of
+   key's state to a file. The trace can be later replayed into a
+   receiver (to decode it again, e.g. with different parameters of
+   receiver) and/or into a key with generator (to hear it again), at
+   original speed, faster, or without any pacing at all.
+
+   Format of trace:
+
+   A trace is a sequence of sessions. Every session starts with a
+   header:
+   0x00 'C' 'W' 'T' version
+   varint: speed [wpm]
+   varint: tolerance
+   varint: gap
+   varint: weighting
+   varint: frequency [Hz]
+   varint: adaptive mode of receiver (0/1)
+   varint: seconds of timestamp of beginning of session
+   varint: microseconds of timestamp of beginning of session
+
+   The header is followed by events. Every event is a single varint:
+   ((delta << 1) | key_state) + 1, where delta is count of
+   microseconds since previous event (or since beginning of session
+   for first event in session). Thanks to the "+1" an event never
+   starts with 0x00 byte, so a header of next session can be
+   recognized by its first byte.
+
+   Varints are unsigned LEB128. A typical event of keying at 20-30
+   WPM takes two or three bytes.
+
+   Recorder only appends data to a file, and writes header of a
+   session before first event of the session, so concatenation of
+   traces is a valid trace too.
+*/
+
+
+
+
+#include "config.h"
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+
+
+#include "libcw_trace.h"
+#include "libcw_codec.h"
+#include "libcw_key.h"
+#include "libcw_rec.h"
+#include "libcw_debug.h"
+#include "libcw_utils.h"
+#include "libcw2.h"
+
+
+
+
+#define MSG_PREFIX "libcw/trace: "
+
+
+
+
+/* From libcw_debug.c. */
+extern cw_debug_t cw_debug_object;
+extern cw_debug_t cw_debug_object_dev;
+
+
+
+
+/* Longest possible varint (64-bit value). */
+#define CW_TRACE_VARINT_SIZE_MAX 10
+
+/* Longest possible header: five bytes of magic and version, and
+   eight varints. */
+#define CW_TRACE_HEADER_SIZE_MAX (5 + 8 * CW_TRACE_VARINT_SIZE_MAX)
+
+/* When replaying a trace, characters that are still in receiver at
+   the end of session are polled with timestamp of last event
+   incremented by this value. This is longer than inter-word space at
+   lowest supported speed. */
+#define CW_TRACE_FINAL_SPACE_LEN (10 * CW_USECS_PER_SEC)
+
+static const uint8_t cw_trace_magic[] = { 0x00, 'C', 'W', 'T', CW_TRACE_VERSION };
+
+
+
+
+static int     cw_trace_get_varint_internal(FILE * file, uint64_t * value);
+static int64_t cw_trace_timestamp_diff_internal(const struct timeval * earlier, const struct timeval * later);
+static void    cw_trace_timestamp_add_internal(struct timeval * timestamp, int64_t usecs);
+static int     cw_trace_recorder_write_internal(cw_trace_recorder_t * recorder, const uint8_t * bytes, size_t n_bytes);
+static int     cw_trace_recorder_write_header_internal(cw_trace_recorder_t * recorder, const cw_trace_header_t * header);
+static int     cw_trace_reader_read_header_internal(cw_trace_reader_t * reader);
+static void    cw_trace_replay_poll_internal(cw_rec_t * rec, const struct timeval * timestamp, cw_trace_character_callback_t callback_func, void * callback_arg);
+static void    cw_trace_replay_apply_header_internal(cw_rec_t * rec, const cw_trace_header_t * header);
+
+
+
+
+/* ******************************************************************** */
+/*                          Section:Recorder                            */
+/* ******************************************************************** */
+
+
+
+
+/**
+   \brief Create new recorder of key events
+
+   Recorder writes header of first session (described by \p header)
+   to \p file, and then appends events passed to
+   cw_trace_recorder_add_event() or to
+   cw_trace_recorder_keying_callback().
+
+   Open \p file in append mode ("ab") to add sessions to existing
+   trace. The file is owned by caller: recorder doesn't close it.
+
+   If timestamp of beginning of session in \p header is zero, current
+   time is used.
+
+   \errno EINVAL - \p file or \p header is NULL
+   \errno ENOMEM - failed to allocate memory
+   \errno EIO - failed to write header
+
+   \param file - file to which the trace is written
+   \param header - parameters of first session
+
+   \return pointer to new recorder on success
+   \return NULL on failure
+*/
+cw_trace_recorder_t * cw_trace_recorder_new(FILE * file, const cw_trace_header_t * header)
+{
+	if (!file || !header) {
+		errno = EINVAL;
+		return (cw_trace_recorder_t *) NULL;
+	}
+
+	cw_trace_recorder_t * recorder = (cw_trace_recorder_t *) malloc(sizeof (cw_trace_recorder_t));
+	if (!recorder) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR, MSG_PREFIX "malloc()");
+		errno = ENOMEM;
+		return (cw_trace_recorder_t *) NULL;
+	}
+
+	recorder->file = file;
+	recorder->n_events = 0;
+	recorder->write_failed = false;
+	pthread_mutex_init(&recorder->mutex, NULL);
+
+	if (CW_SUCCESS != cw_trace_recorder_start_session(recorder, header)) {
+		pthread_mutex_destroy(&recorder->mutex);
+		free(recorder);
+		errno = EIO;
+		return (cw_trace_recorder_t *) NULL;
+	}
+
+	return recorder;
+}
+
+
+
+
+/**
+   \brief Delete recorder
+
+   Data buffered in recorder's file is flushed. The file itself is
+   not closed. Pointer to \p recorder is set to NULL.
+
+   Unregister the recorder from key (if it has been registered as
+   keying callback) before deleting it.
+
+   \param recorder - pointer to recorder
+*/
+void cw_trace_recorder_delete(cw_trace_recorder_t ** recorder)
+{
+	cw_assert (recorder, MSG_PREFIX "recorder delete: pointer to recorder is NULL");
+
+	if (!*recorder) {
+		return;
+	}
+
+	fflush((*recorder)->file);
+	pthread_mutex_destroy(&(*recorder)->mutex);
+
+	free(*recorder);
+	*recorder = (cw_trace_recorder_t *) NULL;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Start new session in trace
+
+   Write header of new session, with parameters from \p header.
+   Timestamps of following events are stored relative to beginning
+   of the session.
+
+   If timestamp of beginning of session in \p header is zero, current
+   time is used.
+
+   \errno EINVAL - \p header is NULL
+   \errno EIO - failed to write header
+
+   \param recorder - recorder
+   \param header - parameters of new session
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_trace_recorder_start_session(cw_trace_recorder_t * recorder, const cw_trace_header_t * header)
+{
+	if (!header) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	cw_trace_header_t h = *header;
+	if (h.start.tv_sec == 0 && h.start.tv_usec == 0) {
+		gettimeofday(&h.start, NULL);
+	}
+
+	pthread_mutex_lock(&recorder->mutex);
+	const int rv = cw_trace_recorder_write_header_internal(recorder, &h);
+	if (CW_SUCCESS == rv) {
+		recorder->prev = h.start;
+	}
+	pthread_mutex_unlock(&recorder->mutex);
+
+	if (CW_SUCCESS != rv) {
+		errno = EIO;
+	}
+	return rv;
+}
+
+
+
+
+/**
+   \brief Append a key event to trace
+
+   Events should be added in chronological order. Timestamp earlier
+   than timestamp of previous event is recorded as equal to that
+   timestamp.
+
+   \p timestamp may be NULL, then current time is used.
+
+   \errno EIO - failed to write event
+
+   \param recorder - recorder
+   \param timestamp - time of change of key's state
+   \param key_state - new state of key (CW_KEY_STATE_OPEN or CW_KEY_STATE_CLOSED)
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_trace_recorder_add_event(cw_trace_recorder_t * recorder, const struct timeval * timestamp, int key_state)
+{
+	struct timeval t;
+	if (timestamp && (timestamp->tv_sec || timestamp->tv_usec)) {
+		t = *timestamp;
+	} else {
+		gettimeofday(&t, NULL);
+	}
+
+	pthread_mutex_lock(&recorder->mutex);
+
+	int64_t delta = cw_trace_timestamp_diff_internal(&recorder->prev, &t);
+	if (delta < 0) {
+		delta = 0;
+		t = recorder->prev;
+	}
+
+	uint8_t bytes[CW_TRACE_VARINT_SIZE_MAX];
+	const uint64_t value = ((((uint64_t) delta) << 1) | (key_state == CW_KEY_STATE_CLOSED ? 1 : 0)) + 1;
+	const size_t n = cw_codec_put_varint_internal(bytes, value);
+	const int rv = cw_trace_recorder_write_internal(recorder, bytes, n);
+	if (CW_SUCCESS == rv) {
+		recorder->prev = t;
+		recorder->n_events++;
+	}
+
+	pthread_mutex_unlock(&recorder->mutex);
+
+	if (CW_SUCCESS != rv) {
+		errno = EIO;
+	}
+	return rv;
+}
+
+
+
+
+/**
+   \brief Flush recorded data to file
+
+   \errno EIO - writing to file has failed (now or in one of previous calls)
+
+   \param recorder - recorder
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_trace_recorder_flush(cw_trace_recorder_t * recorder)
+{
+	pthread_mutex_lock(&recorder->mutex);
+	if (0 != fflush(recorder->file)) {
+		recorder->write_failed = true;
+	}
+	const bool failed = recorder->write_failed;
+	pthread_mutex_unlock(&recorder->mutex);
+
+	if (failed) {
+		errno = EIO;
+		return CW_FAILURE;
+	}
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Keying callback recording key events
+
+   Register this function as keying callback of a key, with recorder
+   as callback's argument:
+   cw_key_register_keying_callback(key, cw_trace_recorder_keying_callback, recorder);
+
+   \param timestamp - time of change of key's state
+   \param key_state - new state of key
+   \param callback_arg - recorder (cw_trace_recorder_t *)
+*/
+void cw_trace_recorder_keying_callback(volatile struct timeval * timestamp, int key_state, void * callback_arg)
+{
+	cw_trace_recorder_t * recorder = (cw_trace_recorder_t *) callback_arg;
+
+	struct timeval t = { 0, 0 };
+	if (timestamp) {
+		t.tv_sec = timestamp->tv_sec;
+		t.tv_usec = timestamp->tv_usec;
+	}
+
+	if (CW_SUCCESS != cw_trace_recorder_add_event(recorder, &t, key_state)) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_KEYING, CW_DEBUG_ERROR,
+			      MSG_PREFIX "keying callback: failed to record event");
+	}
+
+	return;
+}
+
+
+
+
+int cw_trace_recorder_write_header_internal(cw_trace_recorder_t * recorder, const cw_trace_header_t * header)
+{
+	uint8_t bytes[CW_TRACE_HEADER_SIZE_MAX];
+	size_t n = 0;
+
+	memcpy(bytes, cw_trace_magic, sizeof (cw_trace_magic));
+	n += sizeof (cw_trace_magic);
+	n += cw_codec_put_varint_internal(bytes + n, (uint64_t) header->speed);
+	n += cw_codec_put_varint_internal(bytes + n, (uint64_t) header->tolerance);
+	n += cw_codec_put_varint_internal(bytes + n, (uint64_t) header->gap);
+	n += cw_codec_put_varint_internal(bytes + n, (uint64_t) header->weighting);
+	n += cw_codec_put_varint_internal(bytes + n, (uint64_t) header->frequency);
+	n += cw_codec_put_varint_internal(bytes + n, header->is_adaptive ? 1 : 0);
+	n += cw_codec_put_varint_internal(bytes + n, (uint64_t) header->start.tv_sec);
+	n += cw_codec_put_varint_internal(bytes + n, (uint64_t) header->start.tv_usec);
+
+	return cw_trace_recorder_write_internal(recorder, bytes, n);
+}
+
+
+
+
+int cw_trace_recorder_write_internal(cw_trace_recorder_t * recorder, const uint8_t * bytes, size_t n_bytes)
+{
+	if (recorder->write_failed) {
+		return CW_FAILURE;
+	}
+
+	if (n_bytes != fwrite(bytes, 1, n_bytes, recorder->file)) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+			      MSG_PREFIX "fwrite(): %s", strerror(errno));
+		recorder->write_failed = true;
+		return CW_FAILURE;
+	}
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/* ******************************************************************** */
+/*                           Section:Reader                             */
+/* ******************************************************************** */
+
+
+
+
+/**
+   \brief Create new reader of trace
+
+   Position of \p file should be at beginning of a session header
+   (e.g. at beginning of file). The file is owned by caller: reader
+   doesn't close it.
+
+   \errno EINVAL - \p file is NULL
+   \errno ENOMEM - failed to allocate memory
+
+   \param file - file with trace
+
+   \return pointer to new reader on success
+   \return NULL on failure
+*/
+cw_trace_reader_t * cw_trace_reader_new(FILE * file)
+{
+	if (!file) {
+		errno = EINVAL;
+		return (cw_trace_reader_t *) NULL;
+	}
+
+	cw_trace_reader_t * reader = (cw_trace_reader_t *) calloc(1, sizeof (cw_trace_reader_t));
+	if (!reader) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR, MSG_PREFIX "calloc()");
+		errno = ENOMEM;
+		return (cw_trace_reader_t *) NULL;
+	}
+
+	reader->file = file;
+	reader->n_sessions = 0;
+
+	return reader;
+}
+
+
+
+
+/**
+   \brief Delete reader
+
+   Pointer to \p reader is set to NULL. Reader's file is not closed.
+
+   \param reader - pointer to reader
+*/
+void cw_trace_reader_delete(cw_trace_reader_t ** reader)
+{
+	cw_assert (reader, MSG_PREFIX "reader delete: pointer to reader is NULL");
+
+	if (!*reader) {
+		return;
+	}
+
+	free(*reader);
+	*reader = (cw_trace_reader_t *) NULL;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Read next event from trace
+
+   Headers of sessions are consumed by the function. Parameters of
+   session of the returned event can be obtained with
+   cw_trace_reader_get_header(). Field "session" of \p event is
+   incremented when a new session starts.
+
+   \errno ENOENT - there are no more events in trace
+   \errno EINVAL - trace is malformed
+
+   \param reader - reader
+   \param event - read event
+
+   \return CW_SUCCESS when an event has been read
+   \return CW_FAILURE at end of trace or on errors
+*/
+int cw_trace_reader_next(cw_trace_reader_t * reader, cw_trace_event_t * event)
+{
+	while (true) {
+		const int c = getc(reader->file);
+		if (EOF == c) {
+			errno = ENOENT;
+			return CW_FAILURE;
+		}
+
+		if (c == cw_trace_magic[0]) {
+			if (CW_SUCCESS != cw_trace_reader_read_header_internal(reader)) {
+				errno = EINVAL;
+				return CW_FAILURE;
+			}
+			continue;
+		}
+
+		if (0 == reader->n_sessions) {
+			/* Event without session header. */
+			cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+				      MSG_PREFIX "reader: trace doesn't start with header");
+			errno = EINVAL;
+			return CW_FAILURE;
+		}
+
+		ungetc(c, reader->file);
+		uint64_t value = 0;
+		if (CW_SUCCESS != cw_trace_get_varint_internal(reader->file, &value)) {
+			errno = EINVAL;
+			return CW_FAILURE;
+		}
+		if (0 == value) {
+			/* Recorder never writes zero (see "+1" in format
+			   of event), but first byte of an overlong
+			   encoding of zero is non-zero. */
+			cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+				      MSG_PREFIX "reader: invalid event");
+			errno = EINVAL;
+			return CW_FAILURE;
+		}
+		value--;
+
+		cw_trace_timestamp_add_internal(&reader->prev, (int64_t) (value >> 1));
+
+		event->timestamp = reader->prev;
+		event->key_state = (value & 1) ? CW_KEY_STATE_CLOSED : CW_KEY_STATE_OPEN;
+		event->session = reader->n_sessions;
+
+		return CW_SUCCESS;
+	}
+}
+
+
+
+
+/**
+   \brief Get parameters of current session of trace
+
+   \errno ENOENT - no session header has been read yet
+
+   \param reader - reader
+   \param header - parameters of session of last event returned by cw_trace_reader_next()
+
+   \return CW_SUCCESS on success
+   \return CW_FAILURE on failure
+*/
+int cw_trace_reader_get_header(const cw_trace_reader_t * reader, cw_trace_header_t * header)
+{
+	if (0 == reader->n_sessions) {
+		errno = ENOENT;
+		return CW_FAILURE;
+	}
+
+	*header = reader->header;
+	return CW_SUCCESS;
+}
+
+
+
+
+/* First byte of header has been already consumed by caller. */
+int cw_trace_reader_read_header_internal(cw_trace_reader_t * reader)
+{
+	for (size_t i = 1; i < sizeof (cw_trace_magic); i++) {
+		if (getc(reader->file) != cw_trace_magic[i]) {
+			cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR,
+				      MSG_PREFIX "reader: invalid header of session");
+			return CW_FAILURE;
+		}
+	}
+
+	uint64_t values[8];
+	for (int i = 0; i < 8; i++) {
+		if (CW_SUCCESS != cw_trace_get_varint_internal(reader->file, &values[i])) {
+			return CW_FAILURE;
+		}
+	}
+	if (values[7] >= CW_USECS_PER_SEC) {
+		return CW_FAILURE;
+	}
+
+	reader->header.speed = (int) values[0];
+	reader->header.tolerance = (int) values[1];
+	reader->header.gap = (int) values[2];
+	reader->header.weighting = (int) values[3];
+	reader->header.frequency = (int) values[4];
+	reader->header.is_adaptive = values[5] != 0;
+	reader->header.start.tv_sec = (time_t) values[6];
+	reader->header.start.tv_usec = (suseconds_t) values[7];
+
+	reader->prev = reader->header.start;
+	reader->n_sessions++;
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/* ******************************************************************** */
+/*                          Section:Replayer                            */
+/* ******************************************************************** */
+
+
+
+
+/**
+   \brief Replay a trace
+
+   Events read by \p reader are passed to receiver \p rec and/or to
+   straight key \p key.
+
+   Receiver is given original timestamps of events, so it decodes
+   the trace in the same way regardless of \p speedup. Parameters of
+   receiver are set to parameters recorded in headers of sessions.
+   Characters decoded by receiver are passed to \p callback_func.
+
+   Key (which should have a generator, see
+   cw_key_register_generator()) is notified about events in
+   wall-clock time: \p speedup of 1.0 replays the trace at its original speed,
+   2.0 replays it two times faster. With \p speedup equal to zero
+   events are replayed as fast as possible (which is useful only
+   when \p key is NULL). Pacing applies to receiver too, so that
+   characters are passed to \p callback_func as they are "heard".
+
+   \errno EINVAL - invalid arguments, or trace is malformed
+
+   \param reader - reader of trace
+   \param rec - receiver decoding the trace (may be NULL)
+   \param key - key notified about events (may be NULL)
+   \param speedup - how many times faster than original the trace should be replayed; zero for no pacing
+   \param callback_func - function receiving characters decoded by \p rec (may be NULL)
+   \param callback_arg - argument for \p callback_func
+
+   \return CW_SUCCESS when whole trace has been replayed
+   \return CW_FAILURE on failure
+*/
+int cw_trace_replay(cw_trace_reader_t * reader, cw_rec_t * rec, volatile cw_key_t * key, double speedup, cw_trace_character_callback_t callback_func, void * callback_arg)
+{
+	if (!reader || speedup < 0.0) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	int session = 0;
+	struct timeval last = { 0, 0 };
+	struct timeval trace_start = { 0, 0 };
+	struct timeval wall_start = { 0, 0 };
+
+	cw_trace_event_t event;
+	while (CW_SUCCESS == cw_trace_reader_next(reader, &event)) {
+
+		if (event.session != session) {
+			if (rec) {
+				if (session) {
+					/* Get last character of previous session. */
+					cw_trace_timestamp_add_internal(&last, CW_TRACE_FINAL_SPACE_LEN);
+					cw_trace_replay_poll_internal(rec, &last, callback_func, callback_arg);
+				}
+				cw_trace_replay_apply_header_internal(rec, &reader->header);
+			}
+			if (!session) {
+				trace_start = event.timestamp;
+				gettimeofday(&wall_start, NULL);
+			}
+			session = event.session;
+		}
+
+		if (speedup > 0.0) {
+			/* Sleep until wall-clock time of the event. */
+			const int64_t trace_elapsed = cw_trace_timestamp_diff_internal(&trace_start, &event.timestamp);
+			struct timeval now;
+			gettimeofday(&now, NULL);
+			const int64_t wall_elapsed = cw_trace_timestamp_diff_internal(&wall_start, &now);
+			const int64_t wait = (int64_t) (trace_elapsed / speedup) - wall_elapsed;
+			if (wait > 0) {
+				struct timespec n;
+				n.tv_sec = wait / CW_USECS_PER_SEC;
+				n.tv_nsec = (wait % CW_USECS_PER_SEC) * 1000;
+				cw_nanosleep_internal(&n);
+			}
+		}
+
+		if (key) {
+			cw_key_sk_notify_event(key, event.key_state);
+		}
+
+		if (rec) {
+			int rv;
+			if (event.key_state == CW_KEY_STATE_CLOSED) {
+				/* Beginning of mark may end a character
+				   (or a word) that is in receiver. */
+				cw_trace_replay_poll_internal(rec, &event.timestamp, callback_func, callback_arg);
+				rv = cw_rec_mark_begin(rec, &event.timestamp);
+			} else {
+				rv = cw_rec_mark_end(rec, &event.timestamp);
+			}
+			if (CW_SUCCESS != rv) {
+				cw_debug_msg (&cw_debug_object, CW_DEBUG_RECEIVE_STATES, CW_DEBUG_WARNING,
+					      MSG_PREFIX "replay: receiver rejected event %d @ %ld.%06ld: %s",
+					      event.key_state, (long) event.timestamp.tv_sec, (long) event.timestamp.tv_usec, strerror(errno));
+				if (ENOMEM == errno) {
+					/* Representation is too long to be a character. */
+					cw_rec_reset_state(rec);
+				}
+			}
+		}
+
+		last = event.timestamp;
+	}
+
+	if (ENOENT != errno) {
+		errno = EINVAL;
+		return CW_FAILURE;
+	}
+
+	if (rec && session) {
+		cw_trace_timestamp_add_internal(&last, CW_TRACE_FINAL_SPACE_LEN);
+		cw_trace_replay_poll_internal(rec, &last, callback_func, callback_arg);
+	}
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   \brief Get complete character from receiver, if there is one
+
+   On success receiver is reset, so that it is ready for next
+   character.
+*/
+void cw_trace_replay_poll_internal(cw_rec_t * rec, const struct timeval * timestamp, cw_trace_character_callback_t callback_func, void * callback_arg)
+{
+	char c = '\0';
+	bool is_end_of_word = false;
+	bool is_error = false;
+
+	if (CW_SUCCESS == cw_rec_poll_character(rec, timestamp, &c, &is_end_of_word, &is_error)) {
+		if (callback_func) {
+			(*callback_func)(callback_arg, timestamp, c, is_end_of_word, is_error);
+		}
+		cw_rec_reset_state(rec);
+
+	} else if (ENOENT == errno) {
+		/* Complete representation that isn't a valid character. */
+		if (callback_func) {
+			(*callback_func)(callback_arg, timestamp, CW_TRACE_UNKNOWN_CHARACTER, false, true);
+		}
+		cw_rec_reset_state(rec);
+
+	} else {
+		/* EAGAIN: space is too short to end a character;
+		   ERANGE: receiver is idle. */
+		;
+	}
+
+	return;
+}
+
+
+
+
+void cw_trace_replay_apply_header_internal(cw_rec_t * rec, const cw_trace_header_t * header)
+{
+	cw_rec_reset_state(rec);
+
+	/* Speed can't be set in adaptive mode. */
+	cw_rec_disable_adaptive_mode(rec);
+	if (header->speed) {
+		cw_rec_set_speed(rec, header->speed);
+	}
+	if (header->tolerance) {
+		cw_rec_set_tolerance(rec, header->tolerance);
+	}
+	cw_rec_set_gap(rec, header->gap);
+	if (header->is_adaptive) {
+		/* Initial adaptive threshold is derived from speed
+		   only during sync in fixed speed mode. */
+		cw_rec_sync_parameters_internal(rec);
+		cw_rec_enable_adaptive_mode(rec);
+	}
+
+	return;
+}
+
+
+
+
+/* ******************************************************************** */
+/*                           Section:Helpers                            */
+/* ******************************************************************** */
+
+
+
+
+/**
+   \brief Read value encoded as unsigned LEB128 from file
+
+   Bytes of the value are collected from file and decoded with
+   cw_codec_get_varint_internal().
+
+   \return CW_SUCCESS if complete value has been read
+   \return CW_FAILURE if file ends in the middle of the value, or value is too long
+*/
+int cw_trace_get_varint_internal(FILE * file, uint64_t * value)
+{
+	uint8_t bytes[CW_TRACE_VARINT_SIZE_MAX];
+	size_t n = 0;
+	int c = 0;
+	do {
+		c = getc(file);
+		if (EOF == c) {
+			return CW_FAILURE;
+		}
+		bytes[n++] = (uint8_t) c;
+	} while ((c & 0x80) && n < sizeof (bytes));
+
+	size_t i = 0;
+	if (!cw_codec_get_varint_internal(bytes, n, &i, value)) {
+		return CW_FAILURE;
+	}
+
+	return CW_SUCCESS;
+}
+
+
+
+
+int64_t cw_trace_timestamp_diff_internal(const struct timeval * earlier, const struct timeval * later)
+{
+	return ((int64_t) later->tv_sec - (int64_t) earlier->tv_sec) * CW_USECS_PER_SEC
+		+ ((int64_t) later->tv_usec - (int64_t) earlier->tv_usec);
+}
+
+
+
+
+void cw_trace_timestamp_add_internal(struct timeval * timestamp, int64_t usecs)
+{
+	const int64_t total = (int64_t) timestamp->tv_usec + usecs;
+	timestamp->tv_sec += total / CW_USECS_PER_SEC;
+	timestamp->tv_usec = total % CW_USECS_PER_SEC;
+
+	return;
+}
@@ -0,0 +1,116 @@
+/*
+  This file is a part of unixcw project.
+  unixcw project is covered by GNU General Public License, version 2 or later.
+*/
+
+#ifndef H_LIBCW_TRACE
+#define H_LIBCW_TRACE
+
+
+
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+
+
+
+#include "libcw_key.h"
+#include "libcw_rec.h"
+
+
+
+
+/* Version of format of trace, written in header of every session. */
+#define CW_TRACE_VERSION               1
+
+/* Character reported by replayer for a representation that can't be
+   looked up. */
+#define CW_TRACE_UNKNOWN_CHARACTER   '?'
+
+
+
+
+/* Parameters of session, as recorded in its header. */
+typedef struct {
+	int speed;          /* [wpm] */
+	int tolerance;
+	int gap;
+	int weighting;
+	int frequency;      /* [Hz] */
+	bool is_adaptive;   /* Adaptive speed tracking of receiver. */
+
+	/* Time of beginning of session. Timestamps of events are
+	   stored as increments over this value. */
+	struct timeval start;
+} cw_trace_header_t;
+
+
+
+
+/* One change of key's state. */
+typedef struct {
+	struct timeval timestamp;
+	int key_state;      /* CW_KEY_STATE_OPEN or CW_KEY_STATE_CLOSED. */
+
+	/* Count of session headers read so far, including header of
+	   session to which the event belongs. */
+	int session;
+} cw_trace_event_t;
+
+
+
+
+/* Function receiving characters decoded by replayer.
+
+   \p is_error is true when received representation can't be looked
+   up; \p c is then CW_TRACE_UNKNOWN_CHARACTER. */
+typedef void (* cw_trace_character_callback_t)(void * callback_arg, const struct timeval * timestamp, char c, bool is_end_of_word, bool is_error);
+
+
+
+
+struct cw_trace_recorder_struct {
+	FILE * file;
+
+	/* Timestamp of last recorded event (or of beginning of
+	   session). */
+	struct timeval prev;
+
+	/* Count of events recorded since creation of recorder. */
+	uint64_t n_events;
+
+	/* fwrite() has failed. */
+	bool write_failed;
+
+	/* Events are recorded from key's thread (e.g. generator's
+	   thread for iambic keyer), sessions may be started from
+	   client's thread. */
+	pthread_mutex_t mutex;
+};
+
+typedef struct cw_trace_recorder_struct cw_trace_recorder_t;
+
+
+
+
+struct cw_trace_reader_struct {
+	FILE * file;
+
+	/* Header of current session. */
+	cw_trace_header_t header;
+	int n_sessions;
+
+	/* Timestamp of last read event (or of beginning of session). */
+	struct timeval prev;
+};
+
+typedef struct cw_trace_reader_struct cw_trace_reader_t;
+
+
+
+
+#endif /* #ifndef H_LIBCW_TRACE */
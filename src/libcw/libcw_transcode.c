@@ -0,0 +1,613 @@
+/*
+  Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+  Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation; either version 2
+  of the License, or (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along
+  with this program; if not, write to the Free Software Foundation, Inc.,
+  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+/**
+   \file libcw_transcode.c
+
+   \brief Bulk conversion of text to Dots and Dashes, and back.
+
+   cw_character_to_representation() and
+   cw_representation_to_character() convert single characters, and
+   the former allocates every representation it returns. Transcoder
+   converts whole buffers of text: "PARIS IS" is encoded as
+   ".--. .- .-. .. ... / .. ...", and such text is decoded back to
+   "PARIS IS".
+
+   All lookups are done in tables of 256 entries built when the
+   transcoder is created, so processing of a byte of input is a
+   table lookup and (in encoder) a copy of fixed-size slot. The
+   tables are built from table of characters that is current at
+   that moment (see cw_load_character_table()); a table loaded later
+   is used by transcoders created later.
+   Input may be split into chunks at arbitrary positions: state
+   of transcoding is carried from one chunk to next one.
+
+   Newlines are preserved in both directions, so line structure of
+   the text survives a round trip. Other white space in text is
+   collapsed into one word separator.
+*/
+
+
+
+
+#include "config.h"
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <errno.h>
+
+
+#include "libcw_transcode.h"
+#include "libcw_data.h"
+#include "libcw_debug.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+#define MSG_PREFIX "libcw/transcode: "
+
+
+
+
+/* From libcw_debug.c. */
+extern cw_debug_t cw_debug_object;
+extern cw_debug_t cw_debug_object_dev;
+
+
+
+
+static bool   cw_transcoder_set_separators_internal(cw_transcoder_t * tr, const char * char_separator, const char * word_separator);
+static void   cw_transcoder_build_tables_internal(cw_transcoder_t * tr);
+static size_t cw_transcoder_encode_internal(cw_transcoder_t * tr, const unsigned char * input, size_t size, char * output);
+static size_t cw_transcoder_decode_internal(cw_transcoder_t * tr, const unsigned char * input, size_t size, char * output);
+static char * cw_transcoder_decode_character_internal(cw_transcoder_t * tr, char * output);
+static void   cw_transcoder_reset_internal(cw_transcoder_t * tr);
+
+
+
+
+/**
+   \brief Create new transcoder
+
+   \p char_separator is put between representations of characters,
+   and \p word_separator is put between words. Pass NULL to use
+   default separator (CW_TRANSCODE_CHAR_SEPARATOR_DEFAULT and
+   CW_TRANSCODE_WORD_SEPARATOR_DEFAULT respectively).
+
+   Separators can't contain Dot, Dash or newline, and they must be
+   different. Decoder must be able to tell word separator from
+   character separator: word separator must either contain a byte
+   that isn't in character separator, or be a longer run of bytes of
+   character separator.
+
+   \errno EINVAL - invalid direction or separators
+   \errno ENOMEM - failed to allocate memory
+
+   \param direction - CW_TRANSCODE_ENCODE or CW_TRANSCODE_DECODE
+   \param char_separator - separator of characters, or NULL
+   \param word_separator - separator of words, or NULL
+
+   \return pointer to new transcoder on success
+   \return NULL on failure
+*/
+cw_transcoder_t * cw_transcoder_new(int direction, const char * char_separator, const char * word_separator)
+{
+	if (direction != CW_TRANSCODE_ENCODE && direction != CW_TRANSCODE_DECODE) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_PARAMETERS, CW_DEBUG_ERROR,
+			      MSG_PREFIX "new: invalid direction %d", direction);
+		errno = EINVAL;
+		return (cw_transcoder_t *) NULL;
+	}
+
+	cw_transcoder_t * tr = (cw_transcoder_t *) calloc(1, sizeof (cw_transcoder_t));
+	if (!tr) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_STDLIB, CW_DEBUG_ERROR, MSG_PREFIX "calloc()");
+		errno = ENOMEM;
+		return (cw_transcoder_t *) NULL;
+	}
+
+	tr->direction = direction;
+	if (!cw_transcoder_set_separators_internal(tr,
+						   char_separator ? char_separator : CW_TRANSCODE_CHAR_SEPARATOR_DEFAULT,
+						   word_separator ? word_separator : CW_TRANSCODE_WORD_SEPARATOR_DEFAULT)) {
+		free(tr);
+		errno = EINVAL;
+		return (cw_transcoder_t *) NULL;
+	}
+
+	cw_transcoder_build_tables_internal(tr);
+	cw_transcoder_reset_internal(tr);
+
+	return tr;
+}
+
+
+
+
+/**
+   \brief Delete transcoder
+
+   Pointer to \p tr is set to NULL.
+
+   \param tr - pointer to transcoder
+*/
+void cw_transcoder_delete(cw_transcoder_t ** tr)
+{
+	cw_assert (tr, MSG_PREFIX "delete: pointer to transcoder is NULL");
+
+	if (!*tr) {
+		return;
+	}
+
+	free(*tr);
+	*tr = (cw_transcoder_t *) NULL;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Get size of output buffer sufficient for given input
+
+   Output buffer passed to cw_transcoder_process() must have at least
+   this size for input of \p size bytes. Output buffer passed to
+   cw_transcoder_finish() must have at least the size returned for
+   \p size equal to zero.
+
+   \param tr - transcoder
+   \param size - size of input
+
+   \return size of output buffer
+*/
+size_t cw_transcoder_get_max_output(const cw_transcoder_t * tr, size_t size)
+{
+	if (tr->direction == CW_TRANSCODE_ENCODE) {
+		/* Every byte of input may be a character preceded by
+		   a separator. Encoder copies whole slots, so last
+		   slot may be written past end of representation. */
+		size_t separator_len = tr->word_separator_len > tr->char_separator_len
+			? tr->word_separator_len
+			: tr->char_separator_len;
+		return size * (separator_len + CW_DATA_MAX_REPRESENTATION_LENGTH) + CW_TRANSCODE_SLOT_SIZE;
+	} else {
+		/* Every byte of input may end a character preceded by
+		   a space. */
+		return 2 * size + 2;
+	}
+}
+
+
+
+
+/**
+   \brief Transcode a chunk of input
+
+   Input may end in the middle of a representation or separator;
+   transcoding continues with next chunk. Call
+   cw_transcoder_finish() after last chunk.
+
+   Characters without representation (when encoding) and unknown
+   representations (when decoding) are skipped and counted as
+   errors.
+
+   \param tr - transcoder
+   \param input - chunk of input
+   \param size - size of the chunk
+   \param output - output buffer, see cw_transcoder_get_max_output()
+
+   \return count of bytes written to \p output
+*/
+size_t cw_transcoder_process(cw_transcoder_t * tr, const char * input, size_t size, char * output)
+{
+	if (tr->direction == CW_TRANSCODE_ENCODE) {
+		return cw_transcoder_encode_internal(tr, (const unsigned char *) input, size, output);
+	} else {
+		return cw_transcoder_decode_internal(tr, (const unsigned char *) input, size, output);
+	}
+}
+
+
+
+
+/**
+   \brief End transcoding of a stream
+
+   Write out a character whose representation ended at end of last
+   chunk, and reset state of transcoder, so that it can be used for
+   next stream. Counters are not reset.
+
+   \param tr - transcoder
+   \param output - output buffer, see cw_transcoder_get_max_output()
+
+   \return count of bytes written to \p output
+*/
+size_t cw_transcoder_finish(cw_transcoder_t * tr, char * output)
+{
+	char * out = output;
+	if (tr->direction == CW_TRANSCODE_DECODE) {
+		out = cw_transcoder_decode_character_internal(tr, out);
+	}
+
+	/* Trailing white space of text isn't encoded. */
+	cw_transcoder_reset_internal(tr);
+
+	return (size_t) (out - output);
+}
+
+
+
+
+/**
+   \brief Get counters of transcoder
+
+   \param tr - transcoder
+   \param n_characters - count of transcoded characters (may be NULL)
+   \param n_errors - count of characters without representation, or of unknown representations (may be NULL)
+*/
+void cw_transcoder_get_counts(const cw_transcoder_t * tr, int64_t * n_characters, int64_t * n_errors)
+{
+	if (n_characters) {
+		*n_characters = tr->n_characters;
+	}
+	if (n_errors) {
+		*n_errors = tr->n_errors;
+	}
+
+	return;
+}
+
+
+
+
+/**
+   \brief Validate and store separators of transcoder
+
+   \param tr - transcoder
+   \param char_separator - separator of characters
+   \param word_separator - separator of words
+
+   \return true if separators are valid
+   \return false otherwise
+*/
+bool cw_transcoder_set_separators_internal(cw_transcoder_t * tr, const char * char_separator, const char * word_separator)
+{
+	size_t char_len = strlen(char_separator);
+	size_t word_len = strlen(word_separator);
+	if (char_len < 1 || char_len > CW_TRANSCODE_SEPARATOR_LEN_MAX
+	    || word_len < 1 || word_len > CW_TRANSCODE_SEPARATOR_LEN_MAX) {
+
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_PARAMETERS, CW_DEBUG_ERROR,
+			      MSG_PREFIX "invalid length of separator");
+		return false;
+	}
+
+	if (strpbrk(char_separator, ".-\n") || strpbrk(word_separator, ".-\n")) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_PARAMETERS, CW_DEBUG_ERROR,
+			      MSG_PREFIX "separator contains Dot, Dash or newline");
+		return false;
+	}
+
+	/* Word separator made only of bytes of character separator
+	   is recognized by length of run of such bytes. */
+	bool is_run = strspn(word_separator, char_separator) == word_len;
+	if (is_run && word_len <= char_len) {
+		cw_debug_msg (&cw_debug_object, CW_DEBUG_PARAMETERS, CW_DEBUG_ERROR,
+			      MSG_PREFIX "word separator can't be told from character separator");
+		return false;
+	}
+
+	memcpy(tr->char_separator, char_separator, char_len + 1);
+	memcpy(tr->word_separator, word_separator, word_len + 1);
+	tr->char_separator_len = char_len;
+	tr->word_separator_len = word_len;
+	tr->word_separator_is_run = is_run;
+
+	return true;
+}
+
+
+
+
+/**
+   \brief Build lookup tables of transcoder
+
+   \param tr - transcoder
+*/
+void cw_transcoder_build_tables_internal(cw_transcoder_t * tr)
+{
+	/* All lookups are done in one table of characters, even if
+	   the table is swapped in the meantime. */
+	const cw_character_table_t * table = cw_character_table_internal();
+
+	/* Lookup table in libcw_data.c has UCHAR_MAX entries, so
+	   don't look up last byte value; there is no character for
+	   it anyway. */
+	for (int c = 1; c < UCHAR_MAX; c++) {
+		const char * representation = cw_character_table_to_representation_internal(table, c);
+		if (!representation) {
+			continue;
+		}
+		size_t len = strlen(representation);
+		memcpy(tr->encode_slots[c], representation, len);
+		tr->encode_lens[c] = (uint8_t) len;
+
+		uint8_t hash = cw_representation_to_hash_internal(representation);
+		if (hash && !tr->decode_characters[hash]) {
+			tr->decode_characters[hash] = (char) cw_character_table_to_character_internal(table, representation);
+		}
+	}
+
+	for (int c = 0; c <= UCHAR_MAX; c++) {
+		if (isspace(c)) {
+			tr->classes[c] = CW_TRANSCODE_CLASS_SPACE;
+		}
+	}
+
+	if (tr->direction == CW_TRANSCODE_DECODE) {
+		tr->classes[(unsigned char) CW_DOT_REPRESENTATION] = CW_TRANSCODE_CLASS_DOT;
+		tr->classes[(unsigned char) CW_DASH_REPRESENTATION] = CW_TRANSCODE_CLASS_DASH;
+		for (size_t i = 0; i < tr->word_separator_len; i++) {
+			tr->classes[(unsigned char) tr->word_separator[i]] = CW_TRANSCODE_CLASS_WORD;
+		}
+		for (size_t i = 0; i < tr->char_separator_len; i++) {
+			tr->classes[(unsigned char) tr->char_separator[i]] = CW_TRANSCODE_CLASS_SPACE;
+		}
+	}
+
+	tr->classes['\n'] = CW_TRANSCODE_CLASS_NEWLINE;
+
+	return;
+}
+
+
+
+
+/**
+   \brief Encode a chunk of text
+
+   \param tr - transcoder
+   \param input - chunk of text
+   \param size - size of the chunk
+   \param output - output buffer
+
+   \return count of bytes written to \p output
+*/
+size_t cw_transcoder_encode_internal(cw_transcoder_t * tr, const unsigned char * input, size_t size, char * output)
+{
+	/* State is kept in local variables: stores through output
+	   pointer could otherwise alias fields of transcoder, and
+	   force compiler to reload them for every byte. */
+	bool has_character = tr->has_character;
+	bool is_word_pending = tr->is_word_pending;
+	int64_t n_characters = 0;
+	int64_t n_errors = 0;
+
+	char * out = output;
+	const unsigned char * end = input + size;
+
+	for (const unsigned char * in = input; in < end; in++) {
+		const unsigned char c = *in;
+		const size_t len = tr->encode_lens[c];
+
+		if (len) {
+			if (has_character) {
+				if (is_word_pending) {
+					memcpy(out, tr->word_separator, tr->word_separator_len);
+					out += tr->word_separator_len;
+				} else {
+					memcpy(out, tr->char_separator, tr->char_separator_len);
+					out += tr->char_separator_len;
+				}
+			}
+			memcpy(out, tr->encode_slots[c], CW_TRANSCODE_SLOT_SIZE);
+			out += len;
+
+			has_character = true;
+			is_word_pending = false;
+			n_characters++;
+			continue;
+		}
+
+		switch (tr->classes[c]) {
+		case CW_TRANSCODE_CLASS_SPACE:
+			is_word_pending = has_character;
+			break;
+		case CW_TRANSCODE_CLASS_NEWLINE:
+			*out++ = '\n';
+			has_character = false;
+			is_word_pending = false;
+			break;
+		default:
+			n_errors++;
+			break;
+		}
+	}
+
+	tr->has_character = has_character;
+	tr->is_word_pending = is_word_pending;
+	tr->n_characters += n_characters;
+	tr->n_errors += n_errors;
+
+	return (size_t) (out - output);
+}
+
+
+
+
+/**
+   \brief Decode a chunk of Dots and Dashes text
+
+   \param tr - transcoder
+   \param input - chunk of Dots and Dashes text
+   \param size - size of the chunk
+   \param output - output buffer
+
+   \return count of bytes written to \p output
+*/
+size_t cw_transcoder_decode_internal(cw_transcoder_t * tr, const unsigned char * input, size_t size, char * output)
+{
+	/* See comment in cw_transcoder_encode_internal(). */
+	bool has_character = tr->has_character;
+	bool is_word_pending = tr->is_word_pending;
+	unsigned int hash = tr->hash;
+	int n_elements = tr->n_elements;
+	size_t run_len = tr->run_len;
+	int64_t n_characters = 0;
+	int64_t n_errors = 0;
+
+	char * out = output;
+	const unsigned char * end = input + size;
+
+	for (const unsigned char * in = input; in < end; in++) {
+		const uint8_t class = tr->classes[*in];
+
+		if (class == CW_TRANSCODE_CLASS_DOT || class == CW_TRANSCODE_CLASS_DASH) {
+			if (n_elements == 0) {
+				/* First element of a character ends
+				   preceding run of separator bytes. */
+				if (is_word_pending) {
+					*out++ = ' ';
+					is_word_pending = false;
+				}
+				run_len = 0;
+			}
+			if (n_elements < CW_DATA_MAX_REPRESENTATION_LENGTH) {
+				hash = (hash << 1) | (class == CW_TRANSCODE_CLASS_DASH);
+			}
+			n_elements++;
+			continue;
+		}
+
+		/* Any other byte ends representation being collected. */
+		if (n_elements) {
+			const char c = n_elements <= CW_DATA_MAX_REPRESENTATION_LENGTH
+				? tr->decode_characters[hash]
+				: '\0';
+			if (c) {
+				*out++ = c;
+				has_character = true;
+				n_characters++;
+			} else {
+				n_errors++;
+			}
+			hash = 1; /* Sentinel bit, see cw_representation_to_hash_internal(). */
+			n_elements = 0;
+		}
+
+		switch (class) {
+		case CW_TRANSCODE_CLASS_SPACE:
+			run_len++;
+			if (tr->word_separator_is_run
+			    && run_len > tr->char_separator_len
+			    && has_character) {
+
+				is_word_pending = true;
+			}
+			break;
+
+		case CW_TRANSCODE_CLASS_WORD:
+			is_word_pending = has_character;
+			break;
+
+		case CW_TRANSCODE_CLASS_NEWLINE:
+			*out++ = '\n';
+			has_character = false;
+			is_word_pending = false;
+			run_len = 0;
+			break;
+
+		default:
+			n_errors++;
+			break;
+		}
+	}
+
+	tr->has_character = has_character;
+	tr->is_word_pending = is_word_pending;
+	tr->hash = hash;
+	tr->n_elements = n_elements;
+	tr->run_len = run_len;
+	tr->n_characters += n_characters;
+	tr->n_errors += n_errors;
+
+	return (size_t) (out - output);
+}
+
+
+
+
+/**
+   \brief Write out character whose representation has been collected by decoder
+
+   Function does nothing if no representation has been collected.
+
+   \param tr - transcoder
+   \param output - position in output buffer
+
+   \return position in output buffer after the character
+*/
+char * cw_transcoder_decode_character_internal(cw_transcoder_t * tr, char * output)
+{
+	if (tr->n_elements == 0) {
+		return output;
+	}
+
+	const char c = tr->n_elements <= CW_DATA_MAX_REPRESENTATION_LENGTH
+		? tr->decode_characters[tr->hash]
+		: '\0';
+	if (c) {
+		*output++ = c;
+		tr->has_character = true;
+		tr->n_characters++;
+	} else {
+		tr->n_errors++;
+	}
+
+	tr->hash = 1; /* Sentinel bit, see cw_representation_to_hash_internal(). */
+	tr->n_elements = 0;
+
+	return output;
+}
+
+
+
+
+/**
+   \brief Reset streaming state of transcoder
+
+   \param tr - transcoder
+*/
+void cw_transcoder_reset_internal(cw_transcoder_t * tr)
+{
+	tr->has_character = false;
+	tr->is_word_pending = false;
+	tr->hash = 1;
+	tr->n_elements = 0;
+	tr->run_len = 0;
+
+	return;
+}
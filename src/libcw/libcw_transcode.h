@@ -0,0 +1,96 @@
+/*
+  This file is a part of unixcw project.
+  unixcw project is covered by GNU General Public License, version 2 or later.
+*/
+
+#ifndef H_LIBCW_TRANSCODE
+#define H_LIBCW_TRANSCODE
+
+
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+
+
+/* Direction of transcoding. */
+enum {
+	CW_TRANSCODE_ENCODE = 0,  /* Text to Dots and Dashes. */
+	CW_TRANSCODE_DECODE = 1   /* Dots and Dashes to text. */
+};
+
+/* Default separators of representations of characters and of
+   words in Dots and Dashes text. */
+#define CW_TRANSCODE_CHAR_SEPARATOR_DEFAULT  " "
+#define CW_TRANSCODE_WORD_SEPARATOR_DEFAULT  " / "
+
+/* Longest separator. */
+#define CW_TRANSCODE_SEPARATOR_LEN_MAX       15
+
+/* Each representation is stored in a fixed-size slot, so that
+   encoder can copy it with a single fixed-size memcpy(). */
+#define CW_TRANSCODE_SLOT_SIZE               8
+
+
+
+
+/* Classes of bytes of input. Encoder uses only OTHER, SPACE and
+   NEWLINE classes. */
+enum {
+	CW_TRANSCODE_CLASS_OTHER = 0,   /* Encoder: any non-space byte. Decoder: byte not valid in Dots and Dashes text. */
+	CW_TRANSCODE_CLASS_DOT,
+	CW_TRANSCODE_CLASS_DASH,
+	CW_TRANSCODE_CLASS_SPACE,       /* Byte of character separator, or other white space. */
+	CW_TRANSCODE_CLASS_WORD,        /* Byte that appears only in word separator. */
+	CW_TRANSCODE_CLASS_NEWLINE
+};
+
+
+
+
+struct cw_transcoder_struct {
+	int direction;
+
+	char char_separator[CW_TRANSCODE_SEPARATOR_LEN_MAX + 1];
+	char word_separator[CW_TRANSCODE_SEPARATOR_LEN_MAX + 1];
+	size_t char_separator_len;
+	size_t word_separator_len;
+
+	/* Class of every byte value of input. */
+	uint8_t classes[256];
+
+	/* Encoder: representation of every byte value (zero length
+	   for bytes that have no representation). */
+	char encode_slots[256][CW_TRANSCODE_SLOT_SIZE];
+	uint8_t encode_lens[256];
+
+	/* Decoder: character of every representation hash (zero for
+	   unknown representations). */
+	char decode_characters[256];
+
+	/* Word separator consists only of bytes of character
+	   separator, so a word break is recognized by length of run
+	   of separator bytes. */
+	bool word_separator_is_run;
+
+	/* Streaming state, carried between chunks of input. */
+	bool has_character;      /* A character has been emitted on current line. */
+	bool is_word_pending;    /* Encoder: white space after a character. Decoder: run of separator bytes is a word break. */
+	unsigned int hash;       /* Decoder: hash of representation being collected. */
+	int n_elements;          /* Decoder: count of elements of representation being collected. */
+	size_t run_len;          /* Decoder: length of current run of separator bytes. */
+
+	/* Counters. */
+	int64_t n_characters;    /* Transcoded characters. */
+	int64_t n_errors;        /* Characters without representation, or unknown representations. */
+};
+
+typedef struct cw_transcoder_struct cw_transcoder_t;
+
+
+
+
+#endif /* #ifndef H_LIBCW_TRANSCODE */
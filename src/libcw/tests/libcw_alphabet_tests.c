@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+ * Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+
+
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+
+
+
+#include "test_framework.h"
+
+#include "libcw_alphabet.h"
+#include "libcw_alphabet_tests.h"
+#include "libcw_gen.h"
+#include "libcw_rec.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+int test_cw_alphabet(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	const char * representations[CW_ALPHABET_REPRESENTATIONS_MAX];
+
+	/* Lookup of codepoints. */
+	{
+		int n = LIBCW_TEST_FUT(cw_alphabet_codepoint_to_representations)(CW_ALPHABET_CYRILLIC, 0x0429, representations); /* Щ */
+		cte->expect_op_int(cte, 1, "==", n, false, "Cyrillic capital letter");
+		cte->expect_op_int(cte, 0, "==", strcmp("--.-", representations[0]), false, "Cyrillic capital letter representation");
+
+		n = cw_alphabet_codepoint_to_representations(CW_ALPHABET_CYRILLIC, 0x0449, representations); /* щ */
+		cte->expect_op_int(cte, true, "==", n == 1 && !strcmp("--.-", representations[0]), false, "Cyrillic small letter");
+
+		n = cw_alphabet_codepoint_to_representations(CW_ALPHABET_GREEK, '7', representations);
+		cte->expect_op_int(cte, true, "==", n == 1 && !strcmp("--...", representations[0]), false, "digit in Greek alphabet");
+
+		n = cw_alphabet_codepoint_to_representations(CW_ALPHABET_LATIN, 0xFC, representations); /* ü */
+		cte->expect_op_int(cte, true, "==", n == 1 && !strcmp("..--", representations[0]), false, "Latin letter with diaeresis");
+
+		n = cw_alphabet_codepoint_to_representations(CW_ALPHABET_WABUN, 0x30AC, representations); /* ガ */
+		cte->expect_op_int(cte, 2, "==", n, false, "Wabun voiced kana");
+		cte->expect_op_int(cte, true, "==", n == 2 && !strcmp(".-..", representations[0]) && !strcmp("..", representations[1]), false, "Wabun voiced kana representations");
+
+		errno = 0;
+		n = cw_alphabet_codepoint_to_representations(CW_ALPHABET_CYRILLIC, 'Q', representations);
+		cte->expect_op_int(cte, 0, "==", n || errno != ENOENT, false, "Latin letter in Cyrillic alphabet");
+
+		errno = 0;
+		n = cw_alphabet_codepoint_to_representations(CW_ALPHABET_MAX, 'Q', representations);
+		cte->expect_op_int(cte, 0, "==", n || errno != EINVAL, false, "invalid alphabet");
+	}
+
+	/* Lookup of representations. */
+	{
+		uint32_t codepoint = LIBCW_TEST_FUT(cw_alphabet_representation_to_codepoint)(CW_ALPHABET_CYRILLIC, "--.-");
+		cte->expect_op_int(cte, 0x0429, "==", (int) codepoint, false, "Cyrillic representation");
+		codepoint = cw_alphabet_representation_to_codepoint(CW_ALPHABET_LATIN, "--.-");
+		cte->expect_op_int(cte, 'Q', "==", (int) codepoint, false, "Latin representation");
+		codepoint = cw_alphabet_representation_to_codepoint(CW_ALPHABET_HEBREW, ".----");
+		cte->expect_op_int(cte, '1', "==", (int) codepoint, false, "digit in Hebrew alphabet");
+		codepoint = cw_alphabet_representation_to_codepoint(CW_ALPHABET_CYRILLIC, "........");
+		cte->expect_op_int(cte, 0, "==", (int) codepoint, false, "unknown representation");
+	}
+
+	/* UTF-8. */
+	{
+		const char * string = "\xd0\xa9" "\xe3\x82\xac";
+		uint32_t codepoint = 0;
+		bool ok = cw_utf8_decode_internal(&string, &codepoint);
+		cte->expect_op_int(cte, 0x0429, "==", ok ? (int) codepoint : -1, false, "decode two-byte sequence");
+		ok = cw_utf8_decode_internal(&string, &codepoint);
+		cte->expect_op_int(cte, 0x30AC, "==", ok ? (int) codepoint : -1, false, "decode three-byte sequence");
+		cte->expect_op_int(cte, 0, "==", *string, false, "decode whole string");
+
+		const char * invalid[] = { "\xc0\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xd0", "\x80" };
+		for (size_t i = 0; i < sizeof (invalid) / sizeof (invalid[0]); i++) {
+			string = invalid[i];
+			ok = cw_utf8_decode_internal(&string, &codepoint);
+			cte->expect_op_int(cte, false, "==", ok, false, "decode invalid sequence #%zu", i);
+		}
+
+		const uint32_t codepoints[] = { 'A', 0xFC, 0x0429, 0x30AC, 0x1F600 };
+		for (size_t i = 0; i < sizeof (codepoints) / sizeof (codepoints[0]); i++) {
+			char buffer[CW_ALPHABET_UTF8_SIZE];
+			const int len = cw_utf8_encode_internal(codepoints[i], buffer);
+			string = buffer;
+			ok = cw_utf8_decode_internal(&string, &codepoint);
+			cte->expect_op_int(cte, 0, "==", !ok || codepoint != codepoints[i] || string != buffer + len, false, "round trip of U+%04X", codepoints[i]);
+		}
+	}
+
+	/* Generator. */
+	{
+		cw_gen_t * gen = cw_gen_new(CW_AUDIO_NULL, NULL);
+		cte->assert2(cte, gen, "failed to create generator");
+
+		/* "ЩИ" */
+		errno = 0;
+		int cwret = LIBCW_TEST_FUT(cw_gen_enqueue_utf8_string)(gen, "\xd0\xa9\xd0\x98");
+		cte->expect_op_int(cte, true, "==", cwret == CW_FAILURE && errno == ENOENT, false, "enqueue Cyrillic string in Latin alphabet");
+		cte->expect_op_int(cte, 0, "==", (int) cw_gen_get_queue_length(gen), false, "queue length after failed enqueue");
+
+		cwret = LIBCW_TEST_FUT(cw_gen_set_alphabet)(gen, CW_ALPHABET_CYRILLIC);
+		cte->expect_op_int(cte, CW_SUCCESS, "==", cwret, false, "set alphabet");
+		cwret = cw_gen_enqueue_utf8_string(gen, "\xd0\xa9\xd0\x98");
+		cte->expect_op_int(cte, CW_SUCCESS, "==", cwret, false, "enqueue Cyrillic string");
+		/* Marks of --.- and .., each followed by inter-mark-space,
+		   plus end-of-character space after each character. */
+		cte->expect_op_int(cte, 8 + 1 + 4 + 1, "==", (int) cw_gen_get_queue_length(gen), false, "queue length after enqueue");
+
+		errno = 0;
+		cwret = cw_gen_enqueue_utf8_string(gen, "\xd0");
+		cte->expect_op_int(cte, true, "==", cwret == CW_FAILURE && errno == ENOENT, false, "enqueue invalid UTF-8");
+		cwret = cw_gen_set_alphabet(gen, -1);
+		cte->expect_op_int(cte, CW_FAILURE, "==", cwret, false, "set invalid alphabet");
+
+		cw_gen_delete(&gen);
+	}
+
+	/* Receiver. */
+	{
+		cw_rec_t * rec = cw_rec_new();
+		cte->assert2(cte, rec, "failed to create receiver");
+
+		int cwret = LIBCW_TEST_FUT(cw_rec_set_alphabet)(rec, CW_ALPHABET_GREEK);
+		cte->expect_op_int(cte, CW_SUCCESS, "==", cwret, false, "set alphabet");
+
+		struct timeval timestamp = { .tv_sec = 1, .tv_usec = 0 };
+		const char * representation = ".--."; /* Π */
+		for (const char * mark = representation; *mark; mark++) {
+			timestamp.tv_usec += 100000;
+			cw_rec_add_mark(rec, &timestamp, *mark);
+		}
+		timestamp.tv_sec += 2;
+
+		char character[CW_ALPHABET_UTF8_SIZE];
+		bool is_end_of_word = false;
+		bool is_error = true;
+		cwret = LIBCW_TEST_FUT(cw_rec_poll_utf8_character)(rec, &timestamp, character, &is_end_of_word, &is_error);
+		cte->expect_op_int(cte, CW_SUCCESS, "==", cwret, false, "poll UTF-8 character");
+		cte->expect_op_int(cte, 0, "==", strcmp("\xce\xa0", character), false, "received character");
+		cte->expect_op_int(cte, true, "==", is_end_of_word, false, "end of word");
+		cte->expect_op_int(cte, false, "==", is_error, false, "error flag");
+
+		cw_rec_delete(&rec);
+	}
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
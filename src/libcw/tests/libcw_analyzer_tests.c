@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+ * Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+
+
+
+#include "test_framework.h"
+
+#include "libcw_analyzer.h"
+#include "libcw_analyzer_tests.h"
+#include "libcw_data.h"
+#include "libcw_key.h"
+#include "libcw_rec.h"
+#include "libcw_utils.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+static void test_analyzer_timestamp_add(struct timeval * timestamp, double usecs);
+static void test_analyzer_key_representation(cw_analyzer_t * an, struct timeval * timestamp, int unit, const char * representation, double dot_units, bool is_end_of_word);
+static void test_analyzer_key_text(cw_analyzer_t * an, struct timeval * timestamp, int unit, const char * text);
+
+
+
+
+void test_analyzer_timestamp_add(struct timeval * timestamp, double usecs)
+{
+	timestamp->tv_usec += (int) usecs;
+	timestamp->tv_sec += timestamp->tv_usec / CW_USECS_PER_SEC;
+	timestamp->tv_usec %= CW_USECS_PER_SEC;
+}
+
+
+
+
+/* Key one character, with Dots \p dot_units long. */
+void test_analyzer_key_representation(cw_analyzer_t * an, struct timeval * timestamp, int unit, const char * representation, double dot_units, bool is_end_of_word)
+{
+	for (const char * r = representation; *r; r++) {
+		cw_analyzer_add_event(an, timestamp, CW_KEY_STATE_CLOSED);
+		test_analyzer_timestamp_add(timestamp, (*r == CW_DOT_REPRESENTATION ? dot_units : 3) * unit);
+		cw_analyzer_add_event(an, timestamp, CW_KEY_STATE_OPEN);
+		test_analyzer_timestamp_add(timestamp, unit);
+	}
+	test_analyzer_timestamp_add(timestamp, (is_end_of_word ? 6 : 2) * unit);
+
+	return;
+}
+
+
+
+
+void test_analyzer_key_text(cw_analyzer_t * an, struct timeval * timestamp, int unit, const char * text)
+{
+	for (const char * c = text; *c; c++) {
+		if (*c != ' ') {
+			test_analyzer_key_representation(an, timestamp, unit, cw_character_to_representation_internal(*c), 1.0, c[1] == ' ' || c[1] == '\0');
+		}
+	}
+
+	return;
+}
+
+
+
+
+/**
+   Analyze keying with known timing and known errors
+*/
+int test_cw_analyzer(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	cw_analyzer_t * an = LIBCW_TEST_FUT(cw_analyzer_new)();
+	cte->expect_valid_pointer(cte, an, "analyzer new");
+	cte->assert2(cte, an, "failed to create analyzer");
+	cte->expect_op_int(cte, CW_SUCCESS, "==", LIBCW_TEST_FUT(cw_analyzer_set_parameters)(an, 20, 50), false, "set parameters");
+
+	const int unit = CW_DOT_CALIBRATION / 20;
+	struct timeval t = { 1000, 0 };
+
+	const int n_words = 200;
+	for (int i = 0; i < n_words; i++) {
+		test_analyzer_key_text(an, &t, unit, "PARIS");
+	}
+	/* 'A' with too long Dot. */
+	const int n_malformed = 20;
+	for (int i = 0; i < n_malformed; i++) {
+		test_analyzer_key_representation(an, &t, unit, ".-", 1.8, true);
+	}
+	/* Representation that isn't a character. */
+	const int n_unknown = 5;
+	for (int i = 0; i < n_unknown; i++) {
+		test_analyzer_key_representation(an, &t, unit, "......", 1.0, true);
+	}
+	LIBCW_TEST_FUT(cw_analyzer_flush)(an);
+
+
+	cte->expect_op_int(cte, n_words * 5 + n_malformed, "==", (int) an->n_characters, false, "count of characters");
+	cte->expect_op_int(cte, n_words + n_malformed, "==", (int) an->n_words, false, "count of words");
+	cte->expect_op_int(cte, n_unknown, "==", (int) an->n_unknown, false, "count of unknown representations");
+
+	const double expected_dot = (10.0 * n_words * unit + 1.8 * n_malformed * unit) / (10 * n_words + n_malformed);
+	cte->log_info(cte, "dot: %.0f +/- %.0f us (expected %.0f us), dash: %.0f us\n",
+		      an->dot.mean, cw_analyzer_stat_get_sd(&an->dot), expected_dot, an->dash.mean);
+	cte->expect_op_int(cte, true, "==", fabs(an->dot.mean - expected_dot) < 100, false, "mean length of Dots");
+	cte->expect_op_int(cte, true, "==", fabs(an->dash.mean - 3 * unit) < 100, false, "mean length of Dashes");
+	cte->expect_op_int(cte, true, "==", fabs(an->iword_space.mean - 7 * unit) < 100, false, "mean length of inter-word spaces");
+	cte->expect_op_int(cte, true, "==", fabs(an->ichar_space.mean - 3 * unit) < 100, false, "mean length of inter-character spaces");
+
+	double ratio = 0.0;
+	double weighting = 0.0;
+	cte->expect_op_int(cte, CW_SUCCESS, "==", LIBCW_TEST_FUT(cw_analyzer_get_ratio)(an, &ratio), false, "get ratio");
+	cte->expect_op_int(cte, CW_SUCCESS, "==", LIBCW_TEST_FUT(cw_analyzer_get_weighting)(an, &weighting), false, "get weighting");
+	cte->log_info(cte, "ratio = %.2f, weighting = %.1f\n", ratio, weighting);
+	cte->expect_op_int(cte, true, "==", fabs(ratio - 3.0) < 0.1, false, "ratio");
+	cte->expect_op_int(cte, true, "==", fabs(weighting - 50.0) < 3.0, false, "weighting");
+
+	const cw_analyzer_character_t * p = LIBCW_TEST_FUT(cw_analyzer_get_character)(an, 'P');
+	cte->assert2(cte, p, "failed to get statistics of character");
+	cte->expect_op_int(cte, n_words, "==", (int) p->n, false, "count of 'P' characters");
+	cte->expect_op_int(cte, 0, "==", (int) p->n_malformed, false, "count of mis-formed 'P' characters");
+	cte->expect_op_int(cte, true, "==", fabs(p->speed.mean - 20.0) < 0.5, false, "speed of 'P' characters");
+
+	char malformed[4];
+	const int n = LIBCW_TEST_FUT(cw_analyzer_get_malformed_characters)(an, malformed, 3);
+	cte->expect_op_int(cte, 1, "==", n, false, "count of mis-formed characters");
+	cte->expect_op_int(cte, 'A', "==", malformed[0], false, "mis-formed character");
+
+	char representation[CW_ANALYZER_UNKNOWN_LEN + 1];
+	int64_t count = 0;
+	cte->expect_op_int(cte, CW_SUCCESS, "==", LIBCW_TEST_FUT(cw_analyzer_get_unknown)(an, 0, representation, &count), false, "get unknown representation");
+	cte->expect_op_int(cte, true, "==", 0 == strcmp("......", representation) && count == n_unknown, false, "unknown representation");
+	cte->expect_op_int(cte, CW_FAILURE, "==", cw_analyzer_get_unknown(an, 1, representation, &count), false, "get non-existent unknown representation");
+
+	double speeds[CW_ANALYZER_SPEED_POINTS_MAX];
+	int64_t interval = 0;
+	const int n_points = LIBCW_TEST_FUT(cw_analyzer_get_speed_curve)(an, speeds, &interval);
+	cte->log_info(cte, "%d points of speed curve, %lld us each; first point: %.2f wpm\n", n_points, (long long) interval, speeds[0]);
+	cte->expect_op_int(cte, true, "==", n_points > 1 && fabs(speeds[0] - 20.0) < 0.5, false, "speed curve");
+
+	LIBCW_TEST_FUT(cw_analyzer_delete)(&an);
+	cte->expect_null_pointer(cte, an, "analyzer delete");
+
+
+	/* Hours of keying are analyzed quickly, in constant memory. */
+	{
+		an = cw_analyzer_new();
+		cw_analyzer_set_parameters(an, 20, 50);
+
+		struct timeval begin, end;
+		gettimeofday(&begin, NULL);
+		const int n_long = 20000;
+		for (int i = 0; i < n_long; i++) {
+			test_analyzer_key_text(an, &t, unit, "PARIS");
+		}
+		cw_analyzer_flush(an);
+		gettimeofday(&end, NULL);
+
+		const int duration = cw_timestamp_compare_internal(&begin, &end);
+		const int n_points_long = cw_analyzer_get_speed_curve(an, speeds, &interval);
+		cte->log_info(cte, "%lld events (%.1f hours of keying) analyzed in %d us; %d points of speed curve, %lld s each\n",
+			      (long long) an->n_events, an->keying_time / 3600e6, duration, n_points_long, (long long) interval / CW_USECS_PER_SEC);
+		cte->expect_op_int(cte, n_long * 5, "==", (int) an->n_characters, false, "count of characters in long keying");
+		cte->expect_op_int(cte, true, "==", n_points_long <= CW_ANALYZER_SPEED_POINTS_MAX && interval > CW_ANALYZER_SPEED_INTERVAL_INITIAL, false, "speed curve of long keying");
+		cte->expect_op_int(cte, true, "==", fabs(speeds[n_points_long / 2] - 20.0) < 0.5, false, "speed in the middle of long keying");
+
+		cw_analyzer_delete(&an);
+	}
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+ * Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+
+#include "test_framework.h"
+
+#include "libcw_codec.h"
+#include "libcw_codec_tests.h"
+#include "libcw_sched.h"
+#include "libcw_gen.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+/* Growing buffer of samples. */
+typedef struct {
+	cw_sample_t * samples;
+	size_t n_samples;
+	size_t capacity;
+	size_t n_silent_samples; /* Samples passed as silence. */
+} test_codec_pcm_t;
+
+/* Growing buffer of encoded bytes. */
+typedef struct {
+	uint8_t * bytes;
+	size_t n_bytes;
+	size_t capacity;
+} test_codec_stream_t;
+
+
+
+
+static int test_codec_pcm_write(void * write_arg, const cw_sample_t * samples, int n_samples)
+{
+	test_codec_pcm_t * pcm = (test_codec_pcm_t *) write_arg;
+	if (pcm->n_samples + n_samples > pcm->capacity) {
+		pcm->capacity = 2 * (pcm->n_samples + n_samples);
+		pcm->samples = (cw_sample_t *) realloc(pcm->samples, pcm->capacity * sizeof (cw_sample_t));
+		if (!pcm->samples) {
+			return CW_FAILURE;
+		}
+	}
+	memcpy(pcm->samples + pcm->n_samples, samples, n_samples * sizeof (cw_sample_t));
+	pcm->n_samples += n_samples;
+
+	return CW_SUCCESS;
+}
+
+
+
+
+static int test_codec_pcm_write_silence(void * write_arg, int n_samples)
+{
+	test_codec_pcm_t * pcm = (test_codec_pcm_t *) write_arg;
+	const cw_sample_t silence[CW_SCHED_BUFFER_N_SAMPLES_DEFAULT] = { 0 };
+	if (n_samples > CW_SCHED_BUFFER_N_SAMPLES_DEFAULT) {
+		return CW_FAILURE;
+	}
+	pcm->n_silent_samples += n_samples;
+
+	return test_codec_pcm_write(write_arg, silence, n_samples);
+}
+
+
+
+
+static int test_codec_stream_write(void * write_arg, const uint8_t * bytes, size_t n_bytes)
+{
+	test_codec_stream_t * stream = (test_codec_stream_t *) write_arg;
+	if (stream->n_bytes + n_bytes > stream->capacity) {
+		stream->capacity = 2 * (stream->n_bytes + n_bytes);
+		stream->bytes = (uint8_t *) realloc(stream->bytes, stream->capacity);
+		if (!stream->bytes) {
+			return CW_FAILURE;
+		}
+	}
+	memcpy(stream->bytes + stream->n_bytes, bytes, n_bytes);
+	stream->n_bytes += n_bytes;
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   Encode output of a generator, decode it, and compare decoded
+   samples with samples produced by the generator
+*/
+int test_cw_codec_encode_decode(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	test_codec_pcm_t original = { 0 };
+	test_codec_stream_t stream = { 0 };
+
+	cw_sched_t * sched = cw_sched_new(1, 0, 0);
+	cte->assert2(cte, sched, "failed to create scheduler");
+	cw_gen_t * gen = cw_sched_add_session(sched, test_codec_pcm_write, &original);
+	cte->assert2(cte, gen, "failed to create session");
+
+	cw_codec_encoder_t * enc = LIBCW_TEST_FUT(cw_codec_encoder_new)(gen, test_codec_stream_write, &stream);
+	cte->expect_valid_pointer(cte, enc, "encoder new");
+	cte->assert2(cte, enc, "failed to create encoder");
+
+	cw_gen_set_speed(gen, 25);
+	cw_gen_enqueue_string(gen, "CQ CQ DE SP5 ");
+	/* Change of parameters in the middle of stream. */
+	cw_gen_enqueue_string(gen, "PARIS ");
+	for (int i = 0; i < 100000 && cw_gen_get_queue_length(gen) > 20; i++) {
+		cw_sched_tick(sched);
+	}
+	cw_gen_set_volume(gen, 40);
+	cw_gen_set_tone_slope(gen, CW_TONE_SLOPE_SHAPE_LINEAR, 3000);
+	cw_gen_set_frequency(gen, 650);
+	cw_gen_enqueue_string(gen, "73");
+
+	bool busy = true;
+	for (int i = 0; i < 100000 && busy; i++) {
+		cw_sched_tick(sched);
+		busy = cw_gen_get_queue_length(gen) || gen->render.has_tone;
+	}
+	/* Some silence at the end. */
+	for (int i = 0; i < 50; i++) {
+		cw_sched_tick(sched);
+	}
+
+	LIBCW_TEST_FUT(cw_codec_encoder_delete)(&enc);
+	cte->expect_null_pointer(cte, enc, "encoder delete");
+	cte->expect_null_pointer(cte, gen->encoder, "generator's encoder after encoder delete");
+
+
+	const size_t pcm_bytes = original.n_samples * sizeof (cw_sample_t);
+	cte->log_info(cte, "%zu bytes of PCM encoded in %zu bytes (%.1f : 1)\n",
+		      pcm_bytes, stream.n_bytes, 1.0 * pcm_bytes / stream.n_bytes);
+	cte->expect_op_int(cte, true, "==", stream.n_bytes * 50 <= pcm_bytes, false, "compression ratio of at least 50:1");
+
+
+	/* Decode the stream as whole, then byte by byte, and then
+	   as whole, with silence passed separately. */
+	for (int pass = 0; pass < 3; pass++) {
+		test_codec_pcm_t decoded = { 0 };
+		cw_codec_decoder_t * dec = LIBCW_TEST_FUT(cw_codec_decoder_new)(test_codec_pcm_write, &decoded);
+		cte->assert2(cte, dec, "failed to create decoder");
+		if (pass == 2) {
+			LIBCW_TEST_FUT(cw_codec_decoder_set_write_silence)(dec, test_codec_pcm_write_silence);
+		}
+
+		bool push_failure = false;
+		if (pass != 1) {
+			push_failure = CW_SUCCESS != LIBCW_TEST_FUT(cw_codec_decoder_push)(dec, stream.bytes, stream.n_bytes);
+		} else {
+			for (size_t i = 0; i < stream.n_bytes; i++) {
+				if (CW_SUCCESS != LIBCW_TEST_FUT(cw_codec_decoder_push)(dec, stream.bytes + i, 1)) {
+					push_failure = true;
+					break;
+				}
+			}
+		}
+		cte->expect_op_int(cte, false, "==", push_failure, false, "decoding (pass %d)", pass);
+		cte->expect_op_int(cte, (int) original.n_samples, "==", (int) decoded.n_samples, false, "count of decoded samples (pass %d)", pass);
+
+		const bool identical = original.n_samples == decoded.n_samples
+			&& 0 == memcmp(original.samples, decoded.samples, pcm_bytes);
+		cte->expect_op_int(cte, true, "==", identical, false, "decoded samples are identical (pass %d)", pass);
+		if (pass == 2) {
+			cte->log_info(cte, "%zu of %zu decoded samples passed as silence\n", decoded.n_silent_samples, decoded.n_samples);
+			cte->expect_op_int(cte, true, "==", decoded.n_silent_samples * 3 >= decoded.n_samples, false, "at least a third of samples passed as silence");
+		}
+
+		LIBCW_TEST_FUT(cw_codec_decoder_delete)(&dec);
+		free(decoded.samples);
+	}
+
+	/* Invalid stream. */
+	{
+		test_codec_pcm_t decoded = { 0 };
+		cw_codec_decoder_t * dec = cw_codec_decoder_new(test_codec_pcm_write, &decoded);
+		const uint8_t garbage[] = "RIFF....WAVE";
+		cte->expect_op_int(cte, CW_FAILURE, "==", cw_codec_decoder_push(dec, garbage, sizeof (garbage)), false, "decoding invalid stream");
+		cw_codec_decoder_delete(&dec);
+	}
+
+	/* Record that never ends: magic of stream followed by
+	   unterminated varint. Decoder must give up instead of waiting
+	   for more bytes forever. */
+	{
+		test_codec_pcm_t decoded = { 0 };
+		cw_codec_decoder_t * dec = cw_codec_decoder_new(test_codec_pcm_write, &decoded);
+		uint8_t garbage[100];
+		memset(garbage, 0x80, sizeof (garbage));
+		memcpy(garbage, stream.bytes, 4); /* Magic. */
+		errno = 0;
+		const int cwret = cw_codec_decoder_push(dec, garbage, sizeof (garbage));
+		cte->expect_op_int(cte, CW_FAILURE, "==", cwret, false, "decoding endless record");
+		cte->expect_op_int(cte, EINVAL, "==", errno, false, "errno after decoding endless record");
+		cw_codec_decoder_delete(&dec);
+		free(decoded.samples);
+	}
+
+	cw_sched_delete(&sched);
+	free(original.samples);
+	free(stream.bytes);
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
+
+
+
+
+/**
+   Encode output of a generator keyed by straight key, with slopes
+   split between buffers and interrupted by edges, decode it, and
+   compare decoded samples with samples produced by the generator
+*/
+int test_cw_codec_straight_key(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	test_codec_pcm_t original = { 0 };
+	test_codec_stream_t stream = { 0 };
+
+	/* Generator set up in the same way as session of scheduler.
+	   Buffer of 10 ms, slopes of 48 samples. */
+	cw_gen_t * gen = cw_gen_new(CW_AUDIO_NULL, NULL);
+	cte->assert2(cte, gen, "failed to create generator");
+	gen->sample_rate = 48000;
+	gen->buffer_n_samples = 480;
+	gen->buffer = (cw_sample_t *) malloc(gen->buffer_n_samples * sizeof (cw_sample_t));
+	cte->assert2(cte, gen->buffer, "failed to allocate buffer");
+	gen->render.is_external = true;
+	cw_gen_set_volume(gen, 70);
+	cw_gen_set_tone_slope(gen, CW_TONE_SLOPE_SHAPE_RAISED_COSINE, 1000);
+
+	cw_codec_encoder_t * enc = cw_codec_encoder_new(gen, test_codec_stream_write, &stream);
+	cte->assert2(cte, enc, "failed to create encoder");
+
+	/* Edges [us]. Buffer rendered at n * 10 ms ends at the time.
+	   Rising slope split between buffers, falling slope split
+	   between buffers, rising slope interrupted by key-up, and
+	   rising slope split between buffers and then interrupted. */
+	const struct {
+		int usecs;
+		bool is_closed;
+	} edges[] = {
+		{  9600, true  }, { 39700, false },
+		{ 62000, true  }, { 62500, false },
+		{ 79900, true  }, { 80200, false }
+	};
+	size_t e = 0;
+	for (int b = 1; b <= 10; b++) {
+		const int now_usecs = b * 10000;
+		for (; e < sizeof (edges) / sizeof (edges[0]) && edges[e].usecs < now_usecs; e++) {
+			struct timeval t = { .tv_sec = 1000, .tv_usec = edges[e].usecs };
+			cw_gen_sk_publish_edge_internal(gen, edges[e].is_closed, &t);
+		}
+		struct timeval now = { .tv_sec = 1000 + now_usecs / 1000000, .tv_usec = now_usecs % 1000000 };
+		cw_gen_sk_render_buffer_internal(gen, 0, &now);
+		test_codec_pcm_write(&original, gen->buffer, gen->buffer_n_samples);
+	}
+
+	cw_codec_encoder_delete(&enc);
+
+	test_codec_pcm_t decoded = { 0 };
+	cw_codec_decoder_t * dec = cw_codec_decoder_new(test_codec_pcm_write, &decoded);
+	cte->assert2(cte, dec, "failed to create decoder");
+	const int cwret = LIBCW_TEST_FUT(cw_codec_decoder_push)(dec, stream.bytes, stream.n_bytes);
+	cte->expect_op_int(cte, CW_SUCCESS, "==", cwret, false, "decoding stream of straight key");
+	cte->expect_op_int(cte, (int) original.n_samples, "==", (int) decoded.n_samples, false, "count of decoded samples of straight key");
+
+	int n_different = 0;
+	for (size_t i = 0; i < original.n_samples && i < decoded.n_samples; i++) {
+		if (original.samples[i] != decoded.samples[i]) {
+			n_different++;
+		}
+	}
+	cte->expect_op_int(cte, 0, "==", n_different, false, "decoded samples of straight key are identical");
+
+	cw_codec_decoder_delete(&dec);
+	cw_gen_delete(&gen);
+	free(decoded.samples);
+	free(original.samples);
+	free(stream.bytes);
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
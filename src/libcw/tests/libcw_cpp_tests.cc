@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+ * Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+
+
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <utility>
+
+
+
+
+#include "libcw++.h"
+#include "libcw_cpp_tests.h"
+
+/* Internal headers are included too, so that declarations of modern
+   API in libcw++.h are checked against the real ones. */
+extern "C" {
+#include "libcw2.h"
+#include "libcw_data.h"
+}
+
+
+
+
+/* Encoding at compile time. */
+static constexpr auto test_cq = cw::encode("CQ de");
+static_assert(test_cq.size() == 18, "count of elements");
+static_assert(test_cq[0] == '-' && test_cq[4] == CW_ELEMENT_EOC_SPACE && test_cq[10] == CW_ELEMENT_EOW_SPACE, "elements");
+static_assert(cw::element_eoc_space == CW_ELEMENT_EOC_SPACE && cw::element_eow_space == CW_ELEMENT_EOW_SPACE, "elements of libcw");
+static_assert(cw::max_representation_length == CW_DATA_MAX_REPRESENTATION_LENGTH, "length of representation");
+static_assert(cw::representation('?') != nullptr && cw::representation('#') == nullptr, "representations");
+
+
+
+
+
+#if defined(__cpp_impl_coroutine)
+
+/* g++ warns about switch statements that it generates for bodies of
+   coroutines. */
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wswitch-default"
+#endif
+
+static cw::task test_play(cw::event_loop & loop, cw::generator & gen, int * progress)
+{
+	gen.enqueue("PARIS");
+	co_await loop.queue_below(gen, 2);
+	*progress = 1;
+	co_await loop.message_played(gen);
+	*progress = gen.queue_length() == 0 ? 2 : -1;
+}
+
+
+
+
+/* Receive a character, and then end of word. */
+static cw::task test_receive(cw::event_loop & loop, cw::receiver & rec, cw::event_loop::character received[2])
+{
+	received[0] = co_await loop.character_received(rec);
+	received[1] = co_await loop.character_received(rec);
+}
+
+
+
+
+static cw::task test_keyer(cw::event_loop & loop, cw::key & key, int * progress)
+{
+	key.ik_notify_paddle_event(CW_KEY_STATE_CLOSED, CW_KEY_STATE_OPEN);
+	key.ik_notify_paddle_event(CW_KEY_STATE_OPEN, CW_KEY_STATE_OPEN);
+	*progress = 1;
+	co_await loop.keyer_idle(key);
+	*progress = 2;
+}
+
+#endif
+
+
+
+
+int test_libcw_cpp(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	/* Compile-time representations are a copy of ASCII part of
+	   main table of characters; check that the copy matches the
+	   table. Other characters aren't known to the copy. */
+	{
+		int n_mismatches = 0;
+		for (int c = 0; c <= UCHAR_MAX; c++) {
+			const char * expected = c < 128 ? cw_character_to_representation_internal(c) : nullptr;
+			const char * representation = cw::representation((char) c);
+			if ((expected == nullptr) != (representation == nullptr)
+			    || (expected && std::strcmp(expected, representation))) {
+				n_mismatches++;
+			}
+		}
+		cte->expect_op_int(cte, 0, "==", n_mismatches, false, "compile-time representations vs. main table");
+	}
+
+	/* Encoded string is enqueued as cw_gen_enqueue_string()
+	   would enqueue it. */
+	{
+		static constexpr auto message = cw::encode("VVV DE N0CALL/B <");
+		cte->expect_op_int(cte, 0, "==", std::strcmp("...- ...- ...- / -.. . / -. ----- -.-. .- .-.. .-.. -..-. -... / ...-.- ", message.data()), false, "encoded message: '%s'", message.data());
+
+		cw::generator gen(CW_AUDIO_NULL);
+		cw::generator reference(CW_AUDIO_NULL);
+		bool cwret = LIBCW_TEST_FUT(cw_gen_enqueue_elements)(gen.get(), message.data(), message.size());
+		cte->expect_op_int(cte, true, "==", cwret, false, "enqueue elements");
+		reference.enqueue("VVV DE N0CALL/B <");
+		cte->expect_op_int(cte, (int) reference.queue_length(), "==", (int) gen.queue_length(), false, "queue length");
+
+		errno = 0;
+		cwret = cw_gen_enqueue_elements(gen.get(), ".-x", 3);
+		cte->expect_op_int(cte, true, "==", !cwret && errno == EINVAL, false, "enqueue invalid elements");
+
+		/* Ownership of generator is moved. */
+		cw::generator other = std::move(gen);
+		cte->expect_op_int(cte, true, "==", gen.get() == nullptr && other.get() != nullptr, false, "move generator");
+		cte->expect_op_int(cte, true, "==", other.set_speed(30) && other.speed() == 30, false, "set speed");
+	}
+
+	/* Receiver. */
+	{
+		cw::receiver rec;
+		struct timeval timestamp = { 1, 0 };
+		for (const char * mark = "-.-."; *mark; mark++) {
+			timestamp.tv_usec += 100000;
+			rec.add_mark(&timestamp, *mark);
+		}
+		timestamp.tv_sec += 2;
+
+		char c = '\0';
+		bool is_end_of_word = false;
+		bool is_error = true;
+		const bool cwret = rec.poll_character(&timestamp, c, is_end_of_word, is_error);
+		cte->expect_op_int(cte, true, "==", cwret && c == 'C' && is_end_of_word && !is_error, false, "poll character");
+	}
+
+	/* Key. */
+	{
+		cw::generator gen(CW_AUDIO_NULL);
+		cw::key key;
+		key.register_generator(gen);
+		cw::key other = std::move(key);
+		cte->expect_op_int(cte, true, "==", key.get() == nullptr && other.get() != nullptr, false, "move key");
+	}
+
+#if defined(__cpp_impl_coroutine)
+	/* Coroutines waiting for generators, receiver and keyer
+	   in single thread. */
+	{
+		cw::event_loop loop;
+
+		cw::generator gen1(CW_AUDIO_NULL);
+		cw::generator gen2(CW_AUDIO_NULL);
+		cw::generator gen3(CW_AUDIO_NULL);
+		for (cw::generator * gen : { &gen1, &gen2, &gen3 }) {
+			gen->set_speed(40);
+			gen->start();
+			loop.attach(*gen);
+		}
+
+		int played1 = 0;
+		int played2 = 0;
+		test_play(loop, gen1, &played1);
+		test_play(loop, gen2, &played2);
+
+		/* Last mark of 'C' ends now, so the loop has to wait
+		   for end-of-character gap. */
+		cw::receiver rec;
+		rec.set_speed(30);
+		rec.set_adaptive_mode(false);
+		struct timeval now;
+		gettimeofday(&now, nullptr);
+		long long usecs = now.tv_sec * 1000000LL + now.tv_usec - 440000;
+		for (const char * mark = "-.-."; *mark; mark++) {
+			struct timeval timestamp = { (time_t) (usecs / 1000000), (suseconds_t) (usecs % 1000000) };
+			rec.mark_begin(&timestamp);
+			usecs += *mark == '-' ? 120000 : 40000;
+			timestamp = { (time_t) (usecs / 1000000), (suseconds_t) (usecs % 1000000) };
+			rec.mark_end(&timestamp);
+			usecs += 40000;
+		}
+		cw::event_loop::character received[2];
+		test_receive(loop, rec, received);
+
+		cw::key key;
+		key.register_generator(gen3);
+		int keyed = 0;
+		test_keyer(loop, key, &keyed);
+
+		cte->expect_op_int(cte, true, "==", played1 == 0 && played2 == 0 && received[0].c == '\0' && keyed == 1, false, "coroutines are suspended");
+		loop.run();
+		cte->expect_op_int(cte, true, "==", played1 == 2 && played2 == 2 && !cw_gen_is_playing(gen1.get()), false, "message played");
+		cte->expect_op_int(cte, true, "==", received[0].c == 'C' && !received[0].is_end_of_word && !received[0].is_error, false, "character received: '%c'", received[0].c);
+		cte->expect_op_int(cte, true, "==", received[1].c == ' ' && received[1].is_end_of_word, false, "end of word received after character");
+		cte->expect_op_int(cte, true, "==", keyed == 2 && !cw_key_ik_is_busy(key.get()), false, "keyer idle");
+
+		for (cw::generator * gen : { &gen1, &gen2, &gen3 }) {
+			loop.detach(*gen);
+			gen->stop();
+		}
+	}
+#endif
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
@@ -0,0 +1,30 @@
+/*
+  This file is a part of unixcw project.  unixcw project is covered by
+  GNU General Public License, version 2 or later.
+*/
+
+#ifndef _LIBCW_CPP_TESTS_H_
+#define _LIBCW_CPP_TESTS_H_
+
+
+
+
+#include "test_framework.h"
+
+
+
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+int test_libcw_cpp(cw_test_executor_t * cte);
+
+#if defined(__cplusplus)
+}
+#endif
+
+
+
+
+#endif /* #ifndef _LIBCW_CPP_TESTS_H_ */
@@ -28,6 +28,7 @@
 #include <ctype.h>
 #include <limits.h>
 #include <string.h>
+#include <pthread.h>
 
 
 
@@ -643,6 +644,173 @@ int test_validate_string_internal(cw_test_executor_t * cte)
 
 
 
+/**
+   Validate and normalize a string in one pass
+*/
+int test_normalize_string_internal(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	char normalized[64];
+	size_t positions[2];
+
+	/* White space is collapsed, lowercase characters are
+	   converted, and invalid characters are removed. */
+	int n_invalid = LIBCW_TEST_FUT(cw_string_normalize)("cq \t\n cq%de n0call\x01", normalized, positions, 2);
+	cte->expect_op_int(cte, 2, "==", n_invalid, 0, "normalize string: count of invalid characters");
+	cte->expect_op_int(cte, 0, "==", strcmp("CQ CQDE N0CALL", normalized), 0, "normalize string: normalized string '%s'", normalized);
+	cte->expect_op_int(cte, true, "==", positions[0] == 8 && positions[1] == 18, 0, "normalize string: positions of invalid characters");
+
+	/* Only the first positions are reported; string is normalized in place. */
+	char text[] = "%% a   b %%";
+	n_invalid = cw_string_normalize(text, text, positions, 1);
+	cte->expect_op_int(cte, 4, "==", n_invalid, 0, "normalize string in place: count of invalid characters");
+	cte->expect_op_int(cte, 0, "==", strcmp(" A B ", text), 0, "normalize string in place: normalized string '%s'", text);
+	cte->expect_op_int(cte, 0, "==", (int) positions[0], 0, "normalize string in place: position of first invalid character");
+
+	/* Validation only. */
+	char charlist[UCHAR_MAX + 1];
+	cw_list_characters(charlist);
+	n_invalid = cw_string_normalize(charlist, NULL, NULL, 0);
+	cte->expect_op_int(cte, 0, "==", n_invalid, 0, "normalize string: validation of all characters");
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
+
+
+
+
+/**
+   Lookup thread for test_load_character_table_internal(): lookups
+   in table of characters must work while tables are swapped.
+*/
+static void * test_character_table_lookups(void * arg)
+{
+	const bool * done = (const bool *) arg;
+	long n_errors = 0;
+
+	while (!__atomic_load_n(done, __ATOMIC_ACQUIRE)) {
+		const char * representation = cw_character_to_representation_internal('A');
+		if (!representation || strcmp(representation, ".-") != 0) {
+			n_errors++;
+		}
+		if (cw_representation_to_character_internal("--.-") != 'Q') {
+			n_errors++;
+		}
+	}
+
+	return (void *) n_errors;
+}
+
+
+
+
+/**
+   Tables of characters defined by client code
+*/
+int test_load_character_table_internal(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	const int count = cw_get_character_count();
+
+	/* New character, and new representation of existing
+	   character. */
+	{
+		const char characters[] = { '*', '%' };
+		const char * representations[] = { "-.-.--", ".-.-.-" };
+		int cwret = LIBCW_TEST_FUT(cw_load_character_table)(characters, representations, 2);
+		cte->expect_op_int(cte, CW_SUCCESS, "==", cwret, 0, "load table");
+
+		const char * representation = cw_character_to_representation_internal('*');
+		cte->expect_op_int(cte, true, "==", representation && !strcmp("-.-.--", representation), 0, "new character: representation");
+		cte->expect_op_int(cte, '*', "==", cw_representation_to_character_internal("-.-.--"), 0, "new character: character");
+		cte->expect_op_int(cte, count + 2, "==", cw_get_character_count(), 0, "new character: count of characters");
+		cte->expect_op_int(cte, true, "==", cw_string_is_valid("CQ*%"), 0, "new character: valid string");
+
+		/* '.' has the same representation as '%', but it can
+		   still be sent. */
+		cte->expect_op_int(cte, '%', "==", cw_representation_to_character_internal(".-.-.-"), 0, "shared representation: character");
+		representation = cw_character_to_representation_internal('.');
+		cte->expect_op_int(cte, true, "==", representation && !strcmp(".-.-.-", representation), 0, "shared representation: representation");
+	}
+
+	/* Invalid entries don't change current table. */
+	{
+		const char characters[] = { '#', ' ' };
+		const char * representations[] = { "........", "-" };
+		errno = 0;
+		int cwret = cw_load_character_table(characters, representations, 1);
+		cte->expect_op_int(cte, true, "==", cwret == CW_FAILURE && errno == EINVAL, 0, "load table with too long representation");
+		errno = 0;
+		cwret = cw_load_character_table(characters + 1, representations + 1, 1);
+		cte->expect_op_int(cte, true, "==", cwret == CW_FAILURE && errno == EINVAL, 0, "load table with space character");
+		cte->expect_op_int(cte, '*', "==", cw_representation_to_character_internal("-.-.--"), 0, "table after failed load");
+	}
+
+	/* Table in file. */
+	{
+		char path[] = "/tmp/libcw_table_XXXXXX";
+		const int fd = mkstemp(path);
+		cte->assert2(cte, fd != -1, "failed to create temporary file");
+		const char * contents = "# Club characters\n\n* -.-.--\n0x23 .-...-\n";
+		cte->assert2(cte, write(fd, contents, strlen(contents)) == (ssize_t) strlen(contents), "failed to write temporary file");
+		close(fd);
+
+		int cwret = LIBCW_TEST_FUT(cw_load_character_table_file)(path);
+		cte->expect_op_int(cte, CW_SUCCESS, "==", cwret, 0, "load table from file");
+		cte->expect_op_int(cte, '#', "==", cw_representation_to_character_internal(".-...-"), 0, "table from file: character given with code");
+		cte->expect_op_int(cte, false, "==", cw_character_is_valid('%'), 0, "table from file: characters of previous table");
+
+		FILE * file = fopen(path, "w");
+		cte->assert2(cte, file, "failed to open temporary file");
+		fputs("* -.-.--\n** -.-\n", file);
+		fclose(file);
+		errno = 0;
+		cwret = cw_load_character_table_file(path);
+		cte->expect_op_int(cte, true, "==", cwret == CW_FAILURE && errno == EINVAL, 0, "load table from invalid file");
+		unlink(path);
+
+		cwret = cw_load_character_table_file(path);
+		cte->expect_op_int(cte, CW_FAILURE, "==", cwret, 0, "load table from missing file");
+	}
+
+	/* Lookups during swaps of tables. */
+	{
+		bool done = false;
+		pthread_t thread;
+		pthread_create(&thread, NULL, test_character_table_lookups, &done);
+
+		const char characters[] = { '*' };
+		const char * representations[] = { "-.-.--" };
+		for (int i = 0; i < 1000; i++) {
+			if (i % 2) {
+				cw_load_character_table(characters, representations, 1);
+			} else {
+				cw_reset_character_table();
+			}
+		}
+		__atomic_store_n(&done, true, __ATOMIC_RELEASE);
+
+		void * n_errors = NULL;
+		pthread_join(thread, &n_errors);
+		cte->expect_op_int(cte, 0, "==", (int) (long) n_errors, 0, "lookups during swaps of tables");
+	}
+
+	LIBCW_TEST_FUT(cw_reset_character_table)();
+	cte->expect_op_int(cte, count, "==", cw_get_character_count(), 0, "reset table: count of characters");
+	cte->expect_op_int(cte, false, "==", cw_character_is_valid('*'), 0, "reset table: character is removed");
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
+
+
+
+
 /**
    \brief Validating representations of characters
 
@@ -22,6 +22,8 @@ int test_prosign_lookups_internal(cw_test_executor_t * cte);
 int test_phonetic_lookups_internal(cw_test_executor_t * cte);
 int test_validate_character_internal(cw_test_executor_t * cte);
 int test_validate_string_internal(cw_test_executor_t * cte);
+int test_normalize_string_internal(cw_test_executor_t * cte);
+int test_load_character_table_internal(cw_test_executor_t * cte);
 int test_validate_representation_internal(cw_test_executor_t * cte);
 
 
@@ -22,7 +22,10 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <limits.h> /* UCHAR_MAX */
+#include <math.h>
+#include <string.h>
 #include <errno.h>
 #include <unistd.h>
 
@@ -32,6 +35,8 @@
 #include "test_framework.h"
 
 #include "libcw_gen.h"
+#include "libcw_tq_internal.h"
+#include "libcw_gen_internal.h"
 #include "libcw_gen_tests.h"
 #include "libcw_debug.h"
 #include "libcw_utils.h"
@@ -1221,3 +1226,811 @@ int test_cw_gen_enqueue_string(cw_test_executor_t * cte)
 
 	return 0;
 }
+
+
+
+
+/* Helpers for test_cw_gen_sk_edges(). */
+static void test_cw_gen_sk_timestamp(struct timeval * t, int usecs)
+{
+	t->tv_sec = 1000 + usecs / CW_USECS_PER_SEC;
+	t->tv_usec = usecs % CW_USECS_PER_SEC;
+}
+
+static int test_cw_gen_sk_max_abs(const cw_gen_t * gen, int start, int stop)
+{
+	int max = 0;
+	for (int i = start; i < stop; i++) {
+		const int a = abs(gen->buffer[i]);
+		max = a > max ? a : max;
+	}
+	return max;
+}
+
+
+
+
+/**
+   Straight key keying a generator: edges are applied to generator's
+   output with sample accuracy, one buffer period after they happen,
+   and there is no traffic in tone queue while the key is closed.
+*/
+int test_cw_gen_sk_edges(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	cw_gen_t * gen = cw_gen_new(CW_AUDIO_NULL, NULL);
+	cte->assert2(cte, gen, "failed to create generator");
+
+	/* Null generator doesn't have a buffer, set it up in the
+	   same way as session scheduler does. Buffer of 10 ms. */
+	gen->sample_rate = 48000;
+	gen->buffer_n_samples = 480;
+	gen->buffer = (cw_sample_t *) malloc(gen->buffer_n_samples * sizeof (cw_sample_t));
+	cte->assert2(cte, gen->buffer, "failed to allocate buffer");
+	gen->render.is_external = true;
+	cw_gen_set_volume(gen, 70);
+	cw_gen_set_tone_slope(gen, CW_TONE_SLOPE_SHAPE_LINEAR, 1000);
+	const int n_slope = gen->tone_slope.n_amplitudes;
+	cte->expect_op_int(cte, 48, "==", n_slope, 0, "sk edges: slope samples count");
+
+	const int plateau = gen->volume_abs * 9 / 10;
+	struct timeval t;
+
+	/* Key-down 5 ms before first buffer is rendered (at 10 ms):
+	   rising slope starts 240 samples into first buffer. Repeated
+	   key-down is ignored. */
+	test_cw_gen_sk_timestamp(&t, 5000);
+	LIBCW_TEST_FUT(cw_gen_sk_publish_edge_internal)(gen, true, &t);
+	LIBCW_TEST_FUT(cw_gen_sk_publish_edge_internal)(gen, true, &t);
+	cte->expect_op_int(cte, 1, "==", (int) gen->sk.n_edges, 0, "sk edges: repeated key-down is ignored");
+	cte->expect_op_int(cte, true, "==", LIBCW_TEST_FUT(cw_gen_sk_is_active_internal)(gen), 0, "sk edges: active after key-down");
+
+	test_cw_gen_sk_timestamp(&t, 10000);
+	LIBCW_TEST_FUT(cw_gen_sk_render_buffer_internal)(gen, 0, &t);
+	cte->expect_op_int(cte, 0, "==", test_cw_gen_sk_max_abs(gen, 0, 240), 0, "sk edges: silence before key-down edge");
+	cte->expect_op_int(cte, 0, "<", test_cw_gen_sk_max_abs(gen, 240, 240 + n_slope), 0, "sk edges: rising slope after key-down edge");
+	cte->expect_op_int(cte, plateau, "<", test_cw_gen_sk_max_abs(gen, 240 + n_slope, gen->buffer_n_samples), 0, "sk edges: tone after rising slope");
+
+	/* Key held: continuous tone, nothing in tone queue. */
+	bool failure = false;
+	for (int i = 2; i <= 4; i++) {
+		test_cw_gen_sk_timestamp(&t, i * 10000);
+		cw_gen_sk_render_buffer_internal(gen, 0, &t);
+		if (!cte->expect_op_int(cte, plateau, "<", test_cw_gen_sk_max_abs(gen, 0, gen->buffer_n_samples), 1, "sk edges: tone while key is held")
+		    || !cte->expect_op_int(cte, 0, "==", (int) cw_tq_length_internal(gen->tq), 1, "sk edges: tone queue is empty while key is held")) {
+			failure = true;
+		}
+	}
+	cte->expect_op_int(cte, false, "==", failure, 0, "sk edges: continuous tone while key is held");
+
+	/* Key-up at 42.5 ms, 2.5 ms into period of buffer rendered
+	   at 50 ms: falling slope starts 120 samples into the
+	   buffer. The mark is 4 * 480 + 120 - 240 = 1800 samples
+	   (37.5 ms) long, just as the time between the edges. */
+	test_cw_gen_sk_timestamp(&t, 42500);
+	LIBCW_TEST_FUT(cw_gen_sk_publish_edge_internal)(gen, false, &t);
+	test_cw_gen_sk_timestamp(&t, 50000);
+	cw_gen_sk_render_buffer_internal(gen, 0, &t);
+	cte->expect_op_int(cte, plateau, "<", test_cw_gen_sk_max_abs(gen, 0, 120), 0, "sk edges: tone before key-up edge");
+	cte->expect_op_int(cte, plateau, ">", test_cw_gen_sk_max_abs(gen, 120 + n_slope / 2, 120 + n_slope), 0, "sk edges: falling slope after key-up edge");
+	cte->expect_op_int(cte, 0, "==", test_cw_gen_sk_max_abs(gen, 120 + n_slope, gen->buffer_n_samples), 0, "sk edges: silence after falling slope");
+	cte->expect_op_int(cte, false, "==", cw_gen_sk_is_active_internal(gen), 0, "sk edges: inactive after falling slope");
+	cte->expect_op_int(cte, 0, "==", (int) cw_tq_length_internal(gen->tq), 0, "sk edges: tone queue is empty after key-up");
+
+	cw_gen_delete(&gen);
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
+
+
+
+
+/**
+   Lengths of tones enqueued in symbolic mode are resolved at dequeue
+   time, so a change of speed or gap applies to text that is already
+   in tone queue.
+*/
+int test_cw_gen_symbolic_enqueue(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	for (int symbolic = 0; symbolic <= 1; symbolic++) {
+		cw_gen_t * gen = cw_gen_new(CW_AUDIO_NULL, NULL);
+		cte->assert2(cte, gen, "failed to create generator");
+
+		LIBCW_TEST_FUT(cw_gen_set_symbolic_enqueue)(gen, symbolic);
+		cte->expect_op_int(cte, symbolic, "==", LIBCW_TEST_FUT(cw_gen_get_symbolic_enqueue)(gen), 0, "symbolic enqueue: mode (%d)", symbolic);
+
+		cw_gen_set_speed(gen, 12);
+		cw_gen_set_gap(gen, 0);
+
+		/* 'A': dot, space, dash, space, eoc space. */
+		cte->expect_op_int(cte, CW_SUCCESS, "==", cw_gen_enqueue_character(gen, 'A'), 0, "symbolic enqueue: enqueue (%d)", symbolic);
+		const int dot_len_enqueue = gen->dot_len;
+		const int eoc_len_enqueue = gen->eoc_space_len + gen->additional_space_len;
+
+		/* Change speed and gap while the character is in queue. */
+		cw_gen_set_speed(gen, 24);
+		cw_gen_set_gap(gen, 5);
+		const int dot_len_dequeue = gen->dot_len;
+		const int dash_len_dequeue = gen->dash_len;
+		const int eoc_len_dequeue = gen->eoc_space_len + gen->additional_space_len;
+
+		const int expected_dot = symbolic ? dot_len_dequeue : dot_len_enqueue;
+		const int expected_eoc = symbolic ? eoc_len_dequeue : eoc_len_enqueue;
+		const int expected_dash = symbolic ? dash_len_dequeue : 3 * dot_len_enqueue;
+
+		cw_tone_t tone;
+		int lens[5] = { 0 };
+		int n = 0;
+		while (n < 5 && CW_SUCCESS == cw_tq_dequeue_internal(gen->tq, &tone)) {
+			LIBCW_TEST_FUT(cw_gen_resolve_tone_len_internal)(gen, &tone);
+			lens[n++] = tone.len;
+		}
+		cte->expect_op_int(cte, 5, "==", n, 0, "symbolic enqueue: count of tones (%d)", symbolic);
+		cte->expect_op_int(cte, expected_dot, "==", lens[0], 0, "symbolic enqueue: dot (%d)", symbolic);
+		cte->expect_op_int(cte, expected_dot, "==", lens[1], 0, "symbolic enqueue: eom space (%d)", symbolic);
+		cte->expect_op_int(cte, expected_dash, "==", lens[2], 0, "symbolic enqueue: dash (%d)", symbolic);
+		cte->expect_op_int(cte, expected_eoc, "==", lens[4], 0, "symbolic enqueue: eoc space (%d)", symbolic);
+
+		cw_gen_delete(&gen);
+	}
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
+
+
+
+
+/* Sum lengths of tones in generator's queue by walking the queue. */
+static int64_t test_cw_gen_queued_duration_walk(cw_gen_t * gen)
+{
+	int64_t duration = 0;
+	size_t idx = gen->tq->head;
+	for (size_t i = 0; i < gen->tq->len; i++) {
+		cw_tone_t tone;
+		CW_TONE_COPY(&tone, &gen->tq->queue[idx]);
+		cw_gen_resolve_tone_len_internal(gen, &tone);
+		duration += tone.len;
+		idx = cw_tq_next_index_internal(gen->tq, idx);
+	}
+	return duration;
+}
+
+
+
+
+/**
+   Queued duration maintained by tone queue matches sum of lengths of
+   queued tones after enqueue, backspace, dequeue, change of speed
+   (for symbolic tones) and flush.
+*/
+int test_cw_gen_get_queued_duration(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	for (int symbolic = 0; symbolic <= 1; symbolic++) {
+		cw_gen_t * gen = cw_gen_new(CW_AUDIO_NULL, NULL);
+		cte->assert2(cte, gen, "failed to create generator");
+		cw_gen_set_symbolic_enqueue(gen, symbolic);
+		cw_gen_set_speed(gen, 20);
+		cw_gen_set_gap(gen, 3);
+
+		int64_t duration = LIBCW_TEST_FUT(cw_gen_get_queued_duration)(gen, NULL);
+		cte->expect_op_int(cte, 0, "==", (int) duration, 0, "queued duration: empty queue (%d)", symbolic);
+
+		cw_gen_enqueue_string(gen, "PARIS PARIS");
+		duration = LIBCW_TEST_FUT(cw_gen_get_queued_duration)(gen, NULL);
+		cte->expect_op_int(cte, (int) test_cw_gen_queued_duration_walk(gen), "==", (int) duration, 0, "queued duration: enqueue (%d)", symbolic);
+
+		cw_tq_handle_backspace_internal(gen->tq);
+		duration = LIBCW_TEST_FUT(cw_gen_get_queued_duration)(gen, NULL);
+		cte->expect_op_int(cte, (int) test_cw_gen_queued_duration_walk(gen), "==", (int) duration, 0, "queued duration: backspace (%d)", symbolic);
+
+		cw_tone_t tone;
+		for (int i = 0; i < 7; i++) {
+			cw_tq_dequeue_internal(gen->tq, &tone);
+		}
+		duration = LIBCW_TEST_FUT(cw_gen_get_queued_duration)(gen, NULL);
+		cte->expect_op_int(cte, (int) test_cw_gen_queued_duration_walk(gen), "==", (int) duration, 0, "queued duration: dequeue (%d)", symbolic);
+
+		/* Lengths of symbolic tones follow the speed. */
+		cw_gen_set_speed(gen, 40);
+		int64_t n_samples = 0;
+		duration = LIBCW_TEST_FUT(cw_gen_get_queued_duration)(gen, &n_samples);
+		cte->expect_op_int(cte, (int) test_cw_gen_queued_duration_walk(gen), "==", (int) duration, 0, "queued duration: change of speed (%d)", symbolic);
+		cte->expect_op_int(cte, (int) (duration * gen->sample_rate / CW_USECS_PER_SEC), "==", (int) n_samples, 0, "queued duration: samples (%d)", symbolic);
+
+		cw_tq_flush_internal(gen->tq);
+		duration = LIBCW_TEST_FUT(cw_gen_get_queued_duration)(gen, NULL);
+		cte->expect_op_int(cte, 0, "==", (int) duration, 0, "queued duration: flush (%d)", symbolic);
+
+		cw_gen_delete(&gen);
+	}
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
+
+
+
+
+/**
+   Messages enqueued with cw_gen_enqueue_at() wait in generator in
+   order of their time, and are moved to tone queue preceded by
+   silence that makes them start at their time.
+*/
+int test_cw_gen_enqueue_at(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	cw_gen_t * gen = cw_gen_new(CW_AUDIO_NULL, NULL);
+	cte->assert2(cte, gen, "failed to create generator");
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	/* Invalid arguments. */
+	errno = 0;
+	int cwret = LIBCW_TEST_FUT(cw_gen_enqueue_at)(gen, "PARIS", CLOCK_PROCESS_CPUTIME_ID, &now);
+	cte->expect_op_int(cte, CW_FAILURE, "==", cwret, 0, "enqueue at: invalid clock");
+	cte->expect_op_int(cte, EINVAL, "==", errno, 0, "enqueue at: invalid clock: errno");
+	errno = 0;
+	cwret = LIBCW_TEST_FUT(cw_gen_enqueue_at)(gen, "PARIS%", CLOCK_MONOTONIC, &now);
+	cte->expect_op_int(cte, CW_FAILURE, "==", cwret, 0, "enqueue at: invalid text");
+	cte->expect_op_int(cte, ENOENT, "==", errno, 0, "enqueue at: invalid text: errno");
+
+	/* Far future, near future, past, and two messages with the
+	   same time, enqueued out of order. */
+	struct timespec far = now;
+	far.tv_sec += 10;
+	struct timespec near = now;
+	near.tv_nsec += 100 * 1000 * 1000;
+	if (near.tv_nsec >= CW_NSECS_PER_SEC) {
+		near.tv_sec++;
+		near.tv_nsec -= CW_NSECS_PER_SEC;
+	}
+	struct timespec past = now;
+	past.tv_sec -= 1;
+
+	cte->expect_op_int(cte, CW_SUCCESS, "==", cw_gen_enqueue_at(gen, "F", CLOCK_MONOTONIC, &far), 0, "enqueue at: far");
+	cte->expect_op_int(cte, CW_SUCCESS, "==", cw_gen_enqueue_at(gen, "N", CLOCK_MONOTONIC, &near), 0, "enqueue at: near");
+	cte->expect_op_int(cte, CW_SUCCESS, "==", cw_gen_enqueue_at(gen, "E", CLOCK_MONOTONIC, &past), 0, "enqueue at: past (1)");
+	cte->expect_op_int(cte, CW_SUCCESS, "==", cw_gen_enqueue_at(gen, "T", CLOCK_MONOTONIC, &past), 0, "enqueue at: past (2)");
+	cte->expect_op_int(cte, 4, "==", (int) gen->timed.n_items, 0, "enqueue at: count of waiting messages");
+
+	/* Late message goes to tone queue without leading silence. */
+	bool dispatched = cw_gen_timed_dispatch_internal(gen);
+	cte->expect_op_int(cte, true, "==", dispatched, 0, "dispatch: late message");
+	cw_tone_t tone;
+	cw_tq_dequeue_internal(gen->tq, &tone);
+	cte->expect_op_int(cte, gen->frequency, "==", tone.frequency, 0, "dispatch: late message starts with mark");
+	cte->expect_op_int(cte, gen->dot_len, "==", tone.len, 0, "dispatch: late message is 'E'");
+
+	/* Nothing is dispatched while tone queue is busy. */
+	dispatched = cw_gen_timed_dispatch_internal(gen);
+	cte->expect_op_int(cte, false, "==", dispatched, 0, "dispatch: busy queue");
+
+	/* Message with the same time, enqueued later, goes next. */
+	cw_tq_flush_internal(gen->tq);
+	dispatched = cw_gen_timed_dispatch_internal(gen);
+	cte->expect_op_int(cte, true, "==", dispatched, 0, "dispatch: second late message");
+	cw_tq_dequeue_internal(gen->tq, &tone);
+	cte->expect_op_int(cte, gen->dash_len, "==", tone.len, 0, "dispatch: second late message is 'T'");
+
+	/* Near message is preceded by silence that ends at its time. */
+	cw_tq_flush_internal(gen->tq);
+	dispatched = cw_gen_timed_dispatch_internal(gen);
+	struct timespec after;
+	clock_gettime(CLOCK_MONOTONIC, &after);
+	cte->expect_op_int(cte, true, "==", dispatched, 0, "dispatch: near message");
+	cw_tq_dequeue_internal(gen->tq, &tone);
+	const int64_t expected = ((int64_t) (near.tv_sec - after.tv_sec) * CW_NSECS_PER_SEC + (near.tv_nsec - after.tv_nsec)) / 1000;
+	cte->expect_op_int(cte, 0, "==", tone.frequency, 0, "dispatch: near message starts with silence");
+	cte->expect_between_int(cte, (int) expected - 10000, tone.len, (int) expected + 1000, "dispatch: length of silence");
+
+	/* Far message waits. */
+	cw_tq_flush_internal(gen->tq);
+	dispatched = cw_gen_timed_dispatch_internal(gen);
+	cte->expect_op_int(cte, false, "==", dispatched, 0, "dispatch: far message");
+	cte->expect_op_int(cte, 1, "==", (int) gen->timed.n_items, 0, "dispatch: far message is waiting");
+
+	/* Flush removes waiting messages. */
+	cw_gen_flush_queue(gen);
+	cte->expect_op_int(cte, 0, "==", (int) gen->timed.n_items, 0, "flush: waiting messages");
+
+	cw_gen_delete(&gen);
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
+
+
+
+
+/* Read all edges from schedule of key edges. */
+static int test_cw_gen_key_edges_read(cw_gen_t * gen, cw_key_edge_t * edges, int capacity)
+{
+	int n = 0;
+	while (n < capacity && CW_SUCCESS == cw_gen_get_key_edge(gen, &edges[n])) {
+		n++;
+	}
+	return n;
+}
+
+
+
+
+/* Compare recorded log of key edges with edges derived from tones in
+   generator's queue. Return count of mismatches. */
+static int test_cw_gen_key_edges_compare(cw_gen_t * gen, const cw_key_edge_t * edges, int n_edges)
+{
+	int n_errors = 0;
+	int e = 0;
+	int key_value = -1;
+	int64_t time = edges[0].time;
+	size_t idx = gen->tq->head;
+	for (size_t i = 0; i < gen->tq->len; i++) {
+		cw_tone_t tone;
+		CW_TONE_COPY(&tone, &gen->tq->queue[idx]);
+		cw_gen_resolve_tone_len_internal(gen, &tone);
+		const int value = tone.frequency ? CW_KEY_STATE_CLOSED : CW_KEY_STATE_OPEN;
+		if (value != key_value) {
+			if (e >= n_edges || edges[e].key_value != value || edges[e].time != time) {
+				n_errors++;
+			}
+			e++;
+			key_value = value;
+		}
+		time += (int64_t) tone.len * 1000;
+		idx = cw_tq_next_index_internal(gen->tq, idx);
+	}
+	return n_errors + (e != n_edges);
+}
+
+
+
+
+/**
+   Key edges published when tones are enqueued match tones in tone
+   queue. Flush and backspace supersede previously published edges.
+*/
+int test_cw_gen_key_edges(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	for (int symbolic = 0; symbolic <= 1; symbolic++) {
+		cw_gen_t * gen = cw_gen_new(CW_AUDIO_NULL, NULL);
+		cte->assert2(cte, gen, "failed to create generator");
+		cw_gen_set_symbolic_enqueue(gen, symbolic);
+		cw_gen_set_speed(gen, 30);
+
+		cw_key_edge_t edges[200];
+
+		/* Disabled schedule publishes nothing. */
+		cw_gen_enqueue_string(gen, "E");
+		int n = test_cw_gen_key_edges_read(gen, edges, 200);
+		cte->expect_op_int(cte, 0, "==", n, 0, "key edges: disabled (%d)", symbolic);
+		cw_gen_flush_queue(gen);
+
+		LIBCW_TEST_FUT(cw_gen_enable_key_edges)(gen, true);
+
+		struct timespec before;
+		clock_gettime(CLOCK_MONOTONIC, &before);
+		cw_gen_enqueue_string(gen, "PARIS PARIS");
+		n = test_cw_gen_key_edges_read(gen, edges, 200);
+		cte->expect_op_int(cte, CW_KEY_STATE_CLOSED, "==", edges[0].key_value, 0, "key edges: first edge is key-down (%d)", symbolic);
+		cte->expect_op_int(cte, 1, "==", edges[0].time >= (int64_t) before.tv_sec * CW_NSECS_PER_SEC + before.tv_nsec, 0, "key edges: first edge is not in the past (%d)", symbolic);
+		cte->expect_op_int(cte, 0, "==", test_cw_gen_key_edges_compare(gen, edges, n), 0, "key edges: enqueue (%d)", symbolic);
+
+		/* Backspace: edges of remaining tones are published
+		   again, starting at the same time. */
+		const int64_t start = edges[0].time;
+		cw_gen_enqueue_string(gen, "AB");
+		cw_gen_enqueue_character(gen, '\b');
+		n = test_cw_gen_key_edges_read(gen, edges, 200);
+		cte->expect_op_int(cte, 1, "==", start == edges[0].time, 0, "key edges: backspace: start (%d)", symbolic);
+		cte->expect_op_int(cte, 0, "==", test_cw_gen_key_edges_compare(gen, edges, n), 0, "key edges: backspace (%d)", symbolic);
+
+		/* Flush: single key-up edge, edges enqueued before the
+		   flush are not returned. */
+		cw_gen_enqueue_string(gen, "T");
+		cw_gen_flush_queue(gen);
+		n = test_cw_gen_key_edges_read(gen, edges, 200);
+		cte->expect_op_int(cte, 1, "==", n, 0, "key edges: flush: count (%d)", symbolic);
+		cte->expect_op_int(cte, CW_KEY_STATE_OPEN, "==", edges[0].key_value, 0, "key edges: flush: key-up (%d)", symbolic);
+
+		cte->expect_op_int(cte, 0, "==", (int) LIBCW_TEST_FUT(cw_gen_get_key_edges_dropped)(gen), 0, "key edges: dropped (%d)", symbolic);
+
+		cw_gen_delete(&gen);
+	}
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
+
+
+
+
+/* Compare timeline with tones in generator's queue. Return count of
+   mismatches. */
+static int test_cw_gen_timeline_compare(cw_gen_t * gen, const cw_timeline_t * timeline)
+{
+	cw_timeline_t * expected = cw_timeline_new();
+	size_t idx = gen->tq->head;
+	for (size_t i = 0; i < gen->tq->len; i++) {
+		cw_tone_t tone;
+		CW_TONE_COPY(&tone, &gen->tq->queue[idx]);
+		cw_timeline_append_internal(expected, &tone);
+		idx = cw_tq_next_index_internal(gen->tq, idx);
+	}
+
+	int n_errors = expected->n_entries != timeline->n_entries || expected->duration != timeline->duration;
+	for (size_t i = 0; i < expected->n_entries && i < timeline->n_entries; i++) {
+		if (expected->entries[i].start != timeline->entries[i].start
+		    || expected->entries[i].len != timeline->entries[i].len
+		    || expected->entries[i].key_value != timeline->entries[i].key_value) {
+			n_errors++;
+		}
+	}
+
+	cw_timeline_delete(&expected);
+	return n_errors;
+}
+
+
+
+
+/**
+   Timeline collected for text matches tones that generator enqueues
+   for the text, for various timing parameters. Backspace removes last
+   character from timeline.
+*/
+int test_cw_gen_timeline(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	cw_gen_t * gen = cw_gen_new(CW_AUDIO_NULL, NULL);
+	cte->assert2(cte, gen, "failed to create generator");
+	cw_timeline_t * timeline = LIBCW_TEST_FUT(cw_timeline_new)();
+	cte->assert2(cte, timeline, "failed to create timeline");
+
+	const struct {
+		int speed;
+		int gap;
+		int weighting;
+	} params[] = {
+		{ 12, 0, 50 },
+		{ 25, 5, 30 },
+		{ 60, 2, 70 },
+	};
+
+	for (size_t p = 0; p < sizeof (params) / sizeof (params[0]); p++) {
+		cw_gen_set_speed(gen, params[p].speed);
+		cw_gen_set_gap(gen, params[p].gap);
+		cw_gen_set_weighting(gen, params[p].weighting);
+
+		cw_timeline_clear(timeline);
+		LIBCW_TEST_FUT(cw_gen_set_timeline)(gen, timeline);
+		cw_gen_enqueue_string(gen, "CQ DE SP5 ");
+		cw_gen_enqueue_character_partial(gen, 'A');
+		cw_gen_enqueue_character(gen, 'R');
+		LIBCW_TEST_FUT(cw_gen_set_timeline)(gen, NULL);
+
+		cte->expect_op_int(cte, 0, "==", (int) cw_tq_length_internal(gen->tq), 0, "timeline: nothing in tone queue (%zu)", p);
+
+		cw_gen_enqueue_string(gen, "CQ DE SP5 ");
+		cw_gen_enqueue_character_partial(gen, 'A');
+		cw_gen_enqueue_character(gen, 'R');
+		cte->expect_op_int(cte, 0, "==", test_cw_gen_timeline_compare(gen, timeline), 0, "timeline: matches tone queue (%zu)", p);
+		cte->expect_op_int(cte, CW_KEY_STATE_CLOSED, "==", timeline->entries[0].key_value, 0, "timeline: starts with Mark (%zu)", p);
+		cte->expect_op_int(cte, true, "==", timeline->entries[0].is_first, 0, "timeline: first Mark of character (%zu)", p);
+		cw_tq_flush_internal(gen->tq);
+	}
+
+	/* Backspace. */
+	cw_timeline_clear(timeline);
+	cw_gen_set_timeline(gen, timeline);
+	cw_gen_enqueue_string(gen, "PA");
+	const size_t n_entries = timeline->n_entries;
+	const int64_t duration = timeline->duration;
+	cw_gen_enqueue_string(gen, "RI");
+	cw_gen_enqueue_character_partial(gen, '\b');
+	cw_gen_enqueue_character_partial(gen, '\b');
+	cte->expect_op_int(cte, (int) n_entries, "==", (int) timeline->n_entries, 0, "timeline: backspace: entries");
+	cte->expect_op_int(cte, (int) duration, "==", (int) timeline->duration, 0, "timeline: backspace: duration");
+
+	/* Throughput. */
+	char text[1001];
+	for (int i = 0; i < 1000; i++) {
+		text[i] = "PARIS "[i % 6];
+	}
+	text[1000] = '\0';
+	struct timespec before, after;
+	clock_gettime(CLOCK_MONOTONIC, &before);
+	for (int i = 0; i < 1000; i++) {
+		cw_timeline_clear(timeline);
+		cw_gen_enqueue_string(gen, text);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &after);
+	const double seconds = (after.tv_sec - before.tv_sec) + (after.tv_nsec - before.tv_nsec) / 1e9;
+	cte->log_info(cte, "timeline: %.0f characters per second\n", 1000 * 1000 / seconds);
+
+	cw_gen_set_timeline(gen, NULL);
+	cw_timeline_delete(&timeline);
+	cte->expect_null_pointer(cte, timeline, "timeline: delete");
+	cw_gen_delete(&gen);
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
+
+
+
+
+/* Set up generator rendering samples for external code, in the same
+   way as session scheduler does. */
+static cw_gen_t * test_cw_gen_synthesis_new(int synthesis, int volume, int slope_shape)
+{
+	cw_gen_t * gen = cw_gen_new(CW_AUDIO_NULL, NULL);
+	if (!gen) {
+		return NULL;
+	}
+	gen->sample_rate = 44100;
+	gen->buffer_n_samples = 441;
+	gen->buffer = (cw_sample_t *) malloc(gen->buffer_n_samples * sizeof (cw_sample_t));
+	gen->render.is_external = true;
+	cw_gen_set_synthesis(gen, synthesis);
+	cw_gen_set_volume(gen, volume);
+	cw_gen_set_tone_slope(gen, slope_shape, slope_shape == CW_TONE_SLOPE_SHAPE_RECTANGULAR ? 0 : 5000);
+	cw_gen_set_speed(gen, 30);
+
+	return gen;
+}
+
+
+
+
+/* Render all tones from tone queue of generator, return count of samples. */
+static int64_t test_cw_gen_synthesis_render(cw_gen_t * gen, double * seconds)
+{
+	int64_t n_samples = 0;
+	struct timespec before, after;
+	clock_gettime(CLOCK_MONOTONIC, &before);
+	while (cw_gen_get_queue_length(gen) > 0 || gen->render.has_tone) {
+		cw_gen_render_buffer_internal(gen);
+		n_samples += gen->buffer_n_samples;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &after);
+	*seconds = (after.tv_sec - before.tv_sec) + (after.tv_nsec - before.tv_nsec) / 1e9;
+
+	return n_samples;
+}
+
+
+
+
+/**
+   Fixed-point synthesis produces the same samples as floating-point
+   synthesis, within CW_SYNTHESIS_MAX_ERROR. Speed of both is
+   reported.
+*/
+int test_cw_gen_fixed_point_synthesis(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	const int shapes[] = { CW_TONE_SLOPE_SHAPE_LINEAR, CW_TONE_SLOPE_SHAPE_SINE, CW_TONE_SLOPE_SHAPE_RAISED_COSINE, CW_TONE_SLOPE_SHAPE_RECTANGULAR };
+	const int volumes[] = { 1, 70, 100 };
+	const int frequencies[] = { 100, 700, 3999 };
+
+	for (size_t s = 0; s < sizeof (shapes) / sizeof (shapes[0]); s++) {
+		for (size_t v = 0; v < sizeof (volumes) / sizeof (volumes[0]); v++) {
+			cw_gen_t * floating = test_cw_gen_synthesis_new(CW_SYNTHESIS_FLOATING_POINT, volumes[v], shapes[s]);
+			cw_gen_t * fixed = test_cw_gen_synthesis_new(CW_SYNTHESIS_FIXED_POINT, volumes[v], shapes[s]);
+			cte->assert2(cte, floating && fixed && floating->buffer && fixed->buffer, "failed to create generators");
+			cte->expect_op_int(cte, CW_SYNTHESIS_FIXED_POINT, "==", LIBCW_TEST_FUT(cw_gen_get_synthesis)(fixed), 1, "synthesis");
+
+			/* Tones of different frequencies follow each
+			   other, phase must be continuous in both. */
+			for (size_t f = 0; f < sizeof (frequencies) / sizeof (frequencies[0]); f++) {
+				cw_gen_set_frequency(floating, frequencies[f]);
+				cw_gen_set_frequency(fixed, frequencies[f]);
+				cw_gen_enqueue_string(floating, "PARIS");
+				cw_gen_enqueue_string(fixed, "PARIS");
+			}
+
+			int max_error = 0;
+			int max_sample = 0;
+			while (cw_gen_get_queue_length(floating) > 0 || floating->render.has_tone) {
+				cw_gen_render_buffer_internal(floating);
+				LIBCW_TEST_FUT(cw_gen_render_buffer_internal)(fixed);
+				for (int i = 0; i < floating->buffer_n_samples; i++) {
+					const int error = abs(floating->buffer[i] - fixed->buffer[i]);
+					max_error = error > max_error ? error : max_error;
+					max_sample = abs(fixed->buffer[i]) > max_sample ? abs(fixed->buffer[i]) : max_sample;
+				}
+			}
+			cte->expect_op_int(cte, CW_SYNTHESIS_MAX_ERROR, ">=", max_error, 0, "fixed-point synthesis: max error for slope shape %d, volume %d: %d", shapes[s], volumes[v], max_error);
+			cte->expect_op_int(cte, floating->volume_abs - CW_SYNTHESIS_MAX_ERROR, "<=", max_sample, 0, "fixed-point synthesis: amplitude for slope shape %d, volume %d", shapes[s], volumes[v]);
+
+			cw_gen_delete(&floating);
+			cw_gen_delete(&fixed);
+		}
+	}
+
+	/* Synthesis can't be changed in running generator. */
+	{
+		cw_gen_t * gen = cw_gen_new(CW_AUDIO_NULL, NULL);
+		cte->assert2(cte, gen, "failed to create generator");
+		errno = 0;
+		int cwret = LIBCW_TEST_FUT(cw_gen_set_synthesis)(gen, CW_SYNTHESIS_FIXED_POINT + 1);
+		cte->expect_op_int(cte, true, "==", !cwret && errno == EINVAL, 0, "invalid synthesis");
+		cw_gen_start(gen);
+		errno = 0;
+		cwret = cw_gen_set_synthesis(gen, CW_SYNTHESIS_FIXED_POINT);
+		cte->expect_op_int(cte, true, "==", !cwret && errno == EBUSY, 0, "synthesis of running generator");
+		cw_gen_stop(gen);
+		cw_gen_delete(&gen);
+	}
+
+	/* Benchmark. */
+	{
+		double seconds[2] = { 0.0, 0.0 };
+		int64_t n_samples[2] = { 0, 0 };
+		const int synthesis[2] = { CW_SYNTHESIS_FLOATING_POINT, CW_SYNTHESIS_FIXED_POINT };
+		for (int k = 0; k < 2; k++) {
+			cw_gen_t * gen = test_cw_gen_synthesis_new(synthesis[k], 70, CW_TONE_SLOPE_SHAPE_RAISED_COSINE);
+			cte->assert2(cte, gen && gen->buffer, "failed to create generator");
+			cw_gen_set_speed(gen, CW_SPEED_MIN);
+			cw_gen_enqueue_string(gen, "PARIS PARIS PARIS PARIS");
+			n_samples[k] = test_cw_gen_synthesis_render(gen, &seconds[k]);
+			cw_gen_delete(&gen);
+		}
+		cte->log_info(cte, "synthesis: floating-point: %.1f ns per sample, fixed-point: %.1f ns per sample\n",
+			      seconds[0] * 1e9 / n_samples[0], seconds[1] * 1e9 / n_samples[1]);
+		cte->expect_op_int(cte, (int) n_samples[0], "==", (int) n_samples[1], 0, "synthesis: benchmark: count of samples");
+	}
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
+
+
+
+
+/* Samples written to audio sink by test_cw_gen_synthesis_rate(). */
+static struct {
+	cw_sample_t * samples;
+	int n_samples;
+	int capacity;
+} test_cw_gen_sink;
+
+
+
+
+static int test_cw_gen_sink_write(cw_gen_t * gen)
+{
+	int n_samples = 0;
+	const cw_sample_t * buffer = cw_gen_get_sink_buffer_internal(gen, &n_samples);
+	if (test_cw_gen_sink.n_samples + n_samples > test_cw_gen_sink.capacity) {
+		return CW_FAILURE;
+	}
+	memcpy(test_cw_gen_sink.samples + test_cw_gen_sink.n_samples, buffer, n_samples * sizeof (cw_sample_t));
+	test_cw_gen_sink.n_samples += n_samples;
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/* Render text with generator writing to audio sink with sample rate
+   of 192 kHz, return energy of written samples. */
+static double test_cw_gen_synthesis_rate_render(cw_test_executor_t * cte, int synthesis_rate, double * seconds)
+{
+	cw_gen_t * gen = cw_gen_new(CW_AUDIO_NULL, NULL);
+	cte->assert2(cte, gen, "failed to create generator");
+	gen->sample_rate = 192000;
+	gen->buffer_n_samples = 1920;
+	gen->buffer = (cw_sample_t *) malloc(gen->buffer_n_samples * sizeof (cw_sample_t));
+	cte->assert2(cte, gen->buffer, "failed to allocate buffer");
+	gen->render.is_external = true;
+	gen->write = test_cw_gen_sink_write;
+	cw_gen_set_volume(gen, 70);
+	cw_gen_set_speed(gen, 30);
+	cw_gen_set_tone_slope(gen, CW_TONE_SLOPE_SHAPE_RAISED_COSINE, 5000);
+
+	const int cwret = LIBCW_TEST_FUT(cw_gen_set_synthesis_rate)(gen, synthesis_rate);
+	cte->expect_op_int(cte, CW_SUCCESS, "==", cwret, 0, "synthesis rate: set %d Hz", synthesis_rate);
+	cte->expect_op_int(cte, synthesis_rate ? synthesis_rate : 192000, "==", LIBCW_TEST_FUT(cw_gen_get_synthesis_rate)(gen), 0, "synthesis rate: get");
+	cte->expect_op_int(cte, 192000, "==", cw_gen_get_sink_sample_rate_internal(gen), 0, "synthesis rate: sample rate of audio sink");
+
+	cw_gen_enqueue_string(gen, "PARIS PARIS");
+	test_cw_gen_sink.n_samples = 0;
+
+	struct timespec before, after;
+	clock_gettime(CLOCK_MONOTONIC, &before);
+	while (cw_gen_get_queue_length(gen) > 0 || gen->render.has_tone) {
+		cw_gen_render_buffer_internal(gen);
+		LIBCW_TEST_FUT(cw_gen_write_internal)(gen);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &after);
+	*seconds = (after.tv_sec - before.tv_sec) + (after.tv_nsec - before.tv_nsec) / 1e9;
+
+	cw_gen_delete(&gen);
+
+	double energy = 0.0;
+	for (int i = 0; i < test_cw_gen_sink.n_samples; i++) {
+		energy += (double) test_cw_gen_sink.samples[i] * test_cw_gen_sink.samples[i];
+	}
+	return energy;
+}
+
+
+
+
+/**
+   Generator calculating samples at lower sample rate than sample
+   rate of audio sink writes the same signal to audio sink as
+   generator calculating samples at sample rate of audio sink.
+*/
+int test_cw_gen_synthesis_rate(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	/* Generator without buffer of audio sink. */
+	{
+		cw_gen_t * gen = cw_gen_new(CW_AUDIO_NULL, NULL);
+		cte->assert2(cte, gen, "failed to create generator");
+		errno = 0;
+		const int cwret = LIBCW_TEST_FUT(cw_gen_set_synthesis_rate)(gen, 16000);
+		cte->expect_op_int(cte, true, "==", CW_FAILURE == cwret && EINVAL == errno, 0, "synthesis rate: generator without buffer");
+
+		gen->buffer_n_samples = 480;
+		gen->buffer = (cw_sample_t *) malloc(gen->buffer_n_samples * sizeof (cw_sample_t));
+		gen->write = test_cw_gen_sink_write;
+		errno = 0;
+		const int below = cw_gen_set_synthesis_rate(gen, CW_SYNTHESIS_RATE_MIN - 1);
+		cte->expect_op_int(cte, true, "==", CW_FAILURE == below && EINVAL == errno, 0, "synthesis rate: too low");
+		errno = 0;
+		const int above = cw_gen_set_synthesis_rate(gen, gen->sample_rate + 1);
+		cte->expect_op_int(cte, true, "==", CW_FAILURE == above && EINVAL == errno, 0, "synthesis rate: higher than rate of audio sink");
+		cw_gen_delete(&gen);
+	}
+
+	test_cw_gen_sink.capacity = 192000 * 10;
+	test_cw_gen_sink.samples = (cw_sample_t *) malloc(test_cw_gen_sink.capacity * sizeof (cw_sample_t));
+	cte->assert2(cte, test_cw_gen_sink.samples, "failed to allocate samples");
+
+	double seconds_direct = 0.0;
+	const double energy_direct = test_cw_gen_synthesis_rate_render(cte, 0, &seconds_direct);
+	const int n_direct = test_cw_gen_sink.n_samples;
+
+	double seconds_resampled = 0.0;
+	const double energy_resampled = test_cw_gen_synthesis_rate_render(cte, 16000, &seconds_resampled);
+	const int n_resampled = test_cw_gen_sink.n_samples;
+
+	/* Resampler delays samples, so the last buffer may be missing. */
+	cte->expect_op_int(cte, 1920, ">=", abs(n_direct - n_resampled), 0, "synthesis rate: count of samples: %d / %d", n_direct, n_resampled);
+	cte->expect_op_int(cte, true, "==", fabs(energy_resampled - energy_direct) < energy_direct * 0.02, 0, "synthesis rate: energy of signal");
+
+	cte->log_info(cte, "192000 Hz audio sink: synthesis at 192000 Hz: %.1f ns per sample, at 16000 Hz with resampling: %.1f ns per sample\n",
+		      seconds_direct * 1e9 / n_direct, seconds_resampled * 1e9 / n_resampled);
+
+	free(test_cw_gen_sink.samples);
+	test_cw_gen_sink.samples = NULL;
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
@@ -29,6 +29,14 @@ int test_cw_gen_enqueue_primitives(cw_test_executor_t * cte);
 int test_cw_gen_enqueue_representations(cw_test_executor_t * cte);
 int test_cw_gen_enqueue_character(cw_test_executor_t * cte);
 int test_cw_gen_enqueue_string(cw_test_executor_t * cte);
+int test_cw_gen_sk_edges(cw_test_executor_t * cte);
+int test_cw_gen_symbolic_enqueue(cw_test_executor_t * cte);
+int test_cw_gen_get_queued_duration(cw_test_executor_t * cte);
+int test_cw_gen_enqueue_at(cw_test_executor_t * cte);
+int test_cw_gen_key_edges(cw_test_executor_t * cte);
+int test_cw_gen_timeline(cw_test_executor_t * cte);
+int test_cw_gen_fixed_point_synthesis(cw_test_executor_t * cte);
+int test_cw_gen_synthesis_rate(cw_test_executor_t * cte);
 
 
 
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+ * Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+
+
+
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+
+
+
+#include "test_framework.h"
+
+#include "libcw_pool.h"
+#include "libcw_pool_tests.h"
+#include "libcw_gen.h"
+#include "libcw_rec.h"
+#include "libcw_key.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+int test_cw_pool(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	const size_t alignment = cw_get_storage_alignment();
+	const size_t gen_size = LIBCW_TEST_FUT(cw_gen_get_storage_size)();
+	const size_t rec_size = LIBCW_TEST_FUT(cw_rec_get_storage_size)();
+	const size_t key_size = LIBCW_TEST_FUT(cw_key_get_storage_size)();
+	cte->expect_op_int(cte, true, "==", 0 == gen_size % alignment && 0 == rec_size % alignment && 0 == key_size % alignment, false, "storage sizes are multiples of alignment");
+
+	/* Pool of blocks, each holding objects of one session. */
+	enum { n_sessions = 3 };
+	cw_pool_t * pool = LIBCW_TEST_FUT(cw_pool_new)(gen_size + rec_size + key_size, n_sessions);
+	cte->assert2(cte, pool, "failed to create pool");
+	cte->expect_op_int(cte, (int) (gen_size + rec_size + key_size), "==", (int) cw_pool_get_block_size(pool), false, "block size");
+
+	char * blocks[n_sessions + 1] = { NULL };
+	for (int i = 0; i < n_sessions; i++) {
+		blocks[i] = (char *) LIBCW_TEST_FUT(cw_pool_alloc)(pool);
+		cte->expect_op_int(cte, true, "==", blocks[i] && 0 == (uintptr_t) blocks[i] % alignment, false, "alloc block #%d", i);
+	}
+	cte->expect_op_int(cte, true, "==", blocks[1] == blocks[0] + cw_pool_get_block_size(pool), false, "blocks are adjacent");
+
+	errno = 0;
+	blocks[n_sessions] = (char *) cw_pool_alloc(pool);
+	cte->expect_op_int(cte, true, "==", !blocks[n_sessions] && errno == ENOMEM, false, "alloc from empty pool");
+
+	/* Objects of one session in one block. */
+	{
+		cw_gen_t * gen = LIBCW_TEST_FUT(cw_gen_init)(blocks[0], gen_size, CW_AUDIO_NULL, NULL);
+		cw_rec_t * rec = LIBCW_TEST_FUT(cw_rec_init)(blocks[0] + gen_size, rec_size);
+		cw_key_t * key = LIBCW_TEST_FUT(cw_key_init)(blocks[0] + gen_size + rec_size, key_size);
+		cte->assert2(cte, gen && rec && key, "failed to initialize objects in block");
+		cte->expect_op_int(cte, true, "==", (char *) gen == blocks[0] && (char *) gen->tq > (char *) gen && (char *) gen->tq < (char *) rec, false, "tone queue is in block");
+
+		cw_key_register_generator(key, gen);
+		cw_gen_set_speed(gen, 60);
+		cw_gen_start(gen);
+		cw_gen_enqueue_string(gen, "EE");
+		cw_gen_wait_for_queue_level(gen, 0);
+		cte->expect_op_int(cte, 0, "==", (int) cw_gen_get_queue_length(gen), false, "generator in block plays");
+
+		cw_rec_set_speed(rec, 30);
+		struct timeval timestamp = { 1, 0 };
+		cw_rec_add_mark(rec, &timestamp, CW_DOT_REPRESENTATION);
+		timestamp.tv_sec += 2;
+		char c = '\0';
+		bool is_end_of_word = false;
+		bool is_error = false;
+		const int cwret = cw_rec_poll_character(rec, &timestamp, &c, &is_end_of_word, &is_error);
+		cte->expect_op_int(cte, true, "==", cwret && c == 'E', false, "receiver in block receives");
+
+		cw_gen_stop(gen);
+		LIBCW_TEST_FUT(cw_key_deinit)(key);
+		LIBCW_TEST_FUT(cw_rec_deinit)(rec);
+		LIBCW_TEST_FUT(cw_gen_deinit)(gen);
+		cte->expect_op_int(cte, true, "==", CW_SUCCESS == LIBCW_TEST_FUT(cw_pool_free)(pool, blocks[0]), false, "free block");
+	}
+
+	/* cw_gen_delete() doesn't free storage of generator created in place. */
+	{
+		cw_gen_t * gen = cw_gen_init(blocks[1], gen_size, CW_AUDIO_NULL, NULL);
+		cw_gen_delete(&gen);
+		cte->expect_op_int(cte, true, "==", gen == NULL && CW_SUCCESS == cw_pool_free(pool, blocks[1]), false, "delete generator in block");
+	}
+
+	/* Invalid storages and blocks. */
+	{
+		errno = 0;
+		cw_gen_t * gen = cw_gen_init(blocks[2], gen_size - 1, CW_AUDIO_NULL, NULL);
+		cte->expect_op_int(cte, true, "==", !gen && errno == EINVAL, false, "too small storage");
+
+		errno = 0;
+		cw_rec_t * rec = cw_rec_init(blocks[2] + 1, rec_size);
+		cte->expect_op_int(cte, true, "==", !rec && errno == EINVAL, false, "misaligned storage");
+
+		errno = 0;
+		int cwret = cw_pool_free(pool, blocks[2] + 1);
+		cte->expect_op_int(cte, true, "==", !cwret && errno == EINVAL, false, "free of invalid block");
+
+		cw_pool_free(pool, blocks[2]);
+		cte->expect_op_int(cte, n_sessions, "==", (int) cw_pool_get_n_free(pool), false, "all blocks are free");
+	}
+
+	LIBCW_TEST_FUT(cw_pool_delete)(&pool);
+	cte->expect_op_int(cte, true, "==", pool == NULL, false, "delete pool");
+
+	errno = 0;
+	pool = cw_pool_new(0, n_sessions);
+	cte->expect_op_int(cte, true, "==", !pool && errno == EINVAL, false, "pool with empty blocks");
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
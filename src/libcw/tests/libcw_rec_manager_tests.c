@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+ * Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+
+
+
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+
+
+
+#include "test_framework.h"
+
+#include "libcw_rec.h"
+#include "libcw_rec_manager.h"
+#include "libcw_rec_manager_tests.h"
+#include "libcw_utils.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+enum { TEST_REC_MANAGER_N_RECEIVERS = 2000 };
+enum { TEST_REC_MANAGER_BATCH_SIZE = 512 };
+enum { TEST_REC_MANAGER_TEXT_SIZE = 16 };
+
+/* Text sent to each receiver, as representations of characters. "
+   " is inter-word space. */
+static const char * test_rec_manager_text[] = { ".--.", ".-", ".-.", "..", "...", " ", "-.-.", "--.-" };
+static const char * test_rec_manager_expected = "PARIS CQ ";
+
+
+
+
+typedef struct {
+	char text[TEST_REC_MANAGER_N_RECEIVERS][TEST_REC_MANAGER_TEXT_SIZE];
+	int n_errors;
+} test_rec_manager_received_t;
+
+
+
+
+static void test_cw_rec_manager_callback(void * callback_arg, int receiver, const cw_rec_output_t * output);
+static int test_cw_rec_manager_compare_events(const void * a, const void * b);
+static size_t test_cw_rec_manager_generate(cw_rec_manager_event_t * events, int receiver, int64_t start, int dot_len);
+static void test_cw_rec_manager_set_timestamp(struct timeval * timestamp, int64_t usecs);
+
+
+
+
+void test_cw_rec_manager_callback(void * callback_arg, int receiver, const cw_rec_output_t * output)
+{
+	test_rec_manager_received_t * received = (test_rec_manager_received_t *) callback_arg;
+
+	char * text = received->text[receiver];
+	const size_t len = strlen(text);
+	if (len < TEST_REC_MANAGER_TEXT_SIZE - 1) {
+		text[len] = output->character;
+	}
+	if (output->is_error) {
+		received->n_errors++;
+	}
+
+	return;
+}
+
+
+
+
+int test_cw_rec_manager_compare_events(const void * a, const void * b)
+{
+	const cw_rec_manager_event_t * event_a = (const cw_rec_manager_event_t *) a;
+	const cw_rec_manager_event_t * event_b = (const cw_rec_manager_event_t *) b;
+
+	if (timercmp(&event_a->timestamp, &event_b->timestamp, <)) {
+		return -1;
+	} else if (timercmp(&event_a->timestamp, &event_b->timestamp, >)) {
+		return 1;
+	} else {
+		return event_a->receiver - event_b->receiver;
+	}
+}
+
+
+
+
+void test_cw_rec_manager_set_timestamp(struct timeval * timestamp, int64_t usecs)
+{
+	timestamp->tv_sec = (time_t) (usecs / CW_USECS_PER_SEC);
+	timestamp->tv_usec = (suseconds_t) (usecs % CW_USECS_PER_SEC);
+
+	return;
+}
+
+
+
+
+/* Generate key events of test text sent by one receiver. */
+size_t test_cw_rec_manager_generate(cw_rec_manager_event_t * events, int receiver, int64_t start, int dot_len)
+{
+	size_t n = 0;
+	int64_t t = start;
+
+	for (size_t c = 0; c < sizeof (test_rec_manager_text) / sizeof (test_rec_manager_text[0]); c++) {
+		const char * representation = test_rec_manager_text[c];
+		if (representation[0] == ' ') {
+			/* Inter-character space has been added after
+			   previous character. */
+			t += 4 * dot_len;
+			continue;
+		}
+		for (const char * mark = representation; *mark; mark++) {
+			events[n].receiver = receiver;
+			events[n].key_state = CW_KEY_STATE_CLOSED;
+			test_cw_rec_manager_set_timestamp(&events[n].timestamp, t);
+			n++;
+
+			t += (*mark == CW_DOT_REPRESENTATION ? 1 : 3) * dot_len;
+
+			events[n].receiver = receiver;
+			events[n].key_state = CW_KEY_STATE_OPEN;
+			test_cw_rec_manager_set_timestamp(&events[n].timestamp, t);
+			n++;
+
+			t += dot_len;
+		}
+		t += 2 * dot_len;
+	}
+
+	return n;
+}
+
+
+
+
+/**
+   Receivers of manager, fed with interleaved key events of many
+   senders with different speeds, receive text of each sender.
+*/
+int test_cw_rec_manager(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	errno = 0;
+	cw_rec_manager_t * manager = cw_rec_manager_new(0, test_cw_rec_manager_callback, NULL);
+	cte->expect_op_int(cte, true, "==", !manager && errno == EINVAL, false, "manager without receivers");
+
+
+	test_rec_manager_received_t * received = (test_rec_manager_received_t *) calloc(1, sizeof (test_rec_manager_received_t));
+	manager = cw_rec_manager_new(TEST_REC_MANAGER_N_RECEIVERS, test_cw_rec_manager_callback, received);
+	cte->assert2(cte, manager && received, "failed to create manager");
+
+	errno = 0;
+	cte->expect_op_int(cte, true, "==", NULL == cw_rec_manager_get_receiver(manager, TEST_REC_MANAGER_N_RECEIVERS) && errno == EINVAL, false, "receiver with invalid index");
+
+
+	/* Events of all senders, sorted by time. Senders start at
+	   different times, and send with speeds from CW_SPEED_MIN to
+	   CW_SPEED_MAX, so that deadlines are spread over levels of
+	   timing wheel. */
+	const size_t max_events_per_receiver = 64;
+	cw_rec_manager_event_t * events = (cw_rec_manager_event_t *) malloc(TEST_REC_MANAGER_N_RECEIVERS * max_events_per_receiver * sizeof (cw_rec_manager_event_t));
+	cte->assert2(cte, events, "failed to allocate events");
+	size_t n_events = 0;
+	const int64_t epoch = (int64_t) 1600000000 * CW_USECS_PER_SEC;
+	for (int i = 0; i < TEST_REC_MANAGER_N_RECEIVERS; i++) {
+		const int speed = CW_SPEED_MIN + i % (CW_SPEED_MAX - CW_SPEED_MIN + 1);
+		cw_rec_set_speed(cw_rec_manager_get_receiver(manager, i), speed);
+		const int64_t start = epoch + (int64_t) (i * 7919) % (5 * CW_USECS_PER_SEC);
+		n_events += test_cw_rec_manager_generate(events + n_events, i, start, CW_DOT_CALIBRATION / speed);
+	}
+	qsort(events, n_events, sizeof (cw_rec_manager_event_t), test_cw_rec_manager_compare_events);
+
+
+	/* Events are processed in batches, and after each batch the
+	   time of manager is advanced to time of last event. */
+	struct timespec start;
+	struct timespec stop;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	bool success = true;
+	for (size_t e = 0; e < n_events; e += TEST_REC_MANAGER_BATCH_SIZE) {
+		const size_t n = n_events - e < TEST_REC_MANAGER_BATCH_SIZE ? n_events - e : TEST_REC_MANAGER_BATCH_SIZE;
+		success = success && cw_rec_manager_process(manager, events + e, n);
+		cw_rec_manager_advance(manager, &events[e + n - 1].timestamp);
+	}
+	struct timeval end = events[n_events - 1].timestamp;
+	end.tv_sec += 60;
+	cw_rec_manager_advance(manager, &end);
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+
+	const double elapsed = (stop.tv_sec - start.tv_sec) * 1e9 + (stop.tv_nsec - start.tv_nsec);
+	cte->log_info(cte, "%d receivers, %zu events: %.0f ns per event\n", TEST_REC_MANAGER_N_RECEIVERS, n_events, elapsed / (double) n_events);
+	cte->expect_op_int(cte, true, "==", success, false, "processing events");
+
+	int n_different = 0;
+	for (int i = 0; i < TEST_REC_MANAGER_N_RECEIVERS; i++) {
+		if (strcmp(received->text[i], test_rec_manager_expected)) {
+			if (n_different == 0) {
+				cte->log_info(cte, "receiver %d received '%s'\n", i, received->text[i]);
+			}
+			n_different++;
+		}
+	}
+	cte->expect_op_int(cte, 0, "==", n_different, false, "text received by all receivers");
+	cte->expect_op_int(cte, 0, "==", received->n_errors, false, "characters received without errors");
+	cte->expect_op_int(cte, 0, "==", cw_rec_manager_get_n_pending(manager), false, "no pending receivers");
+
+
+	/* Invalid events are skipped. */
+	{
+		cw_rec_manager_event_t batch[2];
+		batch[0].receiver = -1;
+		batch[0].key_state = CW_KEY_STATE_CLOSED;
+		batch[0].timestamp = end;
+		batch[1].receiver = 0;
+		batch[1].key_state = CW_KEY_STATE_CLOSED;
+		batch[1].timestamp = end;
+		errno = 0;
+		const int cwret = cw_rec_manager_process(manager, batch, 2);
+		cte->expect_op_int(cte, true, "==", !cwret && errno == EINVAL, false, "batch with invalid event");
+		cte->expect_op_int(cte, RS_MARK, "==", cw_rec_manager_get_receiver(manager, 0)->state, false, "valid event of batch with invalid event");
+	}
+
+	cw_rec_manager_delete(&manager);
+	cte->expect_null_pointer(cte, manager, "deleted manager");
+	free(events);
+	free(received);
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+ * Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+
+
+
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+
+
+
+#include "test_framework.h"
+
+#include "libcw_rec.h"
+#include "libcw_rec_output.h"
+#include "libcw_rec_output_tests.h"
+#include "libcw_utils.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+/* Speed of sent characters. Dot is 40 ms long. */
+enum { TEST_REC_OUTPUT_SPEED = 30 };
+enum { TEST_REC_OUTPUT_DOT_LEN = CW_DOT_CALIBRATION / TEST_REC_OUTPUT_SPEED };
+
+enum { TEST_REC_OUTPUT_MAX_ITEMS = 16 };
+
+
+
+
+/* Characters collected by consumer thread. */
+typedef struct {
+	cw_rec_t * rec;
+	char text[TEST_REC_OUTPUT_MAX_ITEMS + 1];
+	int n_items;
+	int n_errors;
+	long max_latency;  /* [us] */
+} test_rec_output_consumer_t;
+
+
+
+
+static void * test_cw_rec_output_consumer(void * arg);
+static void test_cw_rec_output_send(cw_rec_t * rec, const char * representation);
+static long test_cw_rec_output_diff(const struct timeval * earlier, const struct timeval * later);
+
+
+
+
+/* Send character in real time, as a keyer would. */
+void test_cw_rec_output_send(cw_rec_t * rec, const char * representation)
+{
+	for (const char * mark = representation; *mark; mark++) {
+		cw_rec_mark_begin(rec, NULL);
+		usleep(*mark == CW_DOT_REPRESENTATION ? TEST_REC_OUTPUT_DOT_LEN : 3 * TEST_REC_OUTPUT_DOT_LEN);
+		cw_rec_mark_end(rec, NULL);
+		/* Inter-mark space, or first part of inter-character space. */
+		usleep(TEST_REC_OUTPUT_DOT_LEN);
+	}
+	usleep(2 * TEST_REC_OUTPUT_DOT_LEN);
+
+	return;
+}
+
+
+
+
+long test_cw_rec_output_diff(const struct timeval * earlier, const struct timeval * later)
+{
+	return (later->tv_sec - earlier->tv_sec) * CW_USECS_PER_SEC + (later->tv_usec - earlier->tv_usec);
+}
+
+
+
+
+/* Wait for characters until end of word is received. */
+void * test_cw_rec_output_consumer(void * arg)
+{
+	test_rec_output_consumer_t * consumer = (test_rec_output_consumer_t *) arg;
+
+	cw_rec_output_t out;
+	while (consumer->n_items < TEST_REC_OUTPUT_MAX_ITEMS
+	       && cw_rec_wait_output(consumer->rec, &out, 5 * CW_USECS_PER_SEC)) {
+
+		struct timeval now;
+		gettimeofday(&now, NULL);
+
+		/* Character can be recognized when space after last
+		   mark is long enough to be inter-character space,
+		   and inter-word space can be recognized when the
+		   space is too long to be inter-character space. */
+		const long expected = out.is_end_of_word ? consumer->rec->eoc_len_max + 1 : consumer->rec->eoc_len_min;
+		const long latency = test_cw_rec_output_diff(&out.timestamp, &now) - expected;
+		if (latency > consumer->max_latency) {
+			consumer->max_latency = latency;
+		}
+
+		consumer->text[consumer->n_items++] = out.character;
+		if (out.is_error) {
+			consumer->n_errors++;
+		}
+		if (out.is_end_of_word) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+
+
+
+/**
+   Characters sent by one thread are received by other thread as soon
+   as they are recognized.
+*/
+int test_cw_rec_output(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	cw_rec_t * rec = cw_rec_new();
+	cte->assert2(cte, rec, "failed to create receiver");
+	cw_rec_set_speed(rec, TEST_REC_OUTPUT_SPEED);
+
+	cw_rec_output_t out;
+	int cwret = cw_rec_get_output(rec, &out);
+	cte->expect_op_int(cte, true, "==", !cwret && errno == EINVAL && -1 == cw_rec_get_output_fd(rec), false, "queue that isn't running");
+
+	cwret = cw_rec_start_output(rec);
+	cte->expect_op_int(cte, CW_SUCCESS, "==", cwret, false, "start queue");
+	cwret = cw_rec_start_output(rec);
+	cte->expect_op_int(cte, true, "==", !cwret && errno == EALREADY, false, "start running queue");
+
+	cwret = cw_rec_get_output(rec, &out);
+	cte->expect_op_int(cte, true, "==", !cwret && errno == EAGAIN, false, "empty queue");
+	cwret = cw_rec_wait_output(rec, &out, 10000);
+	cte->expect_op_int(cte, true, "==", !cwret && errno == ETIMEDOUT, false, "wait with timeout");
+
+	uint8_t bytes[2048];
+	size_t n_bytes = 0;
+	cwret = cw_rec_snapshot(rec, bytes, sizeof (bytes), &n_bytes);
+	cte->expect_op_int(cte, true, "==", !cwret && errno == EBUSY, false, "snapshot of receiver with running queue");
+
+
+	/* Consumer in other thread. */
+	{
+		test_rec_output_consumer_t consumer = { .rec = rec, .text = { 0 }, .n_items = 0, .n_errors = 0, .max_latency = 0 };
+		pthread_t thread;
+		pthread_create(&thread, NULL, test_cw_rec_output_consumer, &consumer);
+
+		const char * representations[] = { ".--.", ".-", ".-.", "..", "..." };
+		for (size_t i = 0; i < sizeof (representations) / sizeof (representations[0]); i++) {
+			test_cw_rec_output_send(rec, representations[i]);
+		}
+		pthread_join(thread, NULL);
+
+		cte->expect_op_int(cte, 0, "==", strcmp(consumer.text, "PARIS "), false, "received text: '%s'", consumer.text);
+		cte->expect_op_int(cte, 0, "==", consumer.n_errors, false, "received characters without errors");
+		cte->log_info(cte, "largest delay of received character: %ld us\n", consumer.max_latency);
+		cte->expect_op_int(cte, consumer.max_latency, "<", 30000, false, "delay of received characters");
+	}
+
+
+	/* Consumer waiting for descriptor. */
+	{
+		test_cw_rec_output_send(rec, ".");
+
+		struct pollfd pfd = { .fd = cw_rec_get_output_fd(rec), .events = POLLIN, .revents = 0 };
+		int n = poll(&pfd, 1, 1000);
+		cwret = cw_rec_get_output(rec, &out);
+		cte->expect_op_int(cte, true, "==", n == 1 && cwret && out.character == 'E' && !out.is_end_of_word, false, "character from readable descriptor");
+		cte->expect_op_int(cte, true, "==", (int) out.speed == TEST_REC_OUTPUT_SPEED, false, "speed of received character");
+
+		/* Queue is empty until end of word. */
+		cwret = cw_rec_get_output(rec, &out);
+		cte->expect_op_int(cte, true, "==", !cwret && errno == EAGAIN, false, "empty queue after taking character");
+		n = poll(&pfd, 1, 1000);
+		cwret = cw_rec_get_output(rec, &out);
+		cte->expect_op_int(cte, true, "==", n == 1 && cwret && out.character == ' ' && out.is_end_of_word, false, "end of word from readable descriptor");
+		cwret = cw_rec_get_output(rec, &out);
+		n = poll(&pfd, 1, 0);
+		cte->expect_op_int(cte, true, "==", !cwret && errno == EAGAIN && n == 0, false, "descriptor not readable when queue is empty");
+	}
+
+	cte->expect_op_int(cte, 0, "==", (int) cw_rec_get_output_n_dropped(rec), false, "no dropped characters");
+
+	cw_rec_stop_output(rec);
+	cwret = cw_rec_get_output(rec, &out);
+	cte->expect_op_int(cte, true, "==", !cwret && errno == EINVAL, false, "stopped queue");
+
+	/* Receiver can be deleted with running queue. */
+	cwret = cw_rec_start_output(rec);
+	cte->expect_op_int(cte, CW_SUCCESS, "==", cwret, false, "restart queue");
+	cw_rec_delete(&rec);
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
@@ -1552,3 +1552,86 @@ int test_cw_rec_parameter_getters_setters_2(cw_test_executor_t * cte)
 
 	return 0;
 }
+
+
+
+
+static void test_cw_rec_add_usecs(struct timeval * timestamp, int usecs)
+{
+	timestamp->tv_usec += usecs;
+	timestamp->tv_sec += timestamp->tv_usec / CW_USECS_PER_SEC;
+	timestamp->tv_usec %= CW_USECS_PER_SEC;
+}
+
+
+
+
+/* Key marks of one character into receiver, and poll the character
+   after end-of-character space. */
+static char test_cw_rec_adaptive_receive(cw_rec_t * rec, struct timeval * timestamp, const char * representation, int dot_len)
+{
+	for (const char * mark = representation; *mark; mark++) {
+		cw_rec_mark_begin(rec, timestamp);
+		test_cw_rec_add_usecs(timestamp, *mark == CW_DOT_REPRESENTATION ? dot_len : 3 * dot_len);
+		cw_rec_mark_end(rec, timestamp);
+		test_cw_rec_add_usecs(timestamp, dot_len);
+	}
+	test_cw_rec_add_usecs(timestamp, 2 * dot_len);
+
+	char c = '\0';
+	bool is_end_of_word = false;
+	bool is_error = false;
+	if (CW_SUCCESS != cw_rec_poll_character(rec, timestamp, &c, &is_end_of_word, &is_error)) {
+		c = '\0';
+	}
+	cw_rec_reset_state(rec);
+	test_cw_rec_add_usecs(timestamp, 4 * dot_len);
+
+	return c;
+}
+
+
+
+
+/**
+   Averages of lengths of marks after switching to adaptive mode
+
+   When adaptive mode is enabled, averages of lengths of Dots and
+   Dashes must match receiver's current speed, not lengths of marks
+   received before the switch.
+*/
+int test_cw_rec_adaptive_averages(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	cw_rec_t * rec = cw_rec_new();
+	cte->assert2(cte, rec, "failed to create new receiver");
+
+	struct timeval timestamp = { 1, 0 };
+
+	/* Adaptive receiving at 12 WPM. */
+	cw_rec_set_speed(rec, 12);
+	LIBCW_TEST_FUT(cw_rec_enable_adaptive_mode)(rec);
+	const int slow_dot_len = rec->dot_len_ideal;
+	for (int i = 0; i < CW_REC_AVERAGING_ARRAY_LENGTH; i++) {
+		test_cw_rec_adaptive_receive(rec, &timestamp, ".-", slow_dot_len);
+	}
+
+	/* Switch to 30 WPM. */
+	cw_rec_disable_adaptive_mode(rec);
+	cw_rec_set_speed(rec, 30);
+	LIBCW_TEST_FUT(cw_rec_enable_adaptive_mode)(rec);
+	cte->expect_op_int(cte, rec->dot_len_ideal, "==", rec->dot_averaging.average, 0, "average of Dots after switch");
+	cte->expect_op_int(cte, rec->dash_len_ideal, "==", rec->dash_averaging.average, 0, "average of Dashes after switch");
+
+	/* Dash of first character must not be compared with Dashes
+	   received at previous speed. */
+	const char c = test_cw_rec_adaptive_receive(rec, &timestamp, ".-", rec->dot_len_ideal);
+	cte->expect_op_int(cte, 'A', "==", c, 0, "first character after switch");
+
+	cw_rec_delete(&rec);
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
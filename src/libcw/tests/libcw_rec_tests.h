@@ -24,6 +24,7 @@ int test_cw_rec_test_with_varying_speeds(cw_test_executor_t * cte);
 int test_cw_rec_get_receive_parameters(cw_test_executor_t * cte);
 int test_cw_rec_parameter_getters_setters_1(cw_test_executor_t * cte);
 int test_cw_rec_parameter_getters_setters_2(cw_test_executor_t * cte);
+int test_cw_rec_adaptive_averages(cw_test_executor_t * cte);
 
 
 
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+ * Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+
+
+
+
+
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+
+
+#include "test_framework.h"
+
+#include "libcw_resampler.h"
+#include "libcw_resampler_tests.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+/* Convert one second of sine wave (or of constant value, if
+   frequency is zero), and compare output samples with samples of
+   ideal output. Returns count of output samples. */
+static int test_cw_resampler_convert(cw_test_executor_t * cte, int in_rate, int out_rate, int frequency, int * max_error)
+{
+	const int amplitude = 20000;
+
+	/* Output sample m is input signal at time (m * M - (N - 1) / 2) / L
+	   [input samples], where N is length of the filter. */
+	int a = in_rate;
+	int b = out_rate;
+	while (b) {
+		const int r = a % b;
+		a = b;
+		b = r;
+	}
+	const int n_phases = out_rate / a;
+	const int step = in_rate / a;
+	const int n_taps = CW_RESAMPLER_N_TAPS * ((step + n_phases - 1) / n_phases);
+	const double delay = (n_phases * n_taps - 1) / 2.0;
+
+	cw_resampler_t * resampler = LIBCW_TEST_FUT(cw_resampler_new)(in_rate, out_rate);
+	cte->assert2(cte, resampler, "failed to create resampler %d -> %d", in_rate, out_rate);
+
+	cw_sample_t * in = (cw_sample_t *) malloc(in_rate * sizeof (cw_sample_t));
+	cw_sample_t * out = (cw_sample_t *) malloc((out_rate + 1) * sizeof (cw_sample_t));
+	cte->assert2(cte, in && out, "failed to allocate samples");
+	for (int i = 0; i < in_rate; i++) {
+		in[i] = frequency ? lrint(amplitude * sin(2 * M_PI * frequency * i / in_rate)) : amplitude;
+	}
+
+	/* Convert in small chunks, as generator does. */
+	int n_out = 0;
+	for (int i = 0; i < in_rate; ) {
+		int n_in = in_rate - i < 160 ? in_rate - i : 160;
+		n_out += LIBCW_TEST_FUT(cw_resampler_process)(resampler, in + i, &n_in, out + n_out, out_rate + 1 - n_out);
+		i += n_in;
+	}
+
+	/* Skip the samples affected by silence before input. */
+	*max_error = 0;
+	const int first = (int) (2 * delay / step) + 1;
+	const int last = n_out - (int) (2 * delay / step) - 1;
+	for (int m = first; m < last; m++) {
+		const double t = (m * (double) step - delay) / n_phases;
+		const double expected = frequency ? amplitude * sin(2 * M_PI * frequency * t / in_rate) : amplitude;
+		const int error = abs(out[m] - (int) lrint(expected));
+		*max_error = error > *max_error ? error : *max_error;
+	}
+
+	/* Delay reported by resampler is the delay of the ideal
+	   output, in microseconds. */
+	const int expected_delay = (int) (delay / n_phases * 1000000 / in_rate);
+	const int reported_delay = LIBCW_TEST_FUT(cw_resampler_get_delay)(resampler);
+	cte->expect_op_int(cte, 1, ">=", abs(reported_delay - expected_delay), 0, "%d -> %d: delay", in_rate, out_rate);
+
+	free(in);
+	free(out);
+	cw_resampler_delete(&resampler);
+	cte->expect_op_int(cte, true, "==", NULL == resampler, 0, "resampler deleted");
+
+	return n_out;
+}
+
+
+
+
+int test_cw_resampler(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	errno = 0;
+	cw_resampler_t * resampler = LIBCW_TEST_FUT(cw_resampler_new)(0, 48000);
+	cte->expect_op_int(cte, true, "==", NULL == resampler && EINVAL == errno, 0, "invalid input sample rate");
+	errno = 0;
+	resampler = LIBCW_TEST_FUT(cw_resampler_new)(16000, -1);
+	cte->expect_op_int(cte, true, "==", NULL == resampler && EINVAL == errno, 0, "invalid output sample rate");
+	errno = 0;
+	resampler = LIBCW_TEST_FUT(cw_resampler_new)(10007, 48000); /* 10007 is a prime. */
+	cte->expect_op_int(cte, true, "==", NULL == resampler && EINVAL == errno, 0, "too many phases");
+
+	const struct {
+		int in_rate;
+		int out_rate;
+	} rates[] = {
+		{ 16000,  48000 },
+		{ 16000, 192000 },
+		{ 22050,  96000 },
+		{ 44100,  48000 },
+		{ 48000,  16000 },
+	};
+
+	for (size_t i = 0; i < sizeof (rates) / sizeof (rates[0]); i++) {
+		const int in_rate = rates[i].in_rate;
+		const int out_rate = rates[i].out_rate;
+
+		/* Constant input gives constant output. */
+		int max_error = 0;
+		int n_out = test_cw_resampler_convert(cte, in_rate, out_rate, 0, &max_error);
+		cte->expect_op_int(cte, 1, ">=", max_error, 0, "%d -> %d: constant: max error", in_rate, out_rate);
+		cte->expect_op_int(cte, 1, ">=", abs(n_out - out_rate), 0, "%d -> %d: count of samples", in_rate, out_rate);
+
+		/* Tones of Morse code. */
+		const int frequencies[] = { 300, 1000, 4000 };
+		for (size_t f = 0; f < sizeof (frequencies) / sizeof (frequencies[0]); f++) {
+			n_out = test_cw_resampler_convert(cte, in_rate, out_rate, frequencies[f], &max_error);
+			cte->log_info(cte, "%d -> %d: %d Hz: max error %d\n", in_rate, out_rate, frequencies[f], max_error);
+			cte->expect_op_int(cte, 20, ">=", max_error, 0, "%d -> %d: %d Hz: max error", in_rate, out_rate, frequencies[f]);
+		}
+	}
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+ * Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+
+
+
+#include "test_framework.h"
+
+#include "libcw_sched.h"
+#include "libcw_sched_tests.h"
+#include "libcw_gen.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+/* Data collected by write function of a test session. */
+typedef struct {
+	int n_writes;
+	int n_samples;
+	int n_non_zero_samples;  /* Samples that belong to Marks. */
+	int n_bad_sizes;
+	int n_silent_writes;
+	int n_silent_buffers;    /* Written buffers with only zero samples. */
+} test_sched_stream_t;
+
+
+
+
+static int test_sched_write(void * write_arg, const cw_sample_t * samples, int n_samples)
+{
+	test_sched_stream_t * stream = (test_sched_stream_t *) write_arg;
+
+	stream->n_writes++;
+	stream->n_samples += n_samples;
+	if (n_samples != CW_SCHED_BUFFER_N_SAMPLES_DEFAULT) {
+		stream->n_bad_sizes++;
+	}
+	int n_non_zero_samples = 0;
+	for (int i = 0; i < n_samples; i++) {
+		if (samples[i]) {
+			n_non_zero_samples++;
+		}
+	}
+	stream->n_non_zero_samples += n_non_zero_samples;
+	if (0 == n_non_zero_samples) {
+		stream->n_silent_buffers++;
+	}
+
+	return CW_SUCCESS;
+}
+
+
+
+
+static int test_sched_write_silence(void * write_arg, int n_samples)
+{
+	test_sched_stream_t * stream = (test_sched_stream_t *) write_arg;
+
+	stream->n_silent_writes++;
+	stream->n_samples += n_samples;
+
+	return CW_SUCCESS;
+}
+
+
+
+
+/**
+   Test creating and deleting scheduler, adding and removing sessions
+*/
+int test_cw_sched_new_delete(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	cw_sched_t * sched = LIBCW_TEST_FUT(cw_sched_new)(0, 0, 0);
+	cte->expect_null_pointer(cte, sched, "new: zero workers");
+
+	sched = LIBCW_TEST_FUT(cw_sched_new)(4, 0, 0);
+	cte->expect_valid_pointer(cte, sched, "new: four workers");
+	cte->assert2(cte, sched, "failed to create scheduler");
+
+	test_sched_stream_t stream = { 0 };
+	cw_gen_t * gens[10] = { NULL };
+	for (int i = 0; i < 10; i++) {
+		gens[i] = LIBCW_TEST_FUT(cw_sched_add_session)(sched, test_sched_write, &stream);
+		cte->expect_valid_pointer_errors_only(cte, gens[i], "add session #%d", i);
+	}
+	cte->expect_op_int(cte, 10, "==", LIBCW_TEST_FUT(cw_sched_get_n_sessions)(sched), false, "count of sessions after adding");
+
+	/* Generator driven by scheduler can't have its own thread. */
+	cte->expect_op_int(cte, CW_FAILURE, "==", cw_gen_start(gens[3]), false, "starting session's generator");
+
+	int cwret = LIBCW_TEST_FUT(cw_sched_remove_session)(sched, &gens[3]);
+	cte->expect_op_int(cte, CW_SUCCESS, "==", cwret, false, "remove session");
+	cte->expect_null_pointer(cte, gens[3], "removed session's generator");
+	cte->expect_op_int(cte, 9, "==", cw_sched_get_n_sessions(sched), false, "count of sessions after removing");
+
+	cwret = LIBCW_TEST_FUT(cw_sched_tick)(sched);
+	cte->expect_op_int(cte, CW_SUCCESS, "==", cwret, false, "tick");
+	cte->expect_op_int(cte, 9, "==", stream.n_writes, false, "count of writes in one tick");
+
+	/* Remaining sessions are deleted together with scheduler. */
+	LIBCW_TEST_FUT(cw_sched_delete)(&sched);
+	cte->expect_null_pointer(cte, sched, "delete");
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
+
+
+
+
+/**
+   Render many sessions with different parameters, check that every
+   session has received all samples of its Marks
+*/
+int test_cw_sched_sessions(cw_test_executor_t * cte)
+{
+	const int n_sessions = 200;
+	const int n_workers = 4;
+
+	cte->print_test_header(cte, "%s (%d sessions, %d workers)", __func__, n_sessions, n_workers);
+
+	cw_sched_t * sched = cw_sched_new(n_workers, 0, 0);
+	cte->assert2(cte, sched, "failed to create scheduler");
+
+	test_sched_stream_t * streams = (test_sched_stream_t *) calloc(n_sessions, sizeof (test_sched_stream_t));
+	cte->assert2(cte, streams, "failed to allocate streams");
+
+	cw_gen_t ** gens = (cw_gen_t **) calloc(n_sessions, sizeof (cw_gen_t *));
+	cte->assert2(cte, gens, "failed to allocate generators");
+
+	for (int i = 0; i < n_sessions; i++) {
+		gens[i] = cw_sched_add_session(sched, test_sched_write, &streams[i]);
+		cte->assert2(cte, gens[i], "failed to add session #%d", i);
+
+		/* Every session has its own parameters. */
+		cw_gen_set_speed(gens[i], CW_SPEED_MIN + (i % (CW_SPEED_MAX - CW_SPEED_MIN + 1)));
+		cw_gen_set_frequency(gens[i], 300 + 10 * (i % 50));
+		cw_gen_enqueue_string(gens[i], (i % 2) ? "E" : "T");
+	}
+
+	/* Tick until all tone queues are drained. */
+	int n_ticks = 0;
+	bool tick_failure = false;
+	bool any_busy = true;
+	while (any_busy && n_ticks < 100000) {
+		if (CW_SUCCESS != LIBCW_TEST_FUT(cw_sched_tick)(sched)) {
+			tick_failure = true;
+		}
+		n_ticks++;
+
+		any_busy = false;
+		for (int i = 0; i < n_sessions; i++) {
+			if (cw_gen_get_queue_length(gens[i]) || gens[i]->render.has_tone) {
+				any_busy = true;
+				break;
+			}
+		}
+	}
+	cte->expect_op_int(cte, false, "==", tick_failure, false, "ticks (%d)", n_ticks);
+	cte->expect_op_int(cte, false, "==", any_busy, false, "all queues drained");
+
+
+	bool writes_failure = false;
+	bool sizes_failure = false;
+	bool marks_failure = false;
+	for (int i = 0; i < n_sessions; i++) {
+		if (!cte->expect_op_int(cte, n_ticks, "==", streams[i].n_writes, true, "count of writes for session #%d", i)) {
+			writes_failure = true;
+		}
+		if (!cte->expect_op_int(cte, 0, "==", streams[i].n_bad_sizes, true, "sizes of buffers for session #%d", i)) {
+			sizes_failure = true;
+		}
+
+		/* Mark of the session, in samples. Samples at the
+		   edges of slopes may be equal to zero. */
+		int dot_len = 0, dash_len = 0;
+		cw_gen_get_timing_parameters_internal(gens[i], &dot_len, &dash_len, NULL, NULL, NULL, NULL, NULL);
+		const int mark_len = (i % 2) ? dot_len : dash_len;
+		const int expected = (int) ((int64_t) mark_len * CW_SCHED_SAMPLE_RATE_DEFAULT / 1000000);
+		if (!cte->expect_between_int_errors_only(cte, expected * 3 / 4, streams[i].n_non_zero_samples, expected, "samples of Mark for session #%d", i)) {
+			marks_failure = true;
+		}
+	}
+	cte->expect_op_int(cte, false, "==", writes_failure, false, "count of writes");
+	cte->expect_op_int(cte, false, "==", sizes_failure, false, "sizes of buffers");
+	cte->expect_op_int(cte, false, "==", marks_failure, false, "samples of Marks");
+
+	cw_sched_delete(&sched);
+	free(gens);
+	free(streams);
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
+
+
+
+
+/**
+   Silence of session is passed to function receiving silence, and
+   only silence is passed there
+*/
+int test_cw_sched_silence(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	cw_sched_t * sched = cw_sched_new(1, 0, 0);
+	cte->assert2(cte, sched, "failed to create scheduler");
+
+	/* Two identical sessions, one of them with silence passed
+	   separately. */
+	test_sched_stream_t streams[2] = { { 0 }, { 0 } };
+	cw_gen_t * gens[2] = { NULL, NULL };
+	for (int i = 0; i < 2; i++) {
+		gens[i] = cw_sched_add_session(sched, test_sched_write, &streams[i]);
+		cte->assert2(cte, gens[i], "failed to add session #%d", i);
+		cw_gen_set_speed(gens[i], 20);
+		cw_gen_enqueue_string(gens[i], "PARIS PARIS");
+	}
+	int cwret = LIBCW_TEST_FUT(cw_sched_set_write_silence)(sched, gens[1], test_sched_write_silence);
+	cte->expect_op_int(cte, CW_SUCCESS, "==", cwret, 0, "set write silence");
+
+	cw_gen_t * other = cw_gen_new(CW_AUDIO_NULL, NULL);
+	errno = 0;
+	cwret = LIBCW_TEST_FUT(cw_sched_set_write_silence)(sched, other, test_sched_write_silence);
+	cte->expect_op_int(cte, true, "==", CW_FAILURE == cwret && EINVAL == errno, 0, "set write silence for generator of other scheduler");
+	cw_gen_delete(&other);
+
+	int n_ticks = 0;
+	while ((cw_gen_get_queue_length(gens[0]) || gens[0]->render.has_tone) && n_ticks < 100000) {
+		cw_sched_tick(sched);
+		n_ticks++;
+	}
+
+	cte->expect_op_int(cte, streams[0].n_samples, "==", streams[1].n_samples, 0, "count of samples");
+	cte->expect_op_int(cte, streams[0].n_non_zero_samples, "==", streams[1].n_non_zero_samples, 0, "count of non-zero samples");
+	cte->expect_op_int(cte, 0, "==", streams[1].n_silent_buffers, 0, "no silent buffers passed to write function");
+	/* Buffers with both Mark and silence may have zero samples at
+	   the edges of slopes. */
+	cte->expect_op_int(cte, streams[0].n_silent_buffers, ">=", streams[1].n_silent_writes, 0, "silent writes are silent");
+	cte->expect_op_int(cte, true, "==", streams[1].n_silent_writes * 2 >= n_ticks, 0, "at least a half of writes is silence");
+	cte->log_info(cte, "%d of %d buffers passed as silence\n", streams[1].n_silent_writes, n_ticks);
+
+	cw_sched_delete(&sched);
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
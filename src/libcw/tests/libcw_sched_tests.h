@@ -0,0 +1,24 @@
+/*
+  This file is a part of unixcw project.  unixcw project is covered by
+  GNU General Public License, version 2 or later.
+*/
+
+#ifndef _LIBCW_SCHED_TESTS_H_
+#define _LIBCW_SCHED_TESTS_H_
+
+
+
+
+#include "test_framework.h"
+
+
+
+
+int test_cw_sched_new_delete(cw_test_executor_t * cte);
+int test_cw_sched_sessions(cw_test_executor_t * cte);
+int test_cw_sched_silence(cw_test_executor_t * cte);
+
+
+
+
+#endif /* #ifndef _LIBCW_SCHED_TESTS_H_ */
@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+ * Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+
+
+
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+
+
+
+#include "test_framework.h"
+
+#include "libcw_shm_tq.h"
+#include "libcw_shm_tq_tests.h"
+#include "libcw_gen.h"
+#include "libcw_tq.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+static cw_gen_t * test_cw_shm_tq_gen_new(void);
+
+
+
+
+/* Generator without audio sink, whose tone queue isn't dequeued. */
+cw_gen_t * test_cw_shm_tq_gen_new(void)
+{
+	cw_gen_t * gen = cw_gen_new(CW_AUDIO_NULL, NULL);
+	if (!gen) {
+		return NULL;
+	}
+	gen->sample_rate = 44100;
+	gen->buffer_n_samples = 441;
+	gen->buffer = (cw_sample_t *) malloc(gen->buffer_n_samples * sizeof (cw_sample_t));
+	gen->render.is_external = true;
+	cw_gen_set_tone_slope(gen, CW_TONE_SLOPE_SHAPE_RAISED_COSINE, 5000);
+	cw_gen_set_speed(gen, 24);
+
+	return gen;
+}
+
+
+
+
+/**
+   Tones and characters put into shared queue by other process end
+   up in tone queue of generator.
+*/
+int test_cw_shm_tq(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	/* Producer in other process. */
+	{
+		cw_shm_tq_t * queue = cw_shm_tq_new(64);
+		cw_gen_t * gen = test_cw_shm_tq_gen_new();
+		cw_gen_t * reference = test_cw_shm_tq_gen_new();
+		cte->assert2(cte, queue && gen && reference, "failed to create queue and generators");
+
+		/* Generator getting the same items directly. */
+		cw_gen_enqueue_string(reference, "PARIS");
+		cw_tone_t tone;
+		CW_TONE_INIT(&tone, 700, 30000, CW_SLOPE_MODE_STANDARD_SLOPES);
+		cw_tq_enqueue_internal(reference->tq, &tone);
+		const size_t expected_len = cw_gen_get_queue_length(reference);
+
+		const pid_t pid = fork();
+		if (pid == 0) {
+			/* The child gets the descriptor by fork(); other
+			   processes would get it over Unix socket. */
+			cw_shm_tq_t * producer = cw_shm_tq_attach(cw_shm_tq_get_fd(queue));
+			int ok = producer
+				&& CW_SUCCESS == cw_shm_tq_enqueue_string(producer, "PARIS")
+				&& CW_SUCCESS == cw_shm_tq_enqueue_tone(producer, 30000, 700);
+			cw_shm_tq_delete(&producer);
+			_exit(ok ? 0 : 1);
+		}
+		int status = -1;
+		waitpid(pid, &status, 0);
+		cte->expect_op_int(cte, true, "==", WIFEXITED(status) && 0 == WEXITSTATUS(status), false, "enqueue in other process");
+		cte->expect_op_int(cte, 6, "==", (int) cw_shm_tq_get_length(queue), false, "length of shared queue");
+
+		struct timeval start;
+		struct timeval now;
+		gettimeofday(&start, NULL);
+		int cwret = cw_shm_tq_forward(queue, gen);
+		cte->expect_op_int(cte, CW_SUCCESS, "==", cwret, false, "start forwarding");
+		long elapsed = 0;
+		while (cw_gen_get_queue_length(gen) < expected_len && elapsed < 1000000) {
+			usleep(10);
+			gettimeofday(&now, NULL);
+			elapsed = (now.tv_sec - start.tv_sec) * 1000000 + (now.tv_usec - start.tv_usec);
+		}
+		gettimeofday(&now, NULL);
+		elapsed = (now.tv_sec - start.tv_sec) * 1000000 + (now.tv_usec - start.tv_usec);
+		cte->expect_op_int(cte, (int) expected_len, "==", (int) cw_gen_get_queue_length(gen), false, "items forwarded to generator");
+		cte->log_info(cte, "%zu tones forwarded in %ld us\n", expected_len, elapsed);
+
+		/* Items put while consumer waits for them. */
+		cw_gen_flush_queue(gen);
+		cw_gen_flush_queue(reference);
+		cw_gen_enqueue_string(reference, "E");
+		cwret = cw_shm_tq_enqueue_string(queue, "E");
+		elapsed = 0;
+		gettimeofday(&start, NULL);
+		while (cw_gen_get_queue_length(gen) < cw_gen_get_queue_length(reference) && elapsed < 1000000) {
+			usleep(10);
+			gettimeofday(&now, NULL);
+			elapsed = (now.tv_sec - start.tv_sec) * 1000000 + (now.tv_usec - start.tv_usec);
+		}
+		gettimeofday(&now, NULL);
+		elapsed = (now.tv_sec - start.tv_sec) * 1000000 + (now.tv_usec - start.tv_usec);
+		cte->expect_op_int(cte, true, "==", cwret && cw_gen_get_queue_length(gen) == cw_gen_get_queue_length(reference), false, "items forwarded to waiting consumer");
+		cte->log_info(cte, "wakeup of consumer: %ld us\n", elapsed);
+
+		cwret = cw_shm_tq_forward(queue, reference);
+		cte->expect_op_int(cte, true, "==", !cwret && errno == EBUSY, false, "forwarding to second generator");
+
+		/* Generator stops forwarding when it is deleted. */
+		cw_gen_delete(&gen);
+		cte->expect_op_int(cte, CW_SUCCESS, "==", cw_shm_tq_forward(queue, reference), false, "forwarding to other generator");
+		cw_shm_tq_forward(queue, NULL);
+		cw_gen_delete(&reference);
+		cw_shm_tq_delete(&queue);
+	}
+
+	/* Producer without consumer. */
+	{
+		cw_shm_tq_t * queue = cw_shm_tq_new(4);
+		cte->assert2(cte, queue, "failed to create queue");
+
+		int cwret = cw_shm_tq_enqueue_string(queue, "PARI");
+		cte->expect_op_int(cte, CW_SUCCESS, "==", cwret, false, "filling queue");
+		cwret = cw_shm_tq_enqueue_tone(queue, 1000, 500);
+		cte->expect_op_int(cte, true, "==", !cwret && errno == EAGAIN, false, "enqueue in full queue");
+
+		cw_shm_tq_delete(&queue);
+		queue = cw_shm_tq_new(4);
+		cwret = cw_shm_tq_enqueue_string(queue, "PARIS");
+		cte->expect_op_int(cte, true, "==", !cwret && errno == EAGAIN && 0 == cw_shm_tq_get_length(queue), false, "string longer than queue");
+		cwret = cw_shm_tq_enqueue_string(queue, "P%R");
+		cte->expect_op_int(cte, true, "==", !cwret && errno == ENOENT, false, "invalid string");
+		cwret = cw_shm_tq_enqueue_tone(queue, 1000, CW_FREQUENCY_MAX + 1);
+		cte->expect_op_int(cte, true, "==", !cwret && errno == EINVAL, false, "invalid tone");
+		cw_shm_tq_delete(&queue);
+	}
+
+	/* Invalid arguments. */
+	{
+		errno = 0;
+		cw_shm_tq_t * queue = cw_shm_tq_new(100);
+		cte->expect_op_int(cte, true, "==", !queue && errno == EINVAL, false, "capacity that isn't power of two");
+
+		/* Descriptor of file that isn't a shared queue. */
+		char path[] = "/tmp/libcw_shm_tq_test_XXXXXX";
+		const int fd = mkstemp(path);
+		unlink(path);
+		char garbage[512] = { 0 };
+		cte->expect_op_int(cte, (int) sizeof (garbage), "==", (int) write(fd, garbage, sizeof (garbage)), false, "writing to file");
+		errno = 0;
+		queue = cw_shm_tq_attach(fd);
+		cte->expect_op_int(cte, true, "==", !queue && errno == EINVAL, false, "attaching file that isn't a queue");
+		close(fd);
+	}
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
@@ -0,0 +1,22 @@
+/*
+  This file is a part of unixcw project.  unixcw project is covered by
+  GNU General Public License, version 2 or later.
+*/
+
+#ifndef _LIBCW_SHM_TQ_TESTS_H_
+#define _LIBCW_SHM_TQ_TESTS_H_
+
+
+
+
+#include "test_framework.h"
+
+
+
+
+int test_cw_shm_tq(cw_test_executor_t * cte);
+
+
+
+
+#endif /* #ifndef _LIBCW_SHM_TQ_TESTS_H_ */
@@ -0,0 +1,377 @@
+/*
+ * Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+ * Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+
+
+
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+
+
+
+#include "test_framework.h"
+
+#include "libcw_snapshot.h"
+#include "libcw_snapshot_tests.h"
+#include "libcw_gen.h"
+#include "libcw_rec.h"
+#include "libcw_tq.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+static cw_gen_t * test_cw_snapshot_gen_new(int synthesis, int speed, int frequency);
+static void test_cw_snapshot_rec_send(cw_rec_t * rec, struct timeval * timestamp, const char * marks);
+static char test_cw_snapshot_rec_poll(cw_rec_t * rec, struct timeval * timestamp);
+static void test_cw_snapshot_advance(struct timeval * timestamp, int usecs);
+
+
+
+
+/* Generator without audio sink, driven by test code. */
+cw_gen_t * test_cw_snapshot_gen_new(int synthesis, int speed, int frequency)
+{
+	cw_gen_t * gen = cw_gen_new(CW_AUDIO_NULL, NULL);
+	if (!gen) {
+		return NULL;
+	}
+	gen->sample_rate = 44100;
+	gen->buffer_n_samples = 441;
+	gen->buffer = (cw_sample_t *) malloc(gen->buffer_n_samples * sizeof (cw_sample_t));
+	gen->render.is_external = true;
+	cw_gen_set_synthesis(gen, synthesis);
+	cw_gen_set_tone_slope(gen, CW_TONE_SLOPE_SHAPE_RAISED_COSINE, 5000);
+	cw_gen_set_speed(gen, speed);
+	cw_gen_set_frequency(gen, frequency);
+
+	return gen;
+}
+
+
+
+
+/**
+   Generator restored from snapshot continues with the same samples
+   as the snapshotted generator.
+*/
+int test_cw_gen_snapshot(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	const int synthesis[] = { CW_SYNTHESIS_FLOATING_POINT, CW_SYNTHESIS_FIXED_POINT };
+	for (size_t k = 0; k < sizeof (synthesis) / sizeof (synthesis[0]); k++) {
+
+		cw_gen_t * original = test_cw_snapshot_gen_new(synthesis[k], 24, 650);
+		/* Parameters of this generator will be overwritten. */
+		cw_gen_t * restored = test_cw_snapshot_gen_new(CW_SYNTHESIS_FLOATING_POINT, 12, 300);
+		cte->assert2(cte, original && restored && original->buffer && restored->buffer, "failed to create generators");
+
+		cw_gen_set_volume(original, 60);
+		cw_gen_set_symbolic_enqueue(original, true);
+		cw_gen_enqueue_string(original, "PARIS CQ");
+		cw_gen_set_frequency(original, 800);
+		cw_gen_enqueue_string(original, "DE");
+
+		/* Stop in the middle of a tone. */
+		for (int i = 0; i < 23; i++) {
+			cw_gen_render_buffer_internal(original);
+		}
+		cte->expect_op_int(cte, true, "==", original->render.has_tone && original->render.tone.sample_iterator > 0, false, "snapshot in the middle of a tone");
+
+		/* Size of snapshot. */
+		size_t n_bytes = 0;
+		errno = 0;
+		int cwret = LIBCW_TEST_FUT(cw_gen_snapshot)(original, NULL, 0, &n_bytes);
+		cte->expect_op_int(cte, true, "==", !cwret && errno == ENOSPC && n_bytes > 0, false, "size of snapshot");
+
+		uint8_t * bytes = (uint8_t *) malloc(n_bytes);
+		size_t n = 0;
+		struct timespec before, after;
+		clock_gettime(CLOCK_MONOTONIC, &before);
+		cwret = LIBCW_TEST_FUT(cw_gen_snapshot)(original, bytes, n_bytes, &n);
+		const int restore_cwret = LIBCW_TEST_FUT(cw_gen_restore)(restored, bytes, n);
+		clock_gettime(CLOCK_MONOTONIC, &after);
+		cte->expect_op_int(cte, true, "==", cwret && restore_cwret && n == n_bytes, false, "snapshot and restore, synthesis %d", synthesis[k]);
+		cte->log_info(cte, "snapshot of generator with %d queued tones: %d bytes, snapshot and restore: %.1f us\n",
+			      (int) cw_gen_get_queue_length(original), (int) n,
+			      ((after.tv_sec - before.tv_sec) * 1e9 + (after.tv_nsec - before.tv_nsec)) / 1e3);
+
+		cte->expect_op_int(cte, true, "==",
+				   cw_gen_get_speed(restored) == 24
+				   && cw_gen_get_frequency(restored) == 800
+				   && cw_gen_get_volume(restored) == 60
+				   && cw_gen_get_synthesis(restored) == synthesis[k]
+				   && cw_gen_get_symbolic_enqueue(restored)
+				   && cw_gen_get_queue_length(restored) == cw_gen_get_queue_length(original),
+				   false, "parameters of restored generator");
+
+		/* Both generators produce the same samples till the end. */
+		int n_buffers = 0;
+		int n_different = 0;
+		while (cw_gen_get_queue_length(original) > 0 || original->render.has_tone) {
+			cw_gen_render_buffer_internal(original);
+			cw_gen_render_buffer_internal(restored);
+			n_buffers++;
+			if (memcmp(original->buffer, restored->buffer, original->buffer_n_samples * sizeof (cw_sample_t))) {
+				n_different++;
+			}
+		}
+		cte->expect_op_int(cte, 0, "==", n_different, false, "samples of restored generator, synthesis %d (%d buffers)", synthesis[k], n_buffers);
+		cte->expect_op_int(cte, true, "==", 0 == cw_gen_get_queue_length(restored) && !restored->render.has_tone, false, "restored generator is drained");
+
+		/* Invalid snapshots don't modify generator. */
+		{
+			errno = 0;
+			cwret = LIBCW_TEST_FUT(cw_gen_restore)(restored, bytes, n - 1);
+			cte->expect_op_int(cte, true, "==", !cwret && errno == EINVAL, false, "truncated snapshot");
+
+			bytes[3] = CW_SNAPSHOT_VERSION + 1;
+			errno = 0;
+			cwret = cw_gen_restore(restored, bytes, n);
+			cte->expect_op_int(cte, true, "==", !cwret && errno == EINVAL, false, "snapshot of unknown version");
+			bytes[3] = CW_SNAPSHOT_VERSION;
+
+			cw_gen_t * other_rate = test_cw_snapshot_gen_new(synthesis[k], 24, 650);
+			other_rate->sample_rate = 48000;
+			errno = 0;
+			cwret = cw_gen_restore(other_rate, bytes, n);
+			cte->expect_op_int(cte, true, "==", !cwret && errno == EINVAL, false, "snapshot of other sample rate");
+			cw_gen_delete(&other_rate);
+
+			/* Well-formed snapshot with slopes of tone being
+			   rendered that don't fit the table of slope
+			   amplitudes, or the tone. */
+			cw_gen_t * corrupted = test_cw_snapshot_gen_new(synthesis[k], 12, 300);
+			cw_gen_enqueue_string(corrupted, "T");
+			cw_gen_render_buffer_internal(corrupted);
+			const cw_tone_t tone = corrupted->render.tone;
+			const int n_amplitudes = corrupted->tone_slope.n_amplitudes;
+			/* Rising slope, falling slope, samples count of tone. */
+			const int64_t slopes[][3] = {
+				{ INT_MAX,                     tone.falling_slope_n_samples, tone.n_samples },
+				{ tone.rising_slope_n_samples, n_amplitudes + 1,             tone.n_samples },
+				{ n_amplitudes,                n_amplitudes,                 2 * n_amplitudes - 1 }
+			};
+			for (size_t s = 0; s < sizeof (slopes) / sizeof (slopes[0]); s++) {
+				corrupted->render.tone = tone;
+				corrupted->render.tone.rising_slope_n_samples = (int) slopes[s][0];
+				corrupted->render.tone.falling_slope_n_samples = (int) slopes[s][1];
+				corrupted->render.tone.n_samples = slopes[s][2];
+				corrupted->render.tone.sample_iterator = 0;
+				uint8_t corrupted_bytes[512];
+				size_t corrupted_n = 0;
+				cw_gen_snapshot(corrupted, corrupted_bytes, sizeof (corrupted_bytes), &corrupted_n);
+				errno = 0;
+				cwret = cw_gen_restore(restored, corrupted_bytes, corrupted_n);
+				cte->expect_op_int(cte, true, "==", !cwret && errno == EINVAL, false, "snapshot with invalid slopes, case %zu", s);
+			}
+			cw_gen_delete(&corrupted);
+
+			cte->expect_op_int(cte, true, "==", cw_gen_get_speed(restored) == 24 && 0 == cw_gen_get_queue_length(restored), false, "generator not modified by invalid snapshots");
+		}
+
+		free(bytes);
+		cw_gen_delete(&original);
+		cw_gen_delete(&restored);
+	}
+
+	/* Generator with running thread. */
+	{
+		cw_gen_t * gen = cw_gen_new(CW_AUDIO_NULL, NULL);
+		cte->assert2(cte, gen, "failed to create generator");
+		cw_gen_start(gen);
+		uint8_t bytes[256];
+		size_t n = 0;
+		errno = 0;
+		int cwret = LIBCW_TEST_FUT(cw_gen_snapshot)(gen, bytes, sizeof (bytes), &n);
+		cte->expect_op_int(cte, true, "==", !cwret && errno == EBUSY, false, "snapshot of running generator");
+		cw_gen_stop(gen);
+
+		cwret = cw_gen_snapshot(gen, bytes, sizeof (bytes), &n);
+		cte->expect_op_int(cte, true, "==", cwret && CW_SUCCESS == cw_gen_restore(gen, bytes, n), false, "snapshot of stopped generator");
+
+		cw_rec_t * rec = cw_rec_new();
+		uint8_t rec_bytes[2048];
+		cw_rec_snapshot(rec, rec_bytes, sizeof (rec_bytes), &n);
+		errno = 0;
+		cwret = cw_gen_restore(gen, rec_bytes, n);
+		cte->expect_op_int(cte, true, "==", !cwret && errno == EINVAL, false, "snapshot of receiver restored into generator");
+		cw_rec_delete(&rec);
+		cw_gen_delete(&gen);
+	}
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
+
+
+
+
+void test_cw_snapshot_advance(struct timeval * timestamp, int usecs)
+{
+	timestamp->tv_usec += usecs;
+	timestamp->tv_sec += timestamp->tv_usec / 1000000;
+	timestamp->tv_usec %= 1000000;
+
+	return;
+}
+
+
+
+
+/* Send marks to receiver, with lengths that vary a bit, as if
+   keyed by hand at ~20 WPM. */
+void test_cw_snapshot_rec_send(cw_rec_t * rec, struct timeval * timestamp, const char * marks)
+{
+	const int dot_len = 60000;
+	for (const char * m = marks; *m; m++) {
+		const int jitter = (int) ((timestamp->tv_usec / 1000) % 11) - 5; /* [%] */
+		const int len = (*m == CW_DOT_REPRESENTATION ? dot_len : 3 * dot_len) * (100 + jitter) / 100;
+
+		cw_rec_mark_begin(rec, timestamp);
+		test_cw_snapshot_advance(timestamp, len);
+		cw_rec_mark_end(rec, timestamp);
+		test_cw_snapshot_advance(timestamp, dot_len);
+	}
+
+	return;
+}
+
+
+
+
+/* Poll character after inter-character space. */
+char test_cw_snapshot_rec_poll(cw_rec_t * rec, struct timeval * timestamp)
+{
+	test_cw_snapshot_advance(timestamp, 2 * 60000);
+
+	char c = '\0';
+	bool is_end_of_word = false;
+	bool is_error = false;
+	if (CW_SUCCESS != cw_rec_poll_character(rec, timestamp, &c, &is_end_of_word, &is_error)) {
+		return '?';
+	}
+
+	return c;
+}
+
+
+
+
+/**
+   Receiver restored from snapshot taken in the middle of a character
+   receives the same characters as the snapshotted receiver.
+*/
+int test_cw_rec_snapshot(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	cw_rec_t * original = cw_rec_new();
+	cw_rec_t * restored = cw_rec_new();
+	cte->assert2(cte, original && restored, "failed to create receivers");
+
+	cw_rec_set_speed(original, 20);
+	cw_rec_enable_adaptive_mode(original);
+
+	const char * characters[] = { ".--.", ".-", ".-.", "..", "..." }; /* PARIS */
+	char received[8] = { 0 };
+	struct timeval timestamp = { 1000, 0 };
+
+	for (int i = 0; i < 2; i++) {
+		test_cw_snapshot_rec_send(original, &timestamp, characters[i]);
+		received[i] = test_cw_snapshot_rec_poll(original, &timestamp);
+	}
+	/* Stop in the middle of a character. */
+	test_cw_snapshot_rec_send(original, &timestamp, ".-");
+
+	size_t n_bytes = 0;
+	errno = 0;
+	int cwret = LIBCW_TEST_FUT(cw_rec_snapshot)(original, NULL, 0, &n_bytes);
+	cte->expect_op_int(cte, true, "==", !cwret && errno == ENOSPC && n_bytes > 0, false, "size of snapshot");
+
+	uint8_t * bytes = (uint8_t *) malloc(n_bytes);
+	size_t n = 0;
+	cwret = LIBCW_TEST_FUT(cw_rec_snapshot)(original, bytes, n_bytes, &n);
+	const int restore_cwret = LIBCW_TEST_FUT(cw_rec_restore)(restored, bytes, n);
+	cte->expect_op_int(cte, true, "==", cwret && restore_cwret && n == n_bytes, false, "snapshot and restore (%d bytes)", (int) n);
+	cte->expect_op_int(cte, true, "==",
+			   0 == memcmp(&restored->speed, &original->speed, sizeof (original->speed))
+			   && cw_rec_get_adaptive_mode(restored)
+			   && 0 == memcmp(restored->statistics, original->statistics, sizeof (original->statistics)),
+			   false, "parameters of restored receiver");
+
+	/* Both receivers get the same marks. */
+	char received_restored[8] = { 0 };
+	struct timeval timestamp_restored = timestamp;
+	test_cw_snapshot_rec_send(original, &timestamp, ".");
+	test_cw_snapshot_rec_send(restored, &timestamp_restored, ".");
+	received[2] = test_cw_snapshot_rec_poll(original, &timestamp);
+	received_restored[0] = test_cw_snapshot_rec_poll(restored, &timestamp_restored);
+	for (int i = 3; i < 5; i++) {
+		test_cw_snapshot_rec_send(original, &timestamp, characters[i]);
+		test_cw_snapshot_rec_send(restored, &timestamp_restored, characters[i]);
+		received[i] = test_cw_snapshot_rec_poll(original, &timestamp);
+		received_restored[i - 2] = test_cw_snapshot_rec_poll(restored, &timestamp_restored);
+	}
+
+	cte->expect_op_int(cte, true, "==", 0 == strcmp(received, "PARIS"), false, "original receiver: \"%s\"", received);
+	cte->expect_op_int(cte, true, "==", 0 == strcmp(received_restored, "RIS"), false, "restored receiver: \"%s\"", received_restored);
+	cte->expect_op_int(cte, true, "==",
+			   0 == memcmp(&restored->speed, &original->speed, sizeof (original->speed))
+			   && 0 == memcmp(&restored->dot_averaging, &original->dot_averaging, sizeof (original->dot_averaging))
+			   && 0 == memcmp(&restored->dash_averaging, &original->dash_averaging, sizeof (original->dash_averaging)),
+			   false, "adaptation of restored receiver");
+
+	/* Invalid snapshots don't modify receiver. */
+	{
+		const cw_rec_t before = *restored;
+
+		errno = 0;
+		cwret = LIBCW_TEST_FUT(cw_rec_restore)(restored, bytes, n - 1);
+		cte->expect_op_int(cte, true, "==", !cwret && errno == EINVAL, false, "truncated snapshot");
+
+		bytes[4] = CW_SNAPSHOT_KIND_GENERATOR;
+		errno = 0;
+		cwret = cw_rec_restore(restored, bytes, n);
+		cte->expect_op_int(cte, true, "==", !cwret && errno == EINVAL, false, "snapshot of other kind");
+
+		cte->expect_op_int(cte, true, "==", 0 == memcmp(&before, restored, sizeof (before)), false, "receiver not modified by invalid snapshots");
+	}
+
+	free(bytes);
+	cw_rec_delete(&original);
+	cw_rec_delete(&restored);
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
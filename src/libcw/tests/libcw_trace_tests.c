@@ -0,0 +1,413 @@
+/*
+ * Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+ * Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+
+
+
+#include "test_framework.h"
+
+#include "libcw_trace.h"
+#include "libcw_trace_tests.h"
+#include "libcw_data.h"
+#include "libcw_key.h"
+#include "libcw_rec.h"
+#include "libcw_gen.h"
+#include "libcw_utils.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+#define TEST_TRACE_EVENTS_MAX 1000
+
+
+
+
+/* Events of perfectly timed keying of a text. */
+typedef struct {
+	cw_trace_event_t events[TEST_TRACE_EVENTS_MAX];
+	int n_events;
+} test_trace_keying_t;
+
+
+/* Text decoded by replayer. */
+typedef struct {
+	char text[100];
+	size_t len;
+	int n_errors;
+} test_trace_text_t;
+
+
+
+
+static void test_trace_timestamp_add(struct timeval * timestamp, int usecs);
+static void test_trace_key_text(test_trace_keying_t * keying, struct timeval * timestamp, int speed, const char * text);
+static void test_trace_character_callback(void * callback_arg, const struct timeval * timestamp, char c, bool is_end_of_word, bool is_error);
+
+
+
+
+void test_trace_timestamp_add(struct timeval * timestamp, int usecs)
+{
+	timestamp->tv_usec += usecs;
+	timestamp->tv_sec += timestamp->tv_usec / CW_USECS_PER_SEC;
+	timestamp->tv_usec %= CW_USECS_PER_SEC;
+}
+
+
+
+
+/* Append to \p keying events of keying \p text at \p speed,
+   starting at \p timestamp. On return \p timestamp is time after
+   inter-word space that follows the text. */
+void test_trace_key_text(test_trace_keying_t * keying, struct timeval * timestamp, int speed, const char * text)
+{
+	const int unit = CW_DOT_CALIBRATION / speed;
+
+	for (const char * c = text; *c; c++) {
+		if (*c == ' ') {
+			/* Inter-character space is already there. */
+			test_trace_timestamp_add(timestamp, 4 * unit);
+			continue;
+		}
+
+		const char * representation = cw_character_to_representation_internal(*c);
+		for (const char * r = representation; *r; r++) {
+			cw_trace_event_t * event = &keying->events[keying->n_events++];
+			event->timestamp = *timestamp;
+			event->key_state = CW_KEY_STATE_CLOSED;
+			test_trace_timestamp_add(timestamp, (*r == CW_DOT_REPRESENTATION ? 1 : 3) * unit);
+
+			event = &keying->events[keying->n_events++];
+			event->timestamp = *timestamp;
+			event->key_state = CW_KEY_STATE_OPEN;
+			test_trace_timestamp_add(timestamp, unit);
+		}
+		test_trace_timestamp_add(timestamp, 2 * unit);
+	}
+	test_trace_timestamp_add(timestamp, 4 * unit);
+
+	return;
+}
+
+
+
+
+void test_trace_character_callback(void * callback_arg, __attribute__((unused)) const struct timeval * timestamp, char c, bool is_end_of_word, bool is_error)
+{
+	test_trace_text_t * text = (test_trace_text_t *) callback_arg;
+	if (text->len + 2 >= sizeof (text->text)) {
+		return;
+	}
+
+	text->text[text->len++] = c;
+	if (is_end_of_word) {
+		text->text[text->len++] = ' ';
+	}
+	text->text[text->len] = '\0';
+	if (is_error) {
+		text->n_errors++;
+	}
+}
+
+
+
+
+/**
+   Record events to trace (directly and through keying callback of a
+   key), and read them back
+*/
+int test_cw_trace_record_read(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	test_trace_keying_t * keying = (test_trace_keying_t *) calloc(1, sizeof (test_trace_keying_t));
+	cte->assert2(cte, keying, "failed to allocate keying");
+
+	cw_trace_header_t header1 = { .speed = 20, .tolerance = 50, .gap = 0, .weighting = 50, .frequency = 600, .is_adaptive = false, .start = { 1000, 500000 } };
+	cw_trace_header_t header2 = { .speed = 30, .tolerance = 40, .gap = 2, .weighting = 55, .frequency = 750, .is_adaptive = true, .start = { 2000, 0 } };
+
+	struct timeval t = header1.start;
+	test_trace_timestamp_add(&t, 100000);
+	test_trace_key_text(keying, &t, header1.speed, "PARIS");
+	const int n_events_session1 = keying->n_events;
+
+	t = header2.start;
+	test_trace_key_text(keying, &t, header2.speed, "CQ DE SP5");
+
+
+	FILE * file = tmpfile();
+	cte->assert2(cte, file, "failed to create temporary file");
+
+	cw_trace_recorder_t * recorder = LIBCW_TEST_FUT(cw_trace_recorder_new)(file, &header1);
+	cte->expect_valid_pointer(cte, recorder, "recorder new");
+	cte->assert2(cte, recorder, "failed to create recorder");
+
+	bool add_failure = false;
+	for (int i = 0; i < keying->n_events; i++) {
+		if (i == n_events_session1) {
+			if (CW_SUCCESS != LIBCW_TEST_FUT(cw_trace_recorder_start_session)(recorder, &header2)) {
+				add_failure = true;
+				break;
+			}
+		}
+		if (CW_SUCCESS != LIBCW_TEST_FUT(cw_trace_recorder_add_event)(recorder, &keying->events[i].timestamp, keying->events[i].key_state)) {
+			add_failure = true;
+			break;
+		}
+	}
+	cte->expect_op_int(cte, false, "==", add_failure, false, "adding events");
+
+	/* Event with timestamp earlier than previous event is recorded
+	   with timestamp of previous event. */
+	struct timeval earlier = keying->events[keying->n_events - 1].timestamp;
+	earlier.tv_sec -= 10;
+	cw_trace_recorder_add_event(recorder, &earlier, CW_KEY_STATE_CLOSED);
+
+	cte->expect_op_int(cte, CW_SUCCESS, "==", LIBCW_TEST_FUT(cw_trace_recorder_flush)(recorder), false, "recorder flush");
+	LIBCW_TEST_FUT(cw_trace_recorder_delete)(&recorder);
+	cte->expect_null_pointer(cte, recorder, "recorder delete");
+
+	const long file_size = ftell(file);
+	cte->log_info(cte, "%d events recorded in %ld bytes\n", keying->n_events + 1, file_size);
+	cte->expect_op_int(cte, true, "==", file_size <= 3 * (keying->n_events + 1) + 2 * 30, false, "size of trace");
+
+
+	rewind(file);
+	cw_trace_reader_t * reader = LIBCW_TEST_FUT(cw_trace_reader_new)(file);
+	cte->expect_valid_pointer(cte, reader, "reader new");
+	cte->assert2(cte, reader, "failed to create reader");
+
+	bool read_failure = false;
+	bool event_failure = false;
+	bool session_failure = false;
+	cw_trace_event_t event;
+	cw_trace_header_t header;
+	for (int i = 0; i < keying->n_events; i++) {
+		if (CW_SUCCESS != LIBCW_TEST_FUT(cw_trace_reader_next)(reader, &event)) {
+			read_failure = true;
+			break;
+		}
+		if (event.key_state != keying->events[i].key_state
+		    || event.timestamp.tv_sec != keying->events[i].timestamp.tv_sec
+		    || event.timestamp.tv_usec != keying->events[i].timestamp.tv_usec) {
+			event_failure = true;
+			break;
+		}
+
+		const cw_trace_header_t * expected = i < n_events_session1 ? &header1 : &header2;
+		LIBCW_TEST_FUT(cw_trace_reader_get_header)(reader, &header);
+		if (event.session != (i < n_events_session1 ? 1 : 2)
+		    || header.speed != expected->speed
+		    || header.tolerance != expected->tolerance
+		    || header.gap != expected->gap
+		    || header.weighting != expected->weighting
+		    || header.frequency != expected->frequency
+		    || header.is_adaptive != expected->is_adaptive
+		    || header.start.tv_sec != expected->start.tv_sec
+		    || header.start.tv_usec != expected->start.tv_usec) {
+			session_failure = true;
+			break;
+		}
+	}
+	cte->expect_op_int(cte, false, "==", read_failure, false, "reading events");
+	cte->expect_op_int(cte, false, "==", event_failure, false, "read events vs. recorded events");
+	cte->expect_op_int(cte, false, "==", session_failure, false, "sessions of read events");
+
+	cw_trace_reader_next(reader, &event);
+	const struct timeval * last = &keying->events[keying->n_events - 1].timestamp;
+	cte->expect_op_int(cte, true, "==", event.timestamp.tv_sec == last->tv_sec && event.timestamp.tv_usec == last->tv_usec, false, "timestamp of event recorded out of order");
+
+	const int cwret = cw_trace_reader_next(reader, &event);
+	cte->expect_op_int(cte, true, "==", CW_FAILURE == cwret && ENOENT == errno, false, "end of trace");
+
+	LIBCW_TEST_FUT(cw_trace_reader_delete)(&reader);
+	cte->expect_null_pointer(cte, reader, "reader delete");
+	fclose(file);
+
+
+	/* Recorder registered as keying callback of a key. */
+	{
+		file = tmpfile();
+		cte->assert2(cte, file, "failed to create temporary file");
+		recorder = cw_trace_recorder_new(file, &header1);
+		cte->assert2(cte, recorder, "failed to create recorder");
+
+		cw_gen_t * gen = cw_gen_new(CW_AUDIO_NULL, NULL);
+		cw_key_t * key = cw_key_new();
+		cw_key_register_generator(key, gen);
+		cw_key_register_keying_callback(key, LIBCW_TEST_FUT(cw_trace_recorder_keying_callback), recorder);
+
+		const int n = 6;
+		for (int i = 0; i < n; i++) {
+			cw_key_sk_notify_event(key, i % 2 ? CW_KEY_STATE_OPEN : CW_KEY_STATE_CLOSED);
+		}
+		cw_key_register_keying_callback(key, NULL, NULL);
+		cte->expect_op_int(cte, n, "==", (int) recorder->n_events, false, "count of events recorded through keying callback");
+		cw_trace_recorder_delete(&recorder);
+
+		rewind(file);
+		reader = cw_trace_reader_new(file);
+		int n_read = 0;
+		bool state_failure = false;
+		while (CW_SUCCESS == cw_trace_reader_next(reader, &event)) {
+			if (event.key_state != (n_read % 2 ? CW_KEY_STATE_OPEN : CW_KEY_STATE_CLOSED)) {
+				state_failure = true;
+			}
+			n_read++;
+		}
+		cte->expect_op_int(cte, n, "==", n_read, false, "count of events read from trace recorded through keying callback");
+		cte->expect_op_int(cte, false, "==", state_failure, false, "states of events recorded through keying callback");
+		cw_trace_reader_delete(&reader);
+
+		cw_key_delete(&key);
+		cw_gen_delete(&gen);
+		fclose(file);
+	}
+
+
+	/* Malformed traces. */
+	{
+		/* Valid header followed by: overlong encoding of zero
+		   (never written by recorder), and varint that is
+		   longer than any 64-bit value. */
+#define TRACE_HEADER "\0CWT\x01\x0c\x32\x00\x32\x20\x00\x00\x00"
+		const char * traces[] = { "PARIS", "\0CWX", TRACE_HEADER "\x80\x00", TRACE_HEADER "\x80\x80\x80\x80\x80\x80\x80\x80\x80\x80\x01" };
+		const size_t sizes[] = { 5, 4, 13 + 2, 13 + 11 };
+#undef TRACE_HEADER
+		for (int i = 0; i < 4; i++) {
+			file = tmpfile();
+			fwrite(traces[i], 1, sizes[i], file);
+			rewind(file);
+			reader = cw_trace_reader_new(file);
+			const int rv = cw_trace_reader_next(reader, &event);
+			cte->expect_op_int(cte, true, "==", CW_FAILURE == rv && EINVAL == errno, false, "reading malformed trace #%d", i);
+			cw_trace_reader_delete(&reader);
+			fclose(file);
+		}
+	}
+
+	free(keying);
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
+
+
+
+
+/**
+   Replay recorded keying into a receiver
+*/
+int test_cw_trace_replay(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	test_trace_keying_t * keying = (test_trace_keying_t *) calloc(1, sizeof (test_trace_keying_t));
+	cte->assert2(cte, keying, "failed to allocate keying");
+
+	cw_trace_header_t header1 = { .speed = 20, .tolerance = 50, .gap = 0, .weighting = 50, .frequency = 600, .is_adaptive = false, .start = { 1000, 0 } };
+	cw_trace_header_t header2 = { .speed = 12, .tolerance = 50, .gap = 0, .weighting = 50, .frequency = 600, .is_adaptive = false, .start = { 3000, 0 } };
+
+	struct timeval t = header1.start;
+	test_trace_key_text(keying, &t, header1.speed, "PARIS MORSE CODE");
+	const int n_events_session1 = keying->n_events;
+	t = header2.start;
+	test_trace_key_text(keying, &t, header2.speed, "73");
+
+	FILE * file = tmpfile();
+	cte->assert2(cte, file, "failed to create temporary file");
+	cw_trace_recorder_t * recorder = cw_trace_recorder_new(file, &header1);
+	cte->assert2(cte, recorder, "failed to create recorder");
+	for (int i = 0; i < keying->n_events; i++) {
+		if (i == n_events_session1) {
+			cw_trace_recorder_start_session(recorder, &header2);
+		}
+		cw_trace_recorder_add_event(recorder, &keying->events[i].timestamp, keying->events[i].key_state);
+	}
+	cw_trace_recorder_delete(&recorder);
+
+
+	/* Receiver starts with speed that doesn't match any of the
+	   sessions: replayer must use speeds from headers. */
+	cw_rec_t * rec = cw_rec_new();
+	cte->assert2(cte, rec, "failed to create receiver");
+	cw_rec_set_speed(rec, 40);
+
+	rewind(file);
+	cw_trace_reader_t * reader = cw_trace_reader_new(file);
+	test_trace_text_t text = { .len = 0, .n_errors = 0 };
+	int cwret = LIBCW_TEST_FUT(cw_trace_replay)(reader, rec, NULL, 0.0, test_trace_character_callback, &text);
+	cte->expect_op_int(cte, CW_SUCCESS, "==", cwret, false, "replay without pacing");
+	cte->log_info(cte, "replayed text: '%s'\n", text.text);
+	cte->expect_op_int(cte, 0, "==", strcmp("PARIS MORSE CODE 73 ", text.text), false, "replayed text");
+	cte->expect_op_int(cte, 0, "==", text.n_errors, false, "errors in replayed text");
+	cw_trace_reader_delete(&reader);
+
+
+	/* Accelerated replay: trace of "73" at 12 WPM lasts about two
+	   seconds. */
+	{
+		rewind(file);
+		reader = cw_trace_reader_new(file);
+		/* Skip first session. */
+		cw_trace_event_t event;
+		for (int i = 0; i < n_events_session1; i++) {
+			cw_trace_reader_next(reader, &event);
+		}
+		text.len = 0;
+		text.text[0] = '\0';
+
+		const double speedup = 20.0;
+		struct timeval begin, end;
+		gettimeofday(&begin, NULL);
+		cwret = LIBCW_TEST_FUT(cw_trace_replay)(reader, rec, NULL, speedup, test_trace_character_callback, &text);
+		gettimeofday(&end, NULL);
+
+		const int trace_len = cw_timestamp_compare_internal(&keying->events[n_events_session1].timestamp, &keying->events[keying->n_events - 1].timestamp);
+		const int replay_len = cw_timestamp_compare_internal(&begin, &end);
+		cte->log_info(cte, "trace of %d us replayed in %d us\n", trace_len, replay_len);
+		cte->expect_op_int(cte, CW_SUCCESS, "==", cwret, false, "accelerated replay");
+		cte->expect_op_int(cte, true, "==", replay_len >= trace_len / speedup && replay_len < trace_len, false, "duration of accelerated replay");
+		cte->expect_op_int(cte, 0, "==", strcmp("73 ", text.text), false, "text of accelerated replay");
+		cw_trace_reader_delete(&reader);
+	}
+
+	cte->expect_op_int(cte, CW_FAILURE, "==", cw_trace_replay(NULL, rec, NULL, 0.0, NULL, NULL), false, "replay with NULL reader");
+
+	cw_rec_delete(&rec);
+	fclose(file);
+	free(keying);
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2001-2006  Simon Baldwin (simon_baldwin@yahoo.com)
+ * Copyright (C) 2011-2019  Kamil Ignacak (acerion@wp.pl)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+
+
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+
+
+
+#include "test_framework.h"
+
+#include "libcw_transcode.h"
+#include "libcw_transcode_tests.h"
+#include "libcw_utils.h"
+#include "libcw.h"
+#include "libcw2.h"
+
+
+
+
+static size_t test_transcode_string(cw_transcoder_t * tr, const char * input, size_t chunk_size, char * output);
+
+
+
+
+/**
+   Transcode whole \p input, passing it to transcoder in chunks of
+   \p chunk_size bytes. Output is terminated with NUL.
+*/
+size_t test_transcode_string(cw_transcoder_t * tr, const char * input, size_t chunk_size, char * output)
+{
+	size_t len = strlen(input);
+	size_t n = 0;
+	for (size_t i = 0; i < len; i += chunk_size) {
+		size_t size = len - i < chunk_size ? len - i : chunk_size;
+		n += cw_transcoder_process(tr, input + i, size, output + n);
+	}
+	n += cw_transcoder_finish(tr, output + n);
+	output[n] = '\0';
+
+	return n;
+}
+
+
+
+
+int test_cw_transcoder(cw_test_executor_t * cte)
+{
+	cte->print_test_header(cte, __func__);
+
+	char output[256];
+	int64_t n_characters = 0;
+	int64_t n_errors = 0;
+
+	/* Default separators. */
+	{
+		cw_transcoder_t * encoder = LIBCW_TEST_FUT(cw_transcoder_new)(CW_TRANSCODE_ENCODE, NULL, NULL);
+		cw_transcoder_t * decoder = LIBCW_TEST_FUT(cw_transcoder_new)(CW_TRANSCODE_DECODE, NULL, NULL);
+		cte->assert2(cte, encoder && decoder, "failed to create transcoders");
+
+		LIBCW_TEST_FUT(cw_transcoder_process)(encoder, "", 0, output);
+		test_transcode_string(encoder, "  paris  is\tok \nSOS\n", 1000, output);
+		cte->expect_op_int(cte, 0, "==", strcmp(".--. .- .-. .. ... / .. ... / --- -.-\n... --- ...\n", output), false, "encode: '%s'", output);
+
+		test_transcode_string(decoder, ".--. .- .-. .. ... / .. ... / --- -.-\n... --- ...\n", 1000, output);
+		cte->expect_op_int(cte, 0, "==", strcmp("PARIS IS OK\nSOS\n", output), false, "decode: '%s'", output);
+
+		/* Representation and separator split between chunks. */
+		test_transcode_string(decoder, ".--. .- .-. .. ... / .. ...", 1, output);
+		cte->expect_op_int(cte, 0, "==", strcmp("PARIS IS", output), false, "decode in one-byte chunks: '%s'", output);
+
+		/* Invalid input is skipped and counted. */
+		test_transcode_string(encoder, "A\x01" "B", 1000, output);
+		cte->expect_op_int(cte, 0, "==", strcmp(".- -...", output), false, "encode invalid character: '%s'", output);
+		LIBCW_TEST_FUT(cw_transcoder_get_counts)(encoder, &n_characters, &n_errors);
+		cte->expect_op_int(cte, 1, "==", (int) n_errors, false, "encoder errors");
+
+		test_transcode_string(decoder, ".- ........ x -...", 1000, output);
+		cte->expect_op_int(cte, 0, "==", strcmp("AB", output), false, "decode invalid representation: '%s'", output);
+		cw_transcoder_get_counts(decoder, &n_characters, &n_errors);
+		cte->expect_op_int(cte, 2, "==", (int) n_errors, false, "decoder errors");
+
+		LIBCW_TEST_FUT(cw_transcoder_delete)(&encoder);
+		cte->expect_null_pointer(cte, encoder, "transcoder delete");
+		cw_transcoder_delete(&decoder);
+	}
+
+	/* Custom separators. */
+	{
+		cw_transcoder_t * encoder = cw_transcoder_new(CW_TRANSCODE_ENCODE, "|", "||");
+		cw_transcoder_t * decoder = cw_transcoder_new(CW_TRANSCODE_DECODE, "|", "||");
+		cte->assert2(cte, encoder && decoder, "failed to create transcoders");
+
+		test_transcode_string(encoder, "CQ DE", 1000, output);
+		cte->expect_op_int(cte, 0, "==", strcmp("-.-.|--.-||-..|.", output), false, "encode with custom separators: '%s'", output);
+		test_transcode_string(decoder, output, 3, output + 128);
+		cte->expect_op_int(cte, 0, "==", strcmp("CQ DE", output + 128), false, "decode with custom separators: '%s'", output + 128);
+
+		cw_transcoder_delete(&encoder);
+		cw_transcoder_delete(&decoder);
+
+		/* Word separator that can't be told from character separator. */
+		cte->expect_null_pointer(cte, cw_transcoder_new(CW_TRANSCODE_DECODE, "  ", " "), "new with ambiguous separators");
+		cte->expect_null_pointer(cte, cw_transcoder_new(CW_TRANSCODE_DECODE, " ", "-"), "new with Dash in separator");
+		cte->expect_null_pointer(cte, cw_transcoder_new(5, NULL, NULL), "new with invalid direction");
+	}
+
+	/* Round trip of large text. */
+	{
+		const size_t size = 16 * 1024 * 1024;
+		char * text = (char *) malloc(size + 1);
+		cte->assert2(cte, text, "failed to allocate text");
+		const char * words[] = { "PARIS ", "CQ ", "599 ", "TNX\n", "73 " };
+		size_t len = 0;
+		for (int i = 0; len + 8 < size; i++) {
+			const char * word = words[i % 5];
+			memcpy(text + len, word, strlen(word));
+			len += strlen(word);
+		}
+		text[len] = '\0';
+
+		cw_transcoder_t * encoder = cw_transcoder_new(CW_TRANSCODE_ENCODE, NULL, NULL);
+		cw_transcoder_t * decoder = cw_transcoder_new(CW_TRANSCODE_DECODE, NULL, NULL);
+		char * encoded = (char *) malloc(cw_transcoder_get_max_output(encoder, len) + 1);
+		char * decoded = (char *) malloc(2 * len + 3);
+		cte->assert2(cte, encoder && decoder && encoded && decoded, "failed to create transcoders");
+
+		struct timeval begin, middle, end;
+		gettimeofday(&begin, NULL);
+		const size_t n_encoded = test_transcode_string(encoder, text, 1024 * 1024, encoded);
+		gettimeofday(&middle, NULL);
+		test_transcode_string(decoder, encoded, 1024 * 1024, decoded);
+		gettimeofday(&end, NULL);
+
+		const int encode_duration = cw_timestamp_compare_internal(&begin, &middle);
+		const int decode_duration = cw_timestamp_compare_internal(&middle, &end);
+		cte->log_info(cte, "encoded %zu bytes into %zu bytes in %d us, decoded in %d us\n",
+			      len, n_encoded, encode_duration, decode_duration);
+
+		/* Decoder emits one space per word break, so spaces
+		   before newlines of original text are lost. */
+		for (size_t i = 0, j = 0; i <= len; i++) {
+			if (!(text[i] == ' ' && text[i + 1] == '\n')) {
+				text[j++] = text[i];
+			}
+		}
+		/* Trailing space isn't encoded. */
+		size_t trimmed = strlen(text);
+		while (trimmed && text[trimmed - 1] == ' ') {
+			text[--trimmed] = '\0';
+		}
+		cte->expect_op_int(cte, 0, "==", strcmp(text, decoded), false, "round trip of large text");
+
+		free(decoded);
+		free(encoded);
+		free(text);
+		cw_transcoder_delete(&encoder);
+		cw_transcoder_delete(&decoder);
+	}
+
+	cte->print_test_footer(cte, __func__);
+
+	return 0;
+}
@@ -28,6 +28,19 @@
 #include "libcw_gen_tests.h"
 #include "libcw_key_tests.h"
 #include "libcw_rec_tests.h"
+#include "libcw_sched_tests.h"
+#include "libcw_codec_tests.h"
+#include "libcw_trace_tests.h"
+#include "libcw_analyzer_tests.h"
+#include "libcw_transcode_tests.h"
+#include "libcw_alphabet_tests.h"
+#include "libcw_pool_tests.h"
+#include "libcw_resampler_tests.h"
+#include "libcw_snapshot_tests.h"
+#include "libcw_shm_tq_tests.h"
+#include "libcw_rec_output_tests.h"
+#include "libcw_rec_manager_tests.h"
+#include "libcw_cpp_tests.h"
 
 #include "test_framework.h"
 
@@ -56,6 +69,19 @@ cw_test_set_t cw_test_sets[] = {
 			/* cw_debug topic */
 			LIBCW_TEST_FUNCTION_INSERT(test_cw_debug_flags_internal),
 
+			/* cw_trace topic */
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_trace_record_read),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_trace_replay),
+
+			/* cw_analyzer topic */
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_analyzer),
+
+			/* cw_pool topic */
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_pool),
+
+			/* C++ front end */
+			LIBCW_TEST_FUNCTION_INSERT(test_libcw_cpp),
+
 			LIBCW_TEST_FUNCTION_INSERT(NULL),
 		}
 	},
@@ -76,8 +102,16 @@ cw_test_set_t cw_test_sets[] = {
 			LIBCW_TEST_FUNCTION_INSERT(test_phonetic_lookups_internal),
 			LIBCW_TEST_FUNCTION_INSERT(test_validate_character_internal),
 			LIBCW_TEST_FUNCTION_INSERT(test_validate_string_internal),
+			LIBCW_TEST_FUNCTION_INSERT(test_normalize_string_internal),
+			LIBCW_TEST_FUNCTION_INSERT(test_load_character_table_internal),
 			LIBCW_TEST_FUNCTION_INSERT(test_validate_representation_internal),
 
+			/* cw_transcoder topic */
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_transcoder),
+
+			/* cw_alphabet topic */
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_alphabet),
+
 			LIBCW_TEST_FUNCTION_INSERT(NULL),
 		}
 
@@ -117,6 +151,19 @@ cw_test_set_t cw_test_sets[] = {
 		LIBCW_TEST_SET_VALID,
 		LIBCW_TEST_API_MODERN,
 
+		{ LIBCW_TEST_TOPIC_TQ, LIBCW_TEST_TOPIC_MAX }, /* Topics. */
+		{ CW_AUDIO_NULL, LIBCW_TEST_SOUND_SYSTEM_MAX }, /* Sound systems. Tone queue in shared memory is tested with generators using null audio sink. */
+
+		{
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_shm_tq),
+
+			LIBCW_TEST_FUNCTION_INSERT(NULL),
+		}
+	},
+	{
+		LIBCW_TEST_SET_VALID,
+		LIBCW_TEST_API_MODERN,
+
 		{ LIBCW_TEST_TOPIC_GEN, LIBCW_TEST_TOPIC_MAX }, /* Topics. */
 		{ CW_AUDIO_NULL, CW_AUDIO_CONSOLE, CW_AUDIO_OSS, CW_AUDIO_ALSA, CW_AUDIO_PA, LIBCW_TEST_SOUND_SYSTEM_MAX }, /* Sound systems. */
 
@@ -144,6 +191,33 @@ cw_test_set_t cw_test_sets[] = {
 		LIBCW_TEST_SET_VALID,
 		LIBCW_TEST_API_MODERN,
 
+		{ LIBCW_TEST_TOPIC_GEN, LIBCW_TEST_TOPIC_MAX }, /* Topics. */
+		{ CW_AUDIO_NULL, LIBCW_TEST_SOUND_SYSTEM_MAX }, /* Sound systems. Sessions of scheduler and codec, and rendering of straight key's buffers, don't use audio sinks. */
+
+		{
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_gen_sk_edges),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_gen_symbolic_enqueue),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_gen_get_queued_duration),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_gen_enqueue_at),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_gen_key_edges),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_gen_timeline),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_gen_fixed_point_synthesis),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_gen_synthesis_rate),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_resampler),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_sched_new_delete),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_sched_sessions),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_sched_silence),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_codec_encode_decode),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_codec_straight_key),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_gen_snapshot),
+
+			LIBCW_TEST_FUNCTION_INSERT(NULL),
+		}
+	},
+	{
+		LIBCW_TEST_SET_VALID,
+		LIBCW_TEST_API_MODERN,
+
 		{ LIBCW_TEST_TOPIC_KEY, LIBCW_TEST_TOPIC_MAX }, /* Topics. */
 		{ CW_AUDIO_NULL, CW_AUDIO_CONSOLE, CW_AUDIO_OSS, CW_AUDIO_ALSA, CW_AUDIO_PA, LIBCW_TEST_SOUND_SYSTEM_MAX }, /* Sound systems. */
 
@@ -166,8 +240,12 @@ cw_test_set_t cw_test_sets[] = {
 			LIBCW_TEST_FUNCTION_INSERT(test_cw_rec_parameter_getters_setters_1),
 			LIBCW_TEST_FUNCTION_INSERT(test_cw_rec_parameter_getters_setters_2),
 			LIBCW_TEST_FUNCTION_INSERT(test_cw_rec_identify_mark_internal),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_rec_adaptive_averages),
 			LIBCW_TEST_FUNCTION_INSERT(test_cw_rec_test_with_constant_speeds),
 			LIBCW_TEST_FUNCTION_INSERT(test_cw_rec_test_with_varying_speeds),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_rec_snapshot),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_rec_output),
+			LIBCW_TEST_FUNCTION_INSERT(test_cw_rec_manager),
 
 			LIBCW_TEST_FUNCTION_INSERT(NULL)
 		}
@@ -103,11 +103,11 @@ typedef struct cw_test_executor_t {
 
 
 	/**
-	   Verify that operator @param operator is satisfied for
+	   Verify that operator @param op is satisfied for
 	   @param received_value and @param expected_value
 
 	   Use the function to verify that a successful behaviour has
-	   occurred and @param operator applied to value of
+	   occurred and @param op applied to value of
 	   calculation (@param received_value) and expected value
 	   (@param expected_value) returns true.
 
@@ -120,8 +120,8 @@ typedef struct cw_test_executor_t {
 	   @return true if this comparison shows that the values satisfy the operator
 	   @return false otherwise
 	*/
-	bool (* expect_op_int)(struct cw_test_executor_t * self, int expected_value, const char * operator, int received_value, bool errors_only, const char * fmt, ...) __attribute__ ((format (printf, 6, 7)));
-	bool (* expect_op_double)(struct cw_test_executor_t * self, double expected_value, const char * operator, double received_value, bool errors_only, const char * fmt, ...) __attribute__ ((format (printf, 6, 7)));
+	bool (* expect_op_int)(struct cw_test_executor_t * self, int expected_value, const char * op, int received_value, bool errors_only, const char * fmt, ...) __attribute__ ((format (printf, 6, 7)));
+	bool (* expect_op_double)(struct cw_test_executor_t * self, double expected_value, const char * op, double received_value, bool errors_only, const char * fmt, ...) __attribute__ ((format (printf, 6, 7)));
 
 	/**
 	   Verify that @param received_value is between @param
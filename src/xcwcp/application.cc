@@ -719,6 +719,8 @@ void Application::key_event(QKeyEvent *event)
 		} else if (modeset.get_current()->is_receive()) {
 			//fprintf(stderr, "---------- key event: receiver mode mode\n");
 			receiver->handle_key_event(event, reverse_paddles_action->isChecked());
+		} else if (modeset.get_current()->is_dictionary()) {
+			sender->handle_copy_key_event(event);
 		} else {
 			;
 		}
@@ -20,6 +20,7 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cctype>
 #include <string>
 #include <deque>
 #include <sstream>
@@ -64,7 +65,7 @@ void Sender::poll(const Mode *current_mode)
 					       + current_mode->get_dmode()->get_random_word_group());
 			}
 
-			dequeue_and_play_character();
+			dequeue_and_play_character(current_mode->is_dictionary());
 		}
 	}
 
@@ -118,16 +119,55 @@ void Sender::handle_key_event(QKeyEvent *event)
 
 
 
+/**
+   \brief Handle keys entered in main window in dictionary mode
+
+   In dictionary mode user types a copy of played text. The copy
+   is scored against played characters, and the score is displayed
+   in status bar together with next played character.
+
+   Function handles only key presses. Key releases are ignored.
+
+   Call the function only when dictionary mode is active.
+
+   \param event - key event in main window to handle
+*/
+void Sender::handle_copy_key_event(QKeyEvent *event)
+{
+	if (event->type() == QEvent::KeyPress) {
+
+		if (event->key() == Qt::Key_Backspace) {
+			cw_score_delete_received(score);
+			event->accept();
+		} else {
+			const QByteArray text = event->text().toLatin1();
+
+			if (!text.isEmpty() && isprint((unsigned char) text[0])) {
+				cw_score_add_received(score, text.constData());
+				event->accept();
+			}
+		}
+	}
+
+	return;
+}
+
+
+
+
+
 /**
    \brief Clear sender state
 
    Flush libcw tone queue, empty the character queue, and set state to idle.
+   Forget score of copy practice.
 */
 void Sender::clear()
 {
 	cw_flush_tone_queue();
 	queue.clear();
 	is_queue_idle = true;
+	cw_score_reset(score);
 
 	return;
 }
@@ -142,8 +182,10 @@ void Sender::clear()
    Called when the CW send buffer is empty.  If the queue is not idle,
    take the next character from the queue and play it.  If there are
    no more queued characters, set the queue to idle.
+
+   \param is_copy_practice - is user copying played characters?
 */
-void Sender::dequeue_and_play_character()
+void Sender::dequeue_and_play_character(bool is_copy_practice)
 {
 	if (is_queue_idle) {
 		return;
@@ -170,8 +212,22 @@ void Sender::dequeue_and_play_character()
 	   the played char at the end to avoid "jumping" of whole
 	   string when width of glyph of played char changes at
 	   variable font width. */
-	QString status = _("Sending at %1 WPM: '%2'");
-	app->show_status(status.arg(cw_get_send_speed()).arg(c));
+	cw_score_result_t result = cw_score_result_t();
+	if (is_copy_practice) {
+		const char sent[2] = { c, '\0' };
+		cw_score_add_sent(score, sent);
+		cw_score_get_result(score, &result);
+	}
+
+	if (result.n_received > 0) {
+		QString status = _("Copy: %1% (%2 errors), sending at %3 WPM: '%4'");
+		app->show_status(status.arg(cw_score_get_accuracy(score))
+				 .arg(result.n_substitutions + result.n_deletions + result.n_insertions)
+				 .arg(cw_get_send_speed()).arg(c));
+	} else {
+		QString status = _("Sending at %1 WPM: '%2'");
+		app->show_status(status.arg(cw_get_send_speed()).arg(c));
+	}
 
 	return;
 }
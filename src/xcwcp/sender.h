@@ -29,6 +29,9 @@
 #include <deque>
 
 
+#include "scoring.h"
+
+
 
 
 
@@ -59,12 +62,16 @@ namespace cw {
 		Sender(Application *a, TextArea *t) :
 			app (a),
 			textarea (t),
-			is_queue_idle (true) { }
+			is_queue_idle (true),
+			score (cw_score_new(0)) { }
+
+		~Sender() { cw_score_delete(&score); }
 
 		/* Poll timeout handler, and keypress event
-		   handler. */
+		   handlers. */
 		void poll(const Mode *current_mode);
 		void handle_key_event(QKeyEvent *event);
+		void handle_copy_key_event(QKeyEvent *event);
 
 		/* Clear out queued data on stop, mode change, etc. */
 		void clear();
@@ -73,7 +80,7 @@ namespace cw {
 		/* Deque and queue manipulation functions, used to
 		   handle and maintain the buffer of characters
 		   awaiting sending through libcw. */
-		void dequeue_and_play_character();
+		void dequeue_and_play_character(bool is_copy_practice);
 		void enqueue_string(const std::string &word);
 		void delete_character();
 
@@ -84,6 +91,10 @@ namespace cw {
 		bool is_queue_idle;
 		std::deque<char> queue;
 
+		/* Text sent in dictionary modes, and user's copy of
+		   the text. */
+		cw_score_t *score;
+
 
 		/* Prevent unwanted operations. */
 		Sender(const Sender &);